@@ -121,6 +121,7 @@
 #include "ASerialLdd1.h"
 #include "AS1.h"
 #include "UART_PDD.h"
+#include "Events.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -430,6 +431,12 @@ PE_ISR(ASerialLdd1_Interrupt)
 	  UART0_BDH &= ~UART_BDH_RXEDGIE_MASK;
   }
 
+  if (UART0_C5 & UART_C5_RDMAS_MASK) /* Is data register serviced by DMA (hardware/UART.c)? */
+  {
+	  AS1_OnDmaInterrupt();
+	  return;
+  }
+
   if (StatReg & (UART_S1_NF_MASK | UART_S1_OR_MASK | UART_S1_FE_MASK | UART_S1_PF_MASK)) { /* Is any error flag set? */
     Data = (uint16_t)UART_PDD_GetChar8(UART0_BASE_PTR); /* Read an 8-bit character from receiver */
     if ((StatReg & UART_S1_FE_MASK) != 0U) { /* Is the framing error detected? */
@@ -100,7 +100,7 @@ extern "C" {
 #define VECTOR_14         (tIsrFunc)&UnhandledInterrupt         /* 0x0E -    ivINT_PendableSrvReq           unused by PE */
 #define VECTOR_15         (tIsrFunc)&UnhandledInterrupt         /* 0x0F -    ivINT_SysTick                  unused by PE */
 #define VECTOR_16         (tIsrFunc)&UnhandledInterrupt         /* 0x10 -    ivINT_DMA0                     unused by PE */
-#define VECTOR_17         (tIsrFunc)&UnhandledInterrupt         /* 0x11 -    ivINT_DMA1                     unused by PE */
+#define VECTOR_17         (tIsrFunc)&DMA1_Interrupt             /* 0x11 80   ivINT_DMA1                     used by Events.c */
 #define VECTOR_18         (tIsrFunc)&UnhandledInterrupt         /* 0x12 -    ivINT_DMA2                     unused by PE */
 #define VECTOR_19         (tIsrFunc)&UnhandledInterrupt         /* 0x13 -    ivINT_DMA3                     unused by PE */
 #define VECTOR_20         (tIsrFunc)&UnhandledInterrupt         /* 0x14 -    ivINT_DMA4                     unused by PE */
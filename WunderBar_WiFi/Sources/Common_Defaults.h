@@ -119,6 +119,19 @@ extern wcfg_t wunderbar_configuration;
 #define MQTT_MSG_OPT_RETAINED				0
 #define MQTT_MSG_OPT_QOS_SUB				0
 
+#define MQTT_TX_BATCH_MAX_BYTES				1400	// mqtt packets are coalesced into one bulk transfer up to this size (max 1400)
+#define MQTT_TX_BATCH_FLUSH_MS				0		// max time coalesced packets wait for more packets (0 - send after each processing pass)
+
+#define MQTT_RX_RING_SIZE					2048	// ring buffer for received mqtt packets, biggest packet which can be received (power of two)
+#define MQTT_RX_PACKETS						16		// max received packets waiting for processing (power of two)
+
+#define SPOOL_BATCH_FLUSH_MS				2000	// max time spooled readings wait in ram before they are programmed into flash
+#define SPOOL_REPLAY_INTERVAL_MS			200		// pause between replay bursts after reconnect
+#define SPOOL_REPLAY_BURST					2		// spooled readings published in one replay burst
+#define SPOOL_COMMIT_EVERY					16		// replay progress is saved into flash after this many replayed readings
+
+#define UART_CAPTURE_SIZE					0		// ram ring for GS uart traffic capture, read out with debugger (0 - capture disabled)
+
 #define MQTT_TOPIC_PREFIX            		"/v1"
 #define WUNDERBAR_SECURITY_LENGTH  			12
 
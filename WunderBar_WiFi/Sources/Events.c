@@ -47,6 +47,7 @@ extern "C" {
 #include "GS/GS_User/GS_User.h"
 #include "MQTT/MQTT_API_Client/MQTT_Api.h"
 #include "Sensors/Sensors_main.h"
+#include "Scheduler/Scheduler.h"
 
 
 #ifdef __cplusplus
@@ -167,6 +168,75 @@ void AS1_OnFreeTxBuf(void)
   /* Write your code here ... */
 }
 
+/*
+** ===================================================================
+**     Event       :  AS1_OnDmaInterrupt (module Events)
+**
+**     Component   :  AS1 [AsynchroSerial]
+**     Description :
+**         This event is called from AS1 interrupt routine instead of
+**         its own service when UART data register is serviced by DMA
+**         (hardware/UART.c).
+**     Parameters  : None
+**     Returns     : Nothing
+** ===================================================================
+*/
+void AS1_OnDmaInterrupt(void)
+{
+	GS_HAL_Interrupt();
+}
+
+/*
+** ===================================================================
+**     Interrupt   :  DMA1_Interrupt (module Events)
+**
+**     Description :
+**         DMA channel 1 (UART transmit) major loop complete interrupt.
+**     Parameters  : None
+**     Returns     : Nothing
+** ===================================================================
+*/
+PE_ISR(DMA1_Interrupt)
+{
+	GS_HAL_TxDmaInterrupt();
+}
+
+/*
+** ===================================================================
+**     Event       :  GS_HAL_OnRxIdle (module Events)
+**
+**     Component   :  hardware/UART.c
+**     Description :
+**         This event is called when receive line goes idle after
+**         data from GS module. Received data is processed at once
+**         instead of on the next GS timer tick.
+**     Parameters  : None
+**     Returns     : Nothing
+** ===================================================================
+*/
+void GS_HAL_OnRxIdle(void)
+{
+	Sleep_Restore_Countdown();
+	Sched_Post(SCHED_TASK_GS);
+}
+
+/*
+** ===================================================================
+**     Event       :  GS_HAL_OnTxDone (module Events)
+**
+**     Component   :  hardware/UART.c
+**     Description :
+**         This event is called after the last byte passed to
+**         GS_HAL_send is transmitted.
+**     Parameters  : None
+**     Returns     : Nothing
+** ===================================================================
+*/
+void GS_HAL_OnTxDone(void)
+{
+  /* Write your code here ... */
+}
+
 /*
 ** ===================================================================
 **     Event       :  EInt1_OnInterrupt (module Events)
@@ -203,14 +273,13 @@ void EInt1_OnInterrupt(void)
 void TI2_OnInterrupt(void)
 {
   /* Write your code here ... */
-	MSTimer_Increment_milliseconds();
-	Onbrd_Poll();
+	Sched_Post(SCHED_TASK_ONBRD);
 
 	if (MQTT_Get_RunnigStatus())
 	{
 		Sleep_DecrementCountDown();
 	}
-	/* One millisecond interrupt */
+	/* TIMER2_INT_PERIOD interrupt, time is kept by MSTimer */
 }
 
 /*
@@ -230,7 +299,7 @@ void TI2_OnInterrupt(void)
 void TI1_OnInterrupt(void)
 {
   /* Write your code here ... */
-	GS_Main_StateMachine();
+	Sched_Post(SCHED_TASK_GS);
 }
 
 /*
@@ -272,7 +341,7 @@ void EInt2_OnInterrupt(void)
 	if (Check_ExtIntEn())
 	{
 		Sleep_Restore_Countdown();
-		Sensors_SPI_ReadMsg();
+		Sched_Post(SCHED_TASK_SENSORS);
 	}
 }
 
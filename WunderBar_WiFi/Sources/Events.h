@@ -156,6 +156,33 @@ void AS1_OnFullRxBuf(void);
 */
 void AS1_OnFreeTxBuf(void);
 
+/*
+** ===================================================================
+**     Event       :  AS1_OnDmaInterrupt (module Events)
+**
+**     Component   :  AS1 [AsynchroSerial]
+**     Description :
+**         This event is called from AS1 interrupt routine instead of
+**         its own service when UART data register is serviced by DMA
+**         (hardware/UART.c).
+**     Parameters  : None
+**     Returns     : Nothing
+** ===================================================================
+*/
+void AS1_OnDmaInterrupt(void);
+
+/*
+** ===================================================================
+**     Interrupt   :  DMA1_Interrupt (module Events)
+**
+**     Description :
+**         DMA channel 1 (UART transmit) major loop complete interrupt.
+**     Parameters  : None
+**     Returns     : Nothing
+** ===================================================================
+*/
+PE_ISR(DMA1_Interrupt);
+
 void EInt1_OnInterrupt(void);
 /*
 ** ===================================================================
@@ -15,7 +15,7 @@
 #define GS_API_IP_STR_LENGTH  16  ///< Length of string needed to hold longest IP value (ie. 255.255.255.255)
 #define CID_COUNT 16 ///< Number of possible connection IDs
 
-typedef void (*GS_API_DataHandler)(uint8_t cid, uint8_t byte); ///< TCP and UDP connection data handling function pointer. cid is Connection ID of connection sending the data, byte is the data received.
+typedef uint32_t (*GS_API_DataHandler)(uint8_t cid, const uint8_t* data, uint32_t len); ///< TCP and UDP connection data handling function pointer. cid is Connection ID of connection sending the data, data and len is the span of data received (valid only during the call). Returns number of bytes taken, the rest is offered again on next receive (left in the UART meanwhile).
 void App_HandleErrorMessage(int error_message);
 
 /**
@@ -117,6 +117,13 @@ void GS_API_StopProvisioning(void);
  */
 bool GS_API_SetupWifiNetwork(HOST_APP_NETWORK_CONFIG_T* apiNetCfg);
 
+/**
+   @brief Check if queued commands (network setup, socket options) are still being sent
+
+   @return true if there are commands waiting for response
+ */
+bool GS_API_CommandsPending(void);
+
 /**
    @brief Joins already configured wifi network
 
@@ -223,6 +230,20 @@ bool GS_API_SendUdpClientData(uint8_t cid, uint8_t* dataBuffer, uint16_t dataLen
  */
 bool GS_API_SendTcpData(uint8_t cid, uint8_t* dataBuffer, uint16_t dataLength);
 
+/**
+   @brief Sends a TCP data packet gathered from several buffers
+
+   Sends pieces of data as one TCP data packet using the specified CID, without
+   copying them into one buffer. Data longer than 1400 bytes is sent in several
+   bulk transfers.
+
+   @param cid Connection ID of the TCP conenction to send data to
+   @param spans Pieces of data that will be sent
+   @param numSpans Number of pieces
+   @return true if data send was a success. false indicates failure and CID should no longer be used
+ */
+bool GS_API_SendTcpDataSpans(uint8_t cid, const ATLIB_DATA_SPAN_T* spans, uint8_t numSpans);
+
 /**
    @brief Handles incoming data
 
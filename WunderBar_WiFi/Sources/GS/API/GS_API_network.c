@@ -29,6 +29,8 @@ static char tcpServerClientIp[IP_STRING_LENGTH]; ///< IP address of incoming TCP
 /** Private Method Declaration **/
 static uint8_t gs_api_parseCidStr(uint8_t* cidStr);
 static bool gs_api_handle_cmd_resp(HOST_APP_MSG_ID_E msg);
+static void gs_api_handle_queued_cmd_resp(HOST_APP_MSG_ID_E msg, void* arg);
+static void gs_api_setupWifiNetwork(HOST_APP_NETWORK_CONFIG_T* apiNetCfg);
 static bool GS_Api_IsCidValid(uint8_t cid);
 static void gs_api_setCidDataHandler(uint8_t cid, GS_API_DataHandler cidDataHandler);
 static GS_API_DataHandler gs_api_getCidDataHandler(uint8_t cid);
@@ -47,14 +49,39 @@ void GS_API_DisconnectNetwork(void){
 /**
 *  @brief  Set up WiFi network
 *
-*  initialize and set up WiFi parameters for desired WiFi network
+*  initialize and set up WiFi parameters for desired WiFi network.
+*  Commands are queued and sent while main state machine keeps running,
+*  GS_API_CommandsPending tells when they are done.
 *
 *  @param  Network Configuration struct
 *
-*  @return True if successful
+*  @return True if setup commands are queued
 */
 bool GS_API_SetupWifiNetwork(HOST_APP_NETWORK_CONFIG_T* apiNetCfg) {
-     bool set = false;
+
+     AtLib_CommandQueueStart(GS_Api_GetResponseTimeoutHandle(), gs_api_handle_queued_cmd_resp, NULL);
+     gs_api_setupWifiNetwork(apiNetCfg);
+
+     return AtLib_CommandQueueEnd();
+}
+
+/**
+*  @brief  Check if queued commands are still being sent
+*
+*  @return True if there are commands waiting for response
+*/
+bool GS_API_CommandsPending(void){
+     return !AtLib_CommandQueueIdle();
+}
+
+/**
+*  @brief  Queue WiFi network setup commands
+*
+*  @param  Network Configuration struct
+*
+*  @return void
+*/
+static void gs_api_setupWifiNetwork(HOST_APP_NETWORK_CONFIG_T* apiNetCfg) {
      uint8_t security = atoi(apiNetCfg->security);
      // Set all the configuration options
 
@@ -62,17 +89,17 @@ bool GS_API_SetupWifiNetwork(HOST_APP_NETWORK_CONFIG_T* apiNetCfg) {
      if (atoi(apiNetCfg->dhcpEnabled)) {
           if (!gs_api_handle_cmd_resp(AtLibGs_DHCPSet(1)))
           {
-        	  return set;
+        	  return;
           }
      } else {
           if (!gs_api_handle_cmd_resp(AtLibGs_DHCPSet(0)))
-               return set;
+               return;
 
           if (!gs_api_handle_cmd_resp(
                    AtLibGs_IPSet((int8_t *) apiNetCfg->staticIp,
                                  (int8_t *) apiNetCfg->subnetMask,
                                  (int8_t *) apiNetCfg->gatewayIp)))
-               return set;
+               return;
      }
 
      // Check security
@@ -82,10 +109,10 @@ bool GS_API_SetupWifiNetwork(HOST_APP_NETWORK_CONFIG_T* apiNetCfg) {
           // Don't check these since some might not be valid anyway
           if (!gs_api_handle_cmd_resp(
         		  AtLibGs_SetPassPhrase((int8_t *) apiNetCfg->passphrase)))
-        	  return set;
+        	  return;
 
           if (!gs_api_handle_cmd_resp(AtLibGs_SetAuthMode(0)))
-        	  return set;
+        	  return;
           break;
 
      case 1:
@@ -97,10 +124,10 @@ bool GS_API_SetupWifiNetwork(HOST_APP_NETWORK_CONFIG_T* apiNetCfg) {
           if (!gs_api_handle_cmd_resp(
                    AtLibGs_SetWepKey(atoi(apiNetCfg->wepId),
                 		   	   	   	   	   apiNetCfg->wepKey)))
-               return set;
+               return;
 
           if (!gs_api_handle_cmd_resp(AtLibGs_SetAuthMode(0)))
-               return set;
+               return;
           break;
 
      case 4:
@@ -110,7 +137,7 @@ bool GS_API_SetupWifiNetwork(HOST_APP_NETWORK_CONFIG_T* apiNetCfg) {
      case 64:
           // Set WPA
           if (!gs_api_handle_cmd_resp(AtLibGs_SetPassPhrase((int8_t *) apiNetCfg->passphrase)))
-               return set;
+               return;
           break;
 
      default:
@@ -120,13 +147,10 @@ bool GS_API_SetupWifiNetwork(HOST_APP_NETWORK_CONFIG_T* apiNetCfg) {
 
      // Set the security mode
      if(!gs_api_handle_cmd_resp(AtLibGs_SetSecurity(security)))
-          return set;
+          return;
 
      // Set adhoc or infrastructure
-     if(!gs_api_handle_cmd_resp(AtLibGs_Mode(atoi(apiNetCfg->connType))))
-          return set;
-
-     return set;
+     gs_api_handle_cmd_resp(AtLibGs_Mode(atoi(apiNetCfg->connType)));
 }
 
 /**
@@ -218,6 +242,7 @@ bool GS_API_StartProvisioning(char* provSsid, char* provChannel, char* ip,
 */
 void GS_API_StopProvisioning(void){
      // Web client can't be shut off, so just reset the device
+     gs_api_setBaudRate(GS_HAL_BAUD_DEFAULT);
      gs_api_handle_cmd_resp(AtLibGs_Reset());     
 }
 
@@ -408,6 +433,19 @@ bool GS_API_SendTcpData(uint8_t cid, uint8_t* dataBuffer, uint16_t dataLength){
      return ((AtLib_BulkDataTransfer(CID_INT_TO_HEX(cid), dataBuffer, dataLength)) == HOST_APP_MSG_ID_ESC_CMD_OK);
 }
 
+/**
+*  Send TCP data gathered from several buffers
+*
+*  @param  Connection id
+*  @param  Data pieces
+*  @param  Number of pieces
+*
+*  @return True if successful
+*/
+bool GS_API_SendTcpDataSpans(uint8_t cid, const ATLIB_DATA_SPAN_T* spans, uint8_t numSpans){
+     return ((AtLib_BulkDataTransferSpans(CID_INT_TO_HEX(cid), spans, numSpans)) == HOST_APP_MSG_ID_ESC_CMD_OK);
+}
+
 /**
 *  @brief  Send UDP data (as server) to last connected client
 *
@@ -466,13 +504,16 @@ void GS_API_HandleErrorMessage(HOST_APP_MSG_ID_E error_message){
 }
 
 void GS_API_CheckForData(void){
-     uint8_t rxData;
      HOST_APP_MSG_ID_E Error_Message;
 
-     /* Read one byte at a time - Use non-blocking call */
-     while (GS_HAL_recv(&rxData, 1, 0)) {
-          /* Process the received data */
-          switch(Error_Message = AtLib_ReceiveDataProcess(rxData)){
+     /* Process received data chunk by chunk, until there is no more messages - Use non-blocking call */
+     while ((Error_Message = AtLib_ReceiveChunk(NULL)) != HOST_APP_MSG_ID_NONE) {
+          /* Response to queued command */
+          if (AtLib_CommandQueueResponse(Error_Message))
+               continue;
+
+          /* Process the received message */
+          switch(Error_Message){
           case HOST_APP_MSG_ID_TCP_SERVER_CLIENT_CONNECTION:
           {
                uint8_t cidServerStr[] = " ";
@@ -499,6 +540,9 @@ void GS_API_CheckForData(void){
         	  break;
           }
      }
+
+     /* Send next queued command */
+     AtLib_CommandQueueTask();
 }
 
 /**
@@ -546,33 +590,39 @@ bool GS_API_DNSResolve(int8_t* url, uint8_t* hostIPaddr){
 /**
 *  @brief  Set up max retries socket options for desired socket
 *
+*  Command is queued, result is only reported.
+*
 *  @param  Connection id
 *  @param  Max retries in seconds
 *
-*  @return True if successful
+*  @return True if command is queued
 */
 bool GS_Api_SetUpSocket_MaxRT(uint8_t cid, uint32_t max_rt){
 
-	return gs_api_handle_cmd_resp(AtLib_SetSocketOptions(cid, ATLIB_SOCKET_OPTION_TYPE_TCP, ATLIB_SOCKET_OPTION_PARAM_TCP_MAXRT, max_rt));
+	AtLib_CommandQueueStart(GS_Api_GetResponseTimeoutHandle(), gs_api_handle_queued_cmd_resp, NULL);
+	AtLib_SetSocketOptions(cid, ATLIB_SOCKET_OPTION_TYPE_TCP, ATLIB_SOCKET_OPTION_PARAM_TCP_MAXRT, max_rt);
+
+	return AtLib_CommandQueueEnd();
 }
 
 /**
 *  @brief  Set up keep alive socket options for desired socket
 *
+*  Commands are queued, result is only reported.
+*
 *  @param  Connection id
 *  @param  Keep alive in seconds
 *
-*  @return True if successful
+*  @return True if commands are queued
 */
 bool GS_Api_SetUpSocket_TcpKeepAlive(uint8_t cid, uint32_t keepalive){
 
-	if (!gs_api_handle_cmd_resp(AtLib_SetSocketOptions(cid, ATLIB_SOCKET_OPTION_TYPE_SOCK, ATLIB_SOCKET_OPTION_PARAM_SO_KEEPALIVE, 1)))
-		return false;
+	AtLib_CommandQueueStart(GS_Api_GetResponseTimeoutHandle(), gs_api_handle_queued_cmd_resp, NULL);
+	AtLib_SetSocketOptions(cid, ATLIB_SOCKET_OPTION_TYPE_SOCK, ATLIB_SOCKET_OPTION_PARAM_SO_KEEPALIVE, 1);
+	AtLib_SetSocketOptions(cid, ATLIB_SOCKET_OPTION_TYPE_TCP, ATLIB_SOCKET_OPTION_PARAM_TCP_KEEPALIVE_COUNT, 1);
+	AtLib_SetSocketOptions(cid, ATLIB_SOCKET_OPTION_TYPE_TCP, ATLIB_SOCKET_OPTION_PARAM_TCP_KEEPALIVE, keepalive);
 
-	if (!gs_api_handle_cmd_resp(AtLib_SetSocketOptions(cid, ATLIB_SOCKET_OPTION_TYPE_TCP, ATLIB_SOCKET_OPTION_PARAM_TCP_KEEPALIVE_COUNT, 1)))
-		return false;
-
-	return gs_api_handle_cmd_resp(AtLib_SetSocketOptions(cid, ATLIB_SOCKET_OPTION_TYPE_TCP, ATLIB_SOCKET_OPTION_PARAM_TCP_KEEPALIVE, keepalive));
+	return AtLib_CommandQueueEnd();
 }
 
 /**
@@ -865,14 +915,17 @@ uint8_t GS_Api_ParseDisconnectCid(){
    @brief AtCmdLib calls this function for all incoming data
 
    @param cid Incoming data connection ID
-   @param rxData Incoming data value
+   @param pData Incoming data
+   @param dataLen Number of incoming bytes
+   @return Number of bytes taken by the handler, data without handler is dropped
 */
-void App_ProcessIncomingData(uint8_t cid, uint8_t rxData) {
+uint32_t App_ProcessIncomingData(uint8_t cid, const uint8_t* pData, uint32_t dataLen) {
      // Check for and call handler for incoming CID and Data
      if(cid < CID_COUNT && cidDataHandlers[cid])
-          cidDataHandlers[cid](cid, rxData);
-     else
-          GS_API_Printf("RX Data with no handler for cid %d\r\n", cid);
+          return cidDataHandlers[cid](cid, pData, dataLen);
+
+     GS_API_Printf("RX Data with no handler for cid %d\r\n", cid);
+     return dataLen;
 }
 
 /**
@@ -910,14 +963,12 @@ static void gs_api_setCidDataHandler(uint8_t cid, GS_API_DataHandler cidDataHand
    @return CID as an integer, or GS_API_INVALID_CID if it couldn't be converted
 */
 static uint8_t gs_api_parseCidStr(uint8_t* cidStr){
-     unsigned int  cid = GS_API_INVALID_CID;
+     uint8_t cid = AtLib_getCidFromAscii(cidStr[0]);
 
-     if(sscanf((char*)cidStr, "%x",(unsigned int*) &cid)){
-          if(cid >= CID_COUNT){
-               cid = GS_API_INVALID_CID;
-          }
+     if(cid >= CID_COUNT){
+          cid = GS_API_INVALID_CID;
      }
-     return (uint8_t)cid;
+     return cid;
 }
 
 /**
@@ -936,3 +987,13 @@ static bool gs_api_handle_cmd_resp(HOST_APP_MSG_ID_E msg) {
      }
 
 }
+
+/**
+   @brief Reports response to a batch of queued commands
+   @private
+   @param msg Response of the last command, or of the one which failed
+   @param arg Not used
+*/
+static void gs_api_handle_queued_cmd_resp(HOST_APP_MSG_ID_E msg, void* arg) {
+     gs_api_handle_cmd_resp(msg);
+}
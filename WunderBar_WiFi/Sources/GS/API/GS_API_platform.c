@@ -22,6 +22,9 @@ void GS_API_Init(void){
 
 	 GS_Api_SetResponseTimeoutHandle(5000);
 
+	 // module comes out of reset on default rate, return it there first
+	 gs_api_setBaudRate(GS_HAL_BAUD_DEFAULT);
+
 	 // Send a \r\n to sync communication
      GS_HAL_send((uint8_t *) "\r\n", 2);
 
@@ -44,4 +47,33 @@ void GS_API_Init(void){
      AtLibGs_EnableRadio(1);
      AtLib_SetAntennaConf(1);
 
+     // speed up the link, it stays on default rate if module does not respond on the fast one
+     gs_api_setBaudRate(GS_HAL_BAUD_FAST);
+}
+
+/**
+*  @brief  Change UART baud rate on module and host
+*
+*  Module responds on the old rate and switches to the new one after that.
+*  If module does not respond on the new rate, host goes back to default rate,
+*  which module will also use after the next reset.
+*
+*  @param  Baud rate
+*
+*  @return true if module responds on the new rate
+*/
+bool gs_api_setBaudRate(uint32_t baudRate){
+
+     if (GS_HAL_GetBaudRate() == baudRate)
+          return true;
+
+     if (AtLibGs_SetBaudRate(baudRate) == HOST_APP_MSG_ID_OK)
+     {
+          GS_HAL_SetBaudRate(baudRate);
+          if (AtLibGs_Check() == HOST_APP_MSG_ID_OK)
+               return true;
+     }
+
+     GS_HAL_SetBaudRate(GS_HAL_BAUD_DEFAULT);
+     return false;
 }
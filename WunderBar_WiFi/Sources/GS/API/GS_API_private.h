@@ -14,5 +14,6 @@
 
 void gs_api_readNetworkConfig(void);
 void gs_api_writeNetworkConfig(void);
+bool gs_api_setBaudRate(uint32_t baudRate);
 
 #endif /* GS_API_PRIVATE_H_ */
@@ -40,6 +40,13 @@ uint16_t MRBufferIndex = 0;
 
 /* Command transmit buffer */
 char G_ATCmdBuf[HOST_APP_TX_CMD_MAX_SIZE];
+static uint16_t G_ATCmdLen = 0;	/* length of the command in G_ATCmdBuf */
+
+/* Data mode message templates, cid (and bulk data length) are filled in when sent */
+static const uint8_t AtLib_DataStartTemplate[] = { HOST_APP_ESC_CHAR, 'S', '0' };
+static const uint8_t AtLib_DataEndTemplate[] = { HOST_APP_ESC_CHAR, 'E' };
+static const uint8_t AtLib_BulkStartTemplate[] =
+  { HOST_APP_ESC_CHAR, 'Z', '0', '0', '0', '0', '0' };
 
 static uint8_t udpIncomingIp[HOST_APP_RX_IP_MAX_SIZE];
 static uint8_t udpIncomingPort[HOST_APP_RX_PORT_MAX_SIZE];
@@ -55,6 +62,23 @@ static uint8_t udpClientCid = HOST_APP_INVALID_CID;	/* UDP client CID */
  *-------------------------------------------------------------------------*/
 void AtLib_FlushRxBuffer (void);
 
+/*-------------------------------------------------------------------------*
+ * Command builder:
+ *      Commands are put together in G_ATCmdBuf from string literals,
+ *      strings and numbers, without parsing a format string.  Length of a
+ *      literal is known at compile time and G_ATCmdLen is kept up to date,
+ *      so the command does not have to be measured before it is sent.
+ *      Command is kept zero terminated and cut at the end of the buffer.
+ *-------------------------------------------------------------------------*/
+#define ATLIB_CMD_START(lit)            AtLib_CmdStart (lit, sizeof (lit) - 1)
+#define ATLIB_CMD_LIT(lit)              AtLib_CmdAppend (lit, sizeof (lit) - 1)
+
+static void AtLib_CmdStart (const char *pStr, uint16_t len);
+static void AtLib_CmdAppend (const char *pStr, uint16_t len);
+static void AtLib_CmdStr (const char *pStr);
+static void AtLib_CmdChar (char c);
+static void AtLib_CmdNum (int32_t value);
+
 /*---------------------------<AT command list >--------------------------------------------------------------------------
   _________________________________________________________________________________________________________________________
   AT Command                                                                   Description and AT command library API Name
@@ -63,6 +87,9 @@ void AtLib_FlushRxBuffer (void);
   ATE<0|1>                                                                             Disable/enable echo
   API Name: AtLibGs_SetEcho
 
+  ATB=<baudrate>                                                                       Set UART baud rate
+  API Name: AtLibGs_SetBaudRate
+
   AT&W<0|1>                                                                            Save Settings to profile 0/1
   API Name: AtLibGs_SaveProfile
 
@@ -363,7 +390,7 @@ AtLibGs_Check (void)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "\r\nAT\r\n");
+  ATLIB_CMD_START ("\r\nAT\r\n");
 
   rxMsgId = AtLib_CommandSend ();
 
@@ -388,7 +415,38 @@ AtLibGs_SetEcho (uint8_t mode)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "ATE" _F8_ "\r\n", mode);
+  ATLIB_CMD_START ("ATE");
+  AtLib_CmdNum (mode);
+  ATLIB_CMD_LIT ("\r\n");
+
+  /* Send command to S2w App node */
+  rxMsgId = AtLib_CommandSend ();
+
+  return rxMsgId;
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLibGs_SetBaudRate
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Send command to change the UART baud rate of the S2w node:
+ *          ATB=<baudrate>
+ *      and wait for response. Response is sent on the old rate, the new
+ *      rate is used from the next command on (until module reset).
+ * Inputs:
+ *      uint32_t baudRate -- new baud rate
+ * Outputs:
+ *      HOST_APP_MSG_ID_E -- response type
+ *---------------------------------------------------------------------------*/
+HOST_APP_MSG_ID_E
+AtLibGs_SetBaudRate (uint32_t baudRate)
+{
+  HOST_APP_MSG_ID_E rxMsgId;
+
+  /* Construct the AT command */
+  ATLIB_CMD_START ("ATB=");
+  AtLib_CmdNum (baudRate);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -416,7 +474,9 @@ AtLibGs_MACSet (int8_t * pAddr)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+NMAC=%s\r\n", pAddr);
+  ATLIB_CMD_START ("AT+NMAC=");
+  AtLib_CmdStr ((const char *) pAddr);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -444,7 +504,7 @@ AtLibGs_GetMAC (void)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+NMAC=?\r\n");
+  ATLIB_CMD_START ("AT+NMAC=?\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -472,7 +532,11 @@ AtLibGs_CalcNStorePSK (int8_t * pSsid, int8_t * pPsk)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+WPAPSK=%s,%s\r\n", pSsid, pPsk);
+  ATLIB_CMD_START ("AT+WPAPSK=");
+  AtLib_CmdStr ((const char *) pSsid);
+  ATLIB_CMD_LIT (",");
+  AtLib_CmdStr ((const char *) pPsk);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -502,7 +566,7 @@ AtLibGs_WlanConnStat (void)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+NSTAT=?\n");
+  ATLIB_CMD_START ("AT+NSTAT=?\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -531,7 +595,7 @@ AtLibGs_WlanConnStatShort (void)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+WSTATUS\n");
+  ATLIB_CMD_START ("AT+WSTATUS\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -558,7 +622,9 @@ AtLibGs_DHCPSet (uint8_t mode)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+NDHCP=" _F8_ "\r\n", mode);
+  ATLIB_CMD_START ("AT+NDHCP=");
+  AtLib_CmdNum (mode);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -589,12 +655,19 @@ AtLibGs_Assoc (int8_t * pSsid, int8_t * pBssid, int8_t * pChan)
   /* Construct the AT command */
   if (pChan)
     {
-      sprintf (G_ATCmdBuf, "AT+WA=%s,%s,%s\r\n", pSsid,
-	       pBssid ? (char *) pBssid : "", pChan);
+      ATLIB_CMD_START ("AT+WA=");
+      AtLib_CmdStr ((const char *) pSsid);
+      ATLIB_CMD_LIT (",");
+      AtLib_CmdStr (pBssid ? (char *) pBssid : "");
+      ATLIB_CMD_LIT (",");
+      AtLib_CmdStr ((const char *) pChan);
+      ATLIB_CMD_LIT ("\r\n");
     }
   else
     {
-      sprintf (G_ATCmdBuf, "AT+WA=%s\r\n", pSsid);
+      ATLIB_CMD_START ("AT+WA=");
+      AtLib_CmdStr ((const char *) pSsid);
+      ATLIB_CMD_LIT ("\r\n");
     }
 
   /* Send command to S2w App node */
@@ -626,8 +699,11 @@ AtLibGs_TcpClientStart (int8_t * pRemoteTcpSrvIp, int8_t * pRemoteTcpSrvPort)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+NCTCP=%s,%s\n", pRemoteTcpSrvIp,
-	   pRemoteTcpSrvPort);
+  ATLIB_CMD_START ("AT+NCTCP=");
+  AtLib_CmdStr ((const char *) pRemoteTcpSrvIp);
+  ATLIB_CMD_LIT (",");
+  AtLib_CmdStr ((const char *) pRemoteTcpSrvPort);
+  ATLIB_CMD_LIT ("\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -661,8 +737,13 @@ AtLibGs_UdpClientStart (int8_t * pRemoteUdpSrvIp,
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+NCUDP=%s,%s,%s\r\n", pRemoteUdpSrvIp,
-	   pRemoteUdpSrvPort, pUdpLocalPort);
+  ATLIB_CMD_START ("AT+NCUDP=");
+  AtLib_CmdStr ((const char *) pRemoteUdpSrvIp);
+  ATLIB_CMD_LIT (",");
+  AtLib_CmdStr ((const char *) pRemoteUdpSrvPort);
+  ATLIB_CMD_LIT (",");
+  AtLib_CmdStr ((const char *) pUdpLocalPort);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -689,7 +770,7 @@ AtLibGs_CloseAll (void)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+NCLOSEALL\r\n");
+  ATLIB_CMD_START ("AT+NCLOSEALL\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -716,7 +797,9 @@ AtLibGs_BatteryChkStart (uint32_t interval)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+BCHKSTRT=" _F32_ "\r\n", (int)interval);
+  ATLIB_CMD_START ("AT+BCHKSTRT=");
+  AtLib_CmdNum (interval);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -747,9 +830,15 @@ AtLibGs_GotoSTNDBy (uint32_t msec, uint32_t dealy,
 {
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf,
-	   "AT+PSSTBY=" _F32_ "," _F32_ "," _F32_ "," _F32_ "\r\n", (int)msec,
-	   (int)dealy, (int)alarm1_Pol, (int)alarm2_Pol);
+  ATLIB_CMD_START ("AT+PSSTBY=");
+  AtLib_CmdNum (msec);
+  ATLIB_CMD_LIT (",");
+  AtLib_CmdNum (dealy);
+  ATLIB_CMD_LIT (",");
+  AtLib_CmdNum (alarm1_Pol);
+  ATLIB_CMD_LIT (",");
+  AtLib_CmdNum (alarm2_Pol);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   AtLib_CommandSendNoResponse ();
@@ -774,7 +863,9 @@ AtLibGs_SetPassPhrase (int8_t * pPhrase)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+WWPA=%s\r\n", pPhrase);
+  ATLIB_CMD_START ("AT+WWPA=");
+  AtLib_CmdStr ((const char *) pPhrase);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -799,7 +890,7 @@ void
 AtLibGs_EnableDeepSleep (void)
 {
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+PSDPSLEEP\n");
+  ATLIB_CMD_START ("AT+PSDPSLEEP\n");
 
   /* Send command to S2w App node */
   AtLib_CommandSendNoResponse ();
@@ -824,7 +915,7 @@ AtLibGs_StoreNwConn (void)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+STORENWCONN\r\n");
+  ATLIB_CMD_START ("AT+STORENWCONN\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -851,7 +942,7 @@ AtLibGs_ReStoreNwConn (void)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+RESTORENWCONN\r\n");
+  ATLIB_CMD_START ("AT+RESTORENWCONN\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -884,7 +975,13 @@ AtLibGs_IPSet (int8_t * pIpAddr, int8_t * pSubnet, int8_t * pGateway)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+NSET=%s,%s,%s\r\n", pIpAddr, pSubnet, pGateway);
+  ATLIB_CMD_START ("AT+NSET=");
+  AtLib_CmdStr ((const char *) pIpAddr);
+  ATLIB_CMD_LIT (",");
+  AtLib_CmdStr ((const char *) pSubnet);
+  ATLIB_CMD_LIT (",");
+  AtLib_CmdStr ((const char *) pGateway);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -911,7 +1008,9 @@ AtLibGs_SaveProfile (uint8_t profile)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT&W" _F8_ "\r\n", profile);
+  ATLIB_CMD_START ("AT&W");
+  AtLib_CmdNum (profile);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -938,7 +1037,9 @@ AtLibGs_LoadProfile (uint8_t profile)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "ATZ" _F8_ "\r\n", profile);
+  ATLIB_CMD_START ("ATZ");
+  AtLib_CmdNum (profile);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -965,7 +1066,7 @@ AtLibGs_ResetFactoryDefaults (void)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT&F\r\n");
+  ATLIB_CMD_START ("AT&F\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -993,7 +1094,7 @@ AtLibGs_GetRssi (void)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+WRSSI=?\r\n");
+  ATLIB_CMD_START ("AT+WRSSI=?\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1020,7 +1121,7 @@ AtLibGs_DisAssoc (void)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+WD\r\n");
+  ATLIB_CMD_START ("AT+WD\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1055,8 +1156,15 @@ AtLibGs_FWUpgrade (int8_t * pSrvip, uint32_t srvport,
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+FWUP=%s," _F32_ "," _F32_ ",%s\r\n", (char*)pSrvip,
-		  (int)srvport, (int)srcPort, (char*)pSrcIP);
+  ATLIB_CMD_START ("AT+FWUP=");
+  AtLib_CmdStr ((char*)pSrvip);
+  ATLIB_CMD_LIT (",");
+  AtLib_CmdNum (srvport);
+  ATLIB_CMD_LIT (",");
+  AtLib_CmdNum (srcPort);
+  ATLIB_CMD_LIT (",");
+  AtLib_CmdStr ((char*)pSrcIP);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1083,7 +1191,7 @@ AtLibGs_BatteryChkStop (void)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+BCHKSTOP\r\n");
+  ATLIB_CMD_START ("AT+BCHKSTOP\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1112,7 +1220,9 @@ AtLibGs_MultiCast (uint8_t mode)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+MCSTSET=" _F8_ "\r\n", mode);
+  ATLIB_CMD_START ("AT+MCSTSET=");
+  AtLib_CmdNum (mode);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1140,7 +1250,7 @@ AtLibGs_Version (void)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+VER=?\r\n");
+  ATLIB_CMD_START ("AT+VER=?\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1167,7 +1277,9 @@ AtLibGs_Mode (uint32_t mode)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+WM=" _F32_ "\r\n", (int)mode);
+  ATLIB_CMD_START ("AT+WM=");
+  AtLib_CmdNum (mode);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1197,7 +1309,9 @@ AtLibGs_UdpServer_Start (int8_t * pUdpSrvPort)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+NSUDP=%s\r\n", pUdpSrvPort);
+  ATLIB_CMD_START ("AT+NSUDP=");
+  AtLib_CmdStr ((const char *) pUdpSrvPort);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1227,7 +1341,9 @@ AtLibGs_TcpServer_Start (int8_t * pTcpSrvPort)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+NSTCP=%s\r\n", pTcpSrvPort);
+  ATLIB_CMD_START ("AT+NSTCP=");
+  AtLib_CmdStr ((const char *) pTcpSrvPort);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1257,7 +1373,9 @@ AtLibGs_DNSLookup (int8_t * pUrl)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+DNSLOOKUP=%s\r\n", pUrl);
+  ATLIB_CMD_START ("AT+DNSLOOKUP=");
+  AtLib_CmdStr ((const char *) pUrl);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1285,7 +1403,9 @@ AtLibGs_Close (uint8_t cid)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+NCLOSE=%c\r\n", cid);
+  ATLIB_CMD_START ("AT+NCLOSE=");
+  AtLib_CmdChar (cid);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1313,7 +1433,9 @@ AtLibGs_SetWRetryCount (uint32_t count)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+WRETRY=" _F32_ "\r\n", (int)count);
+  ATLIB_CMD_START ("AT+WRETRY=");
+  AtLib_CmdNum (count);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1342,7 +1464,7 @@ AtLibGs_GetErrCount (void)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+ERRCOUNT=?\r\n");
+  ATLIB_CMD_START ("AT+ERRCOUNT=?\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1370,7 +1492,9 @@ AtLibGs_EnableRadio (uint8_t mode)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+WRXACTIVE=" _F8_ "\r\n", mode);
+  ATLIB_CMD_START ("AT+WRXACTIVE=");
+  AtLib_CmdNum (mode);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1399,7 +1523,9 @@ AtLibGs_EnablePwSave (uint8_t mode)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+WRXPS=" _F8_ "\r\n", mode);
+  ATLIB_CMD_START ("AT+WRXPS=");
+  AtLib_CmdNum (mode);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1429,7 +1555,9 @@ AtLibGs_SetTime (int8_t * pTime)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+SETTIME=%s\n", pTime);
+  ATLIB_CMD_START ("AT+SETTIME=");
+  AtLib_CmdStr ((const char *) pTime);
+  ATLIB_CMD_LIT ("\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1460,7 +1588,9 @@ AtLibGs_EnableExternalPA (uint8_t mode)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+EXTPA=" _F8_ "\r\n", mode);
+  ATLIB_CMD_START ("AT+EXTPA=");
+  AtLib_CmdNum (mode);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1489,7 +1619,9 @@ AtLibGs_SyncLossInterval (uint16_t interval)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+WSYNCINTRL=" _F16_ "\r\n", interval);
+  ATLIB_CMD_START ("AT+WSYNCINTRL=");
+  AtLib_CmdNum (interval);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1519,7 +1651,9 @@ AtLibGs_PSPollInterval (uint16_t interval)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+PSPOLLINTRL=" _F16_ "\r\n", interval);
+  ATLIB_CMD_START ("AT+PSPOLLINTRL=");
+  AtLib_CmdNum (interval);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1550,7 +1684,9 @@ AtLibGs_SetTxPower (uint32_t power)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+WP=" _F32_ "\r\n", (int)power);
+  ATLIB_CMD_START ("AT+WP=");
+  AtLib_CmdNum (power);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1583,11 +1719,15 @@ AtLibGs_SetDNSServerIP (int8_t * pDNS1, int8_t * pDNS2)
   /* Construct the AT command */
   if (pDNS2 == NULL)
     {
-      sprintf (G_ATCmdBuf, "AT+DNSSET=%s", pDNS1);
+      ATLIB_CMD_START ("AT+DNSSET=");
+      AtLib_CmdStr ((const char *) pDNS1);
     }
   else
     {
-      sprintf (G_ATCmdBuf, "AT+DNSSET=%s,%s", pDNS1, pDNS2);
+      ATLIB_CMD_START ("AT+DNSSET=");
+      AtLib_CmdStr ((const char *) pDNS1);
+      ATLIB_CMD_LIT (",");
+      AtLib_CmdStr ((const char *) pDNS2);
     }
 
   /* Send command to S2w App node */
@@ -1619,7 +1759,9 @@ AtLibGs_EnableAutoConnect (uint8_t mode)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "ATC" _F8_ "\r\n", mode);
+  ATLIB_CMD_START ("ATC");
+  AtLib_CmdNum (mode);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1643,21 +1785,16 @@ AtLibGs_EnableAutoConnect (uint8_t mode)
 void
 AtLibGs_SwitchFromAutoToCmd (void)
 {
-  uint32_t command_length;
-
-  sprintf (G_ATCmdBuf, "+++");
-  /* Get the command length */
-  command_length = strlen ((const char *) G_ATCmdBuf);
+  ATLIB_CMD_START ("+++");
 
-  GS_HAL_send ((uint8_t *) & G_ATCmdBuf[0], command_length);
+  GS_HAL_send ((uint8_t *) & G_ATCmdBuf[0], G_ATCmdLen);
 
   MSTimerDelay (1000);
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "\r\n");
-  command_length = strlen ((const char *) G_ATCmdBuf);
+  ATLIB_CMD_START ("\r\n");
 
-  GS_HAL_send ((uint8_t *) & G_ATCmdBuf[0], strlen (G_ATCmdBuf));
+  GS_HAL_send ((uint8_t *) & G_ATCmdBuf[0], G_ATCmdLen);
 }
 
 /*---------------------------------------------------------------------------*
@@ -1679,7 +1816,11 @@ AtLibGs_StoreWAutoConn (int8_t * pSsid, uint8_t channel)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+WAUTO=0,%s,," _F8_ "\r\n", pSsid, channel);
+  ATLIB_CMD_START ("AT+WAUTO=0,");
+  AtLib_CmdStr ((const char *) pSsid);
+  ATLIB_CMD_LIT (",,");
+  AtLib_CmdNum (channel);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1709,7 +1850,11 @@ AtLibGs_StoreNAutoConn (int8_t * pIpAddr, int16_t pRmtPort)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+NAUTO=0,0,%s," _F16_ "\r\n", pIpAddr, pRmtPort);
+  ATLIB_CMD_START ("AT+NAUTO=0,0,");
+  AtLib_CmdStr ((const char *) pIpAddr);
+  ATLIB_CMD_LIT (",");
+  AtLib_CmdNum (pRmtPort);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1757,7 +1902,11 @@ AtLibGs_StoreATS (uint8_t param, uint8_t value)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "ATS" _F8_ "=" _F8_ "\r\n", param, value);
+  ATLIB_CMD_START ("ATS");
+  AtLib_CmdNum (param);
+  ATLIB_CMD_LIT ("=");
+  AtLib_CmdNum (value);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1785,7 +1934,9 @@ AtLibGs_BData (uint8_t mode)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+BDATA=" _F8_ "\r\n", mode);
+  ATLIB_CMD_START ("AT+BDATA=");
+  AtLib_CmdNum (mode);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1815,7 +1966,7 @@ AtLibGs_StartWPSPUSH (void)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+WWPS=1");
+  ATLIB_CMD_START ("AT+WWPS=1");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1845,7 +1996,8 @@ AtLibGs_StartWPSPIN (int8_t * pin)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+WWPS=2,%s", pin);
+  ATLIB_CMD_START ("AT+WWPS=2,");
+  AtLib_CmdStr ((const char *) pin);
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1869,7 +2021,9 @@ AtLibGs_StartFirmwareUpdate (HOST_APP_FWUPDATE_MODE_E fwupMode)
 {
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+SOTAFWUPSTART=%d\r\n", fwupMode);
+  ATLIB_CMD_START ("AT+SOTAFWUPSTART=");
+  AtLib_CmdNum (fwupMode);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   AtLib_CommandSendNoResponse ();
@@ -1895,7 +2049,11 @@ AtLibGs_SetHttpConf (HOST_APP_HTTPCONF_PARAM_E parameter, char *value)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+HTTPCONF=%d,%s\r\n", parameter, value);
+  ATLIB_CMD_START ("AT+HTTPCONF=");
+  AtLib_CmdNum (parameter);
+  ATLIB_CMD_LIT (",");
+  AtLib_CmdStr (value);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1909,7 +2067,11 @@ AtLibGs_SetFirmwareConf (HOST_APP_FWUP_CONF_PARAM_E parameter, char *value)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+SOTAFWUPCONF=%d,%s\r\n", parameter, value);
+  ATLIB_CMD_START ("AT+SOTAFWUPCONF=");
+  AtLib_CmdNum (parameter);
+  ATLIB_CMD_LIT (",");
+  AtLib_CmdStr (value);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1923,7 +2085,11 @@ AtLibGs_StartProv (char *username, char *password)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+WEBPROV=%s,%s\r\n", username, password);
+  ATLIB_CMD_START ("AT+WEBPROV=");
+  AtLib_CmdStr (username);
+  ATLIB_CMD_LIT (",");
+  AtLib_CmdStr (password);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1937,7 +2103,9 @@ AtLibGs_SetDHCPServerMode (int8_t mode)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+DHCPSRVR=" _F8_ "\r\n", mode);
+  ATLIB_CMD_START ("AT+DHCPSRVR=");
+  AtLib_CmdNum (mode);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1951,7 +2119,11 @@ AtLibGs_SetDNSServerMode (int8_t mode, char *url)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+DNS=" _F8_ ",%s\r\n", mode, url);
+  ATLIB_CMD_START ("AT+DNS=");
+  AtLib_CmdNum (mode);
+  ATLIB_CMD_LIT (",");
+  AtLib_CmdStr (url);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1965,7 +2137,11 @@ AtLibGs_SetWepKey (int8_t keyIndex, char *key)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+WWEP" _F8_ "=,%s\r\n", keyIndex, key);
+  ATLIB_CMD_START ("AT+WWEP");
+  AtLib_CmdNum (keyIndex);
+  ATLIB_CMD_LIT ("=,");
+  AtLib_CmdStr (key);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1979,7 +2155,9 @@ AtLibGs_SetAuthMode (int8_t secMode)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+WAUTH=" _F8_ "\r\n", secMode);
+  ATLIB_CMD_START ("AT+WAUTH=");
+  AtLib_CmdNum (secMode);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -1993,7 +2171,9 @@ AtLibGs_SetSecurity (int8_t secMode)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+WSEC=" _F8_ "\r\n", secMode);
+  ATLIB_CMD_START ("AT+WSEC=");
+  AtLib_CmdNum (secMode);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -2007,7 +2187,7 @@ AtLibGs_Reset (void)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+RESET\r\n");
+  ATLIB_CMD_START ("AT+RESET\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -2606,6 +2786,44 @@ AtLib_GetUdpServerClientConnection (char *clientIp, char *clientPort)
   return 1;
 }
 
+/*-------------------------------------------------------------------------*
+ * Command queue:
+ *-------------------------------------------------------------------------*/
+/* Module handles one command at a time, so one command is in flight and
+   the next one is sent as soon as its response arrives. */
+typedef struct
+{
+  char cmd[ATLIB_CMD_QUEUE_CMD_SIZE];
+  uint8_t cmdLen;
+  bool last;			/* last command of the batch */
+  uint32_t timeout;		/* ms, from sending the command */
+  ATLIB_CMD_CALLBACK_T callback;
+  void *pArg;
+} ATLIB_CMD_QUEUE_ENTRY_T;
+
+static ATLIB_CMD_QUEUE_ENTRY_T cmdQueue[ATLIB_CMD_QUEUE_SIZE];
+static uint8_t cmdQueueHead = 0;	/* command in flight or the next to send */
+static uint8_t cmdQueueCount = 0;
+static bool cmdInFlight = false;
+static uint64_t cmdSendTime;
+
+static bool cmdQueueOpen = false;	/* batch is being queued */
+static bool cmdBatchFailed;
+static uint8_t cmdBatchCount;
+static uint32_t cmdBatchTimeout;
+static ATLIB_CMD_CALLBACK_T cmdBatchCallback;
+static void *cmdBatchArg;
+
+static ATLIB_CMD_STATS_T cmdStats[ATLIB_CMD_STATS_SIZE];
+static uint8_t cmdStatsCount = 0;
+
+static HOST_APP_MSG_ID_E AtLib_CommandQueueAdd (void);
+static void AtLib_CommandQueueComplete (HOST_APP_MSG_ID_E rxMsgId);
+static ATLIB_CMD_STATS_T *AtLib_CommandStatsFind (const char *pCmd);
+static void AtLib_CommandStatsUpdate (ATLIB_CMD_STATS_T * pStats,
+				      HOST_APP_MSG_ID_E rxMsgId,
+				      uint32_t time);
+
 /*---------------------------------------------------------------------------*
  * Routine:  AtLib_CommandSend
  *---------------------------------------------------------------------------*
@@ -2621,17 +2839,32 @@ HOST_APP_MSG_ID_E
 AtLib_CommandSend (void)
 {
   HOST_APP_MSG_ID_E rxMsgId;
+  ATLIB_CMD_STATS_T *pStats;
+  uint64_t sendTime;
 
 #ifdef HOST_APP_DEBUG_ENABLE
 //  GS_API_Printf (">%s", G_ATCmdBuf);
 #endif
 
+  /* Between AtLib_CommandQueueStart and End commands are only queued */
+  if (cmdQueueOpen)
+    return AtLib_CommandQueueAdd ();
+
+  /* Keep the order, commands queued before are sent first */
+  AtLib_CommandQueueWait ();
+
+  /* Command buffer may be reused while waiting for response */
+  pStats = AtLib_CommandStatsFind (G_ATCmdBuf);
+  sendTime = MSTimerGet ();
+
   /* Now send the command to S2w App node */
-  GS_HAL_send ((uint8_t *) & G_ATCmdBuf[0], strlen ((const char *) G_ATCmdBuf));
+  GS_HAL_send ((uint8_t *) & G_ATCmdBuf[0], G_ATCmdLen);
 
   /* Wait for the response while collecting data into the MRBuffer */
   rxMsgId = AtLib_ResponseHandle ();
 
+  AtLib_CommandStatsUpdate (pStats, rxMsgId, MSTimerDelta (sendTime));
+
   return rxMsgId;
 }
 
@@ -2654,7 +2887,350 @@ AtLib_CommandSendNoResponse (void)
 #endif
 
   /* Send the command to S2w App node */
-  GS_HAL_send ((uint8_t *) & G_ATCmdBuf[0], strlen ((const char *) G_ATCmdBuf));
+  GS_HAL_send ((uint8_t *) & G_ATCmdBuf[0], G_ATCmdLen);
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_CommandQueueStart
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Start a batch of queued commands.  Until AtLib_CommandQueueEnd,
+ *      AtLib_CommandSend (and all AtLibGs_ commands using it) only copies
+ *      the command into the queue and returns HOST_APP_MSG_ID_OK, or
+ *      HOST_APP_MSG_ID_ERROR if it does not fit.  Queued commands are sent
+ *      one after another by AtLib_CommandQueueTask.
+ * Inputs:
+ *      uint32_t timeout -- ms to wait for response of each command
+ *      ATLIB_CMD_CALLBACK_T callback -- called when batch is done (may be
+ *          NULL)
+ *      void *pArg -- passed to callback
+ * Outputs:
+ *      void
+ *---------------------------------------------------------------------------*/
+void
+AtLib_CommandQueueStart (uint32_t timeout, ATLIB_CMD_CALLBACK_T callback,
+			 void *pArg)
+{
+  cmdQueueOpen = true;
+  cmdBatchFailed = false;
+  cmdBatchCount = 0;
+  cmdBatchTimeout = timeout;
+  cmdBatchCallback = callback;
+  cmdBatchArg = pArg;
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_CommandQueueEnd
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      End a batch of queued commands.  If any command of the batch could
+ *      not be queued, the whole batch is dropped.
+ * Inputs:
+ *      void
+ * Outputs:
+ *      bool -- true if batch is queued
+ *---------------------------------------------------------------------------*/
+bool
+AtLib_CommandQueueEnd (void)
+{
+  cmdQueueOpen = false;
+
+  if (cmdBatchFailed)
+    {
+      /* Nothing was sent since the batch was started */
+      cmdQueueCount -= cmdBatchCount;
+      if (cmdBatchCallback)
+	cmdBatchCallback (HOST_APP_MSG_ID_ERROR, cmdBatchArg);
+      return false;
+    }
+
+  if (cmdBatchCount == 0)
+    {
+      if (cmdBatchCallback)
+	cmdBatchCallback (HOST_APP_MSG_ID_OK, cmdBatchArg);
+      return true;
+    }
+
+  cmdQueue[(cmdQueueHead + cmdQueueCount - 1) % ATLIB_CMD_QUEUE_SIZE].last =
+    true;
+
+  return true;
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_CommandQueueResponse
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Offer a received message to the command in flight.  Responses come
+ *      in the order of commands, so any command response completes it.
+ *      Data transfer responses and incoming data are not for it.
+ * Inputs:
+ *      HOST_APP_MSG_ID_E rxMsgId -- received message
+ * Outputs:
+ *      bool -- true if the message was the response of queued command
+ *---------------------------------------------------------------------------*/
+bool
+AtLib_CommandQueueResponse (HOST_APP_MSG_ID_E rxMsgId)
+{
+  if (!cmdInFlight)
+    return false;
+
+  switch (rxMsgId)
+    {
+    case HOST_APP_MSG_ID_NONE:
+    case HOST_APP_MSG_ID_ESC_CMD_OK:
+    case HOST_APP_MSG_ID_ESC_CMD_FAIL:
+    case HOST_APP_MSG_ID_BULK_DATA_RX:
+    case HOST_APP_MSG_ID_DATA_RX:
+    case HOST_APP_MSG_ID_RAW_DATA_RX:
+    case HOST_APP_MSG_ID_HTTP_RESPONSE_DATA_RX:
+    case HOST_APP_MSG_ID_TCP_SERVER_CLIENT_CONNECTION:
+      return false;
+
+    default:
+      AtLib_CommandQueueComplete (rxMsgId);
+      return true;
+    }
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_CommandQueueTask
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Check the deadline of the command in flight and send the next
+ *      queued command when module is free.  Responses should be passed to
+ *      AtLib_CommandQueueResponse before.  Does not block.
+ * Inputs:
+ *      void
+ * Outputs:
+ *      void
+ *---------------------------------------------------------------------------*/
+void
+AtLib_CommandQueueTask (void)
+{
+  ATLIB_CMD_QUEUE_ENTRY_T *pEntry = &cmdQueue[cmdQueueHead];
+
+  if (cmdInFlight)
+    {
+      if (MSTimerDelta (cmdSendTime) < pEntry->timeout)
+	return;
+
+      AtLib_CommandQueueComplete (HOST_APP_MSG_ID_RESPONSE_TIMEOUT);
+      pEntry = &cmdQueue[cmdQueueHead];
+    }
+
+  if ((cmdQueueCount == 0) || cmdQueueOpen)
+    return;
+
+  /* Reset the receive buffer, response is collected into it */
+  AtLib_FlushRxBuffer ();
+
+  GS_HAL_send ((uint8_t *) pEntry->cmd, pEntry->cmdLen);
+  cmdSendTime = MSTimerGet ();
+  cmdInFlight = true;
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_CommandQueueWait
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Block until all queued commands are done.  Other messages received
+ *      meanwhile are dropped, as in AtLib_ResponseHandle.
+ * Inputs:
+ *      void
+ * Outputs:
+ *      void
+ *---------------------------------------------------------------------------*/
+void
+AtLib_CommandQueueWait (void)
+{
+  while (cmdQueueCount && !cmdQueueOpen)
+    {
+      AtLib_CommandQueueResponse (AtLib_ReceiveChunk (NULL));
+      AtLib_CommandQueueTask ();
+    }
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_CommandQueueIdle
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Check if all queued commands are done.
+ * Inputs:
+ *      void
+ * Outputs:
+ *      bool -- true if nothing is queued
+ *---------------------------------------------------------------------------*/
+bool
+AtLib_CommandQueueIdle (void)
+{
+  return (cmdQueueCount == 0);
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_GetCommandStats
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Get latency statistics of AT commands sent so far, queued or not.
+ * Inputs:
+ *      const ATLIB_CMD_STATS_T **ppStats -- set to statistics table
+ * Outputs:
+ *      uint8_t -- number of commands in the table
+ *---------------------------------------------------------------------------*/
+uint8_t
+AtLib_GetCommandStats (const ATLIB_CMD_STATS_T ** ppStats)
+{
+  *ppStats = cmdStats;
+
+  return cmdStatsCount;
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_CommandQueueAdd
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Copy the command from G_ATCmdBuf into the queue, as part of the
+ *      current batch.
+ * Inputs:
+ *      void
+ * Outputs:
+ *      HOST_APP_MSG_ID_E -- HOST_APP_MSG_ID_OK if queued
+ *---------------------------------------------------------------------------*/
+static HOST_APP_MSG_ID_E
+AtLib_CommandQueueAdd (void)
+{
+  ATLIB_CMD_QUEUE_ENTRY_T *pEntry;
+  uint32_t len = G_ATCmdLen;
+
+  if ((cmdQueueCount == ATLIB_CMD_QUEUE_SIZE)
+      || (len > ATLIB_CMD_QUEUE_CMD_SIZE) || cmdBatchFailed)
+    {
+      cmdBatchFailed = true;
+      return HOST_APP_MSG_ID_ERROR;
+    }
+
+  pEntry = &cmdQueue[(cmdQueueHead + cmdQueueCount) % ATLIB_CMD_QUEUE_SIZE];
+  memcpy (pEntry->cmd, G_ATCmdBuf, len);
+  pEntry->cmdLen = len;
+  pEntry->last = false;
+  pEntry->timeout = cmdBatchTimeout;
+  pEntry->callback = cmdBatchCallback;
+  pEntry->pArg = cmdBatchArg;
+
+  cmdQueueCount++;
+  cmdBatchCount++;
+
+  return HOST_APP_MSG_ID_OK;
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_CommandQueueComplete
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Finish the command in flight.  If it failed, the rest of its batch
+ *      is dropped.  Callback is called when the batch is done.
+ * Inputs:
+ *      HOST_APP_MSG_ID_E rxMsgId -- response of the command
+ * Outputs:
+ *      void
+ *---------------------------------------------------------------------------*/
+static void
+AtLib_CommandQueueComplete (HOST_APP_MSG_ID_E rxMsgId)
+{
+  ATLIB_CMD_QUEUE_ENTRY_T *pEntry = &cmdQueue[cmdQueueHead];
+  ATLIB_CMD_CALLBACK_T callback = pEntry->callback;
+  void *pArg = pEntry->pArg;
+  bool last;
+
+  /* Command in the queue is not NULL terminated, name ends before CR */
+  AtLib_CommandStatsUpdate (AtLib_CommandStatsFind (pEntry->cmd), rxMsgId,
+			    MSTimerDelta (cmdSendTime));
+
+  cmdInFlight = false;
+  do
+    {
+      last = cmdQueue[cmdQueueHead].last;
+      cmdQueueHead = (cmdQueueHead + 1) % ATLIB_CMD_QUEUE_SIZE;
+      cmdQueueCount--;
+    }
+  while ((HOST_APP_MSG_ID_OK != rxMsgId) && !last && cmdQueueCount);
+
+  if (last && callback)
+    callback (rxMsgId, pArg);
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_CommandStatsFind
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Find (or add) statistics of the command.  Commands are told apart
+ *      by the name, parameters are not taken into account.
+ * Inputs:
+ *      const char *pCmd -- AT command
+ * Outputs:
+ *      ATLIB_CMD_STATS_T * -- statistics, NULL if the table is full
+ *---------------------------------------------------------------------------*/
+static ATLIB_CMD_STATS_T *
+AtLib_CommandStatsFind (const char *pCmd)
+{
+  char name[ATLIB_CMD_NAME_SIZE];
+  uint8_t i = 0;
+
+  while ((*pCmd == HOST_APP_CR_CHAR) || (*pCmd == HOST_APP_LF_CHAR))
+    pCmd++;
+
+  while ((i < ATLIB_CMD_NAME_SIZE - 1) && (pCmd[i] > ' ')
+	 && (pCmd[i] != '=') && (pCmd[i] != ','))
+    {
+      name[i] = pCmd[i];
+      i++;
+    }
+  name[i] = '\0';
+
+  for (i = 0; i < cmdStatsCount; i++)
+    {
+      if (strcmp (cmdStats[i].name, name) == 0)
+	return &cmdStats[i];
+    }
+
+  if (cmdStatsCount == ATLIB_CMD_STATS_SIZE)
+    return NULL;
+
+  memset (&cmdStats[cmdStatsCount], 0, sizeof (ATLIB_CMD_STATS_T));
+  strcpy (cmdStats[cmdStatsCount].name, name);
+
+  return &cmdStats[cmdStatsCount++];
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_CommandStatsUpdate
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Account one command response in command statistics.
+ * Inputs:
+ *      ATLIB_CMD_STATS_T *pStats -- statistics of the command (may be NULL)
+ *      HOST_APP_MSG_ID_E rxMsgId -- response of the command
+ *      uint32_t time -- ms from sending the command to response
+ * Outputs:
+ *      void
+ *---------------------------------------------------------------------------*/
+static void
+AtLib_CommandStatsUpdate (ATLIB_CMD_STATS_T * pStats,
+			  HOST_APP_MSG_ID_E rxMsgId, uint32_t time)
+{
+  if (pStats == NULL)
+    return;
+
+  pStats->count++;
+  if (HOST_APP_MSG_ID_RESPONSE_TIMEOUT == rxMsgId)
+    pStats->timeouts++;
+  else if (HOST_APP_MSG_ID_OK != rxMsgId)
+    pStats->errors++;
+
+  pStats->lastTime = time;
+  pStats->totalTime += time;
+  if (time > pStats->maxTime)
+    pStats->maxTime = time;
 }
 
 
@@ -2700,20 +3276,21 @@ AtLib_SendTcpData (uint8_t cid, const uint8_t * txBuf, uint32_t dataLen)
   if (HOST_APP_INVALID_CID != cid)
     {
       HOST_APP_MSG_ID_E rxMsgId;
+      uint8_t header[sizeof (AtLib_DataStartTemplate)];
+
       /* Construct the data start indication message */
-      sprintf (G_ATCmdBuf, "%c%c%c", HOST_APP_ESC_CHAR, 'S', cid);
+      memcpy (header, AtLib_DataStartTemplate, sizeof (header));
+      header[2] = cid;
 
-      /* Now send the data START indication message  to S2w node */ GS_HAL_send (
-										(uint8_t *) & G_ATCmdBuf[0], 3);
+      /* Now send the data START indication message  to S2w node */
+      GS_HAL_send (header, sizeof (header));
 
       /* Now send the actual data */
       AtLib_DataSend (txBuf, dataLen);
 
-      /* Construct the data end indication message */
-      sprintf (G_ATCmdBuf, "%c%c\r\n", HOST_APP_ESC_CHAR, 'E');
-
       /* Now send the data END indication message  to S2w node */
-      GS_HAL_send ((uint8_t *) & G_ATCmdBuf[0], 2);
+      GS_HAL_send ((uint8_t *) AtLib_DataEndTemplate,
+		   sizeof (AtLib_DataEndTemplate));
 
       rxMsgId = AtLib_ResponseHandle ();
 
@@ -2769,26 +3346,31 @@ AtLib_SendUdpData (uint8_t cid, const uint8_t * txBuf, uint32_t dataLen,
       if (HOST_APP_CON_UDP_SERVER == conType)
 	{
 	  /* <ESC> < U>  <cid> <ip address><:> <port numer><:> <data> <ESC> < E> */
-	  sprintf (G_ATCmdBuf, "%c%c%c%s:" _F16_ ":", HOST_APP_ESC_CHAR, 'U',
-		   cid, pUdpClientIP, udpClientPort);
+	  ATLIB_CMD_START (HOST_APP_ESC_STR "U");
+	  AtLib_CmdChar (cid);
+	  AtLib_CmdStr ((const char *) pUdpClientIP);
+	  ATLIB_CMD_LIT (":");
+	  AtLib_CmdNum (udpClientPort);
+	  ATLIB_CMD_LIT (":");
 	}
       else
 	{
 	  /* <ESC> < S>  <cid>  <data> <ESC> < E> */
-	  sprintf (G_ATCmdBuf, "%c%c%c", HOST_APP_ESC_CHAR, 'S', cid);
+	  ATLIB_CMD_START (HOST_APP_ESC_STR "S");
+	  AtLib_CmdChar (cid);
 	}
 
-      /* Now send the data START indication message  to S2w node */ GS_HAL_send (
-										(uint8_t *) & G_ATCmdBuf[0], strlen (G_ATCmdBuf));
+      /* Now send the data START indication message  to S2w node */
+      GS_HAL_send ((uint8_t *) & G_ATCmdBuf[0], G_ATCmdLen);
 
       /* Now send the actual data */
       AtLib_DataSend (txBuf, dataLen);
 
-      /* Construct the data start indication message  */
-      sprintf (G_ATCmdBuf, "%c%c\r\n", HOST_APP_ESC_CHAR, 'E');
+      /* Construct the data end indication message  */
+      ATLIB_CMD_START (HOST_APP_ESC_STR "E\r\n");
 
       /* Now send the data END indication message  to S2w node */
-      GS_HAL_send ((uint8_t *) & G_ATCmdBuf[0], strlen (G_ATCmdBuf));
+      GS_HAL_send ((uint8_t *) & G_ATCmdBuf[0], G_ATCmdLen);
     }
 }
 
@@ -2805,6 +3387,8 @@ AtLib_SendUdpData (uint8_t cid, const uint8_t * txBuf, uint32_t dataLen,
  *      <data length> is 4 ASCII characters with the data length
  *      <N bytes> is a number of bytes, <= 1400 bytes
  *      <'E'> is the letter 'E'
+ *      Data is not escaped, so binary data (with ESC bytes in it) is sent
+ *      as it is.  Longer data is split into several transfers.
  * Inputs:
  *      uint8_t cid -- Connection ID
  *      const uint8_t *pTxData -- Data to send to the TCP connection
@@ -2814,22 +3398,90 @@ AtLib_SendUdpData (uint8_t cid, const uint8_t * txBuf, uint32_t dataLen,
  *---------------------------------------------------------------------------*/
 HOST_APP_MSG_ID_E
 AtLib_BulkDataTransfer (uint8_t cid, const uint8_t * pData, uint32_t dataLen)
+{
+  ATLIB_DATA_SPAN_T span;
+
+  span.pData = pData;
+  span.dataLen = dataLen;
+
+  return AtLib_BulkDataTransferSpans (cid, &span, 1);
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_BulkDataTransferSpans
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Send bulk data gathered from several buffers as one bulk data
+ *      transfer (see AtLib_BulkDataTransfer).  Each span is sent to the
+ *      UART straight from its buffer, so data does not have to be copied
+ *      into one contiguous buffer first.  Data longer than
+ *      HOST_APP_BULK_DATA_MAX_SIZE is split into several transfers, each
+ *      one waiting for its response; sending stops at the first failure.
+ * Inputs:
+ *      uint8_t cid -- Connection ID
+ *      const ATLIB_DATA_SPAN_T *pSpans -- Pieces of data to send
+ *      uint8_t numSpans -- Number of pieces
+ * Outputs:
+ *      HOST_APP_MSG_ID_E -- response type
+ *---------------------------------------------------------------------------*/
+HOST_APP_MSG_ID_E
+AtLib_BulkDataTransferSpans (uint8_t cid, const ATLIB_DATA_SPAN_T * pSpans,
+			     uint8_t numSpans)
 {
   /*<Esc> <Z> <Cid> <Data Length xxxx 4 ascii char> <data> */
-  int8_t digits[5];
+  uint8_t header[sizeof (AtLib_BulkStartTemplate) + 1];
+  HOST_APP_MSG_ID_E rxMsgId = HOST_APP_MSG_ID_ESC_CMD_OK;
+  uint32_t dataLen = 0;
+  uint32_t chunkLen;
+  uint32_t partLen;
+  uint32_t offset = 0;
+  uint8_t i;
+
+  for (i = 0; i < numSpans; i++)
+    dataLen += pSpans[i].dataLen;
+
+  memcpy (header, AtLib_BulkStartTemplate, sizeof (AtLib_BulkStartTemplate));
+  header[2] = cid;
+
+  i = 0;
+  while (dataLen)
+    {
+      chunkLen = (dataLen < HOST_APP_BULK_DATA_MAX_SIZE) ?
+	dataLen : HOST_APP_BULK_DATA_MAX_SIZE;
+      dataLen -= chunkLen;
 
-  /* Construct the bulk data start indication message  */
-  AtLib_ConvertNumberTo4DigitASCII (dataLen, digits);
-  sprintf (&(G_ATCmdBuf[0]), "%c%c%c%s", HOST_APP_ESC_CHAR, 'Z', cid, digits);
+      /* Only the length differs between the bulk data START messages */
+      AtLib_ConvertNumberTo4DigitASCII (chunkLen, (int8_t *) & header[3]);
 
-  /* Now send the bulk data START indication message  to S2w node */
-  GS_HAL_send ((uint8_t *) & G_ATCmdBuf[0], strlen (G_ATCmdBuf));
+      /* Now send the bulk data START indication message  to S2w node */
+      GS_HAL_send (header, sizeof (AtLib_BulkStartTemplate));
 
-  /* Now send the actual data */
-  GS_HAL_send ((uint8_t *) pData, dataLen);
+      /* Now send the actual data, piece by piece */
+      while (chunkLen)
+	{
+	  partLen = pSpans[i].dataLen - offset;
+	  if (partLen > chunkLen)
+	    partLen = chunkLen;
+
+	  if (partLen)
+	    GS_HAL_send ((uint8_t *) pSpans[i].pData + offset, partLen);
+
+	  chunkLen -= partLen;
+	  offset += partLen;
+	  if (offset == pSpans[i].dataLen)
+	    {
+	      offset = 0;
+	      i++;
+	    }
+	}
+
+      rxMsgId = AtLib_ResponseHandle ();
+      if (rxMsgId != HOST_APP_MSG_ID_ESC_CMD_OK)
+	break;
+    }
 
   /* Return the response */
-  return AtLib_ResponseHandle ();
+  return rxMsgId;
 }
 
 /*---------------------------------------------------------------------------*
@@ -2872,11 +3524,16 @@ AtLib_UdpServerBulkDataTransfer (uint8_t cid, char *ipAddress, char *port,
 
   /* Construct the bulk data start indication message  */
   AtLib_ConvertNumberTo4DigitASCII (dataLen, digits);
-  sprintf (&(G_ATCmdBuf[0]), "%c%c%c%s:%s:%s", HOST_APP_ESC_CHAR, 'Y', cid,
-	   ipAddress, port, digits);
+  ATLIB_CMD_START (HOST_APP_ESC_STR "Y");
+  AtLib_CmdChar (cid);
+  AtLib_CmdStr (ipAddress);
+  ATLIB_CMD_LIT (":");
+  AtLib_CmdStr (port);
+  ATLIB_CMD_LIT (":");
+  AtLib_CmdStr ((const char *) digits);
 
   /* Now send the bulk data START indication message  to S2w node */
-  GS_HAL_send ((uint8_t *) & G_ATCmdBuf[0], strlen (G_ATCmdBuf));
+  GS_HAL_send ((uint8_t *) & G_ATCmdBuf[0], G_ATCmdLen);
 
   /* Now send the actual data */
   GS_HAL_send ((uint8_t *) pData, dataLen);
@@ -2885,27 +3542,131 @@ AtLib_UdpServerBulkDataTransfer (uint8_t cid, char *ipAddress, char *port,
   return AtLib_ResponseHandle ();
 }
 
+/* CID of hex digit characters, plus one, so zero marks invalid characters */
+static const uint8_t AtLib_CidTable[128] = {
+  ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+  ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+  ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+  ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+};
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_getCidFromAscii
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Convert CID character (hex digit) to number.
+ * Inputs:
+ *      uint8_t cidAscii -- CID character
+ * Outputs:
+ *      uint8_t -- CID, HOST_APP_INVALID_CID if character is not hex digit
+ *---------------------------------------------------------------------------*/
 uint8_t
 AtLib_getCidFromAscii (uint8_t cidAscii)
 {
-  unsigned int temp;
-  uint8_t cid = HOST_APP_INVALID_CID;
-  uint8_t cidStr[] = "00";
-  cidStr[1] = cidAscii;
-
-  sscanf ((const char *) cidStr, "%x", (unsigned int *) &temp);
+  if ((cidAscii >= sizeof (AtLib_CidTable)) || (AtLib_CidTable[cidAscii] == 0))
+    return HOST_APP_INVALID_CID;
 
-  cid = (uint8_t) temp;
-  return (uint8_t) cid;
+  return AtLib_CidTable[cidAscii] - 1;
 }
 
 
+/*---------------------------------------------------------------------------*
+ * Response line table for AtLib_checkEOFMessage
+ *---------------------------------------------------------------------------*
+ * Entries are in priority order: when several of them are found in one
+ * line, the first one wins (same as the former chain of strstr calls).
+ * AtLib_EofFirstChar maps the first character of the entries to a mask of
+ * entries, so the line is scanned only once and the entries are compared
+ * only where they can start.  Keep both tables in sync when adding lines.
+ *---------------------------------------------------------------------------*/
+typedef enum
+{
+  ATLIB_EOF_OK,
+  ATLIB_EOF_INVALID_INPUT,
+  ATLIB_EOF_DISASSOCIATED,
+  ATLIB_EOF_IP_CONFIG_FAIL,
+  ATLIB_EOF_SOCKET_FAIL,
+  ATLIB_EOF_ERROR,
+  ATLIB_EOF_APP_RESET,
+  ATLIB_EOF_FW_UPDATE_OK,
+  ATLIB_EOF_DISCONNECT,
+  ATLIB_EOF_DISASSOCIATION_EVENT,
+  ATLIB_EOF_OUT_OF_STBY_ALARM,
+  ATLIB_EOF_OUT_OF_STBY_TIMER,
+  ATLIB_EOF_UNEXPECTED_WARM_BOOT,
+  ATLIB_EOF_OUT_OF_DEEP_SLEEP,
+  ATLIB_EOF_WELCOME_MSG,
+  ATLIB_EOF_CONNECT,
+  ATLIB_EOF_COUNT
+} ATLIB_EOF_E;
+
+#define ATLIB_EOF_BIT(e)                (1UL << (e))
+
+/* side effects of the response line, applied in this order */
+#define ATLIB_EOF_CLEAR_ASSOCIATION     0x01
+#define ATLIB_EOF_SET_RESET             0x02
+#define ATLIB_EOF_CLEAR_CID             0x04
+
+/* "CONNECT 0 1 192.168.100.200 65535" - only counts if line is long enough */
+#define ATLIB_EOF_CONNECT_MIN_LEN       21
+
+typedef struct
+{
+  const char *str;
+  uint8_t len;
+  uint8_t actions;
+  HOST_APP_MSG_ID_E msgId;
+} ATLIB_EOF_MSG_T;
+
+static const ATLIB_EOF_MSG_T AtLib_EofMsg[ATLIB_EOF_COUNT] = {
+  [ATLIB_EOF_OK] = {"OK", 2, 0, HOST_APP_MSG_ID_OK},
+  [ATLIB_EOF_INVALID_INPUT] = {"ERROR: INVALID INPUT", 20, 0, HOST_APP_MSG_ID_INVALID_INPUT},
+  [ATLIB_EOF_DISASSOCIATED] = {"DISASSOCIATED", 13, ATLIB_EOF_CLEAR_ASSOCIATION | ATLIB_EOF_CLEAR_CID,
+                               HOST_APP_MSG_ID_DISASSOCIATION_EVENT},
+  [ATLIB_EOF_IP_CONFIG_FAIL] = {"ERROR: IP CONFIG FAIL", 21, 0, HOST_APP_MSG_ID_ERROR_IP_CONFIG_FAIL},
+  [ATLIB_EOF_SOCKET_FAIL] = {"ERROR: SOCKET FAILURE", 21, ATLIB_EOF_CLEAR_CID, HOST_APP_MSG_ID_ERROR_SOCKET_FAIL},
+  [ATLIB_EOF_ERROR] = {"ERROR", 5, 0, HOST_APP_MSG_ID_ERROR},
+  [ATLIB_EOF_APP_RESET] = {"APP Reset-APP SW Reset", 22,
+                           ATLIB_EOF_CLEAR_ASSOCIATION | ATLIB_EOF_SET_RESET | ATLIB_EOF_CLEAR_CID,
+                           HOST_APP_MSG_ID_APP_RESET},
+  [ATLIB_EOF_FW_UPDATE_OK] = {"APP Reset External Flash FW-UP-SUCCESS", 38,
+                              ATLIB_EOF_CLEAR_ASSOCIATION | ATLIB_EOF_SET_RESET | ATLIB_EOF_CLEAR_CID,
+                              HOST_APP_MSG_ID_FW_UPDATE_OK},
+  [ATLIB_EOF_DISCONNECT] = {"DISCONNECT", 10, ATLIB_EOF_CLEAR_CID, HOST_APP_MSG_ID_DISCONNECT},
+  [ATLIB_EOF_DISASSOCIATION_EVENT] = {"Disassociation Event", 20, ATLIB_EOF_CLEAR_ASSOCIATION | ATLIB_EOF_CLEAR_CID,
+                                      HOST_APP_MSG_ID_DISASSOCIATION_EVENT},
+  [ATLIB_EOF_OUT_OF_STBY_ALARM] = {"Out of StandBy-Alarm", 20, 0, HOST_APP_MSG_ID_OUT_OF_STBY_ALARM},
+  [ATLIB_EOF_OUT_OF_STBY_TIMER] = {"Out of StandBy-Timer", 20, 0, HOST_APP_MSG_ID_OUT_OF_STBY_TIMER},
+  [ATLIB_EOF_UNEXPECTED_WARM_BOOT] = {"UnExpected Warm Boot", 20,
+                                      ATLIB_EOF_CLEAR_ASSOCIATION | ATLIB_EOF_SET_RESET | ATLIB_EOF_CLEAR_CID,
+                                      HOST_APP_MSG_ID_UNEXPECTED_WARM_BOOT},
+  [ATLIB_EOF_OUT_OF_DEEP_SLEEP] = {"Out of Deep Sleep", 17, 0, HOST_APP_MSG_ID_OUT_OF_DEEP_SLEEP},
+  [ATLIB_EOF_WELCOME_MSG] = {"Serial2WiFi APP", 15,
+                             ATLIB_EOF_CLEAR_ASSOCIATION | ATLIB_EOF_SET_RESET | ATLIB_EOF_CLEAR_CID,
+                             HOST_APP_MSG_ID_WELCOME_MSG},
+  [ATLIB_EOF_CONNECT] = {"CONNECT ", 8, 0, HOST_APP_MSG_ID_TCP_SERVER_CLIENT_CONNECTION},
+};
+
+static const uint32_t AtLib_EofFirstChar[128] = {
+  ['O'] = ATLIB_EOF_BIT (ATLIB_EOF_OK) | ATLIB_EOF_BIT (ATLIB_EOF_OUT_OF_STBY_ALARM) |
+          ATLIB_EOF_BIT (ATLIB_EOF_OUT_OF_STBY_TIMER) | ATLIB_EOF_BIT (ATLIB_EOF_OUT_OF_DEEP_SLEEP),
+  ['E'] = ATLIB_EOF_BIT (ATLIB_EOF_INVALID_INPUT) | ATLIB_EOF_BIT (ATLIB_EOF_IP_CONFIG_FAIL) |
+          ATLIB_EOF_BIT (ATLIB_EOF_SOCKET_FAIL) | ATLIB_EOF_BIT (ATLIB_EOF_ERROR),
+  ['D'] = ATLIB_EOF_BIT (ATLIB_EOF_DISASSOCIATED) | ATLIB_EOF_BIT (ATLIB_EOF_DISCONNECT) |
+          ATLIB_EOF_BIT (ATLIB_EOF_DISASSOCIATION_EVENT),
+  ['A'] = ATLIB_EOF_BIT (ATLIB_EOF_APP_RESET) | ATLIB_EOF_BIT (ATLIB_EOF_FW_UPDATE_OK),
+  ['U'] = ATLIB_EOF_BIT (ATLIB_EOF_UNEXPECTED_WARM_BOOT),
+  ['S'] = ATLIB_EOF_BIT (ATLIB_EOF_WELCOME_MSG),
+  ['C'] = ATLIB_EOF_BIT (ATLIB_EOF_CONNECT),
+};
+
 /*---------------------------------------------------------------------------*
  * Routine:  AtLib_checkEOFMessage
  *---------------------------------------------------------------------------*
  * Description:
  *      This functions is used to check the completion of Commands
  *      This function will be called after receiving each line.
+ *      Line is scanned once, see AtLib_EofMsg for recognized lines.
  * Inputs:
  *      const uint8_t *pBuffer -- Line of data to check
  * Outputs:
@@ -2915,112 +3676,106 @@ AtLib_getCidFromAscii (uint8_t cidAscii)
 HOST_APP_MSG_ID_E
 AtLib_checkEOFMessage (const uint8_t * pBuffer)
 {
+  const uint8_t *p;
+  uint32_t candidates;
+  uint32_t found;
+  unsigned int best = ATLIB_EOF_COUNT;
+  unsigned int i;
+  const ATLIB_EOF_MSG_T *msg;
 
-  if ((strstr ((const char *) pBuffer, "OK") != NULL))
-    {
-      return HOST_APP_MSG_ID_OK;
-    } 
-  else if ((strstr ((const char *) pBuffer, "ERROR: INVALID INPUT") != NULL))
-    {
-      return HOST_APP_MSG_ID_INVALID_INPUT;
-    }
-  else if ((strstr ((const char *) pBuffer, "DISASSOCIATED") != NULL))
-    {
-      /* Reset the local flags */
-      AtLib_ClearNodeAssociationFlag ();
-      AtLib_ClearAllCid ();
-      return HOST_APP_MSG_ID_DISASSOCIATION_EVENT;
-    }
-  else if ((strstr ((const char *) pBuffer, "ERROR: IP CONFIG FAIL") != NULL))
+  /* entries which would win over best match so far */
+  candidates = ATLIB_EOF_BIT (ATLIB_EOF_COUNT) - 1;
+
+  for (p = pBuffer; (*p != '\0') && (candidates != 0); p++)
     {
-      return HOST_APP_MSG_ID_ERROR_IP_CONFIG_FAIL;
-    }
-  else if (strstr ((const char *) pBuffer, "ERROR: SOCKET FAILURE") != NULL)
-    {
-      /* Reset the local flags */
-      AtLib_ClearAllCid ();
-      return HOST_APP_MSG_ID_ERROR_SOCKET_FAIL;
-    }
-  else if ((strstr ((const char *) pBuffer, "ERROR") != NULL))
-    {
-      return HOST_APP_MSG_ID_ERROR;
-    }
-  else if ((strstr ((const char *) pBuffer, "APP Reset-APP SW Reset"))
-	   != NULL)
-    {
-      /* Reset the local flags */
-      AtLib_ClearNodeAssociationFlag ();
-      AtLib_SetNodeResetFlag ();
-      AtLib_ClearAllCid ();
-      return HOST_APP_MSG_ID_APP_RESET;
-    }
-  else
-    if ((strstr
-	 ((const char *) pBuffer,
-	  "APP Reset External Flash FW-UP-SUCCESS")) != NULL)
-    {
-      /* Reset the local flags */
-      AtLib_ClearNodeAssociationFlag ();
-      AtLib_SetNodeResetFlag ();
-      AtLib_ClearAllCid ();
-      return HOST_APP_MSG_ID_FW_UPDATE_OK;
-    }
-  else if (((uint8_t *) strstr ((const char *) pBuffer, "DISCONNECT"))
-	   != NULL)
-    {
-      /* Reset the local flags */
-      AtLib_ClearAllCid ();
-      return HOST_APP_MSG_ID_DISCONNECT;
-    }
-  else if ((strstr ((const char *) pBuffer, "Disassociation Event")) != NULL)
-    {
-      /* reset the association flag */
-      AtLib_ClearNodeAssociationFlag ();
-      AtLib_ClearAllCid ();
-      return HOST_APP_MSG_ID_DISASSOCIATION_EVENT;
-    }
-  else if ((strstr ((const char *) pBuffer, "Out of StandBy-Alarm")) != NULL)
-    {
-      return HOST_APP_MSG_ID_OUT_OF_STBY_ALARM;
-    }
-  else if ((strstr ((const char *) pBuffer, "Out of StandBy-Timer")) != NULL)
-    {
-      return HOST_APP_MSG_ID_OUT_OF_STBY_TIMER;
-    }
-  else if ((strstr ((const char *) pBuffer, "UnExpected Warm Boot")) != NULL)
-    {
-      /* Reset the local flags */
-      AtLib_ClearNodeAssociationFlag ();
-      AtLib_SetNodeResetFlag ();
-      AtLib_ClearAllCid ();
-      return HOST_APP_MSG_ID_UNEXPECTED_WARM_BOOT;
-    }
-  else if ((strstr ((const char *) pBuffer, "Out of Deep Sleep")) != NULL)
-    {
-      return HOST_APP_MSG_ID_OUT_OF_DEEP_SLEEP;
-    }
-  else if ((strstr ((const char *) pBuffer, "Serial2WiFi APP")) != NULL)
-    {
-      /* Reset the local flags */
-      AtLib_ClearNodeAssociationFlag ();
-      AtLib_SetNodeResetFlag ();
-      AtLib_ClearAllCid ();
-      return HOST_APP_MSG_ID_WELCOME_MSG;
-    }
-  else if ((strstr ((const char *) pBuffer, "CONNECT ")) != NULL
-	   && strlen (strstr ((const char *) pBuffer, "CONNECT ")) > 20)
-    {
-      // String is formatted as CONNECT 0 1 192.168.100.200 65535
-      return HOST_APP_MSG_ID_TCP_SERVER_CLIENT_CONNECTION;
-    }
-  else if ((pBuffer[0] == 'A') && (pBuffer[1] == 'T') && (pBuffer[2] == '+'))
-    {				/* Handle the echoed back AT Command, if Echo is enabled.  "AT+" . */
-      return HOST_APP_MSG_ID_NONE;
+      if (*p >= sizeof (AtLib_EofFirstChar) / sizeof (AtLib_EofFirstChar[0]))
+        continue;
+
+      found = AtLib_EofFirstChar[*p] & candidates;
+      while (found != 0)
+        {
+          i = __builtin_ctz (found);
+          found &= found - 1;
+
+          if (strncmp ((const char *) p, AtLib_EofMsg[i].str, AtLib_EofMsg[i].len) != 0)
+            continue;
+
+          /* only the first "CONNECT " counts, as strstr would find it */
+          if ((i == ATLIB_EOF_CONNECT) && (strlen ((const char *) p) < ATLIB_EOF_CONNECT_MIN_LEN))
+            {
+              candidates &= ~ATLIB_EOF_BIT (ATLIB_EOF_CONNECT);
+              continue;
+            }
+
+          best = i;
+          candidates = ATLIB_EOF_BIT (i) - 1;
+          break;
+        }
     }
 
-  return HOST_APP_MSG_ID_NONE;
+  if (best == ATLIB_EOF_COUNT)
+    return HOST_APP_MSG_ID_NONE;
+
+  msg = &AtLib_EofMsg[best];
+
+  /* Reset the local flags */
+  if (msg->actions & ATLIB_EOF_CLEAR_ASSOCIATION)
+    AtLib_ClearNodeAssociationFlag ();
+  if (msg->actions & ATLIB_EOF_SET_RESET)
+    AtLib_SetNodeResetFlag ();
+  if (msg->actions & ATLIB_EOF_CLEAR_CID)
+    AtLib_ClearAllCid ();
+
+  return msg->msgId;
 }
 
+/*---------------------------------------------------------------------------*
+ * Receive state
+ *---------------------------------------------------------------------------*
+ * Received bytes are read from the UART in chunks and parsed by
+ * AtLib_ProcessRxChunk.  Parsing stops after every response message, so
+ * the rest of the chunk stays pending (rxCursor .. rxEnd) and is parsed
+ * first on the next call.  The cursor is shared by all receive routines,
+ * so a response wait started from a data or bulk transfer event (for
+ * example sending an ack from a handler) carries on where the parsing
+ * stopped, and bytes are never processed out of order.
+ *
+ * Connection data handler returns the number of bytes it has taken.  When
+ * it takes less (its buffer is full), parsing stalls: the rest of the data
+ * stays pending and new bytes are left in the UART until the next receive
+ * call, which offers the pending data to the handler again.
+ *---------------------------------------------------------------------------*/
+
+/* position inside data message, after the message type character */
+typedef enum
+{
+  ATLIB_RX_PHASE_CID = 0,	/* connection id */
+  ATLIB_RX_PHASE_IP,		/* udp client ip, terminated by space */
+  ATLIB_RX_PHASE_PORT,		/* udp client port, terminated by tab */
+  ATLIB_RX_PHASE_LEN,		/* ascii data length */
+  ATLIB_RX_PHASE_DATA,		/* data */
+  ATLIB_RX_PHASE_ESC		/* ESC received in <Esc>S / <Esc>u data */
+} ATLIB_RX_PHASE_E;
+
+static HOST_APP_RX_STATE_E receive_state = HOST_APP_RX_STATE_START;
+static ATLIB_RX_PHASE_E rxPhase = ATLIB_RX_PHASE_CID;
+static uint8_t ipCharCount = 0;
+static uint8_t portCharCount = 0;
+static uint32_t specialDataLen = 0;
+static uint8_t rxCurrentCid = 0;
+static uint32_t specialDataLenCharCount = 0;
+static uint8_t rxStalled = 0;	/* handler did not take all data */
+
+static uint8_t rxChunk[HOST_APP_RX_CHUNK_SIZE];
+static const uint8_t *rxCursor = rxChunk;
+static const uint8_t *rxEnd = rxChunk;
+
+static HOST_APP_MSG_ID_E AtLib_ReceiveLine (void);
+static HOST_APP_MSG_ID_E AtLib_ReceiveEscape (void);
+static void AtLib_ReceiveData (void);
+static void AtLib_ReceiveDataStart (void);
+static void AtLib_ReceiveDataEnd (void);
+
 /*---------------------------------------------------------------------------*
  * Routine:  AtLib_ReceiveDataHandle
  *---------------------------------------------------------------------------*
@@ -3035,14 +3790,59 @@ AtLib_checkEOFMessage (const uint8_t * pBuffer)
 void
 AtLib_ReceiveDataHandle (void)
 {
-  uint8_t rxData;
+  /* Read all available data, one chunk at a time - Use non-blocking call */
+  while (AtLib_ReceiveChunk (NULL) != HOST_APP_MSG_ID_NONE)
+    ;
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_ReceiveChunk
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Process received data until a response message is found or there is
+ *      no more data.  Pending bytes of the last chunk are processed first,
+ *      then new chunks are read from the UART (non-blocking).  Reading
+ *      stops while connection data handler does not take pending data.
+ * Inputs:
+ *      uint32_t *pRead -- number of bytes read from the UART is added
+ *          to it (may be NULL)
+ * Outputs:
+ *      HOST_APP_MSG_ID_E -- response type, HOST_APP_MSG_ID_NONE if all
+ *          received data is processed without response message
+ *---------------------------------------------------------------------------*/
+HOST_APP_MSG_ID_E
+AtLib_ReceiveChunk (uint32_t * pRead)
+{
+  HOST_APP_MSG_ID_E rxMsgId = HOST_APP_MSG_ID_NONE;
+  uint32_t len;
+
+  /* Offer data not taken by connection handler once more */
+  rxStalled = 0;
 
-  /* Read one byte at a time - Use non-blocking call */
-  while (GS_HAL_recv (&rxData, 1, 0))
+  while (HOST_APP_MSG_ID_NONE == rxMsgId)
     {
-      /* Process the received data */
-      AtLib_ReceiveDataProcess (rxData);
+      if (rxCursor < rxEnd)
+	{
+	  /* Handler is still full, leave new bytes in the UART */
+	  if (rxStalled)
+	    break;
+
+	  /* Continue with bytes left from last chunk */
+	  rxMsgId = AtLib_ProcessRxChunk (NULL, 0);
+	  continue;
+	}
+
+      len = GS_HAL_recv (rxChunk, sizeof (rxChunk), 0);
+      if (len == 0)
+	break;
+
+      if (pRead != NULL)
+	*pRead += len;
+
+      rxMsgId = AtLib_ProcessRxChunk (rxChunk, len);
     }
+
+  return rxMsgId;
 }
 
 /*---------------------------------------------------------------------------*
@@ -3058,56 +3858,197 @@ AtLib_ReceiveDataHandle (void)
 HOST_APP_MSG_ID_E
 AtLib_ReceiveDataProcess (uint8_t rxData)
 {
-  /* receive data handling state */
-  static HOST_APP_RX_STATE_E receive_state = HOST_APP_RX_STATE_START;
-  static uint8_t ipCharCount = 0;
-  static uint8_t portCharCount = 0;
-  static uint32_t specialDataLen = 0;
-  static uint8_t rxCurrentCid = 0;
-  static uint32_t specialDataLenCharCount = 0;
+  static uint8_t rxByte;
 
-  HOST_APP_MSG_ID_E rxMsgId = HOST_APP_MSG_ID_NONE;
+  rxByte = rxData;
 
-#ifdef HOST_APP_DEBUG_ENABLE
-  //if ((isprint(rxData)) || (isspace(rxData)))
-  // ConsolePrintf("%c", rxData);
-#endif
+  return AtLib_ProcessRxChunk (&rxByte, 1);
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_ResponseHandle
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Wait for a response after sending a command.  Keep parsing the
+ *      data until a response is found.
+ * Inputs:
+ *      void
+ * Outputs:
+ *      HOST_APP_MSG_ID_E -- response type
+ *---------------------------------------------------------------------------*/
+HOST_APP_MSG_ID_E
+AtLib_ResponseHandle (void)
+{
+  HOST_APP_MSG_ID_E responseMsgId;
+  uint64_t timeout = MSTimerGet ();
+  uint32_t read;
+
+  /* Reset the receive buffer */
+  AtLib_FlushRxBuffer ();
+
+  /* Reset the message ID */
+  responseMsgId = HOST_APP_MSG_ID_NONE;
 
-  /* Process the received data */
-  switch (receive_state)
+  /* Now process the response from S2w App node */
+  while (HOST_APP_MSG_ID_NONE == responseMsgId)
     {
-    case HOST_APP_RX_STATE_START:
-      switch (rxData)
+      /* Read available data - non-blocking call, block here */
+      read = 0;
+      responseMsgId = AtLib_ReceiveChunk (&read);
+
+      /* Queued command in flight was sent first, it is answered first */
+      if (AtLib_CommandQueueResponse (responseMsgId))
+	responseMsgId = HOST_APP_MSG_ID_NONE;
+
+      if (read)
 	{
-	case 0:
-	  // Ignore, they mess up strstr
+	  timeout = MSTimerGet ();
+	}
+      else if ((HOST_APP_MSG_ID_NONE == responseMsgId)
+	       && (MSTimerDelta (timeout) >= AtLib_Response_Handle_Timeout))
+	{
+	  responseMsgId = HOST_APP_MSG_ID_RESPONSE_TIMEOUT;
+	}
+    }
+
+  return responseMsgId;
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_ResponseHandleNoBlock
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Checks for response. Expects RX buffer to be flushed prior to polling
+ *      this function.
+ * Inputs:
+ *      void
+ * Outputs:
+ *      HOST_APP_MSG_ID_E -- response type
+ *---------------------------------------------------------------------------*/
+HOST_APP_MSG_ID_E
+AtLib_ResponseHandleNoBlock (void)
+{
+  /* Now process the response from S2w App node */
+  return AtLib_ReceiveChunk (NULL);
+}
+
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_ProcessRxChunk
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Process a group of received bytes looking for a response message.
+ *      Processing stops after the first response message, remaining bytes
+ *      stay pending and are processed by next call with rxBuf NULL (buffer
+ *      must stay valid until then).  Connection data is handed over to
+ *      AtLib_ProcessIncomingData in spans, as long as possible.  Processing
+ *      also stops when connection handler does not take all data.
+ * Inputs:
+ *      const uint8_t *rxBuf -- Pointer to bytes, NULL to continue with
+ *          pending bytes
+ *      uint32_t bufLen -- Number of bytes in receive buffer
+ * Outputs:
+ *      HOST_APP_MSG_ID_E -- response type
+ *---------------------------------------------------------------------------*/
+HOST_APP_MSG_ID_E
+AtLib_ProcessRxChunk (const uint8_t * rxBuf, uint32_t bufLen)
+{
+  HOST_APP_MSG_ID_E rxMsgId;
+  uint8_t rxData;
+
+  rxMsgId = HOST_APP_MSG_ID_NONE;
+
+  if (rxBuf != NULL)
+    {
+      rxCursor = rxBuf;
+      rxEnd = rxBuf + bufLen;
+      rxStalled = 0;
+    }
+
+  /* Parse the received data and check whether any valid message present in the chunk */
+  while ((HOST_APP_MSG_ID_NONE == rxMsgId) && (rxCursor < rxEnd) && !rxStalled)
+    {
+      switch (receive_state)
+	{
+	case HOST_APP_RX_STATE_START:
+	  rxData = *rxCursor++;
+	  switch (rxData)
+	    {
+	    case 0:
+	      // Ignore, they mess up strstr
+	      break;
+
+	    case HOST_APP_CR_CHAR:
+	    case HOST_APP_LF_CHAR:
+	      /* CR and LF at the begining, just ignore it */
+	      MRBufferIndex = 0;
+	      break;
+
+	    case HOST_APP_ESC_CHAR:
+	      /* ESCAPE sequence detected */
+	      receive_state = HOST_APP_RX_STATE_ESCAPE_START;
+	      MRBufferIndex = 0;
+	      specialDataLen = 0;
+	      rxCurrentCid = 0;
+	      break;
+
+	    default:
+	      /* Not start of ESC char, not start of any CR or NL */
+	      MRBufferIndex = 0;
+	      MRBuffer[MRBufferIndex] = rxData;
+	      MRBufferIndex++;
+	      receive_state = HOST_APP_RX_STATE_CMD_RESP;
+	      break;
+	    }
 	  break;
 
-	case HOST_APP_CR_CHAR:
-	case HOST_APP_LF_CHAR:
-	  /* CR and LF at the begining, just ignore it */
-	  MRBufferIndex = 0;
+	case HOST_APP_RX_STATE_CMD_RESP:
+	  rxMsgId = AtLib_ReceiveLine ();
 	  break;
 
-	case HOST_APP_ESC_CHAR:
-	  /* ESCAPE sequence detected */
-	  receive_state = HOST_APP_RX_STATE_ESCAPE_START;
-	  MRBufferIndex = 0;
-	  specialDataLen = 0;
-	  rxCurrentCid = 0;
+	case HOST_APP_RX_STATE_ESCAPE_START:
+	  rxMsgId = AtLib_ReceiveEscape ();
 	  break;
 
 	default:
-	  /* Not start of ESC char, not start of any CR or NL */
-	  MRBufferIndex = 0;
-	  MRBuffer[MRBufferIndex] = rxData;
-	  MRBufferIndex++;
-	  receive_state = HOST_APP_RX_STATE_CMD_RESP;
+	  AtLib_ReceiveData ();
 	  break;
 	}
-      break;
+    }
+
+  return rxMsgId;
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_ReceiveLine
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Collect response line into MRBuffer until CR or LF, and check it.
+ *      Printable characters (all above ESC) are copied without further
+ *      checks.
+ * Inputs:
+ *      void
+ * Outputs:
+ *      HOST_APP_MSG_ID_E -- response type
+ *---------------------------------------------------------------------------*/
+static HOST_APP_MSG_ID_E
+AtLib_ReceiveLine (void)
+{
+  HOST_APP_MSG_ID_E rxMsgId = HOST_APP_MSG_ID_NONE;
+  uint8_t rxData;
+
+  while (rxCursor < rxEnd)
+    {
+      rxData = *rxCursor++;
+
+      if (rxData > HOST_APP_ESC_CHAR)
+	{
+	  /* keep room for line end and NULL */
+	  if (MRBufferIndex < HOST_APP_RX_CMD_MAX_SIZE - 2)
+	    MRBuffer[MRBufferIndex++] = rxData;
+	  continue;
+	}
 
-    case HOST_APP_RX_STATE_CMD_RESP:
       switch (rxData)
 	{
 	case 0:
@@ -3129,465 +4070,350 @@ AtLib_ReceiveDataProcess (uint8_t rxData)
 	      /* command echo or end of response detected */
 	      /* Now reset the  state machine */
 	      receive_state = HOST_APP_RX_STATE_START;
+	      return rxMsgId;
 	    }
 	  break;
 
 	case HOST_APP_ESC_CHAR:
 	  /* Defensive check - This should not happen */
 	  receive_state = HOST_APP_RX_STATE_ESCAPE_START;
-	  break;
+	  return rxMsgId;
 
 	default:
-	  MRBuffer[MRBufferIndex] = rxData;
-	  MRBufferIndex++;
+	  if (MRBufferIndex < HOST_APP_RX_CMD_MAX_SIZE - 2)
+	    MRBuffer[MRBufferIndex++] = rxData;
 	  break;
 	}
-      break;
+    }
 
-    case HOST_APP_RX_STATE_ESCAPE_START:
-      switch (rxData)
-	{
-	case HOST_APP_DATA_MODE_BULK_START_CHAR_H:
-	  /* HTTP Bulk data handling start */
-	  /* <Esc>H<1 Byte - CID><4 bytes - Length of the data><data> */
-	  receive_state = HOST_APP_RX_STATE_HTTP_RESPONSE_DATA_HANDLE;
-	  specialDataLen = 0;
-	  specialDataLenCharCount = 0;
-	  break;
+  return rxMsgId;
+}
 
-	case HOST_APP_DATA_MODE_NORMAL_UDP_START_CHAR_U:
-	  /* UDP server handling
-	   *  <Esc>u<CID><IPAddress><space><port><horizontal tab<data><Esc>E
-	   */
-	  receive_state = HOST_APP_RX_STATE_UDP_DATA_HANDLE;
-	  specialDataLen = 0;
-	  specialDataLenCharCount = 0;
-	  ipCharCount = 0;
-	  portCharCount = 0;
-	  memset (udpIncomingIp, 0, sizeof (udpIncomingIp));
-	  memset (udpIncomingPort, 0, sizeof (udpIncomingPort));
-	  break;
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_ReceiveEscape
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Handle character after ESC, which selects the kind of data message.
+ * Inputs:
+ *      void
+ * Outputs:
+ *      HOST_APP_MSG_ID_E -- response type
+ *---------------------------------------------------------------------------*/
+static HOST_APP_MSG_ID_E
+AtLib_ReceiveEscape (void)
+{
+  uint8_t rxData = *rxCursor++;
 
-	case HOST_APP_DATA_MODE_UDP_BULK_START_CHAR_Y:
-	  /* UDP server handling */
-	  /* <Esc>y<CID><IP Address><Space><Port><horizontal tab><data length><data> */
-	  receive_state = HOST_APP_RX_STATE_UDP_BULK_DATA_HANDLE;
-	  specialDataLen = 0;
-	  specialDataLenCharCount = 0;
-	  ipCharCount = 0;
-	  portCharCount = 0;
-	  memset (udpIncomingIp, 0, sizeof (udpIncomingIp));
-	  memset (udpIncomingPort, 0, sizeof (udpIncomingPort));
-	  break;
+  rxPhase = ATLIB_RX_PHASE_CID;
+  specialDataLen = 0;
+  specialDataLenCharCount = 0;
 
-	case HOST_APP_DATA_MODE_BULK_START_CHAR_Z:
-	  /* Bulk data handling start */
-	  /* <Esc>Z<Cid><Data Length xxxx 4 ascii char><data>   */
-	  receive_state = HOST_APP_RX_STATE_BULK_DATA_HANDLE;
-	  specialDataLen = 0;
-	  specialDataLenCharCount = 0;
-	  break;
+  switch (rxData)
+    {
+    case HOST_APP_DATA_MODE_BULK_START_CHAR_H:
+      /* HTTP Bulk data handling start */
+      /* <Esc>H<1 Byte - CID><4 bytes - Length of the data><data> */
+      receive_state = HOST_APP_RX_STATE_HTTP_RESPONSE_DATA_HANDLE;
+      break;
 
-	case HOST_APP_DATA_MODE_NORMAL_START_CHAR_S:
-	  /* Start of data */
-	  /* ESC S  cid  <----data --- > ESC E  */
-	  receive_state = HOST_APP_RX_STATE_DATA_HANDLE;
-	  break;
+    case HOST_APP_DATA_MODE_NORMAL_UDP_START_CHAR_U:
+      /* UDP server handling
+       *  <Esc>u<CID><IPAddress><space><port><horizontal tab<data><Esc>E
+       */
+      receive_state = HOST_APP_RX_STATE_UDP_DATA_HANDLE;
+      ipCharCount = 0;
+      portCharCount = 0;
+      memset (udpIncomingIp, 0, sizeof (udpIncomingIp));
+      memset (udpIncomingPort, 0, sizeof (udpIncomingPort));
+      break;
 
-	case HOST_APP_DATA_MODE_RAW_INDICATION_CHAR_COL:
-	  /* Start of raw data  */
-	  /* ESC R : datalen : <----data --- >
-	     Unlike other data format, there is no ESC E at the end .
-	     So extract datalength to find out the incoming data size */
-	  receive_state = HOST_APP_RX_STATE_RAW_DATA_HANDLE;
-	  specialDataLen = 0;
-	  break;
+    case HOST_APP_DATA_MODE_UDP_BULK_START_CHAR_Y:
+      /* UDP server handling */
+      /* <Esc>y<CID><IP Address><Space><Port><horizontal tab><data length><data> */
+      receive_state = HOST_APP_RX_STATE_UDP_BULK_DATA_HANDLE;
+      ipCharCount = 0;
+      portCharCount = 0;
+      memset (udpIncomingIp, 0, sizeof (udpIncomingIp));
+      memset (udpIncomingPort, 0, sizeof (udpIncomingPort));
+      break;
 
-	case HOST_APP_DATA_MODE_ESC_OK_CHAR_O:
-	  /* ESC command response OK */
-	  /* Note: No need to take any action. Its just an data reception */
-	  /* acknowledgement S2w node */
-	  receive_state = HOST_APP_RX_STATE_START;
-	  return HOST_APP_MSG_ID_ESC_CMD_OK;
+    case HOST_APP_DATA_MODE_BULK_START_CHAR_Z:
+      /* Bulk data handling start */
+      /* <Esc>Z<Cid><Data Length xxxx 4 ascii char><data>   */
+      receive_state = HOST_APP_RX_STATE_BULK_DATA_HANDLE;
+      break;
 
-	case HOST_APP_DATA_MODE_ESC_FAIL_CHAR_F:
-	  /* ESC command response FAILED */
-	  /* Note: Error reported from S2w node, you can use it */
-	  /* for debug purpose. */
-	  receive_state = HOST_APP_RX_STATE_START;
-	  return HOST_APP_MSG_ID_ESC_CMD_FAIL;
+    case HOST_APP_DATA_MODE_NORMAL_START_CHAR_S:
+      /* Start of data */
+      /* ESC S  cid  <----data --- > ESC E  */
+      receive_state = HOST_APP_RX_STATE_DATA_HANDLE;
+      break;
 
-	default:
-	  /* ESC sequence parse error !  */
-	  /* Reset the receive buffer */
-	  receive_state = HOST_APP_RX_STATE_START;
-	  break;
-	}
+    case HOST_APP_DATA_MODE_RAW_INDICATION_CHAR_COL:
+      /* Start of raw data  */
+      /* ESC R : datalen : <----data --- >
+         Unlike other data format, there is no ESC E at the end .
+         So extract datalength to find out the incoming data size */
+      receive_state = HOST_APP_RX_STATE_RAW_DATA_HANDLE;
       break;
 
-    case HOST_APP_RX_STATE_DATA_HANDLE:
-      rxCurrentCid = AtLib_getCidFromAscii (rxData);
+    case HOST_APP_DATA_MODE_ESC_OK_CHAR_O:
+      /* ESC command response OK */
+      /* Note: No need to take any action. Its just an data reception */
+      /* acknowledgement S2w node */
+      receive_state = HOST_APP_RX_STATE_START;
+      return HOST_APP_MSG_ID_ESC_CMD_OK;
 
-      do
-	{
-	  /* keep recieving data till you get ESC E */
-	  GS_HAL_recv (&rxData, 1, 1);
+    case HOST_APP_DATA_MODE_ESC_FAIL_CHAR_F:
+      /* ESC command response FAILED */
+      /* Note: Error reported from S2w node, you can use it */
+      /* for debug purpose. */
+      receive_state = HOST_APP_RX_STATE_START;
+      return HOST_APP_MSG_ID_ESC_CMD_FAIL;
 
-	  /* Read one byte at a time - blocking call */
-	  if (HOST_APP_ESC_CHAR == rxData)
-	    {
-	      /* Preview the next byte */
-	      GS_HAL_recv (&rxData, 1, 1);
-	      if (rxData == HOST_APP_DATA_MODE_NORMAL_END_CHAR_E)
-		{
-		  /* End of data detected */
-		  /* Reset the RX state machine */
-		  receive_state = HOST_APP_RX_STATE_START;
-		}
-	      else
-		{
-		  /* We need to send the Escape Character before the new byte */
-		  AtLib_ProcessIncomingData (rxCurrentCid, HOST_APP_ESC_CHAR);
-		  AtLib_ProcessIncomingData (rxCurrentCid, rxData);
-		}
-	    }
-	  else
-	    {
-	      AtLib_ProcessIncomingData (rxCurrentCid, rxData);
-	    }
-	}
-      while (receive_state != HOST_APP_RX_STATE_START);
+    default:
+      /* ESC sequence parse error !  */
+      /* Reset the receive buffer */
+      receive_state = HOST_APP_RX_STATE_START;
       break;
+    }
 
-    case HOST_APP_RX_STATE_HTTP_RESPONSE_DATA_HANDLE:
-      /* HTTP response CID */
-      rxCurrentCid = AtLib_getCidFromAscii (rxData);
-      do
-	{
-	  /* extracting  the rx data length */
-	  /* Read one byte at a time */
-	  GS_HAL_recv (&rxData, 1, 1);
+  return HOST_APP_MSG_ID_NONE;
+}
 
-	  /* Read one byte at a time - blocking call */
-	  specialDataLen = (specialDataLen * 10) + ((rxData) - '0');
-	  specialDataLenCharCount++;
-	}
-      while (specialDataLenCharCount
-	     < HOST_APP_HTTP_RESP_DATA_LEN_STRING_SIZE);
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_ReceiveData
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Handle data message: connection id, udp client address, data length
+ *      and data.  Data with known length is handed over as it is in the
+ *      chunk, <Esc>S and <Esc>u data up to the next ESC (found with memchr).
+ *      Bytes not taken by the handler are left pending and parsing stalls.
+ * Inputs:
+ *      void
+ * Outputs:
+ *      void
+ *---------------------------------------------------------------------------*/
+static void
+AtLib_ReceiveData (void)
+{
+  const uint8_t *pData;
+  const uint8_t *pEsc;
+  uint32_t len;
+  uint32_t used;
+  uint8_t escData[2];
+  uint8_t rxData;
 
-      /* Now read actual data */
-      while (specialDataLen)
-	{
-	  /* Read one byte at a time */
-	  GS_HAL_recv (&rxData, 1, 1);
+  switch (rxPhase)
+    {
+    case ATLIB_RX_PHASE_CID:
+      rxData = *rxCursor++;
 
-	  /* Read one byte at a time - blocking call */
-	  specialDataLen--;
-	  AtLib_ProcessIncomingData (rxCurrentCid, rxData);
+      if (HOST_APP_RX_STATE_RAW_DATA_HANDLE == receive_state)
+	{
+	  rxPhase = ATLIB_RX_PHASE_LEN;
+	  break;
 	}
-      AtLib_ProcessCompletedHttpBulkTransferEvent(rxCurrentCid);
 
-      receive_state = HOST_APP_RX_STATE_START;
+      rxCurrentCid = AtLib_getCidFromAscii (rxData);
+
+      if (HOST_APP_RX_STATE_DATA_HANDLE == receive_state)
+	rxPhase = ATLIB_RX_PHASE_DATA;
+      else if ((HOST_APP_RX_STATE_UDP_DATA_HANDLE == receive_state)
+	       || (HOST_APP_RX_STATE_UDP_BULK_DATA_HANDLE == receive_state))
+	rxPhase = ATLIB_RX_PHASE_IP;
+      else
+	rxPhase = ATLIB_RX_PHASE_LEN;
       break;
 
-    case HOST_APP_RX_STATE_BULK_DATA_HANDLE:
-      rxCurrentCid = AtLib_getCidFromAscii (rxData);
-      do
-	{
-	  /* extracting  the rx data length */
-	  /* Read one byte at a time - blocking call */
-	  GS_HAL_recv (&rxData, 1, 1);
+    case ATLIB_RX_PHASE_IP:
+      rxData = *rxCursor++;
+      udpIncomingIp[ipCharCount++] = rxData;
 
-	  specialDataLen = (specialDataLen * 10) + ((rxData) - '0');
-	  specialDataLenCharCount++;
-	}
-      while (specialDataLenCharCount < HOST_APP_BULK_DATA_LEN_STRING_SIZE);
-      /* Now read actual data */
-      while (specialDataLen)
+      if ((rxData == ' ') || (ipCharCount >= HOST_APP_RX_IP_MAX_SIZE))
 	{
-	  /* Read one byte at a time - blocking call */
-	  GS_HAL_recv (&rxData, 1, 1);
-	  specialDataLen--;
-	  AtLib_ProcessIncomingData (rxCurrentCid, rxData);
+	  // The last value should be the space, so null terminate string
+	  udpIncomingIp[--ipCharCount] = 0;
+	  rxPhase = ATLIB_RX_PHASE_PORT;
 	}
-      AtLib_ProcessCompletedBulkTransferEvent(rxCurrentCid);
-
-      receive_state = HOST_APP_RX_STATE_START;
       break;
 
-    case HOST_APP_RX_STATE_RAW_DATA_HANDLE:
-      if (HOST_APP_DATA_MODE_RAW_INDICATION_CHAR_COL == rxData)
+    case ATLIB_RX_PHASE_PORT:
+      rxData = *rxCursor++;
+      udpIncomingPort[portCharCount++] = rxData;
+
+      if ((rxData == '\t') || (portCharCount >= HOST_APP_RX_PORT_MAX_SIZE))
 	{
-	  specialDataLenCharCount = 0;
+	  // The last value should be the tab, so null terminate string
+	  udpIncomingPort[--portCharCount] = 0;
+
+	  if (HOST_APP_RX_STATE_UDP_DATA_HANDLE == receive_state)
+	    rxPhase = ATLIB_RX_PHASE_DATA;
+	  else
+	    rxPhase = ATLIB_RX_PHASE_LEN;
 	}
+      break;
 
-      /* Now reset the buffer and state machine */
-      receive_state = HOST_APP_RX_STATE_START;
+    case ATLIB_RX_PHASE_LEN:
+      /* extracting  the rx data length */
+      rxData = *rxCursor++;
 
-      do
+      if (HOST_APP_RX_STATE_RAW_DATA_HANDLE == receive_state)
 	{
-	  /* extracting the rx data length */
-	  /* Read one byte at a time */
-	  /* Read one byte at a time - blocking call */
-	  GS_HAL_recv (&rxData, 1, 1);
-
+	  /* raw data length is terminated by ':' */
 	  if (rxData != HOST_APP_DATA_MODE_RAW_INDICATION_CHAR_COL)
 	    {
 	      specialDataLen = (specialDataLen * 10) + ((rxData) - '0');
 	      specialDataLenCharCount++;
 	    }
+	  if ((rxData == HOST_APP_DATA_MODE_RAW_INDICATION_CHAR_COL)
+	      || (specialDataLenCharCount >= HOST_APP_BULK_DATA_LEN_STRING_SIZE))
+	    AtLib_ReceiveDataStart ();
+	  break;
 	}
-      while ((rxData != HOST_APP_DATA_MODE_RAW_INDICATION_CHAR_COL)
-	     && (specialDataLenCharCount <
-		 HOST_APP_BULK_DATA_LEN_STRING_SIZE));
-
-      /* Now read actual data */
-      while (specialDataLen)
-	{
-	  /* Read one byte at a time - blocking call */
-	  GS_HAL_recv (&rxData, 1, 1);
-	  specialDataLen--;
-	  AtLib_ProcessIncomingData (rxCurrentCid, rxData);
-	}
-
-      receive_state = HOST_APP_RX_STATE_START;
-      break;
-
-    case HOST_APP_RX_STATE_UDP_DATA_HANDLE:
-      rxCurrentCid = AtLib_getCidFromAscii (rxData);
-
-      // Get the IP address
-      do
-	{
-	  /* Read one byte at a time - blocking call */
-	  GS_HAL_recv (&rxData, 1, 1);
-	  udpIncomingIp[ipCharCount++] = rxData;
-	}
-      while (rxData != ' ' && ipCharCount < HOST_APP_RX_IP_MAX_SIZE);
 
-      // The last value should be the space, so null terminate string
-      udpIncomingIp[--ipCharCount] = 0;
+      specialDataLen = (specialDataLen * 10) + ((rxData) - '0');
+      specialDataLenCharCount++;
 
-      // Get the Port
-      do
+      if (HOST_APP_RX_STATE_HTTP_RESPONSE_DATA_HANDLE == receive_state)
 	{
-	  /* Read one byte at a time - blocking call */
-	  GS_HAL_recv (&rxData, 1, 1);
-	  udpIncomingPort[portCharCount++] = rxData;
+	  if (specialDataLenCharCount >= HOST_APP_HTTP_RESP_DATA_LEN_STRING_SIZE)
+	    AtLib_ReceiveDataStart ();
 	}
-      while (rxData != '\t' && portCharCount < HOST_APP_RX_PORT_MAX_SIZE);
+      else if (specialDataLenCharCount >= HOST_APP_BULK_DATA_LEN_STRING_SIZE)
+	AtLib_ReceiveDataStart ();
+      break;
 
-      // The last value should be the tab, so null terminate string
-      udpIncomingPort[--portCharCount] = 0;
+    case ATLIB_RX_PHASE_DATA:
+      pData = rxCursor;
 
-      // Now read the data
-      do
+      if ((HOST_APP_RX_STATE_DATA_HANDLE == receive_state)
+	  || (HOST_APP_RX_STATE_UDP_DATA_HANDLE == receive_state))
 	{
 	  /* keep receiving data till you get ESC E */
-	  GS_HAL_recv (&rxData, 1, 1);
+	  pEsc = memchr (pData, HOST_APP_ESC_CHAR, rxEnd - pData);
+	  len = ((pEsc != NULL) ? pEsc : rxEnd) - pData;
 
-	  /* Read one byte at a time - blocking call */
-	  if (HOST_APP_ESC_CHAR == rxData)
+	  rxCursor += len;
+	  if (pEsc != NULL)
 	    {
 	      /* Preview the next byte */
-	      GS_HAL_recv (&rxData, 1, 1);
-	      if (rxData == HOST_APP_DATA_MODE_NORMAL_END_CHAR_E)
-		{
-		  /* End of data detected */
-		  /* Reset the RX state machine */
-		  receive_state = HOST_APP_RX_STATE_START;
-		}
-	      else
-		{
-		  /* We need to send the Escape Character before the new byte */
-		  AtLib_ProcessIncomingData (rxCurrentCid, HOST_APP_ESC_CHAR);
-		  AtLib_ProcessIncomingData (rxCurrentCid, rxData);
-		}
+	      rxCursor++;
+	      rxPhase = ATLIB_RX_PHASE_ESC;
 	    }
-	  else
+
+	  if (len)
 	    {
-	      AtLib_ProcessIncomingData (rxCurrentCid, rxData);
+	      used = AtLib_ProcessIncomingData (rxCurrentCid, pData, len);
+	      if (used < len)
+		{
+		  rxCursor = pData + used;
+		  rxPhase = ATLIB_RX_PHASE_DATA;
+		  rxStalled = 1;
+		}
 	    }
+	  break;
 	}
-      while (receive_state != HOST_APP_RX_STATE_START);
-      break;
 
-    case HOST_APP_RX_STATE_UDP_BULK_DATA_HANDLE:
-      rxCurrentCid = AtLib_getCidFromAscii (rxData);
+      /* data with known length */
+      len = rxEnd - pData;
+      if (len > specialDataLen)
+	len = specialDataLen;
 
-      // Get the IP address
-      do
-	{
-	  /* Read one byte at a time - blocking call */
-	  GS_HAL_recv (&rxData, 1, 1);
-	  udpIncomingIp[ipCharCount++] = rxData;
-	}
-      while (rxData != ' ' && ipCharCount < HOST_APP_RX_IP_MAX_SIZE);
+      rxCursor += len;
+      specialDataLen -= len;
 
-      // The last value should be the space, so null terminate string
-      udpIncomingIp[--ipCharCount] = 0;
-
-      // Get the Port
-      do
+      if (len)
 	{
-	  /* Read one byte at a time - blocking call */
-	  GS_HAL_recv (&rxData, 1, 1);
-	  udpIncomingPort[portCharCount++] = rxData;
+	  used = AtLib_ProcessIncomingData (rxCurrentCid, pData, len);
+	  if (used < len)
+	    {
+	      rxCursor = pData + used;
+	      specialDataLen += len - used;
+	      rxStalled = 1;
+	      break;
+	    }
 	}
-      while (rxData != '\t' && portCharCount < HOST_APP_RX_PORT_MAX_SIZE);
 
-      // The last value should be the tab, so null terminate string
-      udpIncomingPort[--portCharCount] = 0;
+      if (specialDataLen == 0)
+	AtLib_ReceiveDataEnd ();
+      break;
 
-      do
-	{
-	  /* extracting  the rx data length */
-	  /* Read one byte at a time - blocking call */
-	  GS_HAL_recv (&rxData, 1, 1);
+    case ATLIB_RX_PHASE_ESC:
+      rxData = *rxCursor++;
 
-	  specialDataLen = (specialDataLen * 10) + ((rxData) - '0');
-	  specialDataLenCharCount++;
-	}
-      while (specialDataLenCharCount < HOST_APP_BULK_DATA_LEN_STRING_SIZE);
-      /* Now read actual data */
-      while (specialDataLen)
+      if (rxData == HOST_APP_DATA_MODE_NORMAL_END_CHAR_E)
 	{
-	  /* Read one byte at a time - blocking call */
-	  GS_HAL_recv (&rxData, 1, 1);
-	  specialDataLen--;
-	  AtLib_ProcessIncomingData (rxCurrentCid, rxData);
+	  /* End of data detected, packets of the frame are processed */
+	  AtLib_ReceiveDataEnd ();
+	  break;
 	}
 
-      receive_state = HOST_APP_RX_STATE_START;
-      break;
+      /* We need to send the Escape Character before the new byte */
+      rxPhase = ATLIB_RX_PHASE_DATA;
+      escData[0] = HOST_APP_ESC_CHAR;
+      escData[1] = rxData;
+      used = AtLib_ProcessIncomingData (rxCurrentCid, escData, sizeof (escData));
+      if (used < sizeof (escData))
+	{
+	  /* Byte after ESC is parsed again, ESC too if it is not taken */
+	  rxCursor--;
+	  if (used == 0)
+	    rxPhase = ATLIB_RX_PHASE_ESC;
+	  rxStalled = 1;
+	}
       break;
 
     default:
       /* This case will not be executed */
+      receive_state = HOST_APP_RX_STATE_START;
       break;
     }
-
-  return rxMsgId;
 }
 
 /*---------------------------------------------------------------------------*
- * Routine:  AtLib_ResponseHandle
+ * Routine:  AtLib_ReceiveDataStart
  *---------------------------------------------------------------------------*
  * Description:
- *      Wait for a response after sending a command.  Keep parsing the
- *      data until a response is found.
+ *      Data length is received, go on with data.
  * Inputs:
  *      void
  * Outputs:
- *      HOST_APP_MSG_ID_E -- response type
- *---------------------------------------------------------------------------*/
-HOST_APP_MSG_ID_E
-AtLib_ResponseHandle (void)
-{
-  HOST_APP_MSG_ID_E responseMsgId;
-  uint8_t rxData;
-  uint64_t timeout = MSTimerGet ();
-  uint8_t gotData = 0;
-
-  /* Reset the receive buffer */
-  AtLib_FlushRxBuffer ();
-
-  /* Reset the message ID */
-  responseMsgId = HOST_APP_MSG_ID_NONE;
-
-  /* Now process the response from S2w App node */
-  while (HOST_APP_MSG_ID_NONE == responseMsgId)
-    {
-      gotData = 1;
-      /* Read one byte at a time - non-blocking call, block here */
-      timeout = MSTimerGet ();
-      while (!GS_HAL_recv (&rxData, 1, 0))
-	{
-	  if (MSTimerDelta (timeout) >= AtLib_Response_Handle_Timeout)
-	    {
-	      gotData = 0;
-	      responseMsgId = HOST_APP_MSG_ID_RESPONSE_TIMEOUT;
-	      break;
-	    }
-	}
-      if (gotData)
-	{
-	  /* Process the received data */
-	  responseMsgId = AtLib_ReceiveDataProcess (rxData);
-	  if (responseMsgId != HOST_APP_MSG_ID_NONE)
-	    {
-	      /* Message successfully received from S2w App node */
-	      break;
-	    }
-	}
-    }
-
-  return responseMsgId;
-}
-
-/*---------------------------------------------------------------------------*
- * Routine:  AtLib_ResponseHandleNoBlock
- *---------------------------------------------------------------------------*
- * Description:
- *      Checks for response. Expects RX buffer to be flushed prior to polling
- *      this function.
- * Inputs:
  *      void
- * Outputs:
- *      HOST_APP_MSG_ID_E -- response type
  *---------------------------------------------------------------------------*/
-HOST_APP_MSG_ID_E
-AtLib_ResponseHandleNoBlock (void)
+static void
+AtLib_ReceiveDataStart (void)
 {
-  HOST_APP_MSG_ID_E responseMsgId;
-  uint8_t rxData;
-
-  /* Reset the message ID */
-  responseMsgId = HOST_APP_MSG_ID_NONE;
+  rxPhase = ATLIB_RX_PHASE_DATA;
 
-  /* Now process the response from S2w App node */
-  while (responseMsgId == HOST_APP_MSG_ID_NONE && GS_HAL_recv (&rxData, 1, 0))
-    {
-      responseMsgId = AtLib_ReceiveDataProcess (rxData);
-    }
-
-  return responseMsgId;
+  if (specialDataLen == 0)
+    AtLib_ReceiveDataEnd ();
 }
 
-
 /*---------------------------------------------------------------------------*
- * Routine:  AtLib_ProcessRxChunk
+ * Routine:  AtLib_ReceiveDataEnd
  *---------------------------------------------------------------------------*
  * Description:
- *      Process a group of received bytes looking for a response message.
+ *      All data with known length (or tcp data up to <Esc>E) is received.
+ *      Receive state is reset before transfer event is generated, so
+ *      responses to commands sent from the event are parsed as usual.
  * Inputs:
- *      const uint8_t *rxBuf -- Pointer to bytes
- *      uint32_t bufLen -- Number of bytes in receive buffer
+ *      void
  * Outputs:
- *      HOST_APP_MSG_ID_E -- response type
+ *      void
  *---------------------------------------------------------------------------*/
-HOST_APP_MSG_ID_E
-AtLib_ProcessRxChunk (const uint8_t * rxBuf, uint32_t bufLen)
+static void
+AtLib_ReceiveDataEnd (void)
 {
-  HOST_APP_MSG_ID_E rxMsgId;
+  HOST_APP_RX_STATE_E state = receive_state;
 
-  rxMsgId = HOST_APP_MSG_ID_NONE;
+  receive_state = HOST_APP_RX_STATE_START;
 
-  /* Parse the received data and check whether any valid message present in the chunk */
-  while (bufLen)
-    {
-      /* Process the received data */
-      rxMsgId = AtLib_ReceiveDataProcess (*rxBuf);
-      if (rxMsgId != HOST_APP_MSG_ID_NONE)
-	{
-	  /* Message received from S2w App node */
-	  break;
-	}
-      rxBuf++;
-      bufLen--;
-    }
-
-  return rxMsgId;
+  if (HOST_APP_RX_STATE_HTTP_RESPONSE_DATA_HANDLE == state)
+    AtLib_ProcessCompletedHttpBulkTransferEvent (rxCurrentCid);
+  else if ((HOST_APP_RX_STATE_BULK_DATA_HANDLE == state)
+	   || (HOST_APP_RX_STATE_DATA_HANDLE == state))
+    AtLib_ProcessCompletedBulkTransferEvent (rxCurrentCid);
 }
 
 /*---------------------------------------------------------------------------*
@@ -3605,20 +4431,22 @@ AtLib_FlushIncomingMessage (void)
 {
   /* This function will read all incoming data until nothing happens */
   /* for 100 ms */
-  uint8_t rxData;
   uint64_t start;
 
-  /* Read one byte at a time - non-blocking call */
+  /* Let queued commands get their responses first */
+  AtLib_CommandQueueWait ();
+
+  /* Drop bytes left from last chunk */
+  rxCursor = rxEnd;
+  rxStalled = 0;
+
+  /* Read one chunk at a time - non-blocking call */
   start = MSTimerGet ();
   while (MSTimerDelta (start) < 100)
     {
-      if (GS_HAL_recv (&rxData, 1, 0))
+      if (GS_HAL_recv (rxChunk, sizeof (rxChunk), 0))
 	{
 	  start = MSTimerGet ();
-#ifdef HOST_APP_DEBUG_ENABLE
-	  /* If required you can print the received characters on debug UART port. */
-//	  GS_API_Printf ("%c", rxData);
-#endif
 	}
     };
 }
@@ -3827,12 +4655,117 @@ AtLib_strcasecmp (const char *s1, const char *s2)
   return (tolower (*us1) - tolower (*us2));
 }
 
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_CmdStart
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Start new command in G_ATCmdBuf.  Use ATLIB_CMD_START for string
+ *      literals.
+ * Inputs:
+ *      const char *pStr -- First characters of the command
+ *      uint16_t len -- Number of characters
+ * Outputs:
+ *      void
+ *---------------------------------------------------------------------------*/
+static void
+AtLib_CmdStart (const char *pStr, uint16_t len)
+{
+  G_ATCmdLen = 0;
+  AtLib_CmdAppend (pStr, len);
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_CmdAppend
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Append characters to the command in G_ATCmdBuf.  Use ATLIB_CMD_LIT
+ *      for string literals.
+ * Inputs:
+ *      const char *pStr -- Characters to append
+ *      uint16_t len -- Number of characters
+ * Outputs:
+ *      void
+ *---------------------------------------------------------------------------*/
+static void
+AtLib_CmdAppend (const char *pStr, uint16_t len)
+{
+  if (len > HOST_APP_TX_CMD_MAX_SIZE - 1 - G_ATCmdLen)
+    len = HOST_APP_TX_CMD_MAX_SIZE - 1 - G_ATCmdLen;
+
+  memcpy (&G_ATCmdBuf[G_ATCmdLen], pStr, len);
+  G_ATCmdLen += len;
+  G_ATCmdBuf[G_ATCmdLen] = '\0';
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_CmdStr
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Append zero terminated string to the command in G_ATCmdBuf.
+ * Inputs:
+ *      const char *pStr -- String to append
+ * Outputs:
+ *      void
+ *---------------------------------------------------------------------------*/
+static void
+AtLib_CmdStr (const char *pStr)
+{
+  AtLib_CmdAppend (pStr, strlen (pStr));
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_CmdChar
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Append one character to the command in G_ATCmdBuf.
+ * Inputs:
+ *      char c -- Character to append
+ * Outputs:
+ *      void
+ *---------------------------------------------------------------------------*/
+static void
+AtLib_CmdChar (char c)
+{
+  AtLib_CmdAppend (&c, 1);
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  AtLib_CmdNum
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Append number in decimal to the command in G_ATCmdBuf, same as
+ *      "%d" did.
+ * Inputs:
+ *      int32_t value -- Number to append
+ * Outputs:
+ *      void
+ *---------------------------------------------------------------------------*/
+static void
+AtLib_CmdNum (int32_t value)
+{
+  char digits[11];
+  uint8_t i = sizeof (digits);
+  uint32_t num = (value < 0) ? -(uint32_t) value : (uint32_t) value;
+
+  do
+    {
+      digits[--i] = '0' + num % 10;
+      num /= 10;
+    }
+  while (num);
+
+  if (value < 0)
+    digits[--i] = '-';
+
+  AtLib_CmdAppend (&digits[i], sizeof (digits) - i);
+}
+
 /*---------------------------------------------------------------------------*
  * Routine:  AtLib_ConvertNumberTo4DigitASCII
  *---------------------------------------------------------------------------*
  * Description:
  *      Equivalent of sprintf("%04d"), number to convert a number to
- *      four characters.
+ *      four characters (and terminating zero).
  * Inputs:
  *      uint32_t myNum -- Number to convert to text
  *      int8_t *pStr -- Place to store characters
@@ -3853,25 +4786,29 @@ AtLib_ConvertNumberTo4DigitASCII (uint32_t myNum, int8_t * pStr)
   digit3 = ((myNum % 1000) % 100) / 10;
   digit4 = ((myNum % 1000) % 100) % 10;
 
-  sprintf ((char *) pStr, _F8_ _F8_ _F8_ _F8_, digit1, digit2, digit3,
-	   digit4);
+  pStr[0] = '0' + digit1;
+  pStr[1] = '0' + digit2;
+  pStr[2] = '0' + digit3;
+  pStr[3] = '0' + digit4;
+  pStr[4] = '\0';
 }
 
 /*---------------------------------------------------------------------------*
  * Routine:  AtLib_ProcessIncomingData
  *---------------------------------------------------------------------------*
  * Description:
- *      Process a bytes coming from the given connection.
+ *      Process bytes coming from the given connection.
  * Inputs:
  *      uint8_t cid -- connection id
- *      uint8_t rxData -- Data to process
+ *      const uint8_t *pData -- Data to process
+ *      uint32_t dataLen -- Number of bytes
  * Outputs:
- *      void
+ *      uint32_t -- Number of bytes taken, the rest is offered again later
  *---------------------------------------------------------------------------*/
-void
-AtLib_ProcessIncomingData (uint8_t cid, uint8_t rxData)
+uint32_t
+AtLib_ProcessIncomingData (uint8_t cid, const uint8_t * pData, uint32_t dataLen)
 {
-  App_ProcessIncomingData (cid, rxData);
+  return App_ProcessIncomingData (cid, pData, dataLen);
 }
 
 /*---------------------------------------------------------------------------*
@@ -3949,8 +4886,9 @@ HOST_APP_MSG_ID_E AtLib_Ping(
 //            "AT+PING=%s" _F16_ "," _F16_ "," _F16_ "," _F8_ "," _F8_ ",%s\r\n",
 //            ip, trails, timeout, len, tos, ttl, payload);
 
-    sprintf(G_ATCmdBuf,
-            "AT+PING=%s"  "\r\n", ip);
+    ATLIB_CMD_START ("AT+PING=");
+    AtLib_CmdStr ((const char *) ip);
+    ATLIB_CMD_LIT ("\r\n");
 
     return AtLib_CommandSend();
     /* TODO: Need some type of callback per ping or at least the summary */
@@ -3979,14 +4917,21 @@ AtLib_AddSSLCertificate(
 {
     HOST_APP_MSG_ID_E rxMsgId;
 
-    sprintf(G_ATCmdBuf, "AT+TCERTADD=%s," _F8_ "," _F16_ "," _F8_ "\n", name, hex,
-            size, ram);
+    ATLIB_CMD_START ("AT+TCERTADD=");
+    AtLib_CmdStr (name);
+    ATLIB_CMD_LIT (",");
+    AtLib_CmdNum (hex);
+    ATLIB_CMD_LIT (",");
+    AtLib_CmdNum (size);
+    ATLIB_CMD_LIT (",");
+    AtLib_CmdNum (ram);
+    ATLIB_CMD_LIT ("\n");
 
     rxMsgId = AtLib_CommandSend();
     if (rxMsgId != HOST_APP_MSG_ID_OK)
     	return rxMsgId;
 
-    sprintf(G_ATCmdBuf, "%c%c", HOST_APP_ESC_CHAR, 'W');
+    ATLIB_CMD_START (HOST_APP_ESC_STR "W");
 
     GS_HAL_send((uint8_t *) & G_ATCmdBuf[0], 1);
     GS_HAL_send((uint8_t *) & G_ATCmdBuf[1], 1);
@@ -4017,7 +4962,9 @@ AtLib_DeleteSSLCertificate(char name[])
     HOST_APP_MSG_ID_E rxMsgId;
 
     /* TODO: Does this require a comma? */
-    sprintf(G_ATCmdBuf, "AT+TCERTDEL=%s,\r\n", name);
+    ATLIB_CMD_START ("AT+TCERTDEL=");
+    AtLib_CmdStr (name);
+    ATLIB_CMD_LIT (",\r\n");
 
     rxMsgId = AtLib_CommandSend();
 
@@ -4041,7 +4988,11 @@ AtLib_SSLOpen(uint8_t cid, char caName[])
 {
     HOST_APP_MSG_ID_E rxMsgId;
 
-    sprintf(G_ATCmdBuf, "AT+SSLOPEN=" _F8_ ",%s\n", (int)cid, caName);
+    ATLIB_CMD_START ("AT+SSLOPEN=");
+    AtLib_CmdNum (cid);
+    ATLIB_CMD_LIT (",");
+    AtLib_CmdStr (caName);
+    ATLIB_CMD_LIT ("\n");
 
     rxMsgId = AtLib_CommandSend();
 
@@ -4065,7 +5016,9 @@ AtLib_SSLClose(uint8_t cid)
 {
     HOST_APP_MSG_ID_E rxMsgId;
 
-    sprintf(G_ATCmdBuf, "AT+SSLCLOSE=" _F16_ "\r\n", cid);
+    ATLIB_CMD_START ("AT+SSLCLOSE=");
+    AtLib_CmdNum (cid);
+    ATLIB_CMD_LIT ("\r\n");
 
     rxMsgId = AtLib_CommandSend();
 
@@ -4089,9 +5042,11 @@ AtLib_HTTPConf(ATLIB_HTTPCLIENT_E param, char value[])
 {
 	HOST_APP_MSG_ID_E rxMsgId;
 
-    sprintf(G_ATCmdBuf, "AT+HTTPCONF=" _F16_ ",", param);
+    ATLIB_CMD_START ("AT+HTTPCONF=");
+    AtLib_CmdNum (param);
+    ATLIB_CMD_LIT (",");
 	
-    GS_HAL_send((uint8_t *) G_ATCmdBuf, strlen(G_ATCmdBuf));
+    GS_HAL_send((uint8_t *) G_ATCmdBuf, G_ATCmdLen);
     GS_HAL_send((uint8_t *) value, strlen(value));
     GS_HAL_send((uint8_t *) "\r\n", 2);
 
@@ -4118,7 +5073,9 @@ AtLib_HTTPConfDel(ATLIB_HTTPCLIENT_E param)
 {
 	HOST_APP_MSG_ID_E rxMsgId;
 
-    sprintf(G_ATCmdBuf, "AT+HTTPCONFDEL=" _F16_ "\r\n", param);
+    ATLIB_CMD_START ("AT+HTTPCONFDEL=");
+    AtLib_CmdNum (param);
+    ATLIB_CMD_LIT ("\r\n");
 
     rxMsgId = AtLib_CommandSend();
 
@@ -4143,7 +5100,9 @@ AtLib_HTTPClose(uint8_t cid)
 	HOST_APP_MSG_ID_E rxMsgId;
 
     /* TODO: Is CID a character or a number? */
-    sprintf(G_ATCmdBuf, "AT+HTTPCLOSE=" _F8_ "\r\n", cid);
+    ATLIB_CMD_START ("AT+HTTPCLOSE=");
+    AtLib_CmdNum (cid);
+    ATLIB_CMD_LIT ("\r\n");
 
     rxMsgId = AtLib_CommandSend();
 
@@ -4177,9 +5136,13 @@ AtLibGs_HTTPOpen(
 {
     HOST_APP_MSG_ID_E rxMsgId;
 
-    sprintf(G_ATCmdBuf, "AT+HTTPOPEN=%s," _F16_ "\n", host, port);
+    ATLIB_CMD_START ("AT+HTTPOPEN=");
+    AtLib_CmdStr (host);
+    ATLIB_CMD_LIT (",");
+    AtLib_CmdNum (port);
+    ATLIB_CMD_LIT ("\n");
 
-    GS_HAL_send((uint8_t *) G_ATCmdBuf, strlen(G_ATCmdBuf));
+    GS_HAL_send((uint8_t *) G_ATCmdBuf, G_ATCmdLen);
 
     rxMsgId = AtLib_ResponseHandle ();
 
@@ -4220,25 +5183,42 @@ AtLibGs_HTTPSend(
 
     	if (type == ATLIBGS_HTTPSEND_GET)
     	{
-    		sprintf(G_ATCmdBuf, "AT+HTTPSEND=" _F8_ "," _F8_ "," _F16_ ",%s\n", cid, type,
-    				timeout, page);
+    		ATLIB_CMD_START ("AT+HTTPSEND=");
+    		AtLib_CmdNum (cid);
+    		ATLIB_CMD_LIT (",");
+    		AtLib_CmdNum (type);
+    		ATLIB_CMD_LIT (",");
+    		AtLib_CmdNum (timeout);
+    		ATLIB_CMD_LIT (",");
+    		AtLib_CmdStr (page);
+    		ATLIB_CMD_LIT ("\n");
     	}
     	else
     	{
-            sprintf(G_ATCmdBuf, "AT+HTTPSEND=" _F8_ "," _F8_ "," _F16_ ",%s" "," _F16_ "\n", cid, type,
-                    timeout, page, size);
+            ATLIB_CMD_START ("AT+HTTPSEND=");
+            AtLib_CmdNum (cid);
+            ATLIB_CMD_LIT (",");
+            AtLib_CmdNum (type);
+            ATLIB_CMD_LIT (",");
+            AtLib_CmdNum (timeout);
+            ATLIB_CMD_LIT (",");
+            AtLib_CmdStr (page);
+            ATLIB_CMD_LIT (",");
+            AtLib_CmdNum (size);
+            ATLIB_CMD_LIT ("\n");
     	}
 
-        GS_HAL_send((uint8_t *) G_ATCmdBuf, strlen(G_ATCmdBuf));
+        GS_HAL_send((uint8_t *) G_ATCmdBuf, G_ATCmdLen);
 
         rxMsgId = AtLib_ResponseHandle();
         if (rxMsgId == HOST_APP_MSG_ID_OK) {
         	if ((type == ATLIBGS_HTTPSEND_POST) && (size))
         	{
 				/* Construct the data start indication message */
-				sprintf(G_ATCmdBuf, "%c%c" _F8_, HOST_APP_ESC_CHAR, 'H', cid);
+				ATLIB_CMD_START (HOST_APP_ESC_STR "H");
+				AtLib_CmdNum (cid);
 				/* Now send the data START indication message  to S2w node */
-				GS_HAL_send((uint8_t *) G_ATCmdBuf, 3);
+				GS_HAL_send((uint8_t *) G_ATCmdBuf, G_ATCmdLen);
 				/* Now send the actual data */
 				GS_HAL_send((uint8_t *) txBuf, size);
         	}
@@ -4298,7 +5278,7 @@ AtLib_GetTime(void)
 {
     HOST_APP_MSG_ID_E rxMsgId;
 
-    sprintf(G_ATCmdBuf, "AT+GETTIME=?\r\n");
+    ATLIB_CMD_START ("AT+GETTIME=?\r\n");
     rxMsgId = AtLib_CommandSend();
 
     return rxMsgId;
@@ -4322,7 +5302,11 @@ AtLib_SetGPIO( ATLIB_GPIO_PIN_E gpio,
 {
     HOST_APP_MSG_ID_E rxMsgId;
 
-    sprintf(G_ATCmdBuf, "AT+DGPIO=" _F16_ "," _F8_ "\r\n", gpio, state);
+    ATLIB_CMD_START ("AT+DGPIO=");
+    AtLib_CmdNum (gpio);
+    ATLIB_CMD_LIT (",");
+    AtLib_CmdNum (state);
+    ATLIB_CMD_LIT ("\r\n");
 
     rxMsgId = AtLib_CommandSend();
 
@@ -4346,7 +5330,7 @@ AtLib_GetCIDInfo(void)
 {
     HOST_APP_MSG_ID_E rxMsgId;
     /* TODO: Parse CID response! */
-    sprintf(G_ATCmdBuf, "AT+CID=?\r\n");
+    ATLIB_CMD_START ("AT+CID=?\r\n");
 
     rxMsgId = AtLib_CommandSend();
 
@@ -4370,7 +5354,9 @@ AtLib_WLanKeepalive(uint32_t seconds)
 {
     HOST_APP_MSG_ID_E rxMsgId;
 
-    sprintf(G_ATCmdBuf, "AT+WKEEPALIVE=" _F32_ "\r\n", (int) seconds);
+    ATLIB_CMD_START ("AT+WKEEPALIVE=");
+    AtLib_CmdNum (seconds);
+    ATLIB_CMD_LIT ("\r\n");
 
     rxMsgId = AtLib_CommandSend();
 
@@ -4394,7 +5380,7 @@ AtLib_GetMemoryInfo(void)
 {
     HOST_APP_MSG_ID_E rxMsgId;
     /* TODO: Parse CID response! */
-    sprintf(G_ATCmdBuf, "AT+MEMTRACE/r/n");
+    ATLIB_CMD_START ("AT+MEMTRACE/r/n");
 
     rxMsgId = AtLib_CommandSend();
 
@@ -4420,7 +5406,9 @@ AtLib_SetPhyMode (uint32_t mode)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+WPHYMODE=" _F32_ "\r\n", (int) mode);
+  ATLIB_CMD_START ("AT+WPHYMODE=");
+  AtLib_CmdNum (mode);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -4447,7 +5435,9 @@ AtLib_SetAntennaConf (uint32_t mode)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+ANTENNA=" _F32_ "\r\n", (int) mode);
+  ATLIB_CMD_START ("AT+ANTENNA=");
+  AtLib_CmdNum (mode);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -4472,7 +5462,7 @@ AtLib_GetPhyMode(void)
 {
     HOST_APP_MSG_ID_E rxMsgId;
 
-    sprintf(G_ATCmdBuf, "AT+WPHYMODE=?\r\n");
+    ATLIB_CMD_START ("AT+WPHYMODE=?\r\n");
 
     rxMsgId = AtLib_CommandSend();
 
@@ -4498,7 +5488,9 @@ AtLib_EnableSoftFlowControl (uint32_t mode)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT&K" _F32_ "\r\n", (int) mode);
+  ATLIB_CMD_START ("AT&K");
+  AtLib_CmdNum (mode);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -4525,7 +5517,11 @@ AtLib_PsPoll (uint32_t mode, uint32_t interval)
   HOST_APP_MSG_ID_E rxMsgId;
 
   /* Construct the AT command */
-  sprintf (G_ATCmdBuf, "AT+WIEEEPSPOLL=" _F32_ "," _F32_ "\r\n", (int) mode, (int) interval);
+  ATLIB_CMD_START ("AT+WIEEEPSPOLL=");
+  AtLib_CmdNum (mode);
+  ATLIB_CMD_LIT (",");
+  AtLib_CmdNum (interval);
+  ATLIB_CMD_LIT ("\r\n");
 
   /* Send command to S2w App node */
   rxMsgId = AtLib_CommandSend ();
@@ -4559,10 +5555,17 @@ HOST_APP_MSG_ID_E AtLib_SetSocketOptions(
     const uint16_t length = 4;
     HOST_APP_MSG_ID_E rxMsgId;
 
-    sprintf(
-    		G_ATCmdBuf,
-            "AT+SETSOCKOPT=" _F8_ "," _F16_ "," _F16_ "," _F32_ "," _F16_ "\r\n",
-            cid, type, param, (int) value, length);
+    ATLIB_CMD_START ("AT+SETSOCKOPT=");
+    AtLib_CmdNum (cid);
+    ATLIB_CMD_LIT (",");
+    AtLib_CmdNum (type);
+    ATLIB_CMD_LIT (",");
+    AtLib_CmdNum (param);
+    ATLIB_CMD_LIT (",");
+    AtLib_CmdNum (value);
+    ATLIB_CMD_LIT (",");
+    AtLib_CmdNum (length);
+    ATLIB_CMD_LIT ("\r\n");
 
     rxMsgId = AtLib_CommandSend();
 
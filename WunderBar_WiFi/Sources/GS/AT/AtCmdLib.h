@@ -16,6 +16,7 @@
 #define  HOST_APP_TCP_CLIENT_CID_OFFSET_BYTE        (8)  /* CID parameter offset in TCP connection response */
 #define  HOST_APP_UDP_CLIENT_CID_OFFSET_BYTE        (8)  /* CID parameter offset in UDP connection response */
 #define  HOST_APP_BULK_DATA_LEN_STRING_SIZE         (4)  /* Number of octets representing the data lenght field in bulk data transfer message */
+#define  HOST_APP_BULK_DATA_MAX_SIZE             (1400)  /* Maximum number of data octets in one bulk data transfer message */
 #define  HOST_APP_RAW_DATA_STRING_SIZE_MAX          (4)  /* Number of octets representing the data lenght field in raw data transfer message*/
 #define  HOST_APP_HTTP_RESP_DATA_LEN_STRING_SIZE    (4)  /* Number of octets representing the data lenght field in HTTP data transfer message*/
 #define  HOST_APP_INVALID_CID                    (0xFF) /* invalid CID */
@@ -180,9 +181,37 @@ typedef enum {
     ATLIBGS_HIGH = 1,
 } ATLIB_GPIO_STATE_E;
 
+/* One piece of data for scatter-gather transfer */
+typedef struct {
+    const uint8_t *pData;
+    uint32_t dataLen;
+} ATLIB_DATA_SPAN_T;
+
+/* Asynchronous command queue */
+#define ATLIB_CMD_QUEUE_SIZE           (8)      /* commands waiting to be sent */
+#define ATLIB_CMD_QUEUE_CMD_SIZE       (96)     /* longest command that can be queued */
+#define ATLIB_CMD_STATS_SIZE           (24)     /* different commands with latency statistics */
+#define ATLIB_CMD_NAME_SIZE            (12)
+
+/* Called when a queued batch of commands is done: response of the last
+   command, or of the first one which failed (rest of batch is dropped) */
+typedef void (*ATLIB_CMD_CALLBACK_T)(HOST_APP_MSG_ID_E rxMsgId, void *pArg);
+
+/* Latency statistics of one AT command, time from sending to response */
+typedef struct {
+    char name[ATLIB_CMD_NAME_SIZE];     /* command without parameters */
+    uint16_t count;
+    uint16_t errors;
+    uint16_t timeouts;
+    uint32_t lastTime;                  /* ms */
+    uint32_t maxTime;                   /* ms */
+    uint32_t totalTime;                 /* ms */
+} ATLIB_CMD_STATS_T;
+
 #define  HOST_APP_CR_CHAR          0x0D     /* octet value in hex representing Carriage return    */
 #define  HOST_APP_LF_CHAR          0x0A     /* octet value in hex representing Line feed             */
 #define  HOST_APP_ESC_CHAR         0x1B     /* octet value in hex representing application level ESCAPE sequence */
+#define  HOST_APP_ESC_STR          "\x1B"   /* ESCAPE character as string literal, to be joined with other literals */
 
 /* Special characters used for data mode handling */
 #define  HOST_APP_DATA_MODE_NORMAL_START_CHAR_S      'S'
@@ -212,6 +241,7 @@ typedef enum {
 #define HOST_APP_RX_CMD_MAX_SIZE             (512)
 #define HOST_APP_RX_IP_MAX_SIZE              (16)
 #define HOST_APP_RX_PORT_MAX_SIZE            (6)
+#define HOST_APP_RX_CHUNK_SIZE               (128)    /* bytes read from UART at once */
 
 
 
@@ -223,6 +253,7 @@ typedef enum {
 HOST_APP_MSG_ID_E AtLib_CommandSend(void);
 HOST_APP_MSG_ID_E AtLibGs_Check(void);
 HOST_APP_MSG_ID_E AtLibGs_SetEcho(uint8_t mode);
+HOST_APP_MSG_ID_E AtLibGs_SetBaudRate(uint32_t baudRate);
 HOST_APP_MSG_ID_E AtLibGs_MACSet(int8_t *pAddr);
 HOST_APP_MSG_ID_E AtLibGs_CalcNStorePSK(int8_t *pSsid, int8_t *pPsk);
 HOST_APP_MSG_ID_E AtLibGs_WlanConnStat(void);
@@ -348,6 +379,13 @@ HOST_APP_MSG_ID_E AtLibGs_Ping(
         char payload[]);
 HOST_APP_MSG_ID_E AtLib_CommandSend(void);
 void AtLib_CommandSendNoResponse(void);
+void AtLib_CommandQueueStart(uint32_t timeout, ATLIB_CMD_CALLBACK_T callback, void *pArg);
+bool AtLib_CommandQueueEnd(void);
+bool AtLib_CommandQueueResponse(HOST_APP_MSG_ID_E rxMsgId);
+void AtLib_CommandQueueTask(void);
+void AtLib_CommandQueueWait(void);
+bool AtLib_CommandQueueIdle(void);
+uint8_t AtLib_GetCommandStats(const ATLIB_CMD_STATS_T **ppStats);
 void AtLib_DataSend(const uint8_t *pTxData, uint32_t dataLen);
 bool AtLib_SendTcpData(uint8_t cid, const uint8_t *txBuf, uint32_t dataLen);
 void AtLib_SendUdpData(
@@ -363,10 +401,12 @@ HOST_APP_MSG_ID_E AtLib_SetSocketOptions(uint8_t cid, ATLIB_SOCKET_OPTION_TYPE_E
 HOST_APP_MSG_ID_E AtLib_Ping(uint8_t ip[], uint16_t trails, uint16_t timeout, uint16_t len, uint8_t tos, uint8_t ttl, uint8_t payload[]);
 
 HOST_APP_MSG_ID_E AtLib_BulkDataTransfer(uint8_t cid, const uint8_t *pData, uint32_t dataLen);
+HOST_APP_MSG_ID_E AtLib_BulkDataTransferSpans(uint8_t cid, const ATLIB_DATA_SPAN_T *pSpans, uint8_t numSpans);
 HOST_APP_MSG_ID_E AtLib_UdpServerBulkDataTransfer(uint8_t cid, char *ipAddress, char *port, const uint8_t *pData, uint32_t dataLen);
 HOST_APP_MSG_ID_E AtLib_checkEOFMessage(const uint8_t * pBuffer);
 void AtLib_ReceiveDataHandle(void);
 HOST_APP_MSG_ID_E AtLib_ReceiveDataProcess(uint8_t rxData);
+HOST_APP_MSG_ID_E AtLib_ReceiveChunk(uint32_t *pRead);
 HOST_APP_MSG_ID_E AtLib_ResponseHandle(void);
 HOST_APP_MSG_ID_E AtLib_ResponseHandleNoBlock(void);
 HOST_APP_MSG_ID_E AtLib_ProcessRxChunk(const uint8_t *rxBuf, uint32_t bufLen);
@@ -374,7 +414,7 @@ HOST_APP_MSG_ID_E AtLib_SSLClose(uint8_t cid);
 HOST_APP_MSG_ID_E AtLib_SSLOpen(uint8_t cid, char caName[]);
 HOST_APP_MSG_ID_E AtLib_DeleteSSLCertificate(char name[]);
 HOST_APP_MSG_ID_E AtLib_AddSSLCertificate(char name[], bool hex, uint16_t size, bool ram, char* cert);
-void AtLib_ProcessIncomingData(uint8_t cid, uint8_t rxData);
+uint32_t AtLib_ProcessIncomingData(uint8_t cid, const uint8_t *pData, uint32_t dataLen);
 void AtLib_LinkCheck(void);
 void AtLib_FlushIncomingMessage(void);
 uint8_t AtLib_IsNodeResetDetected(void);
@@ -399,13 +439,14 @@ uint8_t AtLib_GetUdpCid(void);
 void AtLib_FlushRxBuffer(void);
 int32_t AtLib_strcasecmp(const char *s1, const char *s2);
 void AtLib_ConvertNumberTo4DigitASCII(uint32_t myNum, int8_t *pStr);
+uint8_t AtLib_getCidFromAscii(uint8_t cidAscii);
 
 extern void AtLib_Init(void);
 
 void AtLib_ProcessCompletedHttpBulkTransferEvent (uint8_t cid);
 void AtLib_ProcessCompletedBulkTransferEvent(uint8_t cid);
 // User supplied routines
-extern void App_ProcessIncomingData(uint8_t cid, uint8_t rxData);
+extern uint32_t App_ProcessIncomingData(uint8_t cid, const uint8_t *pData, uint32_t dataLen);
 extern void App_ProcessCompletedBulkTransferEvent(uint8_t cid);
 extern void App_ProcessCompletedHttpBulkTransferEvent(uint8_t cid);
 
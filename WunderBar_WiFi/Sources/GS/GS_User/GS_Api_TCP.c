@@ -97,6 +97,26 @@ bool GS_Api_TCP_Send(char cid, char* send_buff, int send_buff_len){
   	return false;
 }
 
+/**
+*  @brief  Sends data gathered from several buffers over established TCP socket
+*
+*  All pieces are sent as one packet, without copying them into one buffer.
+*
+*  @param  Connection id
+*  @param  Data pieces
+*  @param  Number of pieces
+*
+*  @return True or false for successful transmission
+*/
+bool GS_Api_TCP_SendSpans(char cid, const ATLIB_DATA_SPAN_T* spans, uint8_t numSpans){
+
+	// Check for a valid Client Connection
+	if(cid != GS_API_INVALID_CID)
+		return GS_API_SendTcpDataSpans((uint8_t) cid, spans, numSpans);
+
+	return false;
+}
+
 /**
 *  @brief  Starts TCP client on desired server IP and port.
 *
@@ -88,3 +88,16 @@ void GS_Api_Http_Open(uint8_t* cid, char* host, int hostPort, GS_API_DataHandler
 *  @return True or false for successful transmission
 */
 bool GS_Api_TCP_Send(char cid, char* send_buff, int send_buff_len);
+
+/**
+*  @brief  Sends data gathered from several buffers over established TCP socket
+*
+*  All pieces are sent as one packet, without copying them into one buffer.
+*
+*  @param  Connection id
+*  @param  Data pieces
+*  @param  Number of pieces
+*
+*  @return True or false for successful transmission
+*/
+bool GS_Api_TCP_SendSpans(char cid, const ATLIB_DATA_SPAN_T* spans, uint8_t numSpans);
@@ -25,7 +25,7 @@ static char* HttpBufferPtr = HttpBuffer;      		// pointer to TimeServerBuffer
 
 static char GS_Http_Status = 0;
 
-static void GS_Http_DataHandler(uint8_t cid, uint8_t data);
+static uint32_t GS_Http_DataHandler(uint8_t cid, const uint8_t* data, uint32_t len);
 static void GS_Http_ResetIncomingBuffer();
 static bool GS_Http_IsValidCid(uint8_t cid);
 static bool GS_Http_SetHttp(char* serverIp);
@@ -153,17 +153,26 @@ bool GS_Http_LoadTime(){
 /**
 *  @brief  Handles incoming data for the TCP Client
 *
-*  Just fills byte per byte incoming bytes from http connection
+*  Just fills incoming bytes from http connection into buffer,
+*  bytes which do not fit are dropped.
 *
 *  @param  Connection ID
-*  @param  Byte received
+*  @param  Data received
+*  @param  Number of bytes received
 *
-*  @return void
+*  @return Number of bytes taken (all)
 */
-static void GS_Http_DataHandler(uint8_t cid, uint8_t data){
+static uint32_t GS_Http_DataHandler(uint8_t cid, const uint8_t* data, uint32_t len){
+	uint32_t room = HTPP_BUFFER_LENGTH - (HttpBufferPtr - &HttpBuffer[0]);
+	uint32_t n = len;
+
 	// Save the data to the buffer
-	if ((HttpBufferPtr - &HttpBuffer[0]) < HTPP_BUFFER_LENGTH)
-		*HttpBufferPtr ++ = data;
+	if (n > room)
+		n = room;
+
+	memcpy(HttpBufferPtr, data, n);
+	HttpBufferPtr += n;
+	return len;
 }
 
 /**
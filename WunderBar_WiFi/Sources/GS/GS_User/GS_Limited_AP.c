@@ -6,6 +6,8 @@
  *  @bug    No known bugs.
  */
 
+#include <string.h>
+
 #include "../AT/AtCmdLib.h"
 #include "GS_Api_TCP.h"
 #include "GS_Limited_AP.h"
@@ -22,7 +24,7 @@ static uint8_t Limitted_AP_buffer[LIMITED_AP_BUF_MAX_SIZE];
 static uint8_t*  Limitted_AP_bufferPtr = Limitted_AP_buffer;
 
 
-void GS_TCP_Server_HandleData(uint8_t cid, uint8_t data);
+uint32_t GS_TCP_Server_HandleData(uint8_t cid, const uint8_t* data, uint32_t len);
 
 
 
@@ -183,14 +185,24 @@ char* GS_LAP_GetBuffer(){
 /**
 *  @brief  Handles incoming data for the TCP Server
 *
-*  Receives bulk data from tcp client and stores them in buffer.
+*  Receives bulk data from tcp client and stores them in buffer,
+*  bytes which do not fit are dropped.
 *
 *  @param  Connection ID
-*  @param  Byte received
+*  @param  Data received
+*  @param  Number of bytes received
 *
-*  @return void
+*  @return Number of bytes taken (all)
 */
-void GS_TCP_Server_HandleData(uint8_t cid, uint8_t data){
+uint32_t GS_TCP_Server_HandleData(uint8_t cid, const uint8_t* data, uint32_t len){
+	uint32_t room = LIMITED_AP_BUF_MAX_SIZE - (Limitted_AP_bufferPtr - Limitted_AP_buffer);
+	uint32_t n = len;
+
 	// Save the data to the line buffer
-	*Limitted_AP_bufferPtr++ = data;
+	if (n > room)
+		n = room;
+
+	memcpy(Limitted_AP_bufferPtr, data, n);
+	Limitted_AP_bufferPtr += n;
+	return len;
 }
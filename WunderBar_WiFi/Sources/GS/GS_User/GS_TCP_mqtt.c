@@ -9,26 +9,79 @@
 
 #include <string.h>
 
+#include <hardware/Hw_modules.h>
+#include <Common_Defaults.h>
+
 #include "GS_Api_TCP.h"
 #include "GS_User.h"
+#include "GS_TCP_mqtt.h"
 
 
 // static declarations
 
+#if (MQTT_RX_RING_SIZE & (MQTT_RX_RING_SIZE - 1)) || (MQTT_RX_PACKETS & (MQTT_RX_PACKETS - 1))
+#error "MQTT_RX_RING_SIZE and MQTT_RX_PACKETS must be power of two"
+#endif
+
+#define MQTT_RX_RING_MASK		(MQTT_RX_RING_SIZE - 1)
+
+typedef enum {
+	RX_STATE_TYPE,					// waiting for first byte of fixed header
+	RX_STATE_LENGTH,				// decoding remaining length
+	RX_STATE_WAIT,					// fixed header decoded, waiting for room in ring
+	RX_STATE_BODY,					// storing packet body
+	RX_STATE_SKIP,					// skipping body of packet bigger than ring
+	RX_STATE_ERROR					// malformed stream, connection should be closed
+} TCP_Rx_State_t;
+
+typedef struct {
+	uint16_t offset;				// packet start in ring
+	uint16_t len;
+	uint32_t end;					// ring position after the packet (free running)
+} TCP_Incoming_Packet_t;
+
 typedef struct {
-	uint8_t  line[1500];
-	uint16_t currentWritePos;
-	uint16_t currentReadPos;
-	uint16_t totalData;
-	uint16_t lastSuccessPos;
-	uint8_t  busy;
+	uint8_t  line[MQTT_RX_RING_SIZE];
+	uint32_t head;					// write position (free running, masked on access)
+	uint32_t tail;					// end of last released packet (free running)
+	TCP_Incoming_Packet_t packets[MQTT_RX_PACKETS];
+	uint8_t  packetHead;			// complete packets (free running)
+	uint8_t  packetTail;			// released packets (free running)
+	uint8_t  busy;					// packet is handed out and not released yet
+
+	// stream decoder state, kept between received bytes
+	uint8_t  state;
+	uint8_t  header[5];				// fixed header, kept aside until packet length is known
+	uint8_t  headerLen;
+	uint32_t multiplier;
+	uint32_t remaining;
+	uint32_t packetStart;
+
+	uint32_t received;
+	uint32_t dropped;
+	uint32_t stalls;				// data left in GS uart until packets were released
 } TCP_Incoming_Buffer_t;
 
+typedef struct {
+	uint8_t  line[MQTT_TX_BATCH_MAX_BYTES];
+	uint16_t len;
+	uint8_t  active;
+	uint8_t  failed;				// sending failed while batch was open
+	unsigned long long int firstPacketTime;
+	uint32_t packets;
+	uint32_t frames;
+} TCP_Outgoing_Batch_t;
+
 static TCP_Incoming_Buffer_t Client_TCP_Buffer;          // Buffer to store data that comes from mqtt server
+static TCP_Outgoing_Batch_t  Client_TCP_Batch;           // Packets waiting to be sent in one bulk transfer
 static uint8_t tcpClientCID = GS_API_INVALID_CID; 		///< Connection ID for TCP client
 
-static void GS_TCP_mqtt_HandleTcpClientData(uint8_t cid, uint8_t data);
-static void GS_TCP_mqtt_ResetIncomingBuffer(unsigned int* count);
+static uint32_t GS_TCP_mqtt_HandleTcpClientData(uint8_t cid, const uint8_t* data, uint32_t len);
+static bool GS_TCP_mqtt_StartPacket();
+static bool GS_TCP_mqtt_ReservePacket(uint32_t len);
+static void GS_TCP_mqtt_EndPacket();
+static bool GS_TCP_mqtt_SendSpans(const ATLIB_DATA_SPAN_T* spans, uint8_t numSpans);
+static bool GS_TCP_mqtt_BatchFlush();
 
 
 	///////////////////////////////////////
@@ -38,76 +91,83 @@ static void GS_TCP_mqtt_ResetIncomingBuffer(unsigned int* count);
 
 
 /**
-*  @brief  Get remaining bytes in tcp buffer
+*  @brief  Gets oldest received mqtt packet
+*
+*  Packet is complete and contiguous, and it stays in the ring buffer (no copy)
+*  until GS_TCP_mqtt_ReleasePacket is called. Only one packet can be taken at a time,
+*  so nested call (while packet is processed) returns false.
+*
+*  @param  Return pointer to packet
+*  @param  Return packet length
 *
-*  @return Bytes left for reading
+*  @return True if packet is available
 */
-int GS_TCP_mqtt_GetRemBytes(){
-	return ((int) (Client_TCP_Buffer.totalData - Client_TCP_Buffer.currentReadPos));
+bool GS_TCP_mqtt_GetPacket(char** packet, int* len){
+	TCP_Incoming_Packet_t* pkt;
+
+	if ((Client_TCP_Buffer.busy) || (Client_TCP_Buffer.packetHead == Client_TCP_Buffer.packetTail))
+		return false;
+
+	pkt = &Client_TCP_Buffer.packets[Client_TCP_Buffer.packetTail & (MQTT_RX_PACKETS - 1)];
+
+	*packet = (char *) &Client_TCP_Buffer.line[pkt->offset];
+	*len = pkt->len;
+	Client_TCP_Buffer.busy = 1;
+
+	return true;
 }
 
 /**
-*  @brief  Set last successful position
+*  @brief  Releases packet taken by GS_TCP_mqtt_GetPacket
 *
-*  Set last successful read position when complete mqtt package is read.
-*  Next mqtt process should go from this position.
+*  Its space in ring buffer can be used for new data.
 *
 *  @return void
 */
-void GS_TCP_mqtt_UpdatePtr(){
-	Client_TCP_Buffer.lastSuccessPos = Client_TCP_Buffer.currentReadPos;
+void GS_TCP_mqtt_ReleasePacket(){
+	if (Client_TCP_Buffer.busy == 0)
+		return;
+
+	Client_TCP_Buffer.tail = Client_TCP_Buffer.packets[Client_TCP_Buffer.packetTail & (MQTT_RX_PACKETS - 1)].end;
+	Client_TCP_Buffer.packetTail ++;
+	Client_TCP_Buffer.busy = 0;
 }
 
 /**
 *  @brief  Reset incoming buffer
 *
-*  Reset incoming buffer. Check if there are unprocessed bytes and copy them at the begging of the buffer.
-*  This will happen only if mqtt package has been split into two tcp packages.
+*  Drops all received data and resets stream decoder. Used when new connection is opened.
 *
 *  @return void
 */
 void GS_TCP_mqtt_ResetBuffer(){
-	int bytesRem;
-
-	bytesRem = Client_TCP_Buffer.totalData - Client_TCP_Buffer.lastSuccessPos;
-
-	if (bytesRem > 0)
-		memcpy((void *) &Client_TCP_Buffer.line[0], (const void *) &Client_TCP_Buffer.line[Client_TCP_Buffer.lastSuccessPos], bytesRem);
-
-	Client_TCP_Buffer.currentWritePos = bytesRem;
-	Client_TCP_Buffer.currentReadPos = 0;
-	Client_TCP_Buffer.totalData = bytesRem;
-	Client_TCP_Buffer.lastSuccessPos = 0;
-	Client_TCP_Buffer.busy  = 0;
+	uint32_t received = Client_TCP_Buffer.received;
+	uint32_t dropped  = Client_TCP_Buffer.dropped;
+	uint32_t stalls   = Client_TCP_Buffer.stalls;
+
+	memset((void *) &Client_TCP_Buffer, 0, sizeof(Client_TCP_Buffer));
+	Client_TCP_Buffer.received = received;
+	Client_TCP_Buffer.dropped  = dropped;
+	Client_TCP_Buffer.stalls   = stalls;
 }
 
 /**
-*  @brief  Reads data from library input buffer
+*  @brief  Gets incoming packets statistics
 *
-*  Read desired number of bytes from input buffer.
+*  Dropped packets are bigger than ring buffer and were skipped whole, so stream stayed in sync.
+*  Packets which only have to wait for room are not dropped, data is left in GS uart (stall)
+*  until mqtt client releases processed packets.
 *
-*  @param  Pointer to destination buffer
-*  @param  Number of bytes to read
+*  @param  Return number of received mqtt packets
+*  @param  Return number of dropped mqtt packets
+*  @param  Return number of stalls
 *
-*  @return Number of bytes read
+*  @return void
 */
-int GS_TCP_mqtt_GetData(char* buf, int count){
-	int data = 0;
-	// break if there is no enough bytes in buffer (next tcp packet should arrive promptly)
-	if (count > GS_TCP_mqtt_GetRemBytes())
-		return 0;
-
-	// read requested number of bytes
-	while (count --)
-	{
-		if (Client_TCP_Buffer.currentReadPos <= Client_TCP_Buffer.totalData)
-		{
-			*buf ++ = Client_TCP_Buffer.line[Client_TCP_Buffer.currentReadPos ++];
-			data ++;
-		}
-	}
-
-	return data;
+void GS_TCP_mqtt_GetRxStats(uint32_t* packets, uint32_t* dropped, uint32_t* stalls){
+	*packets = Client_TCP_Buffer.received;
+	*dropped = Client_TCP_Buffer.dropped;
+	*stalls  = Client_TCP_Buffer.stalls;
 }
 
 /**
@@ -127,6 +187,8 @@ char GS_TCP_mqtt_GetClientCID(){
 *  @return void
 */
 void GS_TCP_mqtt_Disconnect(){
+	Client_TCP_Batch.len = 0;			// drop packets not sent yet
+
 	if (tcpClientCID != GS_API_INVALID_CID)
 	{
 		GS_API_CloseSSLconnection(tcpClientCID);
@@ -147,6 +209,9 @@ void GS_TCP_mqtt_Disconnect(){
 */
 bool GS_TCP_mqtt_StartTcpTask(char* server_ip, char* server_port){
 
+	Client_TCP_Batch.len = 0;
+	GS_TCP_mqtt_ResetBuffer();
+
 	GS_Api_TCP_StartTcpClient((char*) &tcpClientCID, server_ip, server_port, GS_TCP_mqtt_HandleTcpClientData);
 
 	if(tcpClientCID != GS_API_INVALID_CID){
@@ -167,40 +232,142 @@ bool GS_TCP_mqtt_StartTcpTask(char* server_ip, char* server_port){
 *  @return True or false depending on successful action
 */
 bool GS_Api_mqtt_SendPacket(char* buf, int buflen){
+	ATLIB_DATA_SPAN_T span;
 
-	if (GS_Api_TCP_Send((char) tcpClientCID, buf, buflen) == false)
-	{
-		GS_API_CommWorking();
-		GS_API_CommWorking();
+	span.pData   = (const uint8_t *) buf;
+	span.dataLen = buflen;
 
-		if (GS_Api_TCP_Send((char) tcpClientCID, buf, buflen) == false)
-		{
-			GS_Api_Disconnect(tcpClientCID);
-			GS_ProcessMqttDisconnect();
+	return GS_Api_mqtt_SendPacketSpans(&span, 1);
+}
+
+/**
+*  @brief  Send packet gathered from several buffers over TCP socket to mqtt server
+*
+*  Sends pieces of a package as one packet over established tcp connection.
+*  While batch is open (see GS_TCP_mqtt_BatchBegin), packet is only appended to the batch,
+*  and it is sent together with other packets when batch is full or closed.
+*  Otherwise packet is sent at once, after any packets still waiting in the batch.
+*
+*  @param  Packet pieces
+*  @param  Number of pieces
+*
+*  @return True or false depending on successful action
+*/
+bool GS_Api_mqtt_SendPacketSpans(const ATLIB_DATA_SPAN_T* spans, uint8_t numSpans){
+	uint32_t len = 0;
+	uint8_t i;
+
+	for (i = 0; i < numSpans; i ++)
+		len += spans[i].dataLen;
+
+	Client_TCP_Batch.packets ++;
+
+	// packet does not fit in the batch, send waiting packets first
+	if (Client_TCP_Batch.len + len > MQTT_TX_BATCH_MAX_BYTES)
+	{
+		if (GS_TCP_mqtt_BatchFlush() == false)
 			return false;
-		}
 	}
 
+	// packet bigger than batch, send it on its own
+	if (len > MQTT_TX_BATCH_MAX_BYTES)
+		return GS_TCP_mqtt_SendSpans(spans, numSpans);
+
+	if (Client_TCP_Batch.len == 0)
+		Client_TCP_Batch.firstPacketTime = MSTimerGet();
+
+	for (i = 0; i < numSpans; i ++)
+	{
+		memcpy((void *) &Client_TCP_Batch.line[Client_TCP_Batch.len], (const void *) spans[i].pData, spans[i].dataLen);
+		Client_TCP_Batch.len += spans[i].dataLen;
+	}
+
+	if (Client_TCP_Batch.active)
+		return true;
+
+	return GS_TCP_mqtt_BatchFlush();
+}
+
+/**
+*  @brief  Open batch of outgoing mqtt packets
+*
+*  Packets sent after this call are collected and sent in one bulk transfer,
+*  waiting for only one response from GS module.
+*
+*  @return void
+*/
+void GS_TCP_mqtt_BatchBegin(){
+	Client_TCP_Batch.active = 1;
+	Client_TCP_Batch.failed = 0;
+}
+
+/**
+*  @brief  Close batch of outgoing mqtt packets
+*
+*  Sends collected packets if MQTT_TX_BATCH_FLUSH_MS have passed since first of them
+*  was added, otherwise they wait for packets from next batch.
+*  Fails also if any bulk transfer failed while batch was open (batch was full).
+*
+*  @return True or false depending on successful action
+*/
+bool GS_TCP_mqtt_BatchEnd(){
+	Client_TCP_Batch.active = 0;
+
+	if (Client_TCP_Batch.failed)
+		return false;
+
+	if ((Client_TCP_Batch.len) && (MSTimerDelta(Client_TCP_Batch.firstPacketTime) >= MQTT_TX_BATCH_FLUSH_MS))
+		return GS_TCP_mqtt_BatchFlush();
+
 	return true;
 }
 
+/**
+*  @brief  Checks if collected packets are still waiting to be sent
+*
+*  @return True if batch is not sent yet
+*/
+bool GS_TCP_mqtt_BatchPending(){
+	return (Client_TCP_Batch.len != 0);
+}
+
+/**
+*  @brief  Gets outgoing packets statistics
+*
+*  Number of bulk transfers per number of packets shows
+*  how many round trips to GS module are saved by batching.
+*
+*  @param  Return number of mqtt packets sent
+*  @param  Return number of bulk transfers used for sending
+*
+*  @return void
+*/
+void GS_TCP_mqtt_GetTxStats(uint32_t* packets, uint32_t* frames){
+	*packets = Client_TCP_Batch.packets;
+	*frames  = Client_TCP_Batch.frames;
+}
+
 /**
 *  @brief  Process completed bulk transfer event.
 *
 *  Will be called when bulk data is completely received from matching cid.
 *  After this we should process data.
+*  If received stream is malformed, connection is closed.
 *
 *  @param  Connection id
 *
 *  @return True if successful
 */
 bool GS_Api_mqtt_CompletedBulkTransfer(uint8_t cid){
-	unsigned int cnt;
 
 	if (cid == tcpClientCID)
 	{
-		GS_TCP_mqtt_ResetIncomingBuffer(&cnt);
-		Client_TCP_Buffer.busy = 1;
+		if (Client_TCP_Buffer.state == RX_STATE_ERROR)
+		{
+			GS_TCP_mqtt_ResetBuffer();
+			GS_Api_Disconnect(tcpClientCID);
+			GS_ProcessMqttDisconnect();
+		}
 		return true;
 	}
 	return false;
@@ -219,39 +386,216 @@ bool GS_Api_mqtt_CompletedBulkTransfer(uint8_t cid){
 *  @brief  Handles incoming data for the TCP Client
 *
 *  All incoming data bytes over tcp will be stored in buffer for matching cid.
-*  Function will be called from AT lib and it will load byte per byte until reception is completed.
+*  Function will be called from AT lib with spans of received data until reception is completed.
+*  Mqtt fixed header is decoded on the fly, so packets can be split over any number of bulk transfers.
+*  Packet body is copied as a whole part of span (packet space in ring is contiguous).
+*  When there is no room for next packet, the rest of span is not taken and AT lib
+*  offers it again after mqtt client has released packets.
 *
 *  @param  Connection ID
-*  @param  Byte received
+*  @param  Data received
+*  @param  Number of bytes received
 *
-*  @return void
+*  @return Number of bytes taken
 */
-static void GS_TCP_mqtt_HandleTcpClientData(uint8_t cid, uint8_t data){
-	// Save the data to the line buffer
-	if (cid == tcpClientCID)
+static uint32_t GS_TCP_mqtt_HandleTcpClientData(uint8_t cid, const uint8_t* data, uint32_t len){
+	uint32_t n, used = 0;
+
+	if (cid != tcpClientCID)
+		return len;
+
+	while (true)
 	{
-		if (Client_TCP_Buffer.currentWritePos < 1500)
+		// fixed header is decoded: packet is started as soon as there is room for it
+		// (packet without body is queued at once), until then the rest stays in GS uart
+		if ((Client_TCP_Buffer.state == RX_STATE_WAIT) && (GS_TCP_mqtt_StartPacket() == false))
+		{
+			Client_TCP_Buffer.stalls ++;
+			return used;
+		}
+
+		if (used == len)
+			return used;
+
+		switch (Client_TCP_Buffer.state)
 		{
-			Client_TCP_Buffer.line[Client_TCP_Buffer.currentWritePos++] = data;
-			Client_TCP_Buffer.totalData = 0;
+		case RX_STATE_TYPE :
+			Client_TCP_Buffer.header[0] = *data;
+			Client_TCP_Buffer.headerLen = 1;
+			Client_TCP_Buffer.remaining = 0;
+			Client_TCP_Buffer.multiplier = 1;
+			Client_TCP_Buffer.state = RX_STATE_LENGTH;
+			n = 1;
+			break;
+
+		case RX_STATE_LENGTH :
+			Client_TCP_Buffer.header[Client_TCP_Buffer.headerLen ++] = *data;
+			Client_TCP_Buffer.remaining += (*data & 127) * Client_TCP_Buffer.multiplier;
+			Client_TCP_Buffer.multiplier *= 128;
+
+			if ((*data & 128) == 0)
+				Client_TCP_Buffer.state = RX_STATE_WAIT;
+			else if (Client_TCP_Buffer.headerLen == sizeof(Client_TCP_Buffer.header))
+				Client_TCP_Buffer.state = RX_STATE_ERROR;		// remaining length has more than 4 bytes
+			n = 1;
+			break;
+
+		case RX_STATE_BODY :
+			n = (len - used < Client_TCP_Buffer.remaining) ? len - used : Client_TCP_Buffer.remaining;
+			memcpy((void *) &Client_TCP_Buffer.line[Client_TCP_Buffer.head & MQTT_RX_RING_MASK], (const void *) data, n);
+			Client_TCP_Buffer.head += n;
+			Client_TCP_Buffer.remaining -= n;
+			if (Client_TCP_Buffer.remaining == 0)
+				GS_TCP_mqtt_EndPacket();
+			break;
+
+		case RX_STATE_SKIP :
+			n = (len - used < Client_TCP_Buffer.remaining) ? len - used : Client_TCP_Buffer.remaining;
+			Client_TCP_Buffer.remaining -= n;
+			if (Client_TCP_Buffer.remaining == 0)
+				Client_TCP_Buffer.state = RX_STATE_TYPE;
+			break;
+
+		default :
+			return len;							// malformed stream, data is dropped
 		}
+
+		data += n;
+		used += n;
+	}
+}
+
+/**
+*  @brief  Starts packet which fixed header is decoded
+*
+*  If there is no room for the packet, received packets are processed first
+*  (mqtt client releases them). Packet bigger than ring is dropped (instead of
+*  being truncated).
+*
+*  @return False if packet has to wait for room
+*/
+static bool GS_TCP_mqtt_StartPacket(){
+	uint32_t len = Client_TCP_Buffer.headerLen + Client_TCP_Buffer.remaining;
+
+	if (len > MQTT_RX_RING_SIZE)
+	{
+		Client_TCP_Buffer.dropped ++;
+		Client_TCP_Buffer.state = RX_STATE_SKIP;
+		return true;
+	}
+
+	if (GS_TCP_mqtt_ReservePacket(len) == false)
+	{
+		GS_ProcessMqttData();
+
+		if (GS_TCP_mqtt_ReservePacket(len) == false)
+			return false;
 	}
+
+	memcpy((void *) &Client_TCP_Buffer.line[Client_TCP_Buffer.head & MQTT_RX_RING_MASK],
+			(const void *) Client_TCP_Buffer.header, Client_TCP_Buffer.headerLen);
+	Client_TCP_Buffer.head += Client_TCP_Buffer.headerLen;
+
+	if (Client_TCP_Buffer.remaining)
+		Client_TCP_Buffer.state = RX_STATE_BODY;
+	else
+		GS_TCP_mqtt_EndPacket();
+	return true;
 }
 
 /**
-*  @brief  Resets library incoming buffer pointers
+*  @brief  Reserves space for packet
 *
-*  Reset buffer pointers and set total bytes in buffer available for read.
+*  Packet is stored contiguously, so if it does not fit before the end of ring,
+*  it starts from the beginning of ring.
 *
-*  @param  return value for number of bytes for reading
+*  @param  Packet length (fixed header included)
+*
+*  @return False if there is no room in ring or packet queue
+*/
+static bool GS_TCP_mqtt_ReservePacket(uint32_t len){
+	uint32_t offset, pad = 0;
+
+	// ring is empty, start from its beginning
+	if (Client_TCP_Buffer.head == Client_TCP_Buffer.tail)
+		Client_TCP_Buffer.head = Client_TCP_Buffer.tail = 0;
+
+	offset = Client_TCP_Buffer.head & MQTT_RX_RING_MASK;
+
+	if (offset + len > MQTT_RX_RING_SIZE)
+		pad = MQTT_RX_RING_SIZE - offset;
+
+	if ((Client_TCP_Buffer.head + pad + len - Client_TCP_Buffer.tail > MQTT_RX_RING_SIZE) ||
+			((uint8_t) (Client_TCP_Buffer.packetHead - Client_TCP_Buffer.packetTail) >= MQTT_RX_PACKETS))
+		return false;
+
+	Client_TCP_Buffer.head += pad;
+	Client_TCP_Buffer.packetStart = Client_TCP_Buffer.head;
+	return true;
+}
+
+/**
+*  @brief  Queues completely received packet
 *
 *  @return void
 */
-static void GS_TCP_mqtt_ResetIncomingBuffer(unsigned int* count){
-	Client_TCP_Buffer.totalData = Client_TCP_Buffer.currentWritePos;
+static void GS_TCP_mqtt_EndPacket(){
+	TCP_Incoming_Packet_t* pkt = &Client_TCP_Buffer.packets[Client_TCP_Buffer.packetHead & (MQTT_RX_PACKETS - 1)];
+
+	pkt->offset = Client_TCP_Buffer.packetStart & MQTT_RX_RING_MASK;
+	pkt->len    = Client_TCP_Buffer.head - Client_TCP_Buffer.packetStart;
+	pkt->end    = Client_TCP_Buffer.head;
+
+	Client_TCP_Buffer.packetHead ++;
+	Client_TCP_Buffer.received ++;
+	Client_TCP_Buffer.state = RX_STATE_TYPE;
+}
+
+/**
+*  @brief  Sends collected packets in one bulk transfer
+*
+*  @return True or false depending on successful action
+*/
+static bool GS_TCP_mqtt_BatchFlush(){
+	ATLIB_DATA_SPAN_T span;
+
+	if (Client_TCP_Batch.len == 0)
+		return true;
+
+	span.pData   = Client_TCP_Batch.line;
+	span.dataLen = Client_TCP_Batch.len;
+	Client_TCP_Batch.len = 0;
 
-	Client_TCP_Buffer.currentWritePos = 0;
-	Client_TCP_Buffer.currentReadPos = 0;
+	return GS_TCP_mqtt_SendSpans(&span, 1);
+}
 
-	*count = Client_TCP_Buffer.totalData;
+/**
+*  @brief  Sends data over TCP socket to mqtt server
+*
+*  If sending fails, try again before considering socket dead.
+*
+*  @param  Data pieces
+*  @param  Number of pieces
+*
+*  @return True or false depending on successful action
+*/
+static bool GS_TCP_mqtt_SendSpans(const ATLIB_DATA_SPAN_T* spans, uint8_t numSpans){
+
+	Client_TCP_Batch.frames ++;
+
+	if (GS_Api_TCP_SendSpans((char) tcpClientCID, spans, numSpans) == false)
+	{
+		GS_API_CommWorking();
+		GS_API_CommWorking();
+
+		if (GS_Api_TCP_SendSpans((char) tcpClientCID, spans, numSpans) == false)
+		{
+			Client_TCP_Batch.failed = Client_TCP_Batch.active;
+			GS_Api_Disconnect(tcpClientCID);
+			GS_ProcessMqttDisconnect();
+			return false;
+		}
+	}
+
+	return true;
 }
@@ -7,6 +7,7 @@
  */
 
 #include <stdbool.h>
+#include "../API/GS_API.h"
 
 // public functions
 
@@ -35,6 +36,60 @@ bool GS_TCP_mqtt_StartTcpTask(char* server_ip, char* server_port);
 */
 bool GS_Api_mqtt_SendPacket(char* buf, int buflen);
 
+/**
+*  @brief  Send packet gathered from several buffers over TCP socket to mqtt server
+*
+*  Sends pieces of a package as one packet over established tcp connection.
+*  If sending fails, try again before considering socket dead.
+*
+*  @param  Packet pieces
+*  @param  Number of pieces
+*
+*  @return True or false depending on successful action
+*/
+bool GS_Api_mqtt_SendPacketSpans(const ATLIB_DATA_SPAN_T* spans, uint8_t numSpans);
+
+/**
+*  @brief  Open batch of outgoing mqtt packets
+*
+*  Packets sent after this call are collected and sent in one bulk transfer,
+*  waiting for only one response from GS module.
+*
+*  @return void
+*/
+void GS_TCP_mqtt_BatchBegin();
+
+/**
+*  @brief  Close batch of outgoing mqtt packets
+*
+*  Sends collected packets if MQTT_TX_BATCH_FLUSH_MS have passed since first of them
+*  was added, otherwise they wait for packets from next batch.
+*  Fails also if any bulk transfer failed while batch was open (batch was full).
+*
+*  @return True or false depending on successful action
+*/
+bool GS_TCP_mqtt_BatchEnd();
+
+/**
+*  @brief  Checks if collected packets are still waiting to be sent
+*
+*  @return True if batch is not sent yet
+*/
+bool GS_TCP_mqtt_BatchPending();
+
+/**
+*  @brief  Gets outgoing packets statistics
+*
+*  Number of bulk transfers per number of packets shows
+*  how many round trips to GS module are saved by batching.
+*
+*  @param  Return number of mqtt packets sent
+*  @param  Return number of bulk transfers used for sending
+*
+*  @return void
+*/
+void GS_TCP_mqtt_GetTxStats(uint32_t* packets, uint32_t* frames);
+
 /**
 *  @brief  Process completed bulk transfer event.
 *
@@ -45,7 +100,7 @@ bool GS_Api_mqtt_SendPacket(char* buf, int buflen);
 *
 *  @return True if successful
 */
-bool GS_Api_mqtt_CompletedBulkTransfer(char cid);
+bool GS_Api_mqtt_CompletedBulkTransfer(uint8_t cid);
 
 /**
 *  @brief  Gets pointer to current client CID for established TCP connection
@@ -64,40 +119,41 @@ char GS_TCP_mqtt_GetClientCID();
 void GS_TCP_mqtt_Disconnect();
 
 /**
-*  @brief  Reads data from library input buffer
+*  @brief  Gets oldest received mqtt packet
 *
-*  Read desired number of bytes from input buffer.
+*  Packet is complete and contiguous, and it stays in the ring buffer (no copy)
+*  until GS_TCP_mqtt_ReleasePacket is called. Only one packet can be taken at a time.
 *
-*  @param  Pointer to destination buffer
-*  @param  Number of bytes to read
+*  @param  Return pointer to packet
+*  @param  Return packet length
 *
-*  @return Number of bytes read
+*  @return True if packet is available
 */
-int  GS_TCP_mqtt_GetData(char* buf, int count);
+bool GS_TCP_mqtt_GetPacket(char** packet, int* len);
 
 /**
-*  @brief  Reset incoming buffer
-*
-*  Reset incoming buffer. Check if there are unprocessed bytes and copy them at the begging of the buffer.
-*  This will happen only if mqtt package has been split into two tcp packages.
+*  @brief  Releases packet taken by GS_TCP_mqtt_GetPacket
 *
 *  @return void
 */
-void GS_TCP_mqtt_ResetBuffer();
+void GS_TCP_mqtt_ReleasePacket();
 
 /**
-*  @brief  Get remaining bytes in tcp buffer
+*  @brief  Reset incoming buffer
+*
+*  Drops all received data and resets stream decoder. Used when new connection is opened.
 *
-*  @return Bytes left for reading
+*  @return void
 */
-int GS_TCP_mqtt_GetRemBytes();
+void GS_TCP_mqtt_ResetBuffer();
 
 /**
-*  @brief  Set last successful position
+*  @brief  Gets incoming packets statistics
 *
-*  Set last successful read position when complete mqtt package is read.
-*  Next mqtt process should go from this position.
+*  @param  Return number of received mqtt packets
+*  @param  Return number of dropped mqtt packets (bigger than ring buffer)
+*  @param  Return number of stalls (data left in GS uart until packets were released)
 *
 *  @return void
 */
-void GS_TCP_mqtt_UpdatePtr();
+void GS_TCP_mqtt_GetRxStats(uint32_t* packets, uint32_t* dropped, uint32_t* stalls);
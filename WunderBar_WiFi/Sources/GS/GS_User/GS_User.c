@@ -25,6 +25,9 @@
 #include "../../MQTT/MQTT_API_Client/MQTT_Api.h"
 #include "../../Onboarding/Onboarding.h"
 #include "../../Sensors/Sensors_main.h"
+#include "../../Sensors/Sensors_Spool.h"
+#include "../../Sensors/Sensors_SensID.h"
+#include "../../Sensors/My_Sensors/Sensors_common.h"
 
 
 
@@ -32,9 +35,25 @@
 
 static struct RepeatCounter_t {
 	unsigned long long int 	Time;
+	unsigned long long int 	Delay;						// current retry delay, 0 if not chosen yet
 	char          		    Cnt;
 } RepeatCounter;
 
+// fast reconnect, reuse everything from last connection which is still valid
+
+static struct Resume_t {
+	bool 					Fast;						// reconnecting with network, server ip, time and certificate of last connection
+	bool 					Connected;					// mqtt connection was established at least once
+	unsigned char 			FastTries;					// tcp/ssl attempts of current fast reconnect
+	uint8_t 				ServerIp[sizeof(wunderbar_configuration.cloud.ip)];	// server ip of last connection, empty if not known
+	unsigned long long int 	StartTime;					// time of disconnect (or boot)
+	unsigned long long int 	StateTime;					// time when current state is entered
+	unsigned int 			StateTimes[GS_MAIN_STATES];	// time spent in each state since StartTime
+	uint32_t 				Seed;						// retry delay jitter
+} Resume;
+
+static GS_Reconnect_Stats_t GS_ReconnectStats;
+
 
 static MainState_t MainState = GS_MAIN_STATE_INIT;
 static char GS_LimitedAP_mode_flag;
@@ -50,10 +69,15 @@ static bool GS_DNS_Resolve(char* url, char* ip);
 static char GS_RepeatCounter_GetCnt();
 static void GS_RepeatCounter_UpdateTime();
 static bool GS_Wait();
+static bool GS_WaitBackoff();
 static bool GS_Timeout(unsigned long long int timeout);
 static void GS_User_SM_SetState(MainState_t state);
 static void GS_SetLeds(bool led1, bool led2);
 static void GS_User_SetSystemTime(void);
+static void GS_User_FullReconnect();
+static void GS_User_PublishReconnectStats();
+static uint32_t GS_Random();
+static unsigned long long int GS_GetBackoff();
 
 
 
@@ -75,6 +99,9 @@ static void GS_User_SetSystemTime(void);
 void GS_Main_StateMachine(){
 
 	GS_API_CheckForData();
+	Sensors_Spool_Task();				// program spooled readings into flash, replay them when connected
+	Sensors_ProcessAggregation();		// publish summaries of expired aggregation windows
+	Sensors_ID_RetrySubList();			// subscribe again sensors with rejected or lost topics
 
 	switch (MainState){
 	// ------------------------------------------------------------------------------------ //
@@ -115,7 +142,9 @@ void GS_Main_StateMachine(){
 	// ------------------ attempt association to wifi network ----------------------------- //
 	case GS_MAIN_STATE_TRY_TO_CONNECT :
 
-		if (GS_Wait())
+		// network setup commands are sent in the background, join after they are done
+		// (reconnect attempts wait with increasing delay)
+		if (!GS_API_CommandsPending() && ((Resume.Connected) ? GS_WaitBackoff() : GS_Wait()))
 		{
 			if (GS_RepeatCounter_GetCnt() > GS_NUMBER_OF_RETRIES)		// if max retries, reset
 				CPU_System_Reset();
@@ -126,7 +155,12 @@ void GS_Main_StateMachine(){
 			if (GS_User_Join_Network() == true)							// Associate on wifi network
 			{
 				GS_SetLeds(false, true);								// set leds
-				GS_User_SM_SetState( GS_MAIN_STATE_GET_SERVER_TIME );	// go to the next state
+
+				// on fast reconnect time and certificate are still valid, go straight to mqtt server
+				if (Resume.Fast)
+					GS_User_SM_SetState( GS_MAIN_STATE_SWICH_TO_CLIENT_MODE );
+				else
+					GS_User_SM_SetState( GS_MAIN_STATE_GET_SERVER_TIME );	// go to the next state
 			}
 
 			GS_RepeatCounter_UpdateTime();
@@ -253,8 +287,16 @@ void GS_Main_StateMachine(){
 	// ------------------- try to open tcp connection on mqtt server ---------------------- //
 	case GS_MAIN_STATE_SWICH_TO_CLIENT_MODE :
 
-		if (GS_Timeout(GS_TRY_INTERVAL))					// try on every GS_TRY_INTERVAL miliseconds
+		// try on every GS_TRY_INTERVAL miliseconds, reconnect attempts wait with increasing delay
+		if ((Resume.Connected) ? GS_WaitBackoff() : GS_Timeout(GS_TRY_INTERVAL))
 		{
+			// if fast reconnect does not succeed, start over with dns, time and certificate
+			if ((Resume.Fast) && (++ Resume.FastTries > GS_NUMBER_OF_FAST_RETRIES))
+			{
+				GS_User_FullReconnect();
+				return;
+			}
+
 			// reset if max retries
 			if (GS_RepeatCounter_GetCnt() > GS_NUMBER_OF_RETRIES)
 				CPU_System_Reset();
@@ -385,7 +427,6 @@ void App_ProcessCompletedBulkTransferEvent(uint8_t cid){
 	if (GS_Api_mqtt_CompletedBulkTransfer(cid) == true)
 	{	// process mqtt data
 		MQTT_Api_OnCompletedBulkTransfer();
-		GS_TCP_mqtt_ResetBuffer();
 		return;
 	}
 
@@ -434,13 +475,32 @@ void GS_ProcessMqttConnect(){
 	Sensor_Cfg_Run();			// send signal to master ble device to start
 	GS_SetLeds(false, false);	// turn off leds
 	GS_HAL_ClearBuff();			// clear buffer
+
+	// close timing of this (re)connect
+	Resume.StateTimes[MainState] += MSTimerDelta(Resume.StateTime);
+	Resume.StateTime = MSTimerGet();
+
+	GS_ReconnectStats.connectTime = MSTimerDelta(Resume.StartTime);
+	memcpy(GS_ReconnectStats.stateTime, Resume.StateTimes, sizeof(GS_ReconnectStats.stateTime));
+	if (Resume.Fast)
+		GS_ReconnectStats.fastReconnects ++;
+	else if (Resume.Connected)
+		GS_ReconnectStats.fullReconnects ++;
+
+	if (Resume.Connected)
+		GS_User_PublishReconnectStats();
+
+	Resume.Connected = true;
+	Resume.Fast = false;
 }
 
 /**
 *  @brief  Process mqtt disconnect event
 *
 *  Should be called when ever mqtt disconnect is detected
-*  Closes socket and set new state
+*  Closes socket and set new state.
+*  Disconnect from client mode starts fast reconnect: network association,
+*  server ip, time and certificate of last connection are reused.
 *
 *  @return void
 */
@@ -454,12 +514,21 @@ void GS_ProcessMqttDisconnect(){
 	GS_TCP_mqtt_Disconnect();					// close connections
     GS_Api_CloseAll();
 
-	MSTimerDelay(5000);							// apply small delay
 	Sleep_Restore_Countdown();
 
 	GS_HAL_ClearBuff();							// clear rx buff
 	MQTT_Api_ResetMqtt(false);
 
+	// connection was up, start timing and fast reconnect (delay before first attempt is set by GS_Wait)
+	if (MainState == GS_MAIN_STATE_CLIENT_MODE)
+	{
+		Resume.StartTime = MSTimerGet();
+		Resume.StateTime = Resume.StartTime;
+		memset(Resume.StateTimes, 0, sizeof(Resume.StateTimes));
+		Resume.FastTries = 0;
+		Resume.Fast = true;
+	}
+
 	// check if the module is still associated on desired wifi network
 	if (GS_API_IsAssociated((uint8_t *) wunderbar_configuration.wifi.ssid) == true)
 		GS_User_SM_SetState( GS_MAIN_STATE_SWICH_TO_CLIENT_MODE );
@@ -467,6 +536,31 @@ void GS_ProcessMqttDisconnect(){
 		GS_User_SM_SetState( GS_MAIN_STATE_TRY_TO_CONNECT );
 }
 
+/**
+*  @brief  Process received mqtt packets
+*
+*  Called when incoming buffer is full in the middle of bulk transfer,
+*  so mqtt client makes room before the rest of data is received.
+*
+*  @return void
+*/
+void GS_ProcessMqttData(){
+	MQTT_Api_OnCompletedBulkTransfer();
+}
+
+/**
+*  @brief  Gets (re)connect timing
+*
+*  Times are of the last connection which is established (connack received).
+*
+*  @param  Return reconnect stats struct
+*
+*  @return void
+*/
+void GS_User_GetReconnectStats(GS_Reconnect_Stats_t* stats){
+	*stats = GS_ReconnectStats;
+}
+
 
 	///////////////////////////////////////
 	/*         static functions          */
@@ -500,13 +594,18 @@ static void GS_Load_Network_Parameters(HOST_APP_NETWORK_CONFIG_T *NetConf){
 *  destination ip   : wunderbar_configuration.cloud.ip
 *  destination port : MQTT_RELAYR_SERVER_PORT
 *
-*  if wunderbar_configuration.cloud.ip is empty, it will perform
-*  dns look up in order to resolve new server ip address.
+*  if wunderbar_configuration.cloud.ip is empty, it will use server ip
+*  of last connection on fast reconnect, or perform dns look up
+*  in order to resolve new server ip address.
 *
 *  @return True if successful
 */
 static bool GS_User_StartTCPTask(){
 
+	// on fast reconnect use ip of last connection
+	if ((wunderbar_configuration.cloud.ip[0] == 0xFF) && (Resume.Fast) && (Resume.ServerIp[0] != 0))
+		memcpy((void *) wunderbar_configuration.cloud.ip, Resume.ServerIp, sizeof(wunderbar_configuration.cloud.ip));
+
 	// if we do not have ip, do dns resolve
 	if (wunderbar_configuration.cloud.ip[0] == 0xFF)
 		if (GS_DNS_Resolve((char *) wunderbar_configuration.cloud.url, (char *) wunderbar_configuration.cloud.ip) == false)
@@ -568,11 +667,13 @@ static bool GS_DNS_Resolve(char* url, char* ip){
 *  @brief  Forget current IP
 *
 *  Delete ip address from ram, we do not need it any more.
-*  Before next connection we will do dns look up to get new ip
+*  Ip is kept only for fast reconnect, otherwise before next
+*  connection we will do dns look up to get new ip
 *
 *  @return void
 */
 static void GS_ForgetServerIp(){
+	memcpy(Resume.ServerIp, (const void *) wunderbar_configuration.cloud.ip, sizeof(Resume.ServerIp));
 	memset((void *) wunderbar_configuration.cloud.ip, (int) 0xFF, sizeof(wunderbar_configuration.cloud.ip));
 }
 
@@ -593,6 +694,94 @@ static void GS_User_SetSystemTime(){
 	RTC_SetTime(time);
 }
 
+/**
+*  @brief  Full reconnect
+*
+*  Fast reconnect failed. Drop server ip of last connection and
+*  go through association, dns look up, time and certificate again.
+*
+*  @return void
+*/
+static void GS_User_FullReconnect(){
+	GS_TCP_mqtt_Disconnect();
+	GS_Api_CloseAll();
+
+	memset(Resume.ServerIp, 0, sizeof(Resume.ServerIp));
+	Resume.Fast = false;
+
+	GS_User_SM_SetState( GS_MAIN_STATE_TRY_TO_CONNECT );
+}
+
+/**
+*  @brief  Publish reconnect timing
+*
+*  Message is published on main board status topic, see GS_Reconnect_Stats_t.
+*
+*  @return void
+*/
+static void GS_User_PublishReconnectStats(){
+	MQTT_User_Message_t MyMessage;
+	char topic[SENSOR_TOPIC_STR_SIZE];
+	char payload[MQTT_MSG_PAYLOAD_MAX];
+	char* ptr;
+	int i;
+
+	ptr = Sensors_Json_Str(topic, MQTT_TOPIC_PREFIX "/");
+	ptr = Sensors_Json_Str(ptr, (const char *) wunderbar_configuration.wunderbar.id);
+	ptr = Sensors_Json_Str(ptr, SENS_UP_STATUS);
+	MyMessage.topicStr = topic;
+	MyMessage.topiclen = ptr - topic;
+
+	ptr = Sensors_Json_Begin(payload);
+	ptr = Sensors_Json_Str(ptr, ",\"reconnect\":");
+	ptr = Sensors_Json_Int(ptr, (int32_t) GS_ReconnectStats.connectTime);
+	ptr = Sensors_Json_Str(ptr, ",\"fast\":");
+	ptr = Sensors_Json_Int(ptr, GS_ReconnectStats.fastReconnects);
+	ptr = Sensors_Json_Str(ptr, ",\"full\":");
+	ptr = Sensors_Json_Int(ptr, GS_ReconnectStats.fullReconnects);
+	ptr = Sensors_Json_Str(ptr, ",\"states\":[");
+	for (i = 0; i < GS_MAIN_STATES; i ++)
+	{
+		if (i)
+			ptr = Sensors_Json_Str(ptr, ",");
+		ptr = Sensors_Json_Int(ptr, (int32_t) GS_ReconnectStats.stateTime[i]);
+	}
+	ptr = Sensors_Json_Str(ptr, "]}");
+	MyMessage.payloadStr = payload;
+	MyMessage.payloadlen = ptr - payload;
+
+	MQTT_Api_Publish(&MyMessage);
+}
+
+/**
+*  @brief  Pseudo random number for retry delay jitter
+*
+*  Xorshift generator seeded with time and wunderbar id, so that devices
+*  which lost connection at the same time do not retry at the same time.
+*
+*  @return random number
+*/
+static uint32_t GS_Random(){
+	uint32_t x = Resume.Seed;
+	int i;
+
+	if (x == 0)
+	{
+		x = (uint32_t) MSTimerGet() ^ (uint32_t) RTC_GetTime() ^ 2166136261u;
+		for (i = 0; (i < sizeof(wunderbar_configuration.wunderbar.id)) && (wunderbar_configuration.wunderbar.id[i] != 0); i ++)
+			x = (x ^ wunderbar_configuration.wunderbar.id[i]) * 16777619u;
+		if (x == 0)
+			x = 1;
+	}
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	Resume.Seed = x;
+
+	return x;
+}
+
 /**
 *  @brief  Gets predefined delay depending on repeat counter
 *
@@ -609,6 +798,26 @@ static unsigned long long int GS_GetDelay(){
 		return (((unsigned long long int) DelayArr[sizeof(DelayArr) - 1]) * 1000);
 }
 
+/**
+*  @brief  Gets reconnect retry delay depending on repeat counter
+*
+*  Delay is doubled with every retry up to GS_BACKOFF_MAX,
+*  and random value between half and full delay is taken (jitter).
+*
+*  @return delay in milliseconds
+*/
+static unsigned long long int GS_GetBackoff(){
+	unsigned long long int delay = GS_BACKOFF_BASE;
+	char i;
+
+	for (i = 0; (i < RepeatCounter.Cnt) && (delay < GS_BACKOFF_MAX); i ++)
+		delay <<= 1;
+	if (delay > GS_BACKOFF_MAX)
+		delay = GS_BACKOFF_MAX;
+
+	return delay / 2 + GS_Random() % (delay / 2 + 1);
+}
+
 /**
 *  @brief  Increment repeat counter
 *
@@ -661,8 +870,29 @@ static bool GS_Timeout(unsigned long long int timeout){
 *  @return True if time passed, false if we still wait
 */
 static bool GS_Wait(){
-	if (MSTimerDelta(RepeatCounter.Time) > GS_GetDelay(RepeatCounter.Cnt))
+	if (MSTimerDelta(RepeatCounter.Time) > GS_GetDelay())
+	{
+		GS_RepeatCounter_IncrementCnt();
+		return 1;
+	}
+	else
+		return 0;
+}
+
+/**
+*  @brief  Wait for reconnect retry delay since last action before passing
+*
+*  Delay is chosen once per retry (see GS_GetBackoff).
+*
+*  @return True if time passed, false if we still wait
+*/
+static bool GS_WaitBackoff(){
+	if (RepeatCounter.Delay == 0)
+		RepeatCounter.Delay = GS_GetBackoff();
+
+	if (MSTimerDelta(RepeatCounter.Time) > RepeatCounter.Delay)
 	{
+		RepeatCounter.Delay = 0;
 		GS_RepeatCounter_IncrementCnt();
 		return 1;
 	}
@@ -694,6 +924,7 @@ static void GS_SetLeds(bool led1, bool led2){
 *  @brief  Set new state and updates time of last action
 *
 *  Set new desired state and update time of last action.
+*  Time spent in previous state is added to reconnect timing.
 *  If we are in Onboarding mode, avoid switching states.
 *  From onboarding we exit on reset.
 *
@@ -706,7 +937,10 @@ static void GS_User_SM_SetState(MainState_t state){
 	if (GS_LimitedAP_mode_flag == 0)
 	{
 		GS_RepeatCounter_UpdateTime();
+		Resume.StateTimes[MainState] += MSTimerDelta(Resume.StateTime);
+		Resume.StateTime = RepeatCounter.Time;
 		RepeatCounter.Cnt = 0;
+		RepeatCounter.Delay = 0;
 		MainState = state;
 	}
 }
@@ -20,6 +20,10 @@
 #define GS_NUMBER_OF_RETRIES  			10
 #define GS_NUMBER_OF_SSLOPEN_RETRIES 	GS_NUMBER_OF_RETRIES - 3           // must be less then GS_NUMBER_OF_RETRIES
 
+#define GS_BACKOFF_BASE					500			// first retry delay in miliseconds, doubled on every retry
+#define GS_BACKOFF_MAX					16000		// retry delay limit in miliseconds
+#define GS_NUMBER_OF_FAST_RETRIES		3			// fast reconnect attempts before full reconnect, must be less then GS_NUMBER_OF_SSLOPEN_RETRIES
+
 
 //////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////
@@ -38,6 +42,22 @@ typedef enum{
      GS_MAIN_STATE_LIMITED_AP
 }MainState_t;
 
+#define GS_MAIN_STATES					(GS_MAIN_STATE_LIMITED_AP + 1)
+
+// (re)connect timing, published after every reconnect on "<wunderbar id>/data/status" topic:
+//
+//   {"ts":1420070400000,"reconnect":1830,"fast":2,"full":0,"states":[0,0,0,0,0,0,1830,0,0,0]}
+//
+// "reconnect" is time from disconnect to connack, "states" is time spent in each
+// state of MainState_t (in enum order) during that reconnect, all in miliseconds.
+
+typedef struct {
+	unsigned int 	connectTime;						// miliseconds from disconnect (or boot) to connack
+	unsigned int 	stateTime[GS_MAIN_STATES];			// miliseconds spent in each state during last (re)connect
+	unsigned short 	fastReconnects;						// reconnects which reused network, server ip, time and certificate
+	unsigned short 	fullReconnects;						// reconnects which went through join, time and certificate
+} GS_Reconnect_Stats_t;
+
 
 // public functions
 
@@ -79,3 +99,24 @@ void GS_ProcessMqttConnect();
 *  @return void
 */
 void GS_ProcessMqttDisconnect();
+
+/**
+*  @brief  Process received mqtt packets
+*
+*  Called when incoming buffer is full in the middle of bulk transfer,
+*  so mqtt client makes room before the rest of data is received.
+*
+*  @return void
+*/
+void GS_ProcessMqttData();
+
+/**
+*  @brief  Gets (re)connect timing
+*
+*  Times are of the last connection which is established (connack received).
+*
+*  @param  Return reconnect stats struct
+*
+*  @return void
+*/
+void GS_User_GetReconnectStats(GS_Reconnect_Stats_t* stats);
@@ -1,30 +1,36 @@
 /** @file   JSON_Msg.c
  *  @brief  File contains functions for processing incoming JSON messages.
- *			Parses JSON string and stores all token found.
+ *			Parses JSON string and keeps views of all tokens found.
  *
  *  @author MikroElektronika
  *  @bug    No known bugs.
  */
 
 #include <string.h>
-#include <stdio.h>
-#include <stdlib.h>
 #include <stdint.h>
 
 #include "../Jsmn/Jsmn.h"
 #include "JSON_Msg.h"
 
 
-// static declarations
+#define JSON_HASH_OFFSET		2166136261u		// FNV-1a
+#define JSON_HASH_PRIME			16777619u
+
 
-typedef char JSONString_t[40];
-static JSONString_t JSON_str_array[MAX_TOKEN_NUMBER];
+// static declarations
 
+static const char* JSON_msg;
 static jsmntok_t tok[MAX_TOKEN_NUMBER];
+static uint32_t tokHash[MAX_TOKEN_NUMBER];			// hash of string tokens, 0 for others
 static int TotalTokensFound;
 
-static int JSON_Msg_Parser(char* msg, int count, JSONString_t json_string[]);
+static int JSON_Msg_Parser(char* msg, int count);
 static int JSON_Msg_FindArray(char* TokArrayStr, int cnt, int* arrCnt);
+static int JSON_Msg_SkipToken(int count);
+static uint32_t JSON_Msg_Hash(const char* str, int len);
+static void JSON_Msg_HashKey(JSON_Key_t* key);
+static bool JSON_Msg_IsKey(int count, const JSON_Key_t* key);
+static int JSON_Msg_ParseFixed(JSON_View_t* view, int decimals, int32_t* value);
 
 
 
@@ -36,33 +42,52 @@ static int JSON_Msg_FindArray(char* TokArrayStr, int cnt, int* arrCnt);
 /**
  *  @brief  JSON message parse.
  *
- *  Parses JSON message with default max token number
- *  Stores results into static string array
+ *  Parses JSON message with default max token number.
+ *  Message is not copied and should stay unchanged while tokens are used.
  *
  *  @param  pointer JSON message which should be parsed.
  *
  *  @return number of found json objects
  */
 int JSON_Msg_Parse(char* msg){
-	return JSON_Msg_Parser(msg, MAX_TOKEN_NUMBER, JSON_str_array);
+	return JSON_Msg_Parser(msg, MAX_TOKEN_NUMBER);
 }
 
 /**
  *  @brief  Search for desired token string from given object count
  *
  *  Searches for desired token within previously parsed JSON string.
+ *  Tokens are compared by hash first (computed while parsing), text is compared only on hash match.
  *  JSON_Msg_Parse should be called prior.
  *
  *  @param  Pointer to string that we search
  *  @param  Token number from which we search
  *
- *  @return Token number of detected object incremented by one,  0xFF not successful
+ *  @return Token number of detected object incremented by one,  -1 not successful
  */
 int JSON_Msg_FindToken(char* tokStr, int cnt){
+	JSON_Key_t key = JSON_KEY((const char *) tokStr);
+
+	return JSON_Msg_FindKey(&key, cnt);
+}
+
+/**
+ *  @brief  Search for desired key from given object count
+ *
+ *  Same as JSON_Msg_FindToken, key text is hashed only on first call.
+ *
+ *  @param  Key that we search (JSON_KEY initializer)
+ *  @param  Token number from which we search
+ *
+ *  @return Token number of detected object incremented by one,  -1 not successful
+ */
+int JSON_Msg_FindKey(JSON_Key_t* key, int cnt){
 	int i;
 
+	JSON_Msg_HashKey(key);
+
 	for (i = cnt; i < TotalTokensFound; i ++)
-		if (strcmp((const char *) &JSON_str_array[i][0], (const char *) tokStr) == 0)
+		if (JSON_Msg_IsKey(i, key))
 			break;
 
 	if (i >= TotalTokensFound)
@@ -72,20 +97,178 @@ int JSON_Msg_FindToken(char* tokStr, int cnt){
 }
 
 /**
- *  @brief  Gets pointer to token string for desired token number
+ *  @brief  Search for desired key among members of json object
+ *
+ *  Only keys of the object itself are compared, nested objects and
+ *  values are skipped. JSON_Msg_Parse should be called prior.
+ *
+ *  @param  Pointer to key string that we search
+ *  @param  Token number of object (as returned by JSON_Msg_FindToken)
+ *
+ *  @return Token number of member value,  -1 not successful
+ */
+int JSON_Msg_FindMember(char* tokStr, int count){
+	JSON_Key_t key = JSON_KEY((const char *) tokStr);
+
+	return JSON_Msg_FindKeyMember(&key, count);
+}
+
+/**
+ *  @brief  Search for desired key among members of json object
+ *
+ *  Same as JSON_Msg_FindMember, key text is hashed only on first call.
+ *
+ *  @param  Key that we search (JSON_KEY initializer)
+ *  @param  Token number of object (as returned by JSON_Msg_FindKey)
+ *
+ *  @return Token number of member value,  -1 not successful
+ */
+int JSON_Msg_FindKeyMember(JSON_Key_t* key, int count){
+	int i;
+
+	if ((count < 0) || (count >= TotalTokensFound) || (tok[count].type != JSMN_OBJECT))
+		return -1;
+
+	JSON_Msg_HashKey(key);
+
+	// members are key and value pairs inside of object text, value may have tokens of its own
+	for (i = count + 1; (i + 1 < TotalTokensFound) && (tok[i].start < tok[count].end); )
+	{
+		if (JSON_Msg_IsKey(i, key))
+			return (i + 1);
+
+		i = JSON_Msg_SkipToken(i + 1);
+	}
+
+	return -1;
+}
+
+/**
+ *  @brief  Gets number of members of json array
+ *
+ *  Array members follow array token (count + 1, count + 2 ...).
+ *
+ *  @param  Desired token number
+ *
+ *  @return Number of array members, -1 if token is not an array
+ */
+int JSON_Msg_GetArraySize(int count){
+	if ((count <= 0) || (count >= TotalTokensFound) || (tok[count].type != JSMN_ARRAY))
+		return -1;
+
+	return tok[count].size;
+}
+
+/**
+ *  @brief  Gets view of token text for desired token number
  *
- *  Returns pointer to object string of desired token number.
  *  Can be used with JSON_Msg_FindToken function
  *
  *  @param  Desired token number
+ *  @param  Return view of token text
+ *
+ *  @return 0  - successful,  -1 -  invalid token number
+ */
+int JSON_Msg_GetView(int count, JSON_View_t* view){
+	if ((count <= 0) || (count >= TotalTokensFound))
+		return -1;
+
+	if ((tok[count].type != JSMN_STRING) && (tok[count].type != JSMN_PRIMITIVE))
+		return -1;
+
+	view->str = &JSON_msg[tok[count].start];
+	view->len = tok[count].end - tok[count].start;
+	return 0;
+}
+
+/**
+ *  @brief  Gets int value of desired token
+ *
+ *  Token should be integer number (fraction part is ignored), quoted or not.
+ *
+ *  @param  Desired token number
+ *  @param  Return value
+ *
+ *  @return 0  - successful,  -1 -  failed
+ */
+int JSON_Msg_GetInt(int count, int32_t* value){
+	return JSON_Msg_GetFixed(count, 0, value);
+}
+
+/**
+ *  @brief  Gets bool value of desired token
+ *
+ *  Token should be true/false or integer number (non zero is true).
+ *
+ *  @param  Desired token number
+ *  @param  Return value
  *
- *  @return Pointer to token string or null pointer if invalid
+ *  @return 0  - successful,  -1 -  failed
  */
-char* JSON_Msg_GetTokStr(int count){
-	if ((count > 0) && (count <= MAX_TOKEN_NUMBER))
-		return JSON_str_array[count];
+int JSON_Msg_GetBool(int count, bool* value){
+	JSON_View_t view;
+	int32_t temp;
+
+	if (JSON_Msg_GetView(count, &view) != 0)
+		return -1;
+
+	if ((view.len == 4) && (memcmp((const void *) view.str, (const void *) "true", 4) == 0))
+		*value = true;
+	else if ((view.len == 5) && (memcmp((const void *) view.str, (const void *) "false", 5) == 0))
+		*value = false;
+	else if (JSON_Msg_ParseFixed(&view, 0, &temp) == 0)
+		*value = (temp != 0);
 	else
-		return NULL;
+		return -1;
+
+	return 0;
+}
+
+/**
+ *  @brief  Gets fixed point value of desired token
+ *
+ *  Decimal number is returned multiplied by 10^decimals, extra decimal places are truncated.
+ *  For example "21.456" with two decimals is returned as 2145.
+ *
+ *  @param  Desired token number
+ *  @param  Number of decimal places
+ *  @param  Return value
+ *
+ *  @return 0  - successful,  -1 -  failed
+ */
+int JSON_Msg_GetFixed(int count, int decimals, int32_t* value){
+	JSON_View_t view;
+
+	if (JSON_Msg_GetView(count, &view) != 0)
+		return -1;
+
+	return JSON_Msg_ParseFixed(&view, decimals, value);
+}
+
+/**
+ *  @brief  Copies text of desired token as zero terminated string
+ *
+ *  Token is not truncated, if it does not fit into buffer nothing is copied.
+ *
+ *  @param  Desired token number
+ *  @param  Output buffer
+ *  @param  Size of output buffer (with zero termination)
+ *
+ *  @return Length of copied string,  -1 -  failed
+ */
+int JSON_Msg_GetStr(int count, char* buf, int size){
+	JSON_View_t view;
+
+	if (JSON_Msg_GetView(count, &view) != 0)
+		return -1;
+
+	if (view.len >= size)
+		return -1;
+
+	memcpy((void *) buf, (const void *) view.str, view.len);
+	buf[view.len] = 0;
+
+	return view.len;
 }
 
 /**
@@ -100,13 +283,15 @@ char* JSON_Msg_GetTokStr(int count){
  *  @return Number of members found in array
  */
 int JSON_Msg_ReadArray(char* ArrName, char* arr){
-	int arrCnt = 0, r, i, value;
+	int arrCnt = 0, r, i;
+	int32_t value;
 	// find desired array
 	if ((r = JSON_Msg_FindArray(ArrName, 0, &arrCnt)) > 0)
 	{
 		for (i = 0; i < arrCnt; i ++)
 		{
-			sscanf(JSON_Msg_GetTokStr(r++), "%d", &value);
+			if (JSON_Msg_GetInt(r++, &value) != 0)
+				value = 0;
 			*arr ++ = (char) value;
 		}
 	}
@@ -125,22 +310,23 @@ int JSON_Msg_ReadArray(char* ArrName, char* arr){
  /**
  *  @brief  JSON message parser.
  *
- *  Function will parse JSON message and extract all JSON strings and primitives for further process.
- *  All Json tokens will be stored in static array of strings and will be available for later use.
+ *  Function will parse JSON message and find all JSON tokens for further process.
+ *  Tokens are kept as offsets into message, hashes of string tokens are computed for key lookup.
  *  Function uses jasmin json parser.
  *
  *  @param  Pointer to input JSON message string.
  *  @param  Max number of tokens that can be stored
- *  @param  Array of strings where tokens will be stored
  *
  *  @return Number of total found tokens.
  */
-static int JSON_Msg_Parser(char* msg, int count, JSONString_t json_string[]){
+static int JSON_Msg_Parser(char* msg, int count){
 	jsmn_parser p;
 	uint8_t i;
 
 	jsmn_init(&p);
 
+	JSON_msg = (const char *) msg;
+
 	if ((TotalTokensFound = jsmn_parse(&p, msg, strlen(msg), tok, count)) > count)
 		return -1;  // error we can not store all tokens
 
@@ -148,11 +334,10 @@ static int JSON_Msg_Parser(char* msg, int count, JSONString_t json_string[]){
 	{
 		for (i = 0; i < TotalTokensFound; i ++)
 		{
-			if ((tok[i].type == JSMN_STRING) || (tok[i].type == JSMN_PRIMITIVE))
-			{
-				memcpy((void *) json_string[i], (const void *) &msg[tok[i].start], tok[i].end - tok[i].start);
-				json_string[i][tok[i].end - tok[i].start] = 0;
-			}
+			if (tok[i].type == JSMN_STRING)
+				tokHash[i] = JSON_Msg_Hash(&msg[tok[i].start], tok[i].end - tok[i].start);
+			else
+				tokHash[i] = 0;
 		}
 	}
 
@@ -174,7 +359,7 @@ static int JSON_Msg_FindArray(char* TokArrayStr, int cnt, int* arrCnt){
 	int r;
 
 	r = JSON_Msg_FindToken(TokArrayStr, cnt);
-	if (r > 0)
+	if ((r > 0) && (r < TotalTokensFound))
 	{
 		if (tok[r].type == JSMN_ARRAY)
 			*arrCnt = tok[r].size;
@@ -183,3 +368,140 @@ static int JSON_Msg_FindArray(char* TokArrayStr, int cnt, int* arrCnt){
 	}
 	return (r + 1);
 }
+
+/**
+ *  @brief  Skip token with all tokens inside of it
+ *
+ *  @param  Token number
+ *
+ *  @return Number of the next token on the same or upper level
+ */
+static int JSON_Msg_SkipToken(int count){
+	int i = count + 1;
+
+	while ((i < TotalTokensFound) && (tok[i].start < tok[count].end))
+		i ++;
+
+	return i;
+}
+
+/**
+ *  @brief  Hash of token text
+ *
+ *  FNV-1a hash, used to skip text compare of tokens which do not match.
+ *
+ *  @param  Pointer to text
+ *  @param  Text length
+ *
+ *  @return 32 bit hash
+ */
+static uint32_t JSON_Msg_Hash(const char* str, int len){
+	uint32_t hash = JSON_HASH_OFFSET;
+
+	while (len --)
+	{
+		hash ^= (uint8_t) *str ++;
+		hash *= JSON_HASH_PRIME;
+	}
+
+	return hash;
+}
+
+/**
+ *  @brief  Hash key text if it is not hashed yet
+ *
+ *  @param  Key
+ *
+ *  @return void
+ */
+static void JSON_Msg_HashKey(JSON_Key_t* key){
+	if (key->len < 0)
+	{
+		key->len  = strlen(key->str);
+		key->hash = JSON_Msg_Hash(key->str, key->len);
+	}
+}
+
+/**
+ *  @brief  Compare token with key, by hash first and by text on hash match
+ *
+ *  @param  Token number
+ *  @param  Hashed key
+ *
+ *  @return true if token text is the key
+ */
+static bool JSON_Msg_IsKey(int count, const JSON_Key_t* key){
+	return (tokHash[count] == key->hash) && (tok[count].end - tok[count].start == key->len) &&
+			(memcmp((const void *) &JSON_msg[tok[count].start], (const void *) key->str, key->len) == 0);
+}
+
+/**
+ *  @brief  Convert decimal number text into fixed point value
+ *
+ *  Accepts optional minus sign, integer part and optional fraction part.
+ *  Fraction digits over desired number of decimals are truncated.
+ *
+ *  @param  View of number text
+ *  @param  Number of decimal places
+ *  @param  Return value
+ *
+ *  @return 0  - successful,  -1 -  not a number or out of range
+ */
+static int JSON_Msg_ParseFixed(JSON_View_t* view, int decimals, int32_t* value){
+	const char *ptr = view->str, *end = view->str + view->len;
+	int64_t result = 0;
+	bool neg = false;
+	int digits = 0;
+
+	if ((ptr < end) && (*ptr == '-'))
+	{
+		neg = true;
+		ptr ++;
+	}
+
+	// integer part
+	while ((ptr < end) && (*ptr >= '0') && (*ptr <= '9'))
+	{
+		result = result * 10 + (*ptr ++ - '0');
+		digits ++;
+		if (result > INT32_MAX)
+			return -1;
+	}
+
+	if (digits == 0)
+		return -1;
+
+	// fraction part
+	if ((ptr < end) && (*ptr == '.'))
+	{
+		ptr ++;
+		digits = 0;
+		while ((ptr < end) && (*ptr >= '0') && (*ptr <= '9'))
+		{
+			if (digits ++ < decimals)
+				result = result * 10 + (*ptr - '0');
+			ptr ++;
+		}
+
+		if (digits == 0)
+			return -1;
+	}
+	else
+		digits = 0;
+
+	if (ptr != end)
+		return -1;
+
+	// missing decimal places
+	while (digits ++ < decimals)
+		result *= 10;
+
+	if (neg)
+		result = -result;
+
+	if ((result > INT32_MAX) || (result < INT32_MIN))
+		return -1;
+
+	*value = (int32_t) result;
+	return 0;
+}
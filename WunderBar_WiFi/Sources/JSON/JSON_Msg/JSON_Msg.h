@@ -1,20 +1,44 @@
 /** @file   JSON_Msg.h
  *  @brief  File contains functions for processing incoming JSON messages.
- *			Parses JSON string and stores all token found.
+ *			Parses JSON string and keeps views of all tokens found.
  *
  *  @author MikroElektronika
  *  @bug    No known bugs.
  */
 
+#ifndef JSON_MSG_H_
+#define JSON_MSG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
 #define MAX_TOKEN_NUMBER   50
 
+// view of token text inside of parsed message (not zero terminated)
+
+typedef struct {
+	const char* str;
+	int len;
+} JSON_View_t;
+
+// key which is searched often, text is hashed once on first search
+// (keys given as strings are hashed on every search)
+
+typedef struct {
+	const char* str;
+	int len;						// -1 until key is hashed
+	uint32_t hash;
+} JSON_Key_t;
+
+#define JSON_KEY(str)	{ str, -1, 0 }
+
 // public functions
 
 /**
  *  @brief  JSON message parse.
  *
- *  Parses JSON message with default max token number
- *  Stores results into static string array
+ *  Parses JSON message with default max token number.
+ *  Message is not copied and should stay unchanged while tokens are used.
  *
  *  @param  pointer JSON message which should be parsed.
  *
@@ -26,15 +50,53 @@ int JSON_Msg_Parse(char* msg);
  *  @brief  Search for desired token string from given object count
  *
  *  Searches for desired token within previously parsed JSON string.
+ *  Tokens are compared by hash first (computed while parsing), text is compared only on hash match.
  *  JSON_Msg_Parse should be called prior.
  *
  *  @param  Pointer to string that we search
  *  @param  Token number from which we search
  *
- *  @return Token number of detected object incremented by one,  0xFF not successful
+ *  @return Token number of detected object incremented by one,  -1 not successful
  */
 int JSON_Msg_FindToken(char* tokStr, int cnt);
 
+/**
+ *  @brief  Search for desired key from given object count
+ *
+ *  Same as JSON_Msg_FindToken, key text is hashed only on first call.
+ *
+ *  @param  Key that we search (JSON_KEY initializer)
+ *  @param  Token number from which we search
+ *
+ *  @return Token number of detected object incremented by one,  -1 not successful
+ */
+int JSON_Msg_FindKey(JSON_Key_t* key, int cnt);
+
+/**
+ *  @brief  Search for desired key among members of json object
+ *
+ *  Only keys of the object itself are compared, nested objects and
+ *  values are skipped. JSON_Msg_Parse should be called prior.
+ *
+ *  @param  Pointer to key string that we search
+ *  @param  Token number of object (as returned by JSON_Msg_FindToken)
+ *
+ *  @return Token number of member value,  -1 not successful
+ */
+int JSON_Msg_FindMember(char* tokStr, int count);
+
+/**
+ *  @brief  Search for desired key among members of json object
+ *
+ *  Same as JSON_Msg_FindMember, key text is hashed only on first call.
+ *
+ *  @param  Key that we search (JSON_KEY initializer)
+ *  @param  Token number of object (as returned by JSON_Msg_FindKey)
+ *
+ *  @return Token number of member value,  -1 not successful
+ */
+int JSON_Msg_FindKeyMember(JSON_Key_t* key, int count);
+
 /**
  *  @brief  Read JSON array with desired name
  *
@@ -49,13 +111,77 @@ int JSON_Msg_FindToken(char* tokStr, int cnt);
 int JSON_Msg_ReadArray(char* ArraName, char* arr);
 
 /**
- *  @brief  Gets pointer to token string for desired token number
+ *  @brief  Gets number of members of json array
+ *
+ *  Array members follow array token (count + 1, count + 2 ...).
+ *
+ *  @param  Desired token number
+ *
+ *  @return Number of array members, -1 if token is not an array
+ */
+int JSON_Msg_GetArraySize(int count);
+
+/**
+ *  @brief  Gets view of token text for desired token number
  *
- *  Returns pointer to object string of desired token number.
  *  Can be used with JSON_Msg_FindToken function
  *
  *  @param  Desired token number
+ *  @param  Return view of token text
+ *
+ *  @return 0  - successful,  -1 -  invalid token number
+ */
+int JSON_Msg_GetView(int count, JSON_View_t* view);
+
+/**
+ *  @brief  Gets int value of desired token
+ *
+ *  Token should be integer number (fraction part is ignored), quoted or not.
+ *
+ *  @param  Desired token number
+ *  @param  Return value
+ *
+ *  @return 0  - successful,  -1 -  failed
+ */
+int JSON_Msg_GetInt(int count, int32_t* value);
+
+/**
+ *  @brief  Gets bool value of desired token
+ *
+ *  Token should be true/false or integer number (non zero is true).
+ *
+ *  @param  Desired token number
+ *  @param  Return value
  *
- *  @return Pointer to token string or null pointer if invalid
+ *  @return 0  - successful,  -1 -  failed
  */
-char* JSON_Msg_GetTokStr(int count);
+int JSON_Msg_GetBool(int count, bool* value);
+
+/**
+ *  @brief  Gets fixed point value of desired token
+ *
+ *  Decimal number is returned multiplied by 10^decimals, extra decimal places are truncated.
+ *  For example "21.456" with two decimals is returned as 2145.
+ *
+ *  @param  Desired token number
+ *  @param  Number of decimal places
+ *  @param  Return value
+ *
+ *  @return 0  - successful,  -1 -  failed
+ */
+int JSON_Msg_GetFixed(int count, int decimals, int32_t* value);
+
+/**
+ *  @brief  Copies text of desired token as zero terminated string
+ *
+ *  Token is not truncated, if it does not fit into buffer nothing is copied.
+ *
+ *  @param  Desired token number
+ *  @param  Output buffer
+ *  @param  Size of output buffer (with zero termination)
+ *
+ *  @return Length of copied string,  -1 -  failed
+ */
+int JSON_Msg_GetStr(int count, char* buf, int size);
+
+#endif // JSON_MSG_H_
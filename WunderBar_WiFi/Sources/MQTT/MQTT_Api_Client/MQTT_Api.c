@@ -5,12 +5,14 @@
  *  @bug    No known bugs.
  */
 
+#include <stddef.h>
 #include <string.h>
 
 #include <Common_Defaults.h>
 
 #include "../../Sensors/Sensors_SensID.h"
 #include "../../Sensors/Sensors_main.h"
+#include "../../Sensors/Sensors_Spool.h"
 #include "../../GS/GS_User/GS_User.h"
 
 #include "../MQTT_paho/MQTTPacket.h"
@@ -49,8 +51,10 @@ void MQTT_Api_SetReceiveCallBack(void (*MQTT_User_CallBack)(MQTT_User_Message_t*
 *  @brief  MQTT Publish
 *
 *  Publishes desired message on desired topic on mqtt server
+*  Topic and payload lengths are set by caller (topics usually come
+*  pre-rendered from sensor topic table).
 *
-*  @param  Message struct with topic, payload and option flags
+*  @param  Message struct with topic, payload, their lengths and option flags
 *
 *  @return Message handler
 */
@@ -77,8 +81,38 @@ char MQTT_Api_Subscr(char* topic, int qos ){
 	msg.messageType 	= SUBSCRIBE_MESSAGE;
 	msg.dup 			= MQTT_MSG_OPT_DUP;
 	msg.retained 		= MQTT_MSG_OPT_RETAINED;
-	msg.payloadlen 		= strlen(topic);
-	strcpy(msg.topicStr, topic);
+	msg.topiclen 		= strlen(topic);
+	msg.topicStr 		= topic;
+	msg.payloadlen 		= 0;
+	msg.payloadStr 		= NULL;
+
+	return MQTT_Msg_PrepareForSub(&msg);
+}
+
+/**
+*  @brief  MQTT Subscribe topic list
+*
+*  Subscribes on several topics with one subscribe message.
+*  Topics in list are zero terminated, one after another, and serialized
+*  packet should fit into MQTT_SUB_PACKET_MAX.
+*
+*  @param  Topic list
+*  @param  Topic list length (with zero terminations)
+*  @param  Desired qos level
+*
+*  @return Message handler
+*/
+char MQTT_Api_SubscrList(char* topics, int len, int qos){
+	MQTT_User_Message_t msg;
+
+	msg.qos 			= qos;
+	msg.messageType 	= SUBSCRIBE_MESSAGE;
+	msg.dup 			= MQTT_MSG_OPT_DUP;
+	msg.retained 		= MQTT_MSG_OPT_RETAINED;
+	msg.topiclen 		= len;
+	msg.topicStr 		= topics;
+	msg.payloadlen 		= 0;
+	msg.payloadStr 		= NULL;
 
 	return MQTT_Msg_PrepareForSub(&msg);
 }
@@ -98,8 +132,35 @@ char MQTT_Api_Unsubscr(char* topic){
 	msg.messageType = UNSUBSCRIBE_MESSAGE;
 	msg.dup = 0;
 	msg.retained = 0;
-	msg.payloadlen = strlen(topic);
-	strcpy(msg.topicStr, topic);
+	msg.topiclen = strlen(topic);
+	msg.topicStr = topic;
+	msg.payloadlen = 0;
+	msg.payloadStr = NULL;
+
+	return MQTT_Msg_PrepareForUnsub(&msg);
+}
+
+/**
+*  @brief  MQTT Unsubscribe topic list
+*
+*  Unsubscribes several topics with one unsubscribe message.
+*  Topics in list are zero terminated, one after another.
+*
+*  @param  Topic list
+*  @param  Topic list length (with zero terminations)
+*
+*  @return Message handler
+*/
+char MQTT_Api_UnsubscrList(char* topics, int len){
+	MQTT_User_Message_t msg;
+
+	msg.messageType = UNSUBSCRIBE_MESSAGE;
+	msg.dup = 0;
+	msg.retained = 0;
+	msg.topiclen = len;
+	msg.topicStr = topics;
+	msg.payloadlen = 0;
+	msg.payloadStr = NULL;
 
 	return MQTT_Msg_PrepareForUnsub(&msg);
 }
@@ -107,14 +168,16 @@ char MQTT_Api_Unsubscr(char* topic){
 /**
 *  @brief  Process subscription response (suback/unsuback) from mqtt server
 *
-*  It will update status in sensor ID list
+*  It will update status in sensor ID list.
+*  Called for every topic of subscribe/unsubscribe message.
 *
 *  @param  Sub topic
+*  @param  Suback return code of the topic (granted qos, MQTT_SUBACK_FAILURE if rejected)
 *
 *  @return void
 */
-void MQTT_Api_ProcessSubscription(char* topic){
-	Sensors_ID_ProcessSuccessfulSubscription(topic);
+void MQTT_Api_ProcessSubscription(char* topic, unsigned char code){
+	Sensors_ID_ProcessSuccessfulSubscription(topic, code);
 }
 
 /**
@@ -132,6 +195,7 @@ void MQTT_Api_CheckSubList(){
 *  @brief  Reset mqtt stack
 *
 *  Reset mqtt state machine and depending on input parameter, reset message buffer.
+*  Publish messages which were not delivered are spooled before buffer is cleared.
 *
 *  @param  Clean start flag, if set clear message buffer
 *
@@ -140,18 +204,23 @@ void MQTT_Api_CheckSubList(){
 void MQTT_Api_ResetMqtt(bool clean_start){
 	MQTT_User_ResetState();
 	if (clean_start)
+	{
+		MQTT_Msg_ForEachPublish(Sensors_Spool_StoreMsg);
 		MQTT_Msg_DiscardAllMsg();
+	}
 }
 
 /**
 *  MQTT on connect event
 *
 *  Will be called when connack message is received.
+*  Starts replay of readings spooled while connection was down.
 *
 *  @return void
 */
 void MQTT_OnConnectEvent(){
 	GS_ProcessMqttConnect();
+	Sensors_Spool_StartReplay();
 }
 
 /**
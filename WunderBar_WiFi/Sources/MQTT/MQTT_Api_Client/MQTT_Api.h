@@ -17,8 +17,10 @@ void (*MQTT_Api_ProcessReceivedMessage)(MQTT_User_Message_t* message);
 *  @brief  MQTT Publish
 *
 *  Publishes desired message on desired topic on mqtt server
+*  Topic and payload lengths are set by caller (topics usually come
+*  pre-rendered from sensor topic table).
 *
-*  @param  Message struct with topic, payload and option flags
+*  @param  Message struct with topic, payload, their lengths and option flags
 *
 *  @return Message handler
 */
@@ -36,6 +38,21 @@ char MQTT_Api_Publish(MQTT_User_Message_t* msg);
 */
 char MQTT_Api_Subscr(char* topic, int qos );
 
+/**
+*  @brief  MQTT Subscribe topic list
+*
+*  Subscribes on several topics with one subscribe message.
+*  Topics in list are zero terminated, one after another, and serialized
+*  packet should fit into MQTT_SUB_PACKET_MAX.
+*
+*  @param  Topic list
+*  @param  Topic list length (with zero terminations)
+*  @param  Desired qos level
+*
+*  @return Message handler
+*/
+char MQTT_Api_SubscrList(char* topics, int len, int qos);
+
 /**
 *  @brief  MQTT Unsubscribe
 *
@@ -47,16 +64,31 @@ char MQTT_Api_Subscr(char* topic, int qos );
 */
 char MQTT_Api_Unsubscr(char* topic);
 
+/**
+*  @brief  MQTT Unsubscribe topic list
+*
+*  Unsubscribes several topics with one unsubscribe message.
+*  Topics in list are zero terminated, one after another.
+*
+*  @param  Topic list
+*  @param  Topic list length (with zero terminations)
+*
+*  @return Message handler
+*/
+char MQTT_Api_UnsubscrList(char* topics, int len);
+
 /**
 *  @brief  Process subscription response (suback/unsuback) from mqtt server
 *
-*  It will update status in sensor ID list
+*  It will update status in sensor ID list.
+*  Called for every topic of subscribe/unsubscribe message.
 *
 *  @param  Sub topic
+*  @param  Suback return code of the topic (granted qos, MQTT_SUBACK_FAILURE if rejected)
 *
 *  @return void
 */
-void MQTT_Api_ProcessSubscription(char* topic);
+void MQTT_Api_ProcessSubscription(char* topic, unsigned char code);
 
 /**
 *  @brief  Reset mqtt stack
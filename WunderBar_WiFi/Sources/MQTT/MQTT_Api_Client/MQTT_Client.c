@@ -30,6 +30,8 @@ typedef struct {
 	int message_type;
 	int dup;
 	int messageID;
+	int count;										// suback return codes
+	int grantedQos[MQTT_SUB_MAX_TOPICS + 1];		// paho stores one code more than max count
 } MQTT_Response_t;
 
 typedef enum{
@@ -41,8 +43,8 @@ typedef enum{
 
 static MQTT_State_t MQTT_State = MQTT_STATE_BEGIN;
 static char MQTT_Running_Flag = 0;
-static char MQTT_read_buf[512];
-static int  MQTT_read_buflen = sizeof(MQTT_read_buf);
+static char* MQTT_read_buf;				// packet being processed, points into tcp ring buffer
+static int   MQTT_read_buflen;
 
 static bool MQTT_User_Receive();
 static char MQTT_User_ProcessAck(MQTT_Response_t* response);
@@ -53,6 +55,7 @@ static char MQTT_User_ProcessSuback(MQTT_Response_t* response);
 static char MQTT_User_ProcessUnsuback(MQTT_Response_t* response);
 static void MQTT_User_ProcessResp(MQTT_User_Message_t* message, MQTT_Response_t* response);
 static bool MQTT_User_WaitForResponse(unsigned long long int time);
+static int  MQTT_User_GetTopicList(MQTT_User_Message_t* MyMsg, MQTTString* topicList);
 static char MQTT_User_GetState();
 
 
@@ -109,12 +112,24 @@ char MQTT_State_Machine(){
 	// process ping mechanism and message buffer
 	case MQTT_STATE_RUNNING :
 
+		GS_TCP_mqtt_BatchBegin();						// packets from this pass go out together
+
 		if (MQTT_User_PingReq())						// keep alive connection
 			GPIO_LedOn();								// signal successful action
 
 		if ((result = MQTT_Msg_Process()) != 0)			// process mqtt messages
 			GPIO_LedOn();								// signal successful action
 
+		// failed bulk transfer already started reconnect, qos 0 publishes
+		// from the batch are sent again, like publishes which failed at once
+		if (GS_TCP_mqtt_BatchEnd() == false)
+		{
+			MQTT_Msg_BatchFailed();
+			result = 1;
+		}
+		else if (GS_TCP_mqtt_BatchPending() == false)
+			MQTT_Msg_BatchSent();
+
 		break;
 
 	default :
@@ -128,25 +143,25 @@ char MQTT_State_Machine(){
 *  @brief  Event on completed bulk transfer
 *
 *  Event generated on completed bulk transfer over tcp socket.
-*  Parses incoming buffer for mqtt messages and process them.
+*  Processes all complete mqtt packets received so far. Packet split over
+*  several bulk transfers is processed when its last part is received.
 *
 *  @return True if at least one mqtt message processed.
 */
 bool MQTT_Api_OnCompletedBulkTransfer(){
-    // process received message
-    if (MQTT_User_GetState() > MQTT_STATE_BEGIN)
-    {
-    	while (GS_TCP_mqtt_GetRemBytes())
-    	{
-    		if (MQTT_User_Receive() == 1)
-    			GS_TCP_mqtt_UpdatePtr();
-    		else
-    			break;
-    	}
-    	// at least one message received
-    	return true;
-    }
-    return false;
+	bool result = false;
+
+	// process received messages
+	if (MQTT_User_GetState() > MQTT_STATE_BEGIN)
+	{
+		while (GS_TCP_mqtt_GetPacket(&MQTT_read_buf, &MQTT_read_buflen))
+		{
+			if (MQTT_User_Receive())
+				result = true;
+			GS_TCP_mqtt_ReleasePacket();			// malformed or unknown packets are dropped
+		}
+	}
+	return result;
 }
 
 /**
@@ -169,38 +184,43 @@ char MQTT_Get_RunnigStatus(){
 }
 
 /**
-*  @brief  Subscribe desired topic on mqtt server
+*  @brief  Subscribe desired topics on mqtt server
 *
-*  Subscribes desired topic on mqtt server with requested qos
+*  Subscribes all topics from message topic list on mqtt server with requested qos,
+*  in one subscribe packet.
 *
 *  @param  Mqtt message struct
 *
-*  @return void
+*  @return Bytes written, 0 if packet could not be created
 */
-void MQTT_Api_SubscribeTopic(MQTT_User_Message_t* MyMsg){
-	MQTTString myTopic = MQTTString_initializer;
-	int myQos = MyMsg->qos;
+int MQTT_Api_SubscribeTopic(MQTT_User_Message_t* MyMsg){
+	MQTTString myTopics[MQTT_SUB_MAX_TOPICS];
+	int myQos[MQTT_SUB_MAX_TOPICS];
+	int cnt, i;
 
-	myTopic.cstring = &MyMsg->topicStr[0];
+	cnt = MQTT_User_GetTopicList(MyMsg, myTopics);
+	for (i = 0; i < cnt; i ++)
+		myQos[i] = MyMsg->qos;
 
-	MQTT_User_Subscribe(MyMsg->dup, MyMsg->messageID, 1, &myTopic, &myQos);
+	return MQTT_User_Subscribe(MyMsg->dup, MyMsg->messageID, cnt, myTopics, myQos);
 }
 
 /**
-*  @brief  Unsubscribe desired topic on mqtt server
+*  @brief  Unsubscribe desired topics on mqtt server
 *
-*  Unsubscribes desired topic on mqtt server
+*  Unsubscribes all topics from message topic list on mqtt server, in one unsubscribe packet.
 *
 *  @param  Mqtt message struct
 *
-*  @return void
+*  @return Bytes written, 0 if packet could not be created
 */
-void MQTT_Api_UnsubscribeTopic(MQTT_User_Message_t* MyMsg){
-	MQTTString myTopic = MQTTString_initializer;
+int MQTT_Api_UnsubscribeTopic(MQTT_User_Message_t* MyMsg){
+	MQTTString myTopics[MQTT_SUB_MAX_TOPICS];
+	int cnt;
 
-	myTopic.cstring = &MyMsg->topicStr[0];
+	cnt = MQTT_User_GetTopicList(MyMsg, myTopics);
 
-	MQTT_User_Unsubscribe(MyMsg->dup, MyMsg->messageID, 1, &myTopic);
+	return MQTT_User_Unsubscribe(MyMsg->dup, MyMsg->messageID, cnt, myTopics);
 }
 
 
@@ -271,6 +291,7 @@ static bool MQTT_User_Receive(){
 	// just received ping response, reset ping timer interval
 	case PINGRESP :
 		MQTT_User_PingResp();
+		MQTT_User_Response.message_type = 0;	// nothing more to process
 		result = 1;
 		break;
 
@@ -311,15 +332,17 @@ static char MQTT_User_ProcessAck(MQTT_Response_t* response){
 /**
 *  @brief  Process mqtt  subscribe acknowledge message
 *
+*  Return code of every subscribed topic is kept in response struct.
+*
 *  @param  Response struct
 *
 *  @return 0 failed; 1 - success
 */
 static char MQTT_User_ProcessSuback(MQTT_Response_t* response){
-	int cnt, gqos;
 
 	response->message_type = SUBACK;
-	return (MQTTDeserialize_suback(&response->messageID, 2, &cnt, &gqos, MQTT_read_buf, MQTT_read_buflen));
+	return (MQTTDeserialize_suback(&response->messageID, MQTT_SUB_MAX_TOPICS, &response->count,
+									response->grantedQos, MQTT_read_buf, MQTT_read_buflen) == 1);
 }
 
 /**
@@ -336,19 +359,19 @@ static char MQTT_User_ProcessUnsuback(MQTT_Response_t* response){
 }
 
 /**
-*  @brief  Reads entire mqtt message and stores it in buffer
+*  @brief  Gets type of received mqtt message
 *
-*  Reads mqtt message from buffer and stores it in given buffer.
-*  Decrypt message type and read entire message.
+*  Message is already complete in read buffer (received packet),
+*  only its type is decoded from fixed header.
 *
-*  @param  Read buffer
-*  @param  Read buffer length
-*  @param  Function pointer for get data procedure (used to read received data)
-*
-*  @return Mwtt message type
+*  @return Mqtt message type
 */
 static int MQTT_User_ReadMessage(){
-	return MQTTPacket_read(MQTT_read_buf, MQTT_read_buflen, GS_TCP_mqtt_GetData);
+	MQTTHeader header;
+
+	header.byte = MQTT_read_buf[0];
+
+	return header.bits.type;
 }
 
 /**
@@ -381,16 +404,26 @@ static void MQTT_User_ProcessPublish(MQTT_User_Message_t* message, MQTT_Response
 	MQTTString topic;
 	char* payload_in;
 
-	MQTTDeserialize_publish((int*) &message->dup, (int*) &message->qos, (int*) &message->retained, (int*) &message->messageID,
-			                     &topic, &payload_in, (int*) &message->payloadlen, MQTT_read_buf, MQTT_read_buflen);
+	int dup, qos, retained, messageID;
+
+	if (MQTTDeserialize_publish(&dup, &qos, &retained, &messageID,
+			                     &topic, &payload_in, &message->payloadlen, MQTT_read_buf, MQTT_read_buflen) != 1)
+	{
+		response->message_type = 0;		// malformed publish, ignore it
+		return;
+	}
 
-	// copy topic string
-	memcpy((void *) message->topicStr, (const void *) topic.lenstring.data, topic.lenstring.len);
-	message->topicStr[topic.lenstring.len] = '\0';  // add zero termination
+	message->dup = dup;
+	message->qos = qos;
+	message->retained = retained;
+	message->messageID = messageID;
+	message->messageType = PUBLISH_MESSAGE;
 
-	// copy payload string
-	memcpy((void *) message->payloadStr, (const void *) payload_in, message->payloadlen);
-	message->payloadStr[message->payloadlen] = '\0'; // add zero termination
+	// topic and payload are left in read buffer, they are copied
+	// (with zero termination) when message is stored for processing
+	message->topicStr = topic.lenstring.data;
+	message->topiclen = topic.lenstring.len;
+	message->payloadStr = payload_in;
 
 	response->message_type = PUBLISH;
 	response->dup = message->dup;
@@ -418,12 +451,40 @@ static void MQTT_User_ProcessResp(MQTT_User_Message_t* message, MQTT_Response_t*
 		GPIO_LedOn();
 		MQTT_Msg_ProcessRecvMsg(message);
 		break;
+	case SUBACK:
+		MQTT_Msg_ProcessSuback(response->messageID, response->count, response->grantedQos);
+		break;
 	default :
 		MQTT_Msg_ProcessResponse(response->message_type, response->messageID, response->dup);
 		break;
 	}
 }
 
+/**
+*  @brief  Makes paho topic list from message topic list
+*
+*  Topics stay in message buffer, only their pointers and lengths are set.
+*
+*  @param  Mqtt message struct
+*  @param  Return topic list (MQTT_SUB_MAX_TOPICS members)
+*
+*  @return Number of topics
+*/
+static int MQTT_User_GetTopicList(MQTT_User_Message_t* MyMsg, MQTTString* topicList){
+	const char* topic;
+	int pos = 0, len, cnt = 0;
+
+	while ((cnt < MQTT_SUB_MAX_TOPICS) && ((topic = MQTT_Msg_NextTopic(MyMsg, &pos, &len)) != NULL))
+	{
+		topicList[cnt].cstring = NULL;
+		topicList[cnt].lenstring.data = (char *) topic;
+		topicList[cnt].lenstring.len = len;
+		cnt ++;
+	}
+
+	return cnt;
+}
+
 /**
 *  @brief  Returns current state of mqtt process
 *
@@ -28,10 +28,58 @@ static struct MQTT_MsgProcessBusy_t {
 	unsigned long long int 	LastAction;
 } MQTT_MsgProcessBusy;
 
+static struct MQTT_MsgSlots_t {
+	unsigned char  FreeList[MQTT_API_MSG_BUFFER];	// stack of empty slots
+	unsigned short FreeCount;
+	unsigned char  MidIndex[MQTT_MSG_INDEX_SIZE];	// message ID -> slot (open addressing)
+	unsigned short LastMID;
+	char           Initialized;
+} MQTT_MsgSlots;
+
+static struct MQTT_MsgArena_t {
+	unsigned int   Data[MQTT_MSG_ARENA_SIZE / sizeof(unsigned int)];
+	unsigned short Top;					// end of last allocated block
+	unsigned short Used;				// bytes in allocated blocks
+	unsigned short HighWater;
+	unsigned short Compactions;
+	unsigned short Failed;
+	unsigned char  Locked;				// blocks must not move (pointers to them are in use)
+} MQTT_MsgArena;
+
+// arena block header, topic and payload (zero terminated) follow it
+
+// message scheduler queues
+#define MQTT_MSG_QUEUE_NONE		0
+#define MQTT_MSG_QUEUE_READY	1				// messages ready for action on next pass
+#define MQTT_MSG_QUEUE_WINDOW	2				// qos 1/2 publishes waiting for in-flight window
+#define MQTT_MSG_QUEUE_BATCH	3				// qos 0 publishes waiting in outgoing batch
+
+static struct MQTT_MsgSched_t {
+	unsigned char  Next[MQTT_API_MSG_BUFFER];		// next slot in queue
+	unsigned char  Queue[MQTT_API_MSG_BUFFER];		// queue slot is linked in
+	unsigned char  Head[4];
+	unsigned char  Tail[4];
+	unsigned short Count[4];
+	unsigned char  Timers[MQTT_API_MSG_BUFFER];		// waiting slots, min-heap on retransmit deadline
+	unsigned char  TimerPos[MQTT_API_MSG_BUFFER];	// heap position of slot, MQTT_MSG_NO_SLOT if no timer
+	unsigned short TimerCount;
+	unsigned char  InFlight[MQTT_API_MSG_BUFFER];	// 1 if slot is unacknowledged qos 1/2 publish
+	unsigned short InFlightCount;
+} MQTT_MsgSched;
+
+typedef struct {
+	unsigned short size;				// block size with header, multiple of 4
+	unsigned char  handler;				// owner message, MQTT_MSG_NO_SLOT if block is free
+	unsigned char  reserved;
+} MQTT_Msg_ArenaBlock_t;
+
+#define MQTT_MSG_ARENA_PTR(offset)  ((unsigned char *) MQTT_MsgArena.Data + (offset))
+
 static char MQTT_Msg_CheckForTimeout(unsigned char handler);
 static void MQTT_Msg_Retrasmit(unsigned char handler);
 static void MQTT_Msg_Discard(unsigned char handler);
 static void MQTT_Msg_UpdateLastActionTime(unsigned char handler);
+static void MQTT_Msg_SetInFlight(unsigned char handler);
 static void MQTT_Msg_SendPublish(unsigned char handler, int* bytesWritten);
 static void MQTT_Msg_SetState(unsigned char handler, MQTT_Msg_State_t state);
 static void MQTT_Msg_SendPuback(unsigned char handler);
@@ -46,9 +94,29 @@ static void MQTT_Msg_ExecuteMessage(unsigned char handler);
 static char MQTT_Msg_TimeoutMsgInProgress();
 static void MQTT_Msg_SetMsgInProgress();
 static void MQTT_Msg_SetLastTimeMsgInProgress();
-static void MQTT_Msg_ProcessSubscription(unsigned char handler);
+static void MQTT_Msg_ProcessSubscription(unsigned char handler, int count, int* grantedQos);
 static char MQTT_Msg_IsMsgPending(unsigned char handler);
 static unsigned short MQTT_Msg_GetFreeMID();
+static void MQTT_Msg_InitSlots();
+static unsigned char MQTT_Msg_AllocSlot();
+static void MQTT_Msg_FreeSlot(unsigned char handler);
+static void MQTT_Msg_IndexAdd(unsigned char handler);
+static void MQTT_Msg_IndexRemove(unsigned char handler);
+static char MQTT_Msg_ArenaAlloc(unsigned char handler, unsigned int size);
+static void MQTT_Msg_ArenaFree(unsigned char handler);
+static void MQTT_Msg_ArenaCompact();
+static void MQTT_Msg_ArenaSetPointers(unsigned char handler);
+static void MQTT_Msg_InitSched();
+static void MQTT_Msg_Schedule(unsigned char handler);
+static char MQTT_Msg_IsReadyState(MQTT_Msg_State_t state);
+static char MQTT_Msg_IsWaitingState(MQTT_Msg_State_t state);
+static void MQTT_Msg_QueuePush(unsigned char queue, unsigned char handler);
+static unsigned char MQTT_Msg_QueuePop(unsigned char queue);
+static void MQTT_Msg_TimerSet(unsigned char handler);
+static void MQTT_Msg_TimerClear(unsigned char handler);
+static void MQTT_Msg_TimerSift(unsigned short pos);
+static unsigned char MQTT_Msg_TimerExpired();
+static char MQTT_Msg_WaitsForWindow(unsigned char handler);
 
 
 
@@ -64,27 +132,67 @@ static unsigned short MQTT_Msg_GetFreeMID();
 *
 *  Should be called frequently. Processes messages from buffer.
 *  Message buffer holds messages scheduled for sending and received messages.
+*  Only messages whose response timer expired and messages ready for action
+*  are touched, messages waiting for response are not scanned.
 *
 *  @return 1 if there is still messages for processing
 */
 char MQTT_Msg_Process(){
-	char i, r;
-	unsigned int cnt = 0;
+	unsigned char handler;
+	unsigned short cnt;
+	char r = 0;
 
 	MQTT_BytesWrtitten = 0;
 
-	for (i = 0; i < MQTT_API_MSG_BUFFER; i ++)
+	MQTT_Msg_TimeoutMsgInProgress();
+
+	MQTT_MsgArena.Locked ++;			// topics and payloads are used in place
+
+	// retransmit or discard messages without response
+	while ((handler = MQTT_Msg_TimerExpired()) != MQTT_MSG_NO_SLOT)
 	{
-		r = MQTT_Msg_StateMachine(i);
-		if (r == 255)
-			return 1;	// still processing messages
+		r = MQTT_Msg_StateMachine(handler);
+		MQTT_Msg_Schedule(handler);
+		if ((r == 255) || (MQTT_BytesWrtitten > MQTT_MSG_MAX_BYTES_TO_WRITE))
+			break;
+	}
 
-		cnt += (unsigned int) r;
-		if (MQTT_BytesWrtitten > MQTT_MSG_MAX_BYTES_TO_WRITE)
+	// qos 1/2 publishes which waited for free place in in-flight window
+	while ((r != 255) && (MQTT_BytesWrtitten <= MQTT_MSG_MAX_BYTES_TO_WRITE) &&
+			(MQTT_MsgSched.InFlightCount < MQTT_MSG_INFLIGHT_WINDOW))
+	{
+		if ((handler = MQTT_Msg_QueuePop(MQTT_MSG_QUEUE_WINDOW)) == MQTT_MSG_NO_SLOT)
 			break;
+
+		r = MQTT_Msg_StateMachine(handler);
+		MQTT_Msg_Schedule(handler);
 	}
 
-	if ((cnt > 0) || (MQTT_MsgProcessBusy.InProcess))
+	// messages ready for action, in order they became ready
+	// (messages that stay ready are queued again, so take only ones queued before this pass)
+	cnt = MQTT_MsgSched.Count[MQTT_MSG_QUEUE_READY];
+	while ((r != 255) && (MQTT_BytesWrtitten <= MQTT_MSG_MAX_BYTES_TO_WRITE) && (cnt --))
+	{
+		if ((handler = MQTT_Msg_QueuePop(MQTT_MSG_QUEUE_READY)) == MQTT_MSG_NO_SLOT)
+			break;
+		if (MQTT_Msg_IsReadyState(MQTT_Api_Messages[handler].MQTT_MsgState) == 0)
+			continue;
+
+		// new qos 1/2 publish waits (in order) until in-flight window has free place
+		if (MQTT_Msg_WaitsForWindow(handler))
+		{
+			MQTT_Msg_QueuePush(MQTT_MSG_QUEUE_WINDOW, handler);
+			continue;
+		}
+
+		r = MQTT_Msg_StateMachine(handler);
+		MQTT_Msg_Schedule(handler);
+	}
+
+	MQTT_MsgArena.Locked --;
+
+	if ((r == 255) || (MQTT_MsgProcessBusy.InProcess) ||
+			(MQTT_MsgSlots.Initialized && (MQTT_MsgSlots.FreeCount < MQTT_API_MSG_BUFFER)))
 		return 1;   	// still processing messages
 	else
 		return 0;		// empty buffer
@@ -101,9 +209,16 @@ char MQTT_Msg_Process(){
 *  @return Message handler
 */
 char MQTT_Msg_PrepareForSend(MQTT_User_Message_t* MyMessage){
+	unsigned char handler;
+
 	MyMessage->messageType = PUBLISH_MESSAGE;
+
+	EnterCritical();
 	MyMessage->messageID = MQTT_Msg_GetFreeMID();
-	return MQTT_Msg_StoreMessage(MyMessage, MQTT_MSG_STATE_READY_TO_SEND);
+	handler = MQTT_Msg_StoreMessage(MyMessage, MQTT_MSG_STATE_READY_TO_SEND);
+	ExitCritical();
+
+	return handler;
 }
 
 /**
@@ -117,9 +232,16 @@ char MQTT_Msg_PrepareForSend(MQTT_User_Message_t* MyMessage){
 *  @return Message handler
 */
 char MQTT_Msg_PrepareForSub(MQTT_User_Message_t* MyMessage){
+	unsigned char handler;
+
 	MyMessage->messageType = SUBSCRIBE_MESSAGE;
+
+	EnterCritical();
 	MyMessage->messageID = MQTT_Msg_GetFreeMID();
-	return MQTT_Msg_StoreMessage(MyMessage, MQTT_MSG_STATE_READY_TO_SUBSCRIBE);
+	handler = MQTT_Msg_StoreMessage(MyMessage, MQTT_MSG_STATE_READY_TO_SUBSCRIBE);
+	ExitCritical();
+
+	return handler;
 }
 
 /**
@@ -133,9 +255,16 @@ char MQTT_Msg_PrepareForSub(MQTT_User_Message_t* MyMessage){
 *  @return Message handler
 */
 char MQTT_Msg_PrepareForUnsub(MQTT_User_Message_t* MyMessage){
+	unsigned char handler;
+
 	MyMessage->messageType = UNSUBSCRIBE_MESSAGE;
+
+	EnterCritical();
 	MyMessage->messageID = MQTT_Msg_GetFreeMID();
-	return MQTT_Msg_StoreMessage(MyMessage, MQTT_MSG_STATE_READY_TO_UNSUBSCRIBE);
+	handler = MQTT_Msg_StoreMessage(MyMessage, MQTT_MSG_STATE_READY_TO_UNSUBSCRIBE);
+	ExitCritical();
+
+	return handler;
 }
 
 /**
@@ -144,15 +273,42 @@ char MQTT_Msg_PrepareForUnsub(MQTT_User_Message_t* MyMessage){
  *  @return void
  */
 void MQTT_Msg_DiscardAllMsg(){
-	char i;
+	EnterCritical();
+	memset((void *) MQTT_Api_Messages, 0, sizeof(MQTT_Api_Messages));
+	MQTT_Msg_InitSlots();
+	ExitCritical();
 
-	for (i = 0; i < MQTT_API_MSG_BUFFER; i ++)
+	memset((void *) &MQTT_MsgProcessBusy, 0, sizeof(MQTT_MsgProcessBusy));
+}
+
+/**
+ *  @brief  Calls desired function for every publish message which is not delivered yet
+ *
+ *  Used for saving undelivered messages before buffer is discarded.
+ *
+ *  @param  Function pointer called with each message
+ *
+ *  @return void
+ */
+void MQTT_Msg_ForEachPublish(void (*callback)(MQTT_User_Message_t* msg)){
+	unsigned char handler;
+
+	EnterCritical();
+	for (handler = 0; handler < MQTT_API_MSG_BUFFER; handler ++)
 	{
-		if (MQTT_Msg_IsMsgPending(i))
-			MQTT_Msg_Discard(i);
+		switch (MQTT_Api_Messages[handler].MQTT_MsgState)
+		{
+		case MQTT_MSG_STATE_READY_TO_SEND:
+		case MQTT_MSG_STATE_PUBLISH_BATCHED:
+		case MQTT_MSG_STATE_PUBACK_WAITING:
+		case MQTT_MSG_STATE_PUBREC_WAITING:
+			callback(&MQTT_Api_Messages[handler].MQTT_MyMessage);
+			break;
+		default:
+			break;
+		}
 	}
-
-	memset((void *) &MQTT_MsgProcessBusy, 0, sizeof(MQTT_MsgProcessBusy));
+	ExitCritical();
 }
 
 /**
@@ -166,6 +322,63 @@ void MQTT_Msg_ClearMsgInProgress(){
 	MQTT_MsgProcessBusy.InProcess = 0;
 }
 
+/**
+*  @brief  Outgoing batch is sent
+*
+*  Qos 0 publishes from the batch are delivered to tcp socket, they are discarded.
+*
+*  @return void
+*/
+void MQTT_Msg_BatchSent(){
+	unsigned char handler;
+
+	while ((handler = MQTT_Msg_QueuePop(MQTT_MSG_QUEUE_BATCH)) != MQTT_MSG_NO_SLOT)
+	{
+		if (MQTT_Api_Messages[handler].MQTT_MsgState == MQTT_MSG_STATE_PUBLISH_BATCHED)
+			MQTT_Msg_Discard(handler);
+	}
+}
+
+/**
+*  @brief  Sending of outgoing batch failed
+*
+*  Qos 0 publishes from the batch are sent again (after reconnect).
+*  Publishes from part of batch which was sent before failure can be sent twice.
+*
+*  @return void
+*/
+void MQTT_Msg_BatchFailed(){
+	unsigned char handler;
+
+	while ((handler = MQTT_Msg_QueuePop(MQTT_MSG_QUEUE_BATCH)) != MQTT_MSG_NO_SLOT)
+	{
+		if (MQTT_Api_Messages[handler].MQTT_MsgState == MQTT_MSG_STATE_PUBLISH_BATCHED)
+			MQTT_Msg_SetState(handler, MQTT_MSG_STATE_READY_TO_SEND);
+	}
+}
+
+/**
+*  @brief  Gets message arena usage
+*
+*  Reports used bytes, high water mark and fragmentation of the arena
+*  holding topics and payloads, for sizing MQTT_MSG_ARENA_SIZE.
+*
+*  @param  Return arena stats struct
+*
+*  @return void
+*/
+void MQTT_Msg_GetArenaStats(MQTT_Msg_ArenaStats_t* stats){
+	EnterCritical();
+	stats->size 		= MQTT_MSG_ARENA_SIZE;
+	stats->used 		= MQTT_MsgArena.Used;
+	stats->top 			= MQTT_MsgArena.Top;
+	stats->holes 		= MQTT_MsgArena.Top - MQTT_MsgArena.Used;
+	stats->highWater 	= MQTT_MsgArena.HighWater;
+	stats->compactions 	= MQTT_MsgArena.Compactions;
+	stats->failed 		= MQTT_MsgArena.Failed;
+	ExitCritical();
+}
+
 
 
 
@@ -185,11 +398,10 @@ void MQTT_Msg_ClearMsgInProgress(){
 *
 *  @param  MAessage handler
 *
-*  @return 0 if empty, 1 if action performed
+*  @return 0 if empty, 1 if action performed, 255 if sending failed
 */
 static char MQTT_Msg_StateMachine(unsigned char handler){
-
-	MQTT_Msg_TimeoutMsgInProgress();
+	int bytesWritten;
 
 	switch (MQTT_Api_Messages[handler].MQTT_MsgState)
 	{	// empty message (no action)
@@ -199,25 +411,21 @@ static char MQTT_Msg_StateMachine(unsigned char handler){
 
 		// message is ready for publishing
 	case MQTT_MSG_STATE_READY_TO_SEND :
-		{
-			int bytesWritten;
-
-			MQTT_Msg_SendPublish(handler, &bytesWritten);
-			if (bytesWritten < 0)
-				return 255;
-			MQTT_BytesWrtitten += bytesWritten;
-		}
+		MQTT_Msg_SendPublish(handler, &bytesWritten);
+		if (bytesWritten < 0)
+			return 255;
+		MQTT_BytesWrtitten += bytesWritten;
 		break;
 
 		// message is ready for subscription
 	case MQTT_MSG_STATE_READY_TO_SUBSCRIBE :
-		if (MQTT_Api_Messages[handler].MQTT_MyMessage.messageType == SUBSCRIBE_MESSAGE)
+		if ((MQTT_Api_Messages[handler].MQTT_MyMessage.messageType == SUBSCRIBE_MESSAGE) &&
+				((bytesWritten = MQTT_Api_SubscribeTopic(&MQTT_Api_Messages[handler].MQTT_MyMessage)) > 0))
 		{
-			MQTT_Api_SubscribeTopic(&MQTT_Api_Messages[handler].MQTT_MyMessage);
 			MQTT_Msg_UpdateLastActionTime(handler);
 			MQTT_Msg_SetState(handler, MQTT_MSG_STATE_SUBACK_WAITING);
 
-			MQTT_BytesWrtitten += 600;
+			MQTT_BytesWrtitten += bytesWritten;
 		}
 		else
 			MQTT_Msg_Discard(handler);
@@ -227,12 +435,10 @@ static char MQTT_Msg_StateMachine(unsigned char handler){
 	case MQTT_MSG_STATE_READY_TO_UNSUBSCRIBE :
 		if (MQTT_Api_Messages[handler].MQTT_MyMessage.messageType == UNSUBSCRIBE_MESSAGE)
 		{
-			MQTT_Api_UnsubscribeTopic(&MQTT_Api_Messages[handler].MQTT_MyMessage);
+			MQTT_BytesWrtitten += MQTT_Api_UnsubscribeTopic(&MQTT_Api_Messages[handler].MQTT_MyMessage);
 			MQTT_Msg_UpdateLastActionTime(handler);
 			MQTT_Msg_SetState(handler, MQTT_MSG_STATE_UNSUBACK_WAITING);
 
-			MQTT_BytesWrtitten += 600;
-
 			MQTT_Msg_Discard(handler);			// if we do not want to wait unsuback
 		}
 		else
@@ -368,6 +574,8 @@ void MQTT_Msg_ProcessResponse(int msgType, int msgID, int msgDup){
 	if ((handler = MQTT_Msg_GetMessHandler(msgID)) < 0)
 		return;
 
+	MQTT_MsgArena.Locked ++;
+
 	switch (msgType)
 	{
 	case PUBACK :
@@ -387,18 +595,77 @@ void MQTT_Msg_ProcessResponse(int msgType, int msgID, int msgDup){
 		break;
 
 	case SUBACK :
-		MQTT_Msg_ProcessSubscription(handler);
+		MQTT_Msg_ProcessSubscription(handler, 0, NULL);
 		MQTT_Msg_SetState(handler, MQTT_MSG_STATE_SUBACK_RECEIVED);
 		break;
 
 	case UNSUBACK :
-		MQTT_Msg_ProcessSubscription(handler);
+		MQTT_Msg_ProcessSubscription(handler, 0, NULL);
 		MQTT_Msg_SetState(handler, MQTT_MSG_STATE_UNSUBACK_RECEIVED);
 		break;
 
 	default :
 		break;
 	}
+
+	MQTT_MsgArena.Locked --;
+}
+
+/**
+*  @brief  Process received subscribe acknowledge
+*
+*  Passes return code of every topic from subscribe message to the application
+*  and sets appropriate message state.
+*
+*  @param  Message ID
+*  @param  Number of return codes
+*  @param  Return codes (granted qos or 0x80 for failure)
+*
+*  @return void
+*/
+void MQTT_Msg_ProcessSuback(int msgID, int count, int* grantedQos){
+	signed short handler;
+
+	if ((handler = MQTT_Msg_GetMessHandler(msgID)) < 0)
+		return;
+
+	if (MQTT_Api_Messages[handler].MQTT_MyMessage.messageType != SUBSCRIBE_MESSAGE)
+		return;
+
+	MQTT_MsgArena.Locked ++;
+
+	MQTT_Msg_ProcessSubscription(handler, count, grantedQos);
+	MQTT_Msg_SetState(handler, MQTT_MSG_STATE_SUBACK_RECEIVED);
+
+	MQTT_MsgArena.Locked --;
+}
+
+/**
+*  @brief  Gets next topic from message topic list
+*
+*  Topic list holds zero terminated topics one after another
+*  (last topic may end at topic length without zero termination).
+*
+*  @param  Mqtt message struct
+*  @param  Position in topic list, should be 0 for first topic
+*  @param  Return topic length
+*
+*  @return Pointer to topic, NULL if there are no more topics
+*/
+const char* MQTT_Msg_NextTopic(MQTT_User_Message_t* MyMsg, int* pos, int* len){
+	const char* topic;
+	int end;
+
+	if (*pos >= MyMsg->topiclen)
+		return NULL;
+
+	topic = &MyMsg->topicStr[*pos];
+	for (end = *pos; (end < MyMsg->topiclen) && (MyMsg->topicStr[end] != 0); end ++);
+
+	*len = end - *pos;
+	*pos = end + 1;				// skip zero termination
+
+	return topic;
 }
 
 /**
@@ -421,15 +688,32 @@ static char MQTT_Msg_IsMsgPending(unsigned char handler){
 *  @brief  Discards desired message in buffer
 *
 *  Should be called when publish was successful, or msg was processed.
-*  It will delete message from buffer.
+*  It will delete message from buffer. If message was in-flight publish,
+*  its place in in-flight window is released.
 *
 *  @param  Message handler
 *
 *  @return void
 */
 static void MQTT_Msg_Discard(unsigned char handler){
+	EnterCritical();
+	if (MQTT_Msg_IsMsgPending(handler))
+	{
+		// drop message id from index, release topic and payload, and return slot to free list
+		MQTT_Msg_IndexRemove(handler);
+		MQTT_Msg_ArenaFree(handler);
+		MQTT_Msg_FreeSlot(handler);
+		MQTT_Msg_TimerClear(handler);
+
+		if (MQTT_MsgSched.InFlight[handler])
+		{
+			MQTT_MsgSched.InFlight[handler] = 0;
+			MQTT_MsgSched.InFlightCount --;
+		}
+	}
 	// delete message, and set message state to empty
 	memset( (void *) &MQTT_Api_Messages[handler], 0, sizeof(MQTT_Api_Msg_t));
+	ExitCritical();
 }
 
 /**
@@ -443,6 +727,7 @@ static void MQTT_Msg_Discard(unsigned char handler){
 */
 static void MQTT_Msg_UpdateLastActionTime(unsigned char handler){
 	MQTT_Api_Messages[handler].TimeOfLastAction = MSTimerGet();
+	MQTT_Msg_Schedule(handler);
 }
 
 /**
@@ -450,7 +735,8 @@ static void MQTT_Msg_UpdateLastActionTime(unsigned char handler){
 *
 *  Publish message with desired handler from buffer.
 *  Depending on desired QOS, send message and go to next state.
-*  In case QOS = 0, just send the message and discard it.
+*  In case QOS = 0, send the message and keep it until outgoing batch is sent
+*  (see MQTT_Msg_BatchSent), if sending fails message stays ready to send.
 *  In case QOS = 1, send the message and go to wait for puback state
 *  In case WOS = 2, send the message and go to wait for pubrec state
 *
@@ -466,16 +752,21 @@ static void MQTT_Msg_SendPublish(unsigned char handler, int* bytesWritten){
 	switch (MQTT_Api_Messages[handler].MQTT_MyMessage.qos)
 	{
 	case 0 :
-		// delete msg (we do not need it any nore)
-		MQTT_Msg_Discard(handler);
+		// delete msg when batch is sent (we do not need it any more)
+		if (*bytesWritten < 0)
+			break;
+		MQTT_Msg_SetState(handler, MQTT_MSG_STATE_PUBLISH_BATCHED);
+		MQTT_Msg_QueuePush(MQTT_MSG_QUEUE_BATCH, handler);
 		break;
 	case 1 :
 		// wait for puback, and set time of last action
+		MQTT_Msg_SetInFlight(handler);
 		MQTT_Msg_SetState(handler, MQTT_MSG_STATE_PUBACK_WAITING);
 		MQTT_Msg_UpdateLastActionTime(handler);
 		break;
 	case 2 :
 		// wait for pubrec, and set time of last action
+		MQTT_Msg_SetInFlight(handler);
 		MQTT_Msg_SetState(handler, MQTT_MSG_STATE_PUBREC_WAITING);
 		MQTT_Msg_UpdateLastActionTime(handler);
 		break;
@@ -546,6 +837,8 @@ static void MQTT_Msg_Retrasmit(unsigned char handler){
 /**
 *  @brief  Sets state for desired msg in buffer
 *
+*  Message is queued for next pass or its response timer is set, depending on state.
+*
 *  @param  Message handler
 *  @param  Desired new message state
 *
@@ -553,6 +846,45 @@ static void MQTT_Msg_Retrasmit(unsigned char handler){
 */
 static void MQTT_Msg_SetState(unsigned char handler, MQTT_Msg_State_t state){
 	MQTT_Api_Messages[handler].MQTT_MsgState = state;
+	MQTT_Msg_Schedule(handler);
+}
+
+/**
+*  @brief  Checks if publish should wait for place in in-flight window
+*
+*  New qos 1/2 publish waits if window is full, or if other publishes are already
+*  waiting (so publishes are sent in order). Retransmissions never wait.
+*
+*  @param  Message handler
+*
+*  @return 1 if publish should wait
+*/
+static char MQTT_Msg_WaitsForWindow(unsigned char handler){
+	if ((MQTT_Api_Messages[handler].MQTT_MsgState != MQTT_MSG_STATE_READY_TO_SEND) ||
+			(MQTT_Api_Messages[handler].MQTT_MyMessage.qos == 0) || MQTT_MsgSched.InFlight[handler])
+		return 0;
+
+	if ((MQTT_MsgSched.InFlightCount >= MQTT_MSG_INFLIGHT_WINDOW) || MQTT_MsgSched.Count[MQTT_MSG_QUEUE_WINDOW])
+		return 1;
+
+	return 0;
+}
+
+/**
+*  @brief  Counts publish into in-flight window
+*
+*  @param  Message handler
+*
+*  @return void
+*/
+static void MQTT_Msg_SetInFlight(unsigned char handler){
+	EnterCritical();
+	if (MQTT_MsgSched.InFlight[handler] == 0)
+	{
+		MQTT_MsgSched.InFlight[handler] = 1;
+		MQTT_MsgSched.InFlightCount ++;
+	}
+	ExitCritical();
 }
 
 /**
@@ -663,10 +995,11 @@ static void MQTT_Msg_ExecuteMessage(unsigned char handler){
 }
 
 /**
-*  @brief  Saves current message into first empty slot in buffer
+*  @brief  Saves current message into empty slot in buffer
 *
-*  Finds first empty slot in message buffer and saves message.
-*  Sets starting state of the message.
+*  Takes empty slot from free list and saves message.
+*  Topic and payload are copied into message arena at their real length.
+*  Sets starting state of the message and adds its message ID to index.
 *  Returns message buffer index as message handler.
 *
 *  @param  MQTT message struct
@@ -675,46 +1008,68 @@ static void MQTT_Msg_ExecuteMessage(unsigned char handler){
 *  @return Message handler, 255 if buffer is full
 */
 static unsigned char MQTT_Msg_StoreMessage(MQTT_User_Message_t* MyMessage, MQTT_Msg_State_t state){
-	unsigned char count = 255;
+	unsigned char handler;
+
+	EnterCritical();
 
-	// find first empty message slot in buffer
-	for (count = 0; count < MQTT_API_MSG_BUFFER; count ++)
+	if (MyMessage->topiclen < 0)
+		MyMessage->topiclen = 0;
+	if (MyMessage->payloadlen < 0)
+		MyMessage->payloadlen = 0;
+
+	handler = MQTT_Msg_AllocSlot();
+	if (handler != MQTT_MSG_NO_SLOT)
 	{
-		if (MQTT_Api_Messages[count].MQTT_MsgState == MQTT_MSG_STATE_EMPTY)
-			break;
-	}
+		// topic and payload with zero terminations
+		if (MQTT_Msg_ArenaAlloc(handler, MyMessage->topiclen + MyMessage->payloadlen + 2) == 0)
+		{
+			MQTT_Msg_FreeSlot(handler);
+			ExitCritical();
+			return MQTT_MSG_NO_SLOT;
+		}
 
-	if (count == MQTT_API_MSG_BUFFER)
-		return 255;           // error no more space for messages
+		// save message
+		MQTT_Api_Messages[handler].MQTT_MsgState 	= state;
+		memcpy((void *) &MQTT_Api_Messages[handler].MQTT_MyMessage, (const void *) MyMessage, sizeof(MQTT_User_Message_t));
+		MQTT_Api_Messages[handler].TimeOfLastAction = MSTimerGet();
+		MQTT_Api_Messages[handler].retransmittions 	= 0;
+
+		MQTT_Msg_ArenaSetPointers(handler);
+		if (MyMessage->topiclen)
+			memcpy((void *) MQTT_Api_Messages[handler].MQTT_MyMessage.topicStr, (const void *) MyMessage->topicStr, MyMessage->topiclen);
+		MQTT_Api_Messages[handler].MQTT_MyMessage.topicStr[MyMessage->topiclen] = '\0';
+		if (MyMessage->payloadlen)
+			memcpy((void *) MQTT_Api_Messages[handler].MQTT_MyMessage.payloadStr, (const void *) MyMessage->payloadStr, MyMessage->payloadlen);
+		MQTT_Api_Messages[handler].MQTT_MyMessage.payloadStr[MyMessage->payloadlen] = '\0';
+
+		MQTT_Msg_IndexAdd(handler);
+		MQTT_Msg_Schedule(handler);
+	}
 
-	// save message
-	MQTT_Api_Messages[count].MQTT_MsgState 	  = state;
-	memcpy((void *) &MQTT_Api_Messages[count].MQTT_MyMessage, (const void *) MyMessage, sizeof(MQTT_User_Message_t));
-	MQTT_Api_Messages[count].TimeOfLastAction = MSTimerGet();
+	ExitCritical();
 
-	return count;
+	return handler;           // MQTT_MSG_NO_SLOT if no more space for messages
 }
 
 /**
 *  @brief  Get unused message ID
 *
-*  Look in message buffer for currently unused message ID.
+*  Rolls 16 bit message ID counter, skipping 0 and IDs that are
+*  currently in buffer. At most MQTT_API_MSG_BUFFER IDs can be in use,
+*  so free one is found in at most MQTT_API_MSG_BUFFER + 1 steps.
 *
 *  @return Message ID
 */
 static unsigned short MQTT_Msg_GetFreeMID(){
-	unsigned char i, j, success;
+	unsigned short i;
 
-	for (i = 1; i < MQTT_API_MSG_BUFFER + 1; i ++)
+	for (i = 0; i < MQTT_API_MSG_BUFFER + 1; i ++)
 	{
-		success = 0;
-		for (j = 0; j < MQTT_API_MSG_BUFFER; j ++)
-		{
-			if (i != MQTT_Api_Messages[j].MQTT_MyMessage.messageID)
-				success ++;
-		}
-		if (success == MQTT_API_MSG_BUFFER)
-			return i;
+		if (++ MQTT_MsgSlots.LastMID == 0)
+			MQTT_MsgSlots.LastMID = 1;
+
+		if (MQTT_Msg_GetMessHandler(MQTT_MsgSlots.LastMID) < 0)
+			return MQTT_MsgSlots.LastMID;
 	}
 	return 0xFFFF;
 }
@@ -722,27 +1077,547 @@ static unsigned short MQTT_Msg_GetFreeMID(){
 /**
 *  @brief  Gets message handler for given message ID
 *
+*  Looks up message ID in index (linear probing from ID hash).
+*
 *  @param  Message ID
 *
-*  @return Message handler
+*  @return Message handler, -1 if not found
 */
 static signed short MQTT_Msg_GetMessHandler(int messageID){
-	signed short count;
+	unsigned short pos;
+	unsigned char  handler;
+
+	if ((messageID == 0) || (MQTT_MsgSlots.Initialized == 0))
+		return -1;
 
-	for (count = 0; count < MQTT_API_MSG_BUFFER; count ++)
+	pos = (unsigned short) messageID & (MQTT_MSG_INDEX_SIZE - 1);
+	while ((handler = MQTT_MsgSlots.MidIndex[pos]) != MQTT_MSG_NO_SLOT)
 	{
-		if (MQTT_Api_Messages[count].MQTT_MyMessage.messageID == messageID)
-			return count;
+		if (MQTT_Api_Messages[handler].MQTT_MyMessage.messageID == messageID)
+			return handler;
+		pos = (pos + 1) & (MQTT_MSG_INDEX_SIZE - 1);
 	}
 
 	return -1;
 }
 
 /**
-*  @brief
+*  @brief  Initialize free slot list and message ID index
+*
+*  All slots are marked empty, lowest slot will be used first.
+*  Message arena and scheduler are emptied.
+*
+*  @return void
+*/
+static void MQTT_Msg_InitSlots(){
+	unsigned short i;
+
+	for (i = 0; i < MQTT_API_MSG_BUFFER; i ++)
+		MQTT_MsgSlots.FreeList[i] = (unsigned char) (MQTT_API_MSG_BUFFER - 1 - i);
+	MQTT_MsgSlots.FreeCount = MQTT_API_MSG_BUFFER;
+
+	memset((void *) MQTT_MsgSlots.MidIndex, MQTT_MSG_NO_SLOT, sizeof(MQTT_MsgSlots.MidIndex));
+	MQTT_MsgSlots.Initialized = 1;
+
+	MQTT_MsgArena.Top  = 0;
+	MQTT_MsgArena.Used = 0;
+
+	MQTT_Msg_InitSched();
+}
+
+/**
+*  @brief  Takes empty slot from free list
+*
+*  @return Message handler, MQTT_MSG_NO_SLOT if buffer is full
+*/
+static unsigned char MQTT_Msg_AllocSlot(){
+	if (MQTT_MsgSlots.Initialized == 0)
+		MQTT_Msg_InitSlots();
+
+	if (MQTT_MsgSlots.FreeCount == 0)
+		return MQTT_MSG_NO_SLOT;
+
+	return MQTT_MsgSlots.FreeList[-- MQTT_MsgSlots.FreeCount];
+}
+
+/**
+*  @brief  Returns slot to free list
+*
+*  @param  Message handler
+*
+*  @return void
+*/
+static void MQTT_Msg_FreeSlot(unsigned char handler){
+	if (MQTT_MsgSlots.FreeCount < MQTT_API_MSG_BUFFER)
+		MQTT_MsgSlots.FreeList[MQTT_MsgSlots.FreeCount ++] = handler;
+}
+
+/**
+*  @brief  Adds message ID of stored message to index
+*
+*  Message ID 0 (qos 0 messages) is not indexed.
+*
+*  @param  Message handler
+*
+*  @return void
+*/
+static void MQTT_Msg_IndexAdd(unsigned char handler){
+	unsigned short pos;
+
+	if (MQTT_Api_Messages[handler].MQTT_MyMessage.messageID == 0)
+		return;
+
+	pos = MQTT_Api_Messages[handler].MQTT_MyMessage.messageID & (MQTT_MSG_INDEX_SIZE - 1);
+	while (MQTT_MsgSlots.MidIndex[pos] != MQTT_MSG_NO_SLOT)
+		pos = (pos + 1) & (MQTT_MSG_INDEX_SIZE - 1);
+
+	MQTT_MsgSlots.MidIndex[pos] = handler;
+}
+
+/**
+*  @brief  Removes message from index
+*
+*  Entries following removed one are shifted back,
+*  so probe chains stay unbroken without tombstones.
+*
+*  @param  Message handler
+*
+*  @return void
+*/
+static void MQTT_Msg_IndexRemove(unsigned char handler){
+	unsigned short i, j, home;
+	unsigned char  h;
+
+	if (MQTT_Api_Messages[handler].MQTT_MyMessage.messageID == 0)
+		return;
+
+	// find index entry of this slot
+	i = MQTT_Api_Messages[handler].MQTT_MyMessage.messageID & (MQTT_MSG_INDEX_SIZE - 1);
+	while (MQTT_MsgSlots.MidIndex[i] != handler)
+	{
+		if (MQTT_MsgSlots.MidIndex[i] == MQTT_MSG_NO_SLOT)
+			return;
+		i = (i + 1) & (MQTT_MSG_INDEX_SIZE - 1);
+	}
+
+	// shift back entries which probed past removed one
+	j = i;
+	while (1)
+	{
+		j = (j + 1) & (MQTT_MSG_INDEX_SIZE - 1);
+		if ((h = MQTT_MsgSlots.MidIndex[j]) == MQTT_MSG_NO_SLOT)
+			break;
+
+		home = MQTT_Api_Messages[h].MQTT_MyMessage.messageID & (MQTT_MSG_INDEX_SIZE - 1);
+		if (((j - home) & (MQTT_MSG_INDEX_SIZE - 1)) >= ((j - i) & (MQTT_MSG_INDEX_SIZE - 1)))
+		{
+			MQTT_MsgSlots.MidIndex[i] = h;
+			i = j;
+		}
+	}
+
+	MQTT_MsgSlots.MidIndex[i] = MQTT_MSG_NO_SLOT;
+}
+
+/**
+*  @brief  Allocates arena block for topic and payload of the message
+*
+*  Blocks are allocated at the top of the arena. If there is no room at the top,
+*  but freed blocks below it would make enough room, arena is compacted first.
+*  Compaction is skipped while arena is locked, message is dropped instead.
+*
+*  @param  Message handler
+*  @param  Number of bytes needed
+*
+*  @return 1 - success,  0 - arena is full
+*/
+static char MQTT_Msg_ArenaAlloc(unsigned char handler, unsigned int size){
+	MQTT_Msg_ArenaBlock_t* block;
+
+	size = (size + sizeof(MQTT_Msg_ArenaBlock_t) + 3) & ~3;
+
+	if (size > MQTT_MSG_ARENA_SIZE - MQTT_MsgArena.Top)
+	{
+		if ((size > MQTT_MSG_ARENA_SIZE - MQTT_MsgArena.Used) || MQTT_MsgArena.Locked)
+		{
+			MQTT_MsgArena.Failed ++;
+			return 0;
+		}
+		MQTT_Msg_ArenaCompact();
+	}
+
+	block = (MQTT_Msg_ArenaBlock_t *) MQTT_MSG_ARENA_PTR(MQTT_MsgArena.Top);
+	block->size    = (unsigned short) size;
+	block->handler = handler;
+
+	MQTT_Api_Messages[handler].ArenaOffset = MQTT_MsgArena.Top;
+
+	MQTT_MsgArena.Top  += size;
+	MQTT_MsgArena.Used += size;
+	if (MQTT_MsgArena.Used > MQTT_MsgArena.HighWater)
+		MQTT_MsgArena.HighWater = MQTT_MsgArena.Used;
+
+	return 1;
+}
+
+/**
+*  @brief  Releases arena block of the message
+*
+*  Block is marked free. If it is the last block in arena,
+*  its space is given back immediately, otherwise on next compaction.
+*
+*  @param  Message handler
+*
+*  @return void
+*/
+static void MQTT_Msg_ArenaFree(unsigned char handler){
+	unsigned short offset = MQTT_Api_Messages[handler].ArenaOffset;
+	MQTT_Msg_ArenaBlock_t* block = (MQTT_Msg_ArenaBlock_t *) MQTT_MSG_ARENA_PTR(offset);
+
+	if (block->handler != handler)
+		return;
+
+	block->handler = MQTT_MSG_NO_SLOT;
+	MQTT_MsgArena.Used -= block->size;
+
+	if ((offset + block->size == MQTT_MsgArena.Top) || (MQTT_MsgArena.Used == 0))
+		MQTT_MsgArena.Top = (MQTT_MsgArena.Used == 0) ? 0 : offset;
+}
+
+/**
+*  @brief  Compacts message arena
+*
+*  Moves all used blocks to the beginning of the arena,
+*  and updates topic and payload pointers of their messages.
+*
+*  @return void
+*/
+static void MQTT_Msg_ArenaCompact(){
+	unsigned short src = 0, dst = 0, size;
+	unsigned char handler;
+	MQTT_Msg_ArenaBlock_t* block;
+
+	while (src < MQTT_MsgArena.Top)
+	{
+		block   = (MQTT_Msg_ArenaBlock_t *) MQTT_MSG_ARENA_PTR(src);
+		size    = block->size;
+		handler = block->handler;
+
+		if (handler != MQTT_MSG_NO_SLOT)
+		{
+			if (dst != src)
+			{
+				memmove((void *) MQTT_MSG_ARENA_PTR(dst), (const void *) block, size);
+				MQTT_Api_Messages[handler].ArenaOffset = dst;
+				MQTT_Msg_ArenaSetPointers(handler);
+			}
+			dst += size;
+		}
+		src += size;
+	}
+
+	MQTT_MsgArena.Top = dst;
+	MQTT_MsgArena.Compactions ++;
+}
+
+/**
+*  @brief  Points topic and payload of the message to its arena block
+*
+*  @param  Message handler
+*
+*  @return void
+*/
+static void MQTT_Msg_ArenaSetPointers(unsigned char handler){
+	MQTT_User_Message_t* msg = &MQTT_Api_Messages[handler].MQTT_MyMessage;
+
+	msg->topicStr   = (char *) MQTT_MSG_ARENA_PTR(MQTT_Api_Messages[handler].ArenaOffset + sizeof(MQTT_Msg_ArenaBlock_t));
+	msg->payloadStr = msg->topicStr + msg->topiclen + 1;
+}
+
+/**
+*  @brief  Empties message queues and timers
+*
+*  @return void
+*/
+static void MQTT_Msg_InitSched(){
+	memset((void *) &MQTT_MsgSched, 0, sizeof(MQTT_MsgSched));
+	memset((void *) MQTT_MsgSched.Head,     MQTT_MSG_NO_SLOT, sizeof(MQTT_MsgSched.Head));
+	memset((void *) MQTT_MsgSched.Tail,     MQTT_MSG_NO_SLOT, sizeof(MQTT_MsgSched.Tail));
+	memset((void *) MQTT_MsgSched.TimerPos, MQTT_MSG_NO_SLOT, sizeof(MQTT_MsgSched.TimerPos));
+}
+
+/**
+*  @brief  Schedules message according to its state
+*
+*  Message waiting for response gets response timer, message which needs action
+*  is queued for next pass (if it is not queued already). Other messages are not touched
+*  until their state is changed.
+*
+*  @param  Message handler
+*
+*  @return void
+*/
+static void MQTT_Msg_Schedule(unsigned char handler){
+	MQTT_Msg_State_t state;
+
+	EnterCritical();
+
+	state = MQTT_Api_Messages[handler].MQTT_MsgState;
+
+	if (MQTT_Msg_IsWaitingState(state))
+		MQTT_Msg_TimerSet(handler);
+	else
+		MQTT_Msg_TimerClear(handler);
+
+	if (MQTT_Msg_IsReadyState(state) && (MQTT_MsgSched.Queue[handler] == MQTT_MSG_QUEUE_NONE))
+		MQTT_Msg_QueuePush(MQTT_MSG_QUEUE_READY, handler);
+
+	ExitCritical();
+}
+
+/**
+*  @brief  Checks if message in desired state needs action from state machine
+*
+*  @param  Message state
+*
+*  @return 1 if message should be processed on next pass
 */
-static void MQTT_Msg_ProcessSubscription(unsigned char handler){
-	MQTT_Api_ProcessSubscription(MQTT_Api_Messages[handler].MQTT_MyMessage.topicStr);
+static char MQTT_Msg_IsReadyState(MQTT_Msg_State_t state){
+	switch (state)
+	{
+	case MQTT_MSG_STATE_READY_TO_SEND :
+	case MQTT_MSG_STATE_READY_TO_SUBSCRIBE :
+	case MQTT_MSG_STATE_READY_TO_UNSUBSCRIBE :
+	case MQTT_MSG_STATE_PUBACK_READY_TO_SEND :
+	case MQTT_MSG_STATE_PUBREC_READY_TO_SEND :
+	case MQTT_MSG_STATE_PUBCOMP_READY_TO_SEND :
+	case MQTT_MSG_STATE_PUBREL_READY_TO_SEND :
+	case MQTT_MSG_STATE_PUBLISH_RECEIVED :
+	case MQTT_MSG_STATE_SUBACK_RECEIVED :
+	case MQTT_MSG_STATE_PUBACK_RECEIVED :
+	case MQTT_MSG_STATE_PUBCOMP_RECEIVED :
+	case MQTT_MSG_STATE_PUBREL_RECEIVED :
+		return 1;
+
+	default :
+		return 0;
+	}
+}
+
+/**
+*  @brief  Checks if message in desired state waits for response
+*
+*  @param  Message state
+*
+*  @return 1 if message needs response timer
+*/
+static char MQTT_Msg_IsWaitingState(MQTT_Msg_State_t state){
+	switch (state)
+	{
+	case MQTT_MSG_STATE_PUBACK_WAITING :
+	case MQTT_MSG_STATE_PUBREC_WAITING :
+	case MQTT_MSG_STATE_PUBCOMP_WAITING :
+	case MQTT_MSG_STATE_PUBREL_WAITING :
+	case MQTT_MSG_STATE_SUBACK_WAITING :
+	case MQTT_MSG_STATE_UNSUBACK_WAITING :
+		return 1;
+
+	default :
+		return 0;
+	}
+}
+
+/**
+*  @brief  Appends message to the end of desired queue
+*
+*  @param  Queue (MQTT_MSG_QUEUE_READY, MQTT_MSG_QUEUE_WINDOW or MQTT_MSG_QUEUE_BATCH)
+*  @param  Message handler
+*
+*  @return void
+*/
+static void MQTT_Msg_QueuePush(unsigned char queue, unsigned char handler){
+	EnterCritical();
+
+	MQTT_MsgSched.Next[handler]  = MQTT_MSG_NO_SLOT;
+	MQTT_MsgSched.Queue[handler] = queue;
+
+	if (MQTT_MsgSched.Head[queue] == MQTT_MSG_NO_SLOT)
+		MQTT_MsgSched.Head[queue] = handler;
+	else
+		MQTT_MsgSched.Next[MQTT_MsgSched.Tail[queue]] = handler;
+
+	MQTT_MsgSched.Tail[queue] = handler;
+	MQTT_MsgSched.Count[queue] ++;
+
+	ExitCritical();
+}
+
+/**
+*  @brief  Takes first message from desired queue
+*
+*  @param  Queue (MQTT_MSG_QUEUE_READY, MQTT_MSG_QUEUE_WINDOW or MQTT_MSG_QUEUE_BATCH)
+*
+*  @return Message handler, MQTT_MSG_NO_SLOT if queue is empty
+*/
+static unsigned char MQTT_Msg_QueuePop(unsigned char queue){
+	unsigned char handler;
+
+	EnterCritical();
+
+	if ((handler = MQTT_MsgSched.Head[queue]) != MQTT_MSG_NO_SLOT)
+	{
+		MQTT_MsgSched.Head[queue] = MQTT_MsgSched.Next[handler];
+		if (MQTT_MsgSched.Head[queue] == MQTT_MSG_NO_SLOT)
+			MQTT_MsgSched.Tail[queue] = MQTT_MSG_NO_SLOT;
+
+		MQTT_MsgSched.Queue[handler] = MQTT_MSG_QUEUE_NONE;
+		MQTT_MsgSched.Count[queue] --;
+	}
+
+	ExitCritical();
+
+	return handler;
+}
+
+/**
+*  @brief  Sets (or moves) response timer of the message
+*
+*  Timers are kept in min-heap ordered by deadline, TimeOfLastAction + MQTT_MSG_RETRASMIT_TIMEOUT.
+*  Timeout is the same for all messages, so heap is ordered by time of last action.
+*
+*  @param  Message handler
+*
+*  @return void
+*/
+static void MQTT_Msg_TimerSet(unsigned char handler){
+	unsigned short pos = MQTT_MsgSched.TimerPos[handler];
+
+	if (pos == MQTT_MSG_NO_SLOT)
+	{
+		pos = MQTT_MsgSched.TimerCount ++;
+		MQTT_MsgSched.Timers[pos]     = handler;
+		MQTT_MsgSched.TimerPos[handler] = (unsigned char) pos;
+	}
+
+	MQTT_Msg_TimerSift(pos);
+}
+
+/**
+*  @brief  Removes response timer of the message
+*
+*  @param  Message handler
+*
+*  @return void
+*/
+static void MQTT_Msg_TimerClear(unsigned char handler){
+	unsigned short pos = MQTT_MsgSched.TimerPos[handler];
+	unsigned char  last;
+
+	if (pos == MQTT_MSG_NO_SLOT)
+		return;
+
+	MQTT_MsgSched.TimerPos[handler] = MQTT_MSG_NO_SLOT;
+	last = MQTT_MsgSched.Timers[-- MQTT_MsgSched.TimerCount];
+
+	// move last timer into emptied place
+	if (pos < MQTT_MsgSched.TimerCount)
+	{
+		MQTT_MsgSched.Timers[pos]    = last;
+		MQTT_MsgSched.TimerPos[last] = (unsigned char) pos;
+		MQTT_Msg_TimerSift(pos);
+	}
+}
+
+/**
+*  @brief  Restores heap order for timer at desired heap position
+*
+*  Timer is moved up or down, whichever is needed.
+*
+*  @param  Heap position
+*
+*  @return void
+*/
+static void MQTT_Msg_TimerSift(unsigned short pos){
+	unsigned char  handler = MQTT_MsgSched.Timers[pos];
+	unsigned long long int time = MQTT_Api_Messages[handler].TimeOfLastAction;
+	unsigned short next;
+
+	// up, while parent expires later
+	while (pos > 0)
+	{
+		next = (pos - 1) / 2;
+		if (MQTT_Api_Messages[MQTT_MsgSched.Timers[next]].TimeOfLastAction <= time)
+			break;
+		MQTT_MsgSched.Timers[pos] = MQTT_MsgSched.Timers[next];
+		MQTT_MsgSched.TimerPos[MQTT_MsgSched.Timers[pos]] = (unsigned char) pos;
+		pos = next;
+	}
+
+	// down, while some child expires earlier
+	while ((next = 2 * pos + 1) < MQTT_MsgSched.TimerCount)
+	{
+		if ((next + 1 < MQTT_MsgSched.TimerCount) &&
+				(MQTT_Api_Messages[MQTT_MsgSched.Timers[next + 1]].TimeOfLastAction < MQTT_Api_Messages[MQTT_MsgSched.Timers[next]].TimeOfLastAction))
+			next ++;
+		if (MQTT_Api_Messages[MQTT_MsgSched.Timers[next]].TimeOfLastAction >= time)
+			break;
+		MQTT_MsgSched.Timers[pos] = MQTT_MsgSched.Timers[next];
+		MQTT_MsgSched.TimerPos[MQTT_MsgSched.Timers[pos]] = (unsigned char) pos;
+		pos = next;
+	}
+
+	MQTT_MsgSched.Timers[pos]       = handler;
+	MQTT_MsgSched.TimerPos[handler] = (unsigned char) pos;
+}
+
+/**
+*  @brief  Takes message whose response timer expired
+*
+*  Only the earliest timer is checked. Timer of returned message is removed,
+*  it is set again when message state is scheduled.
+*
+*  @return Message handler, MQTT_MSG_NO_SLOT if no timer expired
+*/
+static unsigned char MQTT_Msg_TimerExpired(){
+	unsigned char handler = MQTT_MSG_NO_SLOT;
+
+	EnterCritical();
+
+	if ((MQTT_MsgSched.TimerCount > 0) &&
+			(MSTimerDelta(MQTT_Api_Messages[MQTT_MsgSched.Timers[0]].TimeOfLastAction) > MQTT_MSG_RETRASMIT_TIMEOUT))
+	{
+		handler = MQTT_MsgSched.Timers[0];
+		MQTT_Msg_TimerClear(handler);
+	}
+
+	ExitCritical();
+
+	return handler;
+}
+
+/**
+*  @brief  Passes result of subscription for every topic of the message to the application
+*
+*  @param  Message handler
+*  @param  Number of return codes (0 - all topics succeeded)
+*  @param  Return codes (granted qos or 0x80 for failure)
+*
+*  @return void
+*/
+static void MQTT_Msg_ProcessSubscription(unsigned char handler, int count, int* grantedQos){
+	MQTT_User_Message_t* msg = &MQTT_Api_Messages[handler].MQTT_MyMessage;
+	const char* topic;
+	int pos = 0, len, i = 0;
+
+	while ((topic = MQTT_Msg_NextTopic(msg, &pos, &len)) != NULL)
+	{
+		// unsuback has no return codes, topics missing in suback are considered failed
+		if (count == 0)
+			MQTT_Api_ProcessSubscription((char *) topic, 0);
+		else
+			MQTT_Api_ProcessSubscription((char *) topic, (i < count) ? (unsigned char) grantedQos[i] : MQTT_SUBACK_FAILURE);
+		i ++;
+	}
 }
 
 /**
@@ -23,12 +23,23 @@
 //////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////
 
-#define MQTT_API_MSG_BUFFER 200
+#define MQTT_API_MSG_BUFFER 254     // slots are addressed by unsigned char, 255 is MQTT_MSG_NO_SLOT
+#define MQTT_MSG_NO_SLOT    255     // invalid message handler
+#define MQTT_MSG_INDEX_SIZE 512     // message ID index size (power of two, about 2 * MQTT_API_MSG_BUFFER)
+
+#define MQTT_MSG_ARENA_SIZE  24576  // storage for topics and payloads of buffered messages
+#define MQTT_MSG_TOPIC_MAX   100    // topic buffer size used by message producers
+#define MQTT_MSG_PAYLOAD_MAX 400    // payload buffer size used by message producers
 
 #define MQTT_MSG_RETRASMIT_TIMEOUT 			30000   // 10s
 #define MQTT_MSG_DISCARD_AFTER_RETRANSMITS  10   // 10 * 10s
 #define MQTT_MSG_RESPONSE_WAIT_TIMEOUT 		4000
 #define MQTT_MSG_MAX_BYTES_TO_WRITE			500
+#define MQTT_MSG_INFLIGHT_WINDOW			10		// max qos 1/2 publishes waiting for acknowledge
+
+#define MQTT_SUB_PACKET_MAX					512		// subscribe/unsubscribe packet buffer size
+#define MQTT_SUB_MAX_TOPICS					16		// max topics in one subscribe/unsubscribe message
+#define MQTT_SUBACK_FAILURE					0x80	// suback return code for rejected topic
 
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -58,10 +69,13 @@ typedef enum {
     MQTT_MSG_STATE_PUBREC_RECEIVED,
     MQTT_MSG_STATE_PUBCOMP_RECEIVED,
     MQTT_MSG_STATE_SUBACK_RECEIVED,
-    MQTT_MSG_STATE_UNSUBACK_RECEIVED
+    MQTT_MSG_STATE_UNSUBACK_RECEIVED,
+    MQTT_MSG_STATE_PUBLISH_BATCHED			// qos 0 publish waiting in outgoing batch until it is sent
 }MQTT_Msg_State_t;
 
 // one mqtt message
+// topic and payload are owned by the caller, when message is stored
+// in buffer they are copied into message arena at their real length
 
 typedef struct {
 	char qos;
@@ -69,9 +83,10 @@ typedef struct {
 	unsigned short messageID;
 	char retained;
 	char messageType;
+	int topiclen;
 	int payloadlen;
-	char topicStr[100];
-	char payloadStr[200];
+	char* topicStr;
+	char* payloadStr;
 } MQTT_User_Message_t;
 
 // one mqtt message with its state
@@ -80,9 +95,22 @@ typedef struct {
 	MQTT_Msg_State_t MQTT_MsgState;
 	unsigned long long int TimeOfLastAction;
 	unsigned int retransmittions;
-	MQTT_User_Message_t MQTT_MyMessage;
+	MQTT_User_Message_t MQTT_MyMessage;		// topicStr and payloadStr point into arena
+	unsigned short ArenaOffset;				// arena block holding topic and payload
 } MQTT_Api_Msg_t;
 
+// message arena usage
+
+typedef struct {
+	unsigned short size;					// arena size in bytes
+	unsigned short used;					// bytes held by buffered messages
+	unsigned short top;						// end of last allocated block
+	unsigned short holes;					// freed bytes below top (fragmentation)
+	unsigned short highWater;				// max bytes ever used
+	unsigned short compactions;				// number of compactions
+	unsigned short failed;					// messages dropped, arena was full
+} MQTT_Msg_ArenaStats_t;
+
 
 //////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////
@@ -141,6 +169,15 @@ char MQTT_Msg_PrepareForUnsub(MQTT_User_Message_t* MyMessage);
  */
 void MQTT_Msg_DiscardAllMsg();
 
+/**
+ *  @brief  Calls desired function for every publish message which is not delivered yet
+ *
+ *  @param  Function pointer called with each message
+ *
+ *  @return void
+ */
+void MQTT_Msg_ForEachPublish(void (*callback)(MQTT_User_Message_t* msg));
+
 /**
 *  @brief  Clear Message in progress flag
 *
@@ -150,6 +187,24 @@ void MQTT_Msg_DiscardAllMsg();
 */
 void MQTT_Msg_ClearMsgInProgress();
 
+/**
+*  @brief  Outgoing batch is sent
+*
+*  Qos 0 publishes from the batch are delivered to tcp socket, they are discarded.
+*
+*  @return void
+*/
+void MQTT_Msg_BatchSent();
+
+/**
+*  @brief  Sending of outgoing batch failed
+*
+*  Qos 0 publishes from the batch are sent again (after reconnect).
+*
+*  @return void
+*/
+void MQTT_Msg_BatchFailed();
+
 /**
 *  @brief  Process received response from mqtt and update appropriate message status
 *
@@ -161,6 +216,20 @@ void MQTT_Msg_ClearMsgInProgress();
 */
 void MQTT_Msg_ProcessResponse(int msgType, int msgID, int msgDup);
 
+/**
+*  @brief  Process received subscribe acknowledge
+*
+*  Passes return code of every topic from subscribe message to the application
+*  and sets appropriate message state.
+*
+*  @param  Message ID
+*  @param  Number of return codes
+*  @param  Return codes (granted qos or 0x80 for failure)
+*
+*  @return void
+*/
+void MQTT_Msg_ProcessSuback(int msgID, int count, int* grantedQos);
+
 /**
 *  @brief  Loads message after reception into buffer for further processing
 *
@@ -172,6 +241,32 @@ void MQTT_Msg_ProcessResponse(int msgType, int msgID, int msgDup);
 */
 char MQTT_Msg_ProcessRecvMsg(MQTT_User_Message_t* MyMessage);
 
+/**
+*  @brief  Gets message arena usage
+*
+*  Reports used bytes, high water mark and fragmentation of the arena
+*  holding topics and payloads, for sizing MQTT_MSG_ARENA_SIZE.
+*
+*  @param  Return arena stats struct
+*
+*  @return void
+*/
+void MQTT_Msg_GetArenaStats(MQTT_Msg_ArenaStats_t* stats);
+
+
+/**
+*  @brief  Gets next topic from message topic list
+*
+*  Topic list holds zero terminated topics one after another
+*  (last topic may end at topic length without zero termination).
+*
+*  @param  Mqtt message struct
+*  @param  Position in topic list, should be 0 for first topic
+*  @param  Return topic length
+*
+*  @return Pointer to topic, NULL if there are no more topics
+*/
+const char* MQTT_Msg_NextTopic(MQTT_User_Message_t* MyMsg, int* pos, int* len);
 
 //////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////
@@ -179,26 +274,27 @@ char MQTT_Msg_ProcessRecvMsg(MQTT_User_Message_t* MyMessage);
 
 
 /**
-*  @brief  Subscribe desired topic on mqtt server
+*  @brief  Subscribe desired topics on mqtt server
 *
-*  Subscribes desired topic on mqtt server with requested qos
+*  Subscribes all topics from message topic list on mqtt server with requested qos,
+*  in one subscribe packet.
 *
 *  @param  Mqtt message struct
 *
-*  @return void
+*  @return Bytes written, 0 if packet could not be created
 */
-void MQTT_Api_SubscribeTopic(MQTT_User_Message_t* MyMsg);
+int MQTT_Api_SubscribeTopic(MQTT_User_Message_t* MyMsg);
 
 /**
-*  @brief  Unsubscribe desired topic on mqtt server
+*  @brief  Unsubscribe desired topics on mqtt server
 *
-*  Unsubscribes desired topic on mqtt server
+*  Unsubscribes all topics from message topic list on mqtt server, in one unsubscribe packet.
 *
 *  @param  Mqtt message struct
 *
-*  @return void
+*  @return Bytes written, 0 if packet could not be created
 */
-void MQTT_Api_UnsubscribeTopic(MQTT_User_Message_t* MyMsg);
+int MQTT_Api_UnsubscribeTopic(MQTT_User_Message_t* MyMsg);
 
 /**
 *  @brief  Reset state machine to initial value
@@ -35,6 +35,10 @@
 	static MQTT_Ping_t MQTT_TimeToPing = PING_IDLE;
 	static char MQTT_Ping_Retries = 0;
 
+	static unsigned long long int MQTT_ConnectTime;
+	static unsigned int MQTT_TimeToFirstPublish = 0;
+	static bool MQTT_FirstPublishPending = false;
+
 
 
 	///////////////////////////////////////
@@ -53,7 +57,7 @@
 *  @return void
 */
 void MQTT_User_SendPUBREL(int message_dup, int message_ID){
-	char MQTT_buf[512];
+	char MQTT_buf[4];				// ack and ping packets are 2 - 4 bytes long
 	int MQTT_buflen = sizeof(MQTT_buf);
 	int len = 0;
 
@@ -71,7 +75,7 @@ void MQTT_User_SendPUBREL(int message_dup, int message_ID){
 *  @return void
 */
 void MQTT_User_SendPUBACK(int message_ID){
-	char MQTT_buf[512];
+	char MQTT_buf[4];				// ack and ping packets are 2 - 4 bytes long
 	int MQTT_buflen = sizeof(MQTT_buf);
 	int len = 0;
 
@@ -89,7 +93,7 @@ void MQTT_User_SendPUBACK(int message_ID){
 *  @return void
 */
 void MQTT_User_SendPUBREC(int message_ID){
-	char MQTT_buf[512];
+	char MQTT_buf[4];				// ack and ping packets are 2 - 4 bytes long
 	int MQTT_buflen = sizeof(MQTT_buf);
 	int len = 0;
 
@@ -107,7 +111,7 @@ void MQTT_User_SendPUBREC(int message_ID){
 *  @return void
 */
 void MQTT_User_SendPUBCOMP(int message_ID){
-	char MQTT_buf[512];
+	char MQTT_buf[4];				// ack and ping packets are 2 - 4 bytes long
 	int MQTT_buflen = sizeof(MQTT_buf);
 	int len = 0;
 
@@ -118,7 +122,8 @@ void MQTT_User_SendPUBCOMP(int message_ID){
 /**
 *  @brief  Publishes desired message on server
 *
-*  Serialize publish message and send it on socket
+*  Serialize publish header and send it on socket together with topic and payload,
+*  which are sent straight from the message (no packet buffer).
 *  Set led on as indicator and set RTC alarm on ping interval
 *
 *  @param  MQTT Message struct
@@ -126,21 +131,45 @@ void MQTT_User_SendPUBCOMP(int message_ID){
 *  @return bytes written, -1 if sending failed
 */
 int MQTT_User_Publish(MQTT_User_Message_t* message){
-	char MQTT_buf[512];
-	int MQTT_buflen = sizeof(MQTT_buf);
-	int len = 0;
-	MQTTString topicString = MQTTString_initializer;
-
-	topicString.cstring = message->topicStr;
+	ATLIB_DATA_SPAN_T spans[4];
+	char header[7];							// fixed header, remaining length and topic length
+	char packetID[2];
+	char* ptr = packetID;
+	int len, i, cnt = 0;
+
+	len = MQTTSerialize_publishHeader(header, sizeof(header), message->dup, message->qos, message->retained,
+										message->topiclen, message->payloadlen);
+	if (len <= 0)
+		return -1;
 
-	len = MQTTSerialize_publish(MQTT_buf, MQTT_buflen, message->dup, message->qos, message->retained,
-								message->messageID, topicString, message->payloadStr, message->payloadlen);
+	// packet is sent piece by piece, topic and payload straight from message buffer
+	spans[cnt].pData = (const uint8_t *) header;
+	spans[cnt ++].dataLen = len;
+	spans[cnt].pData = (const uint8_t *) message->topicStr;
+	spans[cnt ++].dataLen = message->topiclen;
+	if (message->qos > 0)
+	{
+		writeInt(&ptr, message->messageID);
+		spans[cnt].pData = (const uint8_t *) packetID;
+		spans[cnt ++].dataLen = sizeof(packetID);
+	}
+	spans[cnt].pData = (const uint8_t *) message->payloadStr;
+	spans[cnt ++].dataLen = message->payloadlen;
 
-	if (GS_Api_mqtt_SendPacket(MQTT_buf, len) == false)
+	if (GS_Api_mqtt_SendPacketSpans(spans, cnt) == false)
 		return -1;
 
 	RTC_SetAlarm(MQTT_PING_INTERVAL);			// delay ping request
 
+	if (MQTT_FirstPublishPending)
+	{
+		MQTT_TimeToFirstPublish = MSTimerDelta(MQTT_ConnectTime);
+		MQTT_FirstPublishPending = false;
+	}
+
+	for (i = 0, len = 0; i < cnt; i ++)
+		len += spans[i].dataLen;
+
 	return len;
 }
 
@@ -155,16 +184,20 @@ int MQTT_User_Publish(MQTT_User_Message_t* message){
 *  @param  Topic name string list
 *  @param  Requested qos list
 *
-*  @return void
+*  @return Bytes written, 0 if packet could not be created
 */
-void MQTT_User_Subscribe(int dup, int messID, int listMembers, MQTTString* topicList, int* qosList){
-	char MQTT_buf[512];
+int MQTT_User_Subscribe(int dup, int messID, int listMembers, MQTTString* topicList, int* qosList){
+	char MQTT_buf[MQTT_SUB_PACKET_MAX];
 	int MQTT_buflen = sizeof(MQTT_buf);
 	int len = 0;
 
 	len = MQTTSerialize_subscribe(MQTT_buf, MQTT_buflen, dup, messID, listMembers, topicList, qosList);
+	if (len <= 0)
+		return 0;
 
 	GS_Api_mqtt_SendPacket(MQTT_buf, len);
+
+	return len;
 }
 
 /**
@@ -177,16 +210,20 @@ void MQTT_User_Subscribe(int dup, int messID, int listMembers, MQTTString* topic
 *  @param  number of members
 *  @param  Topic name string list
 *
-*  @return void
+*  @return Bytes written, 0 if packet could not be created
 */
-void MQTT_User_Unsubscribe(int dup, int messID, int listMembers, MQTTString* topicList){
-	char MQTT_buf[512];
+int MQTT_User_Unsubscribe(int dup, int messID, int listMembers, MQTTString* topicList){
+	char MQTT_buf[MQTT_SUB_PACKET_MAX];
 	int MQTT_buflen = sizeof(MQTT_buf);
 	int len = 0;
 
 	len = MQTTSerialize_unsubscribe(MQTT_buf, MQTT_buflen, dup, messID, listMembers, topicList);
+	if (len <= 0)
+		return 0;
 
 	GS_Api_mqtt_SendPacket(MQTT_buf, len);
+
+	return len;
 }
 
 /**
@@ -199,7 +236,7 @@ void MQTT_User_Unsubscribe(int dup, int messID, int listMembers, MQTTString* top
 *  @return True if we sent ping request
 */
 bool MQTT_User_PingReq(){
-	char MQTT_buf[512];
+	char MQTT_buf[4];				// ack and ping packets are 2 - 4 bytes long
 	int MQTT_buflen = sizeof(MQTT_buf);
 	int len = 0;
 
@@ -280,4 +317,22 @@ void MQTT_User_Connect(){
 
 	len = MQTTSerialize_connect(MQTT_buf, MQTT_buflen, &MQTT_Client_Options);
 	GS_Api_mqtt_SendPacket(MQTT_buf, len);
+
+	MQTT_ConnectTime = MSTimerGet();
+	MQTT_FirstPublishPending = true;
+}
+
+/**
+*  @brief  Gets time from last connect to first publish
+*
+*  Time from sending connect packet to sending first publish packet after it.
+*  Shows how long connection setup (connack, subscriptions) delays telemetry after (re)connect.
+*
+*  @return Time in milliseconds, 0 if nothing is published since last connect
+*/
+unsigned int MQTT_User_GetTimeToFirstPublish(){
+	if (MQTT_FirstPublishPending)
+		return 0;
+
+	return MQTT_TimeToFirstPublish;
 }
@@ -45,9 +45,9 @@ bool MQTT_User_PingReq();
 *  @param  Topic name string list
 *  @param  Requested qos list
 *
-*  @return void
+*  @return Bytes written, 0 if packet could not be created
 */
-void MQTT_User_Subscribe(int dup, int messID, int listMembers, MQTTString* topicList, int* qosList);
+int  MQTT_User_Subscribe(int dup, int messID, int listMembers, MQTTString* topicList, int* qosList);
 
 /**
 *  @brief  Sends unsubscribe message to mqtt server
@@ -59,9 +59,9 @@ void MQTT_User_Subscribe(int dup, int messID, int listMembers, MQTTString* topic
 *  @param  number of members
 *  @param  Topic name string list
 *
-*  @return void
+*  @return Bytes written, 0 if packet could not be created
 */
-void MQTT_User_Unsubscribe(int dup, int messID, int listMembers, MQTTString* topicList);
+int  MQTT_User_Unsubscribe(int dup, int messID, int listMembers, MQTTString* topicList);
 
 /**
 *  @brief  Publishes desired message on server
@@ -139,3 +139,13 @@ void MQTT_User_PingResp();
 *  @return void
 */
 void MQTT_User_InitPing();
+
+/**
+*  @brief  Gets time from last connect to first publish
+*
+*  Time from sending connect packet to sending first publish packet after it.
+*  Shows how long connection setup (connack, subscriptions) delays telemetry after (re)connect.
+*
+*  @return Time in milliseconds, 0 if nothing is published since last connect
+*/
+unsigned int MQTT_User_GetTimeToFirstPublish();
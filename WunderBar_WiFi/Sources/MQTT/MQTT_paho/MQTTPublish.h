@@ -19,6 +19,7 @@
 
 int MQTTSerialize_publish(char* buf, int buflen, int dup, int qos, int retained, int packetid, MQTTString topicName,
 		char* payload, int payloadlen);
+int MQTTSerialize_publishHeader(char* buf, int buflen, int dup, int qos, int retained, int topiclen, int payloadlen);
 
 int MQTTDeserialize_publish(int* dup, int* qos, int* retained, int* packetid, MQTTString* topicName,
 		char** payload, int* payloadlen, char* buf, int len);
@@ -91,6 +91,57 @@ exit:
 
 
 
+/**
+  * Serializes only the part of a publish packet preceding the topic name: the fixed header,
+  * the remaining length and the topic name length.  Topic name, packet identifier (for QoS > 0)
+  * and payload are then sent straight from their own buffers, so the packet does not have to be
+  * assembled in one buffer.
+  * @param buf the buffer into which the header will be serialized (7 bytes is always enough)
+  * @param buflen the length in bytes of the supplied buffer
+  * @param dup integer - the MQTT dup flag
+  * @param qos integer - the MQTT QoS value
+  * @param retained integer - the MQTT retained flag
+  * @param topiclen integer - the length of the MQTT topic in the publish
+  * @param payloadlen integer - the length of the MQTT payload
+  * @return the length of the serialized header.  <= 0 indicates error
+  */
+int MQTTSerialize_publishHeader(char* buf, int buflen, int dup, int qos, int retained, int topiclen, int payloadlen)
+{
+	char *ptr = buf;
+	MQTTHeader header;
+	int rem_len = 0;
+	int rc = 0;
+
+	FUNC_ENTRY;
+	rem_len = 2 + topiclen + payloadlen;
+	if (qos > 0)
+		rem_len += 2; /* packetid */
+
+	if (buflen < 1 + 4 + 2)
+	{
+		rc = MQTTPACKET_BUFFER_TOO_SHORT;
+		goto exit;
+	}
+
+	header.byte = 0;
+	header.bits.type = PUBLISH;
+	header.bits.dup = dup;
+	header.bits.qos = qos;
+	header.bits.retain = retained;
+	writeChar(&ptr, header.byte); /* write header */
+
+	ptr += MQTTPacket_encode(ptr, rem_len); /* write remaining length */;
+
+	writeInt(&ptr, topiclen); /* write topic name length, topic name follows */
+
+	rc = ptr - buf;
+
+exit:
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
 /**
   * Serializes the ack packet into the supplied buffer.
   * @param buf the buffer into which the packet will be serialized
@@ -62,7 +62,6 @@
  */
 unsigned int Onbrd_Process_msg(char* msg){
 	ble_pass_t ble_pass;
-	char *ptr;
 	unsigned int result = 0;
 
 	if (JSON_Msg_Parse(msg) <= 0)
@@ -77,34 +76,28 @@ unsigned int Onbrd_Process_msg(char* msg){
 	//  parse ble passkeys form message
 	if (JSON_Msg_FindToken(CFG_PASSKEY, 0) > 0)
 	{
-		if ((ptr = JSON_Msg_GetTokStr(JSON_Msg_FindToken(CFG_HTU, 0))) > 0)
+		if (JSON_Msg_GetStr(JSON_Msg_FindToken(CFG_HTU, 0), (char *) &ble_pass.pass_htu, sizeof(ble_pass.pass_htu)) >= 0)
 		{	// htu passkey
-			strcpy((char *) &ble_pass.pass_htu, (const char *) ptr);
 			result |= (unsigned int) CFG_PASS_HTU_MASK;
 		}
-		if ((ptr = JSON_Msg_GetTokStr(JSON_Msg_FindToken(CFG_GYRO, 0))) > 0)
+		if (JSON_Msg_GetStr(JSON_Msg_FindToken(CFG_GYRO, 0), (char *) &ble_pass.pass_gyro, sizeof(ble_pass.pass_gyro)) >= 0)
 		{ 	// gyro passkey
-			strcpy((char *) &ble_pass.pass_gyro, (const char *) ptr);
 			result |= (unsigned int) CFG_PASS_GYRO_MASK;
 		}
-		if ((ptr = JSON_Msg_GetTokStr(JSON_Msg_FindToken(CFG_LIGHT, 0))) > 0)
+		if (JSON_Msg_GetStr(JSON_Msg_FindToken(CFG_LIGHT, 0), (char *) &ble_pass.pass_light, sizeof(ble_pass.pass_light)) >= 0)
 		{ 	// light passkey
-			strcpy((char *) &ble_pass.pass_light, (const char *) ptr);
 			result |= (unsigned int) CFG_PASS_LIGHT_MASK;
 		}
-		if ((ptr = JSON_Msg_GetTokStr(JSON_Msg_FindToken(CFG_MICROPHONE, 0))) > 0)
+		if (JSON_Msg_GetStr(JSON_Msg_FindToken(CFG_MICROPHONE, 0), (char *) &ble_pass.pass_mic, sizeof(ble_pass.pass_mic)) >= 0)
 		{	// microphone passkey
-			strcpy((char *) &ble_pass.pass_mic, (const char *) ptr);
 			result |= (unsigned int) CFG_PASS_MICROPHONE_MASK;
 		}
-		if ((ptr = JSON_Msg_GetTokStr(JSON_Msg_FindToken(CFG_BRIDGE, 0))) > 0)
+		if (JSON_Msg_GetStr(JSON_Msg_FindToken(CFG_BRIDGE, 0), (char *) &ble_pass.pass_bridge, sizeof(ble_pass.pass_bridge)) >= 0)
 		{	// bridge passkey
-			strcpy((char *) &ble_pass.pass_bridge, (const char *) ptr);
 			result |= (unsigned int) CFG_PASS_BRIDGE_MASK;
 		}
-		if ((ptr = JSON_Msg_GetTokStr(JSON_Msg_FindToken(CFG_IR, 0))) > 0)
+		if (JSON_Msg_GetStr(JSON_Msg_FindToken(CFG_IR, 0), (char *) &ble_pass.pass_ir, sizeof(ble_pass.pass_ir)) >= 0)
 		{	// ir passkey
-			strcpy((char *) &ble_pass.pass_ir, (const char *) ptr);
 			result |= (unsigned int) CFG_PASS_IR_MASK;
 		}
 
@@ -125,19 +118,16 @@ unsigned int Onbrd_Process_msg(char* msg){
 			strcpy((char *) &wunderbar_configuration.wunderbar.id, (const char *) temp_id_str);
 			result |= (unsigned int) CFG_WUNDERBAR_ID_MASK;
 		}
-		if ((ptr = JSON_Msg_GetTokStr(JSON_Msg_FindToken(CFG_WUNDERBARPASS, 0))) > 0)
+		if (JSON_Msg_GetStr(JSON_Msg_FindToken(CFG_WUNDERBARPASS, 0), (char *) &wunderbar_configuration.wunderbar.security, sizeof(wunderbar_configuration.wunderbar.security)) >= 0)
 		{	// master module security
-			strcpy((char *) &wunderbar_configuration.wunderbar.security, (const char *) ptr);
 			result |= (unsigned int) CFG_WUNDERBAR_PASS_MASK;
 		}
-		if ((ptr = JSON_Msg_GetTokStr(JSON_Msg_FindToken(CFG_WIFI_SSID, 0))) > 0)
+		if (JSON_Msg_GetStr(JSON_Msg_FindToken(CFG_WIFI_SSID, 0), (char *) &wunderbar_configuration.wifi.ssid, sizeof(wunderbar_configuration.wifi.ssid)) >= 0)
 		{	// wifi ssid
-			strcpy((char *) &wunderbar_configuration.wifi.ssid, (const char *) ptr);
 			result |= (unsigned int) CFG_WIFI_SSID_MASK;
 		}
-		if ((ptr = JSON_Msg_GetTokStr(JSON_Msg_FindToken(CFG_WIFI_PASS, 0))) > 0)
+		if (JSON_Msg_GetStr(JSON_Msg_FindToken(CFG_WIFI_PASS, 0), (char *) &wunderbar_configuration.wifi.password, sizeof(wunderbar_configuration.wifi.password)) >= 0)
 		{	// wifi password
-			strcpy((char *) &wunderbar_configuration.wifi.password, (const char *) ptr);
 			result |= (unsigned int) CFG_WIFI_PASS_MASK;
 		}
 	}
@@ -145,9 +135,8 @@ unsigned int Onbrd_Process_msg(char* msg){
 	// parse cloud url from message
 	if (JSON_Msg_FindToken(CFG_CLOUD, 0) > 0)
 	{
-		if ((ptr = JSON_Msg_GetTokStr(JSON_Msg_FindToken(CFG_CLOUD_URL, 0))) > 0)
+		if (JSON_Msg_GetStr(JSON_Msg_FindToken(CFG_CLOUD_URL, 0), (char *) &wunderbar_configuration.cloud.url, sizeof(wunderbar_configuration.cloud.url)) >= 0)
 		{	// mqtt url
-			strcpy((char *) &wunderbar_configuration.cloud.url, (const char *) ptr);
 			result |= (unsigned int) CFG_CLOUD_URL_MASK;
 		}
 	}
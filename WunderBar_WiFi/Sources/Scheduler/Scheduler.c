@@ -0,0 +1,116 @@
+/** @file   Scheduler.c
+ *  @brief  File contains cooperative priority scheduler for application tasks.
+ *  		Interrupts only post events, tasks are run from the main loop.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+// Every task has a counter of pending events. Timer events are coalesced
+// (one pending event is enough to poll state machine), spi events are counted
+// since every ext int from ble master signals one message to read.
+//
+// On every pass the table is scanned from the highest priority, so sensor
+// data is read and processed before the next step of wifi/mqtt state machine.
+// Tasks run to completion, they do not preempt each other and they share
+// spi and mqtt buffers without locking.
+//
+// When nothing is pending the core sleeps. Pending check and sleep are done with
+// interrupts masked, an interrupt that arrives in between still wakes the core.
+
+#include <hardware/Hw_modules.h>
+#include <User_init.h>
+#include "../GS/GS_User/GS_User.h"
+#include "../Onboarding/Onboarding.h"
+#include "../Sensors/Sensors_main.h"
+
+#include "Scheduler.h"
+
+
+// static declarations
+
+static volatile uint8_t Sched_Pending[SCHED_TASK_COUNT];
+static Sched_Stats_t Sched_Stats;
+
+static void (* const Sched_TaskTable[SCHED_TASK_COUNT])() = {
+	Sensors_SPI_ReadMsg,			// SCHED_TASK_SENSORS
+	GS_Main_StateMachine,			// SCHED_TASK_GS
+	Onbrd_Poll						// SCHED_TASK_ONBRD
+};
+
+static const uint8_t Sched_MaxPending[SCHED_TASK_COUNT] = {
+	SCHED_SENSORS_MAX_PENDING,		// SCHED_TASK_SENSORS
+	1,								// SCHED_TASK_GS
+	1								// SCHED_TASK_ONBRD
+};
+
+
+
+
+	///////////////////////////////////////
+	/*         public functions          */
+	///////////////////////////////////////
+
+
+
+/**
+*  @brief  Post event for the task
+*
+*  Mark task as ready to run. Safe to call from interrupt.
+*
+*  @param  Task to run
+*
+*  @return void
+*/
+void Sched_Post(Sched_Task_t task){
+	EnterCritical();
+	if (Sched_Pending[task] < Sched_MaxPending[task])
+		Sched_Pending[task] ++;
+	else
+		Sched_Stats.overruns[task] ++;
+	ExitCritical();
+}
+
+/**
+*  @brief  Run one scheduler pass
+*
+*  Runs highest priority task with pending event, or puts core to sleep
+*  until next interrupt if nothing is pending. Should be called from main loop.
+*
+*  @return void
+*/
+void Sched_Run(){
+	uint8_t task;
+
+	EnterCritical();
+	for (task = 0; task < SCHED_TASK_COUNT; task ++)
+	{
+		if (Sched_Pending[task])
+		{
+			Sched_Pending[task] --;
+			break;
+		}
+	}
+
+	if (task == SCHED_TASK_COUNT)
+	{
+		Sched_Stats.idles ++;
+		Sleep_Idle();				// returns when interrupt is pending, it is served after ExitCritical
+	}
+	ExitCritical();
+
+	if (task < SCHED_TASK_COUNT)
+	{
+		Sched_Stats.runs[task] ++;
+		Sched_TaskTable[task]();
+	}
+}
+
+/**
+*  @brief  Get scheduler statistics
+*
+*  @return Pointer to scheduler statistics
+*/
+const Sched_Stats_t* Sched_GetStats(){
+	return &Sched_Stats;
+}
@@ -0,0 +1,71 @@
+/** @file   Scheduler.h
+ *  @brief  File contains cooperative priority scheduler for application tasks.
+ *  		Interrupts only post events, tasks are run from the main loop.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <stdint.h>
+
+
+//////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+
+// tasks in order of priority, lower value is run first
+
+typedef enum {
+	SCHED_TASK_SENSORS = 0,			// spi ingress from ble master module
+	SCHED_TASK_GS,					// wifi module, mqtt client and spool (cloud i/o)
+	SCHED_TASK_ONBRD,				// onboarding button and process polling
+	SCHED_TASK_COUNT
+} Sched_Task_t;
+
+#define SCHED_SENSORS_MAX_PENDING  		8			// spi messages signaled by ble master and not read yet
+
+typedef struct {
+	uint32_t runs[SCHED_TASK_COUNT];
+	uint32_t overruns[SCHED_TASK_COUNT];			// events posted while max number of events was pending
+	uint32_t idles;
+} Sched_Stats_t;
+
+
+//////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+
+// public functions
+
+/**
+*  @brief  Post event for the task
+*
+*  Mark task as ready to run. Safe to call from interrupt.
+*
+*  @param  Task to run
+*
+*  @return void
+*/
+void Sched_Post(Sched_Task_t task);
+
+/**
+*  @brief  Run one scheduler pass
+*
+*  Runs highest priority task with pending event, or puts core to sleep
+*  until next interrupt if nothing is pending. Should be called from main loop.
+*
+*  @return void
+*/
+void Sched_Run();
+
+/**
+*  @brief  Get scheduler statistics
+*
+*  @return Pointer to scheduler statistics
+*/
+const Sched_Stats_t* Sched_GetStats();
+
+#endif // SCHEDULER_H_
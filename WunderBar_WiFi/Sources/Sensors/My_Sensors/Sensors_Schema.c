@@ -0,0 +1,373 @@
+/** @file   Sensors_Schema.c
+ *  @brief  File contains command schema of all sensor boards and generic decoder
+ *  		which forms SPI frame from json message received from cloud
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+// Every writable characteristic of every sensor board is described by list of fields.
+// Field gives json key (optionally member of parent object), value type, allowed range
+// and offset and size of the target member inside of characteristic struct from
+// wunderbar_common.h. Characteristic struct is sent as data of SPI frame.
+//
+// Values out of range are rejected here, message is not sent to master ble module.
+// New field is added only by adding a line in the appropriate field list.
+
+#include <stddef.h>
+
+#include "Sensors_common.h"
+
+
+typedef enum {
+	SENS_FIELD_INT,				// integer number
+	SENS_FIELD_BOOL,			// true/false or number
+	SENS_FIELD_FIXED2,			// decimal number, stored multiplied by 100
+	SENS_FIELD_BYTES,			// array of bytes, stored as length byte followed by bytes
+	SENS_FIELD_MASK				// integer number with bits only in mask (min is 0, max is the mask)
+} Sensors_FieldType_t;
+
+typedef struct {
+	uint8_t     parent;			// key of enclosing object (key is its member), SENS_KEY_NONE if key is searched from message start
+	uint8_t     key;			// Sensors_Key_t
+	uint8_t     type;
+	uint8_t     offset;			// offset of target member in characteristic struct (length byte for SENS_FIELD_BYTES)
+	uint8_t     size;			// size of target member (max number of bytes for SENS_FIELD_BYTES)
+	int32_t     min;			// allowed range (for every byte of SENS_FIELD_BYTES)
+	int32_t     max;			// (allowed bits for SENS_FIELD_MASK)
+} Sensors_Field_t;
+
+typedef struct {
+	uint8_t                data_id;
+	uint8_t                field_id;
+	uint8_t                operation;
+	uint8_t                fieldCnt;
+	const Sensors_Field_t* fields;
+} Sensors_Schema_t;
+
+
+// field of characteristic struct
+#define SENS_FIELD(parent, key, type, st, member, min, max) \
+	{ parent, key, type, offsetof(st, member), sizeof(((st *) 0)->member), min, max }
+
+// characteristic with single value
+#define SENS_VALUE(parent, key, type, t, min, max) \
+	{ parent, key, type, 0, sizeof(t), min, max }
+
+// array of bytes with length byte in front of it
+#define SENS_BYTES(parent, key, st, length, bytes) \
+	{ parent, key, SENS_FIELD_BYTES, offsetof(st, length), sizeof(((st *) 0)->bytes), 0, UINT8_MAX }
+
+// schema entries
+#define SENS_WRITE(data_id, field_id, fields) \
+	{ data_id, field_id, OPERATION_WRITE, sizeof(fields) / sizeof(Sensors_Field_t), fields }
+#define SENS_READ(data_id, field_id) \
+	{ data_id, field_id, OPERATION_READ, 0, NULL }
+
+#define SENS_THRESHOLD_INT16(parent, type, st, member) \
+	SENS_FIELD(parent, SENS_KEY_HYSTERESIS, type, st, member.sbl,  0,         UINT16_MAX), \
+	SENS_FIELD(parent, SENS_KEY_LOW,        type, st, member.low,  INT16_MIN, INT16_MAX),  \
+	SENS_FIELD(parent, SENS_KEY_HIGH,       type, st, member.high, INT16_MIN, INT16_MAX)
+
+#define SENS_THRESHOLD_INT32(parent, type, st, member) \
+	SENS_FIELD(parent, SENS_KEY_HYSTERESIS, type, st, member.sbl,  0,         INT32_MAX), \
+	SENS_FIELD(parent, SENS_KEY_LOW,        type, st, member.low,  INT32_MIN, INT32_MAX), \
+	SENS_FIELD(parent, SENS_KEY_HIGH,       type, st, member.high, INT32_MIN, INT32_MAX)
+
+#define SENS_BRIDGE_BAUDRATE_MIN	1200
+#define SENS_BRIDGE_BAUDRATE_MAX	1000000
+
+
+// common characteristics
+
+static const Sensors_Field_t Sensors_BeaconFreqFields[] = {
+	SENS_VALUE(SENS_KEY_NONE, SENS_KEY_FREQ, SENS_FIELD_INT, beaconFrequency_t, 0, INT32_MAX)
+};
+
+static const Sensors_Field_t Sensors_FrequencyFields[] = {
+	SENS_VALUE(SENS_KEY_NONE, SENS_KEY_FREQ, SENS_FIELD_INT, frequency_t, 0, INT32_MAX)
+};
+
+static const Sensors_Field_t Sensors_LedStateFields[] = {
+	SENS_VALUE(SENS_KEY_NONE, SENS_KEY_CMD, SENS_FIELD_BOOL, led_state_t, 0, 1)
+};
+
+// htu
+
+static const Sensors_Field_t Sensors_HtuThresholdFields[] = {
+	SENS_THRESHOLD_INT16(SENS_KEY_TEMPERATURE, SENS_FIELD_FIXED2, sensor_htu_threshold_t, temperature),
+	SENS_THRESHOLD_INT16(SENS_KEY_HUMIDITY,    SENS_FIELD_FIXED2, sensor_htu_threshold_t, humidity)
+};
+
+static const Sensors_Field_t Sensors_HtuConfigFields[] = {
+	SENS_VALUE(SENS_KEY_CONFIG, SENS_KEY_RESOLUTION, SENS_FIELD_INT, sensor_htu_config_t, HTU21D_RH_12_TEMP14, HTU21D_RH_11_TEMP11)
+};
+
+// gyro
+
+static const Sensors_Field_t Sensors_GyroThresholdFields[] = {
+	SENS_THRESHOLD_INT32(SENS_KEY_GYRO,  SENS_FIELD_FIXED2, sensor_gyro_threshold_t, gyro),
+	SENS_THRESHOLD_INT16(SENS_KEY_ACCEL, SENS_FIELD_FIXED2, sensor_gyro_threshold_t, acc)
+};
+
+static const Sensors_Field_t Sensors_GyroConfigFields[] = {
+	SENS_FIELD(SENS_KEY_ACCEL, SENS_KEY_RANGE, SENS_FIELD_INT, sensor_gyro_config_t, acc_full_scale,  ACC_FULL_SCALE_2G,      ACC_FULL_SCALE_16G),
+	SENS_FIELD(SENS_KEY_GYRO,  SENS_KEY_RANGE, SENS_FIELD_INT, sensor_gyro_config_t, gyro_full_scale, GYRO_FULL_SCALE_250DPS, GYRO_FULL_SCALE_2000DPS)
+};
+
+// light and proximity
+
+static const Sensors_Field_t Sensors_LightThresholdFields[] = {
+	SENS_THRESHOLD_INT16(SENS_KEY_LIGHT, SENS_FIELD_INT, sensor_lightprox_threshold_t, white),
+	SENS_THRESHOLD_INT16(SENS_KEY_PROX,  SENS_FIELD_INT, sensor_lightprox_threshold_t, proximity)
+};
+
+static const Sensors_Field_t Sensors_LightConfigFields[] = {
+	SENS_FIELD(SENS_KEY_CONFIG, SENS_KEY_RGBC_GAIN,  SENS_FIELD_INT, sensor_lightprox_config_t, rgbc_gain,  RGBC_GAIN_1,       RGBC_GAIN_60),
+	SENS_FIELD(SENS_KEY_CONFIG, SENS_KEY_PROX_DRIVE, SENS_FIELD_MASK, sensor_lightprox_config_t, prox_drive, 0, PROX_DRIVE_12_5_MA)
+};
+
+// microphone
+
+static const Sensors_Field_t Sensors_SoundThresholdFields[] = {
+	SENS_THRESHOLD_INT16(SENS_KEY_NONE, SENS_FIELD_INT, sensor_microphone_threshold_t, mic_level)
+};
+
+// bridge
+
+static const Sensors_Field_t Sensors_BridgeDataFields[] = {
+	SENS_BYTES(SENS_KEY_NONE, SENS_KEY_DOWN_BRIDGE, sensor_bridge_data_t, payload_length, payload)
+};
+
+static const Sensors_Field_t Sensors_BridgeConfigFields[] = {
+	SENS_FIELD(SENS_KEY_NONE, SENS_KEY_BAUDRATE, SENS_FIELD_INT, sensor_bridge_config_t, baud_rate, SENS_BRIDGE_BAUDRATE_MIN, SENS_BRIDGE_BAUDRATE_MAX)
+};
+
+// ir
+
+static const Sensors_Field_t Sensors_IrDataFields[] = {
+	SENS_VALUE(SENS_KEY_NONE, SENS_KEY_CMD, SENS_FIELD_INT, sensor_ir_data_t, 0, UINT8_MAX)
+};
+
+
+// characteristics which can be written or read from cloud
+
+static const Sensors_Schema_t Sensors_Schema[] = {
+	SENS_WRITE(DATA_ID_DEV_HTU,    FIELD_ID_CHAR_SENSOR_BEACON_FREQUENCY, Sensors_BeaconFreqFields),
+	SENS_WRITE(DATA_ID_DEV_HTU,    FIELD_ID_CHAR_SENSOR_FREQUENCY,        Sensors_FrequencyFields),
+	SENS_WRITE(DATA_ID_DEV_HTU,    FIELD_ID_CHAR_SENSOR_LED_STATE,        Sensors_LedStateFields),
+	SENS_WRITE(DATA_ID_DEV_HTU,    FIELD_ID_CHAR_SENSOR_THRESHOLD,        Sensors_HtuThresholdFields),
+	SENS_WRITE(DATA_ID_DEV_HTU,    FIELD_ID_CHAR_SENSOR_CONFIG,           Sensors_HtuConfigFields),
+	SENS_READ (DATA_ID_DEV_HTU,    FIELD_ID_CHAR_FIRMWARE_REVISION),
+	SENS_READ (DATA_ID_DEV_HTU,    FIELD_ID_CHAR_HARDWARE_REVISION),
+
+	SENS_WRITE(DATA_ID_DEV_GYRO,   FIELD_ID_CHAR_SENSOR_BEACON_FREQUENCY, Sensors_BeaconFreqFields),
+	SENS_WRITE(DATA_ID_DEV_GYRO,   FIELD_ID_CHAR_SENSOR_FREQUENCY,        Sensors_FrequencyFields),
+	SENS_WRITE(DATA_ID_DEV_GYRO,   FIELD_ID_CHAR_SENSOR_LED_STATE,        Sensors_LedStateFields),
+	SENS_WRITE(DATA_ID_DEV_GYRO,   FIELD_ID_CHAR_SENSOR_THRESHOLD,        Sensors_GyroThresholdFields),
+	SENS_WRITE(DATA_ID_DEV_GYRO,   FIELD_ID_CHAR_SENSOR_CONFIG,           Sensors_GyroConfigFields),
+	SENS_READ (DATA_ID_DEV_GYRO,   FIELD_ID_CHAR_FIRMWARE_REVISION),
+	SENS_READ (DATA_ID_DEV_GYRO,   FIELD_ID_CHAR_HARDWARE_REVISION),
+
+	SENS_WRITE(DATA_ID_DEV_LIGHT,  FIELD_ID_CHAR_SENSOR_BEACON_FREQUENCY, Sensors_BeaconFreqFields),
+	SENS_WRITE(DATA_ID_DEV_LIGHT,  FIELD_ID_CHAR_SENSOR_FREQUENCY,        Sensors_FrequencyFields),
+	SENS_WRITE(DATA_ID_DEV_LIGHT,  FIELD_ID_CHAR_SENSOR_LED_STATE,        Sensors_LedStateFields),
+	SENS_WRITE(DATA_ID_DEV_LIGHT,  FIELD_ID_CHAR_SENSOR_THRESHOLD,        Sensors_LightThresholdFields),
+	SENS_WRITE(DATA_ID_DEV_LIGHT,  FIELD_ID_CHAR_SENSOR_CONFIG,           Sensors_LightConfigFields),
+	SENS_READ (DATA_ID_DEV_LIGHT,  FIELD_ID_CHAR_FIRMWARE_REVISION),
+	SENS_READ (DATA_ID_DEV_LIGHT,  FIELD_ID_CHAR_HARDWARE_REVISION),
+
+	SENS_WRITE(DATA_ID_DEV_SOUND,  FIELD_ID_CHAR_SENSOR_BEACON_FREQUENCY, Sensors_BeaconFreqFields),
+	SENS_WRITE(DATA_ID_DEV_SOUND,  FIELD_ID_CHAR_SENSOR_FREQUENCY,        Sensors_FrequencyFields),
+	SENS_WRITE(DATA_ID_DEV_SOUND,  FIELD_ID_CHAR_SENSOR_LED_STATE,        Sensors_LedStateFields),
+	SENS_WRITE(DATA_ID_DEV_SOUND,  FIELD_ID_CHAR_SENSOR_THRESHOLD,        Sensors_SoundThresholdFields),
+	SENS_READ (DATA_ID_DEV_SOUND,  FIELD_ID_CHAR_FIRMWARE_REVISION),
+	SENS_READ (DATA_ID_DEV_SOUND,  FIELD_ID_CHAR_HARDWARE_REVISION),
+
+	SENS_WRITE(DATA_ID_DEV_BRIDGE, FIELD_ID_CHAR_SENSOR_BEACON_FREQUENCY, Sensors_BeaconFreqFields),
+	SENS_WRITE(DATA_ID_DEV_BRIDGE, FIELD_ID_CHAR_SENSOR_LED_STATE,        Sensors_LedStateFields),
+	SENS_WRITE(DATA_ID_DEV_BRIDGE, FIELD_ID_CHAR_SENSOR_DATA_W,           Sensors_BridgeDataFields),
+	SENS_WRITE(DATA_ID_DEV_BRIDGE, FIELD_ID_CHAR_SENSOR_CONFIG,           Sensors_BridgeConfigFields),
+	SENS_READ (DATA_ID_DEV_BRIDGE, FIELD_ID_CHAR_FIRMWARE_REVISION),
+	SENS_READ (DATA_ID_DEV_BRIDGE, FIELD_ID_CHAR_HARDWARE_REVISION),
+
+	SENS_WRITE(DATA_ID_DEV_IR,     FIELD_ID_CHAR_SENSOR_BEACON_FREQUENCY, Sensors_BeaconFreqFields),
+	SENS_WRITE(DATA_ID_DEV_IR,     FIELD_ID_CHAR_SENSOR_LED_STATE,        Sensors_LedStateFields),
+	SENS_WRITE(DATA_ID_DEV_IR,     FIELD_ID_CHAR_SENSOR_DATA_W,           Sensors_IrDataFields),
+	SENS_READ (DATA_ID_DEV_IR,     FIELD_ID_CHAR_FIRMWARE_REVISION),
+	SENS_READ (DATA_ID_DEV_IR,     FIELD_ID_CHAR_HARDWARE_REVISION)
+};
+
+
+// static declarations
+
+static const Sensors_Schema_t* Sensors_Schema_Find(uint8_t data_id, uint8_t field_id);
+static int  Sensors_Schema_DecodeField(const Sensors_Field_t* field, uint8_t* data);
+static void Sensors_Schema_Store(uint8_t* dst, int32_t value, uint8_t size);
+
+
+
+///////////////////////////////////////
+/*         public functions          */
+///////////////////////////////////////
+
+
+/*
+ *  @brief  Process incoming message from mqtt.
+ *
+ *  Process data received from mqtt server and prepare it in format for master ble module.
+ *  Characteristic is decoded by its schema and packed in appropriate SPI frame.
+ *
+ *  @param  Spi message frame (data id and field id already set)
+ *  @param  Pointer to json text message
+ *
+ *  @return Error code: 0 - OK;  -1 - fail
+ */
+int Sensors_Schema_ProcessData(spi_frame_t* SPI_msg, char* msg){
+	const Sensors_Schema_t* schema;
+	uint8_t i;
+
+	if ((schema = Sensors_Schema_Find(SPI_msg->data_id, SPI_msg->field_id)) == NULL)
+		return -1;
+
+	if (JSON_Msg_Parse(msg) <= 0)					// parse JSON message
+		return -1;
+
+	if (Sensors_JSON_StoreMsgId() == 0)				// store msg_id
+		return -1;
+
+	for (i = 0; i < schema->fieldCnt; i ++)
+	{
+		if (Sensors_Schema_DecodeField(&schema->fields[i], &SPI_msg->data[0]) != 0)
+		{
+			Sensors_JSON_DiscardMsgId();
+			return -1;
+		}
+	}
+
+	SPI_msg->operation = schema->operation;
+
+	return 0;
+}
+
+
+
+///////////////////////////////////////
+/*         static functions          */
+///////////////////////////////////////
+
+
+/**
+ *  @brief  Find schema of desired characteristic
+ *
+ *  @param  Sensor data id
+ *  @param  Characteristic field id
+ *
+ *  @return Pointer to schema, NULL if characteristic can not be accessed from cloud
+ */
+static const Sensors_Schema_t* Sensors_Schema_Find(uint8_t data_id, uint8_t field_id){
+	uint8_t i;
+
+	for (i = 0; i < sizeof(Sensors_Schema) / sizeof(Sensors_Schema_t); i ++)
+		if ((Sensors_Schema[i].data_id == data_id) && (Sensors_Schema[i].field_id == field_id))
+			return &Sensors_Schema[i];
+
+	return NULL;
+}
+
+/**
+ *  @brief  Decode single field from parsed json message
+ *
+ *  Finds field value, checks its range and stores it into SPI frame data.
+ *
+ *  @param  Field description
+ *  @param  SPI frame data
+ *
+ *  @return 0  - successful,  -1 - missing, invalid or out of range value
+ */
+static int Sensors_Schema_DecodeField(const Sensors_Field_t* field, uint8_t* data){
+	int start = 0, c, i, cnt;
+	int32_t value;
+	bool flag;
+
+	if (field->parent != SENS_KEY_NONE)
+		if ((start = JSON_Msg_FindKey(&Sensors_Keys[field->parent], 0)) < 0)
+			return -1;
+
+	if (field->parent != SENS_KEY_NONE)
+		c = JSON_Msg_FindKeyMember(&Sensors_Keys[field->key], start);
+	else
+		c = JSON_Msg_FindKey(&Sensors_Keys[field->key], start);
+
+	if (c < 0)
+		return -1;
+
+	switch (field->type)
+	{
+	case SENS_FIELD_INT :
+		if (JSON_Msg_GetInt(c, &value) != 0)
+			return -1;
+		break;
+
+	case SENS_FIELD_MASK :
+		if ((JSON_Msg_GetInt(c, &value) != 0) || (value & ~field->max))
+			return -1;
+		break;
+
+	case SENS_FIELD_BOOL :
+		if (JSON_Msg_GetBool(c, &flag) != 0)
+			return -1;
+		value = flag;
+		break;
+
+	case SENS_FIELD_FIXED2 :
+		if (JSON_Msg_GetFixed(c, 2, &value) != 0)
+			return -1;
+		break;
+
+	case SENS_FIELD_BYTES :
+		if ((cnt = JSON_Msg_GetArraySize(c)) <= 0)
+			return -1;
+
+		if (cnt > field->size)
+			return -1;
+
+		for (i = 0; i < cnt; i ++)
+		{
+			if ((JSON_Msg_GetInt(c + 1 + i, &value) != 0) || (value < field->min) || (value > field->max))
+				return -1;
+			data[field->offset + 1 + i] = (uint8_t) value;
+		}
+
+		data[field->offset] = (uint8_t) cnt;
+		return 0;
+
+	default :
+		return -1;
+	}
+
+	if ((value < field->min) || (value > field->max))
+		return -1;
+
+	Sensors_Schema_Store(&data[field->offset], value, field->size);
+	return 0;
+}
+
+/**
+ *  @brief  Store value into field of desired size (little endian)
+ *
+ *  @param  Destination
+ *  @param  Value
+ *  @param  Size of field in bytes
+ *
+ *  @return void
+ */
+static void Sensors_Schema_Store(uint8_t* dst, int32_t value, uint8_t size){
+	uint32_t v = (uint32_t) value;
+
+	while (size --)
+	{
+		*dst ++ = (uint8_t) v;
+		v >>= 8;
+	}
+}
@@ -6,16 +6,41 @@
  *  @bug    No known bugs.
  */
 
-#include <stdio.h>
 #include "Sensors_common.h"
-
-float atof(char * s);
+#include <hardware/Hw_modules.h>
+
+// json keys in order of Sensors_Key_t
+
+JSON_Key_t Sensors_Keys[SENS_KEY_COUNT] = {
+	JSON_KEY(JSON_MSG_ID),
+	JSON_KEY(JSON_MSG_FREQ),
+	JSON_KEY(JSON_MSG_CMD),
+	JSON_KEY(JSON_MSG_GYRO),
+	JSON_KEY(JSON_MSG_ACCEL),
+	JSON_KEY(JSON_MSG_LIGHT),
+	JSON_KEY(JSON_MSG_PROX),
+	JSON_KEY(JSON_MSG_HYSTERESIS),
+	JSON_KEY(JSON_MSG_LOW),
+	JSON_KEY(JSON_MSG_HIGH),
+	JSON_KEY(JSON_MSG_RANGE),
+	JSON_KEY(JSON_MSG_TEMPERATURE),
+	JSON_KEY(JSON_MSG_HUMIDITY),
+	JSON_KEY(JSON_MSG_CONFIG),
+	JSON_KEY(JSON_MSG_RGBC_GAIN),
+	JSON_KEY(JSON_MSG_PROX_DRIVE),
+	JSON_KEY(JSON_MSG_DOWN_BRIDGE),
+	JSON_KEY(JSON_MSG_BAUDRATE),
+	JSON_KEY(JSON_MSG_RESOLUTION),
+	JSON_KEY(JSON_MSG_ENCODING),
+	JSON_KEY(JSON_MSG_WINDOW),
+	JSON_KEY(JSON_MSG_PERIOD)
+};
 
 // static declarations
 
 static char Sensors_MsgID[20];
 
-static char Sensors_Convert_x_2_ascii(uint8_t x);
+static char* Sensors_Json_Uint(char* ptr, uint32_t x);
 
 
 ///////////////////////////////////////
@@ -24,75 +49,184 @@ static char Sensors_Convert_x_2_ascii(uint8_t x);
 
 
 /**
- *  @brief  Fill threshold 16bit int struct from float values
+ *  @brief  Start json message with time stamp
  *
- *  Three threshold values in int format are represented as its real value multiplied by 100.
+ *  Writes opening brace and "ts" member with current RTC time in ms.
+ *  Message members are then appended with Sensors_Json_* functions.
  *
- *  @param  Thresholf float struct
- *  @param  Return threshold 16bit int struct
+ *  @param  Pointer to buffer for json message
  *
- *  @return void
+ *  @return Pointer to end of message (terminating zero)
  */
-void Sensors_ConvertFloat_2_int16(threshold_float_t f_threshold, threshold_int16_t* t_int16){
-	t_int16->sbl   = (int16_t) (f_threshold.sbl  * 100);
-	t_int16->low   = (int16_t) (f_threshold.low  * 100);
-	t_int16->high  = (int16_t) (f_threshold.high * 100);
+char* Sensors_Json_Begin(char* buf){
+	memcpy(buf, SENSORS_JSON_TS, sizeof(SENSORS_JSON_TS) - 1);
+	buf += sizeof(SENSORS_JSON_TS) - 1;
+
+	return buf + RTC_GetSystemTimeStr(buf);
 }
 
 /**
- *  @brief  Fill threshold 32bit int struct from float values
+ *  @brief  Append string to json message
  *
- *  Three threshold values in int format are represented as its real value multiplied by 100.
+ *  @param  Pointer to end of message
+ *  @param  String which is appended (member name, punctuation or text value)
+ *
+ *  @return Pointer to end of message (terminating zero)
+ */
+char* Sensors_Json_Str(char* ptr, const char* str){
+	while ((*ptr = *str ++) != 0)
+		ptr ++;
+
+	return ptr;
+}
+
+/**
+ *  @brief  Append integer number to json message
  *
- *  @param  Thresholf float struct
- *  @param  Return threshold 32bit int struct
+ *  @param  Pointer to end of message
+ *  @param  Value
  *
- *  @return void
+ *  @return Pointer to end of message (terminating zero)
  */
-void Sensors_ConvertFloat_2_int32(threshold_float_t f_threshold, threshold_int32_t* t_int32){
-	t_int32->sbl  = (int32_t) (f_threshold.sbl  * 100);
-	t_int32->low  = (int32_t) (f_threshold.low  * 100);
-	t_int32->high = (int32_t) (f_threshold.high * 100);
+char* Sensors_Json_Int(char* ptr, int32_t x){
+	if (x < 0)
+	{
+		*ptr ++ = '-';
+		return Sensors_Json_Uint(ptr, - (uint32_t) x);
+	}
+
+	return Sensors_Json_Uint(ptr, (uint32_t) x);
 }
 
 /**
- *  @brief  Convert string of integer into string with two decimal spaces (x / 100)
+ *  @brief  Append number with two decimal places to json message (x / 100)
  *
- *  Input value which is 100 times greater than real (integer representation),
- *  should be transformed into string with its real value.
+ *  Input value is 100 times greater than real value (integer representation).
+ *  Integer part has at least one digit, decimal part always has two (-5 is written as -0.05).
+ *
+ *  @param  Pointer to end of message
+ *  @param  Value multiplied by 100
+ *
+ *  @return Pointer to end of message (terminating zero)
+ */
+char* Sensors_Json_Fixed2(char* ptr, int32_t x){
+	uint32_t u = (uint32_t) x;
+
+	if (x < 0)
+	{
+		*ptr ++ = '-';
+		u = - u;
+	}
+
+	ptr = Sensors_Json_Uint(ptr, u / 100);
+	u %= 100;
+
+	*ptr ++ = '.';
+	*ptr ++ = '0' + u / 10;
+	*ptr ++ = '0' + u % 10;
+	*ptr = 0;
+
+	return ptr;
+}
+
+/**
+ *  @brief  Form battery level message
  *
- *  @param  Return string
- *  @param  Input value
+ *  @param  Pointer to buffer for json message
+ *  @param  Battery level
  *
  *  @return void
  */
-void Sensors_Convert_f_Str(char* txt, int x){
-	char temp_txt[9], *ptr;
-	char neg = 0;
+void Sensors_Json_BatteryLevel(char* buf, uint8_t level){
+	char* ptr;
+
+	ptr = Sensors_Json_Begin(buf);
+	ptr = Sensors_Json_Str(ptr, ",\"val\":");
+	ptr = Sensors_Json_Uint(ptr, level);
+	Sensors_Json_Str(ptr, "}");
+}
 
-	if (x < 0){
-		neg = 1;
-		x = -x;
+/**
+ *  @brief  Form firmware or hardware revision message
+ *
+ *  @param  Pointer to buffer for json message
+ *  @param  Member name ("firmware" or "hardware")
+ *  @param  Revision string
+ *
+ *  @return void
+ */
+void Sensors_Json_Revision(char* buf, const char* name, const char* rev){
+	char* ptr;
+
+	ptr = Sensors_Json_Begin(buf);
+	ptr = Sensors_Json_Str(ptr, ",\"");
+	ptr = Sensors_Json_Str(ptr, name);
+	ptr = Sensors_Json_Str(ptr, "\":\"");
+	ptr = Sensors_Json_Str(ptr, rev);
+	Sensors_Json_Str(ptr, "\"}");
+}
+
+/**
+ *  @brief  Form binary sensor data message
+ *
+ *  Header with time stamp is followed by sensor data struct taken from spi frame.
+ *
+ *  @param  Spi message frame with sensor data
+ *  @param  Pointer to buffer for binary message
+ *
+ *  @return Message length, -1 if sensor has no binary data
+ */
+int Sensors_Bin_Form(spi_frame_t* SPI_msg, char* buf){
+	unsigned long long int time;
+	int size, i;
+
+	switch (SPI_msg->data_id)
+	{
+	case DATA_ID_DEV_HTU :
+		size = sizeof(sensor_htu_data_t);
+		break;
+
+	case DATA_ID_DEV_GYRO :
+		size = sizeof(sensor_gyro_data_t);
+		break;
+
+	case DATA_ID_DEV_LIGHT :
+		size = sizeof(sensor_lightprox_data_t);
+		break;
+
+	case DATA_ID_DEV_SOUND :
+		size = sizeof(sensor_microphone_data_t);
+		break;
+
+	case DATA_ID_DEV_BRIDGE :
+		size = ((sensor_bridge_data_t*) &SPI_msg->data[0])->payload_length;
+		if (size > BRIDGE_PAYLOAD_SIZE)
+			size = BRIDGE_PAYLOAD_SIZE;
+		size += 1;
+		break;
+
+	default :
+		return -1;
 	}
 
-	temp_txt[8] = 0;
-	ptr = &temp_txt[7];
-	*ptr-- = Sensors_Convert_x_2_ascii((x /       1) % 10);
-	*ptr-- = Sensors_Convert_x_2_ascii((x /      10) % 10);
-	*ptr-- = '.';
-	*ptr-- = Sensors_Convert_x_2_ascii((x /     100) % 10);
-	*ptr-- = Sensors_Convert_x_2_ascii((x /    1000) % 10);
-	*ptr-- = Sensors_Convert_x_2_ascii((x /   10000) % 10);
-	*ptr-- = Sensors_Convert_x_2_ascii((x /  100000) % 10);
-	*ptr   = Sensors_Convert_x_2_ascii((x / 1000000) % 10);
-
-	while ((*ptr == '0') && (ptr < &temp_txt[4]))
-		ptr ++;
+	buf[0] = SENSORS_BIN_VERSION;
+	buf[1] = SPI_msg->data_id;
 
-	if (neg)
-		* --ptr = '-';
+	time = RTC_GetTime();
+	for (i = 0; i < 8; i ++)
+	{
+		buf[2 + i] = (char) time;
+		time >>= 8;
+	}
 
-	strcpy(txt, (const char *) ptr);
+	// structs are little endian as on master ble module
+	memcpy((void *) &buf[SENSORS_BIN_HEADER_SIZE], (const void *) &SPI_msg->data[0], size);
+
+	// bridge length byte gives the payload bytes which were copied
+	if (SPI_msg->data_id == DATA_ID_DEV_BRIDGE)
+		buf[SENSORS_BIN_HEADER_SIZE] = size - 1;
+
+	return SENSORS_BIN_HEADER_SIZE + size;
 }
 
 /**
@@ -106,9 +240,9 @@ void Sensors_Convert_f_Str(char* txt, int x){
 char Sensors_JSON_StoreMsgId(){
 	char c;
 
-	c = JSON_Msg_FindToken(JSON_MSG_ID, 0);
-	if (c > 0)
-		strcpy(Sensors_MsgID, JSON_Msg_GetTokStr(c));
+	c = JSON_Msg_FindKey(&Sensors_Keys[SENS_KEY_ID], 0);
+	if ((c > 0) && (JSON_Msg_GetStr(c, Sensors_MsgID, sizeof(Sensors_MsgID)) < 0))
+		return 0;
 
 	return c;
 }
@@ -133,54 +267,6 @@ void Sensors_JSON_DiscardMsgId(){
 	memset(Sensors_MsgID, 0, sizeof(Sensors_MsgID));
 }
 
-/**
- *  @brief  Gets int value for desired token string
- *
- *  Searches desired token in json message from given token number, and returns its integer value.
- *  Token should be of int type.
- *
- *  @param  Pointer to string that we search
- *  @param  Token number from which we search,
- *  @param  Return value for desired int data
- *
- *  @return 0  - successful,  -1 -  failed
- */
-int Sensors_JSON_ReadSingleIntValue(char* tokStr, int cnt, int* value){
-	int c;
-
-	if ((c = JSON_Msg_FindToken(tokStr, cnt)) > 0)
-	{
-		sscanf(JSON_Msg_GetTokStr(c), "%d", value);
-		return 0;
-	}
-	else
-		return -1;
-}
-
-/**
- *  @brief  Gets float value for desired token string
- *
- *  Searches desired token in json message from given token number, and returns its float value.
- *  Token should be of float type.
- *
- *  @param  Pointer to string that we search
- *  @param  Token number from which we search,
- *  @param  Return value for desired float data
- *
- *  @return 0  - successful,  -1 -  failed
- */
-int Sensors_JSON_ReadSingleFloatValue(char* tokStr, int cnt, float* value){
-	int c;
-
-	if ((c = JSON_Msg_FindToken(tokStr, cnt)) > 0)
-	{
-		*value = atof(JSON_Msg_GetTokStr(c));
-		return 0;
-	}
-	else
-		return -1;
-}
-
 /**
  *  @brief  Extracts text characteristic from JSON message
  *
@@ -206,111 +292,6 @@ int Sensors_JSON_ReadSingleFloatValue(char* tokStr, int cnt, float* value){
 //		return -1;
 //}
 
-/**
- *  @brief  Extracts beacon frequency characteristic from JSON message
- *
- *  Searches for beacon frequency characteristic and reads its int value.
- *
- *  @param  Return value of beacon frequency
- *
- *  @return 0  - successful,  -1 - failed
- */
-int Sensors_Extract_BeaconFreq(beaconFrequency_t* beaconfreq){
-	if (Sensors_JSON_ReadSingleIntValue(JSON_MSG_FREQ, 0, (int*) beaconfreq) == 0)
-		return 0;
-	else
-		return -1;
-}
-
-/**
- *  @brief  Extracts frequency characteristic from JSON message
- *
- *  Searches for frequency characteristic and reads its int value.
- *
- *  @param  Return value of frequency
- *
- *  @return 0  - successful,  -1 - failed
- */
-int Sensors_Extract_Frequency(frequency_t* freq){
-	if (Sensors_JSON_ReadSingleIntValue(JSON_MSG_FREQ, 0, (int*) freq) == 0)
-		return 0;
-	else
-		return -1;
-}
-
-/**
- *  @brief  Extracts led state characteristic from JSON message
- *
- *  Searches for led state characteristic and reads its bool value.
- *
- *  @param  Return value of led state
- *
- *  @return 0  - successful,  -1 - failed
- */
-int Sensors_Extract_LedState(led_state_t* led){
-	int temp_led;
-	if (Sensors_JSON_ReadSingleIntValue(JSON_MSG_CMD, 0, (int*) &temp_led) == 0)
-	{
-		if (temp_led == 1)
-			*led = true;
-		else
-			*led = false;
-		return 0;
-	}
-	else
-		return -1;
-}
-
-/**
- *  @brief  Extract  three threshold float values
- *
- *  Searches for threshold token in json message from given token number.
- *  And stores three float threshold values in aoppropriate struct.
- *
- *  @param  given start token number
- *  @param  Return float threshold struct
- *
- *  @return 0  - successful,  -1 - failed
- */
-int Sensors_FloatReadThreshould(char cnt, threshold_float_t* f_threshold){
-	// extract hysteresis value
-	if (Sensors_JSON_ReadSingleFloatValue(JSON_MSG_HYSTERESIS, cnt, (float*) &f_threshold->sbl) != 0)
-		return -1;
-	// extract low value
-	if (Sensors_JSON_ReadSingleFloatValue(JSON_MSG_LOW, cnt, (float*) &f_threshold->low) != 0)
-		return -1;
-	// extract high value
-	if (Sensors_JSON_ReadSingleFloatValue(JSON_MSG_HIGH, cnt, (float*) &f_threshold->high) != 0)
-		return -1;
-	// return OK
-	return 0;
-}
-
-/**
- *  @brief  Extract three threshold int values
- *
- *  Searches for threshold token in json message from given token number.
- *  And stores three int threshold values in aoppropriate struct.
- *
- *  @param  given start token number
- *  @param  Return int threshold struct
- *
- *  @return 0  - successful,  -1 - failed
- */
-int Sensors_IntReadThreshold(char cnt, threshold_int16_t* i_threshold){
-	// extract hysteresis value
-	if (Sensors_JSON_ReadSingleIntValue(JSON_MSG_HYSTERESIS, cnt, (int*) &i_threshold->sbl) != 0)
-		return -1;
-	// extract low value
-	if (Sensors_JSON_ReadSingleIntValue(JSON_MSG_LOW, cnt, (int*) &i_threshold->low) != 0)
-		return -1;
-	// extract high value
-	if (Sensors_JSON_ReadSingleIntValue(JSON_MSG_HIGH, cnt, (int*) &i_threshold->high) != 0)
-		return -1;
-	// return OK
-	return 0;
-}
-
 /**
  *  @brief  Form firmware or hardware revision string
  *
@@ -336,10 +317,29 @@ void Sensors_FormFrmHwRevStr(char* txt){
 
 
 /**
- *  @brief  Returns ascii value of a number.
+ *  @brief  Append unsigned integer number to json message
  *
- *  @return ascii
+ *  Digits are formed from the lowest one with 32bit division only.
+ *
+ *  @param  Pointer to end of message
+ *  @param  Value
+ *
+ *  @return Pointer to end of message (terminating zero)
  */
-static char Sensors_Convert_x_2_ascii(uint8_t x){
-	return x + '0';
+static char* Sensors_Json_Uint(char* ptr, uint32_t x){
+	char temp_txt[10];
+	char* digit = &temp_txt[sizeof(temp_txt)];
+
+	do
+	{
+		* --digit = '0' + x % 10;
+		x /= 10;
+	}
+	while (x != 0);
+
+	while (digit < &temp_txt[sizeof(temp_txt)])
+		*ptr ++ = *digit ++;
+
+	*ptr = 0;
+	return ptr;
 }
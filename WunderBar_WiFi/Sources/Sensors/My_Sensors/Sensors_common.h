@@ -46,17 +46,93 @@
 #define JSON_MSG_UP_BRIDGE     "up_ch_payload"
 #define JSON_MSG_BAUDRATE      "baudrate"
 #define JSON_MSG_RESOLUTION    "resolution"
+#define JSON_MSG_ENCODING      "encoding"
+#define JSON_MSG_WINDOW        "window"
+#define JSON_MSG_PERIOD        "period"
+
+// keys searched in messages from cloud, index into Sensors_Keys (hashed once)
+
+typedef enum {
+	SENS_KEY_ID = 0,
+	SENS_KEY_FREQ,
+	SENS_KEY_CMD,
+	SENS_KEY_GYRO,
+	SENS_KEY_ACCEL,
+	SENS_KEY_LIGHT,
+	SENS_KEY_PROX,
+	SENS_KEY_HYSTERESIS,
+	SENS_KEY_LOW,
+	SENS_KEY_HIGH,
+	SENS_KEY_RANGE,
+	SENS_KEY_TEMPERATURE,
+	SENS_KEY_HUMIDITY,
+	SENS_KEY_CONFIG,
+	SENS_KEY_RGBC_GAIN,
+	SENS_KEY_PROX_DRIVE,
+	SENS_KEY_DOWN_BRIDGE,
+	SENS_KEY_BAUDRATE,
+	SENS_KEY_RESOLUTION,
+	SENS_KEY_ENCODING,
+	SENS_KEY_WINDOW,
+	SENS_KEY_PERIOD,
+
+	SENS_KEY_COUNT
+} Sensors_Key_t;
+
+#define SENS_KEY_NONE          0xFF
+
+extern JSON_Key_t Sensors_Keys[SENS_KEY_COUNT];
 
 
 //////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////
 
-// common message templates
+// json messages for mqtt server
+//
+//   {"ts":1420070400000,"val":85}
+//   {"ts":1420070400000,"firmware":"1.0.0"}
+//   {"ts":1420070400000,"hardware":"1.0.0"}
+//
+// messages are formed with Sensors_Json_* functions from integer values in spi frame
 
-#define Template_battery_level 	"{\"ts\":%s,\"val\":%s}"
-#define Template_firmware_rev   "{\"ts\":%s,\"firmware\":\"%s\"}"
-#define Template_hardware_rev   "{\"ts\":%s,\"hardware\":\"%s\"}"
+#define SENSORS_JSON_TS         "{\"ts\":"
+#define SENSORS_JSON_FIRMWARE   "firmware"
+#define SENSORS_JSON_HARDWARE   "hardware"
+
+
+//////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+
+// binary sensor data
+//
+// Sensor data can be published in binary form instead of json, selected per sensor
+// by message {"encoding":"binary"} (or "json") on "<sensor id>/config/encoding" topic.
+// Binary data is published on "<sensor id>/data/bin" topic, all numbers are little endian:
+//
+//   offset  size  content
+//   0       1     SENSORS_BIN_VERSION
+//   1       1     data id of sensor (DATA_ID_DEV_HTU ... DATA_ID_DEV_BRIDGE)
+//   2       8     time stamp, RTC time in ms
+//   10      n     sensor data struct from wunderbar_common.h as received from sensor:
+//
+//   htu     sensor_htu_data_t         n = 4   temperature, humidity (int16, x 100)
+//   gyro    sensor_gyro_data_t        n = 18  gyro x, y, z (int32, x 100), accel x, y, z (int16, x 100)
+//   light   sensor_lightprox_data_t   n = 10  r, g, b, white, proximity (uint16)
+//   sound   sensor_microphone_data_t  n = 2   mic level (int16)
+//   bridge  sensor_bridge_data_t      n = 1 + payload length (uint8 length, payload bytes)
+
+#define SENSORS_BIN_VERSION     1
+#define SENSORS_BIN_HEADER_SIZE 10
+
+#define SENSORS_ENCODING_JSON   "json"
+#define SENSORS_ENCODING_BIN    "binary"
+
+typedef enum {
+	SENS_ENCODING_JSON = 0,
+	SENS_ENCODING_BIN
+} Sensors_Encoding_t;
 
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -66,85 +142,81 @@
 // functions
 
 /**
- *  @brief  Fill threshold 16bit int struct from float values
+ *  @brief  Start json message with time stamp
  *
- *  Three threshold values in int format are represented as its real value multiplied by 100.
+ *  Writes opening brace and "ts" member with current RTC time in ms.
+ *  Message members are then appended with Sensors_Json_* functions.
  *
- *  @param  Thresholf float struct
- *  @param  Return threshold 16bit int struct
+ *  @param  Pointer to buffer for json message
  *
- *  @return void
+ *  @return Pointer to end of message (terminating zero)
  */
-void Sensors_ConvertFloat_2_int16(threshold_float_t f_threshold, threshold_int16_t* t_int16);
+char* Sensors_Json_Begin(char* buf);
 
 /**
- *  @brief  Fill threshold 32bit int struct from float values
- *
- *  Three threshold values in int format are represented as its real value multiplied by 100.
+ *  @brief  Append string to json message
  *
- *  @param  Thresholf float struct
- *  @param  Return threshold 32bit int struct
+ *  @param  Pointer to end of message
+ *  @param  String which is appended (member name, punctuation or text value)
  *
- *  @return void
+ *  @return Pointer to end of message (terminating zero)
  */
+char* Sensors_Json_Str(char* ptr, const char* str);
 
 /**
- *  @brief  Fill threshold 32bit int struct from float values
+ *  @brief  Append integer number to json message
  *
- *  Three threshold values in int format are represented as its real value multiplied by 100.
+ *  @param  Pointer to end of message
+ *  @param  Value
  *
- *  @param  Thresholf float struct
- *  @param  Return threshold 32bit int struct
- *
- *  @return void
+ *  @return Pointer to end of message (terminating zero)
  */
-void Sensors_ConvertFloat_2_int32(threshold_float_t f_threshold, threshold_int32_t* t_int32);
+char* Sensors_Json_Int(char* ptr, int32_t x);
 
 /**
- *  @brief  Convert string of integer into string with two decimal spaces (x / 100)
+ *  @brief  Append number with two decimal places to json message (x / 100)
  *
- *  Input value which is 100 times greater than real (integer representation),
- *  should be transformed into string with its real value.
+ *  Input value is 100 times greater than real value (integer representation).
  *
- *  @param  Return string
- *  @param  Input value
+ *  @param  Pointer to end of message
+ *  @param  Value multiplied by 100
  *
- *  @return void
+ *  @return Pointer to end of message (terminating zero)
  */
-void Sensors_Convert_f_Str(char* txt, int x);
+char* Sensors_Json_Fixed2(char* ptr, int32_t x);
 
 /**
- *  @brief  Extracts led state characteristic from JSON message
+ *  @brief  Form battery level message
  *
- *  Searches for led state characteristic and reads its bool value.
+ *  @param  Pointer to buffer for json message
+ *  @param  Battery level
  *
- *  @param  Return value of led state
- *
- *  @return 0  - successful,  -1 - failed
+ *  @return void
  */
-int  Sensors_Extract_LedState(led_state_t* led);
+void Sensors_Json_BatteryLevel(char* buf, uint8_t level);
 
 /**
- *  @brief  Extracts frequency characteristic from JSON message
+ *  @brief  Form firmware or hardware revision message
  *
- *  Searches for frequency characteristic and reads its int value.
+ *  @param  Pointer to buffer for json message
+ *  @param  Member name (SENSORS_JSON_FIRMWARE or SENSORS_JSON_HARDWARE)
+ *  @param  Revision string
  *
- *  @param  Return value of frequency
- *
- *  @return 0  - successful,  -1 - failed
+ *  @return void
  */
-int  Sensors_Extract_Frequency(frequency_t* freq);
+void Sensors_Json_Revision(char* buf, const char* name, const char* rev);
 
 /**
- *  @brief  Extracts beacon frequency characteristic from JSON message
+ *  @brief  Form binary sensor data message
  *
- *  Searches for beacon frequency characteristic and reads its int value.
+ *  Header with time stamp is followed by sensor data struct taken from spi frame.
  *
- *  @param  Return value of beacon frequency
+ *  @param  Spi message frame with sensor data
+ *  @param  Pointer to buffer for binary message
  *
- *  @return 0  - successful,  -1 - failed
+ *  @return Message length, -1 if sensor has no binary data
  */
-int  Sensors_Extract_BeaconFreq(beaconFrequency_t* beaconfreq);
+int Sensors_Bin_Form(spi_frame_t* SPI_msg, char* buf);
 
 /**
  *  @brief  Extracts text characteristic from JSON message
@@ -160,32 +232,6 @@ int  Sensors_Extract_BeaconFreq(beaconFrequency_t* beaconfreq);
  */
 //int  Sensors_Extract_Pass(char* passkey);
 
-/**
- *  @brief  Extract  three threshold float values
- *
- *  Searches for threshold token in json message from given token number.
- *  And stores three float threshold values in aoppropriate struct.
- *
- *  @param  given start token number
- *  @param  Return float threshold struct
- *
- *  @return 0  - successful,  -1 - failed
- */
-int  Sensors_FloatReadThreshould(char cnt, threshold_float_t* f_threshold);
-
-/**
- *  @brief  Extract three threshold int values
- *
- *  Searches for threshold token in json message from given token number.
- *  And stores three int threshold values in aoppropriate struct.
- *
- *  @param  given start token number
- *  @param  Return int threshold struct
- *
- *  @return 0  - successful,  -1 - failed
- */
-int  Sensors_IntReadThreshold(char cnt, threshold_int16_t* i_threshold);
-
 /**
  *  @brief  Form firmware or hardware revision string
  *
@@ -221,34 +267,6 @@ char* Sensors_JSON_GetStoredMsgId();
  */
 void Sensors_JSON_DiscardMsgId();
 
-/**
- *  @brief  Gets int value for desired token string
- *
- *  Searches desired token in json message from given token number, and returns its integer value.
- *  Token should be of int type.
- *
- *  @param  Pointer to string that we search
- *  @param  Token number from which we search,
- *  @param  Return value for desired int data
- *
- *  @return 0  - successful,  -1 -  failed
- */
-int  Sensors_JSON_ReadSingleIntValue(char* tokStr, int cnt, int* value);
-
-/**
- *  @brief  Gets float value for desired token string
- *
- *  Searches desired token in json message from given token number, and returns its float value.
- *  Token should be of float type.
- *
- *  @param  Pointer to string that we search
- *  @param  Token number from which we search,
- *  @param  Return value for desired float data
- *
- *  @return 0  - successful,  -1 -  failed
- */
-int  Sensors_JSON_ReadSingleFloatValue(char* tokStr, int cnt, float* value);
-
 /**
  *  @brief  Get ble firmware revision string
  *
@@ -263,13 +281,8 @@ char* Sensors_GetBleFirmRevStr();
 
 // Sensors Process Data functions (down from cloud)
 
-int Sensors_htu_ProcessData   (spi_frame_t* SPI_msg, char* msg);
-int Sensors_ir_ProcessData    (spi_frame_t* SPI_msg, char* msg);
-int Sensors_light_ProcessData (spi_frame_t* SPI_msg, char* msg);
-int Sensors_gyro_ProcessData  (spi_frame_t* SPI_msg, char* msg);
-int Sensors_sound_ProcessData (spi_frame_t* SPI_msg, char* msg);
-int Sensors_bridge_ProcessData(spi_frame_t* SPI_msg, char* msg);
-int MainBoard_ProcessData     (spi_frame_t* SPI_msg, char* msg);
+int Sensors_Schema_ProcessData(spi_frame_t* SPI_msg, char* msg);		// all sensor boards, see Sensors_Schema.c
+int MainBoard_ProcessData      (spi_frame_t* SPI_msg, char* msg);
 
 
 //////////////////////////////////////////////////////////////////////////////////
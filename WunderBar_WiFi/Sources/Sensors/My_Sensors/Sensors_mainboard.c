@@ -6,7 +6,6 @@
  */
 
 
-#include <stdio.h>
 #include "Sensors_common.h"
 #include <hardware/Hw_modules.h>
 #include "Common_Defaults.h"
@@ -17,11 +16,12 @@ void MainBoard_Update_FwRev(spi_frame_t* SPI_msg);
 
 
 /*
- *  Template for JSON message response
+ *  JSON message response
  *  message on mqtt server will be in this format
+ *
+ *  {"ts":1420070400000,"kinetis":"1.0.0","master ble":"1.0.0"}
+ *  {"ts":1420070400000,"hardware":"1.0.0"}
  */
-#define Template_main_firmware_rev   "{\"ts\":%s,\"kinetis\":\"%s\",\"master ble\":\"%s\"}"
-#define Template_main_hardware_rev   "{\"ts\":%s,\"hardware\":\"%s\"}"
 
 /**
  *  @brief  Get ble firmware revision string
@@ -46,23 +46,24 @@ char* Sensors_GetBleFirmRevStr(){
  */
 void MainBoard_Update(spi_frame_t* SPI_msg, char* buf){
 
-	char time[30];
+	char* ptr;
 
 	switch (SPI_msg->field_id)
 	{
 		// post firmware revision
 	case FIELD_ID_CHAR_FIRMWARE_REVISION :
 
-		RTC_GetSystemTimeStr(time);
-		sprintf(buf, Template_main_firmware_rev, time, KINETIS_FIRMWARE_REV, FirmwareRev);
+		ptr = Sensors_Json_Begin(buf);
+		ptr = Sensors_Json_Str(ptr, ",\"kinetis\":\"" KINETIS_FIRMWARE_REV "\",\"master ble\":\"");
+		ptr = Sensors_Json_Str(ptr, FirmwareRev);
+		Sensors_Json_Str(ptr, "\"}");
 
 		break;
 
 		// post hardware revision
 	case FIELD_ID_CHAR_HARDWARE_REVISION :
 
-		RTC_GetSystemTimeStr(time);
-		sprintf(buf, Template_main_hardware_rev, time, MAIN_BOARD_HW_REV);
+		Sensors_Json_Revision(buf, SENSORS_JSON_HARDWARE, MAIN_BOARD_HW_REV);
 
 		break;
 
@@ -0,0 +1,359 @@
+/** @file   Sensors_Aggr.c
+ *  @brief  File contains functions for aggregating sensor data over a window
+ *  		of samples or time, so one summary message is published per window
+ *  		instead of one message per notification.
+ *
+ *  		Every sensor has a table of numeric channels in its data struct,
+ *  		in the order they appear in regular json message. Window keeps
+ *  		min, max, sum and last value of every channel as received from sensor.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include <hardware/Hw_modules.h>
+#include "Sensors_Aggr.h"
+#include "My_Sensors/Sensors_common.h"
+
+
+// numeric channel of sensor data
+
+typedef enum {
+	AGGR_INT16 = 0,
+	AGGR_UINT16,
+	AGGR_INT32
+} Aggr_Type_t;
+
+typedef struct {
+	const char* name;						// json text written before channel value
+	uint8_t offset;							// offset in sensor data struct
+	uint8_t type;							// Aggr_Type_t
+} Aggr_Channel_t;
+
+typedef struct {
+	const Aggr_Channel_t* channels;			// NULL if sensor data is not numeric
+	uint8_t count;
+	bool fixed2;							// values are 100 times greater than real value
+	const char* end;						// json text written after last channel
+} Aggr_Sensor_t;
+
+// window of one sensor
+
+typedef struct {
+	uint16_t window;						// samples per window, 0 if not set (passthrough if period is not set either)
+	uint32_t period;						// ms per window, 0 if not set
+	uint32_t count;							// samples in window
+	unsigned long long int start;			// ms timer value at first sample
+	int32_t min [SENS_AGGR_CHANNELS_MAX];
+	int32_t max [SENS_AGGR_CHANNELS_MAX];
+	int32_t last[SENS_AGGR_CHANNELS_MAX];
+	int64_t sum [SENS_AGGR_CHANNELS_MAX];
+} Aggr_Window_t;
+
+#define AGGR_CHANNELS(table)	(table), (sizeof(table) / sizeof(table[0]))
+
+
+// static declarations
+
+static const Aggr_Channel_t Aggr_HtuChannels[] = {
+	{",\"temp\":",				offsetof(sensor_htu_data_t, temperature),		AGGR_INT16},
+	{",\"hum\":",				offsetof(sensor_htu_data_t, humidity),			AGGR_INT16}
+};
+
+static const Aggr_Channel_t Aggr_GyroChannels[] = {
+	{",\"gyro\":{\"x\":",		offsetof(sensor_gyro_data_t, gyro.x),			AGGR_INT32},
+	{",\"y\":",					offsetof(sensor_gyro_data_t, gyro.y),			AGGR_INT32},
+	{",\"z\":",					offsetof(sensor_gyro_data_t, gyro.z),			AGGR_INT32},
+	{"},\"accel\":{\"x\":",		offsetof(sensor_gyro_data_t, acc.x),			AGGR_INT16},
+	{",\"y\":",					offsetof(sensor_gyro_data_t, acc.y),			AGGR_INT16},
+	{",\"z\":",					offsetof(sensor_gyro_data_t, acc.z),			AGGR_INT16}
+};
+
+static const Aggr_Channel_t Aggr_LightChannels[] = {
+	{",\"light\":",				offsetof(sensor_lightprox_data_t, white),		AGGR_UINT16},
+	{",\"clr\":{\"r\":",		offsetof(sensor_lightprox_data_t, r),			AGGR_UINT16},
+	{",\"g\":",					offsetof(sensor_lightprox_data_t, g),			AGGR_UINT16},
+	{",\"b\":",					offsetof(sensor_lightprox_data_t, b),			AGGR_UINT16},
+	{"},\"prox\":",				offsetof(sensor_lightprox_data_t, proximity),	AGGR_UINT16}
+};
+
+static const Aggr_Channel_t Aggr_SoundChannels[] = {
+	{",\"snd_level\":",			offsetof(sensor_microphone_data_t, mic_level),	AGGR_INT16}
+};
+
+static const Aggr_Sensor_t Aggr_Sensors[NUMBER_OF_SENSORS] = {
+	{AGGR_CHANNELS(Aggr_HtuChannels),	true,	"}"},		// DATA_ID_DEV_HTU
+	{AGGR_CHANNELS(Aggr_GyroChannels),	true,	"}}"},		// DATA_ID_DEV_GYRO
+	{AGGR_CHANNELS(Aggr_LightChannels),	false,	"}"},		// DATA_ID_DEV_LIGHT
+	{AGGR_CHANNELS(Aggr_SoundChannels),	false,	"}"},		// DATA_ID_DEV_SOUND
+	{NULL, 0, false, NULL},									// DATA_ID_DEV_BRIDGE
+	{NULL, 0, false, NULL}									// DATA_ID_DEV_IR
+};
+
+static Aggr_Window_t Aggr_Windows[NUMBER_OF_SENSORS];
+static Sensors_Aggr_Stats_t Aggr_Stats;
+
+static int32_t Sensors_Aggr_GetValue(const uint8_t* data, const Aggr_Channel_t* channel);
+static int32_t Sensors_Aggr_Mean(int64_t sum, uint32_t count);
+static char*   Sensors_Aggr_Value(char* ptr, int32_t x, bool fixed2);
+static void    Sensors_Aggr_Summary(data_id_t sensor, char* buf);
+
+
+///////////////////////////////////////
+/*         public functions          */
+///////////////////////////////////////
+
+
+/**
+ *  @brief  Configure aggregation of sensor data
+ *
+ *  Parses {"window":n,"period":ms} message. Missing member is 0,
+ *  both 0 selects passthrough.
+ *
+ *  @param  Sensor data id
+ *  @param  Json message
+ *
+ *  @return 0  - successful,  -1 - failed (setting is not changed)
+ */
+int Sensors_Aggr_Config(data_id_t sensor, char* msg){
+	Aggr_Window_t* win;
+	int32_t window = 0, period = 0;
+	int tokWindow, tokPeriod;
+
+	if ((sensor >= NUMBER_OF_SENSORS) || (Aggr_Sensors[sensor].channels == NULL))
+		return -1;
+
+	if (JSON_Msg_Parse(msg) <= 0)
+		return -1;
+
+	tokWindow = JSON_Msg_FindKey(&Sensors_Keys[SENS_KEY_WINDOW], 0);
+	tokPeriod = JSON_Msg_FindKey(&Sensors_Keys[SENS_KEY_PERIOD], 0);
+
+	if ((tokWindow < 0) && (tokPeriod < 0))
+		return -1;
+
+	if ((tokWindow > 0) && (JSON_Msg_GetInt(tokWindow, &window) != 0))
+		return -1;
+
+	if ((tokPeriod > 0) && (JSON_Msg_GetInt(tokPeriod, &period) != 0))
+		return -1;
+
+	if ((window < 0) || (window > SENS_AGGR_WINDOW_MAX) || (period < 0) || (period > SENS_AGGR_PERIOD_MAX))
+		return -1;
+
+	win = &Aggr_Windows[sensor];
+
+	Aggr_Stats.discarded += win->count;
+	win->count  = 0;
+	win->window = window;
+	win->period = period;
+
+	return 0;
+}
+
+/**
+ *  @brief  Add sensor data sample to window
+ *
+ *  Should be called for every sensor data message received from sensor.
+ *
+ *  @param  Spi message frame with sensor data
+ *  @param  Pointer to buffer for summary json message
+ *
+ *  @return SENS_AGGR_PASS, SENS_AGGR_HOLD, or SENS_AGGR_READY when summary is in buffer
+ */
+Sensors_Aggr_Result_t Sensors_Aggr_Add(spi_frame_t* SPI_msg, char* buf){
+	const Aggr_Sensor_t* sens;
+	Aggr_Window_t* win;
+	int32_t value;
+	int i;
+
+	if (SPI_msg->data_id >= NUMBER_OF_SENSORS)
+		return SENS_AGGR_PASS;
+
+	sens = &Aggr_Sensors[SPI_msg->data_id];
+	win  = &Aggr_Windows[SPI_msg->data_id];
+
+	if ((win->window == 0) && (win->period == 0))
+		return SENS_AGGR_PASS;
+
+	if (win->count == 0)
+		win->start = MSTimerGet();
+
+	for (i = 0; i < sens->count; i ++)
+	{
+		value = Sensors_Aggr_GetValue(&SPI_msg->data[0], &sens->channels[i]);
+
+		if (win->count == 0)
+		{
+			win->min[i] = value;
+			win->max[i] = value;
+			win->sum[i] = 0;
+		}
+		else if (value < win->min[i])
+			win->min[i] = value;
+		else if (value > win->max[i])
+			win->max[i] = value;
+
+		win->sum[i] += value;
+		win->last[i] = value;
+	}
+
+	win->count ++;
+	Aggr_Stats.samples ++;
+
+	// time only window has no sample limit
+	if (((win->window == 0) || (win->count < win->window)) && ((win->period == 0) || (MSTimerGet() - win->start < win->period)))
+		return SENS_AGGR_HOLD;
+
+	Sensors_Aggr_Summary(SPI_msg->data_id, buf);
+	return SENS_AGGR_READY;
+}
+
+/**
+ *  @brief  Close expired time window
+ *
+ *  Should be called periodically, so window is closed
+ *  when sensor stops sending data.
+ *
+ *  @param  Sensor data id
+ *  @param  Pointer to buffer for summary json message
+ *
+ *  @return True if window period has elapsed and summary is in buffer
+ */
+bool Sensors_Aggr_Expired(data_id_t sensor, char* buf){
+	Aggr_Window_t* win;
+
+	if (sensor >= NUMBER_OF_SENSORS)
+		return false;
+
+	win = &Aggr_Windows[sensor];
+
+	if ((win->count == 0) || (win->period == 0) || (MSTimerGet() - win->start < win->period))
+		return false;
+
+	Sensors_Aggr_Summary(sensor, buf);
+	return true;
+}
+
+/**
+ *  @brief  Gets aggregation counters
+ *
+ *  @param  Return stats struct
+ *
+ *  @return void
+ */
+void Sensors_Aggr_GetStats(Sensors_Aggr_Stats_t* stats){
+	*stats = Aggr_Stats;
+}
+
+
+
+///////////////////////////////////////
+/*         static functions          */
+///////////////////////////////////////
+
+
+/**
+ *  @brief  Read channel value from sensor data
+ *
+ *  Sensor data structs are packed, value is copied to avoid unaligned access.
+ *
+ *  @param  Sensor data from spi frame
+ *  @param  Channel
+ *
+ *  @return Channel value
+ */
+static int32_t Sensors_Aggr_GetValue(const uint8_t* data, const Aggr_Channel_t* channel){
+	int16_t  i16;
+	uint16_t u16;
+	int32_t  i32;
+
+	switch (channel->type)
+	{
+	case AGGR_INT16 :
+		memcpy((void *) &i16, (const void *) &data[channel->offset], sizeof(i16));
+		return i16;
+
+	case AGGR_UINT16 :
+		memcpy((void *) &u16, (const void *) &data[channel->offset], sizeof(u16));
+		return u16;
+
+	default :
+		memcpy((void *) &i32, (const void *) &data[channel->offset], sizeof(i32));
+		return i32;
+	}
+}
+
+/**
+ *  @brief  Mean value of window rounded to nearest (half away from zero)
+ *
+ *  @param  Sum of values
+ *  @param  Number of values
+ *
+ *  @return Mean value
+ */
+static int32_t Sensors_Aggr_Mean(int64_t sum, uint32_t count){
+	if (sum < 0)
+		return - (int32_t) (((uint64_t) - sum + count / 2) / count);
+
+	return (int32_t) (((uint64_t) sum + count / 2) / count);
+}
+
+/**
+ *  @brief  Append channel value to json message
+ *
+ *  @param  Pointer to end of message
+ *  @param  Value
+ *  @param  True if value is 100 times greater than real value
+ *
+ *  @return Pointer to end of message (terminating zero)
+ */
+static char* Sensors_Aggr_Value(char* ptr, int32_t x, bool fixed2){
+	if (fixed2)
+		return Sensors_Json_Fixed2(ptr, x);
+
+	return Sensors_Json_Int(ptr, x);
+}
+
+/**
+ *  @brief  Form summary message and start new window
+ *
+ *  Every channel is written as [min,max,mean,last] (see Sensors_Aggr.h).
+ *
+ *  @param  Sensor data id
+ *  @param  Pointer to buffer for summary json message
+ *
+ *  @return void
+ */
+static void Sensors_Aggr_Summary(data_id_t sensor, char* buf){
+	const Aggr_Sensor_t* sens = &Aggr_Sensors[sensor];
+	Aggr_Window_t* win = &Aggr_Windows[sensor];
+	char* ptr;
+	int i;
+
+	ptr = Sensors_Json_Begin(buf);
+	ptr = Sensors_Json_Str(ptr, ",\"cnt\":");
+	ptr = Sensors_Json_Int(ptr, win->count);
+
+	for (i = 0; i < sens->count; i ++)
+	{
+		ptr = Sensors_Json_Str(ptr, sens->channels[i].name);
+		ptr = Sensors_Json_Str(ptr, "[");
+		ptr = Sensors_Aggr_Value(ptr, win->min[i], sens->fixed2);
+		ptr = Sensors_Json_Str(ptr, ",");
+		ptr = Sensors_Aggr_Value(ptr, win->max[i], sens->fixed2);
+		ptr = Sensors_Json_Str(ptr, ",");
+		ptr = Sensors_Aggr_Value(ptr, Sensors_Aggr_Mean(win->sum[i], win->count), sens->fixed2);
+		ptr = Sensors_Json_Str(ptr, ",");
+		ptr = Sensors_Aggr_Value(ptr, win->last[i], sens->fixed2);
+		ptr = Sensors_Json_Str(ptr, "]");
+	}
+
+	Sensors_Json_Str(ptr, sens->end);
+
+	win->count = 0;
+	Aggr_Stats.summaries ++;
+}
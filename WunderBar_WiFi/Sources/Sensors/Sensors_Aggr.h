@@ -0,0 +1,108 @@
+/** @file   Sensors_Aggr.h
+ *  @brief  File contains functions for aggregating sensor data over a window
+ *  		of samples or time, so one summary message is published per window
+ *  		instead of one message per notification.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#ifndef SENSORS_AGGR_H_
+#define SENSORS_AGGR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "wunderbar_common.h"
+
+
+// Aggregation is selected per sensor by message on "<sensor id>/config/aggregate" topic:
+//
+//   {"window":20}                 summary of every 20 samples
+//   {"period":5000}               summary of samples received in 5000 ms
+//   {"window":20,"period":5000}   whichever comes first
+//   {"window":0}                  passthrough, every sample is published (default)
+//
+// Time window starts with its first sample and is closed by the first sample or
+// aggregation task call after period has elapsed. Window with period only is not
+// limited in number of samples. Changing setting discards samples
+// of unfinished window. Setting is kept until reset.
+//
+// Summary is published on "<sensor id>/data" topic in json (regardless of encoding),
+// every channel of sensor data is replaced with [min,max,mean,last] in units of the
+// regular message, "cnt" is number of samples in window:
+//
+//   {"ts":1420070400000,"cnt":20,"temp":[21.40,21.90,21.62,21.80],"hum":[45.10,46.00,45.47,45.90]}
+//
+// Values are kept in fixed point as received from sensor, mean is rounded to nearest.
+// Only htu, gyro, light and sound sensors have numeric data, bridge and ir are always passthrough.
+
+#define SENS_AGGR_WINDOW_MAX	0xFFFF			// samples per window
+#define SENS_AGGR_PERIOD_MAX	3600000			// ms per window
+#define SENS_AGGR_CHANNELS_MAX	6				// numeric values in sensor data (gyro)
+
+typedef enum {
+	SENS_AGGR_PASS = 0,							// sample is not aggregated, publish it
+	SENS_AGGR_HOLD,								// sample is added to window
+	SENS_AGGR_READY								// sample closed window, summary is formed
+} Sensors_Aggr_Result_t;
+
+// aggregation counters
+
+typedef struct {
+	uint32_t samples;							// samples added to windows
+	uint32_t summaries;							// summaries formed
+	uint32_t discarded;							// samples discarded with unfinished window
+} Sensors_Aggr_Stats_t;
+
+
+// public functions
+
+/**
+ *  @brief  Configure aggregation of sensor data
+ *
+ *  Parses {"window":n,"period":ms} message. Missing member is 0,
+ *  both 0 selects passthrough.
+ *
+ *  @param  Sensor data id
+ *  @param  Json message
+ *
+ *  @return 0  - successful,  -1 - failed (setting is not changed)
+ */
+int Sensors_Aggr_Config(data_id_t sensor, char* msg);
+
+/**
+ *  @brief  Add sensor data sample to window
+ *
+ *  Should be called for every sensor data message received from sensor.
+ *
+ *  @param  Spi message frame with sensor data
+ *  @param  Pointer to buffer for summary json message
+ *
+ *  @return SENS_AGGR_PASS, SENS_AGGR_HOLD, or SENS_AGGR_READY when summary is in buffer
+ */
+Sensors_Aggr_Result_t Sensors_Aggr_Add(spi_frame_t* SPI_msg, char* buf);
+
+/**
+ *  @brief  Close expired time window
+ *
+ *  Should be called periodically, so window is closed
+ *  when sensor stops sending data.
+ *
+ *  @param  Sensor data id
+ *  @param  Pointer to buffer for summary json message
+ *
+ *  @return True if window period has elapsed and summary is in buffer
+ */
+bool Sensors_Aggr_Expired(data_id_t sensor, char* buf);
+
+/**
+ *  @brief  Gets aggregation counters
+ *
+ *  @param  Return stats struct
+ *
+ *  @return void
+ */
+void Sensors_Aggr_GetStats(Sensors_Aggr_Stats_t* stats);
+
+#endif // SENSORS_AGGR_H_
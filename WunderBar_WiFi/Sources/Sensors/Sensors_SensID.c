@@ -10,6 +10,7 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include <hardware/Hw_modules.h>
 #include "Common_Defaults.h"
 #include "Sensors_main.h"
 #include "Sensors_SensID.h"
@@ -18,19 +19,52 @@
 
 // static declarations
 
-static SensId_t MySensorList[NUMBER_OF_SENSORS];
+// topics collected for one subscribe (or unsubscribe) message
+typedef struct {
+	char			buf[MQTT_SUB_PACKET_MAX];		// zero terminated topics, one after another
+	int				len;
+	int				remLen;							// remaining length of serialized packet
+	unsigned char	count;
+	unsigned char	sensors;						// bit mask of sensors with topics in list
+	char			unsub;
+} SensSubList_t;
 
+static SensId_t MySensorList[NUMBER_OF_SENSORS];
 
-static void Sensors_ID_CreateSubPath(char* buf, char* path, unsigned char index);
+// uplink topics of connected sensors, last row holds main board topics
+static SensTopic_t MyTopicTable[NUMBER_OF_SENSORS + 1][SENSOR_TOPIC_COUNT];
+
+// uplink subtopic of each sensor characteristic (field id)
+static const char* const sensors_up_subtopics[SENSOR_TOPIC_COUNT] = {
+	NULL,							// FIELD_ID_CHAR_SENSOR_ID
+	SENS_UP_CHAR_BEACONFREQ,		// FIELD_ID_CHAR_SENSOR_BEACON_FREQUENCY
+	SENS_UP_CHAR_FREQUENCY,			// FIELD_ID_CHAR_SENSOR_FREQUENCY
+	SENS_UP_LED_STATE,				// FIELD_ID_CHAR_SENSOR_LED_STATE
+	SENS_UP_CHAR_THRESHOLD,			// FIELD_ID_CHAR_SENSOR_THRESHOLD
+	SENS_UP_CHAR_SENSCFG,			// FIELD_ID_CHAR_SENSOR_CONFIG
+	SENS_UP_DATA,					// FIELD_ID_CHAR_SENSOR_DATA_R
+	SENS_DOWN_DATA,					// FIELD_ID_CHAR_SENSOR_DATA_W
+	SENS_UP_CHAR_BATTERY_LEVEL,		// FIELD_ID_CHAR_BATTERY_LEVEL
+	SENS_UP_MANUFACTURER_NAME,		// FIELD_ID_CHAR_MANUFACTURER_NAME
+	SENS_UP_HARDWAREREV,			// FIELD_ID_CHAR_HARDWARE_REVISION
+	SENS_UP_FIRMWAREREV,			// FIELD_ID_CHAR_FIRMWARE_REVISION
+	SENS_UP_DATA_BIN				// SENSOR_TOPIC_DATA_BIN
+};
+
+
+static void Sensors_ID_SubListInit(SensSubList_t* list, char unsub);
+static int  Sensors_ID_SubListAdd(SensSubList_t* list, unsigned char index, const char* id, const char* path);
+static void Sensors_ID_SubListFlush(SensSubList_t* list);
 static void Sensors_ID_StoreSensor(char* id, unsigned char index);
-static void Sensors_ID_ScheduleForSub(unsigned char index);
-static void Sensors_ID_ScheduleForUnsub(unsigned char index);
+static void Sensors_ID_ScheduleForSub(SensSubList_t* list, unsigned char index);
+static void Sensors_ID_ScheduleForUnsub(SensSubList_t* list, unsigned char index);
 static void Sensors_ID_ByteToHex(char* txt, char x);
-static void Sensors_ID_SubscribeMainBoard();
+static void Sensors_ID_SubscribeMainBoard(SensSubList_t* list);
 static void Sensors_ID_SetActive(unsigned char index);
 static void Sensors_ID_Clear(unsigned char index);
 static void Sensors_ID_SetNeedUpdate(unsigned char index);
 static void Sensors_ID_ClrNeedUpdate(unsigned char index);
+static void Sensors_ID_BuildTopics(unsigned char row, const char* id);
 
 
 
@@ -65,6 +99,61 @@ char Sensors_ID_GetActiveStatus(unsigned char index){
 	return MySensorList[index].active;
 }
 
+/**
+ *  @brief  Gets uplink topic for desired sensor characteristic
+ *
+ *  Returns pointer to topic pre-rendered in topic table when sensor was connected
+ *  (main board topics are rendered on mqtt connect). Topic is zero terminated.
+ *
+ *  @param  sensor index (DATA_ID_DEV_CENTRAL for main board)
+ *  @param  sensor field id
+ *  @param  return topic length
+ *
+ *  @return Pointer to topic string, NULL if there is no topic for sensor characteristic
+ */
+const char* Sensors_ID_GetTopic(unsigned char index, unsigned char field_id, int* len){
+	SensTopic_t* topic;
+
+	if (index == DATA_ID_DEV_CENTRAL)
+		index = NUMBER_OF_SENSORS;
+	else if (index >= NUMBER_OF_SENSORS)
+		return NULL;
+
+	if (field_id >= SENSOR_TOPIC_FIELDS)
+		return NULL;
+
+	topic = &MyTopicTable[index][field_id];
+	if (topic->len == 0)
+		return NULL;
+
+	*len = topic->len;
+	return (const char *) topic->str;
+}
+
+/**
+ *  @brief  Gets uplink topic for binary sensor data
+ *
+ *  Binary data is published on its own subtopic, so content type is known from the topic.
+ *
+ *  @param  sensor index
+ *  @param  return topic length
+ *
+ *  @return Pointer to topic string, NULL if sensor is not connected
+ */
+const char* Sensors_ID_GetBinTopic(unsigned char index, int* len){
+	SensTopic_t* topic;
+
+	if (index >= NUMBER_OF_SENSORS)
+		return NULL;
+
+	topic = &MyTopicTable[index][SENSOR_TOPIC_DATA_BIN];
+	if (topic->len == 0)
+		return NULL;
+
+	*len = topic->len;
+	return (const char *) topic->str;
+}
+
 /**
  *  @brief  Process connection status received from ble master
  *
@@ -79,17 +168,23 @@ char Sensors_ID_GetActiveStatus(unsigned char index){
  *  @return void
  */
 void Sensors_ID_Process(char* id, char sensIndex, char connStatus){
+	SensSubList_t list;
+
 	// if connection
 	if (connStatus == 0)
 	{
 		Sensors_ID_StoreSensor(id, (unsigned char) sensIndex);
-		Sensors_ID_ScheduleForSub((unsigned char) sensIndex);
+		Sensors_ID_SubListInit(&list, 0);
+		Sensors_ID_ScheduleForSub(&list, (unsigned char) sensIndex);
+		Sensors_ID_SubListFlush(&list);
 	}
 	else if (connStatus == 1)  // if disconnected
 	{
 		if (Sensors_ID_GetActiveStatus((unsigned char) sensIndex) == 1)
 		{
-			Sensors_ID_ScheduleForUnsub((unsigned char) sensIndex);
+			Sensors_ID_SubListInit(&list, 1);
+			Sensors_ID_ScheduleForUnsub(&list, (unsigned char) sensIndex);
+			Sensors_ID_SubListFlush(&list);
 		}
 		Sensors_ID_Clear((unsigned char) sensIndex); // delete sensor from list
 	}
@@ -98,22 +193,36 @@ void Sensors_ID_Process(char* id, char sensIndex, char connStatus){
 /**
  *  @brief  Process successful subscription or unsubscription
  *
- *  When subscription or unsubscription is acknowledged clear need update flag
+ *  Called for every topic of acknowledged message. Need update flag of sensor
+ *  is cleared when all its topics are granted, rejected topic keeps it set
+ *  until sensor is subscribed again.
  *
  *  @param  subscribe topic
+ *  @param  suback return code of the topic (MQTT_SUBACK_FAILURE if rejected)
  *
  *  @return void
  */
-void Sensors_ID_ProcessSuccessfulSubscription(char* topic){
+void Sensors_ID_ProcessSuccessfulSubscription(char* topic, unsigned char code){
+	SensId_t* sens;
 	unsigned char cnt;
 
 	for (cnt = 0; cnt < NUMBER_OF_SENSORS; cnt ++)
 	{
-		if (MySensorList[cnt].needUpdate == 1)
-		{
-			if (strstr((const char *) topic, (const char *) MySensorList[cnt].SensorIDstr))
-				Sensors_ID_ClrNeedUpdate(cnt);
-		}
+		sens = &MySensorList[cnt];
+
+		if ((sens->active == 0) || (sens->needUpdate == 0))
+			continue;
+
+		if (strstr((const char *) topic, (const char *) sens->SensorIDstr) == NULL)
+			continue;
+
+		if (code == MQTT_SUBACK_FAILURE)
+			sens->subFailed = 1;
+		else if (sens->subPending)
+			sens->subPending --;
+
+		if ((sens->subPending == 0) && (sens->subFailed == 0))
+			Sensors_ID_ClrNeedUpdate(cnt);
 	}
 }
 
@@ -174,18 +283,52 @@ void Sensors_ID_FormSensIdStr(char* sensIdStr, char* sensIdArr){
 /**
  *  @brief  Goes through entire list of sensors and subscribes on all connected sensors
  *
+ *  Topics of all sensors are packed into as few subscribe messages as possible.
+ *
  *  @return void
  */
 void Sensors_ID_CheckSubList(){
+	SensSubList_t list;
 	unsigned char i;
 
+	Sensors_ID_SubListInit(&list, 0);
+
 	for (i = 0; i < NUMBER_OF_SENSORS; i ++)
 	{
 		if (Sensors_ID_GetActiveStatus(i))
-			Sensors_ID_ScheduleForSub(i);
+			Sensors_ID_ScheduleForSub(&list, i);
 	}
 
-	Sensors_ID_SubscribeMainBoard();
+	Sensors_ID_SubscribeMainBoard(&list);
+	Sensors_ID_SubListFlush(&list);
+}
+
+/**
+ *  @brief  Subscribes again sensors with need update flag set
+ *
+ *  Topics of sensor are scheduled again SENS_ID_SUB_RETRY_PERIOD after
+ *  previous attempt, if any of them was rejected, not scheduled or not acknowledged.
+ *  Should be called periodically.
+ *
+ *  @return void
+ */
+void Sensors_ID_RetrySubList(){
+	SensSubList_t list;
+	unsigned char i;
+
+	if (MQTT_Get_RunnigStatus() == 0)
+		return;
+
+	Sensors_ID_SubListInit(&list, 0);
+
+	for (i = 0; i < NUMBER_OF_SENSORS; i ++)
+	{
+		if ((Sensors_ID_GetActiveStatus(i)) && (MySensorList[i].needUpdate == 1) &&
+				(MSTimerDelta(MySensorList[i].subTime) > SENS_ID_SUB_RETRY_PERIOD))
+			Sensors_ID_ScheduleForSub(&list, i);
+	}
+
+	Sensors_ID_SubListFlush(&list);
 }
 
 /**
@@ -196,14 +339,19 @@ void Sensors_ID_CheckSubList(){
  *  @return void
  */
 void Sensors_ID_ClearList(){
+	SensSubList_t list;
 	unsigned char i;
 
+	Sensors_ID_SubListInit(&list, 1);
+
 	for (i = 0; i < NUMBER_OF_SENSORS; i ++)
 	{
 		if (Sensors_ID_GetActiveStatus(i))
-			Sensors_ID_ScheduleForUnsub(i);
+			Sensors_ID_ScheduleForUnsub(&list, i);
 		Sensors_ID_Clear(i);
 	}
+
+	Sensors_ID_SubListFlush(&list);
 }
 
 
@@ -229,18 +377,93 @@ static void Sensors_ID_SetActive(unsigned char index){
 }
 
 /**
- *  @brief  Creates subtopic sub path with sensor ID and desired subtopic
+ *  @brief  Starts empty subscription topic list
  *
- *  Create subscribe topic with desired sensor id and subtopic
+ *  @param  topic list
+ *  @param  1 for unsubscribe list, 0 for subscribe list
  *
- *  @param  pointer to output buffer for result string
+ *  @return void
+ */
+static void Sensors_ID_SubListInit(SensSubList_t* list, char unsub){
+	list->len    = 0;
+	list->remLen = 2;				// message id
+	list->count  = 0;
+	list->sensors = 0;
+	list->unsub  = unsub;
+}
+
+/**
+ *  @brief  Adds topic to subscription topic list
+ *
+ *  Creates topic with desired sensor id and subtopic. If serialized packet
+ *  would not fit into MQTT_SUB_PACKET_MAX, topics collected so far
+ *  are scheduled first.
+ *
+ *  @param  topic list
+ *  @param  sensor index (NUMBER_OF_SENSORS for main board)
+ *  @param  sensor id string
  *  @param  desired path
- *  @param  sensor index
+ *
+ *  @return 0  - successful,  -1 - failed (topic does not fit into list)
+ */
+static int Sensors_ID_SubListAdd(SensSubList_t* list, unsigned char index, const char* id, const char* path){
+	// prefix size counts zero termination, it is used for '/'
+	int topicLen = sizeof(MQTT_TOPIC_PREFIX) + strlen(id) + strlen(path);
+	int topicSize = 2 + topicLen + ((list->unsub) ? 0 : 1);		// length, topic and requested qos
+	int remLen = list->remLen + topicSize;
+
+	// fixed header is 1 byte and remaining length 1 - 2 bytes
+	if ((list->count == MQTT_SUB_MAX_TOPICS) || (1 + ((remLen < 128) ? 1 : 2) + remLen > MQTT_SUB_PACKET_MAX))
+	{
+		Sensors_ID_SubListFlush(list);
+		remLen = list->remLen + topicSize;
+	}
+
+	if (list->len + topicLen + 1 > sizeof(list->buf))
+		return -1;
+
+	sprintf(&list->buf[list->len], MQTT_TOPIC_PREFIX "/%s" "%s", id, path);
+	list->len += topicLen + 1;
+	list->remLen = remLen;
+	list->count ++;
+
+	if (index < NUMBER_OF_SENSORS)
+		list->sensors |= 1 << index;
+
+	return 0;
+}
+
+/**
+ *  @brief  Schedules collected topics in one subscribe (or unsubscribe) message
+ *
+ *  If there is no free message slot, sensors with topics in list are marked
+ *  as failed, so they are subscribed again.
+ *
+ *  @param  topic list, it is empty afterwards
  *
  *  @return void
  */
-static void Sensors_ID_CreateSubPath(char* buf, char* path, unsigned char index){
-	sprintf(buf, MQTT_TOPIC_PREFIX "/%s" "%s" , Sensors_ID_GetSensorID(index), path);
+static void Sensors_ID_SubListFlush(SensSubList_t* list){
+	unsigned char handler, i;
+
+	if (list->count)
+	{
+		if (list->unsub)
+			handler = MQTT_Api_UnsubscrList(list->buf, list->len);
+		else
+			handler = MQTT_Api_SubscrList(list->buf, list->len, MQTT_MSG_OPT_QOS_SUB);
+
+		if (handler == MQTT_MSG_NO_SLOT)
+		{
+			for (i = 0; i < NUMBER_OF_SENSORS; i ++)
+			{
+				if (list->sensors & (1 << i))
+					MySensorList[i].subFailed = 1;
+			}
+		}
+	}
+
+	Sensors_ID_SubListInit(list, list->unsub);
 }
 
 /**
@@ -252,6 +475,7 @@ static void Sensors_ID_CreateSubPath(char* buf, char* path, unsigned char index)
  */
 static void Sensors_ID_Clear(unsigned char index){
 	memset((void *) &MySensorList[index], (int) 0, sizeof(SensId_t));
+	memset((void *) &MyTopicTable[index], (int) 0, sizeof(MyTopicTable[index]));
 }
 
 /**
@@ -276,11 +500,52 @@ static void Sensors_ID_ClrNeedUpdate(unsigned char index){
 	MySensorList[index].needUpdate = 0;
 }
 
+/**
+ *  @brief  Renders uplink topics into topic table
+ *
+ *  Creates topic "/v1/<id><subtopic>" for every sensor characteristic,
+ *  so publishers don't have to build topic for every message.
+ *
+ *  @param  topic table row
+ *  @param  sensor id string
+ *
+ *  @return void
+ */
+static void Sensors_ID_BuildTopics(unsigned char row, const char* id){
+	SensTopic_t* topic = MyTopicTable[row];
+	int idLen = strlen(id), subLen;
+	unsigned char field;
+	char* ptr;
+
+	for (field = 0; field < SENSOR_TOPIC_COUNT; field ++, topic ++)
+	{
+		topic->len = 0;
+		if (sensors_up_subtopics[field] == NULL)
+			continue;
+
+		// prefix size counts zero termination, it is used for '/'
+		subLen = strlen(sensors_up_subtopics[field]);
+		if ((sizeof(MQTT_TOPIC_PREFIX) + idLen + subLen) >= sizeof(topic->str))
+			continue;
+
+		ptr = topic->str;
+		memcpy((void *) ptr, (const void *) MQTT_TOPIC_PREFIX, sizeof(MQTT_TOPIC_PREFIX) - 1);
+		ptr += sizeof(MQTT_TOPIC_PREFIX) - 1;
+		*ptr ++ = '/';
+		memcpy((void *) ptr, (const void *) id, idLen);
+		ptr += idLen;
+		memcpy((void *) ptr, (const void *) sensors_up_subtopics[field], subLen + 1);
+		ptr += subLen;
+
+		topic->len = ptr - topic->str;
+	}
+}
+
 /**
  *  @brief  Stores sensor id in sensors list.
  *
  *  Creates Sensor id string from 16 byte array, and stores it into sensor list
- *  under desired index (sensor type)
+ *  under desired index (sensor type). Renders sensor uplink topics.
  *
  *  @param  pointer to byte array (sensor id)
  *  @param  sensor index
@@ -289,6 +554,7 @@ static void Sensors_ID_ClrNeedUpdate(unsigned char index){
  */
 static void Sensors_ID_StoreSensor(char* id, unsigned char index){
 	Sensors_ID_FormSensIdStr((char *) &MySensorList[index].SensorIDstr, id);
+	Sensors_ID_BuildTopics(index, (const char *) MySensorList[index].SensorIDstr);
 	Sensors_ID_SetNeedUpdate(index);
 	Sensors_ID_SetActive(index);
 }
@@ -296,39 +562,55 @@ static void Sensors_ID_StoreSensor(char* id, unsigned char index){
 /**
  *  @brief  Subscribe main board with main board id
  *
+ *  Also renders main board uplink topics, main board id is known at this point.
+ *
+ *  @param  topic list
+ *
  *  @return void
  */
-static void Sensors_ID_SubscribeMainBoard(){
-	char temp_buf[75];
+static void Sensors_ID_SubscribeMainBoard(SensSubList_t* list){
+	Sensors_ID_BuildTopics(NUMBER_OF_SENSORS, (const char *) wunderbar_configuration.wunderbar.id);
 
-	sprintf(temp_buf, MQTT_TOPIC_PREFIX "/%s" MQTT_SENS_SUBTOPICS_CMD_PING, (char *) wunderbar_configuration.wunderbar.id);
-	MQTT_Api_Subscr(temp_buf, MQTT_MSG_OPT_QOS_SUB);
+	Sensors_ID_SubListAdd(list, NUMBER_OF_SENSORS, (const char *) wunderbar_configuration.wunderbar.id, MQTT_SENS_SUBTOPICS_CMD_PING);
 }
 
 /**
  *  @brief  Schedule topics for subscription
  *
  *  For desired sensor (found in list by index) create subscription topics
- *  and schedule them for sending to mqt server.
+ *  and add them to topic list, which is scheduled for sending to mqtt server.
+ *  Sets need update flag, it is cleared when all topics are granted.
  *
+ *  @param  topic list
  *  @param  Sensor index in sensor list
  *
  *  @return void
  */
-static void Sensors_ID_ScheduleForSub(unsigned char index){
-	char temp_buf[75];
-
-	Sensors_ID_CreateSubPath(temp_buf, MQTT_SENS_SUBTOPICS_CONFIG,   index);
-	MQTT_Api_Subscr(temp_buf, MQTT_MSG_OPT_QOS_SUB);
-	Sensors_ID_CreateSubPath(temp_buf, MQTT_SENS_SUBTOPICS_CMD_LED,  index);
-	MQTT_Api_Subscr(temp_buf, MQTT_MSG_OPT_QOS_SUB);
-	Sensors_ID_CreateSubPath(temp_buf, MQTT_SENS_SUBTOPICS_CMD_PING, index);
-	MQTT_Api_Subscr(temp_buf, MQTT_MSG_OPT_QOS_SUB);
+static void Sensors_ID_ScheduleForSub(SensSubList_t* list, unsigned char index){
+	static const char* const paths[] = {
+		MQTT_SENS_SUBTOPICS_CONFIG,
+		MQTT_SENS_SUBTOPICS_CMD_LED,
+		MQTT_SENS_SUBTOPICS_CMD_PING,
+		MQTT_SENS_SUBTOPICS_CMD_DATA			// ir and bridge only
+	};
+	SensId_t* sens = &MySensorList[index];
+	const char* id = Sensors_ID_GetSensorID(index);
+	unsigned char i, count = 3;
 
 	if ((index == DATA_ID_DEV_IR) || (index == DATA_ID_DEV_BRIDGE))
+		count = 4;
+
+	Sensors_ID_SetNeedUpdate(index);
+	sens->subPending = 0;
+	sens->subFailed  = 0;
+	sens->subTime    = MSTimerGet();
+
+	for (i = 0; i < count; i ++)
 	{
-		Sensors_ID_CreateSubPath(temp_buf, MQTT_SENS_SUBTOPICS_CMD_DATA, index);
-		MQTT_Api_Subscr(temp_buf, MQTT_MSG_OPT_QOS_SUB);
+		if (Sensors_ID_SubListAdd(list, index, id, paths[i]) == 0)
+			sens->subPending ++;
+		else
+			sens->subFailed = 1;
 	}
 }
 
@@ -336,26 +618,22 @@ static void Sensors_ID_ScheduleForSub(unsigned char index){
  *  @brief  Schedule topics for unsubscription
  *
  *  For desired sensor (found in list by index) create unsubscription topics
- *  and schedule them for sending to mqt server.
+ *  and add them to topic list, which is scheduled for sending to mqtt server.
  *
+ *  @param  topic list
  *  @param  Sensor index in sensor list
  *
  *  @return void
  */
-static void Sensors_ID_ScheduleForUnsub(unsigned char index){
-	char temp_buf[75];
-
-	Sensors_ID_CreateSubPath(temp_buf, MQTT_SENS_SUBTOPICS_CONFIG,   index);
-	MQTT_Api_Unsubscr(temp_buf);
-	Sensors_ID_CreateSubPath(temp_buf, MQTT_SENS_SUBTOPICS_CMD_LED,  index);
-	MQTT_Api_Unsubscr(temp_buf);
-	Sensors_ID_CreateSubPath(temp_buf, MQTT_SENS_SUBTOPICS_CMD_PING, index);
-	MQTT_Api_Unsubscr(temp_buf);
+static void Sensors_ID_ScheduleForUnsub(SensSubList_t* list, unsigned char index){
+	const char* id = Sensors_ID_GetSensorID(index);
+
+	Sensors_ID_SubListAdd(list, index, id, MQTT_SENS_SUBTOPICS_CONFIG);
+	Sensors_ID_SubListAdd(list, index, id, MQTT_SENS_SUBTOPICS_CMD_LED);
+	Sensors_ID_SubListAdd(list, index, id, MQTT_SENS_SUBTOPICS_CMD_PING);
+
 	if ((index == DATA_ID_DEV_IR) || (index == DATA_ID_DEV_BRIDGE))
-	{
-		Sensors_ID_CreateSubPath(temp_buf, MQTT_SENS_SUBTOPICS_CMD_DATA, index);
-		MQTT_Api_Unsubscr(temp_buf);
-	}
+		Sensors_ID_SubListAdd(list, index, id, MQTT_SENS_SUBTOPICS_CMD_DATA);
 }
 
 /**
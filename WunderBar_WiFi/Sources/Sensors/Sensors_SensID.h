@@ -13,14 +13,30 @@
 
 #define SENSOR_ID_LEN  				16
 
+#define SENSOR_TOPIC_FIELDS			(FIELD_ID_CHAR_FIRMWARE_REVISION + 1)	// cached characteristics (field ids)
+#define SENSOR_TOPIC_DATA_BIN		SENSOR_TOPIC_FIELDS						// binary sensor data (not a field id)
+#define SENSOR_TOPIC_COUNT			(SENSOR_TOPIC_DATA_BIN + 1)
+#define SENSOR_TOPIC_STR_SIZE		67		// "/v1/" + wunderbar id (max 39) + longest subtopic + zero termination
+
 typedef char SensorIDstr_t[38];
 
+#define SENS_ID_SUB_RETRY_PERIOD	10000	// ms before topics of sensor with need update flag are subscribed again
+
 typedef struct {
 	SensorIDstr_t   SensorIDstr;
 	char	 		needUpdate;
 	char			active;
+	unsigned char	subPending;							// topics waiting for suback
+	char			subFailed;							// topic rejected or not scheduled
+	unsigned long long int subTime;					// time topics were scheduled
 } SensId_t;
 
+// pre-rendered uplink topic of one sensor characteristic
+typedef struct {
+	unsigned char	len;								// topic length, 0 if there is no topic
+	char			str[SENSOR_TOPIC_STR_SIZE];
+} SensTopic_t;
+
 
 static const char hex_array[16] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
 static const SensorIDstr_t sensor_id_template = "ffffffff-ffff-ffff-ffff-ffffffffffff";
@@ -68,16 +84,29 @@ void Sensors_ID_FormSensIdStr(char* sensIdStr, char* sensIdArr);
  */
 void Sensors_ID_Process(char* id, char sensIndex, char connStatus);
 
+/**
+ *  @brief  Subscribes again sensors with need update flag set
+ *
+ *  Topics of sensor are scheduled again SENS_ID_SUB_RETRY_PERIOD after
+ *  previous attempt, if any of them was rejected, not scheduled or not acknowledged.
+ *  Should be called periodically.
+ *
+ *  @return void
+ */
+void Sensors_ID_RetrySubList();
+
 /**
  *  @brief  Process successful subscription or unsubscription
  *
- *  When subscription or unsubscription is acknowledged clear need update flag
+ *  Called for every topic of acknowledged message. Need update flag of sensor
+ *  is cleared when all its topics are granted, rejected topic keeps it set.
  *
  *  @param  subscribe topic
+ *  @param  suback return code of the topic (MQTT_SUBACK_FAILURE if rejected)
  *
  *  @return void
  */
-void Sensors_ID_ProcessSuccessfulSubscription(char* topic);
+void Sensors_ID_ProcessSuccessfulSubscription(char* topic, unsigned char code);
 
 /**
  *  @brief  Gets active status of sensor
@@ -108,4 +137,30 @@ data_id_t Sensors_ID_FindSensorID(char* topic);
  */
 char* Sensors_ID_GetSensorID(unsigned char index);
 
+/**
+ *  @brief  Gets uplink topic for desired sensor characteristic
+ *
+ *  Returns pointer to topic pre-rendered in topic table when sensor was connected
+ *  (main board topics are rendered on mqtt connect). Topic is zero terminated.
+ *
+ *  @param  sensor index (DATA_ID_DEV_CENTRAL for main board)
+ *  @param  sensor field id
+ *  @param  return topic length
+ *
+ *  @return Pointer to topic string, NULL if there is no topic for sensor characteristic
+ */
+const char* Sensors_ID_GetTopic(unsigned char index, unsigned char field_id, int* len);
+
+/**
+ *  @brief  Gets uplink topic for binary sensor data
+ *
+ *  Binary data is published on its own subtopic, so content type is known from the topic.
+ *
+ *  @param  sensor index
+ *  @param  return topic length
+ *
+ *  @return Pointer to topic string, NULL if sensor is not connected
+ */
+const char* Sensors_ID_GetBinTopic(unsigned char index, int* len);
+
 #endif // SENSORS_SENSID_H_
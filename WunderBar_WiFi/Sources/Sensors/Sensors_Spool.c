@@ -0,0 +1,690 @@
+/** @file   Sensors_Spool.c
+ *  @brief  File contains functions for spooling sensor readings into flash
+ *  		while there is no connection with mqtt server, and replaying
+ *  		them after connection is established again.
+ *
+ *  		Readings are kept in log structured ring in reserved flash region
+ *  		(FLASH_SPOOL_ADDR). Every sector starts with header holding sector
+ *  		sequence number, followed by phrase aligned records. When ring is full,
+ *  		oldest sector is erased. Replay progress is saved with commit records,
+ *  		so readings published before reset are not replayed again
+ *  		(readings published after last commit can be published twice).
+ *
+ *  		Spool region must be in other flash block than code, so flash can
+ *  		be programmed while code is running.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include <hardware/Hw_modules.h>
+#include "Common_Defaults.h"
+#include "../FTFE/flash_FTFE.h"
+#include "../MQTT/MQTT_API_Client/MQTT_Api.h"
+#include "Sensors_Spool.h"
+
+
+// flash access, can be replaced with simulated flash
+
+#ifndef SPOOL_FLASH_ERASE
+#define SPOOL_FLASH_ERASE(addr)					Flash_SectorErase(addr)
+#define SPOOL_FLASH_PROGRAM(addr, src, len)		Flash_ByteProgram((addr), (src), (len))
+#define SPOOL_FLASH_PTR(addr)					((const uint8_t *) (addr))
+#endif
+
+#define SPOOL_PHRASE			8
+#define SPOOL_SECTORS			(FLASH_SPOOL_SIZE / FLASH_SECTOR_SIZE)
+#define SPOOL_END				(FLASH_SPOOL_ADDR + FLASH_SPOOL_SIZE)
+#define SPOOL_SECTOR_MAGIC		0x314C5053		// "SPL1"
+
+#define SPOOL_REC_DATA			0x4144			// reading
+#define SPOOL_REC_COMMIT		0x4D43			// readings up to seq are replayed
+#define SPOOL_REC_ERASED		0xFFFF
+
+#define SPOOL_ALIGN(x)			(((x) + SPOOL_PHRASE - 1) & ~(SPOOL_PHRASE - 1))
+#define SPOOL_SECTOR_OF(addr)	((((addr) >= SPOOL_END) ? FLASH_SPOOL_ADDR : (addr)) & ~(FLASH_SECTOR_SIZE - 1))
+
+// sector header, first phrase of every sector
+
+typedef struct {
+	uint32_t magic;
+	uint32_t seq;							// increases by one for every started sector
+} Spool_SectorHdr_t;
+
+// record header, one phrase
+
+typedef struct {
+	uint16_t type;							// SPOOL_REC_DATA or SPOOL_REC_COMMIT
+	uint16_t size;							// record size with header, multiple of phrase
+	uint32_t seq;							// reading number (last replayed reading in commit record)
+} Spool_RecHdr_t;
+
+// reading, follows record header, topic and payload follow it
+
+typedef struct {
+	unsigned long long int time;			// RTC time when reading was spooled
+	uint16_t payloadlen;
+	uint8_t  topiclen;
+	uint8_t  reserved;
+} Spool_DataHdr_t;
+
+static struct Sensors_Spool_t {
+	uint32_t Sector;						// sector being written
+	uint32_t SectorSeq;
+	uint32_t WriteAddr;						// next free phrase in flash
+	uint32_t ReadAddr;						// next record for replay
+	uint32_t NextSeq;						// number of next reading
+	uint32_t ReplaySeq;						// last replayed (or dropped) reading
+	uint32_t CommitSeq;						// last replayed reading saved in flash
+	uint64_t Batch[SPOOL_BATCH_SIZE / sizeof(uint64_t)];	// records waiting to be programmed
+	uint16_t BatchLen;
+	unsigned long long int BatchTime;		// time when first record was added to batch
+	unsigned long long int ReplayTime;
+	bool     Replay;						// replay is in progress
+	bool     Ready;							// flash region is scanned
+	Sensors_Spool_Stats_t Stats;
+} Spool;
+
+static uint64_t Spool_FlashBuf[SPOOL_BATCH_SIZE / sizeof(uint64_t)];		// batch being programmed
+
+
+static bool Spool_AddRecord(uint16_t type, uint32_t seq, const char* topic, int topiclen, const char* payload, int payloadlen);
+static void Spool_Flush();
+static void Spool_Replay();
+static bool Spool_StartSector(uint32_t sector);
+static bool Spool_NextSector();
+static const Spool_RecHdr_t* Spool_Record(uint32_t* addr);
+static bool Spool_RecordValid(uint32_t addr, uint32_t sector);
+static uint32_t Spool_ScanSector(uint32_t sector, uint32_t* dataSeq, uint32_t* commitSeq);
+static bool Spool_IsErased(uint32_t addr, uint32_t end);
+static uint32_t Spool_NextSectorAddr(uint32_t sector);
+
+
+
+
+	///////////////////////////////////////
+	/*         public functions          */
+	///////////////////////////////////////
+
+
+
+/**
+ *  @brief  Init spool
+ *
+ *  Scans spool flash region and restores write position, replay position
+ *  and readings which are not replayed yet (survive reset).
+ *
+ *  @return void
+ */
+void Sensors_Spool_Init(){
+	const Spool_SectorHdr_t* hdr;
+	const Spool_RecHdr_t* rec;
+	uint32_t sector, newest = 0, addr = 0, dataSeq = 0, commitSeq = 0;
+	bool found = false;
+	unsigned short i;
+
+	memset((void *) &Spool, 0, sizeof(Spool));
+	Spool.Stats.capacity = FLASH_SPOOL_SIZE - SPOOL_SECTORS * sizeof(Spool_SectorHdr_t);
+
+	// find sector written last
+	for (i = 0; i < SPOOL_SECTORS; i ++)
+	{
+		sector = FLASH_SPOOL_ADDR + i * FLASH_SECTOR_SIZE;
+		hdr = (const Spool_SectorHdr_t *) SPOOL_FLASH_PTR(sector);
+
+		if ((hdr->magic == SPOOL_SECTOR_MAGIC) && ((found == false) || ((int32_t) (hdr->seq - Spool.SectorSeq) > 0)))
+		{
+			newest = sector;
+			Spool.SectorSeq = hdr->seq;
+			found = true;
+		}
+	}
+
+	// empty region
+	if (found == false)
+	{
+		Spool.NextSeq = 1;
+		if (Spool_StartSector(FLASH_SPOOL_ADDR))
+		{
+			Spool.ReadAddr = Spool.WriteAddr;
+			Spool.Ready = true;
+		}
+		return;
+	}
+
+	// scan sectors from oldest to newest (sectors are written in ring order)
+	sector = newest;
+	for (i = 0; i < SPOOL_SECTORS; i ++)
+	{
+		sector = Spool_NextSectorAddr(sector);
+		hdr = (const Spool_SectorHdr_t *) SPOOL_FLASH_PTR(sector);
+		if (hdr->magic != SPOOL_SECTOR_MAGIC)
+			continue;
+
+		if (Spool.ReadAddr == 0)
+			Spool.ReadAddr = sector + sizeof(Spool_SectorHdr_t);
+
+		addr = Spool_ScanSector(sector, &dataSeq, &commitSeq);
+	}
+
+	Spool.Sector    = newest;
+	Spool.WriteAddr = addr;
+	Spool.NextSeq   = dataSeq + 1;
+	Spool.ReplaySeq = commitSeq;
+	Spool.CommitSeq = commitSeq;
+	Spool.Ready     = true;
+
+	// count readings which are not replayed yet
+	addr = Spool.ReadAddr;
+	while ((rec = Spool_Record(&addr)) != NULL)
+	{
+		if ((rec->type == SPOOL_REC_DATA) && (rec->seq > Spool.ReplaySeq))
+		{
+			Spool.Stats.pending ++;
+			Spool.Stats.used += rec->size;
+		}
+		addr += rec->size;
+	}
+
+	// rest of sector is not erased (programming was interrupted), continue in next sector
+	if (Spool_IsErased(Spool.WriteAddr, Spool.Sector + FLASH_SECTOR_SIZE) == false)
+		Spool.Ready = Spool_NextSector();
+
+	Spool.Replay = (Spool.Stats.pending > 0);
+}
+
+/**
+ *  @brief  Spool one reading
+ *
+ *  Reading is timestamped and added to ram batch, which is programmed
+ *  into flash later by Sensors_Spool_Task. Safe to call from interrupt.
+ *
+ *  @param  topic string
+ *  @param  topic length
+ *  @param  payload string
+ *  @param  payload length
+ *
+ *  @return True if reading is spooled
+ */
+bool Sensors_Spool_Store(const char* topic, int topiclen, const char* payload, int payloadlen){
+	bool result;
+
+	EnterCritical();
+	result = Spool_AddRecord(SPOOL_REC_DATA, Spool.NextSeq, topic, topiclen, payload, payloadlen);
+	if (result)
+	{
+		Spool.NextSeq ++;
+		Spool.Stats.stored ++;
+		Spool.Stats.pending ++;
+		Spool.Stats.dataBytes += topiclen + payloadlen;
+	}
+	else
+		Spool.Stats.dropped ++;
+	ExitCritical();
+
+	return result;
+}
+
+/**
+ *  @brief  Spool mqtt message
+ *
+ *  Used for publish messages which are still in mqtt buffer when buffer is discarded.
+ *
+ *  @param  Mqtt message struct
+ *
+ *  @return void
+ */
+void Sensors_Spool_StoreMsg(MQTT_User_Message_t* msg){
+	Sensors_Spool_Store(msg->topicStr, msg->topiclen, msg->payloadStr, msg->payloadlen);
+}
+
+/**
+ *  @brief  Start replay of spooled readings
+ *
+ *  Should be called when connection with mqtt server is established.
+ *
+ *  @return void
+ */
+void Sensors_Spool_StartReplay(){
+	if (Spool.Stats.pending)
+	{
+		Spool.Replay = true;
+		Spool.ReplayTime = MSTimerGet();
+	}
+}
+
+/**
+ *  @brief  Spool service
+ *
+ *  Should be called frequently. Programs batched readings into flash,
+ *  and while mqtt is running republishes spooled readings at limited pace.
+ *
+ *  @return void
+ */
+void Sensors_Spool_Task(){
+	bool online = MQTT_Get_RunnigStatus();
+
+	if (Spool.Ready == false)
+		return;
+
+	// readings spooled while mqtt buffer was full
+	if ((online) && (Spool.Replay == false) && (Spool.Stats.pending))
+		Sensors_Spool_StartReplay();
+
+	// program batch when it is half full, when it is old enough, or when it should be replayed
+	if ((Spool.BatchLen) && ((Spool.BatchLen >= SPOOL_BATCH_SIZE / 2) || ((online) && (Spool.Replay)) ||
+			(MSTimerDelta(Spool.BatchTime) >= SPOOL_BATCH_FLUSH_MS)))
+		Spool_Flush();
+
+	if ((online) && (Spool.Replay) && (MSTimerDelta(Spool.ReplayTime) >= SPOOL_REPLAY_INTERVAL_MS))
+	{
+		Spool.ReplayTime = MSTimerGet();
+		Spool_Replay();
+	}
+}
+
+/**
+ *  @brief  Gets spool usage
+ *
+ *  Write amplification is flashBytes / dataBytes, sector erases are counted separately.
+ *
+ *  @param  Return spool stats struct
+ *
+ *  @return void
+ */
+void Sensors_Spool_GetStats(Sensors_Spool_Stats_t* stats){
+	EnterCritical();
+	*stats = Spool.Stats;
+	ExitCritical();
+}
+
+
+
+
+	///////////////////////////////////////
+	/*         static functions          */
+	///////////////////////////////////////
+
+
+
+/**
+ *  @brief  Adds record into ram batch
+ *
+ *  Should be called with interrupts disabled.
+ *
+ *  @param  record type
+ *  @param  record sequence number
+ *  @param  topic string (data record)
+ *  @param  topic length
+ *  @param  payload string (data record)
+ *  @param  payload length
+ *
+ *  @return True if there was room for record
+ */
+static bool Spool_AddRecord(uint16_t type, uint32_t seq, const char* topic, int topiclen, const char* payload, int payloadlen){
+	Spool_RecHdr_t* rec;
+	Spool_DataHdr_t* data;
+	char* ptr;
+	uint32_t size = sizeof(Spool_RecHdr_t);
+
+	if (type == SPOOL_REC_DATA)
+	{
+		if ((topiclen <= 0) || (topiclen > 255) || (payloadlen < 0))
+			return false;
+		size = SPOOL_ALIGN(sizeof(Spool_RecHdr_t) + sizeof(Spool_DataHdr_t) + topiclen + payloadlen);
+	}
+
+	if ((Spool.Ready == false) || (Spool.BatchLen + size > SPOOL_BATCH_SIZE))
+		return false;
+
+	if (Spool.BatchLen == 0)
+		Spool.BatchTime = MSTimerGet();
+
+	rec = (Spool_RecHdr_t *) ((uint8_t *) Spool.Batch + Spool.BatchLen);
+	rec->type = type;
+	rec->size = (uint16_t) size;
+	rec->seq  = seq;
+
+	if (type == SPOOL_REC_DATA)
+	{
+		data = (Spool_DataHdr_t *) (rec + 1);
+		data->time       = RTC_GetTime();
+		data->payloadlen = (uint16_t) payloadlen;
+		data->topiclen   = (uint8_t) topiclen;
+		data->reserved   = 0xFF;
+
+		ptr = (char *) (data + 1);
+		memcpy((void *) ptr, (const void *) topic, topiclen);
+		ptr += topiclen;
+		memcpy((void *) ptr, (const void *) payload, payloadlen);
+		ptr += payloadlen;
+		memset((void *) ptr, 0xFF, (char *) rec + size - ptr);				// phrase padding
+
+		Spool.Stats.used += size;
+	}
+
+	Spool.BatchLen += size;
+
+	return true;
+}
+
+/**
+ *  @brief  Programs batched records into flash
+ *
+ *  Records which fit into current sector are programmed with one flash command sequence.
+ *  Records never cross sector boundary.
+ *
+ *  @return void
+ */
+static void Spool_Flush(){
+	uint8_t* buf = (uint8_t *) Spool_FlashBuf;
+	const Spool_RecHdr_t* rec;
+	uint32_t len, start, off = 0;
+	bool retried = false;
+
+	// take batch, new readings can be added while flash is programmed
+	EnterCritical();
+	len = Spool.BatchLen;
+	memcpy((void *) Spool_FlashBuf, (const void *) Spool.Batch, len);
+	Spool.BatchLen = 0;
+	ExitCritical();
+
+	while (off < len)
+	{
+		// records which fit into rest of the sector
+		for (start = off; off < len; off += rec->size)
+		{
+			rec = (const Spool_RecHdr_t *) (buf + off);
+			if (Spool.WriteAddr + (off - start) + rec->size > Spool.Sector + FLASH_SECTOR_SIZE)
+				break;
+		}
+
+		if (off == start)
+		{
+			if (Spool_NextSector() == false)
+				break;
+			continue;
+		}
+
+		if (SPOOL_FLASH_PROGRAM(Spool.WriteAddr, (uint32_t *) (buf + start), off - start) != Flash_OK)
+		{
+			Spool.Stats.errors ++;
+			off = start;
+			// skip damaged sector, try once more in new sector
+			if ((retried == false) && Spool_NextSector())
+			{
+				retried = true;
+				continue;
+			}
+			break;
+		}
+
+		Spool.WriteAddr += off - start;
+		Spool.Stats.flashBytes += off - start;
+	}
+
+	// records which were not programmed are lost
+	for (; off < len; off += rec->size)
+	{
+		rec = (const Spool_RecHdr_t *) (buf + off);
+		if (rec->type == SPOOL_REC_DATA)
+		{
+			EnterCritical();
+			Spool.Stats.dropped ++;
+			Spool.Stats.pending --;
+			Spool.Stats.used -= rec->size;
+			ExitCritical();
+		}
+	}
+}
+
+/**
+ *  @brief  Republishes spooled readings
+ *
+ *  Publishes up to SPOOL_REPLAY_BURST readings. Replay progress is saved
+ *  in flash every SPOOL_COMMIT_EVERY readings and when replay is done.
+ *
+ *  @return void
+ */
+static void Spool_Replay(){
+	const Spool_RecHdr_t* rec;
+	const Spool_DataHdr_t* data;
+	MQTT_User_Message_t msg;
+	unsigned char cnt = 0;
+
+	while (cnt < SPOOL_REPLAY_BURST)
+	{
+		if ((rec = Spool_Record(&Spool.ReadAddr)) == NULL)
+		{
+			Spool.Replay = false;			// everything is replayed
+			break;
+		}
+
+		if ((rec->type == SPOOL_REC_DATA) && (rec->seq > Spool.ReplaySeq))
+		{
+			data = (const Spool_DataHdr_t *) (rec + 1);
+
+			msg.topicStr   = (char *) (data + 1);
+			msg.topiclen   = data->topiclen;
+			msg.payloadStr = msg.topicStr + data->topiclen;
+			msg.payloadlen = data->payloadlen;
+
+			if ((unsigned char) MQTT_Api_Publish(&msg) == MQTT_MSG_NO_SLOT)
+				break;						// mqtt buffer is full, try later
+
+			EnterCritical();
+			Spool.ReplaySeq = rec->seq;
+			Spool.Stats.replayed ++;
+			Spool.Stats.pending --;
+			Spool.Stats.used -= rec->size;
+			ExitCritical();
+
+			cnt ++;
+		}
+
+		Spool.ReadAddr += rec->size;
+	}
+
+	if ((Spool.ReplaySeq - Spool.CommitSeq >= SPOOL_COMMIT_EVERY) ||
+			((Spool.Replay == false) && (Spool.ReplaySeq != Spool.CommitSeq)))
+	{
+		EnterCritical();
+		if (Spool_AddRecord(SPOOL_REC_COMMIT, Spool.ReplaySeq, NULL, 0, NULL, 0))
+			Spool.CommitSeq = Spool.ReplaySeq;
+		ExitCritical();
+	}
+}
+
+/**
+ *  @brief  Erases sector and writes its header
+ *
+ *  @param  sector address
+ *
+ *  @return True if successful
+ */
+static bool Spool_StartSector(uint32_t sector){
+	Spool_SectorHdr_t hdr;
+
+	Spool.Stats.erases ++;
+	if (SPOOL_FLASH_ERASE(sector) != Flash_OK)
+	{
+		Spool.Stats.errors ++;
+		return false;
+	}
+
+	hdr.magic = SPOOL_SECTOR_MAGIC;
+	hdr.seq   = ++ Spool.SectorSeq;
+
+	if (SPOOL_FLASH_PROGRAM(sector, (uint32_t *) &hdr, sizeof(hdr)) != Flash_OK)
+	{
+		Spool.Stats.errors ++;
+		return false;
+	}
+	Spool.Stats.flashBytes += sizeof(hdr);
+
+	Spool.Sector    = sector;
+	Spool.WriteAddr = sector + sizeof(hdr);
+
+	return true;
+}
+
+/**
+ *  @brief  Continues writing in next sector of the ring
+ *
+ *  If next sector holds readings which are not replayed yet, they are dropped.
+ *
+ *  @return True if successful
+ */
+static bool Spool_NextSector(){
+	const Spool_RecHdr_t* rec;
+	uint32_t next = Spool_NextSectorAddr(Spool.Sector), addr;
+	bool caughtUp = (Spool.ReadAddr == Spool.WriteAddr);
+
+	// oldest sector is overwritten
+	if ((caughtUp == false) && (SPOOL_SECTOR_OF(Spool.ReadAddr) == next))
+	{
+		addr = Spool.ReadAddr;
+		while (((rec = Spool_Record(&addr)) != NULL) && (SPOOL_SECTOR_OF(addr) == next))
+		{
+			if ((rec->type == SPOOL_REC_DATA) && (rec->seq > Spool.ReplaySeq))
+			{
+				EnterCritical();
+				Spool.ReplaySeq = rec->seq;
+				Spool.Stats.dropped ++;
+				Spool.Stats.pending --;
+				Spool.Stats.used -= rec->size;
+				ExitCritical();
+			}
+			addr += rec->size;
+		}
+		Spool.ReadAddr = Spool_NextSectorAddr(next);
+	}
+
+	if (Spool_StartSector(next) == false)
+		return false;
+
+	if (caughtUp)
+		Spool.ReadAddr = Spool.WriteAddr;
+
+	return true;
+}
+
+/**
+ *  @brief  Finds record at or after desired flash address
+ *
+ *  Skips sector headers and ends of sectors. Stops at write address.
+ *
+ *  @param  flash address, moved to found record
+ *
+ *  @return Pointer to record, NULL if there are no more records
+ */
+static const Spool_RecHdr_t* Spool_Record(uint32_t* addr){
+	uint32_t sector;
+	unsigned short hops;
+
+	for (hops = 0; hops <= SPOOL_SECTORS; hops ++)
+	{
+		if (*addr >= SPOOL_END)
+			*addr = FLASH_SPOOL_ADDR;
+
+		sector = SPOOL_SECTOR_OF(*addr);
+		if (*addr == sector)
+			*addr += sizeof(Spool_SectorHdr_t);
+
+		if (*addr == Spool.WriteAddr)
+			return NULL;
+
+		if (Spool_RecordValid(*addr, sector))
+			return (const Spool_RecHdr_t *) SPOOL_FLASH_PTR(*addr);
+
+		*addr = Spool_NextSectorAddr(sector);
+	}
+
+	return NULL;
+}
+
+/**
+ *  @brief  Checks if there is valid record at desired flash address
+ *
+ *  @param  flash address
+ *  @param  sector of the address
+ *
+ *  @return True if record is valid
+ */
+static bool Spool_RecordValid(uint32_t addr, uint32_t sector){
+	const Spool_RecHdr_t* rec = (const Spool_RecHdr_t *) SPOOL_FLASH_PTR(addr);
+
+	if (addr + sizeof(Spool_RecHdr_t) > sector + FLASH_SECTOR_SIZE)
+		return false;
+
+	if ((rec->type != SPOOL_REC_DATA) && (rec->type != SPOOL_REC_COMMIT))
+		return false;
+
+	if ((rec->size < sizeof(Spool_RecHdr_t)) || (rec->size & (SPOOL_PHRASE - 1)) ||
+			(addr + rec->size > sector + FLASH_SECTOR_SIZE))
+		return false;
+
+	return true;
+}
+
+/**
+ *  @brief  Scans records in sector
+ *
+ *  @param  sector address
+ *  @param  return highest reading number
+ *  @param  return highest replayed reading number
+ *
+ *  @return Address after last record in sector
+ */
+static uint32_t Spool_ScanSector(uint32_t sector, uint32_t* dataSeq, uint32_t* commitSeq){
+	const Spool_RecHdr_t* rec;
+	uint32_t addr = sector + sizeof(Spool_SectorHdr_t);
+
+	while (Spool_RecordValid(addr, sector))
+	{
+		rec = (const Spool_RecHdr_t *) SPOOL_FLASH_PTR(addr);
+
+		if ((rec->type == SPOOL_REC_DATA) && (rec->seq > *dataSeq))
+			*dataSeq = rec->seq;
+		else if ((rec->type == SPOOL_REC_COMMIT) && (rec->seq > *commitSeq))
+			*commitSeq = rec->seq;
+
+		addr += rec->size;
+	}
+
+	return addr;
+}
+
+/**
+ *  @brief  Checks if flash is erased
+ *
+ *  @param  start address (word aligned)
+ *  @param  end address
+ *
+ *  @return True if all bytes are erased
+ */
+static bool Spool_IsErased(uint32_t addr, uint32_t end){
+	for (; addr < end; addr += sizeof(uint32_t))
+	{
+		if (*(const uint32_t *) SPOOL_FLASH_PTR(addr) != 0xFFFFFFFF)
+			return false;
+	}
+	return true;
+}
+
+/**
+ *  @brief  Gets next sector in the ring
+ *
+ *  @param  sector address
+ *
+ *  @return Next sector address
+ */
+static uint32_t Spool_NextSectorAddr(uint32_t sector){
+	sector += FLASH_SECTOR_SIZE;
+	if (sector >= SPOOL_END)
+		sector = FLASH_SPOOL_ADDR;
+	return sector;
+}
@@ -0,0 +1,105 @@
+/** @file   Sensors_Spool.h
+ *  @brief  File contains functions for spooling sensor readings into flash
+ *  		while there is no connection with mqtt server, and replaying
+ *  		them after connection is established again.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#ifndef SENSORS_SPOOL_H_
+#define SENSORS_SPOOL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../MQTT/MQTT_API_Client/MQTT_MsgService.h"
+
+
+#define SPOOL_BATCH_SIZE		2048		// ram batch of readings programmed into flash at once (multiple of 8)
+
+// spool usage
+
+typedef struct {
+	uint32_t capacity;						// flash bytes for readings (without sector headers)
+	uint32_t used;							// flash bytes held by readings not replayed yet
+	uint32_t pending;						// readings not replayed yet
+	uint32_t stored;						// readings spooled
+	uint32_t replayed;						// readings published after reconnect
+	uint32_t dropped;						// readings lost (batch full, oldest sector overwritten, flash error)
+	uint32_t dataBytes;						// bytes of spooled topics and payloads
+	uint32_t flashBytes;					// bytes programmed into flash (headers, padding and replay marks included)
+	uint32_t erases;						// erased sectors
+	uint32_t errors;						// flash command errors
+} Sensors_Spool_Stats_t;
+
+
+// public functions
+
+/**
+ *  @brief  Init spool
+ *
+ *  Scans spool flash region and restores write position, replay position
+ *  and readings which are not replayed yet (survive reset).
+ *
+ *  @return void
+ */
+void Sensors_Spool_Init();
+
+/**
+ *  @brief  Spool one reading
+ *
+ *  Reading is timestamped and added to ram batch, which is programmed
+ *  into flash later by Sensors_Spool_Task. Safe to call from interrupt.
+ *
+ *  @param  topic string
+ *  @param  topic length
+ *  @param  payload string
+ *  @param  payload length
+ *
+ *  @return True if reading is spooled
+ */
+bool Sensors_Spool_Store(const char* topic, int topiclen, const char* payload, int payloadlen);
+
+/**
+ *  @brief  Spool mqtt message
+ *
+ *  Used for publish messages which are still in mqtt buffer when buffer is discarded.
+ *
+ *  @param  Mqtt message struct
+ *
+ *  @return void
+ */
+void Sensors_Spool_StoreMsg(MQTT_User_Message_t* msg);
+
+/**
+ *  @brief  Start replay of spooled readings
+ *
+ *  Should be called when connection with mqtt server is established.
+ *
+ *  @return void
+ */
+void Sensors_Spool_StartReplay();
+
+/**
+ *  @brief  Spool service
+ *
+ *  Should be called frequently. Programs batched readings into flash,
+ *  and while mqtt is running republishes spooled readings at limited pace.
+ *
+ *  @return void
+ */
+void Sensors_Spool_Task();
+
+/**
+ *  @brief  Gets spool usage
+ *
+ *  Write amplification is flashBytes / dataBytes, sector erases are counted separately.
+ *
+ *  @param  Return spool stats struct
+ *
+ *  @return void
+ */
+void Sensors_Spool_GetStats(Sensors_Spool_Stats_t* stats);
+
+#endif // SENSORS_SPOOL_H_
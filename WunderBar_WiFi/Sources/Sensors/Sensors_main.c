@@ -18,6 +18,8 @@
 #include "Sensors_main.h"
 #include "Sensors_Cfg_Handler.h"
 #include "Sensors_SensID.h"
+#include "Sensors_Spool.h"
+#include "Sensors_Aggr.h"
 #include "My_Sensors/Sensors_common.h"
 #include "../MQTT/MQTT_API_Client/MQTT_Api.h"
 
@@ -27,14 +29,17 @@
 
 static spi_frame_t myLastSPIFrame;
 
+// encoding of sensor data published on cloud, json by default
+static Sensors_Encoding_t Sensors_Encoding[NUMBER_OF_SENSORS];
+
 // data handlers function pointer list for processing down data from cloud
 static Sensors_DataHandlerMQTT Sensors_DataHandlersMQTT[8] =   {
-													Sensors_htu_ProcessData,
-													Sensors_gyro_ProcessData,
-													Sensors_light_ProcessData,
-													Sensors_sound_ProcessData,
-													Sensors_bridge_ProcessData,
-													Sensors_ir_ProcessData,
+													Sensors_Schema_ProcessData,
+													Sensors_Schema_ProcessData,
+													Sensors_Schema_ProcessData,
+													Sensors_Schema_ProcessData,
+													Sensors_Schema_ProcessData,
+													Sensors_Schema_ProcessData,
 													0,
 													MainBoard_ProcessData
 												};
@@ -52,15 +57,15 @@ static Sensors_DataHandlerBT Sensors_DataHandlersBT[8] =   {
 												};
 
 static void Sensors_Update_Data(spi_frame_t* SPI_msg);
+static void Sensors_Publish_Data(MQTT_User_Message_t* MyMessage, data_id_t sensor, field_id_char_index_t field);
 static void Sensors_Update_Response(spi_frame_t* SPI_msg);
 static void Sensors_SetLastMsg(spi_frame_t* SPI_msg);
 static void Sensors_DiscardLastSpiFrame();
 static int  Sensors_AddMessageID(char** pptr);
-static int  Sensors_Add_SensorId(char** pptr, data_id_t data_id);
-static int  Sensors_AddSubtopic_SensChar(char** pptr, field_id_char_index_t field_id);
 static void Sensors_Save_CentralFwRev(char* fwRev);
 static field_id_char_index_t Sensors_ExtractSensChar(char* topic);
 static bool Sensors_ResponseHandlerBT(char resp, char* buf);
+static void Sensors_SetEncoding(data_id_t sensor, char* msg);
 
 
 
@@ -122,10 +127,27 @@ void Sensors_MsgParse(MQTT_User_Message_t* MyMessage){
 	if (!MQTT_Get_RunnigStatus())
 		return;
 
+	// fields not written by decoder are sent as zeros
+	memset((void *) &SPI_msg, 0, sizeof(SPI_msg));
+
 	// get sensor ID from sensor list
 	if ((SPI_msg.data_id = Sensors_ID_FindSensorID(MyMessage->topicStr)) == 255)
 		return;
 
+	// data encoding is selected on main board
+	if (strstr(MyMessage->topicStr, SENS_DOWN_ENCODING))
+	{
+		Sensors_SetEncoding(SPI_msg.data_id, MyMessage->payloadStr);
+		return;
+	}
+
+	// data aggregation is done on main board
+	if (strstr(MyMessage->topicStr, SENS_DOWN_AGGREGATE))
+	{
+		Sensors_Aggr_Config(SPI_msg.data_id, MyMessage->payloadStr);
+		return;
+	}
+
 	// get characteristic
 	if ((SPI_msg.field_id = Sensors_ExtractSensChar(MyMessage->topicStr)) == 255)
 		return;
@@ -166,6 +188,36 @@ void Sensors_ProcessTimeout(){
 	Sensors_DiscardLastSpiFrame();
 }
 
+/**
+*  @brief  Publish summaries of expired aggregation windows
+*
+*  Should be called periodically, so time window is closed and published
+*  when sensor stops sending data.
+*
+*  @return void
+*/
+void Sensors_ProcessAggregation(){
+	MQTT_User_Message_t MyMessage;
+	char payload[MQTT_MSG_PAYLOAD_MAX];
+	data_id_t sensor;
+
+	MyMessage.payloadStr = payload;
+
+	for (sensor = DATA_ID_DEV_HTU; sensor < NUMBER_OF_SENSORS; sensor ++)
+	{
+		// window is kept until summary can be published
+		if ((MyMessage.topicStr = (char *) Sensors_ID_GetTopic(sensor, FIELD_ID_CHAR_SENSOR_DATA_R, &MyMessage.topiclen)) == NULL)
+			continue;
+
+		if (!Sensors_Aggr_Expired(sensor, MyMessage.payloadStr))
+			continue;
+
+		MyMessage.payloadlen = strlen(MyMessage.payloadStr);
+
+		Sensors_Publish_Data(&MyMessage, sensor, FIELD_ID_CHAR_SENSOR_DATA_R);
+	}
+}
+
 /**
 *  @brief  Init Sensors stack
 *
@@ -176,6 +228,7 @@ void Sensors_ProcessTimeout(){
 */
 void Sensors_Init(){
 	Sensors_ID_ClearList();			// clear list of connected ble modules (on master ble reset)
+	Sensors_Spool_Init();			// restore readings spooled before reset
 	MQTT_Api_SetReceiveCallBack(Sensors_MsgParse); // set user call back for mqtt return messages
 }
 
@@ -226,7 +279,8 @@ void Sensor_Cfg_Start(){
 *  @brief  Updates data on mqtt server with new data from BT
 *
 *  Receives SPI frame from the master ble module, and prepares mqtt message for
-*  publishing on cloud. Creates topic string and payload string according to data.
+*  publishing on cloud. Topic is taken from sensor topic table, payload string
+*  is created according to data.
 *
 *  @param  SPI frame message from ble
 *
@@ -234,34 +288,83 @@ void Sensor_Cfg_Start(){
 */
 static void Sensors_Update_Data(spi_frame_t* SPI_msg){
 	MQTT_User_Message_t MyMessage;
-	char* ptr = MyMessage.topicStr;
+	char payload[MQTT_MSG_PAYLOAD_MAX];
+	Sensors_Aggr_Result_t aggr = SENS_AGGR_PASS;
+	const char* topic;
 
-	strcpy(ptr, MQTT_TOPIC_PREFIX);
-	ptr += strlen(MyMessage.topicStr);
+	MyMessage.payloadStr = payload;
 
-	if (Sensors_Add_SensorId(&ptr, SPI_msg->data_id) == 0)
+	if (SPI_msg->data_id > DATA_ID_DEV_IR)
 		return;			// invalid sensor name index
 
-	Sensors_DataHandlersBT[SPI_msg->data_id](SPI_msg, MyMessage.payloadStr);   		// handle data from sensor, and create payload string
+	// sensor data is added to aggregation window, summary is published when window is closed
+	if (SPI_msg->field_id == FIELD_ID_CHAR_SENSOR_DATA_R)
+		aggr = Sensors_Aggr_Add(SPI_msg, MyMessage.payloadStr);
 
-	if (Sensors_AddSubtopic_SensChar(&ptr, SPI_msg->field_id) == 0)
-		return;         // invalid sensor characteristic
+	if (aggr == SENS_AGGR_HOLD)
+		return;
 
-	if (Sensors_ID_GetActiveStatus(SPI_msg->data_id) != 1)
-		return;         // sensor not active
+	if (aggr == SENS_AGGR_READY)
+	{
+		if ((topic = Sensors_ID_GetTopic(SPI_msg->data_id, SPI_msg->field_id, &MyMessage.topiclen)) != NULL)
+			MyMessage.payloadlen = strlen(MyMessage.payloadStr);
+	}
+	// sensor data in binary form on its own topic
+	else if ((SPI_msg->field_id == FIELD_ID_CHAR_SENSOR_DATA_R) && (Sensors_Encoding[SPI_msg->data_id] == SENS_ENCODING_BIN))
+	{
+		if ((MyMessage.payloadlen = Sensors_Bin_Form(SPI_msg, MyMessage.payloadStr)) < 0)
+			return;
+
+		topic = Sensors_ID_GetBinTopic(SPI_msg->data_id, &MyMessage.topiclen);
+	}
+	else
+	{
+		Sensors_DataHandlersBT[SPI_msg->data_id](SPI_msg, MyMessage.payloadStr);   	// handle data from sensor, and create payload string
+
+		if ((topic = Sensors_ID_GetTopic(SPI_msg->data_id, SPI_msg->field_id, &MyMessage.topiclen)) != NULL)
+			MyMessage.payloadlen = strlen(MyMessage.payloadStr);					// get payload length
+	}
+
+	if (topic == NULL)
+		return;         // invalid sensor characteristic or sensor not connected
+
+	MyMessage.topicStr = (char *) topic;
+
+	Sensors_Publish_Data(&MyMessage, SPI_msg->data_id, SPI_msg->field_id);
+}
+
+/**
+*  @brief  Publish message with sensor data on mqtt server
+*
+*  Message from active sensor is scheduled for publishing. Telemetry is spooled
+*  into flash while mqtt is down or its buffer is full.
+*
+*  @param  Mqtt message with topic and payload
+*  @param  Sensor data id
+*  @param  Sensor characteristic
+*
+*  @return void
+*/
+static void Sensors_Publish_Data(MQTT_User_Message_t* MyMessage, data_id_t sensor, field_id_char_index_t field){
 
+	if (Sensors_ID_GetActiveStatus(sensor) != 1)
+		return;         // sensor not active
 
 	// clear message in progress flag for hardware and firmware revision query
-	if ((SPI_msg->field_id == FIELD_ID_CHAR_HARDWARE_REVISION) || (SPI_msg->field_id == FIELD_ID_CHAR_FIRMWARE_REVISION))
+	if ((field == FIELD_ID_CHAR_HARDWARE_REVISION) || (field == FIELD_ID_CHAR_FIRMWARE_REVISION))
 	{
 		MQTT_Msg_ClearMsgInProgress();
 		Sensors_DiscardLastSpiFrame();
 	}
 
-	MyMessage.payloadlen = strlen(MyMessage.payloadStr);							// get payload length
-
-	if (MQTT_Get_RunnigStatus())
-		MQTT_Api_Publish(&MyMessage);												// schedule for publishing
+	// telemetry is spooled into flash while mqtt is down or its buffer is full
+	if ((field == FIELD_ID_CHAR_SENSOR_DATA_R) || (field == FIELD_ID_CHAR_BATTERY_LEVEL))
+	{
+		if ((MQTT_Get_RunnigStatus() == 0) || ((unsigned char) MQTT_Api_Publish(MyMessage) == MQTT_MSG_NO_SLOT))
+			Sensors_Spool_Store(MyMessage->topicStr, MyMessage->topiclen, MyMessage->payloadStr, MyMessage->payloadlen);
+	}
+	else if (MQTT_Get_RunnigStatus())
+		MQTT_Api_Publish(MyMessage);												// schedule for publishing
 }
 
 /**
@@ -276,20 +379,26 @@ static void Sensors_Update_Data(spi_frame_t* SPI_msg){
 */
 static void Sensors_Update_Response(spi_frame_t* SPI_msg){
 	MQTT_User_Message_t MyMessage;
-	char* ptr = MyMessage.topicStr;
+	char topic[MQTT_MSG_TOPIC_MAX];
+	char payload[MQTT_MSG_PAYLOAD_MAX];
+	const char* sensTopic;
+	char* ptr = topic;
+	int len, result;
 
-	strcpy(ptr, MQTT_TOPIC_PREFIX);
-	ptr += strlen(MyMessage.topicStr);
+	MyMessage.topicStr = topic;
+	MyMessage.payloadStr = payload;
 
-	if (Sensors_Add_SensorId(&ptr, myLastSPIFrame.data_id) == 0)
-		return;			// invalid sensor name index
+	if ((sensTopic = Sensors_ID_GetTopic(myLastSPIFrame.data_id, myLastSPIFrame.field_id, &len)) == NULL)
+		return;			// invalid sensor name index or characteristic
 
-	if (Sensors_AddSubtopic_SensChar(&ptr, myLastSPIFrame.field_id) == 0)
-		return;         // invalid sensor characteristic
+	memcpy((void *) ptr, (const void *) sensTopic, len);
+	ptr += len;
 
-	if (Sensors_AddMessageID(&ptr) <= 1)
+	if ((result = Sensors_AddMessageID(&ptr)) <= 1)
 		return;
 
+	MyMessage.topiclen = len + result;
+
 	// add payload
 	Sensors_ResponseHandlerBT(SPI_msg->data_id, MyMessage.payloadStr);
 
@@ -316,21 +425,17 @@ static void Sensors_Update_Response(spi_frame_t* SPI_msg){
 */
 void MainBoard_Update_FwRev(spi_frame_t* SPI_msg){
 	MQTT_User_Message_t MyMessage;
-	char* ptr = MyMessage.topicStr;
-
-	strcpy(ptr, MQTT_TOPIC_PREFIX);
-	ptr += strlen(MyMessage.topicStr);
+	char payload[MQTT_MSG_PAYLOAD_MAX];
+	const char* topic;
 
-	strcpy(ptr, "/");
-	ptr++;
-
-	strcpy(ptr, (const char *) wunderbar_configuration.wunderbar.id);
-	ptr += strlen((const char *) wunderbar_configuration.wunderbar.id);
-
-	Sensors_AddSubtopic_SensChar(&ptr, SPI_msg->field_id);
+	MyMessage.payloadStr = payload;
 
 	MainBoard_Update(SPI_msg, MyMessage.payloadStr);
 
+	if ((topic = Sensors_ID_GetTopic(DATA_ID_DEV_CENTRAL, SPI_msg->field_id, &MyMessage.topiclen)) == NULL)
+		return;
+
+	MyMessage.topicStr = (char *) topic;
 	MyMessage.payloadlen = strlen(MyMessage.payloadStr);
 
 	if (MQTT_Get_RunnigStatus())
@@ -380,33 +485,6 @@ static int Sensors_AddMessageID(char** pptr){
 	return result;
 }
 
-/**
-*  @brief  Append sensor id into topic string
-*
-*  Appends sensor id and advances pointer to the end of new string.
-*  Also returns number of written bytes.
-*
-*  @param  source string
-*  @param  sensor data id
-*
-*  @return Number of written bytes
-*/
-static int Sensors_Add_SensorId(char** pptr, data_id_t data_id){
-	int result;
-
-	if (data_id > DATA_ID_DEV_IR)
-		return 0;
-
-	strcpy(*pptr, (const char *) "/");
-	*pptr += 1;
-
-	strcpy(*pptr, (const char *) Sensors_ID_GetSensorID(data_id));
-	result = strlen((const char *) Sensors_ID_GetSensorID(data_id));
-	*pptr += result;
-
-	return (result + 1);
-}
-
 /**
 *  @brief  Process firmware revision message from master ble
 *
@@ -464,63 +542,32 @@ static field_id_char_index_t Sensors_ExtractSensChar(char* topic){
 }
 
 /**
-*  @brief  Append sensor characteristic subtopic to input string
+*  @brief  Select encoding of sensor data
 *
-*  Appends sensor characteristic and advances pointer to the end of new string.
-*  Also returns number of written bytes.
+*  Message {"encoding":"binary"} selects binary sensor data (see Sensors_common.h),
+*  {"encoding":"json"} selects json. Setting is kept until reset.
 *
-*  @param  source string
-*  @param  sensor filed id
+*  @param  Sensor data id
+*  @param  Json message
 *
-*  @return Number of written bytes
+*  @return void
 */
-static int Sensors_AddSubtopic_SensChar(char** pptr, field_id_char_index_t field_id){
-	int result;
+static void Sensors_SetEncoding(data_id_t sensor, char* msg){
+	char value[8];
 
-	switch (field_id)
-	{
-	case FIELD_ID_CHAR_SENSOR_BEACON_FREQUENCY :
-		strcpy(*pptr, SENS_UP_CHAR_BEACONFREQ);
-		break;
-	case FIELD_ID_CHAR_SENSOR_FREQUENCY :
-		strcpy(*pptr, SENS_UP_CHAR_FREQUENCY);
-		break;
-	case FIELD_ID_CHAR_SENSOR_LED_STATE :
-		strcpy(*pptr, SENS_UP_LED_STATE);
-		break;
-	case FIELD_ID_CHAR_SENSOR_THRESHOLD :
-		strcpy(*pptr, SENS_UP_CHAR_THRESHOLD);
-		break;
-	case FIELD_ID_CHAR_SENSOR_CONFIG :
-		strcpy(*pptr, SENS_UP_CHAR_SENSCFG);
-		break;
-	case FIELD_ID_CHAR_SENSOR_DATA_R :
-		strcpy(*pptr, SENS_UP_DATA);
-		break;
-	case FIELD_ID_CHAR_SENSOR_DATA_W :
-		strcpy(*pptr, SENS_DOWN_DATA);
-		break;
-	case FIELD_ID_CHAR_BATTERY_LEVEL :
-		strcpy(*pptr, SENS_UP_CHAR_BATTERY_LEVEL);
-		break;
-	case FIELD_ID_CHAR_MANUFACTURER_NAME :
-		strcpy(*pptr, SENS_UP_MANUFACTURER_NAME);
-		break;
-	case FIELD_ID_CHAR_HARDWARE_REVISION :
-		strcpy(*pptr, SENS_UP_HARDWAREREV);
-		break;
-	case FIELD_ID_CHAR_FIRMWARE_REVISION :
-		strcpy(*pptr, SENS_UP_FIRMWAREREV);
-		break;
+	if (sensor >= NUMBER_OF_SENSORS)
+		return;
 
-	default :
-		return 0;
-	}
+	if (JSON_Msg_Parse(msg) <= 0)
+		return;
 
-	result = strlen((const char *) *pptr);
-	*pptr += result;
+	if (JSON_Msg_GetStr(JSON_Msg_FindKey(&Sensors_Keys[SENS_KEY_ENCODING], 0), value, sizeof(value)) < 0)
+		return;
 
-	return result;
+	if (strcmp(value, SENSORS_ENCODING_BIN) == 0)
+		Sensors_Encoding[sensor] = SENS_ENCODING_BIN;
+	else if (strcmp(value, SENSORS_ENCODING_JSON) == 0)
+		Sensors_Encoding[sensor] = SENS_ENCODING_JSON;
 }
 
 /**
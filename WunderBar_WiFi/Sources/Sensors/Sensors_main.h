@@ -30,6 +30,8 @@ typedef void (*Sensors_DataHandlerBT) (spi_frame_t* SPI_msg, char* buf);
 #define SENS_DOWN_FIRMWARE_REV      	"/cmd/ping/firmwarerev"
 #define SENS_DOWN_LED_STATE         	"/cmd/led"
 #define SENS_DOWN_DATA		          	"/cmd"
+#define SENS_DOWN_ENCODING          	"/config/encoding"		// handled on main board, not sent to sensor
+#define SENS_DOWN_AGGREGATE         	"/config/aggregate"		// handled on main board, not sent to sensor
 
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -48,6 +50,7 @@ typedef void (*Sensors_DataHandlerBT) (spi_frame_t* SPI_msg, char* buf);
 #define SENS_UP_MANUFACTURER_NAME		"/data/manufacturername"
 #define SENS_UP_LED_STATE				"/cmd/led"
 #define SENS_UP_DATA					"/data"
+#define SENS_UP_DATA_BIN				"/data/bin"				// binary sensor data, see Sensors_common.h
 #define SENS_UP_STATUS					"/data/status"
 
 
@@ -129,6 +132,16 @@ void Sensor_Cfg_Run();
 */
 void Sensors_ProcessTimeout();
 
+/**
+*  @brief  Publish summaries of expired aggregation windows
+*
+*  Should be called periodically, so time window is closed and published
+*  when sensor stops sending data.
+*
+*  @return void
+*/
+void Sensors_ProcessAggregation();
+
 
 //////////////////////////////////////////////////////////////////////////////////
 
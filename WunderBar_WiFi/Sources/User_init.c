@@ -28,11 +28,12 @@ wcfg_t wunderbar_configuration;
 // to signal that when is ok to use ext int for spi purposes
 static char ExtIntEn = 0;
 static volatile unsigned int dummyread;
-static unsigned int Sleep_CountDown = SLEEP_COUNTDOWN_MS;
+static volatile unsigned int Sleep_CountDown = SLEEP_COUNTDOWN_MS;
 
 static void Set_EI2_pin();
 static void Init_vlps();
 static void enter_vlps();
+static void enter_wait();
 static unsigned int ADC_Measure(char channel);
 static void my_VREF_Init(void);
 static void Load_Wunderbar_Configuration();
@@ -98,8 +99,10 @@ void Global_Peripheral_Init(){
 
 	PMC_LVDSC1 = PMC_LVDSC1_LVDV(1);	// Set Low Voltage Detect trip point
 
+	MSTimer_Init();						// start monotonic clock
 	Init_FPU();                     	// init FPU module
 	SPI_Init();							// init SPI module
+	GS_HAL_Init();						// hand GS UART over to DMA
 
 	Reset_Nordic();						// reset nRF module
 	Reset_Wifi();						// reset WiFi module
@@ -199,14 +202,38 @@ void Sleep_Restore_Countdown(){
 *  @return void
 */
 void Sleep_CheckConditions(){
+	unsigned long long int rtc_time;
+
 	if (Sleep_CountDown == 0)
 	{
 		GPIO_LedOff();
+		rtc_time = RTC_GetTime();
 		enter_vlps();
+		MSTimer_Advance(RTC_GetTime() - rtc_time);		// bus clock (and ms timer) is stopped in vlps
 		Sleep_Restore_Countdown();
 	}
 }
 
+/**
+*  @brief  Put core to sleep while there is nothing to do
+*
+*  Enters vlps mode if sleep conditions are met, otherwise wait mode
+*  (core stopped, peripherals and timers running).
+*  Called by scheduler with interrupts masked, returns when interrupt is pending.
+*
+*  @return void
+*/
+void Sleep_Idle(){
+#ifdef __SLEEP__
+	if (Sleep_CountDown == 0)
+	{
+		Sleep_CheckConditions();
+		return;
+	}
+#endif
+	enter_wait();
+}
+
 /**
 *  Count down sleep counter
 *
@@ -353,6 +380,8 @@ static void enter_vlps()
 /* enable wakwup on uart rx edge */
 UART0_S2 |= UART_S2_RXEDGIF_MASK;
 UART0_BDH |= UART_BDH_RXEDGIE_MASK;
+/* deep sleep, stop mode is set to VLPS by Init_vlps */
+SCB_SCR |= SCB_SCR_SLEEPDEEP_MASK;
 /* wait for write to complete to SMC before stopping core */
 dummyread = UART0_BDH;
 /* Now execute the stop instruction to go into VLPS */
@@ -360,6 +389,18 @@ if (!Sleep_CountDown) // check once more to make sure there's nothing to do...
 	asm("WFI");
 }
 
+/**
+*  @brief  Enter wait mode
+*
+*  Core clock is stopped until next interrupt, peripherals keep running.
+*
+*  @return void
+*/
+static void enter_wait(){
+	SCB_SCR &= ~SCB_SCR_SLEEPDEEP_MASK;
+	asm("WFI");
+}
+
 /***************************************************************/
 /* VLPS mode entry routine. Puts the processor into VLPS mode
 * directly from run or VLPR modes.
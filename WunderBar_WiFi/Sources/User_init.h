@@ -85,6 +85,17 @@ void Sleep_DecrementCountDown();
 */
 void Sleep_CheckConditions();
 
+/**
+*  @brief  Put core to sleep while there is nothing to do
+*
+*  Enters vlps mode if sleep conditions are met, otherwise wait mode
+*  (core stopped, peripherals and timers running).
+*  Called by scheduler with interrupts masked, returns when interrupt is pending.
+*
+*  @return void
+*/
+void Sleep_Idle();
+
 /**
 *  @brief  Resotre sleep countdown counter
 *
@@ -19,12 +19,16 @@
 
 // MSTImer functions
 
+void MSTimer_Init();
 unsigned long long int MSTimerGet ();
+unsigned long long int MSTimer_GetMicros();
 void MSTimerDelay(unsigned long long int delay);
 unsigned long long int MSTimerDelta(unsigned long long int timer);
 void MSTimer_SetTime(unsigned long long int time);
+void MSTimer_Advance(unsigned long long int delta);
 void MSTimer_GetSystemTimeStr(char* txt);
-void MSTimer_Increment_milliseconds();
+void MSTimer_CycleCounterEnable();
+uint32_t MSTimer_GetCycles();
 
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -35,7 +39,7 @@ void MSTimer_Increment_milliseconds();
 
 unsigned long long int RTC_GetTime();
 void RTC_SetTime(unsigned long long int milisecs);
-void RTC_GetSystemTimeStr(char* txt);
+int RTC_GetSystemTimeStr(char* txt);
 void RTC_SetAlarm(unsigned int timeOffset);
 
 
@@ -45,9 +49,23 @@ void RTC_SetAlarm(unsigned int timeOffset);
 
 // USRT functions
 
+#define GS_HAL_BAUD_DEFAULT	115200		// GS module rate after reset
+#define GS_HAL_BAUD_FAST	460800		// rate negotiated after module init
+
+void GS_HAL_Init();
 void GS_HAL_send(uint8_t* StrPtr, uint32_t Size);
 unsigned int GS_HAL_recv(uint8_t* recvbyte, uint32_t Size, uint32_t block);
 void GS_HAL_ClearBuff();
+void GS_HAL_SetBaudRate(uint32_t baudRate);
+uint32_t GS_HAL_GetBaudRate();
+void GS_HAL_GetRxStats(uint32_t* overruns, uint32_t* lost, uint32_t* fifoOverruns);
+void GS_HAL_Interrupt();
+void GS_HAL_TxDmaInterrupt();
+
+// USRT events (Events.c), called from interrupt
+
+void GS_HAL_OnRxIdle(void);
+void GS_HAL_OnTxDone(void);
 
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -105,6 +123,10 @@ void SPI_CS_Deactivate();
 #define FLASH_CONFIG_IMAGE_ADDR 			0x00010000
 #define FLASH_CERTIFICATE_IMAGE_ADDRESS  	0x00011000
 
+#define FLASH_SECTOR_SIZE					0x00001000
+#define FLASH_SPOOL_ADDR					0x000F0000		// sensor readings spooled while offline (last 64 KB, excluded from m_text)
+#define FLASH_SPOOL_SIZE					0x00010000
+
 
 //////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////
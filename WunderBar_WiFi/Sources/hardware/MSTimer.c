@@ -3,33 +3,109 @@
 
 
 
-// should be the same as period of used ISR
-#define MSTIMER_MILISECOND_COUNTER_INC    100
+// PIT channels 0 and 1 are chained into one 64 bit down counter running on bus clock
+#define MSTIMER_TICKS_PER_MS			(CPU_BUS_CLK_HZ / 1000)
+#define MSTIMER_TICKS_PER_US			(CPU_BUS_CLK_HZ / 1000000)
+
+// ARMv7-M debug registers for cycle counter
+#define MSTIMER_DEMCR					(*(volatile uint32_t *) 0xE000EDFCu)
+#define MSTIMER_DEMCR_TRCENA_MASK		0x01000000u
+#define MSTIMER_DWT_CTRL				(*(volatile uint32_t *) 0xE0001000u)
+#define MSTIMER_DWT_CTRL_CYCCNTENA_MASK	0x00000001u
+#define MSTIMER_DWT_CYCCNT				(*(volatile uint32_t *) 0xE0001004u)
+
+static bool MSTimer_Started = false;
+static unsigned long long int milliseconds_offset;		// set by MSTimer_SetTime, 64 bit, so it is only
+														// read and written with interrupts disabled
+
+static unsigned long long int MSTimer_GetTicks();
+
+
+
+	///////////////////////////////////////
+	/*         public functions          */
+	///////////////////////////////////////
+
 
-// milliseconds counter
-static unsigned long long int milliseconds_counter;
 
 /**
- *  @brief  Increment total milliseconds
+ *  @brief  Start monotonic clock
  *
- *  Increment number of miliseconds by defined constant.
- *  Should be called from timer ISR on defined period (MSTIMER_MILISECOND_COUNTER_INC)
+ *  Chains PIT channel 1 to channel 0, so that they count bus clock ticks
+ *  as one 64 bit counter, which does not overflow for the life of the device.
+ *  Should be called first in peripheral init, clock reads 0 until then.
  *
  *  @return void
  */
-void MSTimer_Increment_milliseconds(){
-	 milliseconds_counter += MSTIMER_MILISECOND_COUNTER_INC;
+void MSTimer_Init(){
+	SIM_SCGC6 |= SIM_SCGC6_PIT_MASK;
+
+	PIT_MCR = 0;											// enable module, keep counting in debug mode
+	PIT_TCTRL0 = 0;
+	PIT_TCTRL1 = 0;
+
+	PIT_LDVAL1 = 0xFFFFFFFF;
+	PIT_TCTRL1 = PIT_TCTRL_CHN_MASK | PIT_TCTRL_TEN_MASK;	// decrements when channel 0 reloads
+	PIT_LDVAL0 = 0xFFFFFFFF;
+	PIT_TCTRL0 = PIT_TCTRL_TEN_MASK;
+
+	MSTimer_Started = true;
+}
+
+/**
+ *  @brief  Returns current time in microseconds
+ *
+ *  Time since MSTimer_Init, with bus clock resolution truncated to microseconds.
+ *  Can be called from any context.
+ *
+ *  @return 64 bit value of microseconds
+ */
+unsigned long long int MSTimer_GetMicros(){
+	return MSTimer_GetTicks() / MSTIMER_TICKS_PER_US;
 }
 
 /**
  *  @brief  Returns current time in milliseconds
  *
- *  Returns current millisecond counter.
+ *  Returns monotonic clock in milliseconds (plus time set by MSTimer_SetTime).
+ *  Can be called from any context.
  *
  *  @return 64 bit value of millisecond counter
  */
 unsigned long long int MSTimerGet (){
-	return milliseconds_counter;
+	unsigned long long int offset;
+
+	EnterCritical();
+	offset = milliseconds_offset;
+	ExitCritical();
+
+	return MSTimer_GetTicks() / MSTIMER_TICKS_PER_MS + offset;
+}
+
+/**
+ *  @brief  Enable cycle counter
+ *
+ *  Starts DWT cycle counter of the core, used for profiling with MSTimer_GetCycles.
+ *  Counter is left running (debugger may use it as well).
+ *
+ *  @return void
+ */
+void MSTimer_CycleCounterEnable(){
+	MSTIMER_DEMCR |= MSTIMER_DEMCR_TRCENA_MASK;
+	MSTIMER_DWT_CYCCNT = 0;
+	MSTIMER_DWT_CTRL |= MSTIMER_DWT_CTRL_CYCCNTENA_MASK;
+}
+
+/**
+ *  @brief  Returns core cycle counter
+ *
+ *  Counts core clock cycles (CPU_CORE_CLK_HZ) and wraps around in ~35 s,
+ *  so difference of two readings (as unsigned 32 bit) is valid for shorter sections.
+ *
+ *  @return Cycle counter
+ */
+uint32_t MSTimer_GetCycles(){
+	return MSTIMER_DWT_CYCCNT;
 }
 
 /**
@@ -42,7 +118,7 @@ unsigned long long int MSTimerGet (){
  *  @return 64 bit value of passed time in ms
  */
 unsigned long long int MSTimerDelta(unsigned long long int timer){
-	return ((unsigned int) (milliseconds_counter - timer));
+	return ((unsigned int) (MSTimerGet() - timer));
 }
 
 /**
@@ -63,14 +139,31 @@ void MSTimerDelay(unsigned long long int delay){
 /**
  *  @brief  Set current time in ms
  *
- *  Set milliseconds counter on desired value
+ *  Set milliseconds counter on desired value, clock keeps counting from there.
  *
  *  @param  64 bit value of current time in ms.
  *
  *  @return void
  */
 void MSTimer_SetTime(unsigned long long int time){
-	milliseconds_counter = time;
+	EnterCritical();
+	milliseconds_offset = time - MSTimer_GetTicks() / MSTIMER_TICKS_PER_MS;
+	ExitCritical();
+}
+
+/**
+ *  @brief  Advance current time
+ *
+ *  Adds time that passed while bus clock was stopped (vlps mode).
+ *
+ *  @param  Number of milliseconds to add
+ *
+ *  @return void
+ */
+void MSTimer_Advance(unsigned long long int delta){
+	EnterCritical();
+	milliseconds_offset += delta;
+	ExitCritical();
 }
 
 /**
@@ -81,5 +174,46 @@ void MSTimer_SetTime(unsigned long long int time){
  *  @return void
  */
 void MSTimer_GetSystemTimeStr(char* txt){
-	sprintf(txt, "%ld", milliseconds_counter);
+	unsigned long long int time = MSTimerGet();
+	unsigned long int seconds = (unsigned long int) (time / 1000);
+	unsigned int millis = (unsigned int) (time % 1000);
+
+	// printed in two parts, "%ld" takes only 32 bits of 64bit value
+	if (seconds != 0)
+		sprintf(txt, "%lu%03u", seconds, millis);
+	else
+		sprintf(txt, "%u", millis);
+}
+
+
+
+	///////////////////////////////////////
+	/*         static functions          */
+	///////////////////////////////////////
+
+
+
+/**
+ *  @brief  Returns ticks of monotonic clock
+ *
+ *  Both halves of counter are read without disabling interrupts, high half is read
+ *  again to detect that low half has reloaded in between (then both are read again).
+ *  Counter counts down, so ticks are its complement.
+ *
+ *  @return 64 bit value of bus clock ticks since MSTimer_Init
+ */
+static unsigned long long int MSTimer_GetTicks(){
+	uint32_t high, low;
+
+	if (MSTimer_Started == false)
+		return 0;
+
+	do
+	{
+		high = PIT_CVAL1;
+		low = PIT_CVAL0;
+	}
+	while (high != PIT_CVAL1);
+
+	return ~(((unsigned long long int) high << 32) | low);
 }
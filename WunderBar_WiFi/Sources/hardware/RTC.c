@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 #include "Hw_modules.h"
 #include <RTC_PDD.h>
 
@@ -57,10 +58,52 @@ void RTC_SetAlarm(unsigned int timeOffset){
 /*
  *  @brief  Returns string of current RTC time in ms
  *
+ *  Seconds are formatted only when they change (digits are cached),
+ *  milliseconds are appended as three digits. No 64bit division is needed.
+ *
  *  @param  Pointer to text string where current time will be returned
  *
- *  @return void
+ *  @return Length of time string
  */
-void RTC_GetSystemTimeStr(char* txt){
-	sprintf(txt, "%ld", RTC_GetTime());
+int RTC_GetSystemTimeStr(char* txt){
+	static unsigned int cachedSeconds = 0;
+	static char cachedTxt[10];
+	static int  cachedLen = 0;
+	unsigned int Seconds, Prescaler, millis;
+	char* ptr;
+
+	Seconds = RTC_PDD_ReadTimeSecondsReg(RTC_BASE_PTR); 		/* current seconds */
+
+	Prescaler = RTC_PDD_ReadTimePrescalerReg(RTC_BASE_PTR);		/* current prescaler for milliseconds */
+
+	millis = (Prescaler * 1000) / 32768;
+
+	if (Seconds == 0)
+		return sprintf(txt, "%u", millis);
+
+	if ((Seconds != cachedSeconds) || (cachedLen == 0))
+	{
+		unsigned int x = Seconds;
+
+		ptr = &cachedTxt[sizeof(cachedTxt)];
+		while (x != 0)
+		{
+			* --ptr = '0' + x % 10;
+			x /= 10;
+		}
+
+		cachedLen = &cachedTxt[sizeof(cachedTxt)] - ptr;
+		memmove(cachedTxt, ptr, cachedLen);
+		cachedSeconds = Seconds;
+	}
+
+	memcpy(txt, cachedTxt, cachedLen);
+	ptr = txt + cachedLen;
+
+	*ptr ++ = '0' + millis / 100;
+	*ptr ++ = '0' + (millis / 10) % 10;
+	*ptr ++ = '0' + millis % 10;
+	*ptr = 0;
+
+	return ptr - txt;
 }
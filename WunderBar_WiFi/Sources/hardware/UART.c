@@ -1,13 +1,163 @@
+#include <string.h>
+
+#include <Common_Defaults.h>
+
 #include "Hw_modules.h"
 
 
 #define UART_BLOCK_TIMEOUT 1000  // 1000 ms will be waiting for response
 
+// UART0 data register is serviced by two DMA channels, receive channel 0 and transmit channel 1
+#define UART_RX_DMA_SOURCE		2			// DMAMUX request source UART0 receive
+#define UART_TX_DMA_SOURCE		3			// DMAMUX request source UART0 transmit
+#define UART_TX_DMA_IRQ_PRI		0x50		// DMA1 interrupt priority, same as UART0 (AS1), they do not preempt each other
+
+#define UART_RX_RING_SIZE		0x2000		// ~180 ms of data on fast rate, should be power of 2
+#define UART_TX_BUF_SIZE		256
+
+static uint8_t  UART_RxRing[UART_RX_RING_SIZE];
+static uint32_t UART_RxTail = 0;				// next byte to read, DMA destination address is the head
+static uint32_t UART_RxHeadLast = 0;			// head at last update
+static uint32_t UART_RxAvail = 0;				// bytes written by DMA and not read yet
+static bool     UART_RxWrapPending = false;		// ring wrap seen through head before DMA flagged it
+
+static struct {
+	uint32_t overruns;							// DMA wrote over unread data
+	uint32_t lost;								// unread bytes discarded on overrun
+	uint32_t fifoOverruns;						// receiver fifo overflowed (DMA did not keep up)
+} UART_RxStats;
+
+static uint8_t  UART_TxBuf[2][UART_TX_BUF_SIZE];	// one buffer is filled while the other one is sent
+static uint8_t  UART_TxNext = 0;
+
+static uint32_t UART_BaudRate = GS_HAL_BAUD_DEFAULT;
+
+#if UART_CAPTURE_SIZE
+
+// Capture of GS link traffic. Dump UART_Capture with debugger (e.g. gdb "dump binary value cap.bin UART_Capture").
+// Record is 6 byte header (time in ms, 32 bit LE, then length 16 bit LE with bit 15 set for TX) followed by data.
+// Oldest records are dropped when the ring is full, the oldest one kept starts at (head - used) modulo size.
+#define UART_CAPTURE_MAGIC		0x50414355		// "UCAP"
+#define UART_CAPTURE_HEADER		6
+#define UART_CAPTURE_TX			0x80
+
+typedef struct {
+	uint32_t magic;
+	uint32_t size;				// size of data
+	uint32_t head;				// next byte to write
+	uint32_t used;				// bytes of complete records in data
+	uint32_t dropped;			// records dropped to make room
+	uint8_t  data[UART_CAPTURE_SIZE];
+} UART_Capture_t;
+
+UART_Capture_t UART_Capture;
+
+#endif
+
+
+// static declarations
+
+static uint32_t UART_RxHead();
+static void UART_RxUpdate();
+static uint32_t UART_RxRead(uint8_t* dst, uint32_t size);
+static void UART_RxCheckOverrun();
+static void UART_TxWait();
+#if UART_CAPTURE_SIZE
+static void UART_CaptureRecord(uint8_t dir, const uint8_t* data, uint32_t len);
+static void UART_CaptureWrite(const uint8_t* data, uint32_t len);
+#endif
+
+
+
+	///////////////////////////////////////
+	/*         public functions          */
+	///////////////////////////////////////
+
+
+
+/**
+ *  @brief  UART init function
+ *
+ *  Takes UART0 over from AS1 component (which sets up pins, baud rate and fifo)
+ *  and hands the data register to DMA. Receive channel writes incoming bytes into
+ *  ring buffer and rewinds at its end, so there is no interrupt per received byte.
+ *  Ring wrap sets channel interrupt flag (DMA0 interrupt stays disabled in NVIC),
+ *  which is polled to detect overrun of unread data.
+ *  Transmit channel sends one buffer per request and stops, its interrupt enables
+ *  transmission complete interrupt which reports end of sending (GS_HAL_OnTxDone).
+ *  Idle line interrupt reports end of received data (GS_HAL_OnRxIdle), both come
+ *  through AS1 interrupt routine (AS1_OnDmaInterrupt).
+ *  Should be called before GS module is reset.
+ *
+ *  @return void
+ */
+void GS_HAL_Init(){
+	SIM_SCGC6 |= SIM_SCGC6_DMAMUX_MASK;
+	SIM_SCGC7 |= SIM_SCGC7_DMA_MASK;
+
+	EnterCritical();
+
+	// AS1 error interrupt would read data register behind DMA's back
+	UART0_C3 &= ~(UART_C3_ORIE_MASK | UART_C3_NEIE_MASK | UART_C3_FEIE_MASK | UART_C3_PEIE_MASK);
+
+	// receive channel: UART0_D -> ring buffer, endless
+	DMAMUX_CHCFG0 = 0;
+	DMA_TCD0_SADDR = (uint32_t) &UART0_D;
+	DMA_TCD0_SOFF = 0;
+	DMA_TCD0_SLAST = 0;
+	DMA_TCD0_ATTR = DMA_ATTR_SSIZE(0) | DMA_ATTR_DSIZE(0);
+	DMA_TCD0_NBYTES_MLNO = 1;
+	DMA_TCD0_DADDR = (uint32_t) UART_RxRing;
+	DMA_TCD0_DOFF = 1;
+	DMA_TCD0_DLASTSGA = (uint32_t) -UART_RX_RING_SIZE;
+	DMA_TCD0_CITER_ELINKNO = DMA_CITER_ELINKNO_CITER(UART_RX_RING_SIZE);
+	DMA_TCD0_BITER_ELINKNO = DMA_BITER_ELINKNO_BITER(UART_RX_RING_SIZE);
+	DMA_TCD0_CSR = DMA_CSR_INTMAJOR_MASK;
+	DMA_CINT = DMA_CINT_CINT(0);
+	DMAMUX_CHCFG0 = DMAMUX_CHCFG_ENBL_MASK | DMAMUX_CHCFG_SOURCE(UART_RX_DMA_SOURCE);
+	DMA_SERQ = DMA_SERQ_SERQ(0);
+
+	// transmit channel: tx buffer -> UART0_D, request is disabled when buffer is sent
+	DMAMUX_CHCFG1 = 0;
+	DMA_TCD1_SOFF = 1;
+	DMA_TCD1_SLAST = 0;
+	DMA_TCD1_ATTR = DMA_ATTR_SSIZE(0) | DMA_ATTR_DSIZE(0);
+	DMA_TCD1_NBYTES_MLNO = 1;
+	DMA_TCD1_DADDR = (uint32_t) &UART0_D;
+	DMA_TCD1_DOFF = 0;
+	DMA_TCD1_DLASTSGA = 0;
+	DMA_TCD1_CSR = DMA_CSR_DREQ_MASK | DMA_CSR_INTMAJOR_MASK;
+	DMA_CINT = DMA_CINT_CINT(1);
+	DMAMUX_CHCFG1 = DMAMUX_CHCFG_ENBL_MASK | DMAMUX_CHCFG_SOURCE(UART_TX_DMA_SOURCE);
+	NVICIP1 = NVIC_IP_PRI1(UART_TX_DMA_IRQ_PRI);
+	NVICISER0 |= NVIC_ISER_SETENA(0x02);
+
+	// receiver full and transmitter empty flags request DMA instead of interrupt,
+	// idle line is counted from stop bit, so a long character is not taken as idle
+	UART0_C5 |= UART_C5_RDMAS_MASK | UART_C5_TDMAS_MASK;
+	UART0_C1 |= UART_C1_ILT_MASK;
+	UART0_C2 = (UART0_C2 & ~UART_C2_TCIE_MASK) | UART_C2_RIE_MASK | UART_C2_TIE_MASK | UART_C2_ILIE_MASK;
+
+	UART_RxTail = 0;
+	UART_RxHeadLast = 0;
+	UART_RxAvail = 0;
+	UART_RxWrapPending = false;
+	UART_TxNext = 0;
+
+#if UART_CAPTURE_SIZE
+	UART_Capture.magic = UART_CAPTURE_MAGIC;
+	UART_Capture.size = UART_CAPTURE_SIZE;
+#endif
+
+	ExitCritical();
+}
 
 /**
  *  @brief  UART write function
  *
- *  Send desired number of bytes via UART module
+ *  Send desired number of bytes via UART module.
+ *  Data is copied to tx buffer and sent by DMA, so function returns while the last
+ *  part is still being sent. Waits only if previous buffer is not sent yet.
  *
  *  @param  Pointer to output buffer
  *  @param  Number of bytes to send
@@ -15,15 +165,36 @@
  *  @return void
  */
 void GS_HAL_send(uint8_t* StrPtr, uint32_t Size){
-	uint32_t written;
-	AS1_SendBlock((AS1_TComData *) StrPtr, (word) Size, (word *) &written);
+	uint32_t len;
+	uint8_t* buf;
+
+	while (Size)
+	{
+		len = (Size < UART_TX_BUF_SIZE) ? Size : UART_TX_BUF_SIZE;
+		buf = UART_TxBuf[UART_TxNext];
+		memcpy(buf, StrPtr, len);				// other buffer may still be on the line
+#if UART_CAPTURE_SIZE
+		UART_CaptureRecord(UART_CAPTURE_TX, buf, len);
+#endif
+
+		UART_TxWait();
+		DMA_CDNE = DMA_CDNE_CDNE(1);
+		DMA_TCD1_SADDR = (uint32_t) buf;
+		DMA_TCD1_CITER_ELINKNO = DMA_CITER_ELINKNO_CITER(len);
+		DMA_TCD1_BITER_ELINKNO = DMA_BITER_ELINKNO_BITER(len);
+		DMA_SERQ = DMA_SERQ_SERQ(1);
+
+		UART_TxNext ^= 1;
+		StrPtr += len;
+		Size -= len;
+	}
 }
 
 /**
  *  @brief  UART receive function
  *
  *  Receive bytes from UART and store them in input buffer. If blocking call is used, function will wait for the
- *  desired number of bytes to be received.
+ *  desired number of bytes to be received (or UART_BLOCK_TIMEOUT), otherwise it takes as many of them as there are available.
  *
  *  @param  Pointer to input buffer
  *  @param  Number of bytes to read
@@ -32,17 +203,20 @@ void GS_HAL_send(uint8_t* StrPtr, uint32_t Size){
  *  @return Number of successfully read bytes.
  */
 unsigned int GS_HAL_recv(uint8_t* recvbyte, uint32_t Size, uint32_t block){
-	word read, result = 0;
+	uint32_t read, result = 0;
 	uint64_t time;
+#if UART_CAPTURE_SIZE
+	uint8_t* start = recvbyte;
+#endif
+
+	UART_RxCheckOverrun();
 
 	if (block)
 	{
 		time = MSTimerGet();
-		while (Size)
+		while (Size && (MSTimerDelta(time) <= UART_BLOCK_TIMEOUT))
 		{
-			while ((AS1_RecvBlock((AS1_TComData*)recvbyte, (word)Size, (word*)&read) != ERR_OK) ||
-																						(MSTimerDelta(time) > UART_BLOCK_TIMEOUT))
-				;
+			read = UART_RxRead(recvbyte, Size);
 
 			recvbyte += read;
 			Size -= read;
@@ -51,9 +225,12 @@ unsigned int GS_HAL_recv(uint8_t* recvbyte, uint32_t Size, uint32_t block){
 	}
 	else
 	{
-		if (AS1_RecvBlock((AS1_TComData*)recvbyte, (word)Size, (word*)&read) == ERR_OK)
-			result = read;
+		result = UART_RxRead(recvbyte, Size);
 	}
+
+#if UART_CAPTURE_SIZE
+	UART_CaptureRecord(0, start, result);
+#endif
 	return result;
 }
 
@@ -63,8 +240,324 @@ unsigned int GS_HAL_recv(uint8_t* recvbyte, uint32_t Size, uint32_t block){
  *  @return void
  */
 void GS_HAL_ClearBuff(){
-	uint8_t dummy;
+	UART_RxCheckOverrun();
+
+	EnterCritical();
+	UART_RxUpdate();
+	UART_RxTail = UART_RxHeadLast;
+	UART_RxAvail = 0;
+	ExitCritical();
+}
+
+/**
+ *  @brief  Set UART baud rate
+ *
+ *  Waits for the data in progress to be sent on the old rate.
+ *  UART0 is clocked by core clock, divider is set in 1/32 steps (SBR and BRFA).
+ *
+ *  @param  Baud rate
+ *
+ *  @return void
+ */
+void GS_HAL_SetBaudRate(uint32_t baudRate){
+	uint32_t div = (2 * CPU_CORE_CLK_HZ + baudRate / 2) / baudRate;
+	uint32_t sbr = div >> 5;
+
+	UART_TxWait();
+	while ((UART0_S1 & UART_S1_TC_MASK) == 0)
+		;
+
+	EnterCritical();										// C2 is also written by DMA1 and UART0 interrupts
+	UART0_C2 &= ~(UART_C2_TE_MASK | UART_C2_RE_MASK);
+	UART0_BDH = (UART0_BDH & ~UART_BDH_SBR_MASK) | UART_BDH_SBR(sbr >> 8);
+	UART0_BDL = UART_BDL_SBR(sbr);							// new rate takes effect on BDL write
+	UART0_C4 = (UART0_C4 & ~UART_C4_BRFA_MASK) | UART_C4_BRFA(div & 0x1F);
+	UART0_C2 |= UART_C2_TE_MASK | UART_C2_RE_MASK;
+	ExitCritical();
+
+	UART_BaudRate = baudRate;
+}
+
+/**
+ *  @brief  Get UART baud rate
+ *
+ *  @return Baud rate
+ */
+uint32_t GS_HAL_GetBaudRate(){
+	return UART_BaudRate;
+}
+
+/**
+ *  @brief  Get UART receive error counters
+ *
+ *  @param  Return number of ring overruns (DMA wrote over unread data)
+ *  @param  Return number of unread bytes discarded on ring overruns
+ *  @param  Return number of receiver fifo overruns
+ *
+ *  @return void
+ */
+void GS_HAL_GetRxStats(uint32_t* overruns, uint32_t* lost, uint32_t* fifoOverruns){
+	*overruns = UART_RxStats.overruns;
+	*lost = UART_RxStats.lost;
+	*fifoOverruns = UART_RxStats.fifoOverruns;
+}
+
+/**
+ *  @brief  UART0 status interrupt
+ *
+ *  Called from AS1 interrupt routine once data register is serviced by DMA.
+ *  Idle line flag is cleared by reading status and data register. Data register
+ *  is read only when receiver fifo is empty (DMA took the last byte), otherwise
+ *  the flag stays set and interrupt comes again after DMA empties the fifo.
+ *  Transmission complete interrupt is enabled by transmit DMA interrupt, when the
+ *  last byte is already in fifo, and it's disabled here after one report.
+ *
+ *  @return void
+ */
+void GS_HAL_Interrupt(){
+	uint8_t status = UART0_S1;
+
+	if ((status & UART_S1_IDLE_MASK) && (UART0_RCFIFO == 0))
+	{
+		(void) UART0_D;
+		UART0_SFIFO = UART_SFIFO_RXUF_MASK;		// clear underflow caused by the read
+		GS_HAL_OnRxIdle();
+	}
+
+	if ((UART0_C2 & UART_C2_TCIE_MASK) && (status & UART_S1_TC_MASK))
+	{
+		UART0_C2 &= ~UART_C2_TCIE_MASK;
+		GS_HAL_OnTxDone();
+	}
+}
+
+/**
+ *  @brief  Transmit DMA interrupt
+ *
+ *  Whole buffer is written to UART, transmission complete interrupt
+ *  will report when its last byte leaves the line.
+ *
+ *  @return void
+ */
+void GS_HAL_TxDmaInterrupt(){
+	DMA_CINT = DMA_CINT_CINT(1);
+	UART0_C2 |= UART_C2_TCIE_MASK;
+}
+
+
+
+
+	///////////////////////////////////////
+	/*         static functions          */
+	///////////////////////////////////////
 
-	while (AS1_GetCharsInRxBuf())
-		GS_HAL_recv(&dummy, 1, 0);
+
+
+/**
+ *  @brief  Get ring buffer write index
+ *
+ *  @return Index of the next byte DMA will write
+ */
+static uint32_t UART_RxHead(){
+	// address may point to the end of ring for a moment, before DMA rewinds it
+	return ((uint32_t) DMA_TCD0_DADDR - (uint32_t) UART_RxRing) & (UART_RX_RING_SIZE - 1);
+}
+
+/**
+ *  @brief  Count bytes written by DMA since last update
+ *
+ *  Head going back means ring wrapped once. Wrap flag set while head did not go back
+ *  means a whole ring (or more) was written since last update. If unread bytes
+ *  fill the ring, DMA has written over them: overrun is counted and unread data
+ *  is discarded, reading continues with the next byte received.
+ *  Should be called more often than the ring is filled, more laps are counted as one.
+ *
+ *  @return void
+ */
+static void UART_RxUpdate(){
+	uint32_t head = UART_RxHead();
+	uint32_t count;
+
+	if (DMA_INT & DMA_INT_INT0_MASK)
+	{
+		DMA_CINT = DMA_CINT_CINT(0);
+
+		// flag of the wrap seen through head (now or on last update) is not another lap
+		if ((head >= UART_RxHeadLast) && (UART_RxWrapPending == false))
+		{
+			// ring may have wrapped just after head was read
+			count = UART_RxHead();
+			if (count < head)
+				head = count;
+			else
+				UART_RxAvail += UART_RX_RING_SIZE;
+		}
+		UART_RxWrapPending = false;
+	}
+	else if (head < UART_RxHeadLast)
+	{
+		UART_RxWrapPending = true;				// flag is set by DMA a moment later
+	}
+
+	count = (head - UART_RxHeadLast) & (UART_RX_RING_SIZE - 1);
+	UART_RxHeadLast = head;
+	UART_RxAvail += count;
+
+	if (UART_RxAvail >= UART_RX_RING_SIZE)
+	{
+		UART_RxStats.overruns ++;
+		UART_RxStats.lost += UART_RxAvail;
+		UART_RxTail = head;
+		UART_RxAvail = 0;
+	}
 }
+
+/**
+ *  @brief  Read from ring buffer
+ *
+ *  Copy available bytes, in at most two parts when data wraps around the end of ring.
+ *
+ *  @param  Pointer to input buffer
+ *  @param  Number of bytes to read
+ *
+ *  @return Number of bytes read
+ */
+static uint32_t UART_RxRead(uint8_t* dst, uint32_t size){
+	uint32_t len, read = 0;
+
+	EnterCritical();
+	UART_RxUpdate();
+	ExitCritical();
+
+	while (size && UART_RxAvail)
+	{
+		len = UART_RX_RING_SIZE - UART_RxTail;
+		if (len > UART_RxAvail)
+			len = UART_RxAvail;
+		if (len > size)
+			len = size;
+
+		memcpy(dst, &UART_RxRing[UART_RxTail], len);
+		UART_RxTail = (UART_RxTail + len) & (UART_RX_RING_SIZE - 1);
+		UART_RxAvail -= len;
+
+		dst += len;
+		size -= len;
+		read += len;
+	}
+	return read;
+}
+
+/**
+ *  @brief  Recover receiver after overrun
+ *
+ *  On overrun receiver stops storing data until the flag is cleared by reading status
+ *  and data register. DMA reads only data register, so it's done here once fifo is empty.
+ *
+ *  @return void
+ */
+static void UART_RxCheckOverrun(){
+	if ((UART0_S1 & UART_S1_OR_MASK) && (UART0_RCFIFO == 0))
+	{
+		UART_RxStats.fifoOverruns ++;
+		(void) UART0_D;
+		UART0_SFIFO = UART_SFIFO_RXUF_MASK;		// clear underflow caused by the read
+	}
+}
+
+/**
+ *  @brief  Wait for transmit DMA to finish
+ *
+ *  Request is disabled by DMA when the whole buffer is sent.
+ *
+ *  @return void
+ */
+static void UART_TxWait(){
+	uint64_t time = MSTimerGet();
+
+	while (DMA_ERQ & DMA_ERQ_ERQ1_MASK)
+	{
+		if (MSTimerDelta(time) > UART_BLOCK_TIMEOUT)
+		{
+			DMA_CERQ = DMA_CERQ_CERQ(1);
+			break;
+		}
+	}
+}
+
+#if UART_CAPTURE_SIZE
+
+/**
+ *  @brief  Record UART traffic into capture ring
+ *
+ *  Oldest records are dropped until there is room for the new one.
+ *  Called from timer and external interrupt contexts, so ring is updated in critical section.
+ *
+ *  @param  Direction, UART_CAPTURE_TX or 0 for received data
+ *  @param  Pointer to data
+ *  @param  Number of bytes
+ *
+ *  @return void
+ */
+static void UART_CaptureRecord(uint8_t dir, const uint8_t* data, uint32_t len){
+	uint8_t header[UART_CAPTURE_HEADER];
+	uint32_t time = (uint32_t) MSTimerGet();
+	uint32_t tail, dropLen;
+
+	if (len == 0)
+		return;
+	if (len > UART_CAPTURE_SIZE / 4)				// a few records should always fit
+		len = UART_CAPTURE_SIZE / 4;
+
+	header[0] = time;
+	header[1] = time >> 8;
+	header[2] = time >> 16;
+	header[3] = time >> 24;
+	header[4] = len;
+	header[5] = (len >> 8) | dir;
+
+	EnterCritical();
+
+	while (UART_Capture.used + UART_CAPTURE_HEADER + len > UART_CAPTURE_SIZE)
+	{
+		tail = UART_Capture.head + UART_CAPTURE_SIZE - UART_Capture.used;
+		dropLen = UART_Capture.data[(tail + 4) % UART_CAPTURE_SIZE] |
+					((UART_Capture.data[(tail + 5) % UART_CAPTURE_SIZE] & ~UART_CAPTURE_TX) << 8);
+
+		UART_Capture.used -= UART_CAPTURE_HEADER + dropLen;
+		UART_Capture.dropped ++;
+	}
+
+	UART_CaptureWrite(header, UART_CAPTURE_HEADER);
+	UART_CaptureWrite(data, len);
+	UART_Capture.used += UART_CAPTURE_HEADER + len;
+
+	ExitCritical();
+}
+
+/**
+ *  @brief  Copy bytes to capture ring head
+ *
+ *  @param  Pointer to data
+ *  @param  Number of bytes
+ *
+ *  @return void
+ */
+static void UART_CaptureWrite(const uint8_t* data, uint32_t len){
+	uint32_t part;
+
+	while (len)
+	{
+		part = UART_CAPTURE_SIZE - UART_Capture.head;
+		if (part > len)
+			part = len;
+
+		memcpy(&UART_Capture.data[UART_Capture.head], data, part);
+		UART_Capture.head = (UART_Capture.head + part) % UART_CAPTURE_SIZE;
+
+		data += part;
+		len -= part;
+	}
+}
+
+#endif
@@ -66,6 +66,7 @@
 /* User includes (#include below this line is not maintained by Processor Expert) */
 #include <User_init.h>
 #include <Common_Defaults.h>
+#include <Scheduler/Scheduler.h>
 
 
 /*lint -save  -e970 Disable MISRA rule (6.3) checking. */
@@ -84,9 +85,7 @@ int main(void)
 	Global_Peripheral_Init();
 
   for(;;) {
-#ifdef __SLEEP__
-	  Sleep_CheckConditions();
-#endif
+	  Sched_Run();						// run pending tasks, sleep when idle
   }
   /* For example: for(;;) { } */
 
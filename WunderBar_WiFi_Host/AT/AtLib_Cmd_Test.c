@@ -0,0 +1,505 @@
+/** @file   AtLib_Cmd_Test.c
+ *  @brief  Host equivalence test and benchmark of AT command builder and CID lookup.
+ *
+ *  		Commands are sent by library functions (ATLIB_CMD_START, AtLib_CmdStr,
+ *  		AtLib_CmdNum) and by sprintf of the format strings which were used
+ *  		before (reference below, cut at the end of command buffer as builder
+ *  		does). Random strings, some longer than command buffer, and numbers
+ *  		over the whole range of argument types are used. Bytes given to UART
+ *  		have to be the same. CID lookup table is compared with sscanf for every
+ *  		character.
+ *
+ *  		Benchmark gives time of connect command sequence (module answers OK)
+ *  		and of CID lookup, both ways.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "GS/AT/AtCmdLib.c"
+
+
+// simulated environment
+
+#define TEST_ROUNDS				20000
+#define TEST_STR_MAX			120					// three arguments can fill command buffer
+#define SIM_SENT_MAX			(2 * HOST_APP_TX_CMD_MAX_SIZE)
+#define BENCH_ROUNDS			20000
+#define BENCH_CID_ROUNDS		1000000
+
+static const char Sim_Reply[] = "\r\nOK\r\n";
+
+static uint8_t  Sim_Sent[SIM_SENT_MAX];
+static uint32_t Sim_SentLen;
+static uint32_t Sim_ReplyPos = sizeof(Sim_Reply) - 1;	// nothing to answer
+
+static int Test_Failed;
+
+#define CHECK(cond)		do { if (!(cond)) { printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); Test_Failed ++; } } while (0)
+
+unsigned long long int MSTimerGet(){ return 0; }
+unsigned long long int MSTimerDelta(unsigned long long int timer){ return 0; }
+void MSTimerDelay(unsigned long long int delay){}
+uint32_t App_ProcessIncomingData(uint8_t cid, const uint8_t *pData, uint32_t dataLen){ return dataLen; }
+void App_ProcessCompletedBulkTransferEvent(uint8_t cid){}
+void App_ProcessCompletedHttpBulkTransferEvent(uint8_t cid){}
+
+/**
+*  @brief  Module takes the command and answers OK
+*/
+void GS_HAL_send(uint8_t* StrPtr, uint32_t Size){
+	if (Sim_SentLen + Size <= SIM_SENT_MAX)
+	{
+		memcpy(&Sim_Sent[Sim_SentLen], StrPtr, Size);
+		Sim_SentLen += Size;
+	}
+	Sim_ReplyPos = 0;
+}
+
+unsigned int GS_HAL_recv(uint8_t* recvbyte, uint32_t Size, uint32_t block){
+	uint32_t len = sizeof(Sim_Reply) - 1 - Sim_ReplyPos;
+
+	if (len > Size)
+		len = Size;
+
+	memcpy(recvbyte, &Sim_Reply[Sim_ReplyPos], len);
+	Sim_ReplyPos += len;
+	return len;
+}
+
+
+// commands before builder (sprintf into command buffer)
+
+static void Ref_Command(bool response, const char* format, ...){
+	va_list args;
+
+	va_start(args, format);
+	vsnprintf(G_ATCmdBuf, sizeof(G_ATCmdBuf), format, args);
+	va_end(args);
+	G_ATCmdLen = strlen(G_ATCmdBuf);
+
+	if (response)
+		AtLib_CommandSend();
+	else
+		AtLib_CommandSendNoResponse();
+}
+
+static uint8_t Ref_getCidFromAscii(uint8_t cidAscii){
+	unsigned int temp;
+	uint8_t cidStr[] = "00";
+
+	cidStr[1] = cidAscii;
+	sscanf((const char *) cidStr, "%x", (unsigned int *) &temp);
+	return (uint8_t) temp;
+}
+
+
+// test
+
+typedef enum {
+	CMD_CHECK = 0,
+	CMD_ECHO,
+	CMD_BAUD,
+	CMD_DHCP,
+	CMD_PSK,
+	CMD_PASS,
+	CMD_ASSOC,
+	CMD_ASSOC_NO_BSSID,
+	CMD_ASSOC_SSID,
+	CMD_IPSET,
+	CMD_DNSLOOKUP,
+	CMD_SETTIME,
+	CMD_TCP,
+	CMD_UDP,
+	CMD_SSLOPEN,
+	CMD_SOCKOPT,
+	CMD_STANDBY,
+	CMD_FWUP,
+	CMD_NAUTO,
+	CMD_ATS,
+	CMD_WEP,
+	CMD_DNSMODE,
+	CMD_GPIO,
+	CMD_KEEPALIVE,
+	CMD_PSPOLL,
+	CMD_COUNT
+} Cmd_t;
+
+typedef struct {
+	char     str[3][TEST_STR_MAX + 1];
+	uint32_t num[4];
+} Cmd_Args_t;
+
+// connect sequence: init, association, dns, tcp, socket options and ssl
+static const Cmd_t Bench_Sequence[] = {
+	CMD_CHECK, CMD_ECHO, CMD_GPIO, CMD_KEEPALIVE, CMD_PSPOLL, CMD_DHCP, CMD_PASS, CMD_ASSOC_SSID,
+	CMD_DNSLOOKUP, CMD_SETTIME, CMD_TCP, CMD_SOCKOPT, CMD_SOCKOPT, CMD_SSLOPEN
+};
+
+#define BENCH_COMMANDS			(sizeof(Bench_Sequence) / sizeof(Bench_Sequence[0]))
+
+/**
+*  @brief  Send command by library function or by former format string
+*
+*  Numbers are cast to argument types of the library function, reference
+*  passes them as the former code did.
+*/
+static void Cmd_Run(Cmd_t cmd, Cmd_Args_t* a, bool ref){
+	int8_t* s0 = (int8_t*) a->str[0];
+	int8_t* s1 = (int8_t*) a->str[1];
+	int8_t* s2 = (int8_t*) a->str[2];
+	uint32_t* n = a->num;
+
+	switch (cmd)
+	{
+	case CMD_CHECK :
+		if (ref)
+			Ref_Command(true, "\r\nAT\r\n");
+		else
+			AtLibGs_Check();
+		break;
+
+	case CMD_ECHO :
+		if (ref)
+			Ref_Command(true, "ATE%d\r\n", (uint8_t) n[0]);
+		else
+			AtLibGs_SetEcho(n[0]);
+		break;
+
+	case CMD_BAUD :
+		if (ref)
+			Ref_Command(true, "ATB=%d\r\n", n[0]);
+		else
+			AtLibGs_SetBaudRate(n[0]);
+		break;
+
+	case CMD_DHCP :
+		if (ref)
+			Ref_Command(true, "AT+NDHCP=%d\r\n", (uint8_t) n[0]);
+		else
+			AtLibGs_DHCPSet(n[0]);
+		break;
+
+	case CMD_PSK :
+		if (ref)
+			Ref_Command(true, "AT+WPAPSK=%s,%s\r\n", s0, s1);
+		else
+			AtLibGs_CalcNStorePSK(s0, s1);
+		break;
+
+	case CMD_PASS :
+		if (ref)
+			Ref_Command(true, "AT+WWPA=%s\r\n", s0);
+		else
+			AtLibGs_SetPassPhrase(s0);
+		break;
+
+	case CMD_ASSOC :
+		if (ref)
+			Ref_Command(true, "AT+WA=%s,%s,%s\r\n", s0, s1, s2);
+		else
+			AtLibGs_Assoc(s0, s1, s2);
+		break;
+
+	case CMD_ASSOC_NO_BSSID :
+		if (ref)
+			Ref_Command(true, "AT+WA=%s,%s,%s\r\n", s0, "", s2);
+		else
+			AtLibGs_Assoc(s0, NULL, s2);
+		break;
+
+	case CMD_ASSOC_SSID :
+		if (ref)
+			Ref_Command(true, "AT+WA=%s\r\n", s0);
+		else
+			AtLibGs_Assoc(s0, NULL, NULL);
+		break;
+
+	case CMD_IPSET :
+		if (ref)
+			Ref_Command(true, "AT+NSET=%s,%s,%s\r\n", s0, s1, s2);
+		else
+			AtLibGs_IPSet(s0, s1, s2);
+		break;
+
+	case CMD_DNSLOOKUP :
+		if (ref)
+			Ref_Command(true, "AT+DNSLOOKUP=%s\r\n", s0);
+		else
+			AtLibGs_DNSLookup(s0);
+		break;
+
+	case CMD_SETTIME :
+		if (ref)
+			Ref_Command(true, "AT+SETTIME=%s\n", s0);
+		else
+			AtLibGs_SetTime(s0);
+		break;
+
+	case CMD_TCP :
+		if (ref)
+			Ref_Command(true, "AT+NCTCP=%s,%s\n", s0, s1);
+		else
+			AtLibGs_TcpClientStart(s0, s1);
+		break;
+
+	case CMD_UDP :
+		if (ref)
+			Ref_Command(true, "AT+NCUDP=%s,%s,%s\r\n", s0, s1, s2);
+		else
+			AtLibGs_UdpClientStart(s0, s1, s2);
+		break;
+
+	case CMD_SSLOPEN :
+		if (ref)
+			Ref_Command(true, "AT+SSLOPEN=%d,%s\n", (uint8_t) n[0], s0);
+		else
+			AtLib_SSLOpen(n[0], (char*) s0);
+		break;
+
+	case CMD_SOCKOPT :
+		if (ref)
+			Ref_Command(true, "AT+SETSOCKOPT=%d,%d,%d,%d,%d\r\n", (uint8_t) n[0], (ATLIB_SOCKET_OPTION_TYPE_E) n[1], (ATLIB_SOCKET_OPTION_PARAM_E) n[2], (int) n[3], 4);
+		else
+			AtLib_SetSocketOptions(n[0], (ATLIB_SOCKET_OPTION_TYPE_E) n[1], (ATLIB_SOCKET_OPTION_PARAM_E) n[2], n[3]);
+		break;
+
+	case CMD_STANDBY :
+		if (ref)
+			Ref_Command(false, "AT+PSSTBY=%d,%d,%d,%d\r\n", (int) n[0], (int) n[1], (int) n[2], (int) n[3]);
+		else
+			AtLibGs_GotoSTNDBy(n[0], n[1], n[2], n[3]);
+		break;
+
+	case CMD_FWUP :
+		if (ref)
+			Ref_Command(true, "AT+FWUP=%s,%d,%d,%s\r\n", s0, (int) n[0], (int) n[1], s1);
+		else
+			AtLibGs_FWUpgrade(s0, n[0], n[1], s1);
+		break;
+
+	case CMD_NAUTO :
+		if (ref)
+			Ref_Command(true, "AT+NAUTO=0,0,%s,%d\r\n", s0, (int16_t) n[0]);
+		else
+			AtLibGs_StoreNAutoConn(s0, n[0]);
+		break;
+
+	case CMD_ATS :
+		if (ref)
+			Ref_Command(true, "ATS%d=%d\r\n", (uint8_t) n[0], (uint8_t) n[1]);
+		else
+			AtLibGs_StoreATS(n[0], n[1]);
+		break;
+
+	case CMD_WEP :
+		if (ref)
+			Ref_Command(true, "AT+WWEP%d=,%s\r\n", (int8_t) n[0], s0);
+		else
+			AtLibGs_SetWepKey(n[0], (char*) s0);
+		break;
+
+	case CMD_DNSMODE :
+		if (ref)
+			Ref_Command(true, "AT+DNS=%d,%s\r\n", (int8_t) n[0], s0);
+		else
+			AtLibGs_SetDNSServerMode(n[0], (char*) s0);
+		break;
+
+	case CMD_GPIO :
+		if (ref)
+			Ref_Command(true, "AT+DGPIO=%d,%d\r\n", (ATLIB_GPIO_PIN_E) n[0], (ATLIB_GPIO_STATE_E) n[1]);
+		else
+			AtLib_SetGPIO((ATLIB_GPIO_PIN_E) n[0], (ATLIB_GPIO_STATE_E) n[1]);
+		break;
+
+	case CMD_KEEPALIVE :
+		if (ref)
+			Ref_Command(true, "AT+WKEEPALIVE=%d\r\n", (int) n[0]);
+		else
+			AtLib_WLanKeepalive(n[0]);
+		break;
+
+	case CMD_PSPOLL :
+		if (ref)
+			Ref_Command(true, "AT+WIEEEPSPOLL=%d,%d\r\n", (int) n[0], (int) n[1]);
+		else
+			AtLib_PsPoll(n[0], n[1]);
+		break;
+
+	default :
+		break;
+	}
+}
+
+/**
+*  @brief  Bytes sent to module by one command
+*/
+static uint32_t Cmd_Sent(Cmd_t cmd, Cmd_Args_t* a, bool ref, uint8_t* sent){
+	Sim_SentLen = 0;
+	Sim_ReplyPos = sizeof(Sim_Reply) - 1;
+
+	Cmd_Run(cmd, a, ref);
+	memcpy(sent, Sim_Sent, Sim_SentLen);
+	return Sim_SentLen;
+}
+
+/**
+*  @brief  Random string, any character but zero
+*/
+static void Test_RandomStr(char* str){
+	int len = (rand() % 4) ? rand() % 24 : rand() % (TEST_STR_MAX + 1), i;
+
+	for (i = 0; i < len; i ++)
+		str[i] = (rand() % 4) ? ' ' + rand() % 95 : 1 + rand() % 255;
+	str[len] = 0;
+}
+
+/**
+*  @brief  Random number, small ones and edges of argument types are more likely
+*/
+static uint32_t Test_RandomNum(){
+	static const uint32_t edges[] = { 0, 1, 9, 10, 99, 127, 128, 255, 256, 32767, 32768, 65535, 65536,
+			0x7FFFFFFF, 0x80000000, 0xFFFFFFFF };
+
+	switch (rand() % 4)
+	{
+	case 0 :
+		return rand() % 1000;
+
+	case 1 :
+		return edges[rand() % (sizeof(edges) / sizeof(edges[0]))];
+
+	default :
+		return ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+	}
+}
+
+/** @brief Same bytes sent as with sprintf of former format strings */
+static void Test_Commands(){
+	static uint8_t sent[SIM_SENT_MAX], refSent[SIM_SENT_MAX];
+	Cmd_Args_t args;
+	uint32_t len, refLen, cut = 0;
+	int r, c, i, bad[CMD_COUNT] = { 0 };
+
+	for (r = 0; r < TEST_ROUNDS; r ++)
+	{
+		for (i = 0; i < 3; i ++)
+			Test_RandomStr(args.str[i]);
+		for (i = 0; i < 4; i ++)
+			args.num[i] = Test_RandomNum();
+
+		for (c = 0; c < CMD_COUNT; c ++)
+		{
+			len = Cmd_Sent(c, &args, false, sent);
+			CHECK(G_ATCmdLen == strlen(G_ATCmdBuf));
+			refLen = Cmd_Sent(c, &args, true, refSent);
+
+			if ((len != refLen) || (memcmp(sent, refSent, len) != 0))
+			{
+				if (bad[c] ++ == 0)
+					printf("  command %d \"%.*s\" (reference \"%.*s\")\n", c, (int) len, sent, (int) refLen, refSent);
+			}
+			if (len == HOST_APP_TX_CMD_MAX_SIZE - 1)
+				cut ++;
+		}
+	}
+
+	for (c = 0; c < CMD_COUNT; c ++)
+		CHECK(bad[c] == 0);
+	CHECK(cut > 0);
+	printf("%d commands, %d argument sets, %u cut at end of buffer\n", CMD_COUNT, TEST_ROUNDS, cut);
+}
+
+/** @brief CID lookup table gives the same as sscanf for hex digits and invalid cid for other characters */
+static void Test_Cid(){
+	int c;
+
+	for (c = 0; c < 256; c ++)
+	{
+		if (isxdigit(c))
+			CHECK(AtLib_getCidFromAscii(c) == Ref_getCidFromAscii(c));
+		else
+			CHECK(AtLib_getCidFromAscii(c) == HOST_APP_INVALID_CID);
+	}
+}
+
+
+// benchmark
+
+static uint64_t Bench_Ns(){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+*  @brief  Time of connect sequence, commands built both ways
+*/
+static void Bench_Sequence_Time(){
+	Cmd_Args_t args = {
+		.str = { "wunderbar-test", "52.18.206.44", "8883" },
+		.num = { 1, 1, 1, 30 }
+	};
+	uint64_t start, ns[2];
+	unsigned int r, i, ref;
+
+	for (ref = 0; ref < 2; ref ++)
+	{
+		start = Bench_Ns();
+		for (r = 0; r < BENCH_ROUNDS; r ++)
+			for (i = 0; i < BENCH_COMMANDS; i ++)
+			{
+				Sim_SentLen = 0;
+				Cmd_Run(Bench_Sequence[i], &args, ref);
+			}
+		ns[ref] = Bench_Ns() - start;
+	}
+
+	printf("connect sequence: %.2f us (sprintf %.2f us), %u commands\n",
+			ns[0] / 1e3 / BENCH_ROUNDS, ns[1] / 1e3 / BENCH_ROUNDS, (unsigned int) BENCH_COMMANDS);
+}
+
+/**
+*  @brief  Time of CID lookup, table and sscanf
+*/
+static void Bench_Cid(){
+	static const char cids[] = "0123456789abcdef";
+	volatile unsigned int sum = 0;
+	uint64_t start, ns, refNs;
+	unsigned int r;
+
+	start = Bench_Ns();
+	for (r = 0; r < BENCH_CID_ROUNDS; r ++)
+		sum += AtLib_getCidFromAscii(cids[r & 15]);
+	ns = Bench_Ns() - start;
+
+	start = Bench_Ns();
+	for (r = 0; r < BENCH_CID_ROUNDS; r ++)
+		sum += Ref_getCidFromAscii(cids[r & 15]);
+	refNs = Bench_Ns() - start;
+
+	printf("cid lookup: %.1f ns (sscanf %.1f ns)\n", (double) ns / BENCH_CID_ROUNDS, (double) refNs / BENCH_CID_ROUNDS);
+}
+
+int main(){
+	srand(2015);
+
+	Test_Commands();
+	Test_Cid();
+	Bench_Sequence_Time();
+	Bench_Cid();
+
+	printf(Test_Failed ? "FAILED\n" : "PASSED\n");
+	return Test_Failed ? 1 : 0;
+}
@@ -0,0 +1,319 @@
+/** @file   AtLib_Eof_Test.c
+ *  @brief  Host fuzz test and benchmark of AT response line classifier (AtLib_checkEOFMessage).
+ *
+ *  		Random lines are built from the recognized literals, their prefixes,
+ *  		near misses and noise, and classified by firmware table matcher and by
+ *  		the chain of strstr calls which was used before (reference below).
+ *  		Return code and side effects (association, reset and cid flags) have
+ *  		to be the same for every line.
+ *
+ *  		Benchmark gives time per line of both classifiers on responses of
+ *  		association, tcp and ssl connect.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "GS/AT/AtCmdLib.c"
+
+
+// simulated environment
+
+#define TEST_ROUNDS				3000000
+#define TEST_LINE_MAX			120
+#define BENCH_ROUNDS			20000
+
+static int Test_Failed;
+
+#define CHECK(cond)		do { if (!(cond)) { printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); Test_Failed ++; } } while (0)
+
+unsigned long long int MSTimerGet(){ return 0; }
+unsigned long long int MSTimerDelta(unsigned long long int timer){ return 0; }
+void MSTimerDelay(unsigned long long int delay){}
+void GS_HAL_send(uint8_t* StrPtr, uint32_t Size){}
+unsigned int GS_HAL_recv(uint8_t* recvbyte, uint32_t Size, uint32_t block){ return 0; }
+uint32_t App_ProcessIncomingData(uint8_t cid, const uint8_t *pData, uint32_t dataLen){ return dataLen; }
+void App_ProcessCompletedBulkTransferEvent(uint8_t cid){}
+void App_ProcessCompletedHttpBulkTransferEvent(uint8_t cid){}
+
+
+// classifier before response line table (chain of strstr calls)
+
+static HOST_APP_MSG_ID_E
+Ref_checkEOFMessage (const uint8_t * pBuffer)
+{
+
+  if ((strstr ((const char *) pBuffer, "OK") != NULL))
+    {
+      return HOST_APP_MSG_ID_OK;
+    }
+  else if ((strstr ((const char *) pBuffer, "ERROR: INVALID INPUT") != NULL))
+    {
+      return HOST_APP_MSG_ID_INVALID_INPUT;
+    }
+  else if ((strstr ((const char *) pBuffer, "DISASSOCIATED") != NULL))
+    {
+      /* Reset the local flags */
+      AtLib_ClearNodeAssociationFlag ();
+      AtLib_ClearAllCid ();
+      return HOST_APP_MSG_ID_DISASSOCIATION_EVENT;
+    }
+  else if ((strstr ((const char *) pBuffer, "ERROR: IP CONFIG FAIL") != NULL))
+    {
+      return HOST_APP_MSG_ID_ERROR_IP_CONFIG_FAIL;
+    }
+  else if (strstr ((const char *) pBuffer, "ERROR: SOCKET FAILURE") != NULL)
+    {
+      /* Reset the local flags */
+      AtLib_ClearAllCid ();
+      return HOST_APP_MSG_ID_ERROR_SOCKET_FAIL;
+    }
+  else if ((strstr ((const char *) pBuffer, "ERROR") != NULL))
+    {
+      return HOST_APP_MSG_ID_ERROR;
+    }
+  else if ((strstr ((const char *) pBuffer, "APP Reset-APP SW Reset"))
+	   != NULL)
+    {
+      /* Reset the local flags */
+      AtLib_ClearNodeAssociationFlag ();
+      AtLib_SetNodeResetFlag ();
+      AtLib_ClearAllCid ();
+      return HOST_APP_MSG_ID_APP_RESET;
+    }
+  else
+    if ((strstr
+	 ((const char *) pBuffer,
+	  "APP Reset External Flash FW-UP-SUCCESS")) != NULL)
+    {
+      /* Reset the local flags */
+      AtLib_ClearNodeAssociationFlag ();
+      AtLib_SetNodeResetFlag ();
+      AtLib_ClearAllCid ();
+      return HOST_APP_MSG_ID_FW_UPDATE_OK;
+    }
+  else if (((uint8_t *) strstr ((const char *) pBuffer, "DISCONNECT"))
+	   != NULL)
+    {
+      /* Reset the local flags */
+      AtLib_ClearAllCid ();
+      return HOST_APP_MSG_ID_DISCONNECT;
+    }
+  else if ((strstr ((const char *) pBuffer, "Disassociation Event")) != NULL)
+    {
+      /* reset the association flag */
+      AtLib_ClearNodeAssociationFlag ();
+      AtLib_ClearAllCid ();
+      return HOST_APP_MSG_ID_DISASSOCIATION_EVENT;
+    }
+  else if ((strstr ((const char *) pBuffer, "Out of StandBy-Alarm")) != NULL)
+    {
+      return HOST_APP_MSG_ID_OUT_OF_STBY_ALARM;
+    }
+  else if ((strstr ((const char *) pBuffer, "Out of StandBy-Timer")) != NULL)
+    {
+      return HOST_APP_MSG_ID_OUT_OF_STBY_TIMER;
+    }
+  else if ((strstr ((const char *) pBuffer, "UnExpected Warm Boot")) != NULL)
+    {
+      /* Reset the local flags */
+      AtLib_ClearNodeAssociationFlag ();
+      AtLib_SetNodeResetFlag ();
+      AtLib_ClearAllCid ();
+      return HOST_APP_MSG_ID_UNEXPECTED_WARM_BOOT;
+    }
+  else if ((strstr ((const char *) pBuffer, "Out of Deep Sleep")) != NULL)
+    {
+      return HOST_APP_MSG_ID_OUT_OF_DEEP_SLEEP;
+    }
+  else if ((strstr ((const char *) pBuffer, "Serial2WiFi APP")) != NULL)
+    {
+      /* Reset the local flags */
+      AtLib_ClearNodeAssociationFlag ();
+      AtLib_SetNodeResetFlag ();
+      AtLib_ClearAllCid ();
+      return HOST_APP_MSG_ID_WELCOME_MSG;
+    }
+  else if ((strstr ((const char *) pBuffer, "CONNECT ")) != NULL
+	   && strlen (strstr ((const char *) pBuffer, "CONNECT ")) > 20)
+    {
+      // String is formatted as CONNECT 0 1 192.168.100.200 65535
+      return HOST_APP_MSG_ID_TCP_SERVER_CLIENT_CONNECTION;
+    }
+
+  return HOST_APP_MSG_ID_NONE;
+}
+
+
+// test
+
+typedef struct {
+	HOST_APP_MSG_ID_E id;
+	uint8_t association;
+	uint8_t reset;
+	uint8_t tcpCid;
+	uint8_t udpCid;
+} Test_Result_t;
+
+// response lines of association, tcp and ssl connect (S2W module)
+static const char* const Test_Transcript[] = {
+	"Serial2WiFi APP", "AT+WD", "OK", "ATE0", "OK", "AT+NDHCP=1", "OK",
+	"AT+WWPA=s3cret-pass", "OK", "AT+WA=wunderbar-test,,11",
+	"    IP              SubNet         Gateway   ", " 192.168.1.20: 255.255.255.0: 192.168.1.1", "OK",
+	"AT+DNSLOOKUP=mqtt.relayr.io", "IP:52.18.206.44", "OK",
+	"AT+NCTCP=52.18.206.44,8883", "CONNECT 0", "OK", "AT+SSLOPEN=0,relayr", "OK",
+	"ERROR: SOCKET FAILURE 0", "DISCONNECT 0", "ERROR", "Disassociation Event", "CONNECT 0 1 192.168.100.200 65535"
+};
+
+static const char* const Test_Literals[] = {
+	"OK", "ERROR: INVALID INPUT", "DISASSOCIATED", "ERROR: IP CONFIG FAIL", "ERROR: SOCKET FAILURE",
+	"ERROR", "APP Reset-APP SW Reset", "APP Reset External Flash FW-UP-SUCCESS", "DISCONNECT",
+	"Disassociation Event", "Out of StandBy-Alarm", "Out of StandBy-Timer", "UnExpected Warm Boot",
+	"Out of Deep Sleep", "Serial2WiFi APP", "CONNECT ", "CONNECT 0 1 192.168.100.200 65535", "AT+"
+};
+
+#define TEST_LITERALS			(sizeof(Test_Literals) / sizeof(Test_Literals[0]))
+
+static void Test_Classify(HOST_APP_MSG_ID_E (*classify)(const uint8_t*), const char* line, Test_Result_t* r){
+	nodeAssociationFlag = true;
+	nodeResetFlag = false;
+	tcpClientCid = 1;
+	udpClientCid = 2;
+
+	r->id = classify((const uint8_t *) line);
+	r->association = nodeAssociationFlag;
+	r->reset = nodeResetFlag;
+	r->tcpCid = tcpClientCid;
+	r->udpCid = udpClientCid;
+}
+
+/**
+*  @brief  Random line: literals, prefixes of literals, literals with one changed character and noise
+*/
+static void Test_RandomLine(char* line){
+	const char* lit;
+	int len = 0, n, i;
+
+	while ((len < TEST_LINE_MAX - 40) && (rand() % 4 != 0))
+	{
+		lit = Test_Literals[rand() % TEST_LITERALS];
+		n = strlen(lit);
+
+		switch (rand() % 5)
+		{
+		case 0 :			// whole literal
+			memcpy(&line[len], lit, n);
+			break;
+
+		case 1 :			// prefix
+			n = 1 + rand() % n;
+			memcpy(&line[len], lit, n);
+			break;
+
+		case 2 :			// one character changed
+			memcpy(&line[len], lit, n);
+			line[len + rand() % n] = 1 + rand() % 255;
+			break;
+
+		case 3 :			// noise (any character)
+			n = 1 + rand() % 12;
+			for (i = 0; i < n; i ++)
+				line[len + i] = 1 + rand() % 255;
+			break;
+
+		default :			// printable filler
+			n = 1 + rand() % 30;
+			for (i = 0; i < n; i ++)
+				line[len + i] = ' ' + rand() % 95;
+			break;
+		}
+		len += n;
+	}
+
+	line[len] = 0;
+}
+
+static bool Test_Same(const char* line){
+	Test_Result_t r, ref;
+
+	Test_Classify(AtLib_checkEOFMessage, line, &r);
+	Test_Classify(Ref_checkEOFMessage, line, &ref);
+
+	return memcmp(&r, &ref, sizeof(r)) == 0;
+}
+
+/** @brief Same return code and side effects as strstr chain for random lines and transcript */
+static void Test_Equivalence(){
+	char line[TEST_LINE_MAX + 1];
+	unsigned int i;
+	int bad = 0;
+
+	for (i = 0; i < sizeof(Test_Transcript) / sizeof(Test_Transcript[0]); i ++)
+		CHECK(Test_Same(Test_Transcript[i]));
+
+	for (i = 0; i < TEST_LITERALS; i ++)
+		CHECK(Test_Same(Test_Literals[i]));
+
+	for (i = 0; i < TEST_ROUNDS; i ++)
+	{
+		Test_RandomLine(line);
+		if (!Test_Same(line))
+		{
+			if (bad ++ == 0)
+				printf("  line \"%s\"\n", line);
+		}
+	}
+	CHECK(bad == 0);
+}
+
+
+// benchmark
+
+static uint64_t Bench_Ns(){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+*  @brief  Time per transcript line of both classifiers
+*/
+static void Bench_Transcript(){
+	const unsigned int lines = sizeof(Test_Transcript) / sizeof(Test_Transcript[0]);
+	volatile unsigned int sum = 0;
+	uint64_t start, ns, refNs;
+	unsigned int r, i;
+
+	start = Bench_Ns();
+	for (r = 0; r < BENCH_ROUNDS; r ++)
+		for (i = 0; i < lines; i ++)
+			sum += AtLib_checkEOFMessage((const uint8_t *) Test_Transcript[i]);
+	ns = Bench_Ns() - start;
+
+	start = Bench_Ns();
+	for (r = 0; r < BENCH_ROUNDS; r ++)
+		for (i = 0; i < lines; i ++)
+			sum += Ref_checkEOFMessage((const uint8_t *) Test_Transcript[i]);
+	refNs = Bench_Ns() - start;
+
+	printf("response line classifier: %.1f ns per line (strstr chain %.1f ns), %u lines\n",
+			(double) ns / (BENCH_ROUNDS * lines), (double) refNs / (BENCH_ROUNDS * lines), lines);
+}
+
+int main(){
+	srand(2015);
+
+	Test_Equivalence();
+	Bench_Transcript();
+
+	printf(Test_Failed ? "FAILED\n" : "PASSED\n");
+	return Test_Failed ? 1 : 0;
+}
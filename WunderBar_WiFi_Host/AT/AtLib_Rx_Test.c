@@ -0,0 +1,396 @@
+/** @file   AtLib_Rx_Test.c
+ *  @brief  Host fuzz test and benchmark of chunked AT receive parser (AtLib_ReceiveChunk, AtLib_ProcessRxChunk).
+ *
+ *  		Random streams of response lines, <Esc>O/F, <Esc>S data (with escaped
+ *  		ESC bytes), <Esc>Z bulk and <Esc>H http data are built together with the
+ *  		events they have to give: responses, data bytes of every connection
+ *  		and transfer complete events. Stream is read by the parser with UART
+ *  		reads of one byte (as before chunks), random sizes and whole chunks,
+ *  		while connection handler takes random parts of offered data (full
+ *  		buffer). Events and data have to be the same for every split.
+ *
+ *  		Benchmark gives parse time per byte of mqtt bulk stream, read in chunks
+ *  		and one byte per GS_HAL_recv call.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "GS/AT/AtCmdLib.c"
+
+
+// simulated environment
+
+#define TEST_STREAMS			300
+#define TEST_MESSAGES			200					// messages per stream
+#define SIM_STREAM_MAX			(512 * 1024)
+#define SIM_EVENTS_MAX			4096
+#define SIM_CIDS				4
+#define SIM_DATA_MAX			SIM_STREAM_MAX		// data bytes of one connection
+#define BENCH_PACKETS			2000
+#define BENCH_PACKET_SIZE		200
+
+typedef enum {
+	SIM_READ_BYTE = 0,								// one byte per UART read
+	SIM_READ_RANDOM,
+	SIM_READ_CHUNK,									// all available bytes up to chunk size
+	SIM_READ_COUNT
+} Sim_Read_t;
+
+typedef enum {
+	SIM_EVENT_RESPONSE = 0,
+	SIM_EVENT_BULK,
+	SIM_EVENT_HTTP
+} Sim_EventKind_t;
+
+typedef struct {
+	uint8_t  kind;
+	uint8_t  value;									// response id or cid
+	uint32_t data;									// data bytes of cid received before the event
+} Sim_Event_t;
+
+typedef struct {
+	Sim_Event_t events[SIM_EVENTS_MAX];
+	uint32_t    count;
+	uint8_t     data[SIM_CIDS][SIM_DATA_MAX];
+	uint32_t    dataLen[SIM_CIDS];
+} Sim_Log_t;
+
+static uint8_t  Sim_Stream[SIM_STREAM_MAX];
+static uint32_t Sim_Len;
+static uint32_t Sim_Pos;
+static Sim_Read_t Sim_Read;
+static bool     Sim_Partial;						// handler takes random part of data
+
+static Sim_Log_t Sim_Expected;
+static Sim_Log_t Sim_Actual;
+
+static int Test_Failed;
+
+#define CHECK(cond)		do { if (!(cond)) { printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); Test_Failed ++; } } while (0)
+
+unsigned long long int MSTimerGet(){ return 0; }
+unsigned long long int MSTimerDelta(unsigned long long int timer){ return 0; }
+void MSTimerDelay(unsigned long long int delay){}
+void GS_HAL_send(uint8_t* StrPtr, uint32_t Size){}
+
+unsigned int GS_HAL_recv(uint8_t* recvbyte, uint32_t Size, uint32_t block){
+	uint32_t len = Sim_Len - Sim_Pos;
+
+	if (len > Size)
+		len = Size;
+	if ((Sim_Read == SIM_READ_BYTE) && (len > 1))
+		len = 1;
+	else if ((Sim_Read == SIM_READ_RANDOM) && (len > 1))
+		len = 1 + rand() % len;
+
+	memcpy(recvbyte, &Sim_Stream[Sim_Pos], len);
+	Sim_Pos += len;
+	return len;
+}
+
+static void Sim_LogEvent(Sim_Log_t* log, uint8_t kind, uint8_t value){
+	Sim_Event_t* e = &log->events[log->count ++];
+
+	e->kind = kind;
+	e->value = value;
+	e->data = (kind == SIM_EVENT_RESPONSE) ? 0 : log->dataLen[value];
+}
+
+uint32_t App_ProcessIncomingData(uint8_t cid, const uint8_t *pData, uint32_t dataLen){
+	if (Sim_Partial && (rand() % 2))
+		dataLen = rand() % (dataLen + 1);
+
+	if ((cid < SIM_CIDS) && (Sim_Actual.dataLen[cid] + dataLen <= SIM_DATA_MAX))
+	{
+		memcpy(&Sim_Actual.data[cid][Sim_Actual.dataLen[cid]], pData, dataLen);
+		Sim_Actual.dataLen[cid] += dataLen;
+	}
+	return dataLen;
+}
+
+void App_ProcessCompletedBulkTransferEvent(uint8_t cid){
+	Sim_LogEvent(&Sim_Actual, SIM_EVENT_BULK, cid);
+}
+
+void App_ProcessCompletedHttpBulkTransferEvent(uint8_t cid){
+	Sim_LogEvent(&Sim_Actual, SIM_EVENT_HTTP, cid);
+}
+
+/**
+*  @brief  Reset receive state (module reset) and logs
+*/
+static void Sim_Reset(){
+	receive_state = HOST_APP_RX_STATE_START;
+	rxCursor = rxEnd = rxChunk;
+	rxStalled = 0;
+	MRBufferIndex = 0;
+	Sim_Pos = 0;
+	Sim_Actual.count = 0;
+	memset((void *) Sim_Actual.dataLen, 0, sizeof(Sim_Actual.dataLen));
+}
+
+
+// stream generator
+
+// lines which are classified, and lines which are not (no literal inside)
+static const char* const Gen_Responses[] = {
+	"OK", "ERROR", "ERROR: INVALID INPUT", "ERROR: SOCKET FAILURE 1", "DISCONNECT 2",
+	"Disassociation Event", "Out of Deep Sleep", "CONNECT 0 1 192.168.100.200 65535"
+};
+static const char* const Gen_Info[] = {
+	"IP:52.18.206.44", " 192.168.1.20: 255.255.255.0: 192.168.1.1", "CONNECT 0", "Mac Addr=00:1d:c9:01:02:03"
+};
+
+static void Gen_Put(const void* data, uint32_t len){
+	memcpy(&Sim_Stream[Sim_Len], data, len);
+	Sim_Len += len;
+}
+
+static void Gen_Data(uint8_t cid, const uint8_t* data, uint32_t len){
+	memcpy(&Sim_Expected.data[cid][Sim_Expected.dataLen[cid]], data, len);
+	Sim_Expected.dataLen[cid] += len;
+}
+
+/**
+*  @brief  Response line, sometimes after a line which is not classified
+*/
+static void Gen_Line(){
+	char line[HOST_APP_RX_CMD_MAX_SIZE];
+	const char* resp = Gen_Responses[rand() % (sizeof(Gen_Responses) / sizeof(Gen_Responses[0]))];
+	int len = 0;
+
+	// not classified line stays in receive buffer, next line is checked together with it
+	if (rand() % 4 == 0)
+		len = sprintf(line, "%s\r\n", Gen_Info[rand() % (sizeof(Gen_Info) / sizeof(Gen_Info[0]))]);
+
+	len += sprintf(&line[len], "%s\r", resp);
+	Gen_Put(line, len);
+	Gen_Put("\n", 1);
+
+	Sim_LogEvent(&Sim_Expected, SIM_EVENT_RESPONSE, AtLib_checkEOFMessage((const uint8_t *) line));
+}
+
+/**
+*  @brief  <Esc>S data <Esc>E, ESC inside of data is followed by other byte than E
+*/
+static void Gen_NormalData(uint8_t cid){
+	uint8_t data[600];
+	uint32_t len = rand() % sizeof(data), i;
+	uint8_t head[3] = { HOST_APP_ESC_CHAR, 'S', '0' + cid };
+	uint8_t tail[2] = { HOST_APP_ESC_CHAR, 'E' };
+
+	for (i = 0; i < len; i ++)
+	{
+		data[i] = (rand() % 16) ? rand() : HOST_APP_ESC_CHAR;
+		if ((i > 0) && (data[i - 1] == HOST_APP_ESC_CHAR) && ((data[i] == 'E') || (data[i] == HOST_APP_ESC_CHAR)))
+			data[i] = 'e';
+	}
+	if ((len > 0) && (data[len - 1] == HOST_APP_ESC_CHAR))
+		data[len - 1] = 'x';
+
+	Gen_Put(head, sizeof(head));
+	Gen_Put(data, len);
+	Gen_Put(tail, sizeof(tail));
+	Gen_Data(cid, data, len);
+	Sim_LogEvent(&Sim_Expected, SIM_EVENT_BULK, cid);		// <Esc>E completes transfer too
+}
+
+/**
+*  @brief  <Esc>Z or <Esc>H, 4 digit length and data (any bytes)
+*/
+static void Gen_BulkData(uint8_t cid, bool http){
+	uint8_t data[HOST_APP_BULK_DATA_MAX_SIZE];
+	uint32_t len = (rand() % 8) ? rand() % sizeof(data) : 0, i;
+	char head[8];
+
+	for (i = 0; i < len; i ++)
+		data[i] = rand();
+
+	sprintf(head, "\x1b%c%c%04u", http ? 'H' : 'Z', '0' + cid, (unsigned int) len);
+	Gen_Put(head, 7);
+	Gen_Put(data, len);
+	Gen_Data(cid, data, len);
+	Sim_LogEvent(&Sim_Expected, http ? SIM_EVENT_HTTP : SIM_EVENT_BULK, cid);
+}
+
+static void Gen_Stream(){
+	int m;
+
+	Sim_Len = 0;
+	Sim_Expected.count = 0;
+	memset((void *) Sim_Expected.dataLen, 0, sizeof(Sim_Expected.dataLen));
+
+	for (m = 0; m < TEST_MESSAGES; m ++)
+	{
+		switch (rand() % 6)
+		{
+		case 0 :
+			Gen_Line();
+			break;
+
+		case 1 :
+			Gen_Put((rand() % 2) ? "\x1bO" : "\x1b" "F", 2);
+			Sim_LogEvent(&Sim_Expected, SIM_EVENT_RESPONSE,
+					(Sim_Stream[Sim_Len - 1] == 'O') ? HOST_APP_MSG_ID_ESC_CMD_OK : HOST_APP_MSG_ID_ESC_CMD_FAIL);
+			break;
+
+		case 2 :
+			Gen_NormalData(rand() % SIM_CIDS);
+			break;
+
+		case 3 :
+			Gen_BulkData(rand() % SIM_CIDS, true);
+			break;
+
+		default :
+			Gen_BulkData(rand() % SIM_CIDS, false);
+			break;
+		}
+	}
+}
+
+
+// test
+
+/**
+*  @brief  Parse stream, responses are logged as they are returned
+*
+*  @return true if whole stream is parsed
+*/
+static bool Test_Parse(){
+	HOST_APP_MSG_ID_E id;
+	uint32_t calls = 0;
+
+	Sim_Reset();
+
+	while ((Sim_Pos < Sim_Len) || (rxCursor < rxEnd))
+	{
+		if (calls ++ > 100 * SIM_STREAM_MAX)
+			return false;
+
+		if ((id = AtLib_ReceiveChunk(NULL)) != HOST_APP_MSG_ID_NONE)
+			Sim_LogEvent(&Sim_Actual, SIM_EVENT_RESPONSE, id);
+	}
+
+	return true;
+}
+
+static bool Test_Same(){
+	int cid;
+
+	if ((Sim_Actual.count != Sim_Expected.count) ||
+			(memcmp(Sim_Actual.events, Sim_Expected.events, Sim_Expected.count * sizeof(Sim_Event_t)) != 0))
+		return false;
+
+	for (cid = 0; cid < SIM_CIDS; cid ++)
+	{
+		if ((Sim_Actual.dataLen[cid] != Sim_Expected.dataLen[cid]) ||
+				(memcmp(Sim_Actual.data[cid], Sim_Expected.data[cid], Sim_Expected.dataLen[cid]) != 0))
+			return false;
+	}
+	return true;
+}
+
+/** @brief Same events and data for every split of the stream and every handler fill */
+static void Test_Streams(){
+	static const char* const reads[SIM_READ_COUNT] = { "byte", "random", "chunk" };
+	int s, bad[SIM_READ_COUNT][2];
+	int r, p;
+
+	memset(bad, 0, sizeof(bad));
+
+	for (s = 0; s < TEST_STREAMS; s ++)
+	{
+		Gen_Stream();
+
+		for (r = 0; r < SIM_READ_COUNT; r ++)
+		{
+			for (p = 0; p < 2; p ++)
+			{
+				Sim_Read = r;
+				Sim_Partial = p;
+
+				if (!Test_Parse() || !Test_Same())
+				{
+					if (bad[r][p] ++ == 0)
+						printf("  stream %d, %s reads%s: %u events (%u expected)\n", s, reads[r],
+								p ? ", partial handler" : "", Sim_Actual.count, Sim_Expected.count);
+				}
+			}
+		}
+	}
+
+	for (r = 0; r < SIM_READ_COUNT; r ++)
+	{
+		CHECK(bad[r][0] == 0);
+		CHECK(bad[r][1] == 0);
+	}
+}
+
+
+// benchmark
+
+static uint64_t Bench_Ns(){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+*  @brief  Parse time per byte of mqtt packets in bulk transfers
+*
+*  One byte per GS_HAL_recv call is the way receive path read the UART before chunks.
+*/
+static void Bench_Bulk(){
+	uint8_t data[BENCH_PACKET_SIZE], b;
+	uint64_t start, ns, byteNs;
+	char head[8];
+	int i;
+
+	Sim_Len = 0;
+	for (i = 0; i < BENCH_PACKETS; i ++)
+	{
+		memset(data, i, sizeof(data));
+		sprintf(head, "\x1bZ%c%04u", '0' + i % SIM_CIDS, (unsigned int) sizeof(data));
+		Gen_Put(head, 7);
+		Gen_Put(data, sizeof(data));
+	}
+	Sim_Partial = false;
+
+	Sim_Read = SIM_READ_CHUNK;
+	Sim_Reset();
+	start = Bench_Ns();
+	AtLib_ReceiveDataHandle();
+	ns = Bench_Ns() - start;
+	CHECK(Sim_Actual.count == BENCH_PACKETS);
+
+	Sim_Read = SIM_READ_BYTE;
+	Sim_Reset();
+	start = Bench_Ns();
+	while (GS_HAL_recv(&b, 1, 0))
+		AtLib_ReceiveDataProcess(b);
+	byteNs = Bench_Ns() - start;
+	CHECK(Sim_Actual.count == BENCH_PACKETS);
+
+	printf("bulk receive: %.2f ns per byte in chunks (%.2f ns one byte per read), %u bytes\n",
+			(double) ns / Sim_Len, (double) byteNs / Sim_Len, Sim_Len);
+}
+
+int main(){
+	srand(2015);
+
+	Test_Streams();
+	Bench_Bulk();
+
+	printf(Test_Failed ? "FAILED\n" : "PASSED\n");
+	return Test_Failed ? 1 : 0;
+}
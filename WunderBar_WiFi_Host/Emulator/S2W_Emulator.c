@@ -0,0 +1,700 @@
+/** @file   S2W_Emulator.c
+ *  @brief  Host run of the firmware against emulated S2W module, network and relayr servers.
+ *
+ *  		Board boots with factory configuration and certificate, downloads the
+ *  		certificate of the broker, resets and connects. Scenario then measures
+ *  		sustained publish rate, queueing under segment loss, reconnect after
+ *  		server disconnect and socket failure, handling of asynchronous CONNECT
+ *  		and DISCONNECT lines of other connections and <Esc>O / <Esc>F replies
+ *  		of data frames.
+ *
+ *  		Board uart traffic up to the framing tests is written into capture
+ *  		file (UART.c format), which UART_Replay plays back.
+ *
+ *  		usage: S2W_Emulator [capture file]
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <hardware/Hw_modules.h>
+#include <Common_Defaults.h>
+#include "GS/API/GS_API.h"
+#include "GS/AT/AtCmdLib.h"
+#include "GS/GS_User/GS_TCP_mqtt.h"
+#include "GS/GS_User/GS_User.h"
+#include "MQTT/MQTT_Api_Client/MQTT_Api.h"
+#include "MQTT/MQTT_Api_Client/MQTT_MsgService.h"
+#include "MQTT/MQTT_paho/MQTTPacket.h"
+#include "Scheduler/Scheduler.h"
+#include "Sensors/Sensors_Spool.h"
+
+#include "../Sim/Sim.h"
+#include "S2W_Emulator.h"
+
+
+#define SCN_TIME_LIMIT			900					// virtual seconds for the whole run
+#define SCN_CAPTURE_FILE		"build/S2W_Emulator.cap"
+
+#define SCN_CONNECT_TIMEOUT		120000000			// first connection (certificate download and reset)
+#define SCN_WARMUP_US			2000000
+#define SCN_STEADY_US			30000000
+#define SCN_LOSS_US				20000000
+#define SCN_LOSS_PERMILLE		100
+#define SCN_OUTAGE_US			5000000				// servers unreachable after disconnect
+#define SCN_RECONNECT_TIMEOUT	90000000
+#define SCN_REPLAY_TIMEOUT		60000000
+#define SCN_SETTLE_US			1000000				// wait for answers of injected traffic
+
+#define SCN_BULK_PAYLOAD		2990				// publish split into three bulk frames
+#define SCN_PUBLISH_ID			77
+#define SCN_BURST_PACKETS		(3 * MQTT_RX_PACKETS)	// pings in one bulk frame
+#define SCN_ESC_UP				1600				// escape round trip payload, split into two bulk frames
+#define SCN_ESC_DOWN			600
+#define SCN_ESC_SPACING			37					// bytes between inserted escape sequences
+#define SCN_ESC_TIMEOUT_US		5000000
+
+typedef enum {
+	SCN_CERT = 0,			// first connection
+	SCN_WARMUP,
+	SCN_STEADY,				// sustained publish rate
+	SCN_LOSS,				// segment loss
+	SCN_OUTAGE,				// broker drops connection, servers unreachable for a while
+	SCN_REPLAY,				// spooled readings are published
+	SCN_SOCKFAIL,			// segments are lost until socket fails
+	SCN_FOREIGN,			// CONNECT and DISCONNECT of a tcp server client
+	SCN_FRAMING,			// <Esc>S, bulk and <Esc>F frames, packet burst
+	SCN_DONE
+} Scn_Phase_t;
+
+typedef struct {
+	Scn_Phase_t phase;
+	uint8_t     step;
+	uint64_t    phaseStart;
+	uint64_t    stepStart;
+	int         failed;
+
+	// counters at start of phase
+	Emu_BrokerStats_t broker;
+	Emu_NetStats_t    net;
+	Emu_ModuleStats_t module;
+	uint32_t    rxPackets;
+	uint32_t    rxDropped;
+	uint32_t    rxStalls;
+	int         cids[2];
+
+	// results
+	uint64_t    firstConnect;
+	uint32_t    boots;
+	GS_Reconnect_Stats_t firstStats;
+	double      steadyRate;
+	uint32_t    steadyPublishes;
+	uint32_t    steadyFrames;				// <Esc>Z frames (one AT round trip each)
+	uint32_t    steadyCommands;
+	double      lossRate;
+	uint32_t    lossRetransmits;
+	uint32_t    lossBulkFail;
+	uint32_t    lossConnects;
+	MQTT_Msg_ArenaStats_t lossArena;
+	Sensors_Spool_Stats_t lossSpool;
+	uint64_t    outageReconnect;			// from server disconnect to connack
+	GS_Reconnect_Stats_t outageStats;
+	uint32_t    replayStored;
+	uint32_t    replayReplayed;
+	uint64_t    failDetect;
+	uint64_t    failReconnect;
+	uint32_t    failFailures;
+	uint32_t    failBulkFail;
+	GS_Reconnect_Stats_t failStats;
+	uint32_t    foreignPublishes;
+	uint32_t    captureBytes;
+
+	// last packet taken by mqtt client
+	uint8_t     rxPacket[MQTT_RX_RING_SIZE];
+	int         rxPacketLen;
+} Scn_t;
+
+static Scn_t*      Scn;
+static const char* Scn_CaptureFile = SCN_CAPTURE_FILE;
+
+#define CHECK(cond)		do { if (!(cond)) { printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); Scn->failed ++; } } while (0)
+
+
+// static declarations
+
+static void Scn_Poll();
+static void Scn_Advance(uint64_t now);
+static bool Scn_Up();
+static void Scn_Enter(Scn_Phase_t phase);
+static void Scn_Step();
+static uint64_t Scn_PhaseTime();
+static uint64_t Scn_StepTime();
+static bool Scn_Timeout(uint64_t limit);
+static void Scn_Framing();
+static void Scn_EscPayload(uint8_t* payload, int len, bool escE);
+static bool Scn_EscDown(const uint8_t* payload, int len);
+static void Scn_Report();
+
+static const Sim_Hooks_t Scn_Hooks = {
+	.Boot    = Emu_ModuleReset,
+	.Poll    = Scn_Poll,
+	.Advance = Scn_Advance,
+};
+
+
+
+
+	///////////////////////////////////////
+	/*         public functions          */
+	///////////////////////////////////////
+
+
+
+int main(int argc, char* argv[]){
+	int status;
+
+	if (argc > 1)
+		Scn_CaptureFile = argv[1];
+
+	Sim_Init(SCN_TIME_LIMIT);
+	Sim_FactoryFlash();
+	Emu_ModuleInit();
+	Emu_NetInit();
+	Scn = Sim_SharedAlloc(sizeof(Scn_t));
+
+	Emu_CaptureStart();
+	status = Sim_Run(&Scn_Hooks);
+
+	printf("%s\n", (status == 0) ? "PASSED" : "FAILED");
+	return status;
+}
+
+// packet taken by mqtt client is kept for escape round trip check
+bool __real_GS_TCP_mqtt_GetPacket(char** packet, int* len);
+
+bool __wrap_GS_TCP_mqtt_GetPacket(char** packet, int* len){
+	bool result = __real_GS_TCP_mqtt_GetPacket(packet, len);
+
+	if (result && (*len <= (int) sizeof(Scn->rxPacket)))
+	{
+		memcpy(Scn->rxPacket, *packet, *len);
+		Scn->rxPacketLen = *len;
+	}
+	return result;
+}
+
+
+
+
+	///////////////////////////////////////
+	/*         static functions          */
+	///////////////////////////////////////
+
+
+
+/**
+ *  @brief  Drive scenario, called from main loop of the firmware
+ *
+ *  Only reads virtual time, so firmware runs the same with capture replay.
+ *
+ *  @return void
+ */
+static void Scn_Poll(){
+	Emu_BrokerStats_t broker;
+	Emu_NetStats_t net;
+	Emu_ModuleStats_t module;
+	Sensors_Spool_Stats_t spool;
+	uint64_t now = Sim_Now();
+	char line[64];
+	int cid;
+
+	Emu_BrokerGetStats(&broker);
+	Emu_NetGetStats(&net);
+	Emu_ModuleGetStats(&module);
+
+	switch (Scn->phase)
+	{
+	case SCN_CERT:
+		if (Scn_Up())
+		{
+			Scn->firstConnect = now;
+			Scn->boots = Sim_Boots();
+			GS_User_GetReconnectStats(&Scn->firstStats);
+			CHECK(Scn->boots == 2);					// reset after certificate download
+			Scn_Enter(SCN_WARMUP);
+		}
+		else if (Scn_Timeout(SCN_CONNECT_TIMEOUT))
+			Scn_Enter(SCN_DONE);
+		break;
+
+	case SCN_WARMUP:
+		if (Scn_PhaseTime() >= SCN_WARMUP_US)
+			Scn_Enter(SCN_STEADY);
+		break;
+
+	case SCN_STEADY:
+		if (Scn_PhaseTime() >= SCN_STEADY_US)
+		{
+			Scn->steadyPublishes = broker.publishes - Scn->broker.publishes;
+			Scn->steadyFrames = module.bulkOk + module.bulkFail - Scn->module.bulkOk - Scn->module.bulkFail;
+			Scn->steadyCommands = module.commands - Scn->module.commands;
+			Scn->steadyRate = Scn->steadyPublishes * 1e6 / SCN_STEADY_US;
+			CHECK(broker.connects == Scn->broker.connects);
+			CHECK(Scn->steadyRate > 0);
+			CHECK(Scn->steadyFrames < Scn->steadyPublishes);		// publishes are batched
+
+			Emu_NetSetLoss(SCN_LOSS_PERMILLE);
+			Scn_Enter(SCN_LOSS);
+		}
+		break;
+
+	case SCN_LOSS:
+		if (Scn_PhaseTime() >= SCN_LOSS_US)
+		{
+			Emu_NetSetLoss(0);
+			Scn->lossRate = (broker.publishes - Scn->broker.publishes) * 1e6 / SCN_LOSS_US;
+			Scn->lossRetransmits = net.retransmits - Scn->net.retransmits;
+			Scn->lossBulkFail = module.bulkFail - Scn->module.bulkFail;
+			Scn->lossConnects = broker.connects - Scn->broker.connects;
+			MQTT_Msg_GetArenaStats(&Scn->lossArena);
+			Sensors_Spool_GetStats(&Scn->lossSpool);
+			CHECK(Scn->lossRetransmits > 0);
+
+			Scn_Enter(SCN_OUTAGE);
+		}
+		break;
+
+	case SCN_OUTAGE:
+		if (Scn->step == 0)
+		{
+			// wait until data of loss phase is delivered
+			if (!Scn_Up())
+				break;
+			cid = Emu_ModuleFindCid(EMU_SERVER_MQTT);
+			CHECK(cid >= 0);
+			Emu_NetSetReachable(false);
+			Emu_NetDrop(cid);
+			Scn->outageReconnect = now;
+			Scn_Step();
+		}
+		else if (Scn->step == 1)
+		{
+			if (Scn_StepTime() >= SCN_OUTAGE_US)
+			{
+				Emu_NetSetReachable(true);
+				Scn_Step();
+			}
+		}
+		else if ((broker.connects > Scn->broker.connects) && Scn_Up())
+		{
+			Scn->outageReconnect = now - Scn->outageReconnect;
+			GS_User_GetReconnectStats(&Scn->outageStats);
+			CHECK(Scn->outageStats.connectTime > 0);
+			Scn_Enter(SCN_REPLAY);
+		}
+		else if (Scn_Timeout(SCN_RECONNECT_TIMEOUT))
+			Scn_Enter(SCN_DONE);
+		break;
+
+	case SCN_REPLAY:
+		Sensors_Spool_GetStats(&spool);
+		if ((spool.pending == 0) && (Scn_PhaseTime() >= SCN_SETTLE_US))
+		{
+			Scn->replayStored = spool.stored;
+			Scn->replayReplayed = spool.replayed;
+			CHECK(spool.stored > 0);
+			CHECK(spool.replayed == spool.stored - spool.dropped);
+			Scn_Enter(SCN_SOCKFAIL);
+		}
+		else if (Scn_Timeout(SCN_REPLAY_TIMEOUT))
+			Scn_Enter(SCN_DONE);
+		break;
+
+	case SCN_SOCKFAIL:
+		if (Scn->step == 0)
+		{
+			// segments are lost, socket is not closed by server
+			Emu_NetSetReachable(false);
+			Scn_Step();
+		}
+		else if (Scn->step == 1)
+		{
+			if (!MQTT_Get_RunnigStatus())
+			{
+				Scn->failDetect = now - Scn->phaseStart;
+				Emu_NetSetReachable(true);
+				Scn_Step();
+			}
+			else if (Scn_Timeout(SCN_RECONNECT_TIMEOUT))
+				Scn_Enter(SCN_DONE);
+		}
+		else if ((broker.connects > Scn->broker.connects) && Scn_Up())
+		{
+			Scn->failReconnect = now - Scn->phaseStart;
+			Scn->failFailures = net.failures - Scn->net.failures;
+			Scn->failBulkFail = module.bulkFail - Scn->module.bulkFail;
+			GS_User_GetReconnectStats(&Scn->failStats);
+			CHECK(Scn->failFailures + Scn->failBulkFail > 0);
+			Scn_Enter(SCN_FOREIGN);
+		}
+		else if (Scn_Timeout(SCN_RECONNECT_TIMEOUT))
+			Scn_Enter(SCN_DONE);
+		break;
+
+	case SCN_FOREIGN:
+		if (Scn->step == 0)
+		{
+			// client connects to tcp server of the module
+			Scn->cids[0] = Emu_ModuleOpenForeign();
+			Scn->cids[1] = Emu_ModuleOpenForeign();
+			sprintf(line, "CONNECT %X %X 192.168.1.23 51234", Scn->cids[0], Scn->cids[1]);
+			Emu_ModuleAsyncLine(line);
+			Scn_Step();
+		}
+		else if ((Scn->step == 1) && Emu_ModuleAsyncDone() && (Scn_StepTime() >= SCN_SETTLE_US))
+		{
+			Emu_ModuleCloseForeign(Scn->cids[1]);
+			sprintf(line, "DISCONNECT %X", Scn->cids[1]);
+			Emu_ModuleAsyncLine(line);
+			Scn_Step();
+		}
+		else if ((Scn->step == 2) && Emu_ModuleAsyncDone() && (Scn_StepTime() >= SCN_SETTLE_US))
+		{
+			Emu_ModuleCloseForeign(Scn->cids[0]);
+			Scn->foreignPublishes = broker.publishes - Scn->broker.publishes;
+			CHECK(broker.connects == Scn->broker.connects);
+			CHECK(Scn_Up());
+			CHECK(Scn->foreignPublishes > 0);
+
+			Scn->captureBytes = Emu_CaptureStop(Scn_CaptureFile);
+			CHECK(Scn->captureBytes > 0);
+			Scn_Enter(SCN_FRAMING);
+		}
+		break;
+
+	case SCN_FRAMING:
+		Scn_Framing();
+		break;
+
+	case SCN_DONE:
+		Scn_Report();
+		Sim_Exit(Scn->failed ? 1 : 0);
+		break;
+	}
+}
+
+static void Scn_Advance(uint64_t now){
+	Emu_NetAdvance(now);
+	Emu_ModuleAdvance(now);
+}
+
+/**
+ *  @brief  Check if mqtt session is running on both sides
+ *
+ *  @return True if firmware runs mqtt and broker has sent connack
+ */
+static bool Scn_Up(){
+	return MQTT_Get_RunnigStatus() && Emu_BrokerConnected();
+}
+
+/**
+ *  @brief  Start scenario phase, counters are taken as its base
+ *
+ *  @param  Phase
+ *
+ *  @return void
+ */
+static void Scn_Enter(Scn_Phase_t phase){
+	Scn->phase = phase;
+	Scn->step = 0;
+	Scn->phaseStart = Sim_Now();
+	Scn->stepStart = Scn->phaseStart;
+
+	Emu_BrokerGetStats(&Scn->broker);
+	Emu_NetGetStats(&Scn->net);
+	Emu_ModuleGetStats(&Scn->module);
+	GS_TCP_mqtt_GetRxStats(&Scn->rxPackets, &(uint32_t) { 0 }, &(uint32_t) { 0 });
+}
+
+static void Scn_Step(){
+	Scn->step ++;
+	Scn->stepStart = Sim_Now();
+}
+
+static uint64_t Scn_PhaseTime(){
+	return Sim_Now() - Scn->phaseStart;
+}
+
+static uint64_t Scn_StepTime(){
+	return Sim_Now() - Scn->stepStart;
+}
+
+/**
+ *  @brief  Fail the phase if it takes too long
+ *
+ *  @param  Phase time limit (us)
+ *
+ *  @return True if limit is reached
+ */
+static bool Scn_Timeout(uint64_t limit){
+	if (Scn_PhaseTime() < limit)
+		return false;
+
+	printf("  FAIL phase %d step %d timed out after %llu s\n", Scn->phase, Scn->step,
+			(unsigned long long) (limit / 1000000));
+	Scn->failed ++;
+	return true;
+}
+
+/**
+ *  @brief  Send frames directly through AT library and check replies of the module
+ *
+ *  <Esc>S frame up and down, bulk frame longer than one module transfer,
+ *  data frame on connection without server (<Esc>F), packet burst and
+ *  round trip of payloads with escape characters.
+ *
+ *  @return void
+ */
+static void Scn_Framing(){
+	static uint8_t packet[SCN_BULK_PAYLOAD + 64];
+	static const uint8_t ping[] = { PINGREQ << 4, 0 };
+	static const uint8_t pingResp[] = { PINGRESP << 4, 0 };
+	static const uint8_t payload[] = { '{', 0x1B, 'Z', '}' };		// escape character in <Esc>S data
+	static uint8_t escape[SCN_ESC_UP];
+	MQTTString topic = MQTTString_initializer;
+	Emu_BrokerStats_t broker;
+	Emu_ModuleStats_t module;
+	uint8_t cid = GS_TCP_mqtt_GetClientCID();
+	uint32_t packets, dropped, stalls;
+	int len, other, i;
+	bool ok;
+
+	Emu_BrokerGetStats(&broker);
+	Emu_ModuleGetStats(&module);
+	GS_TCP_mqtt_GetRxStats(&packets, &dropped, &stalls);
+
+	if ((Scn->step != 0) && (Scn_StepTime() < SCN_SETTLE_US))
+		return;
+
+	switch (Scn->step)
+	{
+	case 0:
+		printf("framing\n");
+		CHECK(AtLib_SendTcpData("0123456789ABCDEF"[cid & 0x0F], ping, sizeof(ping)));
+		Scn_Step();
+		break;
+
+	case 1:
+		CHECK(broker.pings == Scn->broker.pings + 1);
+		printf("  <Esc>S up       %s\n", (broker.pings == Scn->broker.pings + 1) ? "<Esc>O, ping delivered" : "not delivered");
+
+		Emu_ModuleNextDataNormal();
+		CHECK(Emu_BrokerPublish("/v1/nobody/x", payload, sizeof(payload), SCN_PUBLISH_ID));
+		CHECK(Emu_BrokerSendPacket(pingResp, sizeof(pingResp)));
+		Scn->rxPackets = packets;
+		Scn_Step();
+		break;
+
+	case 2:
+		CHECK(broker.lastPubackId == SCN_PUBLISH_ID);
+		CHECK(packets == Scn->rxPackets + 2);
+		printf("  <Esc>S down     %u packets decoded, puback %d\n", packets - Scn->rxPackets, broker.lastPubackId);
+
+		topic.cstring = "/v1/" SIM_DEVICE_ID "/bulk";
+		memset(packet, 'x', sizeof(packet));
+		len = MQTTSerialize_publish((char*) packet, sizeof(packet), 0, 0, 0, 0, topic, (char*) packet, SCN_BULK_PAYLOAD);
+		Scn->module = module;
+		CHECK(GS_API_SendTcpData(cid, packet, len));
+		Emu_ModuleGetStats(&module);
+		CHECK(module.bulkOk == Scn->module.bulkOk + (len + HOST_APP_BULK_DATA_MAX_SIZE - 1) / HOST_APP_BULK_DATA_MAX_SIZE);
+		printf("  bulk            %d bytes in %u frames\n", len, module.bulkOk - Scn->module.bulkOk);
+		Scn_Step();
+		break;
+
+	case 3:
+		CHECK(broker.maxPublishLen == SCN_BULK_PAYLOAD);
+
+		// connection of a client which is not on the network
+		Scn->module = module;
+		other = Emu_ModuleOpenForeign();
+		CHECK(!GS_API_SendTcpData(other, (uint8_t*) ping, sizeof(ping)));
+		Emu_ModuleCloseForeign(other);
+		Emu_ModuleGetStats(&module);
+		CHECK(module.bulkFail == Scn->module.bulkFail + 1);
+		printf("  bulk on cid %d   %s\n", other, (module.bulkFail == Scn->module.bulkFail + 1) ? "<Esc>F, send failed" : "no <Esc>F");
+
+		// more packets in one bulk frame than incoming packet queue holds
+		for (i = 0; i < SCN_BURST_PACKETS; i ++)
+			memcpy(&packet[i * sizeof(pingResp)], pingResp, sizeof(pingResp));
+		CHECK(Emu_BrokerSendPacket(packet, SCN_BURST_PACKETS * sizeof(pingResp)));
+		Scn->rxPackets = packets;
+		Scn->rxDropped = dropped;
+		Scn->rxStalls = stalls;
+		Scn_Step();
+		break;
+
+	case 4:
+		CHECK(packets == Scn->rxPackets + SCN_BURST_PACKETS);
+		CHECK(dropped == Scn->rxDropped);
+		printf("  burst           %u of %d packets decoded, %u dropped, %u stalls\n", packets - Scn->rxPackets,
+				SCN_BURST_PACKETS, dropped - Scn->rxDropped, stalls - Scn->rxStalls);
+		Scn_Step();
+		break;
+
+	case 5:
+		// escape characters up, in bulk frames
+		topic.cstring = "/v1/" SIM_DEVICE_ID "/esc";
+		Emu_BrokerWatch(topic.cstring);
+		Scn_EscPayload(escape, SCN_ESC_UP, true);
+		len = MQTTSerialize_publish((char*) packet, sizeof(packet), 0, 0, 0, 0, topic, (char*) escape, SCN_ESC_UP);
+		CHECK(GS_API_SendTcpData(cid, packet, len));
+		Scn_Step();
+		break;
+
+	case 6:
+		len = Emu_BrokerWatched(packet, sizeof(packet));
+		if ((len < 0) && (Scn_StepTime() < SCN_ESC_TIMEOUT_US))
+			break;
+		ok = (len == SCN_ESC_UP) && (memcmp(packet, escape, SCN_ESC_UP) == 0);
+		CHECK(ok);
+		printf("  0x1b up         %d bytes in bulk frames %s\n", SCN_ESC_UP, ok ? "unchanged" : "changed");
+
+		// and down, in bulk frame
+		Scn_EscPayload(escape, SCN_ESC_DOWN, true);
+		CHECK(Emu_BrokerPublish("/v1/nobody/esc", escape, SCN_ESC_DOWN, SCN_PUBLISH_ID + 1));
+		Scn_Step();
+		break;
+
+	case 7:
+	case 8:
+		if ((broker.lastPubackId != SCN_PUBLISH_ID + Scn->step - 6) && (Scn_StepTime() < SCN_ESC_TIMEOUT_US))
+			break;
+		ok = Scn_EscDown(escape, SCN_ESC_DOWN);
+		CHECK(broker.lastPubackId == SCN_PUBLISH_ID + Scn->step - 6);
+		CHECK(ok);
+		printf("  0x1b down       %d bytes in %s frame %s\n", SCN_ESC_DOWN, (Scn->step == 7) ? "bulk" : "<Esc>S",
+				ok ? "unchanged" : "changed");
+
+		if (Scn->step == 7)
+		{
+			// and down, in <Esc>S frame which ends at <Esc>E
+			Scn_EscPayload(escape, SCN_ESC_DOWN, false);
+			Emu_ModuleNextDataNormal();
+			CHECK(Emu_BrokerPublish("/v1/nobody/esc", escape, SCN_ESC_DOWN, SCN_PUBLISH_ID + 2));
+		}
+		Scn_Step();
+		break;
+
+	default:
+		CHECK(broker.connects == Scn->broker.connects);
+		CHECK(Scn_Up());
+		Scn_Enter(SCN_DONE);
+		break;
+	}
+}
+
+/**
+ *  @brief  Payload with every byte value and escape sequences of data frames
+ *
+ *  @param  Buffer for payload
+ *  @param  Payload length
+ *  @param  Include <Esc>E (not for <Esc>S frames, it ends the frame)
+ *
+ *  @return void
+ */
+static void Scn_EscPayload(uint8_t* payload, int len, bool escE){
+	static const char follow[] = "ZSOFHE";
+	int i;
+
+	for (i = 0; i < len; i ++)
+		payload[i] = (uint8_t) i;
+
+	for (i = 0; i + 1 < len; i += SCN_ESC_SPACING)
+	{
+		payload[i] = 0x1B;
+		payload[i + 1] = follow[(i / SCN_ESC_SPACING) % (escE ? 6 : 5)];
+	}
+}
+
+/**
+ *  @brief  Check last packet taken by mqtt client against publish sent by broker
+ *
+ *  @param  Payload
+ *  @param  Payload length
+ *
+ *  @return True if packet carries the payload unchanged
+ */
+static bool Scn_EscDown(const uint8_t* payload, int len){
+	int dup, qos, retained, id, plen;
+	MQTTString topic;
+	uint8_t* data;
+
+	if (MQTTDeserialize_publish(&dup, &qos, &retained, &id, &topic, (char**) &data, &plen,
+			(char*) Scn->rxPacket, Scn->rxPacketLen) != 1)
+		return false;
+
+	return (plen == len) && (memcmp(data, payload, len) == 0);
+}
+
+/**
+ *  @brief  Print results of the scenario
+ *
+ *  @return void
+ */
+static void Scn_Report(){
+	Emu_BrokerStats_t broker;
+	Emu_NetStats_t net;
+	Emu_ModuleStats_t module;
+	Sensors_Spool_Stats_t spool;
+	Sim_BleStats_t ble;
+	const Sched_Stats_t* sched = Sched_GetStats();
+	const ATLIB_CMD_STATS_T* cmd;
+	uint8_t i, n;
+
+	Emu_BrokerGetStats(&broker);
+	Emu_NetGetStats(&net);
+	Emu_ModuleGetStats(&module);
+	Sensors_Spool_GetStats(&spool);
+	Sim_BleGetStats(&ble);
+
+	printf("connect          %.2f s after power on, %u boots (certificate download), firmware %u ms\n",
+			Scn->firstConnect / 1e6, Scn->boots, Scn->firstStats.connectTime);
+	printf("steady           %.1f publishes/s\n", Scn->steadyRate);
+	printf("  round trips    %.1f <Esc>Z frames, %.1f AT commands per 100 publishes (100 frames without batching)\n",
+			Scn->steadyFrames * 100.0 / Scn->steadyPublishes, Scn->steadyCommands * 100.0 / Scn->steadyPublishes);
+	printf("loss %u%%         %.1f publishes/s, %u retransmits, %u <Esc>F, %u reconnects\n",
+			SCN_LOSS_PERMILLE / 10, Scn->lossRate, Scn->lossRetransmits, Scn->lossBulkFail, Scn->lossConnects);
+	printf("  arena          used %u/%u high water %u compactions %u failed %u\n",
+			Scn->lossArena.used, Scn->lossArena.size, Scn->lossArena.highWater, Scn->lossArena.compactions, Scn->lossArena.failed);
+	printf("  spool          stored %u replayed %u pending %u dropped %u\n",
+			Scn->lossSpool.stored, Scn->lossSpool.replayed, Scn->lossSpool.pending, Scn->lossSpool.dropped);
+	printf("outage           reconnect %.2f s (servers down %.1f s), firmware %u ms, fast %u full %u\n",
+			Scn->outageReconnect / 1e6, SCN_OUTAGE_US / 1e6, Scn->outageStats.connectTime,
+			Scn->outageStats.fastReconnects, Scn->outageStats.fullReconnects);
+	printf("  spool          stored %u replayed %u\n", Scn->replayStored, Scn->replayReplayed);
+	printf("socket failure   detected %.2f s, reconnect %.2f s, %u socket failures, %u <Esc>F, firmware %u ms\n",
+			Scn->failDetect / 1e6, Scn->failReconnect / 1e6, Scn->failFailures, Scn->failBulkFail, Scn->failStats.connectTime);
+	printf("foreign client   CONNECT/DISCONNECT ignored by mqtt, %u publishes meanwhile\n", Scn->foreignPublishes);
+	printf("capture          %u bytes -> %s\n", Scn->captureBytes, Scn_CaptureFile);
+
+	printf("broker           connects %u rejects %u publishes %u (%u bytes) subscribes %u pings %u bad %u\n",
+			broker.connects, broker.rejects, broker.publishes, broker.publishBytes, broker.subscribes, broker.pings, broker.bad);
+	printf("network          segments %u retransmits %u socket failures %u lost syn %u peak events %u\n",
+			net.sent, net.retransmits, net.failures, net.connectFails, net.events);
+	printf("module           commands %u <Esc>O %u <Esc>F %u garbled %u board rx overruns %u (%u bytes)\n",
+			module.commands, module.bulkOk, module.bulkFail, module.garbled, module.rxOverruns, module.rxLost);
+	printf("ble              frames %u dropped %u read %u\n", ble.generated, ble.dropped, ble.read);
+	printf("scheduler        runs %u/%u/%u overruns %u/%u/%u idles %u\n",
+			sched->runs[0], sched->runs[1], sched->runs[2], sched->overruns[0], sched->overruns[1], sched->overruns[2], sched->idles);
+
+	n = AtLib_GetCommandStats(&cmd);
+	printf("at commands      (this boot)\n");
+	for (i = 0; i < n; i ++)
+		printf("  %-14s %5u  errors %3u timeouts %3u  avg %5u ms max %5u ms\n", cmd[i].name, cmd[i].count,
+				cmd[i].errors, cmd[i].timeouts, cmd[i].count ? cmd[i].totalTime / cmd[i].count : 0, cmd[i].maxTime);
+}
@@ -0,0 +1,454 @@
+/** @file   S2W_Emulator.h
+ *  @brief  Host emulator of GainSpan Serial-to-WiFi module, its network and relayr cloud servers.
+ *
+ *  		Module side of the uart link (S2W_Module.c) parses AT commands and
+ *  		escape sequences and replies with the timing of the module. Sockets are
+ *  		carried by a simple tcp model (latency, random loss with retransmission,
+ *  		in order delivery, limited send buffer) to mqtt broker and http server
+ *  		(S2W_Network.c). Scenario (S2W_Emulator.c) drives the network and checks
+ *  		the firmware. All state is in memory shared by firmware boots.
+ *
+ *  		Everything happens on virtual time of the simulation (Sim.h): module
+ *  		and network work is queued as events, which are served in time order
+ *  		when firmware moves the time.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#ifndef S2W_EMULATOR_H_
+#define S2W_EMULATOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+//////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+
+// network
+
+#define EMU_SERVER_IP			"52.58.137.10"		// relayr mqtt broker and http server
+#define EMU_MQTT_PORT			8883
+#define EMU_HTTP_PORT			80
+#define EMU_TIME_BASE_MS		1476576000000ULL	// server time at start of simulation
+
+#define EMU_CIDS				16
+#define EMU_SEGMENT_MAX			2048				// bulk message or http response
+#define EMU_RTT_US				40000
+#define EMU_RTO_US				200000				// first retransmission timeout, doubled on every retry
+#define EMU_SNDBUF				8192				// module socket send buffer
+#define EMU_MAXRT_DEFAULT		60					// seconds of retransmissions before socket fails
+
+typedef enum {
+	EMU_SERVER_NONE = 0,
+	EMU_SERVER_MQTT,
+	EMU_SERVER_HTTP
+} Emu_Server_t;
+
+typedef enum {
+	EMU_DIR_UP = 0,			// module to server
+	EMU_DIR_DOWN			// server to module
+} Emu_Dir_t;
+
+typedef enum {
+	EMU_EV_HOST_DATA = 0,	// bytes from board are off the uart line (arg - board baud rate)
+	EMU_EV_MODULE_OP,		// module command is done (arg - operation sequence number)
+	EMU_EV_SEGMENT,			// tcp segment arrives (arg - socket generation and direction)
+	EMU_EV_ACK,				// sent bytes are acknowledged (len - number of bytes)
+	EMU_EV_SOCKET_FAIL		// retransmission limit of the socket is reached
+} Emu_EventType_t;
+
+typedef struct {
+	uint32_t sent;							// segments
+	uint32_t retransmits;
+	uint32_t failures;						// sockets closed on retransmission limit
+	uint32_t connectFails;					// syn attempts which were lost
+	uint32_t events;						// peak number of queued events
+} Emu_NetStats_t;
+
+typedef struct {
+	uint32_t connects;
+	uint32_t rejects;						// wrong credentials
+	uint32_t publishes;
+	uint32_t publishBytes;
+	uint32_t subscribes;
+	uint32_t unsubscribes;
+	uint32_t pings;
+	uint32_t pubacks;						// acknowledges of publishes sent by broker
+	int      lastPubackId;
+	uint32_t maxPublishLen;					// longest publish payload
+	uint32_t bad;							// malformed packets
+} Emu_BrokerStats_t;
+
+
+//////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+
+// module
+
+typedef struct {
+	uint32_t commands;						// AT command lines
+	uint32_t bulkOk;						// <Esc>Z / <Esc>S frames answered with <Esc>O
+	uint32_t bulkFail;						// ... answered with <Esc>F
+	uint32_t garbled;						// bytes received on wrong baud rate
+	uint32_t rxOverruns;					// board uart ring overruns
+	uint32_t rxLost;						// bytes discarded on overruns
+	uint32_t resets;
+} Emu_ModuleStats_t;
+
+
+//////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+
+// S2W_Module.c
+
+/**
+ *  @brief  Allocate module state, should be called before Sim_Run
+ *
+ *  @return void
+ */
+void Emu_ModuleInit();
+
+/**
+ *  @brief  Reset module and board uart (boot of the board)
+ *
+ *  @return void
+ */
+void Emu_ModuleReset();
+
+/**
+ *  @brief  Serve module event
+ *
+ *  @param  Virtual time of the event
+ *  @param  Event type, EMU_EV_HOST_DATA or EMU_EV_MODULE_OP
+ *  @param  Event argument
+ *  @param  Data
+ *  @param  Number of bytes
+ *
+ *  @return void
+ */
+void Emu_ModuleEvent(uint64_t t, Emu_EventType_t type, uint32_t arg, const uint8_t* data, uint32_t len);
+
+/**
+ *  @brief  Send waiting asynchronous line if module is idle
+ *
+ *  @param  Virtual time
+ *
+ *  @return void
+ */
+void Emu_ModuleAdvance(uint64_t now);
+
+/**
+ *  @brief  Data of the socket received from network
+ *
+ *  Forwarded to board in <Esc>Z frame (<Esc>H for http connection).
+ *
+ *  @param  Virtual time
+ *  @param  Connection id
+ *  @param  Data
+ *  @param  Number of bytes
+ *
+ *  @return void
+ */
+void Emu_ModuleSocketData(uint64_t t, uint8_t cid, const uint8_t* data, uint32_t len);
+
+/**
+ *  @brief  Socket closed by server, "DISCONNECT <cid>" is sent to board
+ *
+ *  @param  Virtual time
+ *  @param  Connection id
+ *
+ *  @return void
+ */
+void Emu_ModuleSocketClosed(uint64_t t, uint8_t cid);
+
+/**
+ *  @brief  Retransmission limit of the socket is reached, "ERROR: SOCKET FAILURE" is sent to board
+ *
+ *  @param  Virtual time
+ *  @param  Connection id
+ *
+ *  @return void
+ */
+void Emu_ModuleSocketFailure(uint64_t t, uint8_t cid);
+
+/**
+ *  @brief  Send asynchronous line to board when module is idle
+ *
+ *  @param  Line without CR LF
+ *
+ *  @return void
+ */
+void Emu_ModuleAsyncLine(const char* line);
+
+/**
+ *  @brief  Check if async lines are sent
+ *
+ *  @return True if nothing is waiting
+ */
+bool Emu_ModuleAsyncDone();
+
+/**
+ *  @brief  Send next socket data to board in <Esc>S frame instead of bulk frame
+ *
+ *  @return void
+ */
+void Emu_ModuleNextDataNormal();
+
+/**
+ *  @brief  Find connection of the server
+ *
+ *  @param  Server
+ *
+ *  @return Connection id, -1 if there is none
+ */
+int Emu_ModuleFindCid(Emu_Server_t server);
+
+/**
+ *  @brief  Take connection id for a client of tcp server (not connected to network)
+ *
+ *  @return Connection id, -1 if all are used
+ */
+int Emu_ModuleOpenForeign();
+
+/**
+ *  @brief  Release connection id taken with Emu_ModuleOpenForeign
+ *
+ *  @param  Connection id
+ *
+ *  @return void
+ */
+void Emu_ModuleCloseForeign(uint8_t cid);
+
+/**
+ *  @brief  Get module statistics
+ *
+ *  @param  Return statistics
+ *
+ *  @return void
+ */
+void Emu_ModuleGetStats(Emu_ModuleStats_t* stats);
+
+/**
+ *  @brief  Start capture of board uart traffic (UART.c record format)
+ *
+ *  @return void
+ */
+void Emu_CaptureStart();
+
+/**
+ *  @brief  Stop capture and write it into file
+ *
+ *  File has capture header followed by records, oldest first.
+ *
+ *  @param  File name
+ *
+ *  @return Number of record bytes written, 0 on error
+ */
+uint32_t Emu_CaptureStop(const char* file);
+
+
+//////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+
+// S2W_Network.c
+
+/**
+ *  @brief  Allocate network and event queue state, should be called before Sim_Run
+ *
+ *  @return void
+ */
+void Emu_NetInit();
+
+/**
+ *  @brief  Queue event
+ *
+ *  Events with the same time are served in order they were queued.
+ *
+ *  @param  Virtual time of the event
+ *  @param  Event type
+ *  @param  Connection id
+ *  @param  Event argument
+ *  @param  Data, copied (may be NULL)
+ *  @param  Number of bytes, at most EMU_SEGMENT_MAX
+ *
+ *  @return void
+ */
+void Emu_EventPost(uint64_t t, Emu_EventType_t type, uint8_t cid, uint32_t arg, const uint8_t* data, uint32_t len);
+
+/**
+ *  @brief  Serve events due until given time
+ *
+ *  @param  Virtual time
+ *
+ *  @return void
+ */
+void Emu_NetAdvance(uint64_t now);
+
+/**
+ *  @brief  Find server behind ip and port
+ *
+ *  @param  Server ip
+ *  @param  Server port
+ *
+ *  @return Server, EMU_SERVER_NONE if there is none
+ */
+Emu_Server_t Emu_NetResolve(const char* ip, int port);
+
+/**
+ *  @brief  Check if servers are reachable (dns, http and ssl handshake)
+ *
+ *  @return True if reachable
+ */
+bool Emu_NetReachable();
+
+/**
+ *  @brief  Try tcp handshake (syn and syn-ack can be lost)
+ *
+ *  @return True if handshake succeeds
+ */
+bool Emu_NetConnectAttempt();
+
+/**
+ *  @brief  Open/close tcp connection of the socket
+ *
+ *  @param  Connection id
+ *  @param  Server
+ *
+ *  @return void
+ */
+void Emu_NetOpen(uint8_t cid, Emu_Server_t server);
+void Emu_NetClose(uint8_t cid);
+
+/**
+ *  @brief  Set retransmission time limit of the socket (TCP_MAXRT)
+ *
+ *  @param  Connection id
+ *  @param  Seconds
+ *
+ *  @return void
+ */
+void Emu_NetSetMaxRT(uint8_t cid, uint32_t seconds);
+
+/**
+ *  @brief  Send data of the socket
+ *
+ *  @param  Virtual time
+ *  @param  Connection id
+ *  @param  Direction
+ *  @param  Data
+ *  @param  Number of bytes, at most EMU_SEGMENT_MAX
+ *
+ *  @return False if socket is closed or send buffer is full
+ */
+bool Emu_NetSend(uint64_t t, uint8_t cid, Emu_Dir_t dir, const uint8_t* data, uint32_t len);
+
+/**
+ *  @brief  Server closes connection of the socket
+ *
+ *  @param  Connection id
+ *
+ *  @return void
+ */
+void Emu_NetDrop(uint8_t cid);
+
+/**
+ *  @brief  Set segment loss
+ *
+ *  @param  Lost segments per thousand
+ *
+ *  @return void
+ */
+void Emu_NetSetLoss(uint32_t permille);
+
+/**
+ *  @brief  Make servers (un)reachable, all segments are lost while unreachable
+ *
+ *  @param  Reachable
+ *
+ *  @return void
+ */
+void Emu_NetSetReachable(bool reachable);
+
+/**
+ *  @brief  Check certificate against the one which signed the server certificate
+ *
+ *  @param  Certificate (der)
+ *  @param  Certificate length
+ *
+ *  @return True if ssl handshake succeeds with given certificate
+ */
+bool Emu_NetCertValid(const uint8_t* cert, uint32_t len);
+
+/**
+ *  @brief  Get network statistics
+ *
+ *  @param  Return statistics
+ *
+ *  @return void
+ */
+void Emu_NetGetStats(Emu_NetStats_t* stats);
+
+/**
+ *  @brief  Send QoS 1 publish from broker on the mqtt connection
+ *
+ *  @param  Topic
+ *  @param  Payload
+ *  @param  Payload length
+ *  @param  Packet id
+ *
+ *  @return True if sent
+ */
+bool Emu_BrokerPublish(const char* topic, const uint8_t* payload, int len, int id);
+
+/**
+ *  @brief  Send raw packet from broker on the mqtt connection
+ *
+ *  @param  Packet
+ *  @param  Packet length
+ *
+ *  @return True if sent
+ */
+bool Emu_BrokerSendPacket(const uint8_t* packet, int len);
+
+/**
+ *  @brief  Check if mqtt session is established (connack sent)
+ *
+ *  @return True if connected
+ */
+bool Emu_BrokerConnected();
+
+/**
+ *  @brief  Get broker statistics
+ *
+ *  @param  Return statistics
+ *
+ *  @return void
+ */
+void Emu_BrokerGetStats(Emu_BrokerStats_t* stats);
+
+/**
+ *  @brief  Keep payload of publishes on the topic
+ *
+ *  @param  Topic
+ *
+ *  @return void
+ */
+void Emu_BrokerWatch(const char* topic);
+
+/**
+ *  @brief  Get payload of the last publish on watched topic
+ *
+ *  @param  Buffer for payload
+ *  @param  Buffer size
+ *
+ *  @return Payload length (cut to buffer size), -1 if nothing was published yet
+ */
+int Emu_BrokerWatched(uint8_t* payload, int size);
+
+#endif // S2W_EMULATOR_H_
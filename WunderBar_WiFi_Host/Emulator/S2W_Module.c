@@ -0,0 +1,1092 @@
+/** @file   S2W_Module.c
+ *  @brief  Emulated GainSpan S2W module and the board side of its uart (GS_HAL_*).
+ *
+ *  		Module receives bytes when they are off the host line, on its own baud
+ *  		rate (bytes sent on other rate are lost). Commands are executed one at a
+ *  		time, input is buffered while a command is in progress. Replies go back
+ *  		on the module line with per byte arrival times; board sees a byte only
+ *  		after the ms in which it arrived, so reads depend on ms timer only and a
+ *  		capture can be replayed. Board ring overrun follows UART.c.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#include <hardware/Hw_modules.h>
+
+#include "../Sim/Sim.h"
+#include "S2W_Emulator.h"
+
+
+#define MOD_ESC					0x1B
+#define MOD_LINE_MAX			1024
+#define MOD_IN_SIZE				4096				// module input buffer (bytes waiting for command in progress)
+#define MOD_LINK_SIZE			0x10000				// bytes on the way to board or not read yet
+#define MOD_ASYNC_MAX			4
+#define MOD_ASYNC_IDLE_US		10000				// async lines are sent when module was idle for this long
+
+#define MOD_CMD_US				1000				// command processing
+#define MOD_BULK_US				500					// data frame processing
+#define MOD_RESET_US			300000				// software reset
+#define MOD_BOOT_US				100000				// welcome line after reset pin release
+#define MOD_JOIN_US				1500000				// association and dhcp
+#define MOD_DHCP_US				200000
+#define MOD_SSL_US				150000				// handshake crypto on top of round trips
+#define MOD_CONNECT_FAIL_US		3000000				// tcp connect gives up (syn sent 3 times)
+#define MOD_DNS_FAIL_US			2000000
+
+#define UART_RX_RING_SIZE		0x2000				// board uart ring (UART.c)
+#define UART_TX_BUF_SIZE		256
+#define UART_BLOCK_TIMEOUT		1000
+
+#define UART_CAPTURE_MAGIC		0x50414355			// "UCAP"
+#define UART_CAPTURE_HEADER		6
+#define UART_CAPTURE_TX			0x80
+#define EMU_CAPTURE_SIZE		0x1000000
+
+typedef enum {
+	MOD_RX_LINE = 0,
+	MOD_RX_ESC,
+	MOD_RX_CID,
+	MOD_RX_LEN,
+	MOD_RX_DATA,
+	MOD_RX_SDATA,
+	MOD_RX_SESC,
+	MOD_RX_CERT
+} Mod_RxState_t;
+
+typedef enum {
+	MOD_OP_NONE = 0,
+	MOD_OP_REPLY,							// send prepared reply
+	MOD_OP_CONNECT,							// tcp connect attempt
+	MOD_OP_RESET,							// software reset done
+	MOD_OP_BOOT								// welcome line after reset pin
+} Mod_Op_t;
+
+typedef struct {
+	uint8_t      used;
+	uint8_t      ssl;
+	uint8_t      http;
+	Emu_Server_t server;
+} Mod_Cid_t;
+
+typedef struct {
+	// module to board line
+	uint8_t  link[MOD_LINK_SIZE];
+	uint64_t linkTime[MOD_LINK_SIZE];		// arrival on board
+	uint32_t linkHead;						// next byte to write (free running)
+	uint32_t linkTail;						// next byte board reads
+	uint64_t lineFree;
+	uint32_t hostBaud;						// board uart rate
+	uint32_t baud;							// module uart rate
+	uint32_t nextBaud;
+	uint64_t baudAt;						// new rate takes effect when reply is sent
+
+	// input and parser
+	uint8_t  in[MOD_IN_SIZE];
+	uint32_t inHead;
+	uint32_t inTail;
+	Mod_RxState_t rx;
+	char     line[MOD_LINE_MAX];
+	uint32_t lineLen;
+	uint8_t  rxCid;
+	uint8_t  rxBulk;
+	uint32_t rxLen;
+	uint32_t rxDigits;
+	uint32_t rxCount;
+	uint8_t  rxData[EMU_SEGMENT_MAX];
+	uint8_t  echo;
+
+	// command in progress
+	uint8_t  busy;
+	Mod_Op_t op;
+	uint32_t opSeq;
+	uint8_t  opCid;
+	uint8_t  opTries;
+	Emu_Server_t opServer;
+	char     reply[256];
+	uint64_t lastActivity;
+
+	// state
+	uint8_t  associated;
+	char     passphrase[64];
+	uint32_t certSize;						// certificate being added
+	uint8_t  cert[4096];
+	uint32_t certLen;						// certificate in module
+	uint64_t clockBase;						// module clock (ms) when set
+	uint64_t clockSetAt;
+	Mod_Cid_t cids[EMU_CIDS];
+	uint8_t  nextNormal;
+
+	char     async[MOD_ASYNC_MAX][64];
+	uint8_t  asyncCount;
+
+	// capture of board uart traffic
+	uint8_t  capturing;
+	uint32_t captureUsed;
+
+	Emu_ModuleStats_t stats;
+} Emu_Module_t;
+
+static Emu_Module_t* Mod;
+static uint8_t*      Emu_Capture;
+
+
+// static declarations
+
+static void Mod_HostData(uint64_t t, const uint8_t* data, uint32_t len, uint32_t baud);
+static void Mod_Run(uint64_t t);
+static void Mod_Byte(uint64_t t, uint8_t b);
+static void Mod_Command(uint64_t t, char* cmd);
+static void Mod_DataFrame(uint64_t t, uint8_t cid, const uint8_t* data, uint32_t len);
+static void Mod_OpDone(uint64_t t, uint32_t seq);
+static void Mod_Reply(uint64_t t, uint64_t delay, const char* fmt, ...);
+static void Mod_Emit(uint64_t t, const void* data, uint32_t len);
+static void Mod_EmitStr(uint64_t t, const char* str);
+static uint32_t Mod_Baud(uint64_t t);
+static int  Mod_AllocCid();
+static void Mod_CloseCid(uint8_t cid);
+static void Mod_Restart(uint64_t t);
+static char Mod_Hex(uint8_t cid);
+static void Mod_FormatClock(uint64_t ms, char* txt);
+static uint32_t Mod_LinkRead(uint8_t* dst, uint32_t size);
+static void Mod_CaptureRecord(uint8_t dir, const uint8_t* data, uint32_t len);
+
+
+
+
+	///////////////////////////////////////
+	/*         public functions          */
+	///////////////////////////////////////
+
+
+
+void Emu_ModuleInit(){
+	Mod = Sim_SharedAlloc(sizeof(Emu_Module_t));
+	Emu_Capture = Sim_SharedAlloc(EMU_CAPTURE_SIZE);
+	Mod->baud = GS_HAL_BAUD_DEFAULT;
+	Mod->hostBaud = GS_HAL_BAUD_DEFAULT;
+}
+
+void Emu_ModuleReset(){
+	uint64_t t = Sim_Now();
+
+	// board: uart is set to default rate, bytes not read are lost
+	Mod->hostBaud = GS_HAL_BAUD_DEFAULT;
+	Mod->linkTail = Mod->linkHead;
+
+	// module: reset pin, welcome line after boot
+	Mod_Restart(t);
+	Mod->stats.resets ++;
+	Mod->busy = 1;
+	Mod->op = MOD_OP_BOOT;
+	Emu_EventPost(t + MOD_BOOT_US, EMU_EV_MODULE_OP, 0, ++ Mod->opSeq, NULL, 0);
+}
+
+void Emu_ModuleEvent(uint64_t t, Emu_EventType_t type, uint32_t arg, const uint8_t* data, uint32_t len){
+	if (type == EMU_EV_HOST_DATA)
+		Mod_HostData(t, data, len, arg);
+	else if (type == EMU_EV_MODULE_OP)
+		Mod_OpDone(t, arg);
+}
+
+void Emu_ModuleAdvance(uint64_t now){
+	if (Mod->asyncCount == 0)
+		return;
+
+	if (Mod->busy || (Mod->inHead != Mod->inTail) || (Mod->rx != MOD_RX_LINE) || (Mod->lineLen != 0))
+		return;
+	if ((now < Mod->lastActivity + MOD_ASYNC_IDLE_US) || (now < Mod->lineFree))
+		return;
+
+	Mod_EmitStr(now, "\r\n");
+	Mod_EmitStr(now, Mod->async[0]);
+	Mod_EmitStr(now, "\r\n");
+	memmove(Mod->async[0], Mod->async[1], sizeof(Mod->async[0]) * (MOD_ASYNC_MAX - 1));
+	Mod->asyncCount --;
+}
+
+void Emu_ModuleSocketData(uint64_t t, uint8_t cid, const uint8_t* data, uint32_t len){
+	char header[8];
+
+	if (!Mod->cids[cid].used)
+		return;
+
+	if (Mod->cids[cid].http)
+	{
+		sprintf(header, "\x1BH%c%04u", Mod_Hex(cid), len);
+		Mod_EmitStr(t, header);
+		Mod_Emit(t, data, len);
+	}
+	else if (Mod->nextNormal)
+	{
+		Mod->nextNormal = 0;
+		sprintf(header, "\x1BS%c", Mod_Hex(cid));
+		Mod_EmitStr(t, header);
+		Mod_Emit(t, data, len);
+		Mod_EmitStr(t, "\x1B" "E");
+	}
+	else
+	{
+		sprintf(header, "\x1BZ%c%04u", Mod_Hex(cid), len);
+		Mod_EmitStr(t, header);
+		Mod_Emit(t, data, len);
+	}
+}
+
+void Emu_ModuleSocketClosed(uint64_t t, uint8_t cid){
+	char line[32];
+
+	if (!Mod->cids[cid].used)
+		return;
+
+	Mod_CloseCid(cid);
+	sprintf(line, "\r\nDISCONNECT %c\r\n", Mod_Hex(cid));
+	Mod_EmitStr(t, line);
+}
+
+void Emu_ModuleSocketFailure(uint64_t t, uint8_t cid){
+	char line[40];
+
+	if (!Mod->cids[cid].used)
+		return;
+
+	Mod_CloseCid(cid);
+	sprintf(line, "\r\nERROR: SOCKET FAILURE %c\r\n", Mod_Hex(cid));
+	Mod_EmitStr(t, line);
+}
+
+void Emu_ModuleAsyncLine(const char* line){
+	if (Mod->asyncCount < MOD_ASYNC_MAX)
+		snprintf(Mod->async[Mod->asyncCount ++], sizeof(Mod->async[0]), "%s", line);
+}
+
+bool Emu_ModuleAsyncDone(){
+	return Mod->asyncCount == 0;
+}
+
+void Emu_ModuleNextDataNormal(){
+	Mod->nextNormal = 1;
+}
+
+int Emu_ModuleFindCid(Emu_Server_t server){
+	int cid;
+
+	for (cid = 0; cid < EMU_CIDS; cid ++)
+		if (Mod->cids[cid].used && (Mod->cids[cid].server == server))
+			return cid;
+	return -1;
+}
+
+int Emu_ModuleOpenForeign(){
+	int cid = Mod_AllocCid();
+
+	if (cid >= 0)
+	{
+		Mod->cids[cid].used = 1;
+		Mod->cids[cid].server = EMU_SERVER_NONE;
+	}
+	return cid;
+}
+
+void Emu_ModuleCloseForeign(uint8_t cid){
+	Mod_CloseCid(cid);
+}
+
+void Emu_ModuleGetStats(Emu_ModuleStats_t* stats){
+	*stats = Mod->stats;
+}
+
+void Emu_CaptureStart(){
+	Mod->capturing = 1;
+	Mod->captureUsed = 0;
+}
+
+uint32_t Emu_CaptureStop(const char* file){
+	uint32_t header[5] = { UART_CAPTURE_MAGIC, Mod->captureUsed, 0, Mod->captureUsed, 0 };
+	FILE* f;
+	bool ok;
+
+	Mod->capturing = 0;
+
+	if ((f = fopen(file, "wb")) == NULL)
+		return 0;
+
+	// oldest record starts at (head - used) modulo size, which is 0
+	ok = (fwrite(header, sizeof(header), 1, f) == 1) &&
+			(fwrite(Emu_Capture, 1, Mod->captureUsed, f) == Mod->captureUsed);
+	ok = (fclose(f) == 0) && ok;
+
+	return ok ? Mod->captureUsed : 0;
+}
+
+
+// board uart (UART.c on emulated line)
+
+void GS_HAL_send(uint8_t* StrPtr, uint32_t Size){
+	uint64_t arrival;
+	uint32_t len;
+
+	while (Size)
+	{
+		len = (Size < UART_TX_BUF_SIZE) ? Size : UART_TX_BUF_SIZE;
+		Mod_CaptureRecord(UART_CAPTURE_TX, StrPtr, len);
+
+		arrival = Sim_UartSend(len, Mod->hostBaud);
+		Emu_EventPost(arrival, EMU_EV_HOST_DATA, 0, Mod->hostBaud, StrPtr, len);
+
+		StrPtr += len;
+		Size -= len;
+	}
+}
+
+unsigned int GS_HAL_recv(uint8_t* recvbyte, uint32_t Size, uint32_t block){
+	uint32_t read, result = 0;
+	uint64_t time;
+	uint8_t* start = recvbyte;
+
+	if (block)
+	{
+		time = MSTimerGet();
+		while (Size && (MSTimerDelta(time) <= UART_BLOCK_TIMEOUT))
+		{
+			read = Mod_LinkRead(recvbyte, Size);
+
+			recvbyte += read;
+			Size -= read;
+			result += read;
+		}
+	}
+	else
+	{
+		result = Mod_LinkRead(recvbyte, Size);
+	}
+
+	Mod_CaptureRecord(0, start, result);
+	return result;
+}
+
+void GS_HAL_ClearBuff(){
+	uint64_t visible = Sim_Now() / 1000 * 1000;
+
+	while ((Mod->linkTail != Mod->linkHead) && (Mod->linkTime[Mod->linkTail % MOD_LINK_SIZE] < visible))
+		Mod->linkTail ++;
+}
+
+void GS_HAL_SetBaudRate(uint32_t baudRate){
+	Sim_UartDrain();
+	Mod->hostBaud = baudRate;
+}
+
+uint32_t GS_HAL_GetBaudRate(){
+	return Mod->hostBaud;
+}
+
+void GS_HAL_GetRxStats(uint32_t* overruns, uint32_t* lost, uint32_t* fifoOverruns){
+	*overruns = Mod->stats.rxOverruns;
+	*lost = Mod->stats.rxLost;
+	*fifoOverruns = 0;
+}
+
+
+
+
+	///////////////////////////////////////
+	/*         static functions          */
+	///////////////////////////////////////
+
+
+
+/**
+ *  @brief  Bytes from board are off the line
+ *
+ *  @param  Virtual time
+ *  @param  Data
+ *  @param  Number of bytes
+ *  @param  Board baud rate
+ *
+ *  @return void
+ */
+static void Mod_HostData(uint64_t t, const uint8_t* data, uint32_t len, uint32_t baud){
+	uint32_t i;
+
+	Mod->lastActivity = t;
+
+	if (baud != Mod_Baud(t))
+	{
+		Mod->stats.garbled += len;
+		return;
+	}
+
+	for (i = 0; i < len; i ++)
+	{
+		if (Mod->inHead - Mod->inTail >= MOD_IN_SIZE)
+		{
+			Mod->stats.garbled += len - i;			// module uart overflow
+			break;
+		}
+		Mod->in[Mod->inHead ++ % MOD_IN_SIZE] = data[i];
+	}
+
+	Mod_Run(t);
+}
+
+/**
+ *  @brief  Parse input until a command takes time
+ *
+ *  @param  Virtual time
+ *
+ *  @return void
+ */
+static void Mod_Run(uint64_t t){
+	while (!Mod->busy && (Mod->inTail != Mod->inHead))
+		Mod_Byte(t, Mod->in[Mod->inTail ++ % MOD_IN_SIZE]);
+}
+
+/**
+ *  @brief  Parse one input byte (command line or escape sequence)
+ *
+ *  @param  Virtual time
+ *  @param  Byte
+ *
+ *  @return void
+ */
+static void Mod_Byte(uint64_t t, uint8_t b){
+	switch (Mod->rx)
+	{
+	case MOD_RX_LINE:
+		if (b == MOD_ESC)
+		{
+			Mod->rx = MOD_RX_ESC;
+			Mod->lineLen = 0;
+		}
+		else if (b == '\n')
+		{
+			Mod->line[Mod->lineLen] = 0;
+			Mod->lineLen = 0;
+			if (Mod->echo)
+			{
+				Mod_EmitStr(t, Mod->line);
+				Mod_EmitStr(t, "\r\n");
+			}
+			if (Mod->line[0])
+				Mod_Command(t, Mod->line);
+		}
+		else if ((b != '\r') && (Mod->lineLen < MOD_LINE_MAX - 1))
+		{
+			Mod->line[Mod->lineLen ++] = b;
+		}
+		break;
+
+	case MOD_RX_ESC:
+		Mod->rxCount = 0;
+		Mod->rxLen = 0;
+		Mod->rxDigits = 0;
+		if ((b == 'Z') || (b == 'S'))
+		{
+			Mod->rxBulk = (b == 'Z');
+			Mod->rx = MOD_RX_CID;
+		}
+		else if ((b == 'W') && Mod->certSize)
+		{
+			Mod->certLen = 0;
+			Mod->rx = MOD_RX_CERT;
+		}
+		else
+			Mod->rx = MOD_RX_LINE;
+		break;
+
+	case MOD_RX_CID:
+		Mod->rxCid = ((b >= '0') && (b <= '9')) ? b - '0' : ((b | 0x20) - 'a' + 10) & 0x0F;
+		Mod->rx = Mod->rxBulk ? MOD_RX_LEN : MOD_RX_SDATA;
+		break;
+
+	case MOD_RX_LEN:
+		Mod->rxLen = Mod->rxLen * 10 + (b - '0');
+		if (++ Mod->rxDigits == 4)
+		{
+			Mod->rx = MOD_RX_DATA;
+			if (Mod->rxLen == 0)
+			{
+				Mod->rx = MOD_RX_LINE;
+				Mod_DataFrame(t, Mod->rxCid, Mod->rxData, 0);
+			}
+		}
+		break;
+
+	case MOD_RX_DATA:
+		if (Mod->rxCount < EMU_SEGMENT_MAX)
+			Mod->rxData[Mod->rxCount] = b;
+		if (++ Mod->rxCount == Mod->rxLen)
+		{
+			Mod->rx = MOD_RX_LINE;
+			Mod_DataFrame(t, Mod->rxCid, Mod->rxData, (Mod->rxLen < EMU_SEGMENT_MAX) ? Mod->rxLen : EMU_SEGMENT_MAX);
+		}
+		break;
+
+	case MOD_RX_SDATA:
+		if (b == MOD_ESC)
+			Mod->rx = MOD_RX_SESC;
+		else if (Mod->rxCount < EMU_SEGMENT_MAX)
+			Mod->rxData[Mod->rxCount ++] = b;
+		break;
+
+	case MOD_RX_SESC:
+		if (b == 'E')
+		{
+			Mod->rx = MOD_RX_LINE;
+			Mod_DataFrame(t, Mod->rxCid, Mod->rxData, Mod->rxCount);
+			break;
+		}
+		// escape character is part of data
+		if (Mod->rxCount + 2 <= EMU_SEGMENT_MAX)
+		{
+			Mod->rxData[Mod->rxCount ++] = MOD_ESC;
+			Mod->rxData[Mod->rxCount ++] = b;
+		}
+		Mod->rx = MOD_RX_SDATA;
+		break;
+
+	case MOD_RX_CERT:
+		if (Mod->certLen < sizeof(Mod->cert))
+			Mod->cert[Mod->certLen] = b;
+		Mod->certLen ++;
+		if (Mod->certLen == Mod->certSize)
+		{
+			Mod->certSize = 0;
+			Mod->rx = MOD_RX_LINE;
+			Mod_Reply(t, 50000, "\r\nOK\r\n");
+		}
+		break;
+	}
+}
+
+/**
+ *  @brief  Execute AT command
+ *
+ *  @param  Virtual time
+ *  @param  Command line without line end
+ *
+ *  @return void
+ */
+static void Mod_Command(uint64_t t, char* cmd){
+	char arg1[64], arg2[64];
+	unsigned int n1, n2, n3, n4;
+	struct tm tm;
+	int cid;
+
+	Mod->stats.commands ++;
+
+	if (strncmp(cmd, "AT", 2) != 0)
+	{
+		Mod_Reply(t, MOD_CMD_US, "\r\nERROR: INVALID INPUT\r\n");
+		return;
+	}
+	cmd += 2;
+
+	if ((strcmp(cmd, "E0") == 0) || (strcmp(cmd, "E1") == 0))
+	{
+		Mod->echo = (cmd[1] == '1');
+		Mod_Reply(t, MOD_CMD_US, "\r\nOK\r\n");
+	}
+	else if (sscanf(cmd, "B=%u", &n1) == 1)
+	{
+		Mod_Reply(t, MOD_CMD_US, "\r\nOK\r\n");
+		Mod->nextBaud = n1;					// switched when OK is sent
+	}
+	else if (strcmp(cmd, "+RESET") == 0)
+	{
+		Mod->busy = 1;
+		Mod->op = MOD_OP_RESET;
+		Emu_EventPost(t + MOD_RESET_US, EMU_EV_MODULE_OP, 0, ++ Mod->opSeq, NULL, 0);
+	}
+	else if (sscanf(cmd, "+WWPA=%63[^\n]", Mod->passphrase) == 1)
+	{
+		Mod_Reply(t, MOD_CMD_US, "\r\nOK\r\n");
+	}
+	else if (sscanf(cmd, "+WA=%63[^,]", arg1) == 1)
+	{
+		Mod->associated = (strcmp(arg1, SIM_WIFI_SSID) == 0) && (strcmp(Mod->passphrase, SIM_WIFI_PASSWORD) == 0);
+
+		if (Mod->associated)
+			Mod_Reply(t, MOD_JOIN_US, "\r\n    IP              SubNet         Gateway   \r\n"
+							" 192.168.1.99: 255.255.255.0: 192.168.1.1\r\nOK\r\n");
+		else
+			Mod_Reply(t, MOD_JOIN_US * 3, "\r\nERROR\r\n");
+	}
+	else if (strncmp(cmd, "+NDHCP=1", 8) == 0)
+	{
+		if (Mod->associated)
+			Mod_Reply(t, MOD_DHCP_US, "\r\n    IP              SubNet         Gateway   \r\n"
+							" 192.168.1.99: 255.255.255.0: 192.168.1.1\r\nOK\r\n");
+		else
+			Mod_Reply(t, MOD_CMD_US, "\r\nOK\r\n");
+	}
+	else if (strcmp(cmd, "+WSTATUS") == 0)
+	{
+		if (Mod->associated)
+			Mod_Reply(t, MOD_CMD_US, "\r\nMODE:STA BSSID:00:1d:7e:3a:10:22 SSID:\"%s\" CHANNEL:6 SECURITY:WPA2-PERSONAL\r\nOK\r\n",
+						SIM_WIFI_SSID);
+		else
+			Mod_Reply(t, MOD_CMD_US, "\r\nNOT ASSOCIATED\r\nOK\r\n");
+	}
+	else if (sscanf(cmd, "+DNSLOOKUP=%63s", arg1) == 1)
+	{
+		if (Mod->associated && (strcmp(arg1, SIM_CLOUD_URL) == 0) && Emu_NetReachable())
+			Mod_Reply(t, EMU_RTT_US, "\r\nIP:%s\r\nOK\r\n", EMU_SERVER_IP);
+		else
+			Mod_Reply(t, MOD_DNS_FAIL_US, "\r\nERROR\r\n");
+	}
+	else if (sscanf(cmd, "+NCTCP=%63[^,],%u", arg1, &n1) == 2)
+	{
+		if (!Mod->associated || ((cid = Mod_AllocCid()) < 0))
+		{
+			Mod_Reply(t, MOD_CMD_US, "\r\nERROR\r\n");
+			return;
+		}
+		Mod->busy = 1;
+		Mod->op = MOD_OP_CONNECT;
+		Mod->opCid = cid;
+		Mod->opTries = 0;
+		Mod->opServer = Emu_NetResolve(arg1, n1);
+		Emu_EventPost(t + MOD_CMD_US, EMU_EV_MODULE_OP, 0, ++ Mod->opSeq, NULL, 0);
+	}
+	else if (sscanf(cmd, "+SETSOCKOPT=%u,%u,%u,%u", &n1, &n2, &n3, &n4) == 4)
+	{
+		if ((n1 >= EMU_CIDS) || !Mod->cids[n1].used)
+		{
+			Mod_Reply(t, MOD_CMD_US, "\r\nERROR\r\n");
+			return;
+		}
+		if ((n2 == 6) && (n3 == 10))
+			Emu_NetSetMaxRT(n1, n4);
+		Mod_Reply(t, MOD_CMD_US, "\r\nOK\r\n");
+	}
+	else if (strncmp(cmd, "+TCERTDEL=", 10) == 0)
+	{
+		Mod->certLen = 0;
+		Mod_Reply(t, MOD_CMD_US, "\r\nOK\r\n");
+	}
+	else if (sscanf(cmd, "+TCERTADD=%63[^,],%u,%u,%u", arg1, &n1, &n2, &n3) == 4)
+	{
+		Mod->certSize = n2;
+		Mod->certLen = 0;
+		Mod_Reply(t, MOD_CMD_US, "\r\nOK\r\n");
+	}
+	else if (sscanf(cmd, "+SSLOPEN=%u,%63s", &n1, arg1) == 2)
+	{
+		if ((n1 >= EMU_CIDS) || !Mod->cids[n1].used || Mod->cids[n1].http)
+		{
+			Mod_Reply(t, MOD_CMD_US, "\r\nERROR\r\n");
+		}
+		else if (Emu_NetReachable() && (Mod->certLen > 0) && Emu_NetCertValid(Mod->cert, Mod->certLen))
+		{
+			Mod->cids[n1].ssl = 1;
+			Mod_Reply(t, 2 * EMU_RTT_US + MOD_SSL_US, "\r\nOK\r\n");
+		}
+		else
+		{
+			// handshake failed, module closes the socket
+			Mod_CloseCid(n1);
+			Mod_Reply(t, 2 * EMU_RTT_US + MOD_SSL_US, "\r\nERROR\r\n");
+		}
+	}
+	else if (sscanf(cmd, "+SSLCLOSE=%u", &n1) == 1)
+	{
+		if ((n1 < EMU_CIDS) && Mod->cids[n1].used && Mod->cids[n1].ssl)
+		{
+			Mod->cids[n1].ssl = 0;
+			Mod_Reply(t, MOD_CMD_US, "\r\nOK\r\n");
+		}
+		else
+			Mod_Reply(t, MOD_CMD_US, "\r\nERROR\r\n");
+	}
+	else if (strncmp(cmd, "+NCLOSEALL", 10) == 0)
+	{
+		for (cid = 0; cid < EMU_CIDS; cid ++)
+			Mod_CloseCid(cid);
+		Mod_Reply(t, MOD_CMD_US, "\r\nOK\r\n");
+	}
+	else if (sscanf(cmd, "+NCLOSE=%1s", arg1) == 1)
+	{
+		cid = strtol(arg1, NULL, 16);
+		if (Mod->cids[cid].used)
+		{
+			Mod_CloseCid(cid);
+			Mod_Reply(t, MOD_CMD_US, "\r\nOK\r\n");
+		}
+		else
+			Mod_Reply(t, MOD_CMD_US, "\r\nERROR: INVALID CID\r\n");
+	}
+	else if (sscanf(cmd, "+HTTPOPEN=%63[^,],%u", arg1, &n1) == 2)
+	{
+		if (!Mod->associated || (Emu_NetResolve(arg1, n1) != EMU_SERVER_HTTP) || !Emu_NetReachable() ||
+				((cid = Mod_AllocCid()) < 0))
+		{
+			Mod_Reply(t, MOD_CONNECT_FAIL_US, "\r\nERROR\r\n");
+			return;
+		}
+		Mod->cids[cid].used = 1;
+		Mod->cids[cid].http = 1;
+		Mod->cids[cid].server = EMU_SERVER_HTTP;
+		Emu_NetOpen(cid, EMU_SERVER_HTTP);
+		Mod_Reply(t, EMU_RTT_US, "\r\n%c\r\nOK\r\n", Mod_Hex(cid));
+	}
+	else if (sscanf(cmd, "+HTTPSEND=%u,%u,%u,%63[^,]", &n1, &n2, &n3, arg1) == 4)
+	{
+		if ((n1 < EMU_CIDS) && Mod->cids[n1].used && Mod->cids[n1].http &&
+				Emu_NetSend(t, n1, EMU_DIR_UP, (const uint8_t*) arg1, strlen(arg1)))
+			Mod_Reply(t, MOD_CMD_US, "\r\nOK\r\n");
+		else
+			Mod_Reply(t, MOD_CMD_US, "\r\nERROR\r\n");
+	}
+	else if (sscanf(cmd, "+HTTPCLOSE=%u", &n1) == 1)
+	{
+		if ((n1 < EMU_CIDS) && Mod->cids[n1].used && Mod->cids[n1].http)
+		{
+			Mod_CloseCid(n1);
+			Mod_Reply(t, MOD_CMD_US, "\r\nOK\r\n");
+		}
+		else
+			Mod_Reply(t, MOD_CMD_US, "\r\nERROR\r\n");
+	}
+	else if (sscanf(cmd, "+SETTIME=%u/%u/%u,%63s", &n1, &n2, &n3, arg2) == 4)
+	{
+		memset(&tm, 0, sizeof(tm));
+		tm.tm_mday = n1;
+		tm.tm_mon = n2 - 1;
+		tm.tm_year = n3 - 1900;
+		sscanf(arg2, "%d:%d:%d", &tm.tm_hour, &tm.tm_min, &tm.tm_sec);
+
+		Mod->clockBase = (uint64_t) timegm(&tm) * 1000;
+		Mod->clockSetAt = t;
+		Mod_Reply(t, MOD_CMD_US, "\r\nOK\r\n");
+	}
+	else if (strcmp(cmd, "+GETTIME=?") == 0)
+	{
+		uint64_t ms = Mod->clockBase + (t - Mod->clockSetAt) / 1000;
+
+		Mod_FormatClock(ms, arg2);
+		Mod_Reply(t, MOD_CMD_US, "\r\n%s,%013llu\r\nOK\r\n", arg2, (unsigned long long) ms);
+	}
+	else
+	{
+		// radio, antenna, http headers, gpio...
+		Mod_Reply(t, MOD_CMD_US, "\r\nOK\r\n");
+	}
+}
+
+/**
+ *  @brief  Data frame from board (<Esc>Z or <Esc>S)
+ *
+ *  @param  Virtual time
+ *  @param  Connection id
+ *  @param  Data
+ *  @param  Number of bytes
+ *
+ *  @return void
+ */
+static void Mod_DataFrame(uint64_t t, uint8_t cid, const uint8_t* data, uint32_t len){
+	if (Mod->cids[cid].used && !Mod->cids[cid].http && (Mod->cids[cid].server != EMU_SERVER_NONE) &&
+			Emu_NetSend(t, cid, EMU_DIR_UP, data, len))
+	{
+		Mod->stats.bulkOk ++;
+		Mod_Reply(t, MOD_BULK_US, "\x1BO");
+	}
+	else
+	{
+		Mod->stats.bulkFail ++;
+		Mod_Reply(t, MOD_BULK_US, "\x1B" "F");
+	}
+}
+
+/**
+ *  @brief  Command in progress is done (or needs next step)
+ *
+ *  @param  Virtual time
+ *  @param  Sequence number of the operation
+ *
+ *  @return void
+ */
+static void Mod_OpDone(uint64_t t, uint32_t seq){
+	Mod_Cid_t* c;
+
+	if (seq != Mod->opSeq)
+		return;								// cancelled by reset
+
+	switch (Mod->op)
+	{
+	case MOD_OP_REPLY:
+		Mod_EmitStr(t, Mod->reply);
+		if (Mod->nextBaud)
+			Mod->baudAt = Mod->lineFree;
+		break;
+
+	case MOD_OP_CONNECT:
+		if ((Mod->opServer != EMU_SERVER_NONE) && Emu_NetConnectAttempt())
+		{
+			c = &Mod->cids[Mod->opCid];
+			c->used = 1;
+			c->ssl = 0;
+			c->http = 0;
+			c->server = Mod->opServer;
+			Emu_NetOpen(Mod->opCid, Mod->opServer);
+
+			Mod->busy = 0;
+			Mod_Reply(t, EMU_RTT_US, "\r\nCONNECT %c\r\n\r\nOK\r\n", Mod_Hex(Mod->opCid));
+			return;
+		}
+		// syn is sent again after 1 and 2 seconds
+		if (++ Mod->opTries < 3)
+		{
+			Emu_EventPost(t + Mod->opTries * 1000000, EMU_EV_MODULE_OP, 0, Mod->opSeq, NULL, 0);
+			return;
+		}
+		Mod_EmitStr(t, "\r\nERROR\r\n");
+		break;
+
+	case MOD_OP_RESET:
+		Mod_Restart(t);
+		Mod_EmitStr(t, "\r\nAPP Reset-APP SW Reset\r\n");
+		break;
+
+	case MOD_OP_BOOT:
+		Mod_EmitStr(t, "\r\nSerial2WiFi APP\r\n");
+		break;
+
+	default:
+		break;
+	}
+
+	Mod->busy = 0;
+	Mod->op = MOD_OP_NONE;
+	Mod_Run(t);
+}
+
+/**
+ *  @brief  Prepare reply which is sent when command is done
+ *
+ *  @param  Virtual time
+ *  @param  Processing time of the command
+ *  @param  Reply format
+ *
+ *  @return void
+ */
+static void Mod_Reply(uint64_t t, uint64_t delay, const char* fmt, ...){
+	va_list args;
+
+	va_start(args, fmt);
+	vsnprintf(Mod->reply, sizeof(Mod->reply), fmt, args);
+	va_end(args);
+
+	Mod->busy = 1;
+	Mod->op = MOD_OP_REPLY;
+	Emu_EventPost(t + delay, EMU_EV_MODULE_OP, 0, ++ Mod->opSeq, NULL, 0);
+}
+
+/**
+ *  @brief  Send bytes to board on module line
+ *
+ *  Bytes sent on other rate than board uses are lost.
+ *
+ *  @param  Virtual time
+ *  @param  Data
+ *  @param  Number of bytes
+ *
+ *  @return void
+ */
+static void Mod_Emit(uint64_t t, const void* data, uint32_t len){
+	const uint8_t* p = data;
+	uint32_t baud = Mod_Baud(t);
+	uint64_t start = (Mod->lineFree > t) ? Mod->lineFree : t;
+	uint32_t i;
+
+	Mod->lineFree = start + ((uint64_t) len * 10 * 1000000 + baud - 1) / baud;
+	Mod->lastActivity = Mod->lineFree;
+
+	if (baud != Mod->hostBaud)
+		return;
+
+	for (i = 0; i < len; i ++)
+	{
+		// board has not read for a long time, oldest bytes are overwritten
+		if (Mod->linkHead - Mod->linkTail == MOD_LINK_SIZE)
+		{
+			Mod->linkTail ++;
+			Mod->stats.rxLost ++;
+		}
+		Mod->link[Mod->linkHead % MOD_LINK_SIZE] = p[i];
+		Mod->linkTime[Mod->linkHead % MOD_LINK_SIZE] = start + ((uint64_t) (i + 1) * 10 * 1000000 + baud - 1) / baud;
+		Mod->linkHead ++;
+	}
+}
+
+static void Mod_EmitStr(uint64_t t, const char* str){
+	Mod_Emit(t, str, strlen(str));
+}
+
+/**
+ *  @brief  Get module baud rate, rate change takes effect when the reply is sent
+ *
+ *  @param  Virtual time
+ *
+ *  @return Baud rate
+ */
+static uint32_t Mod_Baud(uint64_t t){
+	if (Mod->baudAt && (t >= Mod->baudAt))
+	{
+		Mod->baud = Mod->nextBaud;
+		Mod->nextBaud = 0;
+		Mod->baudAt = 0;
+	}
+	return Mod->baud;
+}
+
+static int Mod_AllocCid(){
+	int cid;
+
+	for (cid = 0; cid < EMU_CIDS; cid ++)
+		if (!Mod->cids[cid].used)
+			return cid;
+	return -1;
+}
+
+static void Mod_CloseCid(uint8_t cid){
+	if (Mod->cids[cid].used && (Mod->cids[cid].server != EMU_SERVER_NONE))
+		Emu_NetClose(cid);
+	memset(&Mod->cids[cid], 0, sizeof(Mod_Cid_t));
+}
+
+/**
+ *  @brief  Module restart (reset pin or AT+RESET)
+ *
+ *  Sockets are closed, association, certificates in ram and settings are lost.
+ *
+ *  @param  Virtual time
+ *
+ *  @return void
+ */
+static void Mod_Restart(uint64_t t){
+	int cid;
+
+	for (cid = 0; cid < EMU_CIDS; cid ++)
+		Mod_CloseCid(cid);
+
+	Mod->baud = GS_HAL_BAUD_DEFAULT;
+	Mod->nextBaud = 0;
+	Mod->baudAt = 0;
+	Mod->lineFree = t;
+	Mod->inTail = Mod->inHead;
+	Mod->rx = MOD_RX_LINE;
+	Mod->lineLen = 0;
+	Mod->echo = 1;
+	Mod->busy = 0;
+	Mod->op = MOD_OP_NONE;
+	Mod->opSeq ++;
+	Mod->associated = 0;
+	Mod->passphrase[0] = 0;
+	Mod->certSize = 0;
+	Mod->certLen = 0;
+	Mod->clockBase = 0;
+	Mod->clockSetAt = t;
+	Mod->nextNormal = 0;
+}
+
+static char Mod_Hex(uint8_t cid){
+	return "0123456789ABCDEF"[cid & 0x0F];
+}
+
+/**
+ *  @brief  Format module clock as dd/mm/yyyy,HH:MM:SS
+ *
+ *  @param  Miliseconds since epoch
+ *  @param  Output text
+ *
+ *  @return void
+ */
+static void Mod_FormatClock(uint64_t ms, char* txt){
+	time_t sec = ms / 1000;
+	struct tm tm;
+
+	gmtime_r(&sec, &tm);
+	sprintf(txt, "%02d/%02d/%04d,%02d:%02d:%02d", tm.tm_mday, tm.tm_mon + 1, tm.tm_year + 1900,
+				tm.tm_hour, tm.tm_min, tm.tm_sec);
+}
+
+/**
+ *  @brief  Read bytes which arrived on board before the current ms
+ *
+ *  Unread bytes filling the whole uart ring are discarded (UART_RxUpdate).
+ *
+ *  @param  Pointer to input buffer
+ *  @param  Number of bytes to read
+ *
+ *  @return Number of bytes read
+ */
+static uint32_t Mod_LinkRead(uint8_t* dst, uint32_t size){
+	uint64_t visible;
+	uint32_t avail, read = 0;
+
+	Sim_Step(SIM_UART_POLL_US);
+	visible = Sim_Now() / 1000 * 1000;
+
+	for (avail = 0; Mod->linkTail + avail != Mod->linkHead; avail ++)
+		if (Mod->linkTime[(Mod->linkTail + avail) % MOD_LINK_SIZE] >= visible)
+			break;
+
+	if (avail >= UART_RX_RING_SIZE)
+	{
+		Mod->stats.rxOverruns ++;
+		Mod->stats.rxLost += avail;
+		Mod->linkTail += avail;
+		return 0;
+	}
+
+	while (size && avail)
+	{
+		*dst ++ = Mod->link[Mod->linkTail ++ % MOD_LINK_SIZE];
+		size --;
+		avail --;
+		read ++;
+	}
+	return read;
+}
+
+/**
+ *  @brief  Record board uart traffic (UART_CaptureRecord format)
+ *
+ *  @param  Direction, UART_CAPTURE_TX or 0 for received data
+ *  @param  Pointer to data
+ *  @param  Number of bytes
+ *
+ *  @return void
+ */
+static void Mod_CaptureRecord(uint8_t dir, const uint8_t* data, uint32_t len){
+	uint32_t time = Sim_Millis();
+	uint8_t* p;
+
+	if (!Mod->capturing || (len == 0))
+		return;
+
+	if (Mod->captureUsed + UART_CAPTURE_HEADER + len > EMU_CAPTURE_SIZE)
+	{
+		printf("capture buffer is full\n");
+		Sim_Exit(2);
+	}
+
+	p = &Emu_Capture[Mod->captureUsed];
+	p[0] = time;
+	p[1] = time >> 8;
+	p[2] = time >> 16;
+	p[3] = time >> 24;
+	p[4] = len;
+	p[5] = (len >> 8) | dir;
+	memcpy(p + UART_CAPTURE_HEADER, data, len);
+	Mod->captureUsed += UART_CAPTURE_HEADER + len;
+}
@@ -0,0 +1,720 @@
+/** @file   S2W_Network.c
+ *  @brief  Emulated network behind the S2W module: event queue, tcp model, mqtt broker and http server.
+ *
+ *  		Segment is lost with configured probability, sender retransmits it
+ *  		after retransmission timeout which doubles on every retry. Segments of
+ *  		one direction arrive in order. Socket fails when retransmissions take
+ *  		longer than its TCP_MAXRT. Arrival time of a segment is computed when it
+ *  		is sent, so the loss sequence depends on the order of sends only.
+ *
+ *  		Broker checks credentials of the board and answers connect, subscribe,
+ *  		unsubscribe, QoS 1 publish and ping. Http server answers /ping with
+ *  		server time and /cacert.der with the certificate which signed the
+ *  		broker certificate (it differs from the one the board is flashed with).
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "GS/GS_User/GS_Certificate.h"
+#include "MQTT/MQTT_paho/MQTTPacket.h"
+
+#include "../Sim/Sim.h"
+#include "S2W_Emulator.h"
+
+
+#define NET_EVENTS				512
+#define NET_NEVER				UINT64_MAX
+#define NET_BROKER_RX			4096				// mqtt stream reassembly
+#define NET_TOPICS				16					// topics in one subscribe
+
+typedef struct {
+	uint64_t time;
+	uint32_t seq;
+	uint8_t  used;
+	uint8_t  type;
+	uint8_t  cid;
+	uint32_t arg;
+	uint32_t len;
+	uint8_t  data[EMU_SEGMENT_MAX];
+} Net_Event_t;
+
+typedef struct {
+	uint8_t      open;
+	uint32_t     gen;						// stale events of closed connection are dropped
+	Emu_Server_t server;
+	uint32_t     maxRT;						// seconds
+	uint32_t     inflight;					// bytes sent up and not acknowledged
+	uint64_t     lastArrival[2];			// in order delivery per direction
+	uint8_t      failing;					// retransmission limit is reached, failure is queued
+	uint8_t      mqttConnected;
+	uint8_t      rx[NET_BROKER_RX];
+	uint32_t     rxLen;
+} Net_Socket_t;
+
+typedef struct {
+	Net_Event_t  events[NET_EVENTS];
+	uint32_t     queued;
+	uint32_t     seq;
+	uint64_t     next;						// time of the earliest event
+
+	Net_Socket_t sockets[EMU_CIDS];
+	uint32_t     loss;						// per thousand
+	uint8_t      unreachable;
+	uint32_t     random;
+
+	Emu_NetStats_t    stats;
+	Emu_BrokerStats_t broker;
+	char         watchTopic[64];
+	uint8_t      watched[NET_BROKER_RX];	// payload of the last publish on watched topic
+	int          watchedLen;
+} Emu_Net_t;
+
+static Emu_Net_t* Net;
+
+
+// static declarations
+
+static void Net_Dispatch(Net_Event_t* ev);
+static void Net_Segment(uint64_t t, uint8_t cid, Emu_Dir_t dir, const uint8_t* data, uint32_t len);
+static bool Net_Lost();
+static uint32_t Net_Arg(uint8_t cid, Emu_Dir_t dir);
+static bool Net_Current(uint8_t cid, uint32_t arg);
+static void Net_BrokerData(uint64_t t, uint8_t cid, const uint8_t* data, uint32_t len);
+static void Net_BrokerPacket(uint64_t t, uint8_t cid, uint8_t* packet, int len);
+static bool Net_ParseConnect(uint8_t* packet, int len, MQTTString* user, MQTTString* pass);
+static void Net_HttpRequest(uint64_t t, uint8_t cid, const uint8_t* data, uint32_t len);
+static const uint8_t* Net_ServerCert(uint32_t* len);
+static int  Net_MqttCid();
+
+
+
+
+	///////////////////////////////////////
+	/*         public functions          */
+	///////////////////////////////////////
+
+
+
+void Emu_NetInit(){
+	Net = Sim_SharedAlloc(sizeof(Emu_Net_t));
+	Net->next = NET_NEVER;
+	Net->random = 0x2545F491;
+	Net->broker.lastPubackId = -1;
+}
+
+void Emu_EventPost(uint64_t t, Emu_EventType_t type, uint8_t cid, uint32_t arg, const uint8_t* data, uint32_t len){
+	Net_Event_t* ev = NULL;
+	int i;
+
+	for (i = 0; i < NET_EVENTS; i ++)
+	{
+		if (!Net->events[i].used)
+		{
+			ev = &Net->events[i];
+			break;
+		}
+	}
+	if ((ev == NULL) || (len > EMU_SEGMENT_MAX))
+	{
+		printf("emulator event queue is full\n");
+		Sim_Exit(2);
+	}
+
+	ev->used = 1;
+	ev->time = t;
+	ev->seq = Net->seq ++;
+	ev->type = type;
+	ev->cid = cid;
+	ev->arg = arg;
+	ev->len = len;
+	if (data)
+		memcpy(ev->data, data, len);
+
+	if (++ Net->queued > Net->stats.events)
+		Net->stats.events = Net->queued;
+	if (t < Net->next)
+		Net->next = t;
+}
+
+void Emu_NetAdvance(uint64_t now){
+	Net_Event_t* ev;
+	int i;
+
+	while (Net->next <= now)
+	{
+		// earliest event, queued first on equal times
+		ev = NULL;
+		for (i = 0; i < NET_EVENTS; i ++)
+		{
+			if (Net->events[i].used && ((ev == NULL) || (Net->events[i].time < ev->time) ||
+					((Net->events[i].time == ev->time) && ((int32_t) (Net->events[i].seq - ev->seq) < 0))))
+				ev = &Net->events[i];
+		}
+
+		Net_Dispatch(ev);
+		ev->used = 0;
+		Net->queued --;
+
+		Net->next = NET_NEVER;
+		for (i = 0; i < NET_EVENTS; i ++)
+			if (Net->events[i].used && (Net->events[i].time < Net->next))
+				Net->next = Net->events[i].time;
+	}
+}
+
+Emu_Server_t Emu_NetResolve(const char* ip, int port){
+	if (strcmp(ip, EMU_SERVER_IP) != 0)
+		return EMU_SERVER_NONE;
+	if (port == EMU_MQTT_PORT)
+		return EMU_SERVER_MQTT;
+	if (port == EMU_HTTP_PORT)
+		return EMU_SERVER_HTTP;
+	return EMU_SERVER_NONE;
+}
+
+bool Emu_NetReachable(){
+	return !Net->unreachable;
+}
+
+bool Emu_NetConnectAttempt(){
+	if (Net_Lost() || Net_Lost())
+	{
+		Net->stats.connectFails ++;
+		return false;
+	}
+	return true;
+}
+
+void Emu_NetOpen(uint8_t cid, Emu_Server_t server){
+	Net_Socket_t* s = &Net->sockets[cid];
+	uint32_t gen = s->gen + 1;
+
+	memset(s, 0, sizeof(Net_Socket_t));
+	s->gen = gen;
+	s->open = 1;
+	s->server = server;
+	s->maxRT = EMU_MAXRT_DEFAULT;
+}
+
+void Emu_NetClose(uint8_t cid){
+	Net_Socket_t* s = &Net->sockets[cid];
+
+	s->open = 0;
+	s->gen ++;
+	s->mqttConnected = 0;
+	s->rxLen = 0;
+}
+
+void Emu_NetSetMaxRT(uint8_t cid, uint32_t seconds){
+	Net->sockets[cid].maxRT = seconds;
+}
+
+bool Emu_NetSend(uint64_t t, uint8_t cid, Emu_Dir_t dir, const uint8_t* data, uint32_t len){
+	Net_Socket_t* s = &Net->sockets[cid];
+	uint64_t delay = 0, rto = EMU_RTO_US, arrival;
+
+	if (!s->open || (len > EMU_SEGMENT_MAX))
+		return false;
+	if ((dir == EMU_DIR_UP) && (s->inflight + len > EMU_SNDBUF))
+		return false;
+
+	Net->stats.sent ++;
+
+	while (Net_Lost())
+	{
+		Net->stats.retransmits ++;
+		delay += rto;
+		rto *= 2;
+
+		if (delay > (uint64_t) s->maxRT * 1000000)
+		{
+			// sender gives up, module reports failure of its socket; data is never
+			// acknowledged, so send buffer fills meanwhile
+			if (dir == EMU_DIR_UP)
+			{
+				s->inflight += len;
+				if (!s->failing)
+				{
+					s->failing = 1;
+					Emu_EventPost(t + (uint64_t) s->maxRT * 1000000, EMU_EV_SOCKET_FAIL, cid, Net_Arg(cid, dir), NULL, 0);
+				}
+			}
+			return true;
+		}
+	}
+
+	arrival = t + delay + EMU_RTT_US / 2;
+	if (arrival < s->lastArrival[dir])
+		arrival = s->lastArrival[dir];
+	s->lastArrival[dir] = arrival;
+
+	if (dir == EMU_DIR_UP)
+	{
+		s->inflight += len;
+		Emu_EventPost(arrival + EMU_RTT_US / 2, EMU_EV_ACK, cid, Net_Arg(cid, dir), NULL, len);
+	}
+	Emu_EventPost(arrival, EMU_EV_SEGMENT, cid, Net_Arg(cid, dir), data, len);
+
+	return true;
+}
+
+void Emu_NetDrop(uint8_t cid){
+	Emu_ModuleSocketClosed(Sim_Now(), cid);
+}
+
+void Emu_NetSetLoss(uint32_t permille){
+	Net->loss = permille;
+}
+
+void Emu_NetSetReachable(bool reachable){
+	Net->unreachable = !reachable;
+}
+
+bool Emu_NetCertValid(const uint8_t* cert, uint32_t len){
+	uint32_t serverLen;
+	const uint8_t* server = Net_ServerCert(&serverLen);
+
+	return (len == serverLen) && (memcmp(cert, server, len) == 0);
+}
+
+void Emu_NetGetStats(Emu_NetStats_t* stats){
+	*stats = Net->stats;
+}
+
+bool Emu_BrokerPublish(const char* topic, const uint8_t* payload, int len, int id){
+	MQTTString topicString = MQTTString_initializer;
+	uint8_t packet[EMU_SEGMENT_MAX];
+	int cid = Net_MqttCid();
+	int size;
+
+	if (cid < 0)
+		return false;
+
+	topicString.cstring = (char*) topic;
+	size = MQTTSerialize_publish((char*) packet, sizeof(packet), 0, 1, 0, id, topicString, (char*) payload, len);
+	if (size <= 0)
+		return false;
+
+	return Emu_NetSend(Sim_Now(), cid, EMU_DIR_DOWN, packet, size);
+}
+
+bool Emu_BrokerSendPacket(const uint8_t* packet, int len){
+	int cid = Net_MqttCid();
+
+	if (cid < 0)
+		return false;
+
+	return Emu_NetSend(Sim_Now(), cid, EMU_DIR_DOWN, packet, len);
+}
+
+bool Emu_BrokerConnected(){
+	return Net_MqttCid() >= 0;
+}
+
+void Emu_BrokerGetStats(Emu_BrokerStats_t* stats){
+	*stats = Net->broker;
+}
+
+void Emu_BrokerWatch(const char* topic){
+	snprintf(Net->watchTopic, sizeof(Net->watchTopic), "%s", topic);
+	Net->watchedLen = -1;
+}
+
+int Emu_BrokerWatched(uint8_t* payload, int size){
+	int len = (Net->watchedLen < size) ? Net->watchedLen : size;
+
+	if (len > 0)
+		memcpy(payload, Net->watched, len);
+	return len;
+}
+
+
+
+
+	///////////////////////////////////////
+	/*         static functions          */
+	///////////////////////////////////////
+
+
+
+/**
+ *  @brief  Serve event
+ *
+ *  @param  Event
+ *
+ *  @return void
+ */
+static void Net_Dispatch(Net_Event_t* ev){
+	Net_Socket_t* s = &Net->sockets[ev->cid];
+
+	switch (ev->type)
+	{
+	case EMU_EV_HOST_DATA:
+	case EMU_EV_MODULE_OP:
+		Emu_ModuleEvent(ev->time, ev->type, ev->arg, ev->data, ev->len);
+		break;
+
+	case EMU_EV_SEGMENT:
+		if (Net_Current(ev->cid, ev->arg))
+			Net_Segment(ev->time, ev->cid, ev->arg & 1, ev->data, ev->len);
+		break;
+
+	case EMU_EV_ACK:
+		if (Net_Current(ev->cid, ev->arg))
+			s->inflight -= ev->len;
+		break;
+
+	case EMU_EV_SOCKET_FAIL:
+		if (Net_Current(ev->cid, ev->arg))
+		{
+			Net->stats.failures ++;
+			Emu_ModuleSocketFailure(ev->time, ev->cid);
+		}
+		break;
+	}
+}
+
+/**
+ *  @brief  Segment arrives at its receiver
+ *
+ *  @param  Virtual time
+ *  @param  Connection id
+ *  @param  Direction
+ *  @param  Data
+ *  @param  Number of bytes
+ *
+ *  @return void
+ */
+static void Net_Segment(uint64_t t, uint8_t cid, Emu_Dir_t dir, const uint8_t* data, uint32_t len){
+	if (dir == EMU_DIR_DOWN)
+		Emu_ModuleSocketData(t, cid, data, len);
+	else if (Net->sockets[cid].server == EMU_SERVER_MQTT)
+		Net_BrokerData(t, cid, data, len);
+	else if (Net->sockets[cid].server == EMU_SERVER_HTTP)
+		Net_HttpRequest(t, cid, data, len);
+}
+
+/**
+ *  @brief  Decide if next segment is lost (xorshift)
+ *
+ *  @return True if lost
+ */
+static bool Net_Lost(){
+	uint32_t x = Net->random;
+
+	if (Net->unreachable)
+		return true;
+	if (Net->loss == 0)
+		return false;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	Net->random = x;
+
+	return (x % 1000) < Net->loss;
+}
+
+static uint32_t Net_Arg(uint8_t cid, Emu_Dir_t dir){
+	return (Net->sockets[cid].gen << 1) | dir;
+}
+
+static bool Net_Current(uint8_t cid, uint32_t arg){
+	return Net->sockets[cid].open && ((arg >> 1) == Net->sockets[cid].gen);
+}
+
+/**
+ *  @brief  Reassemble mqtt packets from the stream of the board
+ *
+ *  @param  Virtual time
+ *  @param  Connection id
+ *  @param  Data
+ *  @param  Number of bytes
+ *
+ *  @return void
+ */
+static void Net_BrokerData(uint64_t t, uint8_t cid, const uint8_t* data, uint32_t len){
+	Net_Socket_t* s = &Net->sockets[cid];
+	uint32_t remaining, mult, pos, size;
+
+	if (s->rxLen + len > NET_BROKER_RX)
+	{
+		Net->broker.bad ++;
+		s->rxLen = 0;
+		return;
+	}
+	memcpy(&s->rx[s->rxLen], data, len);
+	s->rxLen += len;
+
+	for (;;)
+	{
+		// fixed header, remaining length is encoded in up to 4 bytes
+		remaining = 0;
+		mult = 1;
+		for (pos = 1; pos < s->rxLen; pos ++)
+		{
+			remaining += (s->rx[pos] & 0x7F) * mult;
+			mult *= 128;
+			if (((s->rx[pos] & 0x80) == 0) || (pos == 4))
+				break;
+		}
+		if (pos >= s->rxLen)
+			return;
+
+		size = pos + 1 + remaining;
+		if (size > s->rxLen)
+			return;
+
+		Net_BrokerPacket(t, cid, s->rx, size);
+
+		if (!s->open)
+			return;
+		s->rxLen -= size;
+		memmove(s->rx, &s->rx[size], s->rxLen);
+	}
+}
+
+/**
+ *  @brief  Answer mqtt packet of the board
+ *
+ *  @param  Virtual time
+ *  @param  Connection id
+ *  @param  Packet
+ *  @param  Packet length
+ *
+ *  @return void
+ */
+static void Net_BrokerPacket(uint64_t t, uint8_t cid, uint8_t* packet, int len){
+	Net_Socket_t* s = &Net->sockets[cid];
+	MQTTHeader header;
+	MQTTString user, pass, topic, topics[NET_TOPICS];
+	int qos[NET_TOPICS];
+	uint8_t reply[64];
+	unsigned char* payload;
+	int dup, retained, id, count, size = 0, i, plen;
+	bool ok;
+
+	header.byte = packet[0];
+
+	switch (header.bits.type)
+	{
+	case CONNECT:
+		if (!Net_ParseConnect(packet, len, &user, &pass))
+		{
+			Net->broker.bad ++;
+			break;
+		}
+		ok = (user.lenstring.len == strlen(SIM_DEVICE_ID)) &&
+				(memcmp(user.lenstring.data, SIM_DEVICE_ID, strlen(SIM_DEVICE_ID)) == 0) &&
+				(pass.lenstring.len == strlen(SIM_DEVICE_SECURITY)) &&
+				(memcmp(pass.lenstring.data, SIM_DEVICE_SECURITY, strlen(SIM_DEVICE_SECURITY)) == 0);
+		if (ok)
+		{
+			Net->broker.connects ++;
+			s->mqttConnected = 1;
+		}
+		else
+			Net->broker.rejects ++;
+		size = MQTTSerialize_connack((char*) reply, sizeof(reply), ok ? 0 : 5);
+		break;
+
+	case PUBLISH:
+		if (MQTTDeserialize_publish(&dup, &qos[0], &retained, &id, &topic, (char**) &payload, &plen, (char*) packet, len) != 1)
+		{
+			Net->broker.bad ++;
+			break;
+		}
+		Net->broker.publishes ++;
+		Net->broker.publishBytes += plen;
+		if ((uint32_t) plen > Net->broker.maxPublishLen)
+			Net->broker.maxPublishLen = plen;
+		if (Net->watchTopic[0] && MQTTPacket_equals(&topic, Net->watchTopic))
+		{
+			memcpy(Net->watched, payload, plen);
+			Net->watchedLen = plen;
+		}
+		if (qos[0] == 1)
+			size = MQTTSerialize_puback((char*) reply, sizeof(reply), id);
+		break;
+
+	case PUBACK:
+		if (MQTTDeserialize_ack(&i, &dup, &id, (char*) packet, len) != 1)
+		{
+			Net->broker.bad ++;
+			break;
+		}
+		Net->broker.pubacks ++;
+		Net->broker.lastPubackId = id;
+		break;
+
+	case SUBSCRIBE:
+		if (MQTTDeserialize_subscribe(&dup, &id, NET_TOPICS, &count, topics, qos, (char*) packet, len) != 1)
+		{
+			Net->broker.bad ++;
+			break;
+		}
+		for (i = 0; i < count; i ++)
+			qos[i] = (qos[i] > 1) ? 1 : qos[i];
+		Net->broker.subscribes += count;
+		size = MQTTSerialize_suback((char*) reply, sizeof(reply), id, count, qos);
+		break;
+
+	case UNSUBSCRIBE:
+		if (MQTTDeserialize_unsubscribe(&dup, &id, NET_TOPICS, &count, topics, (char*) packet, len) != 1)
+		{
+			Net->broker.bad ++;
+			break;
+		}
+		Net->broker.unsubscribes += count;
+		size = MQTTSerialize_unsuback((char*) reply, sizeof(reply), id);
+		break;
+
+	case PINGREQ:
+		Net->broker.pings ++;
+		reply[0] = PINGRESP << 4;
+		reply[1] = 0;
+		size = 2;
+		break;
+
+	case DISCONNECT:
+		s->mqttConnected = 0;
+		break;
+
+	default:
+		Net->broker.bad ++;
+		break;
+	}
+
+	if (size > 0)
+		Emu_NetSend(t, cid, EMU_DIR_DOWN, reply, size);
+}
+
+/**
+ *  @brief  Get credentials from connect packet
+ *
+ *  MQTTDeserialize_connect of the paho copy rejects every protocol name
+ *  (MQTTPacket_checkVersion), so packet is parsed here.
+ *
+ *  @param  Packet
+ *  @param  Packet length
+ *  @param  Return user name (empty if not present)
+ *  @param  Return password (empty if not present)
+ *
+ *  @return False if packet is malformed
+ */
+static bool Net_ParseConnect(uint8_t* packet, int len, MQTTString* user, MQTTString* pass){
+	MQTTConnectFlags flags;
+	MQTTString field;
+	char* p = (char*) packet + 1;
+	char* end = (char*) packet + len;
+	int remaining;
+
+	memset(user, 0, sizeof(MQTTString));
+	memset(pass, 0, sizeof(MQTTString));
+
+	p += MQTTPacket_decodeBuf(p, &remaining);
+	if (!readMQTTLenString(&field, &p, end) || (end - p < 4))		// protocol name
+		return false;
+
+	readChar(&p);													// version
+	flags.all = readChar(&p);
+	readInt(&p);													// keep alive
+
+	if (!readMQTTLenString(&field, &p, end))						// client id
+		return false;
+	if (flags.bits.will && (!readMQTTLenString(&field, &p, end) || !readMQTTLenString(&field, &p, end)))
+		return false;
+	if (flags.bits.username && !readMQTTLenString(user, &p, end))
+		return false;
+	if (flags.bits.password && !readMQTTLenString(pass, &p, end))
+		return false;
+
+	return true;
+}
+
+/**
+ *  @brief  Answer http GET request (page sent by AT+HTTPSEND)
+ *
+ *  Response is sent in one segment.
+ *
+ *  @param  Virtual time
+ *  @param  Connection id
+ *  @param  Page
+ *  @param  Page length
+ *
+ *  @return void
+ */
+static void Net_HttpRequest(uint64_t t, uint8_t cid, const uint8_t* data, uint32_t len){
+	uint8_t response[EMU_SEGMENT_MAX];
+	const uint8_t* cert;
+	uint32_t certLen;
+	time_t sec = (EMU_TIME_BASE_MS + t / 1000) / 1000;
+	struct tm tm;
+	int size;
+
+	if ((len == 5) && (memcmp(data, "/ping", 5) == 0))
+	{
+		gmtime_r(&sec, &tm);
+		size = sprintf((char*) response, "200 OK\r\nrelayr ping (UTC)%02d/%02d/%04d,%02d:%02d:%02d",
+						tm.tm_mday, tm.tm_mon + 1, tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec);
+	}
+	else if ((len == 11) && (memcmp(data, "/cacert.der", 11) == 0))
+	{
+		cert = Net_ServerCert(&certLen);
+		memcpy(response, "200 OK\r\n", 8);
+		memcpy(&response[8], cert, certLen);
+		size = 8 + certLen;
+	}
+	else
+	{
+		size = sprintf((char*) response, "404 Not Found\r\n");
+	}
+
+	Emu_NetSend(t, cid, EMU_DIR_DOWN, response, size);
+}
+
+/**
+ *  @brief  Get certificate which signed the broker certificate
+ *
+ *  It is the factory certificate renewed (last byte of signature differs),
+ *  so board has to download it before ssl connection succeeds.
+ *
+ *  @param  Return certificate length
+ *
+ *  @return Certificate (der)
+ */
+static const uint8_t* Net_ServerCert(uint32_t* len){
+	static uint8_t cert[sizeof(uint32_t) + 2048];
+	uint32_t size;
+
+	memcpy(&size, cacert, sizeof(size));
+	if (size > sizeof(cert))
+		size = sizeof(cert);
+
+	memcpy(cert, &cacert[sizeof(uint32_t)], size);
+	cert[size - 1] ^= 0x5A;
+
+	*len = size;
+	return cert;
+}
+
+/**
+ *  @brief  Get connection with established mqtt session
+ *
+ *  @return Connection id, -1 if there is none
+ */
+static int Net_MqttCid(){
+	int cid;
+
+	for (cid = 0; cid < EMU_CIDS; cid ++)
+		if (Net->sockets[cid].open && Net->sockets[cid].mqttConnected)
+			return cid;
+	return -1;
+}
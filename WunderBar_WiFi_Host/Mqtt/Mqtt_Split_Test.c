@@ -0,0 +1,373 @@
+/** @file   Mqtt_Split_Test.c
+ *  @brief  Host fuzz test and benchmark of incoming mqtt stream decoder (GS_TCP_mqtt.c).
+ *
+ *  		Stream of mqtt packets is offered to tcp data handler split at every byte
+ *  		boundary (and at random ones), the way AT lib does it: bytes which are not
+ *  		taken are offered again on next receive. Mqtt client is simulated by
+ *  		Sim_Process, which takes and releases received packets and compares them
+ *  		with the packets which were sent.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "GS/GS_User/GS_TCP_mqtt.c"
+
+
+// simulated environment
+
+#define SIM_CID					3
+#define SIM_STREAM_MAX			(256 * 1024)
+#define SIM_PACKETS_MAX			8192
+
+static GS_API_DataHandler Sim_Handler;
+static uint8_t  Sim_Stream[SIM_STREAM_MAX];		// packets as sent by mqtt server
+static uint32_t Sim_StreamLen;
+static uint32_t Sim_Start[SIM_PACKETS_MAX];		// packet positions in stream
+static uint32_t Sim_Len[SIM_PACKETS_MAX];
+static bool     Sim_Big[SIM_PACKETS_MAX];		// bigger than ring, must be dropped
+static int      Sim_Packets;
+static int      Sim_Next;						// next packet expected by mqtt client
+static int      Sim_Bad;						// packets different from the sent ones
+static bool     Sim_Hold;						// client is processing a packet (nested receive)
+static bool     Sim_Compare;
+static int      Test_Failed;
+
+#define CHECK(cond)		do { if (!(cond)) { printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); Test_Failed ++; } } while (0)
+
+unsigned long long int MSTimerGet(){ return 0; }
+unsigned long long int MSTimerDelta(unsigned long long int timer){ return 0; }
+
+void GS_Api_TCP_StartTcpClient(char* cid, char* serverIp, char* serverPort, GS_API_DataHandler DataHandler){
+	*cid = SIM_CID;
+	Sim_Handler = DataHandler;
+}
+
+bool GS_Api_TCP_SendSpans(char cid, const ATLIB_DATA_SPAN_T* spans, uint8_t numSpans){ return true; }
+void GS_Api_Disconnect(char cid){}
+bool GS_API_CloseSSLconnection(uint8_t cid){ return true; }
+bool GS_API_CommWorking(){ return true; }
+void GS_ProcessMqttDisconnect(){}
+
+/**
+*  @brief  Mqtt client: takes all received packets and checks them
+*/
+static void Sim_Process(){
+	char* packet;
+	int len;
+
+	if (Sim_Hold)
+		return;
+
+	while (GS_TCP_mqtt_GetPacket(&packet, &len))
+	{
+		while ((Sim_Next < Sim_Packets) && (Sim_Big[Sim_Next]))
+			Sim_Next ++;
+
+		if (Sim_Compare)
+		{
+			if ((Sim_Next >= Sim_Packets) || ((uint32_t) len != Sim_Len[Sim_Next]) ||
+					((uint8_t *) packet + len > &Client_TCP_Buffer.line[MQTT_RX_RING_SIZE]) ||
+					(memcmp(packet, &Sim_Stream[Sim_Start[Sim_Next]], len) != 0))
+				Sim_Bad ++;
+		}
+		Sim_Next ++;
+		GS_TCP_mqtt_ReleasePacket();
+	}
+}
+
+void GS_ProcessMqttData(){
+	Sim_Process();
+}
+
+/**
+*  @brief  Appends mqtt packet to stream
+*
+*  @param  Packet type (upper nibble of first byte)
+*  @param  Remaining length
+*/
+static void Sim_AddPacket(uint8_t type, uint32_t remaining){
+	uint8_t* p = &Sim_Stream[Sim_StreamLen];
+	uint32_t len = remaining, i;
+
+	*p++ = (type << 4) | (rand() & 0x0F);
+	do
+	{
+		*p = len & 127;
+		len >>= 7;
+		if (len)
+			*p |= 128;
+		p ++;
+	} while (len);
+
+	for (i = 0; i < remaining; i ++)
+		*p++ = rand();
+
+	Sim_Start[Sim_Packets] = Sim_StreamLen;
+	Sim_Len[Sim_Packets] = p - &Sim_Stream[Sim_StreamLen];
+	Sim_Big[Sim_Packets] = (Sim_Len[Sim_Packets] > MQTT_RX_RING_SIZE);
+	Sim_StreamLen += Sim_Len[Sim_Packets];
+	Sim_Packets ++;
+}
+
+/**
+*  @brief  Builds stream of random packets
+*
+*  Remaining length uses 1 to 3 bytes, some packets have no body and some
+*  are bigger than the ring.
+*
+*  @param  Number of packets
+*  @param  Max remaining length
+*/
+static void Sim_BuildStream(int packets, uint32_t maxLen){
+	Sim_StreamLen = 0;
+	Sim_Packets = 0;
+
+	while ((Sim_Packets < packets) && (Sim_StreamLen + maxLen + 8 < SIM_STREAM_MAX))
+	{
+		switch (rand() % 8)
+		{
+		case 0 :  Sim_AddPacket(13, 0); break;							// PINGRESP
+		case 1 :  Sim_AddPacket(2, 2); break;							// CONNACK
+		case 2 :  Sim_AddPacket(4, 2); break;							// PUBACK
+		case 3 :  Sim_AddPacket(3, 127 + rand() % 200); break;			// two byte length
+		default : Sim_AddPacket(3, rand() % (maxLen + 1)); break;
+		}
+	}
+}
+
+/**
+*  @brief  Starts new connection, all packets are expected again
+*/
+static void Sim_Connect(){
+	GS_TCP_mqtt_StartTcpTask("1.2.3.4", "8883");
+	Sim_Next = 0;
+	Sim_Bad = 0;
+	Sim_Hold = false;
+	Sim_Compare = true;
+}
+
+/**
+*  @brief  Offers part of stream to data handler like AT lib does
+*
+*  Bytes not taken are offered again, after held packet is released
+*  (end of nested processing) and received packets are processed.
+*
+*  @param  Stream position
+*  @param  Number of bytes
+*
+*  @return Number of times data was not taken at once
+*/
+static uint32_t Sim_Receive(uint32_t from, uint32_t len){
+	uint32_t used, stalls = 0;
+
+	while (len)
+	{
+		used = Sim_Handler(SIM_CID, &Sim_Stream[from], len);
+		if (used > len)
+			used = len;
+		if (used < len)
+		{
+			stalls ++;
+			if (stalls > 2 * SIM_PACKETS_MAX)
+				return stalls;							// no progress
+			Sim_Hold = false;
+			Sim_Process();
+		}
+		from += used;
+		len -= used;
+	}
+	return stalls;
+}
+
+/**
+*  @brief  Checks that every packet which fits in ring was received once and unchanged
+*/
+static bool Sim_AllReceived(){
+	Sim_Hold = false;
+	Sim_Process();
+	while ((Sim_Next < Sim_Packets) && (Sim_Big[Sim_Next]))
+		Sim_Next ++;
+
+	return (Sim_Bad == 0) && (Sim_Next == Sim_Packets) &&
+			(Client_TCP_Buffer.state == RX_STATE_TYPE) && (Client_TCP_Buffer.busy == 0) &&
+			(Client_TCP_Buffer.packetHead == Client_TCP_Buffer.packetTail);
+}
+
+
+// tests
+
+/** @brief Stream split in two at every byte boundary */
+static void Test_SplitOnce(){
+	uint32_t i;
+	int fails = 0;
+
+	srand(1);
+	Sim_BuildStream(40, 300);
+
+	for (i = 0; i <= Sim_StreamLen; i ++)
+	{
+		Sim_Connect();
+		Sim_Receive(0, i);
+		Sim_Process();								// end of bulk transfer
+		Sim_Receive(i, Sim_StreamLen - i);
+		if (Sim_AllReceived() == false)
+			fails ++;
+	}
+	CHECK(fails == 0);
+	printf("  split once      %u bytes, %d packets, %u splits\n", Sim_StreamLen, Sim_Packets, Sim_StreamLen + 1);
+}
+
+/** @brief Stream split in three at every pair of byte boundaries */
+static void Test_SplitTwice(){
+	uint32_t i, j, splits = 0;
+	int fails = 0;
+
+	srand(2);
+	Sim_BuildStream(8, 40);
+
+	for (i = 0; i <= Sim_StreamLen; i ++)
+	{
+		for (j = i; j <= Sim_StreamLen; j ++)
+		{
+			Sim_Connect();
+			Sim_Receive(0, i);
+			Sim_Process();
+			Sim_Receive(i, j - i);
+			Sim_Process();
+			Sim_Receive(j, Sim_StreamLen - j);
+			if (Sim_AllReceived() == false)
+				fails ++;
+			splits ++;
+		}
+	}
+	CHECK(fails == 0);
+	printf("  split twice     %u bytes, %d packets, %u splits\n", Sim_StreamLen, Sim_Packets, splits);
+}
+
+/** @brief Random splits, packets bigger than ring, client busy with a packet (nested receive) */
+static void Test_Random(){
+	uint32_t pos, n, before, dropped, stalls, packets, big = 0, waits = 0;
+	int run, i, fails = 0;
+
+	GS_TCP_mqtt_GetRxStats(&packets, &before, &stalls);
+
+	for (run = 0; run < 50; run ++)
+	{
+		srand(200 + run);
+		Sim_BuildStream(400, (run & 1) ? 2 * MQTT_RX_RING_SIZE : 600);
+		Sim_Connect();
+
+		for (pos = 0; pos < Sim_StreamLen; pos += n)
+		{
+			n = 1 + rand() % ((rand() & 1) ? 8 : 1400);
+			if (n > Sim_StreamLen - pos)
+				n = Sim_StreamLen - pos;
+
+			Sim_Hold = ((rand() % 4) == 0);
+			waits += Sim_Receive(pos, n);
+			if ((rand() % 2) == 0)
+				Sim_Process();						// end of bulk transfer, partial packet stays in ring
+		}
+
+		if (Sim_AllReceived() == false)
+			fails ++;
+		for (i = 0; i < Sim_Packets; i ++)
+			big += Sim_Big[i];
+	}
+
+	GS_TCP_mqtt_GetRxStats(&packets, &dropped, &stalls);
+	CHECK(fails == 0);
+	CHECK(dropped - before == big);
+	printf("  random          50 streams, %u bigger than ring, %u waits for room\n", big, waits);
+}
+
+/** @brief Burst of small packets bigger than packet queue in one bulk transfer */
+static void Test_Burst(){
+	uint32_t stalls;
+	int i;
+
+	Sim_StreamLen = 0;
+	Sim_Packets = 0;
+	for (i = 0; i < 3 * MQTT_RX_PACKETS; i ++)
+		Sim_AddPacket(13, 0);
+
+	Sim_Connect();
+	stalls = Sim_Receive(0, Sim_StreamLen);			// client processes when asked for room
+	CHECK(stalls == 0);
+	CHECK(Sim_AllReceived());
+
+	Sim_Connect();
+	Sim_Hold = true;								// client is busy, data waits in uart
+	stalls = Sim_Receive(0, Sim_StreamLen);
+	CHECK(stalls == 1);
+	CHECK(Sim_AllReceived());
+}
+
+/**
+*  @brief  Decoding speed
+*
+*  @param  Typical packet body length
+*  @param  Bytes per receive call
+*/
+static void Test_BenchOne(uint32_t bodyLen, uint32_t chunk){
+	struct timespec t0, t1;
+	uint32_t pos, n, bytes = 0;
+	double ns;
+	int i;
+
+	Sim_StreamLen = 0;
+	Sim_Packets = 0;
+	while (Sim_StreamLen + bodyLen + 8 < SIM_STREAM_MAX / 2)
+		Sim_AddPacket(3, bodyLen);
+
+	Sim_Connect();
+	Sim_Compare = false;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < 20; i ++)
+	{
+		Sim_Next = 0;
+		for (pos = 0; pos < Sim_StreamLen; pos += n)
+		{
+			n = (chunk < Sim_StreamLen - pos) ? chunk : Sim_StreamLen - pos;
+			Sim_Receive(pos, n);
+			Sim_Process();
+		}
+		bytes += Sim_StreamLen;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+	printf("  body %4u chunk %4u   %6.2f ns per byte, %7.1f ns per packet\n",
+			bodyLen, chunk, ns / bytes, ns / (20.0 * Sim_Packets));
+}
+
+/** @brief Decoding speed for typical packets and chunk sizes */
+static void Test_Bench(){
+	printf("decoder speed\n");
+	Test_BenchOne(2, 1);
+	Test_BenchOne(2, 1400);
+	Test_BenchOne(100, 1);
+	Test_BenchOne(100, 64);
+	Test_BenchOne(100, 1400);
+	Test_BenchOne(1000, 1400);
+}
+
+int main(){
+	Test_SplitOnce();
+	Test_SplitTwice();
+	Test_Random();
+	Test_Burst();
+	Test_Bench();
+
+	printf(Test_Failed ? "FAILED\n" : "PASSED\n");
+	return Test_Failed ? 1 : 0;
+}
@@ -0,0 +1,275 @@
+/** @file   MsgService_Bench.c
+ *  @brief  Host microbenchmark of publish enqueue in mqtt message buffer (MQTT_MsgService.c).
+ *
+ *  		Cost of MQTT_Msg_PrepareForSend (message ID and slot) is measured with
+ *  		10, 100 and MQTT_API_MSG_BUFFER messages in flight (stored, not acknowledged),
+ *  		next to the linear slot scan and nested message ID search which were used
+ *  		before slot free list and message ID index. Acknowledge lookup
+ *  		(MQTT_Msg_GetMessHandler of MQTT_Msg_ProcessResponse) is measured
+ *  		at the same fill levels.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "MQTT/MQTT_Api_Client/MQTT_MsgService.c"
+
+
+// simulated environment
+
+#define BENCH_ROUNDS			20000
+
+static int Test_Failed;
+
+#define CHECK(cond)		do { if (!(cond)) { printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); Test_Failed ++; } } while (0)
+
+unsigned long long int MSTimerGet(){ return 0; }
+unsigned long long int MSTimerDelta(unsigned long long int timer){ return 0; }
+
+int  MQTT_User_Publish(MQTT_User_Message_t* message){ return message->topiclen + message->payloadlen; }
+void MQTT_User_SendPUBREL(int message_dup, int message_ID){}
+void MQTT_User_SendPUBACK(int message_ID){}
+void MQTT_User_SendPUBREC(int message_ID){}
+void MQTT_User_SendPUBCOMP(int message_ID){}
+int  MQTT_Api_SubscribeTopic(MQTT_User_Message_t* MyMsg){ return 0; }
+int  MQTT_Api_UnsubscribeTopic(MQTT_User_Message_t* MyMsg){ return 0; }
+void MQTT_Api_ProcessSubscription(char* topic, unsigned char code){}
+void MQTT_OnMsgResponseTimeout(){}
+
+
+// message buffer before slot free list and message ID index (linear scans)
+
+static struct {
+	MQTT_Msg_State_t state;
+	unsigned short   messageID;
+} Ref_Messages[MQTT_API_MSG_BUFFER];
+
+static unsigned char Ref_StoreMessage(unsigned short messageID){
+	unsigned char count;
+
+	for (count = 0; count < MQTT_API_MSG_BUFFER; count ++)
+	{
+		if (Ref_Messages[count].state == MQTT_MSG_STATE_EMPTY)
+			break;
+	}
+
+	if (count == MQTT_API_MSG_BUFFER)
+		return 255;
+
+	Ref_Messages[count].state = MQTT_MSG_STATE_READY_TO_SEND;
+	Ref_Messages[count].messageID = messageID;
+	return count;
+}
+
+static unsigned short Ref_GetFreeMID(){
+	unsigned short i, j, success;
+
+	for (i = 1; i < MQTT_API_MSG_BUFFER + 1; i ++)
+	{
+		success = 0;
+		for (j = 0; j < MQTT_API_MSG_BUFFER; j ++)
+		{
+			if (i != Ref_Messages[j].messageID)
+				success ++;
+		}
+		if (success == MQTT_API_MSG_BUFFER)
+			return i;
+	}
+	return 0xFFFF;
+}
+
+static signed short Ref_GetMessHandler(int messageID){
+	signed short count;
+
+	for (count = 0; count < MQTT_API_MSG_BUFFER; count ++)
+	{
+		if (Ref_Messages[count].messageID == messageID)
+			return count;
+	}
+	return -1;
+}
+
+static unsigned char Ref_PrepareForSend(){
+	return Ref_StoreMessage(Ref_GetFreeMID());
+}
+
+
+// benchmark
+
+static char Bench_Topic[] = "wunderbar/gyro/data";
+static char Bench_Payload[] = "{\"ts\":1420070400000,\"gyro\":{\"x\":120,\"y\":-35,\"z\":8}}";
+static volatile unsigned int Bench_Sink;
+static double Bench_Overhead;				// ns of one Bench_Ns pair
+
+static uint64_t Bench_Ns(){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void Bench_Calibrate(){
+	uint64_t start, ns = 0;
+	int i;
+
+	for (i = 0; i < BENCH_ROUNDS; i ++)
+	{
+		start = Bench_Ns();
+		ns += Bench_Ns() - start;
+	}
+	Bench_Overhead = (double) ns / BENCH_ROUNDS;
+}
+
+static void Bench_Message(MQTT_User_Message_t* msg){
+	memset(msg, 0, sizeof(*msg));
+	msg->qos = 1;
+	msg->topicStr = Bench_Topic;
+	msg->topiclen = strlen(Bench_Topic);
+	msg->payloadStr = Bench_Payload;
+	msg->payloadlen = strlen(Bench_Payload);
+}
+
+/**
+*  @brief  Fills message buffer with messages waiting for acknowledge
+*
+*  Every other message is acknowledged, so free slots and message IDs are spread.
+*
+*  @param  Number of messages in flight
+*/
+static void Bench_Fill(int inFlight){
+	MQTT_User_Message_t msg;
+	unsigned char handlers[MQTT_API_MSG_BUFFER];
+	int i;
+
+	MQTT_Msg_DiscardAllMsg();
+	memset(Ref_Messages, 0, sizeof(Ref_Messages));
+
+	for (i = 0; i < inFlight; i ++)
+	{
+		Bench_Message(&msg);
+		handlers[i] = MQTT_Msg_PrepareForSend(&msg);
+		Ref_PrepareForSend();
+	}
+	for (i = 0; i < inFlight; i += 2)
+	{
+		MQTT_Msg_Discard(handlers[i]);
+		Ref_Messages[i].state = MQTT_MSG_STATE_EMPTY;
+		Ref_Messages[i].messageID = 0;
+	}
+	for (i = 0; i < inFlight; i += 2)
+	{
+		Bench_Message(&msg);
+		MQTT_Msg_PrepareForSend(&msg);
+		Ref_PrepareForSend();
+	}
+}
+
+/**
+*  @brief  Enqueue and acknowledge cost at one fill level
+*
+*  @param  Number of messages in flight (including the measured one)
+*/
+static void Bench_InFlight(int inFlight){
+	MQTT_User_Message_t msg;
+	uint64_t start, enqueueNs = 0, ackNs = 0, refEnqueueNs = 0, refAckNs = 0;
+	unsigned char handler;
+	signed short refHandler;
+	unsigned short mid;
+	int i;
+
+	Bench_Fill(inFlight - 1);
+	CHECK(MQTT_MsgSlots.FreeCount == MQTT_API_MSG_BUFFER - (inFlight - 1));
+
+	for (i = 0; i < BENCH_ROUNDS; i ++)
+	{
+		Bench_Message(&msg);
+
+		start = Bench_Ns();
+		handler = MQTT_Msg_PrepareForSend(&msg);
+		enqueueNs += Bench_Ns() - start;
+
+		if (handler == MQTT_MSG_NO_SLOT)
+		{
+			Test_Failed ++;
+			break;
+		}
+		mid = MQTT_Api_Messages[handler].MQTT_MyMessage.messageID;
+
+		start = Bench_Ns();
+		Bench_Sink += MQTT_Msg_GetMessHandler(mid);
+		ackNs += Bench_Ns() - start;
+
+		CHECK(MQTT_Msg_GetMessHandler(mid) == handler);
+		MQTT_Msg_Discard(handler);
+	}
+
+	for (i = 0; i < BENCH_ROUNDS; i ++)
+	{
+		start = Bench_Ns();
+		handler = Ref_PrepareForSend();
+		refEnqueueNs += Bench_Ns() - start;
+
+		mid = Ref_Messages[handler].messageID;
+
+		start = Bench_Ns();
+		refHandler = Ref_GetMessHandler(mid);
+		refAckNs += Bench_Ns() - start;
+
+		Bench_Sink += refHandler;
+		Ref_Messages[handler].state = MQTT_MSG_STATE_EMPTY;
+		Ref_Messages[handler].messageID = 0;
+	}
+
+	printf("  %3d in flight   enqueue %7.1f ns (linear %8.1f ns)   ack lookup %6.1f ns (linear %7.1f ns)\n", inFlight,
+			(double) enqueueNs / BENCH_ROUNDS - Bench_Overhead, (double) refEnqueueNs / BENCH_ROUNDS - Bench_Overhead,
+			(double) ackNs / BENCH_ROUNDS - Bench_Overhead, (double) refAckNs / BENCH_ROUNDS - Bench_Overhead);
+}
+
+/** @brief Message IDs of stored messages are unique and found by index */
+static void Test_UniqueIDs(){
+	MQTT_User_Message_t msg;
+	unsigned char seen[65536 / 8];
+	unsigned short mid;
+	unsigned char handler;
+	int i, dup = 0, lost = 0;
+
+	MQTT_Msg_DiscardAllMsg();
+	memset(seen, 0, sizeof(seen));
+
+	for (i = 0; i < MQTT_API_MSG_BUFFER; i ++)
+	{
+		Bench_Message(&msg);
+		handler = MQTT_Msg_PrepareForSend(&msg);
+		mid = MQTT_Api_Messages[handler].MQTT_MyMessage.messageID;
+
+		if ((mid == 0) || (seen[mid >> 3] & (1 << (mid & 7))))
+			dup ++;
+		seen[mid >> 3] |= 1 << (mid & 7);
+		if (MQTT_Msg_GetMessHandler(mid) != handler)
+			lost ++;
+	}
+
+	Bench_Message(&msg);
+	CHECK(MQTT_Msg_PrepareForSend(&msg) == (char) MQTT_MSG_NO_SLOT);		// buffer is full
+	CHECK(dup == 0);
+	CHECK(lost == 0);
+}
+
+int main(){
+	Test_UniqueIDs();
+
+	Bench_Calibrate();
+	printf("publish enqueue (%d slots, timer overhead %.1f ns subtracted)\n", MQTT_API_MSG_BUFFER, Bench_Overhead);
+	Bench_InFlight(10);
+	Bench_InFlight(100);
+	Bench_InFlight(MQTT_API_MSG_BUFFER);
+
+	printf(Test_Failed ? "FAILED\n" : "PASSED\n");
+	return Test_Failed ? 1 : 0;
+}
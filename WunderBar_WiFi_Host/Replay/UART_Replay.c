@@ -0,0 +1,648 @@
+/** @file   UART_Replay.c
+ *  @brief  Host replay of GS module uart capture (UART.c format) through the firmware.
+ *
+ *  		Firmware modules above the hardware layer run on board simulation
+ *  		(Sim.h) with GS_HAL_* taken from the capture: received bytes are given
+ *  		to the same GS_HAL_recv call which got them when the capture was made
+ *  		(first call in the ms of the record), sent bytes are compared with
+ *  		transmit records. Virtual time moves only with firmware calls, so a
+ *  		replay of a simulated board capture (S2W_Emulator) repeats the run
+ *  		exactly and any change of timing or traffic shows as a mismatch.
+ *
+ *  		Report: connect latency split by GS_User states for every (re)connect,
+ *  		AT round trips (<Esc>Z frames and command lines) per 100 publishes,
+ *  		AT command latencies (virtual time) and host cpu cost of processing
+ *  		received mqtt packets, queueing sent packets, bulk transfers and
+ *  		AT response parsing.
+ *
+ *  		Capture starts with first boot, board configuration is the one of
+ *  		Sim_FactoryFlash. Capture of a board ring which has dropped records
+ *  		is replayed, but does not match from the start.
+ *
+ *  		usage: UART_Replay [capture file]
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <hardware/Hw_modules.h>
+#include "GS/AT/AtCmdLib.h"
+#include "GS/GS_User/GS_TCP_mqtt.h"
+#include "GS/GS_User/GS_User.h"
+
+#include "../Sim/Sim.h"
+
+
+#define RPL_TIME_LIMIT			900						// virtual seconds
+#define RPL_CAPTURE_FILE		"build/S2W_Emulator.cap"
+#define RPL_STALL_US			20000000				// no record consumed for this long
+#define RPL_MISMATCH_PRINT		5
+
+#define UART_CAPTURE_MAGIC		0x50414355				// "UCAP"
+#define UART_CAPTURE_HEADER		6
+#define UART_CAPTURE_TX			0x80
+#define UART_TX_BUF_SIZE		256
+#define UART_BLOCK_TIMEOUT		1000
+
+#define RPL_PACKET_TYPES		16						// mqtt control packet types
+#define RPL_PUBLISH				3						// mqtt PUBLISH packet type
+#define RPL_ESC					0x1B
+
+typedef struct {
+	uint32_t magic;
+	uint32_t size;
+	uint32_t head;
+	uint32_t used;
+	uint32_t dropped;
+} Rpl_CaptureHeader_t;
+
+typedef struct {
+	uint32_t count;
+	uint64_t bytes;
+	uint64_t ns;
+	uint64_t maxNs;
+} Rpl_Cost_t;
+
+typedef struct {
+	// replay position (shared by boots)
+	uint32_t pos;							// next record
+	uint32_t offset;						// bytes of next rx record already given
+	uint32_t records;
+	uint64_t lastProgress;
+	uint32_t baud;
+
+	// comparison
+	uint32_t txMismatches;
+	uint32_t rxLate;						// rx given in other ms than recorded
+	uint32_t txBytes;
+	uint32_t rxBytes;
+
+	// round trips, from sent bytes
+	uint32_t frames;						// <Esc>Z bulk frames
+	uint32_t commands;						// AT command lines
+
+	// costs
+	Rpl_Cost_t rxPacket[RPL_PACKET_TYPES];	// GS_TCP_mqtt_GetPacket to GS_TCP_mqtt_ReleasePacket
+	Rpl_Cost_t txPacket[RPL_PACKET_TYPES];	// GS_Api_mqtt_SendPacket(Spans)
+	Rpl_Cost_t batch;						// GS_TCP_mqtt_BatchEnd which sent a bulk transfer (bytes - packets)
+	uint32_t   batchPackets;				// packets sent before last bulk transfer
+	Rpl_Cost_t parse;						// AtLib_ReceiveChunk of GS_API_CheckForData without packet processing
+	uint32_t   connects;
+} Rpl_t;
+
+static uint8_t*  Rpl_Data;					// capture records, oldest first
+static uint32_t  Rpl_Size;
+static Rpl_t*    Rpl;
+
+// packet in processing (ram of the boot)
+static uint8_t   Rpl_PacketType;
+static uint64_t  Rpl_PacketStart;
+static uint64_t  Rpl_NestedNs;				// packet processing inside AT parsing
+static uint32_t  Rpl_ParseBytes;
+static bool      Rpl_Parsing;
+
+// sent bytes decoder (ram of the boot)
+typedef enum {
+	RPL_TX_LINE,							// AT command or start of frame
+	RPL_TX_ESC,								// <Esc> received
+	RPL_TX_HEADER,							// <cid><4 digit length> of bulk frame
+	RPL_TX_DATA								// bulk data
+} Rpl_TxState_t;
+
+static Rpl_TxState_t Rpl_TxState;
+static char      Rpl_TxLine[5];
+static uint32_t  Rpl_TxLineLen;
+static uint32_t  Rpl_TxRemaining;
+
+static const char* const Rpl_StateNames[GS_MAIN_STATES] = {
+	"INIT", "TRY_TO_CONNECT", "GET_SERVER_TIME", "WAIT_SERVER_TIME", "GET_CACERT",
+	"WAIT_CACERT", "SWICH_TO_CLIENT", "CHECK_CERT", "CLIENT_MODE", "LIMITED_AP"
+};
+
+static const char* const Rpl_PacketNames[RPL_PACKET_TYPES] = {
+	"-", "CONNECT", "CONNACK", "PUBLISH", "PUBACK", "PUBREC", "PUBREL", "PUBCOMP",
+	"SUBSCRIBE", "SUBACK", "UNSUBSCRIBE", "UNSUBACK", "PINGREQ", "PINGRESP", "DISCONNECT", "-"
+};
+
+void __real_GS_ProcessMqttConnect();
+bool __real_GS_TCP_mqtt_GetPacket(char** packet, int* len);
+void __real_GS_TCP_mqtt_ReleasePacket();
+bool __real_GS_Api_mqtt_SendPacket(char* buf, int buflen);
+bool __real_GS_Api_mqtt_SendPacketSpans(const ATLIB_DATA_SPAN_T* spans, uint8_t numSpans);
+bool __real_GS_TCP_mqtt_BatchEnd();
+HOST_APP_MSG_ID_E __real_AtLib_ReceiveChunk(uint32_t* pRead);
+
+
+// static declarations
+
+static bool Rpl_Load(const char* file);
+static bool Rpl_Record(uint32_t pos, uint32_t* ms, uint32_t* len, bool* tx);
+static uint32_t Rpl_Receive(uint8_t* dst, uint32_t size);
+static void Rpl_Boot();
+static void Rpl_Poll();
+static void Rpl_TxScan(const uint8_t* data, uint32_t len);
+static void Rpl_Finish(int status);
+static uint64_t Rpl_Ns();
+static void Rpl_CostAdd(Rpl_Cost_t* cost, uint64_t ns, uint32_t bytes);
+static void Rpl_CostPrint(const char* name, const Rpl_Cost_t* cost, const char* unit);
+
+static const Sim_Hooks_t Rpl_Hooks = {
+	.Boot    = Rpl_Boot,
+	.Poll    = Rpl_Poll,
+	.Advance = NULL,
+};
+
+
+
+
+	///////////////////////////////////////
+	/*         public functions          */
+	///////////////////////////////////////
+
+
+
+int main(int argc, char* argv[]){
+	const char* file = (argc > 1) ? argv[1] : RPL_CAPTURE_FILE;
+	int status;
+
+	Sim_Init(RPL_TIME_LIMIT);
+	Sim_FactoryFlash();
+	Rpl = Sim_SharedAlloc(sizeof(Rpl_t));
+
+	if (!Rpl_Load(file))
+		return 2;
+
+	printf("replay %s: %u records\n", file, Rpl->records);
+	status = Sim_Run(&Rpl_Hooks);
+
+	printf("%s\n", (status == 0) ? "PASSED" : "FAILED");
+	return status;
+}
+
+
+// board uart from capture
+
+void GS_HAL_send(uint8_t* StrPtr, uint32_t Size){
+	uint32_t len, ms, recLen;
+	bool tx;
+
+	while (Size)
+	{
+		len = (Size < UART_TX_BUF_SIZE) ? Size : UART_TX_BUF_SIZE;
+
+		if (!Rpl_Record(Rpl->pos, &ms, &recLen, &tx) || !tx || (recLen != len) || (ms != Sim_Millis()) ||
+				memcmp(&Rpl_Data[Rpl->pos + UART_CAPTURE_HEADER], StrPtr, len))
+		{
+			if (Rpl->txMismatches ++ < RPL_MISMATCH_PRINT)
+				printf("  tx mismatch at %u ms (record %u ms, %u bytes %s): \"%.*s\"\n", Sim_Millis(), ms, recLen,
+						tx ? "tx" : "rx", (int) ((len < 40) ? len : 40), StrPtr);
+		}
+
+		// transmit record is consumed even on mismatch, replay goes on with next records
+		if (tx && (Rpl->pos < Rpl_Size))
+		{
+			Rpl->pos += UART_CAPTURE_HEADER + recLen;
+			Rpl->lastProgress = Sim_Now();
+		}
+		Rpl->txBytes += len;
+		Rpl_TxScan(StrPtr, len);
+
+		Sim_UartSend(len, Rpl->baud);
+		StrPtr += len;
+		Size -= len;
+	}
+}
+
+unsigned int GS_HAL_recv(uint8_t* recvbyte, uint32_t Size, uint32_t block){
+	uint32_t read, result = 0;
+	uint64_t time;
+
+	if (block)
+	{
+		time = MSTimerGet();
+		while (Size && (MSTimerDelta(time) <= UART_BLOCK_TIMEOUT))
+		{
+			read = Rpl_Receive(recvbyte, Size);
+
+			recvbyte += read;
+			Size -= read;
+			result += read;
+		}
+	}
+	else
+	{
+		result = Rpl_Receive(recvbyte, Size);
+	}
+
+	if (Rpl_Parsing)
+		Rpl_ParseBytes += result;
+	return result;
+}
+
+void GS_HAL_ClearBuff(){
+	// bytes dropped when capture was made were not recorded
+}
+
+void GS_HAL_SetBaudRate(uint32_t baudRate){
+	Sim_UartDrain();
+	Rpl->baud = baudRate;
+}
+
+uint32_t GS_HAL_GetBaudRate(){
+	return Rpl->baud;
+}
+
+void GS_HAL_GetRxStats(uint32_t* overruns, uint32_t* lost, uint32_t* fifoOverruns){
+	*overruns = 0;
+	*lost = 0;
+	*fifoOverruns = 0;
+}
+
+
+// measured firmware functions (linked with --wrap)
+
+void __wrap_GS_ProcessMqttConnect(){
+	GS_Reconnect_Stats_t stats;
+	int i;
+
+	__real_GS_ProcessMqttConnect();
+	GS_User_GetReconnectStats(&stats);
+
+	printf("connect %u   boot %u at %7.2f s: %5u ms, fast %u full %u\n", ++ Rpl->connects, Sim_Boots(),
+			Sim_Now() / 1e6, stats.connectTime, stats.fastReconnects, stats.fullReconnects);
+	for (i = 0; i < GS_MAIN_STATES; i ++)
+		if (stats.stateTime[i])
+			printf("  %-18s %5u ms\n", Rpl_StateNames[i], stats.stateTime[i]);
+}
+
+bool __wrap_GS_TCP_mqtt_GetPacket(char** packet, int* len){
+	bool result = __real_GS_TCP_mqtt_GetPacket(packet, len);
+
+	if (result)
+	{
+		Rpl_PacketType = (uint8_t) (*packet)[0] >> 4;
+		Rpl_PacketStart = Rpl_Ns();
+	}
+	return result;
+}
+
+void __wrap_GS_TCP_mqtt_ReleasePacket(){
+	uint64_t ns = Rpl_Ns() - Rpl_PacketStart;
+
+	__real_GS_TCP_mqtt_ReleasePacket();
+	Rpl_CostAdd(&Rpl->rxPacket[Rpl_PacketType], ns, 0);
+	Rpl_NestedNs += ns;
+}
+
+bool __wrap_GS_Api_mqtt_SendPacket(char* buf, int buflen){
+	uint64_t start = Rpl_Ns();
+	bool result = __real_GS_Api_mqtt_SendPacket(buf, buflen);
+
+	Rpl_CostAdd(&Rpl->txPacket[(uint8_t) buf[0] >> 4], Rpl_Ns() - start, buflen);
+	return result;
+}
+
+bool __wrap_GS_Api_mqtt_SendPacketSpans(const ATLIB_DATA_SPAN_T* spans, uint8_t numSpans){
+	uint64_t start = Rpl_Ns();
+	bool result = __real_GS_Api_mqtt_SendPacketSpans(spans, numSpans);
+	uint32_t bytes = 0;
+	uint8_t i;
+
+	for (i = 0; i < numSpans; i ++)
+		bytes += spans[i].dataLen;
+	Rpl_CostAdd(&Rpl->txPacket[spans[0].pData[0] >> 4], Rpl_Ns() - start, bytes);
+	return result;
+}
+
+bool __wrap_GS_TCP_mqtt_BatchEnd(){
+	uint32_t packets, frames, framesAfter;
+	uint64_t start = Rpl_Ns();
+	bool result;
+
+	GS_TCP_mqtt_GetTxStats(&packets, &frames);
+	result = __real_GS_TCP_mqtt_BatchEnd();
+	GS_TCP_mqtt_GetTxStats(&packets, &framesAfter);
+
+	if (framesAfter != frames)
+	{
+		Rpl_CostAdd(&Rpl->batch, Rpl_Ns() - start, packets - Rpl->batchPackets);
+		Rpl->batchPackets = packets;
+	}
+	return result;
+}
+
+HOST_APP_MSG_ID_E __wrap_AtLib_ReceiveChunk(uint32_t* pRead){
+	uint64_t start = Rpl_Ns();
+	HOST_APP_MSG_ID_E result;
+
+	Rpl_NestedNs = 0;
+	Rpl_ParseBytes = 0;
+	Rpl_Parsing = true;
+
+	result = __real_AtLib_ReceiveChunk(pRead);
+
+	Rpl_Parsing = false;
+	if (Rpl_ParseBytes)
+		Rpl_CostAdd(&Rpl->parse, Rpl_Ns() - start - Rpl_NestedNs, Rpl_ParseBytes);
+	return result;
+}
+
+
+
+
+	///////////////////////////////////////
+	/*         static functions          */
+	///////////////////////////////////////
+
+
+
+/**
+ *  @brief  Load capture file, records are put in order (oldest first)
+ *
+ *  @param  File name
+ *
+ *  @return True if capture is valid
+ */
+static bool Rpl_Load(const char* file){
+	Rpl_CaptureHeader_t header;
+	uint8_t* ring;
+	uint32_t start, pos, len, ms;
+	bool tx, ok;
+	FILE* f;
+
+	if ((f = fopen(file, "rb")) == NULL)
+	{
+		perror(file);
+		return false;
+	}
+
+	ok = (fread(&header, sizeof(header), 1, f) == 1) && (header.magic == UART_CAPTURE_MAGIC) &&
+			(header.used <= header.size) && (header.head < header.size + (header.size == 0));
+	ring = ok ? malloc(header.size + 1) : NULL;
+	ok = ok && ring && (fread(ring, 1, header.size, f) == header.size);
+	fclose(f);
+
+	if (!ok)
+	{
+		printf("%s: not a uart capture\n", file);
+		return false;
+	}
+	if (header.dropped)
+		printf("capture ring dropped %u records, start of the run is missing\n", header.dropped);
+
+	Rpl_Data = malloc(header.used + 1);
+	Rpl_Size = header.used;
+	start = (header.head + header.size - header.used) % (header.size ? header.size : 1);
+	for (pos = 0; pos < header.used; pos ++)
+		Rpl_Data[pos] = ring[(start + pos) % header.size];
+	free(ring);
+
+	for (pos = 0; Rpl_Record(pos, &ms, &len, &tx); pos += UART_CAPTURE_HEADER + len)
+		Rpl->records ++;
+	if (pos != Rpl_Size)
+	{
+		printf("%s: truncated record at offset %u\n", file, pos);
+		return false;
+	}
+	return true;
+}
+
+/**
+ *  @brief  Decode record header
+ *
+ *  @param  Offset of the record
+ *  @param  Return time (ms since boot)
+ *  @param  Return number of data bytes
+ *  @param  Return true for transmit record
+ *
+ *  @return False if there is no complete record at the offset
+ */
+static bool Rpl_Record(uint32_t pos, uint32_t* ms, uint32_t* len, bool* tx){
+	const uint8_t* p = &Rpl_Data[pos];
+
+	*ms = 0;
+	*len = 0;
+	*tx = false;
+
+	if (pos + UART_CAPTURE_HEADER > Rpl_Size)
+		return false;
+
+	*ms = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+	*len = p[4] | ((p[5] & ~UART_CAPTURE_TX) << 8);
+	*tx = (p[5] & UART_CAPTURE_TX) != 0;
+
+	return pos + UART_CAPTURE_HEADER + *len <= Rpl_Size;
+}
+
+/**
+ *  @brief  Give bytes of next receive record when its time has come
+ *
+ *  One record is given per call, as it was recorded from one call.
+ *
+ *  @param  Pointer to input buffer
+ *  @param  Number of bytes to read
+ *
+ *  @return Number of bytes read
+ */
+static uint32_t Rpl_Receive(uint8_t* dst, uint32_t size){
+	uint32_t ms, len, n;
+	bool tx;
+
+	Sim_Step(SIM_UART_POLL_US);
+
+	if (!Rpl_Record(Rpl->pos, &ms, &len, &tx) || tx || (ms > Sim_Millis()))
+		return 0;
+
+	if (ms != Sim_Millis())
+		Rpl->rxLate ++;
+
+	n = len - Rpl->offset;
+	if (n > size)
+		n = size;
+	memcpy(dst, &Rpl_Data[Rpl->pos + UART_CAPTURE_HEADER + Rpl->offset], n);
+
+	Rpl->offset += n;
+	if (Rpl->offset == len)
+	{
+		Rpl->pos += UART_CAPTURE_HEADER + len;
+		Rpl->offset = 0;
+	}
+	Rpl->rxBytes += n;
+	Rpl->lastProgress = Sim_Now();
+	return n;
+}
+
+/**
+ *  @brief  Board boot, uart is set to default rate
+ *
+ *  @return void
+ */
+static void Rpl_Boot(){
+	Rpl->baud = GS_HAL_BAUD_DEFAULT;
+	Rpl->lastProgress = Sim_Now();
+}
+
+/**
+ *  @brief  End replay when all records are consumed or firmware stopped following them
+ *
+ *  @return void
+ */
+static void Rpl_Poll(){
+	if (Rpl->pos >= Rpl_Size)
+		Rpl_Finish((Rpl->txMismatches || Rpl->rxLate) ? 1 : 0);
+
+	if (Sim_Now() - Rpl->lastProgress > RPL_STALL_US)
+	{
+		printf("replay stalled at offset %u of %u\n", Rpl->pos, Rpl_Size);
+		Rpl_Finish(1);
+	}
+}
+
+/**
+ *  @brief  Count AT round trips in sent bytes
+ *
+ *  Bulk frame is <Esc>Z<cid><4 digit length><data>, its data is skipped
+ *  (mqtt packets may contain any byte). Other lines starting with AT are commands.
+ *
+ *  @param  Sent bytes
+ *  @param  Number of bytes
+ *
+ *  @return void
+ */
+static void Rpl_TxScan(const uint8_t* data, uint32_t len){
+	uint32_t i;
+
+	for (; len; data ++, len --)
+	{
+		switch (Rpl_TxState)
+		{
+		case RPL_TX_LINE :
+			if (*data == RPL_ESC)
+				Rpl_TxState = RPL_TX_ESC;
+			else if ((*data == '\r') || (*data == '\n'))
+			{
+				if ((Rpl_TxLineLen >= 2) && (Rpl_TxLine[0] == 'A') && (Rpl_TxLine[1] == 'T'))
+					Rpl->commands ++;
+				Rpl_TxLineLen = 0;
+			}
+			else if (Rpl_TxLineLen < sizeof(Rpl_TxLine))
+				Rpl_TxLine[Rpl_TxLineLen ++] = *data;
+			break;
+
+		case RPL_TX_ESC :
+			Rpl_TxLineLen = 0;
+			Rpl_TxState = (*data == 'Z') ? RPL_TX_HEADER : RPL_TX_LINE;
+			break;
+
+		case RPL_TX_HEADER :
+			Rpl_TxLine[Rpl_TxLineLen ++] = *data;
+			if (Rpl_TxLineLen == sizeof(Rpl_TxLine))
+			{
+				for (i = 1, Rpl_TxRemaining = 0; i < sizeof(Rpl_TxLine); i ++)
+					Rpl_TxRemaining = Rpl_TxRemaining * 10 + Rpl_TxLine[i] - '0';
+				Rpl->frames ++;
+				Rpl_TxLineLen = 0;
+				Rpl_TxState = Rpl_TxRemaining ? RPL_TX_DATA : RPL_TX_LINE;
+			}
+			break;
+
+		case RPL_TX_DATA :
+			if (-- Rpl_TxRemaining == 0)
+				Rpl_TxState = RPL_TX_LINE;
+			break;
+		}
+	}
+}
+
+/**
+ *  @brief  Print report and end simulation
+ *
+ *  @param  Exit status
+ *
+ *  @return void
+ */
+static void Rpl_Finish(int status){
+	const ATLIB_CMD_STATS_T* cmd;
+	char name[32];
+	uint32_t publishes, packets;
+	uint8_t i, n;
+
+	printf("replayed         %.2f s virtual, %u boots, tx %u bytes, rx %u bytes\n",
+			Sim_Now() / 1e6, Sim_Boots(), Rpl->txBytes, Rpl->rxBytes);
+	printf("match            %u tx mismatches, %u rx records in other ms\n", Rpl->txMismatches, Rpl->rxLate);
+
+	// without batching every mqtt packet is sent in its own frame
+	for (i = 0, packets = 0; i < RPL_PACKET_TYPES; i ++)
+		packets += Rpl->txPacket[i].count;
+	publishes = Rpl->txPacket[RPL_PUBLISH].count;
+	printf("round trips      %u <Esc>Z frames for %u mqtt packets, %u AT commands, %u publishes\n",
+			Rpl->frames, packets, Rpl->commands, publishes);
+	if (publishes)
+		printf("  per 100 pub    %.1f <Esc>Z frames (%.1f without batching), %.1f AT round trips\n",
+				Rpl->frames * 100.0 / publishes, packets * 100.0 / publishes,
+				(Rpl->frames + Rpl->commands) * 100.0 / publishes);
+
+	n = AtLib_GetCommandStats(&cmd);
+	printf("at commands      (last boot, virtual time)\n");
+	for (i = 0; i < n; i ++)
+		printf("  %-14s %5u  errors %3u timeouts %3u  avg %5u ms max %5u ms\n", cmd[i].name, cmd[i].count,
+				cmd[i].errors, cmd[i].timeouts, cmd[i].count ? cmd[i].totalTime / cmd[i].count : 0, cmd[i].maxTime);
+
+	printf("host cost        count      avg      max\n");
+	for (i = 0; i < RPL_PACKET_TYPES; i ++)
+	{
+		sprintf(name, "rx %s", Rpl_PacketNames[i]);
+		Rpl_CostPrint(name, &Rpl->rxPacket[i], NULL);
+	}
+	for (i = 0; i < RPL_PACKET_TYPES; i ++)
+	{
+		sprintf(name, "tx %s", Rpl_PacketNames[i]);
+		Rpl_CostPrint(name, &Rpl->txPacket[i], "bytes");
+	}
+	Rpl_CostPrint("bulk transfer", &Rpl->batch, "packets");
+	Rpl_CostPrint("at parsing", &Rpl->parse, "bytes");
+
+	Sim_Exit(status);
+}
+
+static uint64_t Rpl_Ns(){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void Rpl_CostAdd(Rpl_Cost_t* cost, uint64_t ns, uint32_t bytes){
+	cost->count ++;
+	cost->bytes += bytes;
+	cost->ns += ns;
+	if (ns > cost->maxNs)
+		cost->maxNs = ns;
+}
+
+/**
+ *  @brief  Print host cost line (microseconds)
+ *
+ *  @param  Name
+ *  @param  Cost
+ *  @param  Unit of byte counter, NULL if not used
+ *
+ *  @return void
+ */
+static void Rpl_CostPrint(const char* name, const Rpl_Cost_t* cost, const char* unit){
+	if (cost->count == 0)
+		return;
+
+	printf("  %-14s %6u %6.2f us %6.1f us", name, cost->count, cost->ns / 1e3 / cost->count, cost->maxNs / 1e3);
+	if (unit)
+		printf("   %.1f %s, %.1f ns per unit", (double) cost->bytes / cost->count, unit,
+				cost->bytes ? (double) cost->ns / cost->bytes : 0.0);
+	printf("\n");
+}
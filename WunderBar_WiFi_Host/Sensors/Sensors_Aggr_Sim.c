@@ -0,0 +1,282 @@
+/** @file   Sensors_Aggr_Sim.c
+ *  @brief  Host simulation of sensor data aggregation (Sensors_Aggr.c).
+ *
+ *  		Sensors notify data at their rate for a simulated minute, aggregation
+ *  		task (Sensors_ProcessAggregation) runs every SIM_TASK_MS as from
+ *  		GS main state machine. Published data messages are counted and every
+ *  		sample is followed until the message which carries it, so message
+ *  		reduction and latency added by aggregation are reported per setting.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Common_Defaults.h"
+#include "Sensors/Sensors_main.h"
+#include "Sensors/Sensors_SensID.h"
+#include "Sensors/Sensors_Aggr.h"
+#include "MQTT/MQTT_Api_Client/MQTT_Api.h"
+
+
+// simulated environment
+
+#define SIM_TASK_MS				10					// aggregation task period
+#define SIM_RUN_MS				60000				// simulated time of one setting
+#define SIM_SAMPLES_MAX			(1 << 17)			// samples waiting for publish
+
+typedef struct {
+	data_id_t   sensor;
+	const char* name;
+	uint32_t    interval;							// ms between notifications
+} Sim_Sensor_t;
+
+static const Sim_Sensor_t Sim_Sensors[] = {
+	{ DATA_ID_DEV_HTU,   "htu",   1000 },
+	{ DATA_ID_DEV_GYRO,  "gyro",  10   },
+	{ DATA_ID_DEV_LIGHT, "light", 200  },
+	{ DATA_ID_DEV_SOUND, "sound", 100  }
+};
+
+static const char* const Sim_Settings[] = {
+	"{\"window\":0}",
+	"{\"window\":10}",
+	"{\"window\":100}",
+	"{\"period\":1000}",
+	"{\"period\":5000}",
+	"{\"window\":50,\"period\":1000}"
+};
+
+static unsigned long long int Sim_Ms;				// ms timer
+
+// samples of sensor waiting for the message which carries them (ring of arrival times)
+static unsigned long long int Sim_Arrival[SIM_SAMPLES_MAX];
+static uint32_t Sim_Head, Sim_Tail;
+
+static uint32_t Sim_Messages;						// data messages published
+static uint32_t Sim_Bytes;
+static uint32_t Sim_Samples;						// samples carried by published messages
+static uint32_t Sim_LastCnt;						// samples in last published message
+static unsigned long long int Sim_LatencySum;
+static unsigned long long int Sim_LatencyMax;
+
+static int Test_Failed;
+
+void Sensors_MsgParse(MQTT_User_Message_t* MyMessage);		// mqtt receive callback, not in header
+
+#define CHECK(cond)		do { if (!(cond)) { printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); Test_Failed ++; } } while (0)
+
+wcfg_t wunderbar_configuration;
+const uint8_t  SENSORS_DEVICE_NAME[NUMBER_OF_SENSORS][BLE_DEVNAME_MAX_LEN + 1];
+const uint16_t SENSOR_CHAR_UUIDS[NUMBER_OF_RELAYR_CHARACTERISTICS + 1];
+
+char MQTT_Get_RunnigStatus(){ return 1; }
+void MQTT_Api_SetReceiveCallBack(void (*MQTT_User_CallBack)(MQTT_User_Message_t* userMessage)){}
+char MQTT_Api_SubscrList(char* topics, int len, int qos){ return 0; }
+char MQTT_Api_UnsubscrList(char* topics, int len){ return 0; }
+void MQTT_Msg_ClearMsgInProgress(){}
+unsigned long long int MSTimerGet(){ return Sim_Ms; }
+unsigned long long int MSTimerDelta(unsigned long long int timer){ return Sim_Ms - timer; }
+unsigned long long int RTC_GetTime(){ return 1420070400000ULL + Sim_Ms; }
+int  RTC_GetSystemTimeStr(char* txt){ return sprintf(txt, "%llu", RTC_GetTime()); }
+void Sensors_Cfg_ProcessBleMsg(spi_frame_t* spi_msg){}
+bool Sensors_SPI_SendMsg(spi_frame_t* SPI_msg){ return true; }
+void Sensors_Spool_Init(){}
+bool Sensors_Spool_Store(const char* topic, int topiclen, const char* payload, int payloadlen){ return true; }
+
+/**
+*  @brief  Published message, samples it carries are taken from waiting ring
+*
+*  Summary carries "cnt" samples, regular data message carries one.
+*/
+char MQTT_Api_Publish(MQTT_User_Message_t* msg){
+	const char* cnt;
+	uint32_t n = 1;
+
+	if (strstr(msg->topicStr, SENS_UP_DATA) == NULL)
+		return 0;
+
+	if ((cnt = strstr(msg->payloadStr, "\"cnt\":")) != NULL)
+		n = strtoul(&cnt[6], NULL, 10);
+
+	Sim_Messages ++;
+	Sim_Bytes += msg->topiclen + msg->payloadlen;
+	Sim_Samples += n;
+	Sim_LastCnt = n;
+
+	while (n -- && (Sim_Tail != Sim_Head))
+	{
+		unsigned long long int latency = Sim_Ms - Sim_Arrival[Sim_Tail ++ % SIM_SAMPLES_MAX];
+
+		Sim_LatencySum += latency;
+		if (latency > Sim_LatencyMax)
+			Sim_LatencyMax = latency;
+	}
+
+	return 0;
+}
+
+/**
+*  @brief  Connect or disconnect sensor, sensor with index i has id bytes i, i + 1 ...
+*/
+static void Sim_Connect(data_id_t sensor, bool connect){
+	char id[SENSOR_ID_LEN];
+	int j;
+
+	for (j = 0; j < SENSOR_ID_LEN; j ++)
+		id[j] = (char) (0x10 * (sensor + 1) + j);
+	Sensors_ID_Process(id, (char) sensor, connect ? 0 : 1);
+}
+
+/**
+*  @brief  Send aggregation setting to sensor
+*/
+static void Sim_Config(data_id_t sensor, const char* setting){
+	MQTT_User_Message_t msg;
+	char topic[MQTT_MSG_TOPIC_MAX];
+	char text[64];
+
+	snprintf(topic, sizeof(topic), MQTT_TOPIC_PREFIX "/%s" SENS_DOWN_AGGREGATE, Sensors_ID_GetSensorID(sensor));
+	strcpy(text, setting);
+
+	memset((void *) &msg, 0, sizeof(msg));
+	msg.topicStr = topic;
+	msg.topiclen = strlen(topic);
+	msg.payloadStr = text;
+	msg.payloadlen = strlen(text);
+
+	Sensors_MsgParse(&msg);
+}
+
+/**
+*  @brief  Sensor data notification received over SPI
+*/
+static void Sim_Notify(data_id_t sensor){
+	spi_frame_t frame;
+	int i;
+
+	memset((void *) &frame, 0, sizeof(frame));
+	frame.data_id  = sensor;
+	frame.field_id = FIELD_ID_CHAR_SENSOR_DATA_R;
+	for (i = 0; i < SPI_PACKET_DATA_SIZE; i ++)
+		frame.data[i] = rand();
+
+	Sim_Arrival[Sim_Head ++ % SIM_SAMPLES_MAX] = Sim_Ms;
+	Sensors_Process_Data(&frame);
+}
+
+static void Sim_ResetCounters(){
+	Sim_Head = Sim_Tail = 0;
+	Sim_Messages = Sim_Bytes = Sim_Samples = 0;
+	Sim_LatencySum = Sim_LatencyMax = 0;
+}
+
+/**
+*  @brief  Run sensor at its rate, aggregation task every SIM_TASK_MS
+*
+*  @param  Sensor
+*  @param  ms between notifications, 0 if sensor does not send data
+*  @param  Simulated time in ms
+*/
+static void Sim_Run(data_id_t sensor, uint32_t interval, uint32_t ms){
+	unsigned long long int end = Sim_Ms + ms;
+
+	while (Sim_Ms < end)
+	{
+		if ((interval != 0) && (Sim_Ms % interval == 0))
+			Sim_Notify(sensor);
+		if (Sim_Ms % SIM_TASK_MS == 0)
+			Sensors_ProcessAggregation();
+		Sim_Ms ++;
+	}
+}
+
+
+// test
+
+/** @brief Window with period only is not closed by number of samples */
+static void Test_TimeOnlyWindow(){
+	Sim_Config(DATA_ID_DEV_GYRO, "{\"period\":100000}");
+	Sim_ResetCounters();
+
+	Sim_Run(DATA_ID_DEV_GYRO, 1, 100000);
+	Sim_Run(DATA_ID_DEV_GYRO, 0, SIM_TASK_MS);
+
+	CHECK(Sim_Messages == 1);
+	CHECK(Sim_LastCnt == 100000);
+	CHECK(Sim_Samples == 100000);
+
+	Sim_Config(DATA_ID_DEV_GYRO, "{\"window\":0}");
+}
+
+/** @brief Expired window of disconnected sensor is published when sensor is connected again */
+static void Test_NoTopic(){
+	Sim_Config(DATA_ID_DEV_HTU, "{\"period\":1000}");
+	Sim_ResetCounters();
+
+	Sim_Run(DATA_ID_DEV_HTU, 100, 500);
+	Sim_Connect(DATA_ID_DEV_HTU, false);
+	Sim_Run(DATA_ID_DEV_HTU, 0, 2000);
+	CHECK(Sim_Messages == 0);
+
+	Sim_Connect(DATA_ID_DEV_HTU, true);
+	Sim_Run(DATA_ID_DEV_HTU, 0, SIM_TASK_MS);
+	CHECK(Sim_Messages == 1);
+	CHECK(Sim_LastCnt == 5);
+
+	Sim_Config(DATA_ID_DEV_HTU, "{\"window\":0}");
+}
+
+/**
+*  @brief  Message reduction and added latency of every setting
+*
+*  Passthrough latency is 0 (message is published on notification).
+*/
+static void Test_Report(){
+	unsigned int s, i;
+	uint32_t samples;
+
+	printf("sensor  setting                       samples  messages  reduction    bytes  latency avg/max ms\n");
+
+	for (s = 0; s < sizeof(Sim_Sensors) / sizeof(Sim_Sensors[0]); s ++)
+	{
+		for (i = 0; i < sizeof(Sim_Settings) / sizeof(Sim_Settings[0]); i ++)
+		{
+			Sim_Config(Sim_Sensors[s].sensor, Sim_Settings[i]);
+			Sim_ResetCounters();
+
+			Sim_Run(Sim_Sensors[s].sensor, Sim_Sensors[s].interval, SIM_RUN_MS);
+			samples = Sim_Head;
+
+			// samples of unfinished window are discarded by next setting
+			CHECK(Sim_Samples <= samples);
+			CHECK((i != 0) || (Sim_Samples == samples));
+
+			printf("%-7s %-28s %8u  %8u  %8.1fx  %7u  %7.1f/%llu\n", Sim_Sensors[s].name, Sim_Settings[i],
+					samples, Sim_Messages, Sim_Messages ? (double) samples / Sim_Messages : 0.0, Sim_Bytes,
+					Sim_Samples ? (double) Sim_LatencySum / Sim_Samples : 0.0, Sim_LatencyMax);
+		}
+		Sim_Config(Sim_Sensors[s].sensor, "{\"window\":0}");
+	}
+}
+
+int main(){
+	unsigned int s;
+
+	srand(2015);
+	strcpy((char *) wunderbar_configuration.wunderbar.id, "0a1b2c3d-4e5f-6071-8293-a4b5c6d7e8f9");
+	for (s = 0; s < NUMBER_OF_SENSORS; s ++)
+		Sim_Connect(s, true);
+
+	Test_TimeOnlyWindow();
+	Test_NoTopic();
+	Test_Report();
+
+	printf(Test_Failed ? "FAILED\n" : "PASSED\n");
+	return Test_Failed ? 1 : 0;
+}
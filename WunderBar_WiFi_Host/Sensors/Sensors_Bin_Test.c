@@ -0,0 +1,384 @@
+/** @file   Sensors_Bin_Test.c
+ *  @brief  Host test of binary sensor data messages (Sensors_Bin_Form, "/data/bin" topic).
+ *
+ *  		Decoder below is written from the layout documented in Sensors_common.h
+ *  		only (byte offsets, little endian fields), it does not use firmware structs.
+ *  		Random frames of every sensor are published by firmware in binary form,
+ *  		decoded and rendered to json, which has to be identical to json message
+ *  		published by firmware for the same frame and time stamp.
+ *
+ *  		Sizes of json and binary payloads are reported per sensor.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Common_Defaults.h"
+#include "Sensors/Sensors_main.h"
+#include "Sensors/Sensors_SensID.h"
+#include "Sensors/My_Sensors/Sensors_common.h"
+#include "hardware/Hw_modules.h"
+#include "MQTT/MQTT_Api_Client/MQTT_Api.h"
+
+
+// simulated environment
+
+#define TEST_ROUNDS				20000				// random frames per sensor
+
+volatile uint32_t RTC_TSR;
+volatile uint32_t RTC_TPR;
+volatile uint32_t RTC_TAR;
+
+// last published message
+static char Sim_Topic[MQTT_MSG_TOPIC_MAX + 1];
+static uint8_t Sim_Payload[MQTT_MSG_PAYLOAD_MAX];
+static int Sim_PayloadLen;
+static uint32_t Sim_Published;
+
+static int Test_Failed;
+
+void Sensors_MsgParse(MQTT_User_Message_t* MyMessage);		// mqtt receive callback, not in header
+
+#define CHECK(cond)		do { if (!(cond)) { printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); Test_Failed ++; } } while (0)
+
+wcfg_t wunderbar_configuration;
+const uint8_t  SENSORS_DEVICE_NAME[NUMBER_OF_SENSORS][BLE_DEVNAME_MAX_LEN + 1];
+const uint16_t SENSOR_CHAR_UUIDS[NUMBER_OF_RELAYR_CHARACTERISTICS + 1];
+
+char MQTT_Get_RunnigStatus(){ return 1; }
+void MQTT_Api_SetReceiveCallBack(void (*MQTT_User_CallBack)(MQTT_User_Message_t* userMessage)){}
+char MQTT_Api_SubscrList(char* topics, int len, int qos){ return 0; }
+char MQTT_Api_UnsubscrList(char* topics, int len){ return 0; }
+void MQTT_Msg_ClearMsgInProgress(){}
+unsigned long long int MSTimerGet(){ return 0; }
+unsigned long long int MSTimerDelta(unsigned long long int timer){ return 0; }
+void Sensors_Cfg_ProcessBleMsg(spi_frame_t* spi_msg){}
+bool Sensors_SPI_SendMsg(spi_frame_t* SPI_msg){ return true; }
+void Sensors_Spool_Init(){}
+bool Sensors_Spool_Store(const char* topic, int topiclen, const char* payload, int payloadlen){ return true; }
+
+char MQTT_Api_Publish(MQTT_User_Message_t* msg){
+	memcpy(Sim_Topic, msg->topicStr, msg->topiclen);
+	Sim_Topic[msg->topiclen] = 0;
+	memcpy(Sim_Payload, msg->payloadStr, msg->payloadlen);
+	Sim_PayloadLen = msg->payloadlen;
+	Sim_Published ++;
+	return 0;
+}
+
+/**
+*  @brief  Connect sensor, sensor with index i has id bytes 0x10 * (i + 1), ...
+*/
+static void Sim_Connect(data_id_t sensor){
+	char id[SENSOR_ID_LEN];
+	int j;
+
+	for (j = 0; j < SENSOR_ID_LEN; j ++)
+		id[j] = (char) (0x10 * (sensor + 1) + j);
+	Sensors_ID_Process(id, (char) sensor, 0);
+}
+
+/**
+*  @brief  Select encoding of sensor data
+*/
+static void Sim_Encoding(data_id_t sensor, const char* encoding){
+	MQTT_User_Message_t msg;
+	char topic[MQTT_MSG_TOPIC_MAX];
+	char text[64];
+
+	snprintf(topic, sizeof(topic), MQTT_TOPIC_PREFIX "/%s" SENS_DOWN_ENCODING, Sensors_ID_GetSensorID(sensor));
+	sprintf(text, "{\"encoding\":\"%s\"}", encoding);
+
+	memset((void *) &msg, 0, sizeof(msg));
+	msg.topicStr = topic;
+	msg.topiclen = strlen(topic);
+	msg.payloadStr = text;
+	msg.payloadlen = strlen(text);
+
+	Sensors_MsgParse(&msg);
+}
+
+
+// decoder of documented layout
+
+#define BIN_VERSION				1
+#define BIN_HEADER				10
+#define BIN_BRIDGE_MAX			19
+
+typedef struct {
+	uint8_t  sensor;
+	uint64_t ts;
+	int32_t  v[6];									// values in order of the layout table
+	uint8_t  len;									// bridge payload
+	uint8_t  payload[BIN_BRIDGE_MAX];
+} Bin_Sample_t;
+
+static uint32_t Bin_U(const uint8_t* p, int n){
+	uint32_t x = 0;
+
+	while (n --)
+		x = (x << 8) | p[n];
+	return x;
+}
+
+/**
+*  @brief  Decode binary message
+*
+*  @return true if message has valid layout
+*/
+static bool Bin_Decode(const uint8_t* msg, int len, Bin_Sample_t* s){
+	static const int size[] = { 4, 18, 10, 2 };		// htu, gyro, light, sound
+	int i;
+
+	if ((len < BIN_HEADER) || (msg[0] != BIN_VERSION))
+		return false;
+
+	s->sensor = msg[1];
+	s->ts = (uint64_t) Bin_U(&msg[6], 4) << 32 | Bin_U(&msg[2], 4);
+	msg += BIN_HEADER;
+	len -= BIN_HEADER;
+
+	switch (s->sensor)
+	{
+	case 0 :			// htu: temperature, humidity
+		if (len != size[0])
+			return false;
+		s->v[0] = (int16_t) Bin_U(&msg[0], 2);
+		s->v[1] = (int16_t) Bin_U(&msg[2], 2);
+		return true;
+
+	case 1 :			// gyro: gyro x, y, z, accel x, y, z
+		if (len != size[1])
+			return false;
+		for (i = 0; i < 3; i ++)
+		{
+			s->v[i]     = (int32_t) Bin_U(&msg[4 * i], 4);
+			s->v[3 + i] = (int16_t) Bin_U(&msg[12 + 2 * i], 2);
+		}
+		return true;
+
+	case 2 :			// light: r, g, b, white, proximity
+		if (len != size[2])
+			return false;
+		for (i = 0; i < 5; i ++)
+			s->v[i] = (uint16_t) Bin_U(&msg[2 * i], 2);
+		return true;
+
+	case 3 :			// sound: mic level
+		if (len != size[3])
+			return false;
+		s->v[0] = (int16_t) Bin_U(&msg[0], 2);
+		return true;
+
+	case 4 :			// bridge: length, payload
+		if ((len < 1) || (msg[0] > BIN_BRIDGE_MAX) || (len != 1 + msg[0]))
+			return false;
+		s->len = msg[0];
+		memcpy(s->payload, &msg[1], s->len);
+		return true;
+	}
+
+	return false;
+}
+
+static char* Bin_Fixed2(char* p, int32_t x){
+	int64_t a = x < 0 ? - (int64_t) x : x;
+
+	return p + sprintf(p, "%s%lld.%02d", x < 0 ? "-" : "", (long long int) (a / 100), (int) (a % 100));
+}
+
+/**
+*  @brief  Render decoded sample as json sensor data message
+*/
+static void Bin_Render(const Bin_Sample_t* s, char* buf){
+	static const char* const axis[] = { "x", "y", "z" };
+	char* p = buf + sprintf(buf, "{\"ts\":%llu", (unsigned long long int) s->ts);
+	int i;
+
+	switch (s->sensor)
+	{
+	case 0 :
+		p += sprintf(p, ",\"temp\":");
+		p = Bin_Fixed2(p, s->v[0]);
+		p += sprintf(p, ",\"hum\":");
+		p = Bin_Fixed2(p, s->v[1]);
+		break;
+
+	case 1 :
+		for (i = 0; i < 6; i ++)
+		{
+			p += sprintf(p, "%s\"%s\":", (i == 0) ? ",\"gyro\":{" : (i == 3) ? "},\"accel\":{" : ",", axis[i % 3]);
+			p = Bin_Fixed2(p, s->v[i]);
+		}
+		p += sprintf(p, "}");
+		break;
+
+	case 2 :
+		p += sprintf(p, ",\"light\":%d,\"clr\":{\"r\":%d,\"g\":%d,\"b\":%d},\"prox\":%d", s->v[3], s->v[0], s->v[1], s->v[2], s->v[4]);
+		break;
+
+	case 3 :
+		p += sprintf(p, ",\"snd_level\":%d", s->v[0]);
+		break;
+
+	case 4 :
+		p += sprintf(p, ",\"up_ch_payload\":[");
+		for (i = 0; i < s->len; i ++)
+			p += sprintf(p, "%s%d", i ? "," : "", s->payload[i]);
+		p += sprintf(p, "]");
+		break;
+	}
+
+	sprintf(p, "}");
+}
+
+
+// test
+
+typedef void (*Test_Update_t)(spi_frame_t* SPI_msg, char* buf);
+
+static const Test_Update_t Test_Updates[] = {
+	Sensors_htu_Update, Sensors_gyro_Update, Sensors_light_Update, Sensors_sound_Update, Sensors_bridge_Update
+};
+
+static const char* const Test_SensorNames[] = { "htu", "gyro", "light", "sound", "bridge" };
+
+static int32_t Test_Random(int32_t min, int32_t max){
+	return min + (int32_t) (((uint64_t) (uint32_t) rand() * 65536 + (rand() & 0xFFFF)) % ((uint64_t) max - min + 1));
+}
+
+/**
+*  @brief  Random sensor data frame, every field over its whole range
+*/
+static void Test_RandomFrame(spi_frame_t* frame, uint8_t sensor){
+	int i;
+
+	memset((void *) frame, 0, sizeof(*frame));
+	frame->data_id = sensor;
+	frame->field_id = FIELD_ID_CHAR_SENSOR_DATA_R;
+
+	for (i = 0; i < SPI_PACKET_DATA_SIZE; i ++)
+		frame->data[i] = rand();
+
+	// gyro values are written with 7 digits by json writer
+	if (sensor == DATA_ID_DEV_GYRO)
+	{
+		sensor_gyro_data_t* d = (sensor_gyro_data_t*) &frame->data[0];
+
+		d->gyro.x = Test_Random(-9999999, 9999999);
+		d->gyro.y = Test_Random(-9999999, 9999999) >> Test_Random(0, 20);
+		d->gyro.z = Test_Random(-999, 999);
+	}
+	// length over payload size is cut by both encodings
+	else if ((sensor == DATA_ID_DEV_BRIDGE) && (rand() % 4 != 0))
+		((sensor_bridge_data_t*) &frame->data[0])->payload_length = Test_Random(0, BRIDGE_PAYLOAD_SIZE);
+}
+
+/**
+*  @brief  Decoded binary message renders to json message of firmware
+*
+*  @param  Sensor
+*/
+static void Test_Sensor(uint8_t sensor){
+	char json[MQTT_MSG_PAYLOAD_MAX], decoded[MQTT_MSG_PAYLOAD_MAX];
+	const char* binTopic;
+	spi_frame_t frame, copy;
+	Bin_Sample_t sample;
+	uint32_t jsonBytes = 0, binBytes = 0;
+	int i, topiclen, bad = 0;
+
+	Sim_Encoding(sensor, SENSORS_ENCODING_BIN);
+	binTopic = Sensors_ID_GetBinTopic(sensor, &topiclen);
+	CHECK(binTopic != NULL);
+	if (binTopic == NULL)
+		return;
+
+	for (i = 0; i < TEST_ROUNDS; i ++)
+	{
+		RTC_TSR = (rand() & 1) ? (uint32_t) Test_Random(0, 9999) : (uint32_t) Test_Random(1400000000, INT32_MAX) * 2;
+		RTC_TPR = Test_Random(0, 32767);
+
+		Test_RandomFrame(&frame, sensor);
+		copy = frame;
+
+		Sim_Published = 0;
+		Sensors_Process_Data(&frame);
+		CHECK(Sim_Published == 1);
+		CHECK(strcmp(Sim_Topic, binTopic) == 0);
+
+		memset(&sample, 0, sizeof(sample));
+		if (!Bin_Decode(Sim_Payload, Sim_PayloadLen, &sample) || (sample.sensor != sensor))
+		{
+			if (bad ++ == 0)
+				printf("  %s: binary message of %d bytes not decoded\n", Test_SensorNames[sensor], Sim_PayloadLen);
+			continue;
+		}
+		Bin_Render(&sample, decoded);
+
+		Test_Updates[sensor](&copy, json);
+		if ((strcmp(decoded, json) != 0) || (sample.ts != RTC_GetTime()))
+		{
+			if (bad ++ == 0)
+				printf("  %s\n    %s\n    %s\n", Test_SensorNames[sensor], decoded, json);
+		}
+
+		jsonBytes += strlen(json);
+		binBytes += Sim_PayloadLen;
+	}
+	CHECK(bad == 0);
+
+	// json again after encoding is switched back
+	Sim_Encoding(sensor, SENSORS_ENCODING_JSON);
+	Test_RandomFrame(&frame, sensor);
+	Sensors_Process_Data(&frame);
+	CHECK(strcmp(Sim_Topic, binTopic) != 0);
+	CHECK(Sim_Payload[0] == '{');
+
+	printf("  %-7s json %6.1f bytes  binary %5.1f bytes\n", Test_SensorNames[sensor],
+			(double) jsonBytes / TEST_ROUNDS, (double) binBytes / TEST_ROUNDS);
+}
+
+/** @brief Messages which do not follow the layout are rejected by decoder */
+static void Test_Invalid(){
+	uint8_t msg[BIN_HEADER + 20];
+	Bin_Sample_t sample;
+	spi_frame_t frame;
+	int len;
+
+	Test_RandomFrame(&frame, DATA_ID_DEV_HTU);
+	len = Sensors_Bin_Form(&frame, (char *) msg);
+	CHECK(len == BIN_HEADER + 4);
+	CHECK(Bin_Decode(msg, len, &sample));
+	CHECK(!Bin_Decode(msg, len - 1, &sample));
+
+	msg[0] = BIN_VERSION + 1;
+	CHECK(!Bin_Decode(msg, len, &sample));
+
+	// battery level, revisions and ir are json only
+	frame.data_id = DATA_ID_DEV_IR;
+	CHECK(Sensors_Bin_Form(&frame, (char *) msg) < 0);
+}
+
+int main(){
+	uint8_t sensor;
+
+	srand(2015);
+	strcpy((char *) wunderbar_configuration.wunderbar.id, "0a1b2c3d-4e5f-6071-8293-a4b5c6d7e8f9");
+	for (sensor = 0; sensor < NUMBER_OF_SENSORS; sensor ++)
+		Sim_Connect(sensor);
+
+	Test_Invalid();
+
+	printf("sensor data payload (average per message)\n");
+	for (sensor = DATA_ID_DEV_HTU; sensor <= DATA_ID_DEV_BRIDGE; sensor ++)
+		Test_Sensor(sensor);
+
+	printf(Test_Failed ? "FAILED\n" : "PASSED\n");
+	return Test_Failed ? 1 : 0;
+}
@@ -0,0 +1,403 @@
+/** @file   Sensors_Json_Test.c
+ *  @brief  Host test and benchmark of telemetry json writer (Sensors_*_Update, Sensors_Json_*).
+ *
+ *  		Random SPI frames of every sensor type and characteristic are formatted
+ *  		by firmware update functions and by the sprintf templates which were
+ *  		used before (reference below). Messages have to be byte identical, except
+ *  		for time stamp: it is compared with full 64 bit RTC time in ms, which the
+ *  		"%ld" template cut to 32 bits. Time stamp is written by hardware/RTC.c
+ *  		from simulated RTC registers.
+ *
+ *  		Benchmark gives time per message of both writers for every sensor type.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Common_Defaults.h"
+#include "Sensors/Sensors_main.h"
+#include "Sensors/My_Sensors/Sensors_common.h"
+#include "hardware/Hw_modules.h"
+#include "MQTT/MQTT_Api_Client/MQTT_Api.h"
+
+
+// simulated environment
+
+#define TEST_ROUNDS				20000				// random frames per sensor characteristic
+#define BENCH_ROUNDS			200000
+#define TEST_FIXED2_MAX			9999999				// old writer kept 7 digits of fixed point values
+
+volatile uint32_t RTC_TSR;
+volatile uint32_t RTC_TPR;
+volatile uint32_t RTC_TAR;
+
+static int Test_Failed;
+
+#define CHECK(cond)		do { if (!(cond)) { printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); Test_Failed ++; } } while (0)
+
+wcfg_t wunderbar_configuration;
+const uint8_t  SENSORS_DEVICE_NAME[NUMBER_OF_SENSORS][BLE_DEVNAME_MAX_LEN + 1];
+const uint16_t SENSOR_CHAR_UUIDS[NUMBER_OF_RELAYR_CHARACTERISTICS + 1];
+
+char MQTT_Get_RunnigStatus(){ return 1; }
+char MQTT_Api_Publish(MQTT_User_Message_t* msg){ return 0; }
+void MQTT_Api_SetReceiveCallBack(void (*MQTT_User_CallBack)(MQTT_User_Message_t* userMessage)){}
+char MQTT_Api_SubscrList(char* topics, int len, int qos){ return 0; }
+char MQTT_Api_UnsubscrList(char* topics, int len){ return 0; }
+void MQTT_Msg_ClearMsgInProgress(){}
+unsigned long long int MSTimerGet(){ return 0; }
+unsigned long long int MSTimerDelta(unsigned long long int timer){ return 0; }
+void Sensors_Cfg_ProcessBleMsg(spi_frame_t* spi_msg){}
+bool Sensors_SPI_SendMsg(spi_frame_t* SPI_msg){ return true; }
+void Sensors_Spool_Init(){}
+bool Sensors_Spool_Store(const char* topic, int topiclen, const char* payload, int payloadlen){ return true; }
+
+
+// json writer before integer formatting (sprintf templates)
+
+#define Ref_Template_htu_data		"{\"ts\":%s,\"temp\":%s,\"hum\":%s}"
+#define Ref_Template_gyro_data		"{\"ts\":%s,\"gyro\":{\"x\":%s,\"y\":%s,\"z\":%s},\"accel\":{\"x\":%s,\"y\":%s,\"z\":%s}}"
+#define Ref_Template_light_data		"{\"ts\":%s,\"light\":%d,\"clr\":{\"r\":%d,\"g\":%d,\"b\":%d},\"prox\":%d}"
+#define Ref_Template_sound_data		"{\"ts\":%s,\"snd_level\":%d}"
+#define Ref_Template_bridge_data	"{\"ts\":%s,\"up_ch_payload\":[%s]}"
+#define Ref_Template_battery_level	"{\"ts\":%s,\"val\":%s}"
+#define Ref_Template_firmware_rev	"{\"ts\":%s,\"firmware\":\"%s\"}"
+#define Ref_Template_hardware_rev	"{\"ts\":%s,\"hardware\":\"%s\"}"
+
+static void Ref_Convert_f_Str(char* txt, int x){
+	char temp_txt[9], *ptr;
+	char neg = 0;
+
+	if (x < 0){
+		neg = 1;
+		x = -x;
+	}
+
+	temp_txt[8] = 0;
+	ptr = &temp_txt[7];
+	*ptr-- = '0' + (x /       1) % 10;
+	*ptr-- = '0' + (x /      10) % 10;
+	*ptr-- = '.';
+	*ptr-- = '0' + (x /     100) % 10;
+	*ptr-- = '0' + (x /    1000) % 10;
+	*ptr-- = '0' + (x /   10000) % 10;
+	*ptr-- = '0' + (x /  100000) % 10;
+	*ptr   = '0' + (x / 1000000) % 10;
+
+	while ((*ptr == '0') && (ptr < &temp_txt[4]))
+		ptr ++;
+
+	if (neg)
+		* --ptr = '-';
+
+	strcpy(txt, (const char *) ptr);
+}
+
+static void Ref_FormBridgeArray(sensor_bridge_data_t* bridgeData, char* txt){
+	char* ptr = txt;
+	int i;
+
+	for (i = 0; i < bridgeData->payload_length; i ++)
+	{
+		sprintf(ptr, "%d,", (int) bridgeData->payload[i]);
+		ptr = strchr(ptr, ',');
+		ptr ++;
+	}
+	*(ptr - 1) = 0;
+}
+
+static void Ref_FormFrmHwRevStr(char* txt){
+	char* ptr = txt;
+
+	while ((*ptr != 0xFF) && ((ptr - txt) < SPI_PACKET_DATA_SIZE))
+		ptr ++;
+
+	*ptr = 0;
+}
+
+/**
+*  @brief  Sensor update message as formed by sprintf templates
+*
+*  @param  SPI frame
+*  @param  Message buffer (unchanged if characteristic has no message)
+*  @param  Time stamp
+*/
+static void Ref_Update(spi_frame_t* SPI_msg, char* buf, const char* time){
+	char t[7][10], txt[80];
+
+	switch (SPI_msg->field_id)
+	{
+	case FIELD_ID_CHAR_SENSOR_DATA_R :
+		switch (SPI_msg->data_id)
+		{
+		case DATA_ID_DEV_HTU :
+			{
+				sensor_htu_data_t* d = (sensor_htu_data_t*) &SPI_msg->data[0];
+
+				Ref_Convert_f_Str(t[0], (int) d->temperature);
+				Ref_Convert_f_Str(t[1], (int) d->humidity);
+				sprintf(buf, Ref_Template_htu_data, time, t[0], t[1]);
+			}
+			break;
+
+		case DATA_ID_DEV_GYRO :
+			{
+				sensor_gyro_data_t* d = (sensor_gyro_data_t*) &SPI_msg->data[0];
+
+				Ref_Convert_f_Str(t[1], (int) d->gyro.x);
+				Ref_Convert_f_Str(t[2], (int) d->gyro.y);
+				Ref_Convert_f_Str(t[3], (int) d->gyro.z);
+				Ref_Convert_f_Str(t[4], (int) d->acc.x);
+				Ref_Convert_f_Str(t[5], (int) d->acc.y);
+				Ref_Convert_f_Str(t[6], (int) d->acc.z);
+				sprintf(buf, Ref_Template_gyro_data, time, t[1], t[2], t[3], t[4], t[5], t[6]);
+			}
+			break;
+
+		case DATA_ID_DEV_LIGHT :
+			{
+				sensor_lightprox_data_t* d = (sensor_lightprox_data_t*) &SPI_msg->data[0];
+
+				sprintf(buf, Ref_Template_light_data, time, (int) d->white, (int) d->r, (int) d->g, (int) d->b, (int) d->proximity);
+			}
+			break;
+
+		case DATA_ID_DEV_SOUND :
+			sprintf(buf, Ref_Template_sound_data, time, (int) ((sensor_microphone_data_t*) &SPI_msg->data[0])->mic_level);
+			break;
+
+		case DATA_ID_DEV_BRIDGE :
+			Ref_FormBridgeArray((sensor_bridge_data_t*) &SPI_msg->data[0], txt);
+			sprintf(buf, Ref_Template_bridge_data, time, txt);
+			break;
+
+		default :
+			break;
+		}
+		break;
+
+	case FIELD_ID_CHAR_BATTERY_LEVEL :
+		if (SPI_msg->data_id == DATA_ID_DEV_BRIDGE)
+			break;
+		sprintf(t[0], "%d", (int) (char) SPI_msg->data[0]);
+		sprintf(buf, Ref_Template_battery_level, time, t[0]);
+		break;
+
+	case FIELD_ID_CHAR_FIRMWARE_REVISION :
+		Ref_FormFrmHwRevStr((char *) &SPI_msg->data[0]);
+		sprintf(buf, Ref_Template_firmware_rev, time, (char *) &SPI_msg->data[0]);
+		break;
+
+	case FIELD_ID_CHAR_HARDWARE_REVISION :
+		Ref_FormFrmHwRevStr((char *) &SPI_msg->data[0]);
+		sprintf(buf, Ref_Template_hardware_rev, time, (char *) &SPI_msg->data[0]);
+		break;
+	}
+}
+
+
+// test
+
+typedef void (*Test_Update_t)(spi_frame_t* SPI_msg, char* buf);
+
+static const Test_Update_t Test_Updates[NUMBER_OF_SENSORS] = {
+	Sensors_htu_Update, Sensors_gyro_Update, Sensors_light_Update,
+	Sensors_sound_Update, Sensors_bridge_Update, Sensors_ir_Update
+};
+
+static const char* const Test_SensorNames[NUMBER_OF_SENSORS] = { "htu", "gyro", "light", "sound", "bridge", "ir" };
+
+static const uint8_t Test_Fields[] = {
+	FIELD_ID_CHAR_SENSOR_DATA_R, FIELD_ID_CHAR_BATTERY_LEVEL,
+	FIELD_ID_CHAR_FIRMWARE_REVISION, FIELD_ID_CHAR_HARDWARE_REVISION
+};
+
+static int32_t Test_Random(int32_t min, int32_t max){
+	return min + (int32_t) (((uint64_t) (uint32_t) rand() * 65536 + (rand() & 0xFFFF)) % ((uint64_t) max - min + 1));
+}
+
+/**
+*  @brief  Random RTC time, seconds over 2^31 / 1000 do not fit into "%ld" of 32 bit target
+*/
+static void Test_RandomTime(){
+	RTC_TSR = (rand() & 1) ? (uint32_t) Test_Random(0, 9999) : (uint32_t) Test_Random(1400000000, INT32_MAX) * 2;
+	RTC_TPR = Test_Random(0, 32767);
+}
+
+/**
+*  @brief  Random frame of sensor characteristic within ranges of the old writer
+*/
+static void Test_RandomFrame(spi_frame_t* frame, uint8_t sensor, uint8_t field){
+	int i, len;
+
+	memset((void *) frame, 0, sizeof(*frame));
+	frame->data_id = sensor;
+	frame->field_id = field;
+
+	for (i = 0; i < SPI_PACKET_DATA_SIZE; i ++)
+		frame->data[i] = rand();
+
+	if (field == FIELD_ID_CHAR_SENSOR_DATA_R)
+	{
+		if (sensor == DATA_ID_DEV_GYRO)
+		{
+			sensor_gyro_data_t* d = (sensor_gyro_data_t*) &frame->data[0];
+
+			d->gyro.x = Test_Random(-TEST_FIXED2_MAX, TEST_FIXED2_MAX);
+			d->gyro.y = Test_Random(-TEST_FIXED2_MAX, TEST_FIXED2_MAX) >> Test_Random(0, 20);
+			d->gyro.z = Test_Random(-999, 999);
+		}
+		// empty bridge payload made old writer write before its buffer
+		else if (sensor == DATA_ID_DEV_BRIDGE)
+			((sensor_bridge_data_t*) &frame->data[0])->payload_length = Test_Random(1, BRIDGE_PAYLOAD_SIZE);
+	}
+	else if ((field == FIELD_ID_CHAR_FIRMWARE_REVISION) || (field == FIELD_ID_CHAR_HARDWARE_REVISION))
+	{
+		// printable revision, terminated by 0xFF inside of frame data
+		len = Test_Random(0, SPI_PACKET_DATA_SIZE - 1);
+		for (i = 0; i < len; i ++)
+			frame->data[i] = Test_Random(' ' + 1, '~');
+		frame->data[len] = 0xFF;
+	}
+}
+
+/** @brief Update messages are identical to sprintf templates, time stamp has all 64 bits */
+static void Test_Identical(){
+	char msg[MQTT_MSG_PAYLOAD_MAX], ref[MQTT_MSG_PAYLOAD_MAX], time[24];
+	spi_frame_t frame, copy;
+	uint8_t sensor, f;
+	int i, bad, messages;
+
+	for (sensor = 0; sensor < NUMBER_OF_SENSORS; sensor ++)
+	{
+		for (f = 0; f < sizeof(Test_Fields); f ++)
+		{
+			bad = 0;
+			messages = 0;
+
+			for (i = 0; i < TEST_ROUNDS; i ++)
+			{
+				Test_RandomTime();
+				Test_RandomFrame(&frame, sensor, Test_Fields[f]);
+				copy = frame;
+
+				msg[0] = ref[0] = 0;
+				Test_Updates[sensor](&frame, msg);
+
+				sprintf(time, "%llu", RTC_GetTime());
+				Ref_Update(&copy, ref, time);
+
+				if (strcmp(msg, ref) != 0)
+				{
+					if (bad ++ == 0)
+						printf("  %s field %d\n    %s\n    %s\n", Test_SensorNames[sensor], Test_Fields[f], msg, ref);
+				}
+				messages += (msg[0] != 0);
+			}
+
+			CHECK(bad == 0);
+			CHECK((messages == 0) || (messages == TEST_ROUNDS));
+		}
+	}
+}
+
+/** @brief Time stamp is correct over whole range of RTC seconds */
+static void Test_TimeStamp(){
+	static const uint32_t seconds[] = { 0, 1, 9, 10, 999, 1000, 2147483, 2147484, 1420070400, INT32_MAX, UINT32_MAX };
+	char txt[24], ref[24];
+	uint32_t s, p;
+	int len;
+
+	for (s = 0; s < sizeof(seconds) / sizeof(seconds[0]); s ++)
+	{
+		for (p = 0; p < 32768; p += 7)
+		{
+			RTC_TSR = seconds[s];
+			RTC_TPR = p;
+			len = RTC_GetSystemTimeStr(txt);
+			sprintf(ref, "%llu", RTC_GetTime());
+			if ((strcmp(txt, ref) != 0) || (len != (int) strlen(ref)))
+			{
+				CHECK(strcmp(txt, ref) == 0);
+				return;
+			}
+		}
+	}
+}
+
+
+// benchmark
+
+static uint64_t Bench_Ns(){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+*  @brief  Time per sensor data message of both writers
+*
+*  RTC moves 1 ms per message, like sensors which notify at 1 kHz.
+*/
+static void Bench_Sensor(uint8_t sensor){
+	static spi_frame_t frames[256];
+	char msg[MQTT_MSG_PAYLOAD_MAX], time[24];
+	uint64_t start, ns, refNs;
+	volatile size_t len = 0;
+	int i;
+
+	for (i = 0; i < 256; i ++)
+		Test_RandomFrame(&frames[i], sensor, FIELD_ID_CHAR_SENSOR_DATA_R);
+
+	RTC_TSR = 1420070400;
+	RTC_TPR = 0;
+	start = Bench_Ns();
+	for (i = 0; i < BENCH_ROUNDS; i ++)
+	{
+		RTC_TPR = (RTC_TPR + 33) & 0x7FFF;
+		RTC_TSR += (RTC_TPR < 33);
+		Test_Updates[sensor](&frames[i & 255], msg);
+		len += msg[0];
+	}
+	ns = Bench_Ns() - start;
+
+	RTC_TSR = 1420070400;
+	RTC_TPR = 0;
+	start = Bench_Ns();
+	for (i = 0; i < BENCH_ROUNDS; i ++)
+	{
+		RTC_TPR = (RTC_TPR + 33) & 0x7FFF;
+		RTC_TSR += (RTC_TPR < 33);
+		sprintf(time, "%llu", RTC_GetTime());
+		Ref_Update(&frames[i & 255], msg, time);
+		len += msg[0];
+	}
+	refNs = Bench_Ns() - start;
+
+	printf("  %-7s %6.1f ns (sprintf %6.1f ns)  %3d bytes\n", Test_SensorNames[sensor],
+			(double) ns / BENCH_ROUNDS, (double) refNs / BENCH_ROUNDS, (int) strlen(msg));
+}
+
+int main(){
+	uint8_t sensor;
+
+	srand(2015);
+
+	Test_TimeStamp();
+	Test_Identical();
+
+	printf("sensor data message (ns per message)\n");
+	for (sensor = DATA_ID_DEV_HTU; sensor <= DATA_ID_DEV_BRIDGE; sensor ++)
+		Bench_Sensor(sensor);
+
+	printf(Test_Failed ? "FAILED\n" : "PASSED\n");
+	return Test_Failed ? 1 : 0;
+}
@@ -0,0 +1,494 @@
+/** @file   Sensors_Parse_Fuzz.c
+ *  @brief  Host fuzz test and benchmark of downlink json parsing (JSON_Msg.c).
+ *
+ *  		Payloads of the captured command set (Sensors_Commands.txt) are the
+ *  		seed corpus: every config and cmd message which Sensors_MsgParse
+ *  		handles. Seeds are mutated (json characters replaced, inserted and
+ *  		deleted, message cut) and every mutant is sent to Sensors_MsgParse on
+ *  		topic of its seed, twice with different stack contents. Key lookup by
+ *  		hash is compared with copy of every token and strcmp search which was
+ *  		used before token views.
+ *
+ *  		Benchmark gives time of parse and lookup of all sensor keys per message
+ *  		for key hashed once (JSON_Msg_FindKey), key hashed on every search
+ *  		(JSON_Msg_FindToken) and tokens copied and compared by strcmp.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Common_Defaults.h"
+#include "Sensors/Sensors_main.h"
+#include "Sensors/Sensors_SensID.h"
+#include "Sensors/My_Sensors/Sensors_common.h"
+#include "MQTT/MQTT_Api_Client/MQTT_Api.h"
+#include "JSON/Jsmn/jsmn.h"
+
+
+// simulated environment
+
+#define SIM_COMMANDS_FILE		"Sensors/Sensors_Commands.txt"
+#define SIM_LINE_MAX			512
+#define SIM_SEEDS_MAX			128
+#define FUZZ_MUTANTS			2000				// mutants of every seed
+#define BENCH_ROUNDS			2000
+
+static const char* const Sim_SensorNames[NUMBER_OF_SENSORS] = { "htu", "gyro", "light", "sound", "bridge", "ir" };
+
+typedef struct {
+	int  sensor;
+	char path[64];
+	char payload[SIM_LINE_MAX];
+} Sim_Seed_t;
+
+static Sim_Seed_t Sim_Seeds[SIM_SEEDS_MAX];
+static int Sim_SeedCnt;
+
+static spi_frame_t Sim_Frame;						// last frame sent to master ble module
+static int Sim_Frames;
+static int Test_Failed;
+
+void Sensors_MsgParse(MQTT_User_Message_t* MyMessage);		// mqtt receive callback, not in header
+
+#define CHECK(cond)		do { if (!(cond)) { printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); Test_Failed ++; } } while (0)
+
+wcfg_t wunderbar_configuration;
+const uint8_t  SENSORS_DEVICE_NAME[NUMBER_OF_SENSORS][BLE_DEVNAME_MAX_LEN + 1];
+const uint16_t SENSOR_CHAR_UUIDS[NUMBER_OF_RELAYR_CHARACTERISTICS + 1];
+
+char MQTT_Get_RunnigStatus(){ return 1; }
+char MQTT_Api_Publish(MQTT_User_Message_t* msg){ return 0; }
+void MQTT_Api_SetReceiveCallBack(void (*MQTT_User_CallBack)(MQTT_User_Message_t* userMessage)){}
+char MQTT_Api_SubscrList(char* topics, int len, int qos){ return 0; }
+char MQTT_Api_UnsubscrList(char* topics, int len){ return 0; }
+void MQTT_Msg_ClearMsgInProgress(){}
+unsigned long long int MSTimerGet(){ return 0; }
+unsigned long long int MSTimerDelta(unsigned long long int timer){ return 0; }
+unsigned long long int RTC_GetTime(){ return 1420070400000ULL; }
+int  RTC_GetSystemTimeStr(char* txt){ return sprintf(txt, "%llu", RTC_GetTime()); }
+void Sensors_Cfg_ProcessBleMsg(spi_frame_t* spi_msg){}
+void Sensors_Spool_Init(){}
+bool Sensors_Spool_Store(const char* topic, int topiclen, const char* payload, int payloadlen){ return true; }
+
+bool Sensors_SPI_SendMsg(spi_frame_t* SPI_msg){
+	Sim_Frame = *SPI_msg;
+	Sim_Frames ++;
+	return true;
+}
+
+/**
+*  @brief  Connect all sensors, sensor with index i has id bytes i, i + 1 ...
+*/
+static void Sim_ConnectSensors(){
+	char id[SENSOR_ID_LEN];
+	int i, j;
+
+	strcpy((char *) wunderbar_configuration.wunderbar.id, "0a1b2c3d-4e5f-6071-8293-a4b5c6d7e8f9");
+
+	for (i = 0; i < NUMBER_OF_SENSORS; i ++)
+	{
+		for (j = 0; j < SENSOR_ID_LEN; j ++)
+			id[j] = (char) (0x10 * (i + 1) + j);
+		Sensors_ID_Process(id, (char) i, 0);
+	}
+}
+
+/**
+*  @brief  Read payloads of command file as seed corpus
+*
+*  @return Number of seeds
+*/
+static int Sim_ReadSeeds(const char* file){
+	char line[SIM_LINE_MAX], name[16];
+	char* arrow;
+	Sim_Seed_t* seed;
+	int n;
+	FILE* f;
+
+	if ((f = fopen(file, "r")) == NULL)
+		return 0;
+
+	while ((fgets(line, sizeof(line), f) != NULL) && (Sim_SeedCnt < SIM_SEEDS_MAX))
+	{
+		line[strcspn(line, "\r\n")] = 0;
+		if ((line[0] == '#') || (line[0] == 0) || ((arrow = strstr(line, " => ")) == NULL))
+			continue;
+
+		seed = &Sim_Seeds[Sim_SeedCnt];
+		if (sscanf(line, "%15s %63s %n", name, seed->path, &n) != 2)
+			continue;
+		*arrow = 0;
+		strcpy(seed->payload, &line[n]);
+
+		for (seed->sensor = 0; seed->sensor < NUMBER_OF_SENSORS; seed->sensor ++)
+			if (strcmp(name, Sim_SensorNames[seed->sensor]) == 0)
+				break;
+		if (seed->sensor < NUMBER_OF_SENSORS)
+			Sim_SeedCnt ++;
+	}
+	fclose(f);
+
+	return Sim_SeedCnt;
+}
+
+/**
+*  @brief  Fill stack below caller with pattern
+*/
+static void __attribute__((noinline)) Sim_FillStack(uint8_t pattern){
+	volatile uint8_t stack[4096];
+	int i;
+
+	for (i = 0; i < (int) sizeof(stack); i ++)
+		stack[i] = pattern;
+}
+
+/**
+*  @brief  Send command to Sensors_MsgParse
+*
+*  @param  Sensor index
+*  @param  Topic after sensor id
+*  @param  Json payload
+*  @param  Stack fill pattern
+*
+*  @return true if SPI frame was sent
+*/
+static bool __attribute__((noinline)) Sim_Command(int sensor, const char* path, const char* payload, uint8_t pattern){
+	MQTT_User_Message_t msg;
+	char topic[MQTT_MSG_TOPIC_MAX];
+	char text[SIM_LINE_MAX];
+	int frames = Sim_Frames;
+
+	snprintf(topic, sizeof(topic), MQTT_TOPIC_PREFIX "/%s%s", Sensors_ID_GetSensorID(sensor), path);
+	strcpy(text, payload);
+
+	memset((void *) &msg, 0, sizeof(msg));
+	msg.topicStr = topic;
+	msg.topiclen = strlen(topic);
+	msg.payloadStr = text;
+	msg.payloadlen = strlen(text);
+
+	memset((void *) &Sim_Frame, pattern, sizeof(Sim_Frame));
+	Sim_FillStack(pattern);
+	Sensors_MsgParse(&msg);
+
+	return Sim_Frames != frames;
+}
+
+
+// json parsing before token views (every token copied, strcmp search, sscanf values)
+
+typedef char Ref_JSONString_t[40];
+
+static Ref_JSONString_t Ref_Str[MAX_TOKEN_NUMBER];
+static jsmntok_t Ref_Tok[MAX_TOKEN_NUMBER];
+static int Ref_TotalTokensFound;
+static bool Ref_TooLong;							// token did not fit into copy (old parser wrote over next one)
+
+static int Ref_Parse(char* msg){
+	jsmn_parser p;
+	int i;
+
+	jsmn_init(&p);
+
+	if ((Ref_TotalTokensFound = jsmn_parse(&p, msg, strlen(msg), Ref_Tok, MAX_TOKEN_NUMBER)) > MAX_TOKEN_NUMBER)
+		return -1;
+
+	Ref_TooLong = false;
+	for (i = 0; i < Ref_TotalTokensFound; i ++)
+	{
+		if (Ref_Tok[i].end - Ref_Tok[i].start >= (int) sizeof(Ref_JSONString_t))
+			Ref_TooLong = true;
+		else if ((Ref_Tok[i].type == JSMN_STRING) || (Ref_Tok[i].type == JSMN_PRIMITIVE))
+		{
+			memcpy((void *) Ref_Str[i], (const void *) &msg[Ref_Tok[i].start], Ref_Tok[i].end - Ref_Tok[i].start);
+			Ref_Str[i][Ref_Tok[i].end - Ref_Tok[i].start] = 0;
+		}
+	}
+
+	return Ref_TotalTokensFound;
+}
+
+static int Ref_FindToken(const char* tokStr, int cnt){
+	int i;
+
+	for (i = cnt; i < Ref_TotalTokensFound; i ++)
+		if (strcmp((const char *) &Ref_Str[i][0], tokStr) == 0)
+			break;
+
+	if (i >= Ref_TotalTokensFound)
+		return -1;
+	else
+		return (i + 1);
+}
+
+/**
+*  @brief  Search of string tokens only
+*
+*  Old search also matched unquoted primitives and stale text of object tokens,
+*  keys are json strings for token views.
+*/
+static int Ref_FindStringToken(const char* tokStr, int cnt){
+	int i;
+
+	for (i = cnt; i < Ref_TotalTokensFound; i ++)
+		if ((Ref_Tok[i].type == JSMN_STRING) && (strcmp((const char *) &Ref_Str[i][0], tokStr) == 0))
+			break;
+
+	if (i >= Ref_TotalTokensFound)
+		return -1;
+	else
+		return (i + 1);
+}
+
+
+// test
+
+static const char Fuzz_Chars[] = "{}[]\":,-.0123456789 eEtruefalsn_xyz";
+
+/**
+*  @brief  Mutate seed payload
+*
+*  @param  Seed payload
+*  @param  Return mutant (zero terminated, without zero bytes inside)
+*/
+static void Fuzz_Mutate(const char* seed, char* out){
+	int len = strlen(seed), i, n, pos, edits;
+
+	strcpy(out, seed);
+	edits = 1 + rand() % 4;
+
+	for (n = 0; n < edits; n ++)
+	{
+		pos = (len > 0) ? rand() % len : 0;
+
+		switch (rand() % 5)
+		{
+		case 0 :							// replace character
+			if (len > 0)
+				out[pos] = Fuzz_Chars[rand() % (sizeof(Fuzz_Chars) - 1)];
+			break;
+
+		case 1 :							// insert character
+			if (len < SIM_LINE_MAX - 2)
+			{
+				memmove(&out[pos + 1], &out[pos], len - pos + 1);
+				out[pos] = Fuzz_Chars[rand() % (sizeof(Fuzz_Chars) - 1)];
+				len ++;
+			}
+			break;
+
+		case 2 :							// delete character
+			if (len > 0)
+			{
+				memmove(&out[pos], &out[pos + 1], len - pos);
+				len --;
+			}
+			break;
+
+		case 3 :							// cut message
+			out[pos] = 0;
+			len = pos;
+			break;
+
+		default :							// repeat part of message
+			i = (len > 0) ? 1 + rand() % 16 : 0;
+			if ((pos + i <= len) && (len + i < SIM_LINE_MAX - 1))
+			{
+				memmove(&out[pos + i], &out[pos], len - pos + 1);
+				len += i;
+			}
+			break;
+		}
+	}
+}
+
+/**
+*  @brief  Key lookup by hash gives the same tokens as strcmp search
+*
+*  Compared for every sensor key and for every string token text of message.
+*  Messages with tokens which did not fit into old token copies are skipped.
+*
+*  @return false if message was skipped
+*/
+static bool Fuzz_CompareLookup(char* payload){
+	int n, i, k;
+
+	n = JSON_Msg_Parse(payload);
+	if (Ref_Parse(payload) != n)
+	{
+		CHECK(false);
+		return true;
+	}
+
+	if (Ref_TooLong)
+		return false;
+
+	for (k = 0; k < SENS_KEY_COUNT; k ++)
+	{
+		CHECK(JSON_Msg_FindKey(&Sensors_Keys[k], 0) == Ref_FindStringToken(Sensors_Keys[k].str, 0));
+		CHECK(JSON_Msg_FindToken((char *) Sensors_Keys[k].str, 0) == Ref_FindStringToken(Sensors_Keys[k].str, 0));
+	}
+
+	for (i = 0; i < n; i ++)
+		if (Ref_Tok[i].type == JSMN_STRING)
+			CHECK(JSON_Msg_FindToken(Ref_Str[i], 0) == Ref_FindStringToken(Ref_Str[i], 0));
+
+	return true;
+}
+
+/** @brief Mutants of every seed are decoded the same way with any stack contents, lookup matches strcmp search */
+static void Test_Fuzz(){
+	char mutant[SIM_LINE_MAX];
+	spi_frame_t frame;
+	bool sent;
+	int s, m, mutants = 0, frames = 0, compared = 0;
+
+	for (s = 0; s < Sim_SeedCnt; s ++)
+	{
+		for (m = 0; m < FUZZ_MUTANTS; m ++)
+		{
+			Fuzz_Mutate(Sim_Seeds[s].payload, mutant);
+			mutants ++;
+
+			sent = Sim_Command(Sim_Seeds[s].sensor, Sim_Seeds[s].path, mutant, 0x00);
+			frame = Sim_Frame;
+			CHECK(Sim_Command(Sim_Seeds[s].sensor, Sim_Seeds[s].path, mutant, 0xA5) == sent);
+
+			if (sent)
+			{
+				frames ++;
+				CHECK(memcmp((const void *) &frame, (const void *) &Sim_Frame, sizeof(frame)) == 0);
+				CHECK(frame.data_id == Sim_Seeds[s].sensor);
+			}
+
+			compared += Fuzz_CompareLookup(mutant);
+		}
+	}
+
+	printf("%d seeds, %d mutants, %d frames sent, %d lookups compared\n", Sim_SeedCnt, mutants, frames, compared);
+}
+
+
+// benchmark
+
+static volatile int Bench_Sink;
+
+static uint64_t Bench_Ns(){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+*  @brief  Parse every seed and look up all sensor keys, read value of found keys
+*
+*  @param  0 - key hashed once, 1 - key hashed on every search, 2 - copied tokens and strcmp
+*
+*  @return ns per message
+*/
+static double Bench_Lookup(int method){
+	char text[SIM_LINE_MAX];
+	uint64_t start, ns = 0;
+	int32_t value;
+	double d;
+	int r, s, k, c;
+
+	for (r = 0; r < BENCH_ROUNDS; r ++)
+	{
+		for (s = 0; s < Sim_SeedCnt; s ++)
+		{
+			strcpy(text, Sim_Seeds[s].payload);
+			start = Bench_Ns();
+
+			if (method == 2)
+			{
+				Ref_Parse(text);
+				for (k = 0; k < SENS_KEY_COUNT; k ++)
+					if (((c = Ref_FindToken(Sensors_Keys[k].str, 0)) > 0) && (c < Ref_TotalTokensFound))
+					{
+						d = atof(Ref_Str[c]);
+						Bench_Sink += (int) d;
+					}
+			}
+			else
+			{
+				JSON_Msg_Parse(text);
+				for (k = 0; k < SENS_KEY_COUNT; k ++)
+				{
+					c = method ? JSON_Msg_FindToken((char *) Sensors_Keys[k].str, 0) : JSON_Msg_FindKey(&Sensors_Keys[k], 0);
+					if ((c > 0) && (JSON_Msg_GetFixed(c, 2, &value) == 0))
+						Bench_Sink += value;
+				}
+			}
+
+			ns += Bench_Ns() - start;
+		}
+	}
+
+	return (double) ns / BENCH_ROUNDS / Sim_SeedCnt;
+}
+
+/**
+*  @brief  Decode time of whole command (Sensors_MsgParse), ns per message
+*/
+static double Bench_MsgParse(){
+	static char topics[SIM_SEEDS_MAX][MQTT_MSG_TOPIC_MAX];
+	MQTT_User_Message_t msg;
+	char text[SIM_LINE_MAX];
+	uint64_t start, ns = 0;
+	int r, s;
+
+	for (s = 0; s < Sim_SeedCnt; s ++)
+		snprintf(topics[s], sizeof(topics[s]), MQTT_TOPIC_PREFIX "/%s%s", Sensors_ID_GetSensorID(Sim_Seeds[s].sensor), Sim_Seeds[s].path);
+
+	for (r = 0; r < BENCH_ROUNDS; r ++)
+	{
+		for (s = 0; s < Sim_SeedCnt; s ++)
+		{
+			strcpy(text, Sim_Seeds[s].payload);
+			memset((void *) &msg, 0, sizeof(msg));
+			msg.topicStr = topics[s];
+			msg.topiclen = strlen(topics[s]);
+			msg.payloadStr = text;
+			msg.payloadlen = strlen(text);
+
+			start = Bench_Ns();
+			Sensors_MsgParse(&msg);
+			ns += Bench_Ns() - start;
+		}
+	}
+
+	return (double) ns / BENCH_ROUNDS / Sim_SeedCnt;
+}
+
+int main(int argc, char* argv[]){
+	const char* file = (argc > 1) ? argv[1] : SIM_COMMANDS_FILE;
+
+	if (Sim_ReadSeeds(file) == 0)
+	{
+		printf("can not read seeds from %s\n", file);
+		return 1;
+	}
+
+	srand(2015);
+	Sim_ConnectSensors();
+
+	Test_Fuzz();
+
+	printf("parse and lookup of %d keys (ns per message)\n", SENS_KEY_COUNT);
+	printf("  key hashed once      %7.1f ns\n", Bench_Lookup(0));
+	printf("  key hashed on search %7.1f ns\n", Bench_Lookup(1));
+	printf("  token copy, strcmp   %7.1f ns\n", Bench_Lookup(2));
+	printf("Sensors_MsgParse       %7.1f ns per command\n", Bench_MsgParse());
+
+	printf(Test_Failed ? "FAILED\n" : "PASSED\n");
+	return Test_Failed ? 1 : 0;
+}
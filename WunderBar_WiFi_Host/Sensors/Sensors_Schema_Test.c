@@ -0,0 +1,282 @@
+/** @file   Sensors_Schema_Test.c
+ *  @brief  Host test of downlink command decoding (Sensors_MsgParse and Sensors_Schema.c).
+ *
+ *  		Captured command set (Sensors_Commands.txt) is sent to Sensors_MsgParse as
+ *  		mqtt messages on topics of connected sensors. SPI frame given to
+ *  		Sensors_SPI_SendMsg is compared byte by byte with the frame which was
+ *  		sent by the hand written decoders before the schema table. Every command
+ *  		is decoded twice with different stack contents, frame may not depend on it.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Common_Defaults.h"
+#include "Sensors/Sensors_main.h"
+#include "Sensors/Sensors_SensID.h"
+#include "MQTT/MQTT_Api_Client/MQTT_Api.h"
+
+
+// simulated environment
+
+#define SIM_COMMANDS_FILE		"Sensors/Sensors_Commands.txt"
+#define SIM_LINE_MAX			512
+#define SIM_FRAME_UNDEF			0x100				// frame byte not written by decoder
+
+static const char* const Sim_SensorNames[NUMBER_OF_SENSORS] = { "htu", "gyro", "light", "sound", "bridge", "ir" };
+
+static spi_frame_t Sim_Frame;						// last frame sent to master ble module
+static int Sim_Frames;
+static int Test_Failed;
+
+void Sensors_MsgParse(MQTT_User_Message_t* MyMessage);		// mqtt receive callback, not in header
+
+#define CHECK(cond)		do { if (!(cond)) { printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); Test_Failed ++; } } while (0)
+
+wcfg_t wunderbar_configuration;
+const uint8_t  SENSORS_DEVICE_NAME[NUMBER_OF_SENSORS][BLE_DEVNAME_MAX_LEN + 1];
+const uint16_t SENSOR_CHAR_UUIDS[NUMBER_OF_RELAYR_CHARACTERISTICS + 1];
+
+char MQTT_Get_RunnigStatus(){ return 1; }
+char MQTT_Api_Publish(MQTT_User_Message_t* msg){ return 0; }
+void MQTT_Api_SetReceiveCallBack(void (*MQTT_User_CallBack)(MQTT_User_Message_t* userMessage)){}
+char MQTT_Api_SubscrList(char* topics, int len, int qos){ return 0; }
+char MQTT_Api_UnsubscrList(char* topics, int len){ return 0; }
+void MQTT_Msg_ClearMsgInProgress(){}
+unsigned long long int MSTimerGet(){ return 0; }
+unsigned long long int MSTimerDelta(unsigned long long int timer){ return 0; }
+unsigned long long int RTC_GetTime(){ return 1420070400000ULL; }
+int  RTC_GetSystemTimeStr(char* txt){ return sprintf(txt, "%llu", RTC_GetTime()); }
+void Sensors_Cfg_ProcessBleMsg(spi_frame_t* spi_msg){}
+void Sensors_Spool_Init(){}
+bool Sensors_Spool_Store(const char* topic, int topiclen, const char* payload, int payloadlen){ return true; }
+
+bool Sensors_SPI_SendMsg(spi_frame_t* SPI_msg){
+	Sim_Frame = *SPI_msg;
+	Sim_Frames ++;
+	return true;
+}
+
+/**
+*  @brief  Connect all sensors, sensor with index i has id bytes i, i + 1 ...
+*/
+static void Sim_ConnectSensors(){
+	char id[SENSOR_ID_LEN];
+	int i, j;
+
+	strcpy((char *) wunderbar_configuration.wunderbar.id, "0a1b2c3d-4e5f-6071-8293-a4b5c6d7e8f9");
+
+	for (i = 0; i < NUMBER_OF_SENSORS; i ++)
+	{
+		for (j = 0; j < SENSOR_ID_LEN; j ++)
+			id[j] = (char) (0x10 * (i + 1) + j);
+		Sensors_ID_Process(id, (char) i, 0);
+	}
+}
+
+/**
+*  @brief  Fill stack below caller with pattern
+*/
+static void __attribute__((noinline)) Sim_FillStack(uint8_t pattern){
+	volatile uint8_t stack[4096];
+	int i;
+
+	for (i = 0; i < (int) sizeof(stack); i ++)
+		stack[i] = pattern;
+}
+
+/**
+*  @brief  Send command to Sensors_MsgParse
+*
+*  @param  Sensor index
+*  @param  Topic after sensor id
+*  @param  Json payload
+*  @param  Stack fill pattern
+*
+*  @return true if SPI frame was sent
+*/
+static bool __attribute__((noinline)) Sim_Command(int sensor, const char* path, const char* payload, uint8_t pattern){
+	MQTT_User_Message_t msg;
+	char topic[MQTT_MSG_TOPIC_MAX];
+	char text[SIM_LINE_MAX];
+	int frames = Sim_Frames;
+
+	snprintf(topic, sizeof(topic), MQTT_TOPIC_PREFIX "/%s%s", Sensors_ID_GetSensorID(sensor), path);
+	strcpy(text, payload);
+
+	memset((void *) &msg, 0, sizeof(msg));
+	msg.topicStr = topic;
+	msg.topiclen = strlen(topic);
+	msg.payloadStr = text;
+	msg.payloadlen = strlen(text);
+
+	memset((void *) &Sim_Frame, pattern, sizeof(Sim_Frame));
+	Sim_FillStack(pattern);
+	Sensors_MsgParse(&msg);
+
+	return Sim_Frames != frames;
+}
+
+
+// test
+
+/**
+*  @brief  Parse expected frame ("-" if no frame is sent)
+*
+*  @param  Text after "=>"
+*  @param  Return frame bytes (SIM_FRAME_UNDEF for "--")
+*
+*  @return Number of bytes, -1 if no frame is sent
+*/
+static int Test_ParseFrame(const char* txt, int* frame){
+	int len = 0, n;
+	unsigned int x;
+
+	while (*txt == ' ')
+		txt ++;
+	if ((*txt == '-') && (txt[1] != '-'))
+		return -1;
+
+	while (len < (int) sizeof(spi_frame_t))
+	{
+		if (strncmp(txt, " --", 3) == 0 || strncmp(txt, "--", 2) == 0)
+		{
+			frame[len ++] = SIM_FRAME_UNDEF;
+			txt += (*txt == ' ') ? 3 : 2;
+		}
+		else if (sscanf(txt, " %2x%n", &x, &n) == 1)
+		{
+			frame[len ++] = x;
+			txt += n;
+		}
+		else
+			break;
+	}
+
+	return len;
+}
+
+/**
+*  @brief  Print frame the way it is written in command file
+*/
+static void Test_PrintFrame(const uint8_t* a, const uint8_t* b){
+	int i, len = sizeof(spi_frame_t);
+
+	while ((len > 3) && (a[len - 1] == b[len - 1] ? a[len - 1] == 0 : true))
+		len --;
+
+	for (i = 0; i < len; i ++)
+	{
+		if (a[i] == b[i])
+			printf(" %02x", a[i]);
+		else
+			printf(" --");
+	}
+}
+
+/**
+*  @brief  Decode one command and compare frame with expected one
+*
+*  @param  Command file line
+*  @param  Line number
+*/
+static void Test_Command(char* line, int lineNo){
+	uint8_t sent[2][sizeof(spi_frame_t)];
+	int expect[sizeof(spi_frame_t)];
+	char name[16], path[64];
+	char *payload, *arrow;
+	bool isSent[2];
+	int sensor, len, i, n;
+	bool ok = true;
+
+	if ((sscanf(line, "%15s %63s %n", name, path, &n) != 2) || ((arrow = strstr(line, " => ")) == NULL))
+	{
+		printf("  FAIL line %d: bad format\n", lineNo);
+		Test_Failed ++;
+		return;
+	}
+	payload = &line[n];
+	*arrow = 0;
+
+	for (sensor = 0; sensor < NUMBER_OF_SENSORS; sensor ++)
+		if (strcmp(name, Sim_SensorNames[sensor]) == 0)
+			break;
+	CHECK(sensor < NUMBER_OF_SENSORS);
+	if (sensor == NUMBER_OF_SENSORS)
+		return;
+
+	len = Test_ParseFrame(&arrow[4], expect);
+
+	for (i = 0; i < 2; i ++)
+	{
+		isSent[i] = Sim_Command(sensor, path, payload, i ? 0xA5 : 0x00);
+		memcpy((void *) sent[i], (const void *) &Sim_Frame, sizeof(spi_frame_t));
+	}
+
+	if ((isSent[0] != isSent[1]) || (isSent[0] != (len >= 0)))
+		ok = false;
+	else if (isSent[0])
+	{
+		// frame of schema decoder does not depend on stack, not written bytes are zeros
+		if (memcmp((const void *) sent[0], (const void *) sent[1], sizeof(spi_frame_t)) != 0)
+			ok = false;
+
+		for (i = 0; i < (int) sizeof(spi_frame_t); i ++)
+		{
+			if ((i < len) && (expect[i] == SIM_FRAME_UNDEF))
+				continue;
+			if (sent[0][i] != ((i < len) ? expect[i] : 0))
+				ok = false;
+		}
+	}
+
+	if (!ok)
+	{
+		printf("  FAIL line %d: %s %s %s =>", lineNo, name, path, payload);
+		if (isSent[0])
+			Test_PrintFrame(sent[0], sent[1]);
+		else
+			printf(" -");
+		printf("\n");
+		Test_Failed ++;
+	}
+}
+
+int main(int argc, char* argv[]){
+	const char* file = (argc > 1) ? argv[1] : SIM_COMMANDS_FILE;
+	char line[SIM_LINE_MAX];
+	int lineNo = 0, commands = 0;
+	FILE* f;
+
+	if ((f = fopen(file, "r")) == NULL)
+	{
+		printf("can not open %s\n", file);
+		return 1;
+	}
+
+	Sim_ConnectSensors();
+
+	while (fgets(line, sizeof(line), f) != NULL)
+	{
+		lineNo ++;
+		line[strcspn(line, "\r\n")] = 0;
+		if ((line[0] == '#') || (line[0] == 0))
+			continue;
+
+		Test_Command(line, lineNo);
+		commands ++;
+	}
+	fclose(f);
+
+	printf("%d commands, %d frames sent\n", commands, Sim_Frames / 2);
+	CHECK(commands > 0);
+
+	printf(Test_Failed ? "FAILED\n" : "PASSED\n");
+	return Test_Failed ? 1 : 0;
+}
@@ -0,0 +1,250 @@
+/** @file   Sched_Test.c
+ *  @brief  Host test of cooperative scheduler (Scheduler.c) under cloud load.
+ *
+ *  		Tasks are replaced by stand-ins which take virtual time. Ble master
+ *  		signals spi frames (ext int) at sensor rates and in bursts, timer posts
+ *  		wifi/mqtt task which runs for a random time up to SIM_GS_COST_MAX, so
+ *  		cloud task is pending most of the time. Every frame is followed from its
+ *  		interrupt to the read, test checks that no cloud task run is started
+ *  		while a frame is waiting and that frames are not lost.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Scheduler/Scheduler.h"
+
+
+// simulated environment
+
+#define SIM_NEVER				UINT64_MAX
+#define SIM_RUN_US				60000000ULL				// simulated time of one setting
+#define SIM_SPI_COST			40						// us to read and process one frame
+#define SIM_GS_COST_MAX			5000					// longest wifi/mqtt state machine step
+#define SIM_ONBRD_COST			5
+#define SIM_TI2_PERIOD_US		100000
+#define SIM_BURST				(SCHED_SENSORS_MAX_PENDING - 2)	// frames signaled back to back, ble master queue
+														// also holds regular frames of one cloud step
+
+typedef struct {
+	const char* name;
+	uint32_t    gsPeriod;								// us between wifi/mqtt task posts, 0 = no cloud load
+	uint32_t    blePeriod;								// us between frames of ble master
+	uint32_t    burstPeriod;							// us between bursts of frames, 0 = no bursts
+} Sim_Setting_t;
+
+static const Sim_Setting_t Sim_Settings[] = {
+	{ "idle cloud",        0,    5000, 0       },
+	{ "busy cloud",        1000, 5000, 0       },
+	{ "busy cloud, burst", 1000, 5000, 1000000 },
+	{ "gyro rate",         1000, 1000, 0       }
+};
+
+static uint64_t Sim_Us;								// virtual time
+
+static uint64_t Sim_NextGs, Sim_NextBle, Sim_NextBurst, Sim_NextTi2;
+static const Sim_Setting_t* Sim_Cur;
+
+// frames signaled and not read yet (interrupt times)
+static uint64_t Sim_Frames[4 * SCHED_SENSORS_MAX_PENDING];
+static uint32_t Sim_FrameCnt;
+
+static uint32_t Sim_Signaled;
+static uint32_t Sim_Read;
+static uint32_t Sim_GsRuns;
+static uint32_t Sim_GsBehindFrame;						// cloud runs started while frame was waiting
+static uint64_t Sim_LatencySum;
+static uint64_t Sim_LatencyMax;
+
+static int Test_Failed;
+
+#define CHECK(cond)		do { if (!(cond)) { printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); Test_Failed ++; } } while (0)
+
+/**
+*  @brief  Ble master signals spi frame (EInt2_OnInterrupt)
+*/
+static void Sim_BleIrq(uint64_t t){
+	Sim_Signaled ++;
+	if (Sim_FrameCnt < sizeof(Sim_Frames) / sizeof(Sim_Frames[0]))
+		Sim_Frames[Sim_FrameCnt ++] = t;
+	Sched_Post(SCHED_TASK_SENSORS);
+}
+
+/**
+*  @brief  Time of next interrupt
+*/
+static uint64_t Sim_NextIrq(){
+	uint64_t t = Sim_NextBle;
+
+	if (Sim_NextGs < t)
+		t = Sim_NextGs;
+	if (Sim_NextBurst < t)
+		t = Sim_NextBurst;
+	if (Sim_NextTi2 < t)
+		t = Sim_NextTi2;
+	return t;
+}
+
+/**
+*  @brief  Serve interrupts which became due, in time order
+*/
+static void Sim_ServeIrqs(){
+	uint64_t t;
+	int i;
+
+	while ((t = Sim_NextIrq()) <= Sim_Us)
+	{
+		if (t == Sim_NextBle)
+		{
+			Sim_BleIrq(t);
+			Sim_NextBle += Sim_Cur->blePeriod;
+		}
+		else if (t == Sim_NextBurst)
+		{
+			for (i = 0; i < SIM_BURST; i ++)
+				Sim_BleIrq(t);
+			Sim_NextBurst += Sim_Cur->burstPeriod;
+		}
+		else if (t == Sim_NextGs)
+		{
+			Sched_Post(SCHED_TASK_GS);
+			Sim_NextGs += Sim_Cur->gsPeriod;
+		}
+		else
+		{
+			Sched_Post(SCHED_TASK_ONBRD);
+			Sim_NextTi2 += SIM_TI2_PERIOD_US;
+		}
+	}
+}
+
+/**
+*  @brief  Spi ingress task, reads the oldest signaled frame
+*/
+void Sensors_SPI_ReadMsg(){
+	uint64_t latency;
+
+	Sim_Us += SIM_SPI_COST;
+	if (Sim_FrameCnt == 0)
+		return;
+
+	latency = Sim_Us - Sim_Frames[0];
+	Sim_LatencySum += latency;
+	if (latency > Sim_LatencyMax)
+		Sim_LatencyMax = latency;
+
+	memmove(&Sim_Frames[0], &Sim_Frames[1], -- Sim_FrameCnt * sizeof(Sim_Frames[0]));
+	Sim_Read ++;
+}
+
+/**
+*  @brief  Wifi/mqtt task, one step takes random time
+*/
+void GS_Main_StateMachine(){
+	if (Sim_FrameCnt != 0)
+		Sim_GsBehindFrame ++;
+
+	Sim_GsRuns ++;
+	Sim_Us += 1 + rand() % SIM_GS_COST_MAX;
+}
+
+void Onbrd_Poll(){
+	Sim_Us += SIM_ONBRD_COST;
+}
+
+/**
+*  @brief  Sleep until next interrupt
+*/
+void Sleep_Idle(){
+	uint64_t t = Sim_NextIrq();
+
+	if (t > Sim_Us)
+		Sim_Us = t;
+}
+
+/**
+*  @brief  Run main loop for one setting
+*
+*  @param  Setting
+*  @param  Scheduler stats before the run, returned as stats of the run
+*/
+static void Sim_Run(const Sim_Setting_t* setting, Sched_Stats_t* stats){
+	const Sched_Stats_t* total = Sched_GetStats();
+	uint64_t end;
+	int i;
+
+	Sim_Cur = setting;
+	Sim_FrameCnt = Sim_Signaled = Sim_Read = Sim_GsRuns = Sim_GsBehindFrame = 0;
+	Sim_LatencySum = Sim_LatencyMax = 0;
+
+	end = Sim_Us + SIM_RUN_US;
+	Sim_NextBle   = Sim_Us + setting->blePeriod;
+	Sim_NextGs    = setting->gsPeriod    ? Sim_Us + setting->gsPeriod    : SIM_NEVER;
+	Sim_NextBurst = setting->burstPeriod ? Sim_Us + setting->burstPeriod : SIM_NEVER;
+	Sim_NextTi2   = Sim_Us + SIM_TI2_PERIOD_US;
+
+	while (Sim_Us < end)
+	{
+		Sched_Run();
+		Sim_ServeIrqs();
+	}
+
+	// read frames signaled at the end
+	Sim_NextBle = Sim_NextGs = Sim_NextBurst = Sim_NextTi2 = SIM_NEVER;
+	while (Sim_FrameCnt != 0)
+		Sched_Run();
+
+	for (i = 0; i < SCHED_TASK_COUNT; i ++)
+	{
+		stats->runs[i]     = total->runs[i] - stats->runs[i];
+		stats->overruns[i] = total->overruns[i] - stats->overruns[i];
+	}
+	stats->idles = total->idles - stats->idles;
+}
+
+
+// test
+
+/**
+*  @brief  Spi ingress is not starved by cloud task
+*
+*  Frame waits at most for one cloud step and for frames signaled before it.
+*/
+static void Test_Starvation(){
+	unsigned int s;
+
+	printf("setting             frames   reads  overruns  cloud runs  onbrd runs   idles  latency avg/max us\n");
+
+	for (s = 0; s < sizeof(Sim_Settings) / sizeof(Sim_Settings[0]); s ++)
+	{
+		Sched_Stats_t stats = *Sched_GetStats();
+
+		Sim_Run(&Sim_Settings[s], &stats);
+
+		CHECK(Sim_Read == Sim_Signaled);
+		CHECK(stats.runs[SCHED_TASK_SENSORS] == Sim_Signaled);
+		CHECK(stats.overruns[SCHED_TASK_SENSORS] == 0);
+		CHECK(Sim_GsBehindFrame == 0);
+		CHECK(Sim_LatencyMax <= SIM_GS_COST_MAX + SIM_ONBRD_COST + SCHED_SENSORS_MAX_PENDING * SIM_SPI_COST);
+		CHECK((Sim_Settings[s].gsPeriod == 0) || (Sim_GsRuns > 0));
+
+		printf("%-18s %7u %7u  %8u  %10u  %10u %7u  %7.1f/%llu\n", Sim_Settings[s].name,
+				Sim_Signaled, Sim_Read, stats.overruns[SCHED_TASK_SENSORS], stats.runs[SCHED_TASK_GS],
+				stats.runs[SCHED_TASK_ONBRD], stats.idles,
+				Sim_Read ? (double) Sim_LatencySum / Sim_Read : 0.0, (unsigned long long int) Sim_LatencyMax);
+	}
+}
+
+int main(){
+	srand(2015);
+
+	Test_Starvation();
+
+	printf(Test_Failed ? "FAILED\n" : "PASSED\n");
+	return Test_Failed ? 1 : 0;
+}
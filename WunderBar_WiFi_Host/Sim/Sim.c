@@ -0,0 +1,652 @@
+/** @file   Sim.c
+ *  @brief  Host simulation of WunderBar main board (virtual time, interrupts, rtc, flash, ble master).
+ *
+ *  		Board init and interrupt handlers follow User_init.c and Events.c.
+ *  		Ble master sends status of two sensors after run command and then
+ *  		their readings periodically, one external interrupt per spi frame.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <hardware/Hw_modules.h>
+#include <Common_Defaults.h>
+#include <User_init.h>
+#include "FTFE/flash_FTFE.h"
+#include "GS/GS_User/GS_Certificate.h"
+#include "MQTT/MQTT_Api_Client/MQTT_Api.h"
+#include "Onboarding/Onboarding.h"
+#include "Scheduler/Scheduler.h"
+#include "Sensors/Sensors_main.h"
+#include "Sensors/Sensors_Cfg_Handler.h"
+#include "Sensors/wunderbar_common.h"
+
+#include "Sim.h"
+
+
+#define SIM_NEVER				UINT64_MAX
+#define SIM_TI1_PERIOD_US		50000						// main state machine timer
+#define SIM_TI2_PERIOD_US		(TIMER2_INT_PERIOD * 1000)
+
+#define SIM_CONFIG_FLASH_SIZE	0x2000						// config and certificate sectors
+
+#define SIM_BLE_QUEUE			SCHED_SENSORS_MAX_PENDING	// frames signaled by ble master and not read yet
+#define SIM_BLE_SENSORS			2
+#define SIM_BLE_STATUS_DELAY	200000						// sensor connects after run command
+#define SIM_BLE_DATA_DELAY		300000						// first reading after sensor status
+
+typedef struct {
+	uint8_t     running;
+	spi_frame_t queue[SIM_BLE_QUEUE];
+	uint8_t     head;
+	uint8_t     count;
+	uint64_t    next[SIM_BLE_SENSORS];						// next frame of sensor
+	uint8_t     connected[SIM_BLE_SENSORS];
+	uint32_t    seq[SIM_BLE_SENSORS];
+	uint8_t     rdPos;										// spi transaction in progress
+	uint8_t     wrPos;
+	spi_frame_t wrFrame;
+	Sim_BleStats_t stats;
+} Sim_Ble_t;
+
+typedef struct {
+	uint64_t now;
+	uint64_t limit;
+	uint64_t bootTime;
+	uint32_t boots;
+	uint64_t ti1Next;
+	uint64_t ti2Next;
+	uint64_t rtcBase;			// rtc time (ms) when it was set
+	uint64_t rtcSetAt;			// virtual time when rtc was set
+	uint64_t rtcAlarmSec;
+	uint64_t rtcAlarmAt;
+	uint64_t uartFree;			// tx line is busy until
+	Sim_Ble_t ble;
+} Sim_State_t;
+
+static const struct {
+	data_id_t id;
+	uint32_t  period;			// us between readings
+} Sim_BleSensors[SIM_BLE_SENSORS] = {
+	{ DATA_ID_DEV_HTU,   40000 },
+	{ DATA_ID_DEV_LIGHT, 50000 },
+};
+
+static Sim_State_t*       Sim;
+static const Sim_Hooks_t* Sim_Hooks;
+static uint8_t            Sim_Led;
+
+wcfg_t wunderbar_configuration;
+
+// device names and characteristics are used by ble side of common code only
+const uint8_t  SENSORS_DEVICE_NAME[NUMBER_OF_SENSORS][BLE_DEVNAME_MAX_LEN + 1] = {
+	"WunderbarHTU", "WunderbarGYRO", "WunderbarLIGHT", "WunderbarMIC", "WunderbarBRIDG", "WunderbarIR"
+};
+const uint16_t SENSOR_CHAR_UUIDS[NUMBER_OF_RELAYR_CHARACTERISTICS + 1] = {
+	0x2010, 0x2011, 0x2012, 0x2013, 0x2014, 0x2015, 0x2016, 0x2017, 0x2A19
+};
+
+
+// static declarations
+
+static void Sim_Boot();
+static void Sim_LoadConfiguration();
+static void Sim_MapFlash(uint32_t addr, uint32_t size);
+static bool Sim_InFlash(uint32_t addr, uint32_t len);
+static uint64_t Sim_NextIrq();
+static void Sim_ServeIrq(uint64_t t);
+static void Sim_RtcArm();
+static void Sim_BleReset();
+static void Sim_BleStart();
+static void Sim_BleProduce(int sensor);
+
+
+
+
+	///////////////////////////////////////
+	/*         public functions          */
+	///////////////////////////////////////
+
+
+
+void* Sim_SharedAlloc(size_t size){
+	void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+	if (p == MAP_FAILED)
+	{
+		perror("shared memory");
+		exit(2);
+	}
+	return p;
+}
+
+void Sim_Init(uint32_t limitSeconds){
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	Sim = Sim_SharedAlloc(sizeof(Sim_State_t));
+	Sim->limit = (uint64_t) limitSeconds * 1000000;
+
+	Sim_MapFlash(FLASH_CONFIG_IMAGE_ADDR, SIM_CONFIG_FLASH_SIZE);
+	Sim_MapFlash(FLASH_SPOOL_ADDR, FLASH_SPOOL_SIZE);
+}
+
+void Sim_FactoryFlash(){
+	wcfg_t* cfg = (wcfg_t*) FLASH_CONFIG_IMAGE_ADDR;
+
+	memset(cfg, 0xFF, sizeof(wcfg_t));
+	strcpy((char*) cfg->wunderbar.id, SIM_DEVICE_ID);
+	strcpy((char*) cfg->wunderbar.security, SIM_DEVICE_SECURITY);
+	strcpy((char*) cfg->wifi.ssid, SIM_WIFI_SSID);
+	strcpy((char*) cfg->wifi.password, SIM_WIFI_PASSWORD);
+	strcpy((char*) cfg->cloud.url, SIM_CLOUD_URL);
+}
+
+int Sim_Run(const Sim_Hooks_t* hooks){
+	pid_t pid;
+	int status;
+
+	Sim_Hooks = hooks;
+
+	for (;;)
+	{
+		pid = fork();
+		if (pid < 0)
+		{
+			perror("fork");
+			return 2;
+		}
+		if (pid == 0)
+			Sim_Boot();
+
+		if (waitpid(pid, &status, 0) < 0)
+		{
+			perror("waitpid");
+			return 2;
+		}
+		if (WIFSIGNALED(status))
+		{
+			printf("firmware process killed by signal %d\n", WTERMSIG(status));
+			return 2;
+		}
+		if (WEXITSTATUS(status) != SIM_EXIT_RESET)
+			return WEXITSTATUS(status);
+	}
+}
+
+void Sim_Exit(int status){
+	fflush(stdout);
+	_exit(status);
+}
+
+uint64_t Sim_Now(){
+	return Sim->now;
+}
+
+uint32_t Sim_Millis(){
+	return (Sim->now - Sim->bootTime) / 1000;
+}
+
+uint32_t Sim_Boots(){
+	return Sim->boots;
+}
+
+void Sim_Step(uint64_t us){
+	uint64_t end = Sim->now + us;
+	uint64_t t;
+
+	while ((t = Sim_NextIrq()) <= end)
+	{
+		Sim->now = t;
+		Sim_ServeIrq(t);
+	}
+	Sim->now = end;
+
+	if (Sim_Hooks->Advance)
+		Sim_Hooks->Advance(end);
+
+	if (Sim->now >= Sim->limit)
+	{
+		printf("virtual time limit reached (%llu s)\n", (unsigned long long) (Sim->limit / 1000000));
+		Sim_Exit(2);
+	}
+}
+
+uint64_t Sim_UartSend(uint32_t len, uint32_t baud){
+	uint64_t start = (Sim->uartFree > Sim->now) ? Sim->uartFree : Sim->now;
+
+	// double buffered, wait only for the previous buffer
+	if (start > Sim->now)
+		Sim_Step(start - Sim->now);
+
+	Sim->uartFree = start + ((uint64_t) len * 10 * 1000000 + baud - 1) / baud;
+	return Sim->uartFree;
+}
+
+void Sim_UartDrain(){
+	if (Sim->uartFree > Sim->now)
+		Sim_Step(Sim->uartFree - Sim->now);
+}
+
+void Sim_BleGetStats(Sim_BleStats_t* stats){
+	*stats = Sim->ble.stats;
+}
+
+
+// MSTimer
+
+unsigned long long int MSTimerGet(){
+	Sim_Step(1);
+	return (Sim->now - Sim->bootTime) / 1000;
+}
+
+unsigned long long int MSTimerDelta(unsigned long long int timer){
+	return MSTimerGet() - timer;
+}
+
+void MSTimerDelay(unsigned long long int delay){
+	Sim_Step(delay * 1000);
+}
+
+
+// RTC (keeps running over reset)
+
+unsigned long long int RTC_GetTime(){
+	return Sim->rtcBase + (Sim->now - Sim->rtcSetAt) / 1000;
+}
+
+void RTC_SetTime(unsigned long long int milisecs){
+	Sim->rtcBase = milisecs;
+	Sim->rtcSetAt = Sim->now;
+
+	// alarm second which was passed by the jump does not match any more
+	if ((Sim->rtcAlarmAt != SIM_NEVER) && (Sim->rtcAlarmSec * 1000 < milisecs))
+		Sim->rtcAlarmAt = SIM_NEVER;
+	else if (Sim->rtcAlarmAt != SIM_NEVER)
+		Sim_RtcArm();
+}
+
+void RTC_SetAlarm(unsigned int timeOffset){
+	Sim->rtcAlarmSec = RTC_GetTime() / 1000 + timeOffset;
+	Sim_RtcArm();
+}
+
+int RTC_GetSystemTimeStr(char* txt){
+	return sprintf(txt, "%llu", RTC_GetTime());
+}
+
+
+// flash
+
+unsigned char Flash_SectorErase(uint_32 FlashPtr){
+	if ((FlashPtr & (FLASH_SECTOR_SIZE - 1)) || !Sim_InFlash(FlashPtr, FLASH_SECTOR_SIZE))
+		return Flash_FACCERR;
+
+	memset((void*) (uintptr_t) FlashPtr, 0xFF, FLASH_SECTOR_SIZE);
+	return Flash_OK;
+}
+
+unsigned char Flash_ByteProgram(uint_32 FlashStartAdd, uint_32* DataSrcPtr, uint_32 NumberOfBytes){
+	const uint8_t* dst = (const uint8_t*) (uintptr_t) FlashStartAdd;
+	uint32_t i;
+
+	// programmed by phrases, last one is padded
+	if ((FlashStartAdd & 7) || !Sim_InFlash(FlashStartAdd, (NumberOfBytes + 7) & ~7))
+		return Flash_FACCERR;
+
+	for (i = 0; i < ((NumberOfBytes + 7) & ~7); i ++)
+		if (dst[i] != 0xFF)
+			return Flash_NOT_ERASED;
+
+	memcpy((void*) dst, DataSrcPtr, NumberOfBytes);
+	return Flash_OK;
+}
+
+
+// board
+
+void Cpu_SystemReset(){
+	Sim_Exit(SIM_EXIT_RESET);
+}
+
+void Bits1_SetBit(uint8_t Bit){ Sim_Led |= 1 << Bit; }
+void Bits1_ClrBit(uint8_t Bit){ Sim_Led &= ~(1 << Bit); }
+void Bits1_NegBit(uint8_t Bit){ Sim_Led ^= 1 << Bit; }
+
+int Chec_Wifi_Rst_Stable(){
+	return 1;
+}
+
+char Check_MainBoard_ID_Exists(wcfg_t* wcfg){
+	uint8_t i;
+
+	for (i = 0; i < sizeof(wcfg->wunderbar.id); i ++)
+	{
+		if ((char) wcfg->wunderbar.id[i] != (char) 0xFF)
+			return 1;
+	}
+	return 0;
+}
+
+void Sleep_Restore_Countdown(){
+}
+
+void Sleep_Idle(){
+	uint64_t t = Sim_NextIrq();
+
+	if (t > Sim->now)
+		Sim_Step(t - Sim->now);
+}
+
+
+// onboarding is not simulated (board is configured)
+
+void Onbrd_State_Machine(){}
+void Onbrd_ClientDisconnected(){}
+void Onbrd_Poll(){}
+void Onbrd_WifiReceived(){}
+void Onbrd_GoToStart(){}
+void Sensors_Cfg_ProcessBleMsg(spi_frame_t* spi_msg){}
+
+
+// spi link to ble master, frame is taken (or written) when chip select is released
+
+void SPI_CS_Activate(){
+	Sim->ble.rdPos = 0;
+	Sim->ble.wrPos = 0;
+}
+
+void SPI_CS_Deactivate(){
+	Sim_Ble_t* ble = &Sim->ble;
+
+	if (ble->rdPos && ble->count)
+	{
+		ble->head = (ble->head + 1) % SIM_BLE_QUEUE;
+		ble->count --;
+		ble->stats.read ++;
+	}
+	ble->rdPos = 0;
+
+	if (ble->wrPos && (ble->wrFrame.data_id == DATA_ID_CONFIG) && (ble->wrFrame.field_id == FIELD_ID_RUN))
+		Sim_BleStart();
+	ble->wrPos = 0;
+}
+
+unsigned int SPI_Read(char* recvbyte, char size){
+	Sim_Ble_t* ble = &Sim->ble;
+	const uint8_t* frame = (const uint8_t*) &ble->queue[ble->head];
+	uint8_t i;
+
+	for (i = 0; i < (uint8_t) size; i ++, ble->rdPos ++)
+		recvbyte[i] = (ble->count && (ble->rdPos < sizeof(spi_frame_t))) ? frame[ble->rdPos] : 0xFF;
+	return (uint8_t) size;
+}
+
+unsigned int SPI_Write(char* sendbyte, char size){
+	Sim_Ble_t* ble = &Sim->ble;
+	uint8_t i;
+
+	for (i = 0; i < (uint8_t) size; i ++, ble->wrPos ++)
+		if (ble->wrPos < sizeof(spi_frame_t))
+			((uint8_t*) &ble->wrFrame)[ble->wrPos] = sendbyte[i];
+	return (uint8_t) size;
+}
+
+
+
+
+	///////////////////////////////////////
+	/*         static functions          */
+	///////////////////////////////////////
+
+
+
+/**
+ *  @brief  Boot firmware (process of one boot)
+ *
+ *  Follows Global_Peripheral_Init and main loop, does not return.
+ *
+ *  @return void
+ */
+static void Sim_Boot(){
+	Sim->boots ++;
+	Sim->now = (Sim->now + 999) / 1000 * 1000;		// ms timer starts on ms boundary
+	Sim->bootTime = Sim->now;
+	Sim->ti1Next = SIM_NEVER;
+	Sim->ti2Next = Sim->now + SIM_TI2_PERIOD_US;
+	Sim->rtcAlarmAt = SIM_NEVER;
+
+	Sim_BleReset();									// Reset_Nordic
+	Sim_Hooks->Boot();								// Reset_Wifi
+
+	MSTimerDelay(500);
+	GPIO_LedOn();
+
+	Sim_LoadConfiguration();
+	Sensors_Init();
+	Sim->ti1Next = Sim->now + SIM_TI1_PERIOD_US;	// TI1_Enable
+
+	for (;;)
+	{
+		Sim_Hooks->Poll();
+		Sched_Run();
+	}
+}
+
+/**
+ *  @brief  Load configuration from flash
+ *
+ *  Factory certificate is stored into flash on first boot.
+ *
+ *  @return void
+ */
+static void Sim_LoadConfiguration(){
+	const wcfg_t *p_const_wcfg = (void*) FLASH_CONFIG_IMAGE_ADDR;
+	const unsigned int *p_const_size = (void *) FLASH_CERTIFICATE_IMAGE_ADDRESS;
+
+	wunderbar_configuration = *p_const_wcfg;
+
+	if (*p_const_size == 0xFFFFFFFF)
+		GS_Cert_StoreInFlash((char *) cacert);
+}
+
+/**
+ *  @brief  Map erased flash image on its target address
+ *
+ *  @param  Flash address
+ *  @param  Size of image
+ *
+ *  @return void
+ */
+static void Sim_MapFlash(uint32_t addr, uint32_t size){
+	void* p = mmap((void*) (uintptr_t) addr, size, PROT_READ | PROT_WRITE,
+					MAP_SHARED | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+	if (p != (void*) (uintptr_t) addr)
+	{
+		printf("flash image can not be mapped at 0x%05X (vm.mmap_min_addr?)\n", addr);
+		exit(2);
+	}
+	memset(p, 0xFF, size);
+}
+
+/**
+ *  @brief  Check if address range is in simulated flash
+ *
+ *  @param  Start address
+ *  @param  Number of bytes
+ *
+ *  @return True if range is mapped
+ */
+static bool Sim_InFlash(uint32_t addr, uint32_t len){
+	if ((addr >= FLASH_CONFIG_IMAGE_ADDR) && (addr + len <= FLASH_CONFIG_IMAGE_ADDR + SIM_CONFIG_FLASH_SIZE))
+		return true;
+	if ((addr >= FLASH_SPOOL_ADDR) && (addr + len <= FLASH_SPOOL_ADDR + FLASH_SPOOL_SIZE))
+		return true;
+	return false;
+}
+
+/**
+ *  @brief  Get time of the next interrupt
+ *
+ *  @return Virtual time, SIM_NEVER if nothing is scheduled
+ */
+static uint64_t Sim_NextIrq(){
+	uint64_t t = Sim->ti1Next;
+	int i;
+
+	if (Sim->ti2Next < t)
+		t = Sim->ti2Next;
+	if (Sim->rtcAlarmAt < t)
+		t = Sim->rtcAlarmAt;
+	if (Sim->ble.running)
+		for (i = 0; i < SIM_BLE_SENSORS; i ++)
+			if (Sim->ble.next[i] < t)
+				t = Sim->ble.next[i];
+	return t;
+}
+
+/**
+ *  @brief  Serve interrupts due at given time (as in Events.c)
+ *
+ *  @param  Virtual time
+ *
+ *  @return void
+ */
+static void Sim_ServeIrq(uint64_t t){
+	int i;
+
+	if (Sim->ti1Next == t)
+	{
+		Sim->ti1Next += SIM_TI1_PERIOD_US;
+		Sched_Post(SCHED_TASK_GS);
+	}
+	if (Sim->ti2Next == t)
+	{
+		Sim->ti2Next += SIM_TI2_PERIOD_US;
+		Sched_Post(SCHED_TASK_ONBRD);
+	}
+	if (Sim->rtcAlarmAt == t)
+	{
+		Sim->rtcAlarmAt = SIM_NEVER;
+		MQTT_SetPingFlag();
+	}
+	if (Sim->ble.running)
+	{
+		for (i = 0; i < SIM_BLE_SENSORS; i ++)
+			if (Sim->ble.next[i] == t)
+				Sim_BleProduce(i);
+	}
+}
+
+/**
+ *  @brief  Compute virtual time of rtc alarm
+ *
+ *  @return void
+ */
+static void Sim_RtcArm(){
+	uint64_t alarmMs = Sim->rtcAlarmSec * 1000;
+
+	if (alarmMs <= RTC_GetTime())
+		Sim->rtcAlarmAt = Sim->now;
+	else
+		Sim->rtcAlarmAt = Sim->rtcSetAt + (alarmMs - Sim->rtcBase) * 1000;
+}
+
+/**
+ *  @brief  Reset ble master, sensors are connected again after run command
+ *
+ *  @return void
+ */
+static void Sim_BleReset(){
+	Sim_Ble_t* ble = &Sim->ble;
+
+	ble->running = 0;
+	ble->head = 0;
+	ble->count = 0;
+	ble->rdPos = 0;
+	ble->wrPos = 0;
+}
+
+/**
+ *  @brief  Enter run mode, sensors send their status and then readings
+ *
+ *  @return void
+ */
+static void Sim_BleStart(){
+	Sim_Ble_t* ble = &Sim->ble;
+	int i;
+
+	if (ble->running)
+		return;
+
+	ble->running = 1;
+	for (i = 0; i < SIM_BLE_SENSORS; i ++)
+	{
+		ble->connected[i] = 0;
+		ble->next[i] = Sim->now + SIM_BLE_STATUS_DELAY + i * 50000;
+	}
+}
+
+/**
+ *  @brief  Queue next frame of the sensor and signal it with external interrupt
+ *
+ *  @param  Sensor index
+ *
+ *  @return void
+ */
+static void Sim_BleProduce(int sensor){
+	Sim_Ble_t* ble = &Sim->ble;
+	spi_frame_t frame;
+	uint16_t word;
+	uint8_t i, size;
+
+	memset(&frame, 0, sizeof(frame));
+	frame.data_id = Sim_BleSensors[sensor].id;
+	frame.operation = OPERATION_WRITE;
+
+	if (ble->connected[sensor] == 0)
+	{
+		// connection status (operation 0) with sensor id
+		frame.field_id = FIELD_ID_SENSOR_STATUS;
+		for (i = 0; i < sizeof(sensorID_t); i ++)
+			frame.data[i] = 0x10 * (sensor + 1) + i;
+
+		ble->connected[sensor] = 1;
+		ble->next[sensor] += SIM_BLE_DATA_DELAY;
+	}
+	else
+	{
+		frame.field_id = FIELD_ID_CHAR_SENSOR_DATA_R;
+		size = sensors_get_msg_size(frame.data_id, FIELD_ID_CHAR_SENSOR_DATA_R);
+		for (i = 0; i + 1 < size; i += 2)
+		{
+			word = 1000 * (i / 2 + 1) + ble->seq[sensor] % 100;
+			frame.data[i] = word;
+			frame.data[i + 1] = word >> 8;
+		}
+
+		ble->seq[sensor] ++;
+		ble->stats.generated ++;
+		ble->next[sensor] += Sim_BleSensors[sensor].period;
+	}
+
+	if (ble->count == SIM_BLE_QUEUE)
+	{
+		ble->stats.dropped ++;
+		return;
+	}
+
+	ble->queue[(ble->head + ble->count) % SIM_BLE_QUEUE] = frame;
+	ble->count ++;
+
+	// EInt2_OnInterrupt
+	Sleep_Restore_Countdown();
+	Sched_Post(SCHED_TASK_SENSORS);
+}
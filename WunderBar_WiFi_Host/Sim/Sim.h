@@ -0,0 +1,171 @@
+/** @file   Sim.h
+ *  @brief  Host simulation of WunderBar main board for firmware modules above the hardware layer.
+ *
+ *  		Firmware runs on virtual time, every MSTimerGet call moves it by 1 us and
+ *  		idle sleep jumps to the next interrupt. Timer, rtc alarm and ble master
+ *  		interrupts are served from Sim_Step in time order. Every boot runs in its
+ *  		own process forked from the parent, so Cpu_SystemReset loses ram state
+ *  		the same way the board does. Flash (config, certificate and spool images)
+ *  		and simulation state are kept in shared memory and survive resets.
+ *
+ *  		GS_HAL_* functions (wifi module link) are provided by the program which
+ *  		uses the simulation, together with hooks called from the boot loop.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+//////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+
+// board configuration written by Sim_FactoryFlash
+
+#define SIM_DEVICE_ID				"5c0d4a2e-31f7-4b7e-9e1a-0a1b2c3d4e5f"
+#define SIM_DEVICE_SECURITY			"Xk2Lp9QzR4tWv7Ym"
+#define SIM_WIFI_SSID				"wunderbar-test"
+#define SIM_WIFI_PASSWORD			"s3cret-pass"
+#define SIM_CLOUD_URL				"mqtt.relayr.io"
+
+#define SIM_EXIT_RESET				100			// exit status of firmware process on Cpu_SystemReset
+#define SIM_UART_POLL_US			10			// virtual time of one GS_HAL_recv call
+
+typedef struct {
+	void (*Boot)();							// wifi module reset, called on every boot before firmware init
+	void (*Poll)();							// called from main loop before every scheduler pass
+	void (*Advance)(uint64_t now);			// called when virtual time moves (us), may be NULL
+} Sim_Hooks_t;
+
+typedef struct {
+	uint32_t generated;						// sensor data frames produced by ble master
+	uint32_t dropped;						// frames lost because spi queue of ble master was full
+	uint32_t read;							// frames read by firmware
+} Sim_BleStats_t;
+
+
+//////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////
+
+// public functions
+
+/**
+ *  @brief  Allocate memory shared by all boots
+ *
+ *  Should be called before Sim_Run, memory is zeroed.
+ *
+ *  @param  Number of bytes
+ *
+ *  @return Pointer to memory
+ */
+void* Sim_SharedAlloc(size_t size);
+
+/**
+ *  @brief  Init simulation
+ *
+ *  Maps flash images on their target addresses (erased) and resets virtual time.
+ *
+ *  @param  Virtual time limit in seconds, simulation fails when it is reached
+ *
+ *  @return void
+ */
+void Sim_Init(uint32_t limitSeconds);
+
+/**
+ *  @brief  Write board configuration into flash
+ *
+ *  Configuration is the one written by onboarding (SIM_* values, no cloud ip),
+ *  certificate image stays erased.
+ *
+ *  @return void
+ */
+void Sim_FactoryFlash();
+
+/**
+ *  @brief  Run firmware
+ *
+ *  Boots firmware in a child process and boots it again after every reset.
+ *
+ *  @param  Hooks of the program
+ *
+ *  @return Exit status of the last firmware process (other than reset)
+ */
+int Sim_Run(const Sim_Hooks_t* hooks);
+
+/**
+ *  @brief  End simulation from firmware process
+ *
+ *  @param  Exit status returned by Sim_Run
+ *
+ *  @return void
+ */
+void Sim_Exit(int status);
+
+/**
+ *  @brief  Get virtual time
+ *
+ *  @return Microseconds since start of simulation
+ */
+uint64_t Sim_Now();
+
+/**
+ *  @brief  Get firmware ms timer without moving the time
+ *
+ *  @return Miliseconds since boot
+ */
+uint32_t Sim_Millis();
+
+/**
+ *  @brief  Get number of boots
+ *
+ *  @return Boots since start of simulation, 1 for the first one
+ */
+uint32_t Sim_Boots();
+
+/**
+ *  @brief  Move virtual time
+ *
+ *  Interrupts which become due are served in time order.
+ *
+ *  @param  Microseconds
+ *
+ *  @return void
+ */
+void Sim_Step(uint64_t us);
+
+/**
+ *  @brief  Send bytes on wifi module uart
+ *
+ *  Waits while previous data is on the line (transmit is double buffered).
+ *
+ *  @param  Number of bytes
+ *  @param  Baud rate
+ *
+ *  @return Time when the last byte is received by the module
+ */
+uint64_t Sim_UartSend(uint32_t len, uint32_t baud);
+
+/**
+ *  @brief  Wait until all data is sent on wifi module uart
+ *
+ *  @return void
+ */
+void Sim_UartDrain();
+
+/**
+ *  @brief  Get ble master statistics
+ *
+ *  @param  Return statistics
+ *
+ *  @return void
+ */
+void Sim_BleGetStats(Sim_BleStats_t* stats);
+
+#endif // SIM_H_
@@ -0,0 +1,362 @@
+/** @file   Spool_Test.c
+ *  @brief  Host test of sensor reading spool (Sensors_Spool.c) on simulated flash.
+ *
+ *  		Simulated flash behaves like FTFE: erase sets sector to 0xFF, programming
+ *  		is phrase aligned and only allowed on erased phrases. Reset is simulated
+ *  		by calling Sensors_Spool_Init again, which loses ram batch and state.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <hardware/Hw_modules.h>
+#include "FTFE/flash_FTFE.h"
+
+static uint8_t  Sim_Flash[FLASH_SPOOL_SIZE] __attribute__((aligned(8)));
+static uint32_t Sim_Erases;
+static uint32_t Sim_Programmed;
+static int      Sim_FailProgram;				// number of next program commands which fail
+
+static unsigned char Sim_FlashErase(uint32_t addr);
+static unsigned char Sim_FlashProgram(uint32_t addr, uint32_t* src, uint32_t len);
+
+#define SPOOL_FLASH_ERASE(addr)					Sim_FlashErase(addr)
+#define SPOOL_FLASH_PROGRAM(addr, src, len)		Sim_FlashProgram((addr), (src), (len))
+#define SPOOL_FLASH_PTR(addr)					((const uint8_t *) &Sim_Flash[(addr) - FLASH_SPOOL_ADDR])
+
+#include "Sensors/Sensors_Spool.c"
+
+
+// simulated environment
+
+static unsigned long long int Sim_Time;
+static char     Sim_Online;
+static int      Sim_FreeSlots;					// publish slots, -1 unlimited
+static uint32_t Sim_Published[4096];			// reading numbers in publish order
+static int      Sim_PublishedCnt;
+static int      Test_Failed;
+
+#define CHECK(cond)		do { if (!(cond)) { printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); Test_Failed ++; } } while (0)
+
+unsigned long long int MSTimerGet(){ return Sim_Time; }
+unsigned long long int MSTimerDelta(unsigned long long int timer){ return Sim_Time - timer; }
+unsigned long long int RTC_GetTime(){ return 1420070400000ULL + Sim_Time; }
+char MQTT_Get_RunnigStatus(){ return Sim_Online; }
+
+char MQTT_Api_Publish(MQTT_User_Message_t* msg){
+	uint32_t n = 0;
+	int i;
+
+	if (Sim_FreeSlots == 0)
+		return (char) MQTT_MSG_NO_SLOT;
+	if (Sim_FreeSlots > 0)
+		Sim_FreeSlots --;
+
+	// payload is {"n":<reading number>...}
+	for (i = 5; (i < msg->payloadlen) && (msg->payloadStr[i] >= '0') && (msg->payloadStr[i] <= '9'); i ++)
+		n = n * 10 + msg->payloadStr[i] - '0';
+
+	if (Sim_PublishedCnt < (int) (sizeof(Sim_Published) / sizeof(Sim_Published[0])))
+		Sim_Published[Sim_PublishedCnt ++] = n;
+	return 0;
+}
+
+static unsigned char Sim_FlashErase(uint32_t addr){
+	if ((addr < FLASH_SPOOL_ADDR) || (addr >= FLASH_SPOOL_ADDR + FLASH_SPOOL_SIZE) || (addr & (FLASH_SECTOR_SIZE - 1)))
+		return Flash_FACCERR;
+
+	memset(&Sim_Flash[addr - FLASH_SPOOL_ADDR], 0xFF, FLASH_SECTOR_SIZE);
+	Sim_Erases ++;
+	return Flash_OK;
+}
+
+static unsigned char Sim_FlashProgram(uint32_t addr, uint32_t* src, uint32_t len){
+	uint32_t i;
+
+	if ((addr < FLASH_SPOOL_ADDR) || (addr + len > FLASH_SPOOL_ADDR + FLASH_SPOOL_SIZE) || (addr & 7) || (len & 7))
+		return Flash_FACCERR;
+
+	if (Sim_FailProgram)
+	{
+		Sim_FailProgram --;
+		return Flash_MGSTAT0;
+	}
+
+	for (i = 0; i < len; i ++)
+		if (Sim_Flash[addr - FLASH_SPOOL_ADDR + i] != 0xFF)
+			return Flash_NOT_ERASED;
+
+	memcpy(&Sim_Flash[addr - FLASH_SPOOL_ADDR], src, len);
+	Sim_Programmed += len;
+	return Flash_OK;
+}
+
+
+// helpers
+
+static void Test_PowerOn(bool blank){
+	if (blank)
+		memset(Sim_Flash, 0xFF, sizeof(Sim_Flash));
+	Sim_Erases = 0;
+	Sim_Programmed = 0;
+	Sim_PublishedCnt = 0;
+	Sensors_Spool_Init();
+}
+
+static void Test_Tick(int ms){
+	Sim_Time += ms;
+	Sensors_Spool_Task();
+}
+
+// readings have fixed size in flash
+#define TEST_TOPICLEN		24
+#define TEST_PAYLOADLEN		52
+#define TEST_REC_SIZE		SPOOL_ALIGN(sizeof(Spool_RecHdr_t) + sizeof(Spool_DataHdr_t) + TEST_TOPICLEN + TEST_PAYLOADLEN)
+
+static bool Test_Store(uint32_t n){
+	static const char topic[] = "/v1/0123456789abcdef/data";
+	char payload[53];
+
+	snprintf(payload, sizeof(payload), "{\"n\":%010u,\"temp\":21.50,\"hum\":45.10,\"x\":\"pad\"}", n);
+	return Sensors_Spool_Store(topic, TEST_TOPICLEN, payload, TEST_PAYLOADLEN);
+}
+
+static void Test_ReplayAll(){
+	int i;
+
+	Sim_Online = 1;
+	Test_Tick(SPOOL_REPLAY_INTERVAL_MS);						// replay is started by task
+	for (i = 0; (i < 100000) && (Spool.Replay || Spool.BatchLen); i ++)
+		Test_Tick(SPOOL_REPLAY_INTERVAL_MS);
+}
+
+static bool Test_PublishedInOrder(uint32_t first, uint32_t last){
+	int i;
+
+	if (Sim_PublishedCnt != (int) (last - first + 1))
+		return false;
+	for (i = 0; i < Sim_PublishedCnt; i ++)
+		if (Sim_Published[i] != first + i)
+			return false;
+	return true;
+}
+
+static void Test_PrintStats(const char* when){
+	Sensors_Spool_Stats_t s;
+
+	Sensors_Spool_GetStats(&s);
+	printf("  %-22s stored %4u replayed %4u dropped %4u pending %4u used %6u/%u  data %6u flash %6u (x%.2f) erases %2u errors %u\n",
+			when, s.stored, s.replayed, s.dropped, s.pending, s.used, s.capacity, s.dataBytes, s.flashBytes,
+			s.dataBytes ? (double) s.flashBytes / s.dataBytes : 0.0, s.erases, s.errors);
+}
+
+
+// tests
+
+/**
+ *  @brief  Readings spooled offline are programmed in phrase batches and accounted
+ */
+static void Test_Accounting(){
+	Sensors_Spool_Stats_t s;
+	uint32_t n, perSector = (FLASH_SECTOR_SIZE - sizeof(Spool_SectorHdr_t)) / TEST_REC_SIZE;
+
+	printf("accounting\n");
+	Sim_Online = 0;
+	Sim_FreeSlots = -1;
+	Test_PowerOn(true);
+
+	for (n = 1; n <= 100; n ++)
+	{
+		CHECK(Test_Store(n));
+		Test_Tick(10);
+	}
+	Test_Tick(SPOOL_BATCH_FLUSH_MS);
+	Test_PrintStats("100 offline");
+
+	Sensors_Spool_GetStats(&s);
+	CHECK(s.capacity == FLASH_SPOOL_SIZE - SPOOL_SECTORS * sizeof(Spool_SectorHdr_t));
+	CHECK((s.stored == 100) && (s.pending == 100) && (s.dropped == 0));
+	CHECK(s.used == 100 * TEST_REC_SIZE);
+	CHECK(s.dataBytes == 100 * (TEST_TOPICLEN + TEST_PAYLOADLEN));
+	CHECK(s.erases == (100 + perSector - 1) / perSector);
+	CHECK(s.flashBytes == s.erases * sizeof(Spool_SectorHdr_t) + 100 * TEST_REC_SIZE);	// sector headers and records
+	CHECK((s.flashBytes == Sim_Programmed) && (s.erases == Sim_Erases));
+	CHECK(Spool.BatchLen == 0);
+
+	// reset restores readings which are not replayed
+	Test_PowerOn(false);
+	Sensors_Spool_GetStats(&s);
+	CHECK((s.pending == 100) && (s.used == 100 * TEST_REC_SIZE));
+
+	Test_ReplayAll();
+	Test_PrintStats("replayed");
+	CHECK(Test_PublishedInOrder(1, 100));
+
+	// replay is saved with commit record, nothing is replayed after next reset
+	Sensors_Spool_GetStats(&s);
+	CHECK((s.pending == 0) && (s.used == 0));
+	CHECK(s.flashBytes == Sim_Programmed);
+	Test_PowerOn(false);
+	Test_ReplayAll();
+	CHECK(Sim_PublishedCnt == 0);
+}
+
+/**
+ *  @brief  Reset during replay resumes after last commit record
+ */
+static void Test_CommitReplay(){
+	Sensors_Spool_Stats_t s;
+	uint32_t n, commit;
+	int i;
+
+	printf("commit record replay after reset\n");
+	Sim_Online = 0;
+	Sim_FreeSlots = -1;
+	Test_PowerOn(true);
+
+	for (n = 1; n <= 100; n ++)
+	{
+		Test_Store(n);
+		Test_Tick(10);
+	}
+	Test_Tick(SPOOL_BATCH_FLUSH_MS);
+
+	// replay 40 readings, then reset
+	Sim_Online = 1;
+	for (i = 0; (i < 1000) && (Sim_PublishedCnt < 40); i ++)
+		Test_Tick(SPOOL_REPLAY_INTERVAL_MS);
+	Test_Tick(1);											// program commit record
+	commit = Spool.CommitSeq;
+	Test_PrintStats("40 replayed, reset");
+	CHECK(Test_PublishedInOrder(1, 40));
+	CHECK((commit >= 32) && (commit <= 40));
+
+	Test_PowerOn(false);
+	Sensors_Spool_GetStats(&s);
+	CHECK(s.pending == 100 - commit);
+
+	Test_ReplayAll();
+	Test_PrintStats("replayed after reset");
+	printf("  commit at %u, %u readings published twice\n", commit, 40 - commit);
+	CHECK(Test_PublishedInOrder(commit + 1, 100));
+}
+
+/**
+ *  @brief  Long outage wraps the ring, oldest sectors are erased and their readings dropped
+ */
+static void Test_Wrap(){
+	Sensors_Spool_Stats_t s;
+	uint32_t n, total = 1000, perSector = (FLASH_SECTOR_SIZE - sizeof(Spool_SectorHdr_t)) / TEST_REC_SIZE;
+
+	printf("wrap and erase of oldest sector\n");
+	Sim_Online = 0;
+	Sim_FreeSlots = -1;
+	Test_PowerOn(true);
+
+	for (n = 1; n <= total; n ++)
+	{
+		CHECK(Test_Store(n));
+		Test_Tick(10);
+	}
+	Test_Tick(SPOOL_BATCH_FLUSH_MS);
+	Test_PrintStats("1000 offline");
+
+	Sensors_Spool_GetStats(&s);
+	CHECK(s.stored == total);
+	CHECK(s.dropped > 0);
+	CHECK(s.dropped % perSector == 0);						// whole sectors are dropped
+	CHECK(s.pending + s.dropped == total);
+	CHECK(s.pending <= SPOOL_SECTORS * perSector);
+	CHECK(s.used == s.pending * TEST_REC_SIZE);
+	CHECK((s.erases == Sim_Erases) && (s.flashBytes == Sim_Programmed));
+	CHECK(s.erases == (total + perSector - 1) / perSector);	// records do not cross sectors
+
+	// reset in wrapped state restores same readings
+	Test_PowerOn(false);
+	CHECK(Spool.Stats.pending == s.pending);
+
+	Test_ReplayAll();
+	Test_PrintStats("replayed");
+	CHECK(Test_PublishedInOrder(s.dropped + 1, total));
+}
+
+/**
+ *  @brief  Readings which do not fit ram batch and failed flash commands are counted
+ */
+static void Test_Dropped(){
+	Sensors_Spool_Stats_t s;
+	uint32_t n, stored = 0;
+
+	printf("dropped readings\n");
+	Sim_Online = 0;
+	Sim_FreeSlots = -1;
+	Test_PowerOn(true);
+
+	// ram batch is full, task is not called
+	for (n = 1; n <= 30; n ++)
+		stored += Test_Store(n);
+	Sensors_Spool_GetStats(&s);
+	CHECK(stored == SPOOL_BATCH_SIZE / TEST_REC_SIZE);
+	CHECK((s.stored == stored) && (s.dropped == 30 - stored));
+
+	// failed program is retried once in next sector
+	Sim_FailProgram = 1;
+	Test_Tick(SPOOL_BATCH_FLUSH_MS);
+	Sensors_Spool_GetStats(&s);
+	CHECK((s.errors == 1) && (s.pending == stored));
+
+	// retry fails too (header of next sector), batch is lost
+	for (n = 31; n <= 40; n ++)
+		Test_Store(n);
+	Sim_FailProgram = 2;
+	Test_Tick(SPOOL_BATCH_FLUSH_MS);
+	Test_PrintStats("after flash errors");
+	Sensors_Spool_GetStats(&s);
+	CHECK(s.errors == 3);
+	CHECK(s.dropped == 30 - stored + 10);
+	CHECK(s.pending == stored);
+
+	Test_ReplayAll();
+	CHECK(Sim_PublishedCnt == (int) s.pending);
+}
+
+/**
+ *  @brief  Replay waits while mqtt buffer is full
+ */
+static void Test_Backpressure(){
+	int i;
+
+	printf("replay with full mqtt buffer\n");
+	Sim_Online = 0;
+	Sim_FreeSlots = -1;
+	Test_PowerOn(true);
+	for (i = 1; i <= 10; i ++)
+		Test_Store(i);
+
+	Sim_Online = 1;
+	Sim_FreeSlots = 0;
+	for (i = 0; i < 20; i ++)
+		Test_Tick(SPOOL_REPLAY_INTERVAL_MS);
+	CHECK(Sim_PublishedCnt == 0);
+
+	Sim_FreeSlots = -1;
+	Test_ReplayAll();
+	CHECK(Test_PublishedInOrder(1, 10));
+}
+
+
+int main(){
+	Test_Accounting();
+	Test_CommitReplay();
+	Test_Wrap();
+	Test_Dropped();
+	Test_Backpressure();
+
+	printf("%s\n", Test_Failed ? "FAILED" : "PASSED");
+	return Test_Failed ? 1 : 0;
+}
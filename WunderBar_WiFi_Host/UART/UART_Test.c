@@ -0,0 +1,469 @@
+/** @file   UART_Test.c
+ *  @brief  Host test of GS module UART transport (UART.c) on simulated DMA.
+ *
+ *  		UART0, DMAMUX and DMA registers are replaced with variables. Receive channel
+ *  		is simulated by Sim_RxBytes, which writes bytes into ring like DMA does
+ *  		(rewind at the end of major loop, interrupt flag set on every wrap).
+ *  		Transmit channel sends the whole buffer when its request is checked.
+ *  		Interrupt routines (UART0 status, DMA1) are called by tests.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <Cpu.h>
+
+
+// simulated registers
+
+static struct {
+	uint32_t scgc6, scgc7;
+	uint8_t  chcfg0, chcfg1;
+	uint32_t erq, serq, cerq, cdne, intFlags, cint;
+	uint32_t saddr0, daddr0, slast0, dlast0, saddr1, daddr1, slast1, dlast1;
+	uint16_t soff0, doff0, attr0, citer0, biter0, csr0;
+	uint16_t soff1, doff1, attr1, citer1, biter1, csr1;
+	uint32_t nbytes0, nbytes1;
+	uint8_t  bdh, bdl, c1, c2, c3, c4, c5, d, s1, rcfifo, sfifo;
+	uint32_t nvicip1, nviciser0;
+} Sim_Reg;
+
+static uint32_t Sim_DmaErq();
+static uint32_t Sim_DmaInt();
+
+#define CPU_CORE_CLK_HZ					120000000U
+
+#define SIM_SCGC6						Sim_Reg.scgc6
+#define SIM_SCGC7						Sim_Reg.scgc7
+#define SIM_SCGC6_DMAMUX_MASK			0x02u
+#define SIM_SCGC7_DMA_MASK				0x02u
+
+#define DMAMUX_CHCFG0					Sim_Reg.chcfg0
+#define DMAMUX_CHCFG1					Sim_Reg.chcfg1
+#define DMAMUX_CHCFG_ENBL_MASK			0x80u
+#define DMAMUX_CHCFG_SOURCE(x)			(x)
+
+#define DMA_ERQ							Sim_DmaErq()
+#define DMA_ERQ_ERQ1_MASK				0x02u
+#define DMA_SERQ						Sim_Reg.serq
+#define DMA_SERQ_SERQ(x)				((x) + 1)			// 0 is no request
+#define DMA_CERQ						Sim_Reg.cerq
+#define DMA_CERQ_CERQ(x)				((x) + 1)
+#define DMA_CDNE						Sim_Reg.cdne
+#define DMA_CDNE_CDNE(x)				(x)
+#define DMA_INT							Sim_DmaInt()
+#define DMA_INT_INT0_MASK				0x01u
+#define DMA_INT_INT1_MASK				0x02u
+#define DMA_CINT						Sim_Reg.cint
+#define DMA_CINT_CINT(x)				((x) + 1)			// 0 is no request
+
+#define DMA_TCD0_SADDR					Sim_Reg.saddr0
+#define DMA_TCD0_SOFF					Sim_Reg.soff0
+#define DMA_TCD0_SLAST					Sim_Reg.slast0
+#define DMA_TCD0_ATTR					Sim_Reg.attr0
+#define DMA_TCD0_NBYTES_MLNO			Sim_Reg.nbytes0
+#define DMA_TCD0_DADDR					Sim_Reg.daddr0
+#define DMA_TCD0_DOFF					Sim_Reg.doff0
+#define DMA_TCD0_DLASTSGA				Sim_Reg.dlast0
+#define DMA_TCD0_CITER_ELINKNO			Sim_Reg.citer0
+#define DMA_TCD0_BITER_ELINKNO			Sim_Reg.biter0
+#define DMA_TCD0_CSR					Sim_Reg.csr0
+#define DMA_TCD1_SADDR					Sim_Reg.saddr1
+#define DMA_TCD1_SOFF					Sim_Reg.soff1
+#define DMA_TCD1_SLAST					Sim_Reg.slast1
+#define DMA_TCD1_ATTR					Sim_Reg.attr1
+#define DMA_TCD1_NBYTES_MLNO			Sim_Reg.nbytes1
+#define DMA_TCD1_DADDR					Sim_Reg.daddr1
+#define DMA_TCD1_DOFF					Sim_Reg.doff1
+#define DMA_TCD1_DLASTSGA				Sim_Reg.dlast1
+#define DMA_TCD1_CITER_ELINKNO			Sim_Reg.citer1
+#define DMA_TCD1_BITER_ELINKNO			Sim_Reg.biter1
+#define DMA_TCD1_CSR					Sim_Reg.csr1
+#define DMA_ATTR_SSIZE(x)				(x)
+#define DMA_ATTR_DSIZE(x)				(x)
+#define DMA_CITER_ELINKNO_CITER(x)		(x)
+#define DMA_BITER_ELINKNO_BITER(x)		(x)
+#define DMA_CSR_DREQ_MASK				0x08u
+#define DMA_CSR_INTMAJOR_MASK			0x02u
+
+#define NVICIP1							Sim_Reg.nvicip1
+#define NVICISER0						Sim_Reg.nviciser0
+#define NVIC_IP_PRI1(x)					(x)
+#define NVIC_ISER_SETENA(x)				(x)
+
+#define UART0_BDH						Sim_Reg.bdh
+#define UART0_BDL						Sim_Reg.bdl
+#define UART0_C1						Sim_Reg.c1
+#define UART0_C2						Sim_Reg.c2
+#define UART0_C3						Sim_Reg.c3
+#define UART0_C4						Sim_Reg.c4
+#define UART0_C5						Sim_Reg.c5
+#define UART0_D							Sim_Reg.d
+#define UART0_S1						Sim_Reg.s1
+#define UART0_RCFIFO					Sim_Reg.rcfifo
+#define UART0_SFIFO						Sim_Reg.sfifo
+#define UART_BDH_SBR_MASK				0x1Fu
+#define UART_BDH_SBR(x)					((x) & 0x1F)
+#define UART_BDL_SBR(x)					((x) & 0xFF)
+#define UART_C1_ILT_MASK				0x04u
+#define UART_C2_TE_MASK					0x08u
+#define UART_C2_RE_MASK					0x04u
+#define UART_C2_RIE_MASK				0x20u
+#define UART_C2_TIE_MASK				0x80u
+#define UART_C2_TCIE_MASK				0x40u
+#define UART_C2_ILIE_MASK				0x10u
+#define UART_C3_ORIE_MASK				0x08u
+#define UART_C3_NEIE_MASK				0x04u
+#define UART_C3_FEIE_MASK				0x02u
+#define UART_C3_PEIE_MASK				0x01u
+#define UART_C4_BRFA_MASK				0x1Fu
+#define UART_C4_BRFA(x)					((x) & 0x1F)
+#define UART_C5_RDMAS_MASK				0x20u
+#define UART_C5_TDMAS_MASK				0x80u
+#define UART_S1_OR_MASK					0x08u
+#define UART_S1_TC_MASK					0x40u
+#define UART_S1_IDLE_MASK				0x10u
+#define UART_SFIFO_RXUF_MASK			0x01u
+
+#include "hardware/UART.c"
+
+
+// simulated environment
+
+static unsigned long long int Sim_Time;
+static bool     Sim_LateFlag;					// wrap flag is seen one DMA_INT read late
+static bool     Sim_FlagDue;
+static uint8_t  Sim_Tx[4096];
+static uint32_t Sim_TxLen;
+static int      Sim_RxIdleEvents;
+static int      Sim_TxDoneEvents;
+static int      Test_Failed;
+
+#define CHECK(cond)		do { if (!(cond)) { printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); Test_Failed ++; } } while (0)
+
+// every call takes a millisecond, so blocking receive times out
+unsigned long long int MSTimerGet(){ return ++ Sim_Time; }
+unsigned long long int MSTimerDelta(unsigned long long int timer){ return ++ Sim_Time - timer; }
+
+void GS_HAL_OnRxIdle(void){ Sim_RxIdleEvents ++; }
+void GS_HAL_OnTxDone(void){ Sim_TxDoneEvents ++; }
+
+static void Sim_DmaClearInt(){
+	if (Sim_Reg.cint)
+	{
+		Sim_Reg.intFlags &= ~(1u << (Sim_Reg.cint - 1));
+		Sim_Reg.cint = 0;
+	}
+}
+
+static uint32_t Sim_DmaInt(){
+	uint32_t flags;
+
+	Sim_DmaClearInt();
+	flags = Sim_Reg.intFlags;
+	if (Sim_FlagDue)
+	{
+		Sim_Reg.intFlags |= DMA_INT_INT0_MASK;
+		Sim_FlagDue = false;
+	}
+	return flags;
+}
+
+// transmit channel sends whole buffer as soon as its request is seen, major loop interrupt flag is set
+static uint32_t Sim_DmaErq(){
+	uint32_t off;
+
+	if (Sim_Reg.serq == 2)
+	{
+		off = Sim_Reg.saddr1 - (uint32_t) (uintptr_t) UART_TxBuf;
+		if (Sim_TxLen + Sim_Reg.citer1 <= sizeof(Sim_Tx))
+			memcpy(&Sim_Tx[Sim_TxLen], (uint8_t *) UART_TxBuf + off, Sim_Reg.citer1);
+		Sim_TxLen += Sim_Reg.citer1;
+		Sim_Reg.serq = 0;
+		if (Sim_Reg.csr1 & DMA_CSR_INTMAJOR_MASK)
+			Sim_Reg.intFlags |= DMA_INT_INT1_MASK;
+	}
+	return 0;
+}
+
+static void Sim_RxBytes(const uint8_t* data, uint32_t len){
+	uint32_t off;
+
+	Sim_DmaClearInt();
+
+	while (len --)
+	{
+		off = Sim_Reg.daddr0 - (uint32_t) (uintptr_t) UART_RxRing;
+		UART_RxRing[off] = *data ++;
+		Sim_Reg.daddr0 += Sim_Reg.doff0;
+
+		if (-- Sim_Reg.citer0 == 0)
+		{
+			Sim_Reg.daddr0 += Sim_Reg.dlast0;
+			Sim_Reg.citer0 = Sim_Reg.biter0;
+			if (Sim_Reg.csr0 & DMA_CSR_INTMAJOR_MASK)
+			{
+				if (Sim_LateFlag)
+					Sim_FlagDue = true;
+				else
+					Sim_Reg.intFlags |= DMA_INT_INT0_MASK;
+			}
+		}
+	}
+}
+
+
+// helpers
+
+static uint8_t Test_Byte(uint32_t n){
+	return (uint8_t) (n * 7 + (n >> 8));
+}
+
+static void Test_RxStream(uint32_t from, uint32_t len){
+	uint8_t buf[1024];
+	uint32_t i, n;
+
+	while (len)
+	{
+		n = (len < sizeof(buf)) ? len : sizeof(buf);
+		for (i = 0; i < n; i ++)
+			buf[i] = Test_Byte(from + i);
+		Sim_RxBytes(buf, n);
+		from += n;
+		len -= n;
+	}
+}
+
+static bool Test_ReadStream(uint32_t from, uint32_t len){
+	uint8_t buf[700];
+	uint32_t i, n;
+
+	while (len)
+	{
+		n = GS_HAL_recv(buf, (len < sizeof(buf)) ? len : sizeof(buf), 0);
+		if (n == 0)
+			return false;
+		for (i = 0; i < n; i ++)
+			if (buf[i] != Test_Byte(from + i))
+				return false;
+		from += n;
+		len -= n;
+	}
+	return true;
+}
+
+static void Test_Stats(uint32_t* overruns, uint32_t* lost, uint32_t* fifo){
+	GS_HAL_GetRxStats(overruns, lost, fifo);
+}
+
+static void Test_Reset(){
+	memset(&Sim_Reg, 0, sizeof(Sim_Reg));
+	memset(&UART_RxStats, 0, sizeof(UART_RxStats));
+	Sim_LateFlag = false;
+	Sim_FlagDue = false;
+	Sim_TxLen = 0;
+	Sim_RxIdleEvents = 0;
+	Sim_TxDoneEvents = 0;
+	GS_HAL_Init();
+}
+
+
+// tests
+
+static void Test_Stream(){
+	uint32_t pos = 0, overruns, lost, fifo;
+	uint8_t b;
+	int lap;
+
+	printf("stream over %d laps of the ring\n", 10);
+	Test_Reset();
+
+	// chunks shorter than the ring, read between them
+	for (lap = 0; lap < 10 * UART_RX_RING_SIZE / 3000; lap ++)
+	{
+		Test_RxStream(pos, 3000);
+		CHECK(Test_ReadStream(pos, 3000));
+		pos += 3000;
+	}
+
+	// one byte short of a full ring is kept
+	Test_RxStream(pos, UART_RX_RING_SIZE - 1);
+	CHECK(Test_ReadStream(pos, UART_RX_RING_SIZE - 1));
+	CHECK(GS_HAL_recv(&b, 1, 0) == 0);
+
+	Test_Stats(&overruns, &lost, &fifo);
+	CHECK(overruns == 0);
+	CHECK(lost == 0);
+}
+
+static void Test_Overrun(){
+	uint32_t overruns, lost, fifo;
+	uint8_t b;
+
+	printf("overrun of unread data\n");
+	Test_Reset();
+
+	// ring filled and passed without reading, data is discarded
+	Test_RxStream(0, 100);
+	CHECK(Test_ReadStream(0, 50));
+	Test_RxStream(100, UART_RX_RING_SIZE);
+	CHECK(GS_HAL_recv(&b, 1, 0) == 0);
+
+	Test_Stats(&overruns, &lost, &fifo);
+	printf("  overruns %u lost %u\n", overruns, lost);
+	CHECK(overruns == 1);
+	CHECK(lost == 50 + UART_RX_RING_SIZE);
+
+	// reading continues with data received after overrun
+	Test_RxStream(5000, 200);
+	CHECK(Test_ReadStream(5000, 200));
+
+	// whole lap between reads with head back at the same place
+	Test_RxStream(6000, UART_RX_RING_SIZE);
+	CHECK(GS_HAL_recv(&b, 1, 0) == 0);
+	Test_Stats(&overruns, &lost, &fifo);
+	CHECK(overruns == 2);
+
+	// several laps are detected too (counted as one)
+	Test_RxStream(0, 3 * UART_RX_RING_SIZE + 10);
+	CHECK(GS_HAL_recv(&b, 1, 0) == 0);
+	Test_Stats(&overruns, &lost, &fifo);
+	CHECK(overruns == 3);
+
+	// receiver fifo overrun is counted and cleared
+	Sim_Reg.s1 = UART_S1_OR_MASK;
+	GS_HAL_recv(&b, 1, 0);
+	Test_Stats(&overruns, &lost, &fifo);
+	CHECK(fifo == 1);
+}
+
+static void Test_LateFlag(){
+	uint32_t pos = 0, overruns, lost, fifo;
+	int i;
+
+	printf("wrap flag set after head is read\n");
+	Test_Reset();
+	Sim_LateFlag = true;
+
+	// every wrap is seen through head first, late flag must not be taken as another lap
+	for (i = 0; i < 40; i ++)
+	{
+		Test_RxStream(pos, 1500);
+		CHECK(Test_ReadStream(pos, 1500));
+		pos += 1500;
+	}
+
+	Test_Stats(&overruns, &lost, &fifo);
+	CHECK(overruns == 0);
+}
+
+static void Test_ClearBuff(){
+	uint8_t b;
+
+	printf("clear buffer\n");
+	Test_Reset();
+
+	Test_RxStream(0, 3000);
+	GS_HAL_ClearBuff();
+	CHECK(GS_HAL_recv(&b, 1, 0) == 0);
+	Test_RxStream(3000, UART_RX_RING_SIZE - 1);
+	CHECK(Test_ReadStream(3000, UART_RX_RING_SIZE - 1));
+}
+
+static void Test_Blocking(){
+	uint8_t buf[16];
+
+	printf("blocking receive\n");
+	Test_Reset();
+
+	Test_RxStream(0, 10);
+	CHECK(GS_HAL_recv(buf, sizeof(buf), 1) == 10);		// returns on timeout with what it has
+	CHECK(buf[9] == Test_Byte(9));
+}
+
+static void Test_Send(){
+	uint8_t data[1000];
+	uint32_t i;
+
+	printf("send\n");
+	Test_Reset();
+
+	for (i = 0; i < sizeof(data); i ++)
+		data[i] = Test_Byte(i);
+	GS_HAL_send(data, sizeof(data));
+	Sim_DmaErq();										// last buffer is still on the line
+
+	CHECK(Sim_TxLen == sizeof(data));
+	CHECK(memcmp(Sim_Tx, data, sizeof(data)) == 0);
+}
+
+static void Test_Events(){
+	uint8_t data[300];
+
+	printf("idle line and transmit done events\n");
+	Test_Reset();
+	CHECK(UART0_C2 & UART_C2_ILIE_MASK);
+	CHECK(UART0_C1 & UART_C1_ILT_MASK);
+	CHECK(NVICISER0 & 0x02);
+
+	// idle line is reported only after DMA took the last byte from fifo
+	Test_RxStream(0, 20);
+	Sim_Reg.s1 = UART_S1_IDLE_MASK;
+	Sim_Reg.rcfifo = 1;
+	GS_HAL_Interrupt();
+	CHECK(Sim_RxIdleEvents == 0);
+	Sim_Reg.rcfifo = 0;
+	GS_HAL_Interrupt();
+	CHECK(Sim_RxIdleEvents == 1);
+	CHECK(Sim_Reg.sfifo == UART_SFIFO_RXUF_MASK);		// data register was read
+	Sim_Reg.s1 = 0;										// flag cleared by status and data read
+	GS_HAL_Interrupt();
+	CHECK(Sim_RxIdleEvents == 1);
+	CHECK(Test_ReadStream(0, 20));
+
+	// idle transmitter is not reported before anything is sent
+	Sim_Reg.s1 = UART_S1_TC_MASK;
+	GS_HAL_Interrupt();
+	CHECK(Sim_TxDoneEvents == 0);
+
+	// transmit DMA interrupt enables transmission complete, which is reported once
+	memset(data, 'a', sizeof(data));
+	GS_HAL_send(data, sizeof(data));
+	Sim_DmaErq();
+	CHECK(Sim_Reg.intFlags & DMA_INT_INT1_MASK);
+	GS_HAL_TxDmaInterrupt();
+	Sim_DmaClearInt();
+	CHECK((Sim_Reg.intFlags & DMA_INT_INT1_MASK) == 0);
+	CHECK(UART0_C2 & UART_C2_TCIE_MASK);
+
+	Sim_Reg.s1 = 0;										// last byte still on the line
+	GS_HAL_Interrupt();
+	CHECK(Sim_TxDoneEvents == 0);
+	Sim_Reg.s1 = UART_S1_TC_MASK;
+	GS_HAL_Interrupt();
+	CHECK(Sim_TxDoneEvents == 1);
+	CHECK((UART0_C2 & UART_C2_TCIE_MASK) == 0);
+	GS_HAL_Interrupt();
+	CHECK(Sim_TxDoneEvents == 1);
+	CHECK(Sim_TxLen == sizeof(data));
+}
+
+int main(){
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	Test_Stream();
+	Test_Overrun();
+	Test_LateFlag();
+	Test_ClearBuff();
+	Test_Blocking();
+	Test_Send();
+	Test_Events();
+
+	printf("%s\n", Test_Failed ? "FAILED" : "PASSED");
+	return Test_Failed ? 1 : 0;
+}
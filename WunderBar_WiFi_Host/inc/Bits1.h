@@ -0,0 +1,17 @@
+/** @file   Bits1.h
+ *  @brief  Host stand-in for Processor Expert Bits1 component (leds).
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#ifndef __Bits1_H
+#define __Bits1_H
+
+#include <stdint.h>
+
+void Bits1_SetBit(uint8_t Bit);
+void Bits1_ClrBit(uint8_t Bit);
+void Bits1_NegBit(uint8_t Bit);
+
+#endif // __Bits1_H
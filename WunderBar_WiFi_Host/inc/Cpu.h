@@ -0,0 +1,22 @@
+/** @file   Cpu.h
+ *  @brief  Host stand-in for Processor Expert Cpu component.
+ *  		Firmware sources compiled on host see no interrupts.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#ifndef __Cpu_H
+#define __Cpu_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define EnterCritical()
+#define ExitCritical()
+#define Cpu_DisableInt()
+#define Cpu_EnableInt()
+
+void Cpu_SystemReset();
+
+#endif // __Cpu_H
@@ -0,0 +1,14 @@
+/** @file   Events.h
+ *  @brief  Host stand-in for Processor Expert event module.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#ifndef __Events_H
+#define __Events_H
+
+#include "Cpu.h"
+#include "Bits1.h"
+
+#endif // __Events_H
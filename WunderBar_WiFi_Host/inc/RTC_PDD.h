@@ -0,0 +1,29 @@
+/** @file   RTC_PDD.h
+ *  @brief  Host stand-in for Processor Expert RTC peripheral driver.
+ *  		Time registers are variables of the program which uses hardware/RTC.c.
+ *
+ *  @author MikroElektronika
+ *  @bug    No known bugs.
+ */
+
+#ifndef RTC_PDD_H_
+#define RTC_PDD_H_
+
+#include <stdint.h>
+
+extern volatile uint32_t RTC_TSR;				// seconds
+extern volatile uint32_t RTC_TPR;				// prescaler (32768 Hz)
+extern volatile uint32_t RTC_TAR;				// alarm
+
+#define RTC_BASE_PTR							0
+#define PDD_DISABLE								0
+#define PDD_ENABLE								1
+
+#define RTC_PDD_EnableCounter(base, state)
+#define RTC_PDD_ReadTimeSecondsReg(base)		(RTC_TSR)
+#define RTC_PDD_ReadTimePrescalerReg(base)		(RTC_TPR)
+#define RTC_PDD_WriteTimeSecondsReg(base, x)	(RTC_TSR = (x))
+#define RTC_PDD_WriteTimePrescalerReg(base, x)	(RTC_TPR = (x))
+#define RTC_PDD_WriteTimeAlarmReg(base, x)		(RTC_TAR = (x))
+
+#endif // RTC_PDD_H_